@@ -0,0 +1,446 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Delta patch format, made by gen_ota_delta.py. All integers are little endian.
+ *
+ * Header, 80 bytes:
+ *   "ESPD", version (1), 3 reserved bytes,
+ *   uint32 length of the source image, uint32 length of the target image,
+ *   SHA-256 of the source image, as given by esp_partition_get_sha256(),
+ *   SHA-256 of the whole target image.
+ *
+ * Then, until the whole target image is made, control records of three varints
+ * (LEB128): diff length, extra length, and a seek in the source (zigzag coded):
+ *   - diff length bytes of the target are the bytes of the source at the current
+ *     position, plus a difference byte (modulo 256). The differences are mostly
+ *     zeros, they are given as pairs of a varint count of zeros and a varint count
+ *     of literal difference bytes followed by these bytes, until the diff length
+ *     is covered;
+ *   - extra length bytes of the target follow as they are;
+ *   - the source position, moved on by the diff length, is then moved by the seek.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_ota_delta.h"
+#include "mbedtls/sha256.h"
+
+#define DELTA_MAGIC         "ESPD"
+#define DELTA_VERSION       1
+#define DELTA_HEADER_LEN    80
+#define DELTA_HASH_LEN      32
+#define DELTA_BUF_SIZE      1024    /* Each for the source read and the image written */
+
+static const char *TAG = "esp_ota_delta";
+
+typedef enum {
+    DELTA_STATE_HEADER,
+    DELTA_STATE_CONTROL,
+    DELTA_STATE_ZEROS,
+    DELTA_STATE_LITERAL_LEN,
+    DELTA_STATE_LITERAL,
+    DELTA_STATE_EXTRA,
+    DELTA_STATE_DONE,
+} delta_state_t;
+
+struct esp_ota_delta {
+    const esp_partition_t *source;
+    const esp_partition_t *target;
+    esp_ota_handle_t ota_handle;    /* 0 until the header is read */
+    esp_err_t err;                  /* First error, the update can't go on after it */
+    delta_state_t state;
+    uint8_t header[DELTA_HEADER_LEN];
+    size_t header_len;
+    uint32_t source_size;
+    uint32_t target_size;
+    uint32_t varint;                /* Varint being read */
+    unsigned varint_shift;
+    unsigned control_field;         /* Field of the control record being read */
+    uint32_t control[3];            /* Diff length, extra length, seek */
+    uint32_t diff_left;             /* Bytes of the diff not given by a run yet */
+    uint32_t run_left;              /* Bytes left in the current literal or extra run */
+    uint32_t source_pos;
+    uint32_t produced;              /* Bytes of the target image made */
+    bool sha_started;
+    mbedtls_sha256_context sha;
+    uint32_t source_buf_pos;        /* Source offset of source_buf */
+    size_t source_buf_len;
+    size_t out_len;
+    uint8_t source_buf[DELTA_BUF_SIZE];
+    uint8_t out_buf[DELTA_BUF_SIZE];
+};
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t delta_flush(esp_ota_delta_handle_t h)
+{
+    if (h->out_len == 0) {
+        return ESP_OK;
+    }
+    if (mbedtls_sha256_update_ret(&h->sha, h->out_buf, h->out_len) != 0) {
+        return ESP_FAIL;
+    }
+    esp_err_t err = esp_ota_write(h->ota_handle, h->out_buf, h->out_len);
+    h->out_len = 0;
+    return err;
+}
+
+/* Makes len bytes of the target: the source bytes plus the differences in
+ * diff, or the source bytes as they are if diff is NULL */
+static esp_err_t delta_output_diff(esp_ota_delta_handle_t h, const uint8_t *diff, uint32_t len)
+{
+    while (len > 0) {
+        if (h->source_pos < h->source_buf_pos || h->source_pos >= h->source_buf_pos + h->source_buf_len) {
+            h->source_buf_pos = h->source_pos;
+            h->source_buf_len = MIN(sizeof(h->source_buf), h->source_size - h->source_pos);
+            esp_err_t err = esp_partition_read(h->source, h->source_buf_pos, h->source_buf, h->source_buf_len);
+            if (err != ESP_OK) {
+                h->source_buf_len = 0;
+                return err;
+            }
+        }
+        const uint8_t *src = h->source_buf + (h->source_pos - h->source_buf_pos);
+        size_t n = MIN(len, h->source_buf_pos + h->source_buf_len - h->source_pos);
+        n = MIN(n, sizeof(h->out_buf) - h->out_len);
+        uint8_t *out = h->out_buf + h->out_len;
+        if (diff) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = src[i] + diff[i];
+            }
+            diff += n;
+        } else {
+            memcpy(out, src, n);
+        }
+        h->out_len += n;
+        h->source_pos += n;
+        h->produced += n;
+        len -= n;
+        if (h->out_len == sizeof(h->out_buf)) {
+            esp_err_t err = delta_flush(h);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t delta_output_extra(esp_ota_delta_handle_t h, const uint8_t *data, uint32_t len)
+{
+    while (len > 0) {
+        size_t n = MIN(len, sizeof(h->out_buf) - h->out_len);
+        memcpy(h->out_buf + h->out_len, data, n);
+        h->out_len += n;
+        h->produced += n;
+        data += n;
+        len -= n;
+        if (h->out_len == sizeof(h->out_buf)) {
+            esp_err_t err = delta_flush(h);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t delta_start(esp_ota_delta_handle_t h)
+{
+    const uint8_t *header = h->header;
+    if (memcmp(header, DELTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a delta patch");
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+    if (header[4] != DELTA_VERSION) {
+        ESP_LOGE(TAG, "Delta patch version %d is not supported", header[4]);
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+    h->source_size = get_le32(header + 8);
+    h->target_size = get_le32(header + 12);
+    if (h->source_size > h->source->size || h->target_size == 0 || h->target_size > h->target->size) {
+        ESP_LOGE(TAG, "Delta patch from %u to %u bytes doesn't fit partitions of %u and %u bytes",
+                 h->source_size, h->target_size, h->source->size, h->target->size);
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+
+    uint8_t sha256[DELTA_HASH_LEN];
+    esp_err_t err = esp_partition_get_sha256(h->source, sha256);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read the source image (%s)", esp_err_to_name(err));
+        return err;
+    }
+    if (memcmp(sha256, header + 16, DELTA_HASH_LEN) != 0) {
+        ESP_LOGE(TAG, "Delta patch is not for the image in partition %s", h->source->label);
+        return ESP_ERR_OTA_DELTA_SOURCE_MISMATCH;
+    }
+
+    mbedtls_sha256_init(&h->sha);
+    h->sha_started = true;
+    if (mbedtls_sha256_starts_ret(&h->sha, 0) != 0) {
+        return ESP_FAIL;
+    }
+    err = esp_ota_begin(h->target, h->target_size, &h->ota_handle);
+    if (err != ESP_OK) {
+        h->ota_handle = 0;
+        return err;
+    }
+    ESP_LOGI(TAG, "Applying delta patch to make an image of %u bytes", h->target_size);
+    h->state = DELTA_STATE_CONTROL;
+    return ESP_OK;
+}
+
+/* Reads a byte of a varint, returns true once the varint is complete */
+static bool delta_varint(esp_ota_delta_handle_t h, uint8_t byte, esp_err_t *err)
+{
+    if (h->varint_shift > 28 || (h->varint_shift == 28 && (byte & 0x70))) {
+        ESP_LOGE(TAG, "Delta patch has an invalid number");
+        *err = ESP_ERR_OTA_DELTA_INVALID;
+        return false;
+    }
+    h->varint |= (uint32_t)(byte & 0x7f) << h->varint_shift;
+    h->varint_shift += 7;
+    return !(byte & 0x80);
+}
+
+static uint32_t delta_varint_take(esp_ota_delta_handle_t h)
+{
+    uint32_t value = h->varint;
+    h->varint = 0;
+    h->varint_shift = 0;
+    return value;
+}
+
+static esp_err_t delta_end_control(esp_ota_delta_handle_t h)
+{
+    int32_t seek = (int32_t)h->control[2];
+    if ((seek < 0 && (uint32_t)-seek > h->source_pos) ||
+        (seek > 0 && (uint32_t)seek > h->source_size - h->source_pos)) {
+        ESP_LOGE(TAG, "Delta patch seeks out of the source image");
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+    h->source_pos += seek;
+    h->state = h->produced == h->target_size ? DELTA_STATE_DONE : DELTA_STATE_CONTROL;
+    return ESP_OK;
+}
+
+static esp_err_t delta_next_run(esp_ota_delta_handle_t h)
+{
+    if (h->diff_left > 0) {
+        h->state = DELTA_STATE_ZEROS;
+        return ESP_OK;
+    }
+    h->run_left = h->control[1];
+    if (h->run_left > 0) {
+        h->state = DELTA_STATE_EXTRA;
+        return ESP_OK;
+    }
+    return delta_end_control(h);
+}
+
+static esp_err_t delta_start_control(esp_ota_delta_handle_t h)
+{
+    uint32_t diff_len = h->control[0];
+    uint32_t extra_len = h->control[1];
+    uint32_t left = h->target_size - h->produced;
+    if (diff_len > left || extra_len > left - diff_len || diff_len > h->source_size - h->source_pos) {
+        ESP_LOGE(TAG, "Delta patch goes out of the images");
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+    if (diff_len == 0 && extra_len == 0 && h->control[2] == 0) {
+        /* Would not make progress */
+        ESP_LOGE(TAG, "Delta patch has an empty control record");
+        return ESP_ERR_OTA_DELTA_INVALID;
+    }
+    h->diff_left = diff_len;
+    return delta_next_run(h);
+}
+
+esp_err_t esp_ota_delta_begin(const esp_partition_t *source, const esp_partition_t *target, esp_ota_delta_handle_t *out_handle)
+{
+    if (source == NULL || target == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (target->type != ESP_PARTITION_TYPE_APP || source->address == target->address) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_ota_delta_handle_t h = calloc(1, sizeof(struct esp_ota_delta));
+    if (h == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    h->source = source;
+    h->target = target;
+    h->state = DELTA_STATE_HEADER;
+    *out_handle = h;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_delta_write(esp_ota_delta_handle_t h, const void *data, size_t size)
+{
+    if (h == NULL || (data == NULL && size > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *in = data;
+    esp_err_t err = h->err;
+
+    while (size > 0 && err == ESP_OK) {
+        size_t n = 1;
+        switch (h->state) {
+        case DELTA_STATE_HEADER:
+            n = MIN(size, DELTA_HEADER_LEN - h->header_len);
+            memcpy(h->header + h->header_len, in, n);
+            h->header_len += n;
+            if (h->header_len == DELTA_HEADER_LEN) {
+                err = delta_start(h);
+            }
+            break;
+        case DELTA_STATE_CONTROL:
+            if (delta_varint(h, *in, &err)) {
+                h->control[h->control_field++] = delta_varint_take(h);
+                if (h->control_field == 3) {
+                    h->control_field = 0;
+                    /* Zigzag decoding of the seek */
+                    h->control[2] = (h->control[2] >> 1) ^ -(h->control[2] & 1);
+                    err = delta_start_control(h);
+                }
+            }
+            break;
+        case DELTA_STATE_ZEROS:
+            if (delta_varint(h, *in, &err)) {
+                uint32_t zeros = delta_varint_take(h);
+                if (zeros > h->diff_left) {
+                    ESP_LOGE(TAG, "Delta patch has a run longer than its diff");
+                    err = ESP_ERR_OTA_DELTA_INVALID;
+                    break;
+                }
+                h->diff_left -= zeros;
+                err = delta_output_diff(h, NULL, zeros);
+                h->state = DELTA_STATE_LITERAL_LEN;
+            }
+            break;
+        case DELTA_STATE_LITERAL_LEN:
+            if (delta_varint(h, *in, &err)) {
+                h->run_left = delta_varint_take(h);
+                if (h->run_left > h->diff_left) {
+                    ESP_LOGE(TAG, "Delta patch has a run longer than its diff");
+                    err = ESP_ERR_OTA_DELTA_INVALID;
+                    break;
+                }
+                h->diff_left -= h->run_left;
+                if (h->run_left > 0) {
+                    h->state = DELTA_STATE_LITERAL;
+                } else {
+                    err = delta_next_run(h);
+                }
+            }
+            break;
+        case DELTA_STATE_LITERAL:
+            n = MIN(size, h->run_left);
+            err = delta_output_diff(h, in, n);
+            h->run_left -= n;
+            if (err == ESP_OK && h->run_left == 0) {
+                err = delta_next_run(h);
+            }
+            break;
+        case DELTA_STATE_EXTRA:
+            n = MIN(size, h->run_left);
+            err = delta_output_extra(h, in, n);
+            h->run_left -= n;
+            if (err == ESP_OK && h->run_left == 0) {
+                err = delta_end_control(h);
+            }
+            break;
+        case DELTA_STATE_DONE:
+            ESP_LOGE(TAG, "Data after the end of the delta patch");
+            err = ESP_ERR_OTA_DELTA_INVALID;
+            break;
+        }
+        in += n;
+        size -= n;
+    }
+    h->err = err;
+    return err;
+}
+
+static void delta_free(esp_ota_delta_handle_t h)
+{
+    if (h->sha_started) {
+        mbedtls_sha256_free(&h->sha);
+    }
+    free(h);
+}
+
+esp_err_t esp_ota_delta_end(esp_ota_delta_handle_t h)
+{
+    if (h == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = h->err;
+    if (err == ESP_OK && h->state != DELTA_STATE_DONE) {
+        ESP_LOGE(TAG, "Delta patch is incomplete, %u of %u bytes made", h->produced, h->target_size);
+        err = ESP_ERR_INVALID_STATE;
+    }
+    if (err == ESP_OK) {
+        err = delta_flush(h);
+    }
+    if (err == ESP_OK) {
+        uint8_t sha256[DELTA_HASH_LEN];
+        if (mbedtls_sha256_finish_ret(&h->sha, sha256) != 0) {
+            err = ESP_FAIL;
+        } else if (memcmp(sha256, h->header + 16 + DELTA_HASH_LEN, DELTA_HASH_LEN) != 0) {
+            ESP_LOGE(TAG, "SHA-256 of the image made by the delta patch doesn't match");
+            err = ESP_ERR_OTA_VALIDATE_FAILED;
+        }
+    }
+    if (h->ota_handle != 0) {
+        if (err == ESP_OK) {
+            err = esp_ota_end(h->ota_handle);
+        } else {
+            esp_ota_abort(h->ota_handle);
+        }
+    }
+    delta_free(h);
+    return err;
+}
+
+esp_err_t esp_ota_delta_abort(esp_ota_delta_handle_t h)
+{
+    if (h == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (h->ota_handle != 0) {
+        esp_ota_abort(h->ota_handle);
+    }
+    delta_free(h);
+    return ESP_OK;
+}
+
+size_t esp_ota_delta_get_image_size(esp_ota_delta_handle_t h)
+{
+    return h != NULL ? h->target_size : 0;
+}
+
+size_t esp_ota_delta_get_image_len_written(esp_ota_delta_handle_t h)
+{
+    return h != NULL ? h->produced : 0;
+}
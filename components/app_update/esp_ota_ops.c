@@ -51,6 +51,9 @@ typedef struct ota_ops_entry_ {
     uint32_t wrote_size;
     uint8_t partial_bytes;
     uint8_t partial_data[16];
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    esp_partition_erase_handle_t erase_handle;
+#endif
     LIST_ENTRY(ota_ops_entry_) entries;
 } ota_ops_entry_t;
 
@@ -120,7 +123,8 @@ static esp_ota_img_states_t set_new_state_otadata(void)
 #endif
 }
 
-esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+/* Erases the partition from image_offset to the image size, and starts writing at image_offset */
+static esp_err_t ota_begin_at(const esp_partition_t *partition, size_t image_size, size_t image_offset, esp_ota_handle_t *out_handle)
 {
     ota_ops_entry_t *new_entry;
     esp_err_t ret = ESP_OK;
@@ -153,23 +157,32 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     }
 #endif
 
+    new_entry = (ota_ops_entry_t *) calloc(sizeof(ota_ops_entry_t), 1);
+    if (new_entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
     // If input image size is 0 or OTA_SIZE_UNKNOWN, erase entire partition
-    if ((image_size == 0) || (image_size == OTA_SIZE_UNKNOWN)) {
-        ret = esp_partition_erase_range(partition, 0, partition->size);
-    } else {
-        const int aligned_erase_size = (image_size + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
-        ret = esp_partition_erase_range(partition, 0, aligned_erase_size);
+    size_t erase_size = partition->size;
+    if ((image_size != 0) && (image_size != OTA_SIZE_UNKNOWN)) {
+        erase_size = (image_size + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
     }
+    if ((image_offset % SPI_FLASH_SEC_SIZE) != 0 || image_offset >= erase_size) {
+        free(new_entry);
+        return ESP_ERR_INVALID_ARG;
+    }
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    // Writes wait for the erase to pass the written region, see ota_wait_erased()
+    ret = esp_partition_erase_range_async(partition, image_offset, erase_size - image_offset, &new_entry->erase_handle);
+#else
+    ret = esp_partition_erase_range(partition, image_offset, erase_size - image_offset);
+#endif
 
     if (ret != ESP_OK) {
+        free(new_entry);
         return ret;
     }
 
-    new_entry = (ota_ops_entry_t *) calloc(sizeof(ota_ops_entry_t), 1);
-    if (new_entry == NULL) {
-        return ESP_ERR_NO_MEM;
-    }
-
     LIST_INSERT_HEAD(&s_ota_ops_entries_head, new_entry, entries);
 
     if ((image_size == 0) || (image_size == OTA_SIZE_UNKNOWN)) {
@@ -179,11 +192,34 @@ esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp
     }
 
     new_entry->part = partition;
+    new_entry->wrote_size = image_offset;
     new_entry->handle = ++s_ota_ops_last_handle;
     *out_handle = new_entry->handle;
     return ESP_OK;
 }
 
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    return ota_begin_at(partition, image_size, 0, out_handle);
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t image_size, size_t image_offset, esp_ota_handle_t *out_handle)
+{
+    if (image_offset == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ota_begin_at(partition, image_size, image_offset, out_handle);
+}
+
+static esp_err_t ota_wait_erased(ota_ops_entry_t *it, size_t end_offset)
+{
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    return esp_partition_erase_wait(it->erase_handle, end_offset);
+#else
+    return ESP_OK;
+#endif
+}
+
 esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
 {
     const uint8_t *data_bytes = (const uint8_t *)data;
@@ -218,6 +254,10 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
                         return ESP_OK; /* nothing to write yet, just filling buffer */
                     }
                     /* write 16 byte to partition */
+                    ret = ota_wait_erased(it, it->wrote_size + 16);
+                    if (ret != ESP_OK) {
+                        return ret;
+                    }
                     ret = esp_partition_write(it->part, it->wrote_size, it->partial_data, 16);
                     if (ret != ESP_OK) {
                         return ret;
@@ -237,6 +277,10 @@ esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
                 }
             }
 
+            ret = ota_wait_erased(it, it->wrote_size + size);
+            if (ret != ESP_OK) {
+                return ret;
+            }
             ret = esp_partition_write(it->part, it->wrote_size, data_bytes, size);
             if(ret == ESP_OK){
                 it->wrote_size += size;
@@ -274,6 +318,10 @@ esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, s
                 ESP_LOGE(TAG, "Size should be 16byte aligned for flash encryption case");
                 return ESP_ERR_INVALID_ARG;
             }
+            ret = ota_wait_erased(it, offset + size);
+            if (ret != ESP_OK) {
+                return ret;
+            }
             ret = esp_partition_write(it->part, offset, data_bytes, size);
             if (ret == ESP_OK) {
                 it->wrote_size += size;
@@ -310,6 +358,15 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
         goto cleanup;
     }
 
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    // Rest of the partition must be erased before the image can be verified
+    ret = esp_partition_erase_end(it->erase_handle);
+    it->erase_handle = NULL;
+    if (ret != ESP_OK) {
+        goto cleanup;
+    }
+#endif
+
     if (it->partial_bytes > 0) {
         /* Write out last 16 bytes, if necessary */
         ret = esp_partition_write(it->part, it->wrote_size, it->partial_data, 16);
@@ -333,11 +390,40 @@ esp_err_t esp_ota_end(esp_ota_handle_t handle)
     }
 
  cleanup:
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    if (it->erase_handle != NULL) {
+        esp_partition_erase_abort(it->erase_handle);
+    }
+#endif
     LIST_REMOVE(it, entries);
     free(it);
     return ret;
 }
 
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    ota_ops_entry_t *it;
+
+    for (it = LIST_FIRST(&s_ota_ops_entries_head); it != NULL; it = LIST_NEXT(it, entries)) {
+        if (it->handle == handle) {
+            break;
+        }
+    }
+
+    if (it == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+#ifdef CONFIG_APP_OTA_ERASE_IN_BACKGROUND
+    if (it->erase_handle != NULL) {
+        esp_partition_erase_abort(it->erase_handle);
+    }
+#endif
+    LIST_REMOVE(it, entries);
+    free(it);
+    return ESP_OK;
+}
+
 static esp_err_t rewrite_ota_seq(esp_ota_select_entry_t *two_otadata, uint32_t seq, uint8_t sec_id, const esp_partition_t *ota_data_partition)
 {
     if (two_otadata == NULL || sec_id > 1) {
@@ -0,0 +1,350 @@
+#!/usr/bin/env python
+#
+# gen_ota_delta generates a delta patch which turns an app image into another,
+# for the OTA updates applied on the device by esp_ota_delta_write()
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http:#www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from __future__ import print_function, division
+import argparse
+import hashlib
+import re
+import struct
+import sys
+
+__version__ = '1.0'
+
+quiet = False
+
+DELTA_MAGIC = b'ESPD'
+DELTA_VERSION = 1
+HEADER_FORMAT = '<4sB3xII32s32s'
+
+ESP_IMAGE_MAGIC = 0xE9
+IMAGE_HEADER_LEN = 24       # esp_image_header_t
+SEGMENT_HEADER_LEN = 8      # esp_image_segment_header_t
+HASH_LEN = 32
+
+# Length of the keys of the source index, and number of source positions kept for each key
+BLOCK_LEN = 8
+MAX_CANDIDATES = 16
+# A match is worth breaking the current alignment if it is that longer
+MATCH_BONUS = 8
+# Runs of zeros in a diff shorter than this are cheaper as literal bytes
+ZERO_RUN_MIN = 3
+ZERO_RUN = re.compile(b'\x00{%d,}' % ZERO_RUN_MIN)
+
+
+class DeltaError(RuntimeError):
+    pass
+
+
+def status(msg):
+    if not quiet:
+        print(msg)
+
+
+def image_sha256(image):
+    """ SHA-256 of an app image as esp_partition_get_sha256() gives it: the appended hash
+    if the image has one, or else the hash of the image up to its checksum """
+    if len(image) < IMAGE_HEADER_LEN or image[0] != ESP_IMAGE_MAGIC:
+        raise DeltaError('Not an app image')
+    segments = image[1]
+    hash_appended = image[IMAGE_HEADER_LEN - 1]
+    pos = IMAGE_HEADER_LEN
+    for _ in range(segments):
+        if pos + SEGMENT_HEADER_LEN > len(image):
+            raise DeltaError('Truncated app image')
+        _, data_len = struct.unpack_from('<II', image, pos)
+        pos += SEGMENT_HEADER_LEN + data_len
+    # The checksum is the last byte of a 16 byte block
+    image_len = (pos + 16) & ~15
+    if hash_appended:
+        if image_len + HASH_LEN > len(image):
+            raise DeltaError('Truncated app image')
+        digest = bytes(image[image_len:image_len + HASH_LEN])
+        if hashlib.sha256(image[:image_len]).digest() != digest:
+            raise DeltaError('App image hash does not match its contents')
+        return digest
+    if image_len > len(image):
+        raise DeltaError('Truncated app image')
+    return hashlib.sha256(image[:image_len]).digest()
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7f) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def zigzag(value):
+    return value * 2 if value >= 0 else -value * 2 - 1
+
+
+def build_index(source):
+    index = {}
+    for pos in range(len(source) - BLOCK_LEN + 1):
+        key = bytes(source[pos:pos + BLOCK_LEN])
+        candidates = index.get(key)
+        if candidates is None:
+            index[key] = [pos]
+        elif len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+    return index
+
+
+def match_length(a, a_pos, b, b_pos):
+    """ Length of the common prefix of a[a_pos:] and b[b_pos:], compared by slices """
+    limit = min(len(a) - a_pos, len(b) - b_pos)
+    length = 0
+    step = 32
+    while length < limit:
+        end = min(limit, length + step)
+        if a[a_pos + length:a_pos + end] == b[b_pos + length:b_pos + end]:
+            length = end
+            step *= 2
+            continue
+        # The mismatch is in [length, end)
+        while end - length > 1:
+            mid = (length + end) // 2
+            if a[a_pos + length:a_pos + mid] == b[b_pos + length:b_pos + mid]:
+                length = mid
+            else:
+                end = mid
+        break
+    return length
+
+
+def encode_diff(diff):
+    """ Pairs of a count of zeros and a count of literal bytes followed by these bytes """
+    if not diff:
+        return bytearray()
+    out = bytearray()
+    pos = len(diff) - len(diff.lstrip(b'\x00'))
+    zeros = pos
+    for run in ZERO_RUN.finditer(diff, pos):
+        start, end = run.span()
+        out += varint(zeros) + varint(start - pos) + diff[pos:start]
+        zeros = end - start
+        pos = end
+    out += varint(zeros) + varint(len(diff) - pos) + diff[pos:]
+    return out
+
+
+def generate_patch(source, target):
+    """ Delta patch from the source image to the target image.
+
+    The matching follows bsdiff: exact matches of the target in the source, found with
+    an index of the source, are extended forwards and backwards as long as more than half
+    of the bytes match, so that code which only moved keeps a diff of mostly zeros. """
+    source = bytearray(source)
+    target = bytearray(target)
+    index = build_index(source)
+    old_len = len(source)
+    new_len = len(target)
+
+    def search(scan):
+        best_len = 0
+        best_pos = 0
+        for pos in index.get(bytes(target[scan:scan + BLOCK_LEN]), ()):
+            length = match_length(source, pos, target, scan)
+            if length > best_len:
+                best_len = length
+                best_pos = pos
+        return best_len, best_pos
+
+    body = bytearray()
+    scan = 0
+    length = 0
+    pos = 0
+    last_scan = 0
+    last_pos = 0
+    last_offset = 0
+    while scan < new_len:
+        old_score = 0
+        scan += length
+        scsc = scan
+        while scan < new_len:
+            length, pos = search(scan)
+            while scsc < scan + length:
+                if scsc + last_offset < old_len and source[scsc + last_offset] == target[scsc]:
+                    old_score += 1
+                scsc += 1
+            if (length == old_score and length != 0) or length > old_score + MATCH_BONUS:
+                break
+            if scan + last_offset < old_len and source[scan + last_offset] == target[scan]:
+                old_score -= 1
+            scan += 1
+
+        if length == old_score and scan != new_len:
+            continue
+
+        # Extend the previous match forwards...
+        score = 0
+        best_score = 0
+        len_f = 0
+        i = 0
+        while last_scan + i < scan and last_pos + i < old_len:
+            if source[last_pos + i] == target[last_scan + i]:
+                score += 1
+            i += 1
+            if score * 2 - i > best_score * 2 - len_f:
+                best_score = score
+                len_f = i
+
+        # ...and the new one backwards
+        len_b = 0
+        if scan < new_len:
+            score = 0
+            best_score = 0
+            i = 1
+            while scan >= last_scan + i and pos >= i:
+                if source[pos - i] == target[scan - i]:
+                    score += 1
+                if score * 2 - i > best_score * 2 - len_b:
+                    best_score = score
+                    len_b = i
+                i += 1
+
+        if last_scan + len_f > scan - len_b:
+            # The extensions overlap, split them where it is best
+            overlap = (last_scan + len_f) - (scan - len_b)
+            score = 0
+            best_score = 0
+            len_s = 0
+            for i in range(overlap):
+                if target[last_scan + len_f - overlap + i] == source[last_pos + len_f - overlap + i]:
+                    score += 1
+                if target[scan - len_b + i] == source[pos - len_b + i]:
+                    score -= 1
+                if score > best_score:
+                    best_score = score
+                    len_s = i + 1
+            len_f += len_s - overlap
+            len_b -= len_s
+
+        extra_start = last_scan + len_f
+        extra_len = (scan - len_b) - extra_start
+        seek = (pos - len_b) - (last_pos + len_f)
+        if len_f or extra_len or seek:
+            diff = bytearray((n - o) & 0xff for n, o in zip(target[last_scan:extra_start],
+                                                            source[last_pos:last_pos + len_f]))
+            body += varint(len_f) + varint(extra_len) + varint(zigzag(seek))
+            body += encode_diff(diff)
+            body += target[extra_start:extra_start + extra_len]
+
+        last_scan = scan - len_b
+        last_pos = pos - len_b
+        last_offset = pos - scan
+
+    header = struct.pack(HEADER_FORMAT, DELTA_MAGIC, DELTA_VERSION, old_len, new_len,
+                         image_sha256(source), hashlib.sha256(target).digest())
+    return bytearray(header) + body
+
+
+def apply_patch(source, patch):
+    """ Applies a patch the way esp_ota_delta_write() does, to check it """
+    source = bytearray(source)
+    patch = bytearray(patch)
+    header_len = struct.calcsize(HEADER_FORMAT)
+    if len(patch) < header_len:
+        raise DeltaError('Truncated patch')
+    magic, version, old_len, new_len, source_sha, target_sha = struct.unpack_from(HEADER_FORMAT, patch)
+    if magic != DELTA_MAGIC or version != DELTA_VERSION:
+        raise DeltaError('Not a delta patch of version %d' % DELTA_VERSION)
+    if old_len > len(source) or image_sha256(source[:old_len]) != source_sha:
+        raise DeltaError('Patch is not for this source image')
+
+    p = [header_len]
+
+    def read_varint():
+        value = 0
+        shift = 0
+        while True:
+            if p[0] >= len(patch):
+                raise DeltaError('Truncated patch')
+            byte = patch[p[0]]
+            p[0] += 1
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def read_bytes(count):
+        if p[0] + count > len(patch):
+            raise DeltaError('Truncated patch')
+        p[0] += count
+        return patch[p[0] - count:p[0]]
+
+    target = bytearray()
+    old_pos = 0
+    while len(target) < new_len:
+        diff_len = read_varint()
+        extra_len = read_varint()
+        seek = read_varint()
+        seek = (seek >> 1) ^ -(seek & 1)
+        if len(target) + diff_len + extra_len > new_len or old_pos + diff_len > old_len:
+            raise DeltaError('Patch goes out of the images')
+        diff = bytearray()
+        while len(diff) < diff_len:
+            for literal in (False, True):
+                count = read_varint()
+                if count > diff_len - len(diff):
+                    raise DeltaError('Patch has a run longer than its diff')
+                diff += read_bytes(count) if literal else bytearray(count)
+        target += bytearray((o + d) & 0xff for o, d in zip(source[old_pos:old_pos + diff_len], diff))
+        target += read_bytes(extra_len)
+        old_pos += diff_len + seek
+        if old_pos < 0 or old_pos > old_len:
+            raise DeltaError('Patch seeks out of the source image')
+    if p[0] != len(patch):
+        raise DeltaError('Data after the end of the patch')
+    if hashlib.sha256(target).digest() != target_sha:
+        raise DeltaError('SHA-256 of the image made by the patch does not match')
+    return target
+
+
+def main():
+    global quiet
+
+    parser = argparse.ArgumentParser(description='ESP32 delta OTA patch generator')
+    parser.add_argument('--quiet', '-q', help="Don't print non-critical status messages to stderr", action='store_true')
+    parser.add_argument('--no-verify', help="Don't apply the patch to check it", action='store_true')
+    parser.add_argument('source', help='App image running on the device', type=argparse.FileType('rb'))
+    parser.add_argument('target', help='New app image', type=argparse.FileType('rb'))
+    parser.add_argument('output', help='Path for the patch', type=argparse.FileType('wb'))
+    args = parser.parse_args()
+    quiet = args.quiet
+
+    source = bytearray(args.source.read())
+    target = bytearray(args.target.read())
+    try:
+        patch = generate_patch(source, target)
+        if not args.no_verify:
+            if apply_patch(source, patch) != target:
+                raise DeltaError('Patch does not make the new image')
+    except DeltaError as e:
+        print('Error: %s' % e, file=sys.stderr)
+        sys.exit(2)
+
+    args.output.write(patch)
+    status('Delta patch of %d bytes, %.1f%% of the new image of %d bytes'
+           % (len(patch), 100.0 * len(patch) / len(target), len(target)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,139 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Opaque handle for an OTA update from a delta patch
+ */
+typedef struct esp_ota_delta *esp_ota_delta_handle_t;
+
+/**
+ * @brief   Start an OTA update from a delta patch
+ *
+ * A delta patch, made by gen_ota_delta.py from the image in the source partition and the new
+ * image, holds the differences between both. The new image is rebuilt from the source
+ * partition and the patch, and written to the target partition with esp_ota_write().
+ *
+ * The patch is given to esp_ota_delta_write() as it is received: nothing is read nor erased
+ * before its header is, the source partition is then checked to hold the image the patch
+ * was made from, and esp_ota_begin() is called for the target partition.
+ *
+ * @param source      Partition holding the image the patch was made from, usually the running
+ *                    partition given by esp_ota_get_running_partition(). Required.
+ * @param target      Partition which will receive the new image, as for esp_ota_begin(). Required.
+ * @param out_handle  On success, returns a handle to use for subsequent esp_ota_delta_write() and
+ *                    esp_ota_delta_end() or esp_ota_delta_abort() calls.
+ *
+ * @return
+ *    - ESP_OK: Delta update started, no flash operation was done.
+ *    - ESP_ERR_INVALID_ARG: source, target or out_handle were NULL, target doesn't point to an app partition,
+ *      or source and target are the same partition.
+ *    - ESP_ERR_NO_MEM: Cannot allocate memory for the update.
+ */
+esp_err_t esp_ota_delta_begin(const esp_partition_t *source, const esp_partition_t *target, esp_ota_delta_handle_t *out_handle);
+
+/**
+ * @brief   Apply the next part of a delta patch
+ *
+ * This function can be called multiple times as the patch is received, with parts of any size.
+ * The data of the new image is written to the target partition as soon as it is rebuilt. Once this
+ * function returns an error, the update is failed and only esp_ota_delta_abort() can be called.
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin().
+ * @param data    Patch data.
+ * @param size    Size of the data, in bytes.
+ *
+ * @return
+ *    - ESP_OK: Patch data applied.
+ *    - ESP_ERR_INVALID_ARG: handle or data is NULL.
+ *    - ESP_ERR_OTA_DELTA_INVALID: The patch is corrupt, of an unsupported version, continues past its end,
+ *      or makes an image which does not fit in the target partition.
+ *    - ESP_ERR_OTA_DELTA_SOURCE_MISMATCH: The source partition does not hold the image the patch was made from.
+ *    - ESP_ERR_NO_MEM: Cannot allocate memory for the hash of the new image.
+ *    - ESP_ERR_FLASH_OP_TIMEOUT or ESP_ERR_FLASH_OP_FAIL: Flash read or write failed.
+ *    - Errors of esp_ota_begin() and esp_ota_write().
+ */
+esp_err_t esp_ota_delta_write(esp_ota_delta_handle_t handle, const void *data, size_t size);
+
+/**
+ * @brief   Finish an OTA update from a delta patch
+ *
+ * Checks that the whole patch was applied and that the SHA-256 of the image written matches
+ * the one in the patch, then finishes the update with esp_ota_end(). As for esp_ota_end(), the
+ * target partition still has to be selected with esp_ota_set_boot_partition().
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin().
+ *
+ * @note After calling esp_ota_delta_end(), the handle is no longer valid and any memory associated with it is freed
+ *       (regardless of result).
+ *
+ * @return
+ *    - ESP_OK: New image written and valid.
+ *    - ESP_ERR_INVALID_ARG: handle is NULL.
+ *    - ESP_ERR_INVALID_STATE: The patch was not completely written.
+ *    - ESP_ERR_OTA_VALIDATE_FAILED: The image written does not have the SHA-256 given by the patch, or is invalid.
+ *    - The error returned before by esp_ota_delta_write(), if any.
+ *    - Errors of esp_ota_write() and esp_ota_end().
+ */
+esp_err_t esp_ota_delta_end(esp_ota_delta_handle_t handle);
+
+/**
+ * @brief   Abort an OTA update from a delta patch
+ *
+ * Frees the handle and its memory without checking the image written so far, see esp_ota_abort().
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin().
+ *
+ * @return
+ *    - ESP_OK: Update aborted.
+ *    - ESP_ERR_INVALID_ARG: handle is NULL.
+ */
+esp_err_t esp_ota_delta_abort(esp_ota_delta_handle_t handle);
+
+/**
+ * @brief   Gives the size of the image made by the patch
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin().
+ *
+ * @return
+ *    - Size of the new image, in bytes.
+ *    - 0 if handle is NULL or the header of the patch was not written yet.
+ */
+size_t esp_ota_delta_get_image_size(esp_ota_delta_handle_t handle);
+
+/**
+ * @brief   Gives the length of the new image written so far
+ *
+ * @param handle  Handle obtained from esp_ota_delta_begin().
+ *
+ * @return
+ *    - Length of the image rebuilt so far, in bytes.
+ *    - 0 if handle is NULL.
+ */
+size_t esp_ota_delta_get_image_len_written(esp_ota_delta_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
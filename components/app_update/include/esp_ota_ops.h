@@ -37,6 +37,8 @@ extern "C"
 #define ESP_ERR_OTA_SMALL_SEC_VER                (ESP_ERR_OTA_BASE + 0x04)  /*!< Error if the firmware has a secure version less than the running firmware. */
 #define ESP_ERR_OTA_ROLLBACK_FAILED              (ESP_ERR_OTA_BASE + 0x05)  /*!< Error if flash does not have valid firmware in passive partition and hence rollback is not possible */
 #define ESP_ERR_OTA_ROLLBACK_INVALID_STATE       (ESP_ERR_OTA_BASE + 0x06)  /*!< Error if current active firmware is still marked in pending validation state (ESP_OTA_IMG_PENDING_VERIFY), essentially first boot of firmware image post upgrade and hence firmware upgrade is not possible */
+#define ESP_ERR_OTA_DELTA_INVALID                (ESP_ERR_OTA_BASE + 0x07)  /*!< Error if a delta patch is corrupt or not supported */
+#define ESP_ERR_OTA_DELTA_SOURCE_MISMATCH        (ESP_ERR_OTA_BASE + 0x08)  /*!< Error if a delta patch was made from another image than the one in the source partition */
 
 
 /**
@@ -73,6 +75,11 @@ int esp_ota_get_app_elf_sha256(char* dst, size_t size);
  * If image size is not yet known, pass OTA_SIZE_UNKNOWN which will
  * cause the entire partition to be erased.
  *
+ * If CONFIG_APP_OTA_ERASE_IN_BACKGROUND is enabled, the erase runs in a background
+ * task and this function returns once it has started. esp_ota_write() then waits
+ * until the region being written is erased, and esp_ota_end() waits for the whole
+ * erase to complete.
+ *
  * On success, this function allocates memory that remains in use
  * until esp_ota_end() is called with the returned handle.
  *
@@ -97,6 +104,30 @@ int esp_ota_get_app_elf_sha256(char* dst, size_t size);
  */
 esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t image_size, esp_ota_handle_t* out_handle);
 
+/**
+ * @brief   Resume an OTA update which was interrupted
+ *
+ * Like esp_ota_begin(), except that the first image_offset bytes of the image are
+ * expected to be in the partition already, written by an earlier update of the same
+ * image: only the partition from image_offset on is erased, and esp_ota_write()
+ * goes on writing at image_offset.
+ *
+ * The caller is responsible for checking that the data before image_offset was
+ * completely written, esp_ota_end() validates the whole image as usual.
+ *
+ * @param partition     Pointer to info for partition which will receive the OTA update. Required.
+ * @param image_size    Size of the whole OTA app image, as for esp_ota_begin().
+ * @param image_offset  Length of the image already written, a multiple of the flash sector size (SPI_FLASH_SEC_SIZE).
+ * @param out_handle    On success, returns a handle which should be used for subsequent esp_ota_write() and esp_ota_end() calls.
+ *
+ * @return
+ *    - ESP_OK: OTA operation resumed successfully.
+ *    - ESP_ERR_INVALID_ARG: partition or out_handle arguments were NULL, partition doesn't point to an OTA app partition,
+ *      or image_offset is 0, not sector aligned, or beyond the image size.
+ *    - Other errors as for esp_ota_begin().
+ */
+esp_err_t esp_ota_resume(const esp_partition_t* partition, size_t image_size, size_t image_offset, esp_ota_handle_t* out_handle);
+
 /**
  * @brief   Write OTA update data to partition
  *
@@ -156,6 +187,20 @@ esp_err_t esp_ota_write_with_offset(esp_ota_handle_t handle, const void *data, s
  */
 esp_err_t esp_ota_end(esp_ota_handle_t handle);
 
+/**
+ * @brief Abort OTA update, free the handle and memory associated with it.
+ *
+ * Unlike esp_ota_end(), the image written so far is not validated. Use it to give up an update
+ * which failed, the partition is left with an incomplete image.
+ *
+ * @param handle  Handle obtained from esp_ota_begin().
+ *
+ * @return
+ *    - ESP_OK: Handle and its associated memory is freed successfully.
+ *    - ESP_ERR_NOT_FOUND: OTA handle was not found.
+ */
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+
 /**
  * @brief Configure OTA data for a new boot partition
  *
@@ -0,0 +1,73 @@
+#!/usr/bin/env python
+#
+# Makes an ESP32 app image of the loadable segments of an ELF file, the way
+# "esptool.py elf2image" does, for the host tests to have real app images
+# without the esptool submodule. Flash mapped segments are not aligned to
+# the MMU pages as they would be for booting.
+#
+# Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http:#www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+from __future__ import print_function, division
+import hashlib
+import struct
+import sys
+
+PT_LOAD = 1
+ESP_IMAGE_MAGIC = 0xE9
+ESP_CHECKSUM_MAGIC = 0xEF
+
+
+def load_segments(elf):
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        raise ValueError('Not a little endian ELF32 file')
+    entry, phoff = struct.unpack_from('<II', elf, 24)
+    phentsize, phnum = struct.unpack_from('<HH', elf, 42)
+    segments = []
+    for i in range(phnum):
+        p_type, p_offset, _, p_paddr, p_filesz = struct.unpack_from('<IIIII', elf, phoff + i * phentsize)
+        if p_type == PT_LOAD and p_filesz > 0:
+            data = elf[p_offset:p_offset + p_filesz]
+            data += b'\x00' * (-len(data) % 4)
+            segments.append((p_paddr, data))
+    return entry, segments
+
+
+def elf2image(elf):
+    entry, segments = load_segments(bytearray(elf))
+    # DIO, 40 MHz, 4 MB, then the extended header: chip ESP32, hash appended
+    image = bytearray(struct.pack('<BBBBI', ESP_IMAGE_MAGIC, len(segments), 2, 0x20, entry))
+    image += struct.pack('<BBBBHB8xB', 0xEE, 0, 0, 0, 0, 0, 1)
+    checksum = ESP_CHECKSUM_MAGIC
+    for addr, data in segments:
+        image += struct.pack('<II', addr, len(data)) + data
+        for byte in data:
+            checksum ^= byte
+    image += b'\x00' * (15 - len(image) % 16)
+    image.append(checksum)
+    image += hashlib.sha256(image).digest()
+    return image
+
+
+def main():
+    if len(sys.argv) != 3:
+        print('Usage: %s input.elf output.bin' % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+    with open(sys.argv[1], 'rb') as f:
+        image = elf2image(f.read())
+    with open(sys.argv[2], 'wb') as f:
+        f.write(image)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,434 @@
+#include "catch.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "esp_ota_ops.h"
+#include "esp_ota_delta.h"
+#include "mbedtls/sha256.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+const size_t PARTITION_SIZE = 0x100000;
+
+/* The source partition holds `source`, the target partition gets what esp_ota_write() writes */
+struct fake_flash {
+    esp_partition_t source_partition;
+    esp_partition_t target_partition;
+    bytes source;
+    bytes target;
+    size_t image_size;
+    int begin_calls;
+    int end_calls;
+    int abort_calls;
+    size_t max_read;
+    size_t max_write;
+    size_t fail_write_at;       /* esp_ota_write() fails once this much is written */
+} s_flash;
+
+bytes sha256(const bytes &data)
+{
+    bytes out(32);
+    mbedtls_sha256_ret(data.data(), data.size(), out.data(), 0);
+    return out;
+}
+
+void reset(const bytes &source)
+{
+    s_flash.source_partition = esp_partition_t();
+    s_flash.source_partition.type = ESP_PARTITION_TYPE_APP;
+    s_flash.source_partition.subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0;
+    s_flash.source_partition.address = 0x10000;
+    s_flash.source_partition.size = PARTITION_SIZE;
+    strcpy(s_flash.source_partition.label, "ota_0");
+    s_flash.target_partition = s_flash.source_partition;
+    s_flash.target_partition.subtype = ESP_PARTITION_SUBTYPE_APP_OTA_1;
+    s_flash.target_partition.address = 0x10000 + PARTITION_SIZE;
+    strcpy(s_flash.target_partition.label, "ota_1");
+    s_flash.source = source;
+    s_flash.target.clear();
+    s_flash.image_size = 0;
+    s_flash.begin_calls = s_flash.end_calls = s_flash.abort_calls = 0;
+    s_flash.max_read = s_flash.max_write = 0;
+    s_flash.fail_write_at = SIZE_MAX;
+}
+
+} // namespace
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    REQUIRE(partition == &s_flash.source_partition);
+    /* Only the image the patch was made from is read */
+    REQUIRE(src_offset + size <= s_flash.source.size());
+    memcpy(dst, s_flash.source.data() + src_offset, size);
+    s_flash.max_read = std::max(s_flash.max_read, size);
+    return ESP_OK;
+}
+
+/* As bootloader_common_get_sha256_of_partition() does for an app image with a hash appended */
+extern "C" esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    REQUIRE(partition == &s_flash.source_partition);
+    const bytes &image = s_flash.source;
+    if (image.size() < 24 || image[0] != 0xE9 || image[23] != 1) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    size_t pos = 24;
+    for (int i = 0; i < image[1]; i++) {
+        if (pos + 8 > image.size()) {
+            return ESP_ERR_IMAGE_INVALID;
+        }
+        uint32_t data_len;
+        memcpy(&data_len, &image[pos + 4], 4);
+        pos += 8 + data_len;
+    }
+    size_t image_len = (pos + 16) & ~15;
+    if (image_len + 32 > image.size() ||
+        sha256(bytes(image.begin(), image.begin() + image_len)) != bytes(image.begin() + image_len, image.begin() + image_len + 32)) {
+        return ESP_ERR_IMAGE_INVALID;
+    }
+    memcpy(sha_256, &image[image_len], 32);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    REQUIRE(partition == &s_flash.target_partition);
+    s_flash.begin_calls++;
+    s_flash.image_size = image_size;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    REQUIRE(handle == 1);
+    REQUIRE(s_flash.target.size() + size <= s_flash.image_size);
+    if (s_flash.target.size() + size > s_flash.fail_write_at) {
+        return ESP_ERR_FLASH_OP_FAIL;
+    }
+    s_flash.target.insert(s_flash.target.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    s_flash.max_write = std::max(s_flash.max_write, size);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    REQUIRE(handle == 1);
+    s_flash.end_calls++;
+    return s_flash.target.empty() || s_flash.target[0] != 0xE9 ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    REQUIRE(handle == 1);
+    s_flash.abort_calls++;
+    return ESP_OK;
+}
+
+namespace {
+
+bytes read_file(const std::string &path)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    REQUIRE(f != nullptr);
+    bytes data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return data;
+}
+
+void write_file(const std::string &path, const bytes &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    REQUIRE(f != nullptr);
+    REQUIRE(fwrite(data.data(), 1, data.size(), f) == data.size());
+    fclose(f);
+}
+
+/* App images made by "make test" of the ELF files of real builds */
+bytes image(const std::string &name)
+{
+    return read_file(std::string(BUILD_DIR "/images/") + name + ".bin");
+}
+
+/* Runs the patch generator */
+bytes make_patch(const bytes &source, const bytes &target)
+{
+    const std::string dir = BUILD_DIR "/";
+    write_file(dir + "source.bin", source);
+    write_file(dir + "target.bin", target);
+    std::string cmd = PYTHON " ../gen_ota_delta.py -q " + dir + "source.bin " + dir + "target.bin " + dir + "patch.bin";
+    REQUIRE(system(cmd.c_str()) == 0);
+    return read_file(dir + "patch.bin");
+}
+
+/* Applies the patch to the source partition, written in pieces of chunk bytes */
+esp_err_t apply(const bytes &patch, size_t chunk = 4096)
+{
+    esp_ota_delta_handle_t h;
+    REQUIRE(esp_ota_delta_begin(&s_flash.source_partition, &s_flash.target_partition, &h) == ESP_OK);
+    for (size_t pos = 0; pos < patch.size(); pos += chunk) {
+        esp_err_t err = esp_ota_delta_write(h, patch.data() + pos, std::min(chunk, patch.size() - pos));
+        if (err != ESP_OK) {
+            /* The handle stays failed */
+            CHECK(esp_ota_delta_write(h, patch.data(), 1) == err);
+            CHECK(esp_ota_delta_abort(h) == ESP_OK);
+            return err;
+        }
+    }
+    CHECK(esp_ota_delta_get_image_len_written(h) <= esp_ota_delta_get_image_size(h));
+    return esp_ota_delta_end(h);
+}
+
+/* Offsets of the segment headers of an app image */
+std::vector<size_t> segments(const bytes &image)
+{
+    std::vector<size_t> offsets;
+    size_t pos = 24;
+    for (int i = 0; i < image[1]; i++) {
+        offsets.push_back(pos);
+        uint32_t data_len;
+        memcpy(&data_len, &image[pos + 4], 4);
+        pos += 8 + data_len;
+    }
+    offsets.push_back(pos);
+    return offsets;
+}
+
+/* Appends the checksum and the hash to the segments, as esptool.py does */
+void seal(bytes &image)
+{
+    std::vector<size_t> offsets = segments(image);
+    uint8_t checksum = 0xEF;
+    for (size_t i = 0; i + 1 < offsets.size(); i++) {
+        for (size_t pos = offsets[i] + 8; pos < offsets[i + 1]; pos++) {
+            checksum ^= image[pos];
+        }
+    }
+    image.resize(offsets.back());
+    image.resize((image.size() + 16) & ~15);
+    image.back() = checksum;
+    bytes hash = sha256(image);
+    image.insert(image.end(), hash.begin(), hash.end());
+}
+
+/* A new release of the app: another version string, new code in the middle of the
+ * last segment and bytes changed all over it, as addresses which moved */
+bytes new_release(const bytes &base)
+{
+    bytes target = base;
+    const char *ver = "v4.1-dev";
+    auto it = std::search(target.begin(), target.end(), ver, ver + strlen(ver));
+    REQUIRE(it != target.end());
+    memcpy(&*it, "v4.2-rel", 8);
+    uint32_t seed = 1;
+    auto next = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    };
+
+    std::vector<size_t> offsets = segments(target);
+    size_t header = offsets[offsets.size() - 2];
+    uint32_t data_len;
+    memcpy(&data_len, &target[header + 4], 4);
+    bytes code(300);
+    for (auto &b : code) {
+        b = next();
+    }
+    target.insert(target.begin() + header + 8 + (data_len / 2 & ~3), code.begin(), code.end());
+    data_len += code.size();
+    memcpy(&target[header + 4], &data_len, 4);
+    for (int i = 0; i < 500; i++) {
+        target[header + 8 + next() % data_len] = next();
+    }
+    seal(target);
+    return target;
+}
+
+} // namespace
+
+TEST_CASE("patches between real builds make the new image", "[ota_delta]")
+{
+    const char *pairs[][2] = {
+        {"sysview", "sysview_heap_log"},
+        {"sysview_heap_log", "sysview"},
+        /* Built by different IDF versions */
+        {"logtrace", "coredump"},
+        {"coredump", "sysview"},
+        {"sysview", "sysview"},
+    };
+    for (auto &pair : pairs) {
+        CAPTURE(pair[0]);
+        CAPTURE(pair[1]);
+        bytes source = image(pair[0]);
+        bytes target = image(pair[1]);
+        bytes patch = make_patch(source, target);
+        CHECK(patch.size() < target.size());
+
+        for (size_t chunk : {(size_t)1, (size_t)7, (size_t)1000, (size_t)4096, patch.size()}) {
+            CAPTURE(chunk);
+            reset(source);
+            CHECK(apply(patch, chunk) == ESP_OK);
+            CHECK(s_flash.begin_calls == 1);
+            CHECK(s_flash.image_size == target.size());
+            CHECK(s_flash.end_calls == 1);
+            CHECK(s_flash.abort_calls == 0);
+            CHECK(s_flash.target == target);
+            /* Bounded buffers, whatever the size of the images */
+            CHECK(s_flash.max_read <= 1024);
+            CHECK(s_flash.max_write <= 1024);
+        }
+    }
+}
+
+TEST_CASE("a small change makes a small patch", "[ota_delta]")
+{
+    bytes source = image("sysview_heap_log");
+    bytes target = new_release(source);
+    bytes patch = make_patch(source, target);
+    CHECK(patch.size() < target.size() / 20);
+
+    reset(source);
+    CHECK(apply(patch, 1500) == ESP_OK);
+    CHECK(s_flash.target == target);
+
+    /* And the other way round, the update is taken back */
+    patch = make_patch(target, source);
+    CHECK(patch.size() < source.size() / 20);
+    reset(target);
+    CHECK(apply(patch, 1500) == ESP_OK);
+    CHECK(s_flash.target == source);
+}
+
+TEST_CASE("a patch for another image is rejected before writing", "[ota_delta]")
+{
+    bytes patch = make_patch(image("sysview"), image("sysview_heap_log"));
+
+    reset(image("logtrace"));
+    CHECK(apply(patch) == ESP_ERR_OTA_DELTA_SOURCE_MISMATCH);
+    CHECK(s_flash.begin_calls == 0);
+    CHECK(s_flash.target.empty());
+
+    /* Not a valid image in the source partition */
+    bytes source = image("sysview");
+    source[100] ^= 1;
+    reset(source);
+    CHECK(apply(patch) == ESP_ERR_IMAGE_INVALID);
+    CHECK(s_flash.begin_calls == 0);
+}
+
+TEST_CASE("invalid patches are rejected", "[ota_delta]")
+{
+    bytes source = image("sysview_heap_log");
+    bytes target = new_release(source);
+    bytes patch = make_patch(source, target);
+
+    bytes bad_magic = patch;
+    bad_magic[0] = 'X';
+    reset(source);
+    CHECK(apply(bad_magic) == ESP_ERR_OTA_DELTA_INVALID);
+
+    bytes bad_version = patch;
+    bad_version[4] = 2;
+    reset(source);
+    CHECK(apply(bad_version) == ESP_ERR_OTA_DELTA_INVALID);
+
+    /* Target size beyond the partition */
+    bytes too_big = patch;
+    too_big[14] = 0x10;
+    reset(source);
+    CHECK(apply(too_big) == ESP_ERR_OTA_DELTA_INVALID);
+    CHECK(s_flash.begin_calls == 0);
+
+    bytes trailing = patch;
+    trailing.push_back(0);
+    reset(source);
+    CHECK(apply(trailing) == ESP_ERR_OTA_DELTA_INVALID);
+    CHECK(s_flash.end_calls == 0);
+
+    /* Another target hash */
+    bytes bad_hash = patch;
+    bad_hash[50] ^= 1;
+    reset(source);
+    CHECK(apply(bad_hash) == ESP_ERR_OTA_VALIDATE_FAILED);
+    CHECK(s_flash.end_calls == 0);
+    CHECK(s_flash.abort_calls == 1);
+
+    for (size_t cut : {(size_t)10, (size_t)80, (size_t)81, patch.size() / 2, patch.size() - 1}) {
+        CAPTURE(cut);
+        reset(source);
+        CHECK(apply(bytes(patch.begin(), patch.begin() + cut)) == ESP_ERR_INVALID_STATE);
+        CHECK(s_flash.end_calls == 0);
+    }
+}
+
+TEST_CASE("a corrupt patch never makes an image", "[ota_delta]")
+{
+    bytes source = image("sysview_heap_log");
+    bytes target = new_release(source);
+    bytes patch = make_patch(source, target);
+
+    uint32_t seed = 7;
+    for (int i = 0; i < 300; i++) {
+        seed = seed * 1103515245 + 12345;
+        bytes corrupt = patch;
+        size_t pos = 80 + (seed >> 8) % (patch.size() - 80);
+        corrupt[pos] ^= 1 << (seed & 7);
+        CAPTURE(pos);
+        reset(source);
+        /* Reads stay in the source image, and no other image than the target passes */
+        if (apply(corrupt, 512) == ESP_OK) {
+            CHECK(s_flash.target == target);
+        } else {
+            CHECK(s_flash.end_calls == 0);
+        }
+    }
+}
+
+TEST_CASE("a failed flash write fails the update", "[ota_delta]")
+{
+    bytes source = image("sysview");
+    bytes patch = make_patch(source, image("sysview_heap_log"));
+
+    reset(source);
+    s_flash.fail_write_at = 50000;
+    CHECK(apply(patch) == ESP_ERR_FLASH_OP_FAIL);
+    CHECK(s_flash.abort_calls == 1);
+    CHECK(s_flash.end_calls == 0);
+}
+
+TEST_CASE("delta updates check their arguments", "[ota_delta]")
+{
+    reset(image("sysview"));
+    esp_ota_delta_handle_t h;
+    CHECK(esp_ota_delta_begin(nullptr, &s_flash.target_partition, &h) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_begin(&s_flash.source_partition, nullptr, &h) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_begin(&s_flash.source_partition, &s_flash.target_partition, nullptr) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_begin(&s_flash.source_partition, &s_flash.source_partition, &h) == ESP_ERR_INVALID_ARG);
+    esp_partition_t data_partition = s_flash.target_partition;
+    data_partition.type = ESP_PARTITION_TYPE_DATA;
+    CHECK(esp_ota_delta_begin(&s_flash.source_partition, &data_partition, &h) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_write(nullptr, "", 0) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_end(nullptr) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_abort(nullptr) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_ota_delta_get_image_size(nullptr) == 0);
+
+    /* Aborted before the header, nothing was started */
+    REQUIRE(esp_ota_delta_begin(&s_flash.source_partition, &s_flash.target_partition, &h) == ESP_OK);
+    CHECK(esp_ota_delta_write(h, "ESPD", 4) == ESP_OK);
+    CHECK(esp_ota_delta_get_image_size(h) == 0);
+    CHECK(esp_ota_delta_abort(h) == ESP_OK);
+    CHECK(s_flash.begin_calls == 0);
+    CHECK(s_flash.abort_calls == 0);
+}
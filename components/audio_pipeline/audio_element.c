@@ -63,8 +63,20 @@ typedef struct audio_multi_rb {
 typedef enum {
     IO_TYPE_RB = 1, /* I/O through ringbuffer */
     IO_TYPE_CB,     /* I/O through callback */
+    IO_TYPE_FUSED,  /* I/O through the neighbour element running in the same task */
+    IO_TYPE_BQ,     /* I/O through blocks of a buffer pool */
 } io_type_t;
 
+/**
+ *  Data pushed by the previous element of a fused chain, valid during one audio_element_output call
+ */
+typedef struct audio_fused_input {
+    char                        *buf;
+    int                         len;
+    int                         pos;
+    bool                        done;
+} audio_fused_input_t;
+
 typedef enum {
     EVENTS_TYPE_Q = 1,  /* Events through MessageQueue */
     EVENTS_TYPE_CB,     /* Events through Callback function */
@@ -81,11 +93,13 @@ struct audio_element {
     union {
         ringbuf_handle_t        input_rb;
         io_callback_t           read_cb;
+        buf_queue_handle_t      input_bq;
     } in;
     io_type_t                   write_type;
     union {
         ringbuf_handle_t        output_rb;
         io_callback_t           write_cb;
+        buf_queue_handle_t      output_bq;
     } out;
 
     audio_multi_rb_t            multi_in;
@@ -101,6 +115,7 @@ struct audio_element {
 
     int                         buf_size;
     char                        *buf;
+    char                        *out_buf;   /* Output block of audio_element_acquire_output_buf without buffer queue */
 
     char                        *tag;
     int                         task_stack;
@@ -123,6 +138,12 @@ struct audio_element {
     volatile bool               is_running;
     volatile bool               task_run;
     volatile bool               stopping;
+
+    /* Fused chain, processed by the task of fused_head */
+    audio_element_handle_t      fused_head;
+    audio_element_handle_t      fused_prev;
+    audio_element_handle_t      fused_next;
+    audio_fused_input_t         fused_in;
 };
 
 const static int STOPPED_BIT = BIT0;
@@ -147,7 +168,16 @@ static esp_err_t audio_element_cmd_send(audio_element_handle_t el, audio_element
         .cmd = cmd,
     };
     ESP_LOGV(TAG, "[%s]evt internal cmd = %d", el->tag, msg.cmd);
-    return audio_event_iface_cmd(el->iface_event, &msg);
+    esp_err_t ret = audio_event_iface_cmd(el->iface_event, &msg);
+    if (ret == ESP_OK && el->fused_head) {
+        // Commands of fused elements are dispatched by the task of the chain head, wake it up unless it has work queued
+        audio_event_iface_handle_t head_event = el->fused_head->iface_event;
+        if (uxQueueMessagesWaiting(audio_event_iface_get_msg_queue_handle(head_event)) == 0) {
+            msg.cmd = AEL_MSG_CMD_NONE;
+            audio_event_iface_cmd(head_event, &msg);
+        }
+    }
+    return ret;
 }
 
 static esp_err_t audio_element_msg_sendout(audio_element_handle_t el, audio_event_iface_msg_t *msg)
@@ -199,6 +229,20 @@ esp_err_t audio_element_process_deinit(audio_element_handle_t el)
     return ESP_OK;
 }
 
+static void audio_element_fused_release(audio_element_handle_t el)
+{
+    audio_element_process_deinit(el);
+    audio_free(el->buf);
+    el->buf = NULL;
+    audio_free(el->out_buf);
+    el->out_buf = NULL;
+    el->stopping = false;
+    el->is_running = false;
+    el->task_run = false;
+    ESP_LOGD(TAG, "[%s-%p] fused el released", el->tag, el);
+    xEventGroupSetBits(el->state_event, TASK_DESTROYED_BIT);
+}
+
 static esp_err_t audio_element_on_cmd(audio_event_iface_msg_t *msg, void *context)
 {
     audio_element_handle_t el = (audio_element_handle_t)context;
@@ -207,6 +251,10 @@ static esp_err_t audio_element_on_cmd(audio_event_iface_msg_t *msg, void *contex
         ESP_LOGE(TAG, "[%s] Invalid event type, this event should be ELEMENT type", el->tag);
         return ESP_FAIL;
     }
+    if (msg->source != el) {
+        // Woken up by an element fused after this one, see audio_element_fused_dispatch
+        return ESP_OK;
+    }
     //process an event
     switch (msg->cmd) {
         case AEL_MSG_CMD_ERROR:
@@ -292,13 +340,9 @@ static esp_err_t audio_element_on_cmd(audio_event_iface_msg_t *msg, void *contex
     return ESP_OK;
 }
 
-static esp_err_t audio_element_process_running(audio_element_handle_t el)
+static int audio_element_process_data(audio_element_handle_t el)
 {
-    int process_len = -1;
-    if (el->state < AEL_STATE_RUNNING || !el->is_running) {
-        return ESP_ERR_INVALID_STATE;
-    }
-    process_len = el->process(el, el->buf, el->buf_size);
+    int process_len = el->process(el, el->buf, el->buf_size);
     if (process_len <= 0) {
         switch (process_len) {
             case AEL_IO_ABORT:
@@ -311,7 +355,7 @@ static esp_err_t audio_element_process_running(audio_element_handle_t el)
                 if (audio_element_get_state(el) == AEL_STATE_INIT) {
                     el->is_running = false;
                     audio_element_cmd_send(el, AEL_MSG_CMD_RESUME);
-                    return ESP_OK;
+                    return process_len;
                 }
                 audio_element_set_ringbuf_done(el);
                 audio_element_cmd_send(el, AEL_MSG_CMD_FINISH);
@@ -334,29 +378,105 @@ static esp_err_t audio_element_process_running(audio_element_handle_t el)
                 break;
         }
     }
+    return process_len;
+}
+
+static esp_err_t audio_element_process_running(audio_element_handle_t el)
+{
+    if (el->state < AEL_STATE_RUNNING || !el->is_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    audio_element_process_data(el);
     return ESP_OK;
 }
 
-audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
+static int audio_element_fused_read(audio_element_handle_t el, char *buffer, int wanted_size)
 {
-    int in_len = 0;
-    if (el->read_type == IO_TYPE_CB) {
-        if (el->in.read_cb.cb == NULL) {
-            ESP_LOGE(TAG, "[%s] Read IO Type callback but callback not set", el->tag);
-            return ESP_FAIL;
+    int avail = el->fused_in.len - el->fused_in.pos;
+    if (avail <= 0) {
+        return el->fused_in.done ? AEL_IO_DONE : AEL_IO_TIMEOUT;
+    }
+    int read_len = avail < wanted_size ? avail : wanted_size;
+    memcpy(buffer, el->fused_in.buf + el->fused_in.pos, read_len);
+    el->fused_in.pos += read_len;
+    return read_len;
+}
+
+static int audio_element_fused_write(audio_element_handle_t el, char *buffer, int write_size)
+{
+    audio_element_handle_t next = el->fused_next;
+    next->fused_in.buf = buffer;
+    next->fused_in.len = write_size;
+    next->fused_in.pos = 0;
+    next->fused_in.done = false;
+    // Run the next element until it has consumed the whole buffer, it pushes its own output further down the chain
+    while (next->fused_in.pos < write_size) {
+        if (next->state < AEL_STATE_RUNNING || !next->is_running) {
+            break;
         }
-        in_len = el->in.read_cb.cb(el, buffer, wanted_size, el->input_wait_time,
-                                   el->in.read_cb.ctx);
-    } else if (el->read_type == IO_TYPE_RB) {
-        if (el->in.input_rb == NULL) {
-            ESP_LOGE(TAG, "[%s] Read IO type ringbuf but ringbuf not set", el->tag);
-            return ESP_FAIL;
+        if (audio_element_process_data(next) <= 0) {
+            break;
+        }
+    }
+    int written = next->fused_in.pos;
+    next->fused_in.buf = NULL;
+    next->fused_in.len = 0;
+    next->fused_in.pos = 0;
+    if (written > 0) {
+        return written;
+    }
+    // Nothing consumed: report what a ringbuffer would to a writer of a stalled reader
+    switch (next->state) {
+        case AEL_STATE_INIT:
+        case AEL_STATE_PAUSED:
+            return AEL_IO_TIMEOUT;
+        case AEL_STATE_FINISHED:
+            return AEL_IO_DONE;
+        default:
+            return AEL_IO_ABORT;
+    }
+}
+
+static void audio_element_fused_done(audio_element_handle_t el)
+{
+    audio_element_handle_t next = el->fused_next;
+    next->fused_in.done = true;
+    // Let the next element flush until its input reports AEL_IO_DONE, as on a ringbuffer marked done
+    while (next->state == AEL_STATE_RUNNING && next->is_running) {
+        if (audio_element_process_data(next) <= 0) {
+            break;
+        }
+    }
+}
+
+static void audio_element_fused_dispatch(audio_element_handle_t el)
+{
+    for (audio_element_handle_t next = el->fused_next; next; next = next->fused_next) {
+        QueueHandle_t cmd_queue = audio_event_iface_get_msg_queue_handle(next->iface_event);
+        while (next->task_run && uxQueueMessagesWaiting(cmd_queue)) {
+            // The commands set the waiting time for a task of their own, this one must not block
+            audio_event_iface_set_cmd_waiting_timeout(next->iface_event, 0);
+            if (audio_event_iface_waiting_cmd_msg(next->iface_event) != ESP_OK) {
+                if (next->task_run == false) {
+                    audio_element_fused_release(next);
+                } else {
+                    xEventGroupSetBits(next->state_event, STOPPED_BIT);
+                }
+            }
         }
-        in_len = rb_read(el->in.input_rb, buffer, wanted_size, el->input_wait_time);
-    } else {
-        ESP_LOGE(TAG, "[%s] Invalid read IO type", el->tag);
-        return ESP_FAIL;
     }
+}
+
+static void audio_element_fused_update_head(audio_element_handle_t el)
+{
+    for (; el; el = el->fused_next) {
+        audio_element_handle_t prev = el->fused_prev;
+        el->fused_head = prev ? (prev->fused_head ? prev->fused_head : prev) : NULL;
+    }
+}
+
+static int audio_element_input_result(audio_element_handle_t el, int in_len)
+{
     if (in_len <= 0) {
         switch (in_len) {
             case AEL_IO_ABORT:
@@ -385,22 +505,8 @@ audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer,
     return in_len;
 }
 
-audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
+static int audio_element_output_result(audio_element_handle_t el, int output_len)
 {
-    int output_len = 0;
-    if (el->write_type == IO_TYPE_CB) {
-        if (el->out.write_cb.cb && write_size) {
-            output_len = el->out.write_cb.cb(el, buffer, write_size, el->output_wait_time,
-                                             el->out.write_cb.ctx);
-        }
-    } else if (el->write_type == IO_TYPE_RB) {
-        if (el->out.output_rb && write_size) {
-            output_len = rb_write(el->out.output_rb, buffer, write_size, el->output_wait_time);
-            if ((rb_bytes_filled(el->out.output_rb) > el->out_buf_size_expect) || (output_len < 0)) {
-                xEventGroupSetBits(el->state_event, BUFFER_REACH_LEVEL_BIT);
-            }
-        }
-    }
     if (output_len <= 0) {
         switch (output_len) {
             case AEL_IO_ABORT:
@@ -429,6 +535,136 @@ audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer
     }
     return output_len;
 }
+
+audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer, int wanted_size)
+{
+    int in_len = 0;
+    if (el->read_type == IO_TYPE_CB) {
+        if (el->in.read_cb.cb == NULL) {
+            ESP_LOGE(TAG, "[%s] Read IO Type callback but callback not set", el->tag);
+            return ESP_FAIL;
+        }
+        in_len = el->in.read_cb.cb(el, buffer, wanted_size, el->input_wait_time,
+                                   el->in.read_cb.ctx);
+    } else if (el->read_type == IO_TYPE_RB) {
+        if (el->in.input_rb == NULL) {
+            ESP_LOGE(TAG, "[%s] Read IO type ringbuf but ringbuf not set", el->tag);
+            return ESP_FAIL;
+        }
+        in_len = rb_read(el->in.input_rb, buffer, wanted_size, el->input_wait_time);
+    } else if (el->read_type == IO_TYPE_FUSED) {
+        in_len = audio_element_fused_read(el, buffer, wanted_size);
+    } else if (el->read_type == IO_TYPE_BQ) {
+        in_len = buf_queue_read(el->in.input_bq, buffer, wanted_size, el->input_wait_time);
+    } else {
+        ESP_LOGE(TAG, "[%s] Invalid read IO type", el->tag);
+        return ESP_FAIL;
+    }
+    return audio_element_input_result(el, in_len);
+}
+
+audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size)
+{
+    int output_len = 0;
+    if (el->write_type == IO_TYPE_CB) {
+        if (el->out.write_cb.cb && write_size) {
+            output_len = el->out.write_cb.cb(el, buffer, write_size, el->output_wait_time,
+                                             el->out.write_cb.ctx);
+        }
+    } else if (el->write_type == IO_TYPE_RB) {
+        if (el->out.output_rb && write_size) {
+            output_len = rb_write(el->out.output_rb, buffer, write_size, el->output_wait_time);
+            if ((rb_bytes_filled(el->out.output_rb) > el->out_buf_size_expect) || (output_len < 0)) {
+                xEventGroupSetBits(el->state_event, BUFFER_REACH_LEVEL_BIT);
+            }
+        }
+    } else if (el->write_type == IO_TYPE_FUSED) {
+        if (write_size) {
+            output_len = audio_element_fused_write(el, buffer, write_size);
+        }
+    } else if (el->write_type == IO_TYPE_BQ) {
+        if (el->out.output_bq && write_size) {
+            output_len = buf_queue_write(el->out.output_bq, buffer, write_size, el->output_wait_time);
+        }
+    }
+    return audio_element_output_result(el, output_len);
+}
+
+static void audio_element_free_input_block(audio_element_handle_t el, char *buf)
+{
+    if (el->read_type == IO_TYPE_BQ && el->in.input_bq) {
+        buf_pool_handle_t pool = buf_queue_get_pool(el->in.input_bq);
+        if (buf_pool_owns(pool, buf)) {
+            buf_pool_free(pool, buf);
+        }
+    }
+}
+
+audio_element_err_t audio_element_acquire_input_buf(audio_element_handle_t el, char **buf)
+{
+    if (el->read_type != IO_TYPE_BQ) {
+        // Copy adapter for the other I/O types
+        *buf = el->buf;
+        return audio_element_input(el, el->buf, el->buf_size);
+    }
+    if (el->in.input_bq == NULL) {
+        ESP_LOGE(TAG, "[%s] Read IO type buffer queue but queue not set", el->tag);
+        return ESP_FAIL;
+    }
+    int in_len = buf_queue_pop(el->in.input_bq, buf, el->input_wait_time);
+    return audio_element_input_result(el, in_len);
+}
+
+esp_err_t audio_element_release_input_buf(audio_element_handle_t el, char *buf)
+{
+    AUDIO_NULL_CHECK(TAG, el, return ESP_FAIL);
+    audio_element_free_input_block(el, buf);
+    return ESP_OK;
+}
+
+audio_element_err_t audio_element_acquire_output_buf(audio_element_handle_t el, char **buf)
+{
+    if (el->write_type == IO_TYPE_BQ && el->out.output_bq) {
+        buf_pool_handle_t pool = buf_queue_get_pool(el->out.output_bq);
+        *buf = buf_pool_alloc(pool);
+        if (*buf == NULL) {
+            ESP_LOGE(TAG, "[%s] No free block in the buffer pool", el->tag);
+            return audio_element_output_result(el, AEL_IO_FAIL);
+        }
+        return buf_pool_get_block_size(pool);
+    }
+    // Copy adapter, the data is written out by audio_element_commit_output_buf
+    if (el->out_buf == NULL) {
+        el->out_buf = audio_calloc(1, el->buf_size);
+        AUDIO_MEM_CHECK(TAG, el->out_buf, return audio_element_output_result(el, AEL_IO_FAIL));
+    }
+    *buf = el->out_buf;
+    return el->buf_size;
+}
+
+audio_element_err_t audio_element_commit_output_buf(audio_element_handle_t el, char *buf, int len)
+{
+    int output_len = 0;
+    if (el->write_type != IO_TYPE_BQ || el->out.output_bq == NULL) {
+        output_len = audio_element_output(el, buf, len);
+        audio_element_free_input_block(el, buf);
+        return output_len;
+    }
+    buf_pool_handle_t pool = buf_queue_get_pool(el->out.output_bq);
+    if (!buf_pool_owns(pool, buf)) {
+        output_len = len ? buf_queue_write(el->out.output_bq, buf, len, el->output_wait_time) : 0;
+    } else if (len) {
+        // Hand over the block, forwarded input blocks come from the same pool
+        output_len = buf_queue_push(el->out.output_bq, buf, len, el->output_wait_time);
+        if (output_len < 0) {
+            buf_pool_free(pool, buf);
+        }
+    } else {
+        buf_pool_free(pool, buf);
+    }
+    return audio_element_output_result(el, output_len);
+}
+
 void audio_element_task(void *pv)
 {
     audio_element_handle_t el = (audio_element_handle_t)pv;
@@ -455,6 +691,9 @@ void audio_element_task(void *pv)
                 break;
             }
         }
+        if (el->fused_next) {
+            audio_element_fused_dispatch(el);
+        }
         if (audio_element_process_running(el) != ESP_OK) {
             // continue;
         }
@@ -465,7 +704,14 @@ void audio_element_task(void *pv)
         el->close(el);
     }
     el->is_open = false;
+    for (audio_element_handle_t next = el->fused_next; next; next = next->fused_next) {
+        if (next->task_run) {
+            audio_element_fused_release(next);
+        }
+    }
     audio_free(el->buf);
+    audio_free(el->out_buf);
+    el->out_buf = NULL;
     el->stopping = false;
     el->task_run = false;
     ESP_LOGD(TAG, "[%s-%p] el task deleted,%d", el->tag, el, uxTaskGetStackHighWaterMark(NULL));
@@ -661,6 +907,9 @@ esp_err_t audio_element_change_cmd(audio_element_handle_t el, audio_element_msg_
 
 esp_err_t audio_element_reset_input_ringbuf(audio_element_handle_t el)
 {
+    if (el->read_type == IO_TYPE_BQ) {
+        return buf_queue_reset(el->in.input_bq);
+    }
     if (el->read_type != IO_TYPE_RB) {
         return ESP_FAIL;
     }
@@ -678,6 +927,9 @@ esp_err_t audio_element_reset_input_ringbuf(audio_element_handle_t el)
 
 esp_err_t audio_element_reset_output_ringbuf(audio_element_handle_t el)
 {
+    if (el->write_type == IO_TYPE_BQ) {
+        return buf_queue_reset(el->out.output_bq);
+    }
     if (el->write_type != IO_TYPE_RB) {
         return ESP_FAIL;
     }
@@ -695,6 +947,9 @@ esp_err_t audio_element_reset_output_ringbuf(audio_element_handle_t el)
 
 esp_err_t audio_element_abort_input_ringbuf(audio_element_handle_t el)
 {
+    if (el->read_type == IO_TYPE_BQ) {
+        return buf_queue_abort(el->in.input_bq);
+    }
     if (el->read_type != IO_TYPE_RB) {
         return ESP_FAIL;
     }
@@ -712,6 +967,9 @@ esp_err_t audio_element_abort_input_ringbuf(audio_element_handle_t el)
 
 esp_err_t audio_element_abort_output_ringbuf(audio_element_handle_t el)
 {
+    if (el->write_type == IO_TYPE_BQ) {
+        return buf_queue_abort(el->out.output_bq);
+    }
     if (el->write_type != IO_TYPE_RB) {
         return ESP_FAIL;
     }
@@ -733,6 +991,12 @@ esp_err_t audio_element_set_ringbuf_done(audio_element_handle_t el)
     if (NULL == el) {
         return ESP_FAIL;
     }
+    if (el->write_type == IO_TYPE_FUSED) {
+        audio_element_fused_done(el);
+    }
+    if (el->out.output_bq && el->write_type == IO_TYPE_BQ) {
+        ret |= buf_queue_done_write(el->out.output_bq);
+    }
     if (el->out.output_rb && el->write_type == IO_TYPE_RB) {
         ret |= rb_done_write(el->out.output_rb);
         for (int i = 0; i < el->multi_out.max_rb_num; ++i) {
@@ -784,6 +1048,48 @@ ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el)
     }
 }
 
+esp_err_t audio_element_set_input_buf_queue(audio_element_handle_t el, buf_queue_handle_t bq)
+{
+    if (bq) {
+        el->in.input_bq = bq;
+        el->read_type = IO_TYPE_BQ;
+    } else if (el->read_type == IO_TYPE_BQ) {
+        el->in.input_rb = NULL;
+        el->read_type = IO_TYPE_RB;
+    }
+    return ESP_OK;
+}
+
+buf_queue_handle_t audio_element_get_input_buf_queue(audio_element_handle_t el)
+{
+    if (el->read_type == IO_TYPE_BQ) {
+        return el->in.input_bq;
+    } else {
+        return NULL;
+    }
+}
+
+esp_err_t audio_element_set_output_buf_queue(audio_element_handle_t el, buf_queue_handle_t bq)
+{
+    if (bq) {
+        el->out.output_bq = bq;
+        el->write_type = IO_TYPE_BQ;
+    } else if (el->write_type == IO_TYPE_BQ) {
+        el->out.output_rb = NULL;
+        el->write_type = IO_TYPE_RB;
+    }
+    return ESP_OK;
+}
+
+buf_queue_handle_t audio_element_get_output_buf_queue(audio_element_handle_t el)
+{
+    if (el->write_type == IO_TYPE_BQ) {
+        return el->out.output_bq;
+    } else {
+        return NULL;
+    }
+}
+
 esp_err_t audio_element_set_input_timeout(audio_element_handle_t el, TickType_t timeout)
 {
     if (el) {
@@ -1004,6 +1310,9 @@ esp_err_t audio_element_deinit(audio_element_handle_t el)
     if (el->report_info) {
         audio_free(el->report_info);
     }
+    if (el->out_buf) {
+        audio_free(el->out_buf);
+    }
     if (el->audio_thread) {
         audio_thread_cleanup(&el->audio_thread);
     }
@@ -1023,9 +1332,31 @@ esp_err_t audio_element_run(audio_element_handle_t el)
     snprintf(task_name, 32, "el-%s", el->tag);
     audio_event_iface_discard(el->iface_event);
     xEventGroupClearBits(el->state_event, TASK_CREATED_BIT);
+    if (el->fused_head) {
+        // Processed in the task of the chain head, only the element buffer is needed
+        if (el->buf_size > 0) {
+            el->buf = audio_calloc(1, el->buf_size);
+            AUDIO_MEM_CHECK(TAG, el->buf, return ESP_ERR_NO_MEM);
+        }
+        audio_element_force_set_state(el, AEL_STATE_INIT);
+        xEventGroupClearBits(el->state_event, STOPPED_BIT);
+        el->task_run = true;
+        ESP_LOGI(TAG, "[%s-%p] Element fused into [%s]", el->tag, el, el->fused_head->tag);
+        return ESP_OK;
+    }
     if (el->task_stack > 0) {
-        ret = audio_thread_create(&el->audio_thread, el->tag, audio_element_task, el, el->task_stack,
-                                  el->task_prio, el->stack_in_ext, el->task_core);
+        // Fused elements run nested in this task, it gets the stack of the whole chain
+        int task_stack = el->task_stack;
+        bool stack_in_ext = el->stack_in_ext;
+        for (audio_element_handle_t next = el->fused_next; next; next = next->fused_next) {
+            task_stack += next->task_stack;
+            stack_in_ext = stack_in_ext && next->stack_in_ext;
+        }
+        if (el->fused_next) {
+            ESP_LOGD(TAG, "[%s] Task stack of the fused chain: %d", el->tag, task_stack);
+        }
+        ret = audio_thread_create(&el->audio_thread, el->tag, audio_element_task, el, task_stack,
+                                  el->task_prio, stack_in_ext, el->task_core);
         if (ret == ESP_FAIL) {
             audio_element_force_set_state(el, AEL_STATE_ERROR);
             audio_element_report_status(el, AEL_STATUS_ERROR_OPEN);
@@ -1060,6 +1391,10 @@ esp_err_t audio_element_terminate(audio_element_handle_t el)
         return ESP_OK;
     }
     xEventGroupClearBits(el->state_event, TASK_DESTROYED_BIT);
+    if (el->fused_head && el->fused_head->task_run == false) {
+        audio_element_fused_release(el);
+        return ESP_OK;
+    }
     if (audio_element_cmd_send(el, AEL_MSG_CMD_DESTROY) != ESP_OK) {
         ESP_LOGE(TAG, "[%s] Element destroy CMD failed", el->tag);
         return ESP_FAIL;
@@ -1110,6 +1445,11 @@ esp_err_t audio_element_resume(audio_element_handle_t el, float wait_for_rb_thre
         ESP_LOGW(TAG, "[%s] Element has not create when AUDIO_ELEMENT_RESUME", el->tag);
         return ESP_FAIL;
     }
+    if (el->fused_next && audio_element_resume(el->fused_next, 0, timeout) != ESP_OK) {
+        // Data is pushed to the fused elements as soon as this one runs, they must be running first
+        ESP_LOGW(TAG, "[%s] RESUME: fused element [%s] failed", el->tag, el->fused_next->tag);
+        return ESP_FAIL;
+    }
     if (el->state == AEL_STATE_RUNNING) {
         audio_element_report_status(el, AEL_STATUS_STATE_RUNNING);
         ESP_LOGD(TAG, "[%s] RESUME: Element is already running, state:%d, task_run:%d, is_running:%d",
@@ -1281,3 +1621,53 @@ bool audio_element_is_stopping(audio_element_handle_t el)
     }
     return false;
 }
+
+esp_err_t audio_element_set_fused_next(audio_element_handle_t el, audio_element_handle_t next)
+{
+    AUDIO_NULL_CHECK(TAG, el, return ESP_ERR_INVALID_ARG);
+    if (el->is_running || (next && next->is_running)) {
+        ESP_LOGE(TAG, "[%s] Can't change the fused chain of a running element", el->tag);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (el->fused_next) {
+        audio_element_handle_t old = el->fused_next;
+        // The split off elements have no task of their own, release them so that they can be run again
+        for (audio_element_handle_t it = old; it; it = it->fused_next) {
+            if (it->task_run) {
+                audio_element_fused_release(it);
+            }
+        }
+        el->fused_next = NULL;
+        el->write_type = IO_TYPE_RB;
+        el->out.output_rb = NULL;
+        old->fused_prev = NULL;
+        old->read_type = IO_TYPE_RB;
+        old->in.input_rb = NULL;
+        audio_element_fused_update_head(old);
+    }
+    if (next == NULL) {
+        return ESP_OK;
+    }
+    if (el->task_stack <= 0 || next->task_stack <= 0 || next->fused_prev) {
+        ESP_LOGE(TAG, "[%s] Can't fuse [%s], both elements need a task stack and a free input", el->tag, next->tag);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (next->task_run && next->fused_head == NULL) {
+        ESP_LOGE(TAG, "[%s] Can't fuse [%s], terminate its task first", el->tag, next->tag);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (audio_element_handle_t it = next; it; it = it->fused_next) {
+        if (it == el) {
+            ESP_LOGE(TAG, "[%s] Can't fuse [%s], the chain would be a loop", el->tag, next->tag);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    el->fused_next = next;
+    el->write_type = IO_TYPE_FUSED;
+    el->out.output_rb = NULL;
+    next->fused_prev = el;
+    next->read_type = IO_TYPE_FUSED;
+    next->in.input_rb = NULL;
+    audio_element_fused_update_head(next);
+    return ESP_OK;
+}
@@ -52,6 +52,13 @@ typedef struct ringbuf_item {
 
 typedef STAILQ_HEAD(ringbuf_list, ringbuf_item) ringbuf_list_t;
 
+typedef struct buf_queue_item {
+    STAILQ_ENTRY(buf_queue_item) next;
+    buf_queue_handle_t          bq;
+} buf_queue_item_t;
+
+typedef STAILQ_HEAD(buf_queue_list, buf_queue_item) buf_queue_list_t;
+
 typedef struct audio_element_item {
     STAILQ_ENTRY(audio_element_item) next;
     audio_element_handle_t           el;
@@ -68,6 +75,11 @@ struct audio_pipeline {
     audio_element_state_t       state;
     xSemaphoreHandle            lock;
     bool                        linked;
+    bool                        single_task;
+    int                         buf_queue_depth;
+    int                         buf_block_size;
+    buf_pool_handle_t           buf_pool;
+    buf_queue_list_t            bq_list;
     audio_event_iface_handle_t  listener;
 };
 
@@ -255,8 +267,12 @@ audio_pipeline_handle_t audio_pipeline_init(audio_pipeline_cfg_t *config)
     AUDIO_MEM_CHECK(TAG, _success, return NULL);
     STAILQ_INIT(&pipeline->el_list);
     STAILQ_INIT(&pipeline->rb_list);
+    STAILQ_INIT(&pipeline->bq_list);
 
     pipeline->state = AEL_STATE_INIT;
+    pipeline->single_task = config->single_task;
+    pipeline->buf_queue_depth = config->buf_queue_depth;
+    pipeline->buf_block_size = config->buf_block_size;
     return pipeline;
 }
 
@@ -424,10 +440,76 @@ esp_err_t audio_pipeline_wait_for_stop(audio_pipeline_handle_t pipeline)
     return ret;
 }
 
+static esp_err_t _pipeline_fused_linked(audio_pipeline_handle_t pipeline, audio_element_handle_t el, bool first)
+{
+    static audio_element_handle_t prev;
+    if (!first) {
+        esp_err_t ret = audio_element_set_fused_next(prev, el);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        ESP_LOGI(TAG, "link el->el, el:%p, tag:%s, next:%p, tag:%s", prev, audio_element_get_tag(prev) == NULL ? "NULL" : audio_element_get_tag(prev),
+                 el, audio_element_get_tag(el) == NULL ? "NULL" : audio_element_get_tag(el));
+    }
+    prev = el;
+    return ESP_OK;
+}
+
+static bool _pipeline_uses_ringbuf(audio_pipeline_handle_t pipeline)
+{
+    return !pipeline->single_task && pipeline->buf_queue_depth <= 0;
+}
+
+static esp_err_t _pipeline_buf_pool_create(audio_pipeline_handle_t pipeline, int el_num)
+{
+    if (pipeline->single_task || pipeline->buf_queue_depth <= 0) {
+        return ESP_OK;
+    }
+    // Every queue may be full while each element holds an input and an output block, so allocation never fails
+    int block_num = (el_num - 1) * pipeline->buf_queue_depth + 2 * el_num;
+    pipeline->buf_pool = buf_pool_create(pipeline->buf_block_size, block_num);
+    AUDIO_MEM_CHECK(TAG, pipeline->buf_pool, return ESP_ERR_NO_MEM);
+    ESP_LOGI(TAG, "buffer pool:%p, %d blocks of %d bytes", pipeline->buf_pool, block_num, pipeline->buf_block_size);
+    return ESP_OK;
+}
+
+static esp_err_t _pipeline_bq_linked(audio_pipeline_handle_t pipeline, audio_element_handle_t el, bool first, bool last)
+{
+    static buf_queue_handle_t bq;
+    buf_queue_item_t *bq_item;
+    if (!first) {
+        audio_element_set_input_buf_queue(el, bq);
+    }
+    if (last) {
+        return ESP_OK;
+    }
+    bool _success = (
+                        (bq_item = audio_calloc(1, sizeof(buf_queue_item_t))) &&
+                        (bq = buf_queue_create(pipeline->buf_pool, pipeline->buf_queue_depth))
+                    );
+
+    AUDIO_MEM_CHECK(TAG, _success, {
+        audio_free(bq_item);
+        return ESP_ERR_NO_MEM;
+    });
+
+    bq_item->bq = bq;
+    STAILQ_INSERT_TAIL(&pipeline->bq_list, bq_item, next);
+    audio_element_set_output_buf_queue(el, bq);
+    ESP_LOGI(TAG, "link el->bq, el:%p, tag:%s, bq:%p", el, audio_element_get_tag(el) == NULL ? "NULL" : audio_element_get_tag(el), bq);
+    return ESP_OK;
+}
+
 static esp_err_t _pipeline_rb_linked(audio_pipeline_handle_t pipeline, audio_element_handle_t el, bool first, bool last)
 {
     static ringbuf_handle_t rb;
     ringbuf_item_t *rb_item;
+    if (pipeline->single_task) {
+        return _pipeline_fused_linked(pipeline, el, first);
+    }
+    if (pipeline->buf_pool) {
+        return _pipeline_bq_linked(pipeline, el, first, last);
+    }
     if (last) {
         audio_element_set_input_ringbuf(el, rb);
     } else {
@@ -462,6 +544,10 @@ esp_err_t audio_pipeline_link(audio_pipeline_handle_t pipeline, const char *link
     if (pipeline->linked) {
         audio_pipeline_unlink(pipeline);
     }
+    ret = _pipeline_buf_pool_create(pipeline, link_num);
+    if (ret != ESP_OK) {
+        return ret;
+    }
     for (int i = 0; i < link_num; i++) {
         audio_element_item_t *item = audio_pipeline_get_el_item_by_tag(pipeline, link_tag[i]);
         if (item == NULL) {
@@ -495,6 +581,11 @@ esp_err_t audio_pipeline_unlink(audio_pipeline_handle_t pipeline)
         if (el_item->linked) {
             el_item->linked = false;
             el_item->kept_ctx = false;
+            if (pipeline->single_task) {
+                audio_element_set_fused_next(el_item->el, NULL);
+            }
+            audio_element_set_output_buf_queue(el_item->el, NULL);
+            audio_element_set_input_buf_queue(el_item->el, NULL);
             audio_element_set_output_ringbuf(el_item->el, NULL);
             audio_element_set_input_ringbuf(el_item->el, NULL);
             ESP_LOGD(TAG, "audio_pipeline_unlink, %p, %s", el_item->el, audio_element_get_tag(el_item->el));
@@ -509,6 +600,17 @@ esp_err_t audio_pipeline_unlink(audio_pipeline_handle_t pipeline)
         rb_item->host_el = NULL;
         audio_free(rb_item);
     }
+    buf_queue_item_t *bq_item, *bq_tmp;
+    STAILQ_FOREACH_SAFE(bq_item, &pipeline->bq_list, next, bq_tmp) {
+        ESP_LOGD(TAG, "audio_pipeline_unlink, BQ, %p,", bq_item->bq);
+        STAILQ_REMOVE(&pipeline->bq_list, bq_item, buf_queue_item, next);
+        buf_queue_destroy(bq_item->bq);
+        audio_free(bq_item);
+    }
+    if (pipeline->buf_pool) {
+        buf_pool_destroy(pipeline->buf_pool);
+        pipeline->buf_pool = NULL;
+    }
     ESP_LOGI(TAG, "audio_pipeline_unlinked");
     STAILQ_INIT(&pipeline->rb_list);
     pipeline->linked = false;
@@ -550,6 +652,18 @@ esp_err_t audio_pipeline_link_more(audio_pipeline_handle_t pipeline, audio_eleme
         audio_pipeline_unlink(pipeline);
     }
     va_start(args, element_1);
+    va_list count_args;
+    va_copy(count_args, args);
+    int el_num = 1;
+    while (va_arg(count_args, audio_element_handle_t)) {
+        el_num++;
+    }
+    va_end(count_args);
+    ret = _pipeline_buf_pool_create(pipeline, el_num);
+    if (ret != ESP_OK) {
+        va_end(args);
+        return ret;
+    }
     while (element_1) {
         audio_element_handle_t el = element_1;
         audio_element_item_t *item = audio_pipeline_get_el_item_by_handle(pipeline, element_1);
@@ -575,6 +689,10 @@ esp_err_t audio_pipeline_link_more(audio_pipeline_handle_t pipeline, audio_eleme
 
 esp_err_t audio_pipeline_link_insert(audio_pipeline_handle_t pipeline, bool first, audio_element_handle_t prev, ringbuf_handle_t conect_rb, audio_element_handle_t next)
 {
+    if (!_pipeline_uses_ringbuf(pipeline)) {
+        ESP_LOGE(TAG, "%s is only supported by pipelines linked with ringbuffers", __func__);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     if (first) {
         audio_pipeline_register_element(pipeline, prev);
     }
@@ -747,6 +865,10 @@ esp_err_t audio_pipeline_breakup_elements(audio_pipeline_handle_t pipeline, audi
         ESP_LOGE(TAG, "%s have invalid args, %p", __func__, pipeline);
         return ESP_ERR_INVALID_ARG;
     }
+    if (!_pipeline_uses_ringbuf(pipeline)) {
+        ESP_LOGE(TAG, "%s is only supported by pipelines linked with ringbuffers", __func__);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     audio_pipeline_remove_listener(pipeline);
     audio_element_item_t *el_item, *el_tmp;
     ringbuf_item_t *rb_item, *tmp;
@@ -899,6 +1021,10 @@ esp_err_t audio_pipeline_relink(audio_pipeline_handle_t pipeline, const char *li
         ESP_LOGE(TAG, "%s have invalid args, %p, %p", __func__, pipeline, link_tag);
         return ESP_ERR_INVALID_ARG;
     }
+    if (!_pipeline_uses_ringbuf(pipeline)) {
+        ESP_LOGE(TAG, "%s is only supported by pipelines linked with ringbuffers", __func__);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     if (pipeline->linked) {
         ESP_LOGE(TAG, "%s pipeline is already linked, can't relink", __func__);
         return ESP_FAIL;
@@ -941,6 +1067,10 @@ relink_err:
 esp_err_t audio_pipeline_relink_more(audio_pipeline_handle_t pipeline, audio_element_handle_t element_1, ...)
 {
     AUDIO_NULL_CHECK(TAG, (pipeline || element_1), return ESP_ERR_INVALID_ARG);
+    if (!_pipeline_uses_ringbuf(pipeline)) {
+        ESP_LOGE(TAG, "%s is only supported by pipelines linked with ringbuffers", __func__);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     if (pipeline->linked) {
         ESP_LOGE(TAG, "%s pipeline is already linked, can't relink", __func__);
         return ESP_FAIL;
@@ -0,0 +1,401 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "buf_pool.h"
+#include "esp_log.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+
+static const char *TAG = "BUF_POOL";
+
+struct buf_pool {
+    char *mem;                   /**< Memory of all the blocks */
+    int block_size;              /**< Size of each block */
+    int block_num;               /**< Number of blocks */
+    int *free_list;              /**< Indexes of the free blocks */
+    volatile int free_cnt;       /**< Number of free blocks */
+    SemaphoreHandle_t lock;
+};
+
+typedef struct {
+    char *buf;
+    int len;
+} buf_queue_slot_t;
+
+struct buf_queue {
+    buf_pool_handle_t pool;
+    buf_queue_slot_t *slots;
+    int depth;                   /**< Number of slots */
+    int head;                    /**< Slot of the oldest block */
+    volatile int fill_cnt;       /**< Number of queued blocks */
+    char *read_buf;              /**< Block partially consumed by buf_queue_read */
+    int read_len;                /**< Bytes left in read_buf */
+    SemaphoreHandle_t can_read;
+    SemaphoreHandle_t can_write;
+    SemaphoreHandle_t lock;
+    bool abort_read;
+    bool abort_write;
+    bool is_done_write;         /**< To signal that we are done writing */
+};
+
+#define bq_block(handle, time) xSemaphoreTake(handle, time)
+#define bq_release(handle) xSemaphoreGive(handle)
+
+buf_pool_handle_t buf_pool_create(int block_size, int block_num)
+{
+    if (block_size <= 0 || block_num <= 0) {
+        ESP_LOGE(TAG, "Invalid size");
+        return NULL;
+    }
+    buf_pool_handle_t pool = audio_calloc(1, sizeof(struct buf_pool));
+    AUDIO_MEM_CHECK(TAG, pool, return NULL);
+    // Keep every block word aligned
+    pool->block_size = (block_size + 3) & ~3;
+    pool->block_num = block_num;
+    bool _success =
+        (
+            (pool->mem       = audio_calloc(block_num, pool->block_size)) &&
+            (pool->free_list = audio_calloc(block_num, sizeof(int)))      &&
+            (pool->lock      = xSemaphoreCreateMutex())
+        );
+    AUDIO_MEM_CHECK(TAG, _success, goto _pool_init_failed);
+
+    for (int i = 0; i < block_num; i++) {
+        pool->free_list[i] = block_num - 1 - i;
+    }
+    pool->free_cnt = block_num;
+    return pool;
+_pool_init_failed:
+    buf_pool_destroy(pool);
+    return NULL;
+}
+
+esp_err_t buf_pool_destroy(buf_pool_handle_t pool)
+{
+    if (pool == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pool->free_cnt != pool->block_num) {
+        ESP_LOGW(TAG, "Destroy pool with %d blocks in use", pool->block_num - pool->free_cnt);
+    }
+    if (pool->lock) {
+        vSemaphoreDelete(pool->lock);
+    }
+    audio_free(pool->free_list);
+    audio_free(pool->mem);
+    audio_free(pool);
+    return ESP_OK;
+}
+
+char *buf_pool_alloc(buf_pool_handle_t pool)
+{
+    char *buf = NULL;
+    if (pool == NULL) {
+        return NULL;
+    }
+    bq_block(pool->lock, portMAX_DELAY);
+    if (pool->free_cnt > 0) {
+        buf = pool->mem + pool->free_list[--pool->free_cnt] * pool->block_size;
+    }
+    bq_release(pool->lock);
+    return buf;
+}
+
+esp_err_t buf_pool_free(buf_pool_handle_t pool, char *buf)
+{
+    if (!buf_pool_owns(pool, buf)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bq_block(pool->lock, portMAX_DELAY);
+    if (pool->free_cnt >= pool->block_num) {
+        bq_release(pool->lock);
+        ESP_LOGE(TAG, "Block %p freed twice", buf);
+        return ESP_ERR_INVALID_STATE;
+    }
+    pool->free_list[pool->free_cnt++] = (buf - pool->mem) / pool->block_size;
+    bq_release(pool->lock);
+    return ESP_OK;
+}
+
+bool buf_pool_owns(buf_pool_handle_t pool, const char *buf)
+{
+    if (pool == NULL || buf == NULL) {
+        return false;
+    }
+    return (buf >= pool->mem) && (buf < pool->mem + pool->block_size * pool->block_num);
+}
+
+int buf_pool_get_block_size(buf_pool_handle_t pool)
+{
+    return pool->block_size;
+}
+
+int buf_pool_get_free_blocks(buf_pool_handle_t pool)
+{
+    return pool->free_cnt;
+}
+
+buf_queue_handle_t buf_queue_create(buf_pool_handle_t pool, int depth)
+{
+    if (pool == NULL || depth <= 0) {
+        ESP_LOGE(TAG, "Invalid queue parameters");
+        return NULL;
+    }
+    buf_queue_handle_t q = audio_calloc(1, sizeof(struct buf_queue));
+    AUDIO_MEM_CHECK(TAG, q, return NULL);
+    bool _success =
+        (
+            (q->slots     = audio_calloc(depth, sizeof(buf_queue_slot_t))) &&
+            (q->can_read  = xSemaphoreCreateBinary())                      &&
+            (q->lock      = xSemaphoreCreateMutex())                       &&
+            (q->can_write = xSemaphoreCreateBinary())
+        );
+    AUDIO_MEM_CHECK(TAG, _success, goto _queue_init_failed);
+    q->pool = pool;
+    q->depth = depth;
+    return q;
+_queue_init_failed:
+    buf_queue_destroy(q);
+    return NULL;
+}
+
+esp_err_t buf_queue_destroy(buf_queue_handle_t q)
+{
+    if (q == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (q->slots && q->lock) {
+        buf_queue_reset(q);
+    }
+    if (q->can_read) {
+        vSemaphoreDelete(q->can_read);
+    }
+    if (q->can_write) {
+        vSemaphoreDelete(q->can_write);
+    }
+    if (q->lock) {
+        vSemaphoreDelete(q->lock);
+    }
+    audio_free(q->slots);
+    audio_free(q);
+    return ESP_OK;
+}
+
+esp_err_t buf_queue_reset(buf_queue_handle_t q)
+{
+    if (q == NULL) {
+        return ESP_FAIL;
+    }
+    bq_block(q->lock, portMAX_DELAY);
+    while (q->fill_cnt > 0) {
+        buf_pool_free(q->pool, q->slots[q->head].buf);
+        q->head = (q->head + 1) % q->depth;
+        q->fill_cnt--;
+    }
+    if (q->read_buf) {
+        buf_pool_free(q->pool, q->read_buf);
+        q->read_buf = NULL;
+        q->read_len = 0;
+    }
+    q->head = 0;
+    q->is_done_write = false;
+    q->abort_read = false;
+    q->abort_write = false;
+    bq_release(q->lock);
+    return ESP_OK;
+}
+
+buf_pool_handle_t buf_queue_get_pool(buf_queue_handle_t q)
+{
+    return q->pool;
+}
+
+int buf_queue_get_filled(buf_queue_handle_t q)
+{
+    return q->fill_cnt + (q->read_buf ? 1 : 0);
+}
+
+int buf_queue_push(buf_queue_handle_t q, char *buf, int len, TickType_t ticks_to_wait)
+{
+    if (q == NULL || !buf_pool_owns(q->pool, buf)) {
+        return RB_FAIL;
+    }
+    while (1) {
+        bq_block(q->lock, portMAX_DELAY);
+        if (q->fill_cnt < q->depth) {
+            buf_queue_slot_t *slot = &q->slots[(q->head + q->fill_cnt) % q->depth];
+            slot->buf = buf;
+            slot->len = len;
+            q->fill_cnt++;
+            bq_release(q->lock);
+            bq_release(q->can_read);
+            return len;
+        }
+        bq_release(q->lock);
+        if (q->is_done_write) {
+            return RB_DONE;
+        }
+        if (q->abort_write) {
+            return RB_ABORT;
+        }
+        //wait till the reader takes a block
+        if (bq_block(q->can_write, ticks_to_wait) != pdTRUE) {
+            return RB_TIMEOUT;
+        }
+    }
+}
+
+int buf_queue_pop(buf_queue_handle_t q, char **buf, TickType_t ticks_to_wait)
+{
+    if (q == NULL || buf == NULL) {
+        return RB_FAIL;
+    }
+    while (1) {
+        bq_block(q->lock, portMAX_DELAY);
+        if (q->read_buf) {
+            // Hand over the rest of a block partially consumed by buf_queue_read
+            int len = q->read_len;
+            *buf = q->read_buf;
+            q->read_buf = NULL;
+            q->read_len = 0;
+            bq_release(q->lock);
+            return len;
+        }
+        if (q->fill_cnt > 0) {
+            buf_queue_slot_t *slot = &q->slots[q->head];
+            int len = slot->len;
+            *buf = slot->buf;
+            q->head = (q->head + 1) % q->depth;
+            q->fill_cnt--;
+            bq_release(q->lock);
+            bq_release(q->can_write);
+            return len;
+        }
+        bq_release(q->lock);
+        if (q->is_done_write) {
+            return RB_DONE;
+        }
+        if (q->abort_read) {
+            return RB_ABORT;
+        }
+        //wait till the writer queues a block
+        if (bq_block(q->can_read, ticks_to_wait) != pdTRUE) {
+            return RB_TIMEOUT;
+        }
+    }
+}
+
+int buf_queue_read(buf_queue_handle_t q, char *buf, int len, TickType_t ticks_to_wait)
+{
+    int total_read_size = 0;
+    int ret_val = 0;
+    char *block = NULL;
+
+    if (q == NULL || buf == NULL) {
+        return RB_FAIL;
+    }
+    while (len) {
+        int block_len = buf_queue_pop(q, &block, ticks_to_wait);
+        if (block_len < 0) {
+            ret_val = block_len;
+            break;
+        }
+        int read_size = block_len < len ? block_len : len;
+        memcpy(buf, block, read_size);
+        buf += read_size;
+        len -= read_size;
+        total_read_size += read_size;
+        if (read_size < block_len) {
+            // Keep the rest for the next read, only the reader touches read_buf
+            q->read_buf = block + read_size;
+            q->read_len = block_len - read_size;
+        } else {
+            buf_pool_free(q->pool, block);
+        }
+    }
+    if ((ret_val == RB_FAIL) ||
+        (ret_val == RB_ABORT)) {
+        total_read_size = ret_val;
+    }
+    return total_read_size > 0 ? total_read_size : ret_val;
+}
+
+int buf_queue_write(buf_queue_handle_t q, const char *buf, int len, TickType_t ticks_to_wait)
+{
+    int total_write_size = 0;
+    int ret_val = 0;
+
+    if (q == NULL || buf == NULL) {
+        return RB_FAIL;
+    }
+    while (len) {
+        char *block = buf_pool_alloc(q->pool);
+        if (block == NULL) {
+            ESP_LOGE(TAG, "No free block in the pool");
+            ret_val = RB_FAIL;
+            break;
+        }
+        int write_size = q->pool->block_size < len ? q->pool->block_size : len;
+        memcpy(block, buf, write_size);
+        int ret = buf_queue_push(q, block, write_size, ticks_to_wait);
+        if (ret < 0) {
+            buf_pool_free(q->pool, block);
+            ret_val = ret;
+            break;
+        }
+        buf += write_size;
+        len -= write_size;
+        total_write_size += write_size;
+    }
+    if ((ret_val == RB_FAIL) ||
+        (ret_val == RB_ABORT)) {
+        total_write_size = ret_val;
+    }
+    return total_write_size > 0 ? total_write_size : ret_val;
+}
+
+esp_err_t buf_queue_done_write(buf_queue_handle_t q)
+{
+    if (q == NULL) {
+        return ESP_FAIL;
+    }
+    q->is_done_write = true;
+    bq_release(q->can_read);
+    return ESP_OK;
+}
+
+esp_err_t buf_queue_abort(buf_queue_handle_t q)
+{
+    if (q == NULL) {
+        return ESP_FAIL;
+    }
+    q->abort_read = true;
+    q->abort_write = true;
+    bq_release(q->can_read);
+    bq_release(q->can_write);
+    return ESP_OK;
+}
@@ -28,6 +28,7 @@
 #include "esp_err.h"
 #include "audio_event_iface.h"
 #include "ringbuf.h"
+#include "buf_pool.h"
 #include "audio_common.h"
 
 #ifdef __cplusplus
@@ -474,6 +475,50 @@ esp_err_t audio_element_set_output_ringbuf(audio_element_handle_t el, ringbuf_ha
  */
 ringbuf_handle_t audio_element_get_output_ringbuf(audio_element_handle_t el);
 
+/**
+ * @brief      Set Element input buffer queue, the element then reads blocks of a buffer pool instead of a ringbuffer.
+ *             Pass NULL to remove the buffer queue.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[in]  bq    The buffer queue handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_set_input_buf_queue(audio_element_handle_t el, buf_queue_handle_t bq);
+
+/**
+ * @brief      Get Element input buffer queue.
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return     buf_queue_handle_t
+ */
+buf_queue_handle_t audio_element_get_input_buf_queue(audio_element_handle_t el);
+
+/**
+ * @brief      Set Element output buffer queue, the element then writes blocks of a buffer pool instead of a ringbuffer.
+ *             Pass NULL to remove the buffer queue.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[in]  bq    The buffer queue handle
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_set_output_buf_queue(audio_element_handle_t el, buf_queue_handle_t bq);
+
+/**
+ * @brief      Get Element output buffer queue.
+ *
+ * @param[in]  el    The audio element handle
+ *
+ * @return     buf_queue_handle_t
+ */
+buf_queue_handle_t audio_element_get_output_buf_queue(audio_element_handle_t el);
+
 /**
  * @brief      Get current Element state.
  *
@@ -664,6 +709,62 @@ audio_element_err_t audio_element_input(audio_element_handle_t el, char *buffer,
  */
 audio_element_err_t audio_element_output(audio_element_handle_t el, char *buffer, int write_size);
 
+/**
+ * @brief      Get the next input block without copying it, for elements which process data in place.
+ *             With an input buffer queue, the element takes the ownership of a block of the pool.
+ *             Otherwise the data is read with `audio_element_input` into the element buffer.
+ *             The block must be given back with `audio_element_release_input_buf`,
+ *             or passed to `audio_element_commit_output_buf` to forward it to the next element.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[out] buf   The input data
+ *
+ * @return
+ *        - > 0 number of bytes in `buf`
+ *        - <=0 audio_element_err_t
+ */
+audio_element_err_t audio_element_acquire_input_buf(audio_element_handle_t el, char **buf);
+
+/**
+ * @brief      Give back a block got from `audio_element_acquire_input_buf`
+ *
+ * @param[in]  el    The audio element handle
+ * @param[in]  buf   The input data
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_FAIL
+ */
+esp_err_t audio_element_release_input_buf(audio_element_handle_t el, char *buf);
+
+/**
+ * @brief      Get an empty block to produce the output data in.
+ *             With an output buffer queue, this is a free block of the pool.
+ *             Otherwise it is a buffer of the element, copied out by `audio_element_commit_output_buf`.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[out] buf   The empty block
+ *
+ * @return
+ *        - > 0 size of `buf`
+ *        - <=0 audio_element_err_t
+ */
+audio_element_err_t audio_element_acquire_output_buf(audio_element_handle_t el, char **buf);
+
+/**
+ * @brief      Send out a block got from `audio_element_acquire_output_buf` or `audio_element_acquire_input_buf`.
+ *             The element loses the ownership of the block, even if the output fails.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[in]  buf   The output data
+ * @param[in]  len   Number of bytes in `buf`
+ *
+ * @return
+ *        - > 0 number of bytes written
+ *        - <=0 audio_element_err_t
+ */
+audio_element_err_t audio_element_commit_output_buf(audio_element_handle_t el, char *buf, int len);
+
 /**
  * @brief     This API allows the application to set a read callback for the first audio_element in the pipeline for
  *            allowing the pipeline to interface with other systems. The callback is invoked every time the audio
@@ -879,6 +980,31 @@ esp_err_t audio_element_seek(audio_element_handle_t el, void *in_data, int in_si
  */
 bool audio_element_is_stopping(audio_element_handle_t el);
 
+/**
+ * @brief      Fuse the output of an element with the input of the next one.
+ *             Fused elements have no task and no ringbuffer between them: each time `el` outputs data,
+ *             the task of the first element of the chain runs the `process` of `next` on it, and so on down
+ *             the chain. Commands of fused elements are dispatched by that task too, so their states
+ *             and events stay the same as with one task per element.
+ *             The input of a fused element returns as much data as the previous element has output,
+ *             which may be less than the requested size.
+ *
+ *             The calls of the fused elements are nested on the stack of that task, so it is created with
+ *             the sum of the `task_stack` of all the elements of the chain. Its stack is in external memory
+ *             only if `stack_in_ext` is set for all of them. Priority and core are those of the first element.
+ *
+ * @note       The elements must not be running. Pass NULL as `next` to split the chain after `el`.
+ *
+ * @param[in]  el    The audio element handle
+ * @param[in]  next  The element processed after `el`, or NULL
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG: an element has no task stack configured, `next` is already fused or the chain would be a loop
+ *     - ESP_ERR_INVALID_STATE: an element is running or `next` has a task of its own
+ */
+esp_err_t audio_element_set_fused_next(audio_element_handle_t el, audio_element_handle_t next);
+
 
 #ifdef __cplusplus
 }
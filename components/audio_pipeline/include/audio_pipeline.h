@@ -38,12 +38,23 @@ typedef struct audio_pipeline *audio_pipeline_handle_t;
  */
 typedef struct audio_pipeline_cfg {
     int rb_size;        /*!< Audio Pipeline ringbuffer size */
+    bool single_task;   /*!< Run the linked elements in the task of the first one, without ringbuffers between them.
+                             That task is created with the sum of the `task_stack` of the linked elements.
+                             See `audio_element_set_fused_next`. Relink and breakup are not supported in this mode */
+    int buf_queue_depth; /*!< When > 0, link the elements with queues of this many blocks of a shared buffer pool instead of ringbuffers,
+                              elements using `audio_element_acquire_input_buf` and `audio_element_commit_output_buf` then exchange
+                              blocks without copying data. Ignored in single task mode. Relink and breakup are not supported in this mode */
+    int buf_block_size;  /*!< Size of each block of the buffer pool */
 } audio_pipeline_cfg_t;
 
 #define DEFAULT_PIPELINE_RINGBUF_SIZE    (8*1024)
+#define DEFAULT_PIPELINE_BUF_BLOCK_SIZE  (2*1024)
 
 #define DEFAULT_AUDIO_PIPELINE_CONFIG() {\
     .rb_size            = DEFAULT_PIPELINE_RINGBUF_SIZE,\
+    .single_task        = false,\
+    .buf_queue_depth    = 0,\
+    .buf_block_size     = DEFAULT_PIPELINE_BUF_BLOCK_SIZE,\
 }
 
 /**
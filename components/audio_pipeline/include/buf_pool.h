@@ -0,0 +1,229 @@
+/*
+ * ESPRESSIF MIT License
+ *
+ * Copyright (c) 2018 <ESPRESSIF SYSTEMS (SHANGHAI) PTE LTD>
+ *
+ * Permission is hereby granted for use on all ESPRESSIF SYSTEMS products, in which case,
+ * it is free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished
+ * to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _BUF_POOL_H__
+#define _BUF_POOL_H__
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A buffer pool holds a fixed number of equally sized blocks allocated once.
+ * A buffer queue passes blocks of one pool between two elements: the writer hands
+ * over the ownership of a filled block and the reader gives it back to the pool
+ * after use, so no data is copied between the elements.
+ *
+ * The queue functions return the same codes as the ringbuffer (RB_DONE, RB_ABORT, RB_TIMEOUT...)
+ */
+
+typedef struct buf_pool *buf_pool_handle_t;
+typedef struct buf_queue *buf_queue_handle_t;
+
+/**
+ * @brief      Create a pool of `block_num` blocks of `block_size` bytes
+ *
+ * @param[in]  block_size   Size of each block, rounded up to a multiple of 4
+ * @param[in]  block_num    Number of blocks
+ *
+ * @return     buf_pool_handle_t, NULL on failure
+ */
+buf_pool_handle_t buf_pool_create(int block_size, int block_num);
+
+/**
+ * @brief      Free the pool memory, blocks in use become invalid
+ *
+ * @param[in]  pool  The buffer pool handle
+ *
+ * @return     ESP_OK or ESP_ERR_INVALID_ARG
+ */
+esp_err_t buf_pool_destroy(buf_pool_handle_t pool);
+
+/**
+ * @brief      Take a free block from the pool, never blocks
+ *
+ * @param[in]  pool  The buffer pool handle
+ *
+ * @return     Pointer to the block, NULL if all blocks are in use
+ */
+char *buf_pool_alloc(buf_pool_handle_t pool);
+
+/**
+ * @brief      Give a block back to the pool
+ *
+ * @param[in]  pool  The buffer pool handle
+ * @param[in]  buf   Any address inside the block
+ *
+ * @return     ESP_OK or ESP_ERR_INVALID_ARG if the block does not belong to the pool
+ */
+esp_err_t buf_pool_free(buf_pool_handle_t pool, char *buf);
+
+/**
+ * @brief      Check whether an address is inside a block of the pool
+ *
+ * @param[in]  pool  The buffer pool handle
+ * @param[in]  buf   The address to check
+ *
+ * @return     true if `buf` belongs to the pool
+ */
+bool buf_pool_owns(buf_pool_handle_t pool, const char *buf);
+
+/**
+ * @brief      Get the size of each block
+ *
+ * @param[in]  pool  The buffer pool handle
+ *
+ * @return     Block size in bytes
+ */
+int buf_pool_get_block_size(buf_pool_handle_t pool);
+
+/**
+ * @brief      Get the number of blocks not in use
+ *
+ * @param[in]  pool  The buffer pool handle
+ *
+ * @return     Number of free blocks
+ */
+int buf_pool_get_free_blocks(buf_pool_handle_t pool);
+
+/**
+ * @brief      Create a queue holding at most `depth` blocks of `pool`
+ *
+ * @param[in]  pool   The buffer pool the queued blocks belong to
+ * @param[in]  depth  Maximum number of queued blocks
+ *
+ * @return     buf_queue_handle_t, NULL on failure
+ */
+buf_queue_handle_t buf_queue_create(buf_pool_handle_t pool, int depth);
+
+/**
+ * @brief      Give the queued blocks back to the pool and free the queue
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     ESP_OK or ESP_ERR_INVALID_ARG
+ */
+esp_err_t buf_queue_destroy(buf_queue_handle_t q);
+
+/**
+ * @brief      Give the queued blocks back to the pool and clear the done and abort states
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t buf_queue_reset(buf_queue_handle_t q);
+
+/**
+ * @brief      Get the pool of the queue
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     buf_pool_handle_t
+ */
+buf_pool_handle_t buf_queue_get_pool(buf_queue_handle_t q);
+
+/**
+ * @brief      Get the number of queued blocks
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     Number of queued blocks
+ */
+int buf_queue_get_filled(buf_queue_handle_t q);
+
+/**
+ * @brief      Queue a block of the pool, the queue takes the ownership of the block on success
+ *
+ * @param[in]  q              The buffer queue handle
+ * @param[in]  buf            Address inside a block of the queue pool
+ * @param[in]  len            Number of valid bytes from `buf`
+ * @param[in]  ticks_to_wait  Time to wait for a free slot
+ *
+ * @return     `len` on success, or RB_FAIL, RB_DONE, RB_ABORT, RB_TIMEOUT and the caller keeps the block
+ */
+int buf_queue_push(buf_queue_handle_t q, char *buf, int len, TickType_t ticks_to_wait);
+
+/**
+ * @brief      Take the oldest block from the queue, the caller must give it back with `buf_pool_free`
+ *
+ * @param[in]  q              The buffer queue handle
+ * @param[out] buf            Start of the valid data
+ * @param[in]  ticks_to_wait  Time to wait for a block
+ *
+ * @return     Number of valid bytes, or RB_FAIL, RB_DONE, RB_ABORT, RB_TIMEOUT
+ */
+int buf_queue_pop(buf_queue_handle_t q, char **buf, TickType_t ticks_to_wait);
+
+/**
+ * @brief      Copy data out of the queued blocks, same behaviour as `rb_read`
+ *
+ * @param[in]  q              The buffer queue handle
+ * @param[out] buf            Destination buffer
+ * @param[in]  len            Number of bytes to read
+ * @param[in]  ticks_to_wait  Time to wait for each block
+ *
+ * @return     Number of bytes read, or RB_FAIL, RB_DONE, RB_ABORT, RB_TIMEOUT
+ */
+int buf_queue_read(buf_queue_handle_t q, char *buf, int len, TickType_t ticks_to_wait);
+
+/**
+ * @brief      Copy data into blocks of the pool and queue them, same behaviour as `rb_write`
+ *
+ * @param[in]  q              The buffer queue handle
+ * @param[in]  buf            Source buffer
+ * @param[in]  len            Number of bytes to write
+ * @param[in]  ticks_to_wait  Time to wait for each free slot
+ *
+ * @return     Number of bytes written, or RB_FAIL, RB_DONE, RB_ABORT, RB_TIMEOUT
+ */
+int buf_queue_write(buf_queue_handle_t q, const char *buf, int len, TickType_t ticks_to_wait);
+
+/**
+ * @brief      Signal that no more blocks will be queued, the reader gets RB_DONE once the queue is empty
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t buf_queue_done_write(buf_queue_handle_t q);
+
+/**
+ * @brief      Unblock the reader and the writer with RB_ABORT
+ *
+ * @param[in]  q     The buffer queue handle
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t buf_queue_abort(buf_queue_handle_t q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,12 +23,14 @@
  */
 
 #include <pthread.h>
+#include <string.h>
 #include "unity.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "audio_pipeline.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
 static const char *TAG = "AUDIO_ELEMENT_TEST";
 
@@ -117,3 +119,397 @@ TEST_CASE("audio_pipeline", "esp-adf")
     TEST_ASSERT_EQUAL(ESP_OK, audio_element_deinit(last_el));
 
 }
+
+/*
+ * Four stage chain standing in for decoder -> resampler -> equalizer -> i2s: every stage runs a light
+ * per sample loop on the data and passes it on. The source stamps each chunk with its creation time
+ * so that the sink can measure the latency through the chain.
+ */
+#define BENCH_CHUNK_SIZE    (1024)
+#define BENCH_CHUNK_COUNT   (1000)
+#define BENCH_QUEUE_DEPTH   (4)
+
+typedef enum {
+    BENCH_TASK_PER_ELEMENT,
+    BENCH_SINGLE_TASK,
+    BENCH_BUF_POOL,
+} bench_mode_t;
+
+static const char *bench_mode_name[] = {"task/element", "single task", "buffer pool"};
+
+typedef struct {
+    int     chunks_left;
+    int     chunks;
+    int64_t latency_sum;
+    int64_t latency_max;
+} bench_ctx_t;
+
+static esp_err_t _bench_open(audio_element_handle_t self)
+{
+    return ESP_OK;
+}
+
+static int _bench_src_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    bench_ctx_t *ctx = (bench_ctx_t *)context;
+    if (ctx->chunks_left == 0) {
+        return AEL_IO_DONE;
+    }
+    if (ctx->chunks_left > 0) {
+        ctx->chunks_left--;
+    }
+    memset(buffer, 0x55, len);
+    int64_t now = esp_timer_get_time();
+    memcpy(buffer, &now, sizeof(now));
+    return len;
+}
+
+static int _bench_process(audio_element_handle_t self, char *buffer, int len)
+{
+    int r_size = audio_element_input(self, buffer, len);
+    if (r_size <= (int)sizeof(int64_t)) {
+        return r_size;
+    }
+    int16_t *samples = (int16_t *)(buffer + sizeof(int64_t));
+    for (int i = 0; i < (r_size - sizeof(int64_t)) / sizeof(int16_t); i++) {
+        samples[i] = samples[i] - (samples[i] >> 2);
+    }
+    return audio_element_output(self, buffer, r_size);
+}
+
+static int _bench_process_zero_copy(audio_element_handle_t self, char *buffer, int len)
+{
+    char *block = NULL;
+    int r_size = audio_element_acquire_input_buf(self, &block);
+    if (r_size <= (int)sizeof(int64_t)) {
+        if (r_size > 0) {
+            audio_element_release_input_buf(self, block);
+        }
+        return r_size;
+    }
+    int16_t *samples = (int16_t *)(block + sizeof(int64_t));
+    for (int i = 0; i < (r_size - sizeof(int64_t)) / sizeof(int16_t); i++) {
+        samples[i] = samples[i] - (samples[i] >> 2);
+    }
+    return audio_element_commit_output_buf(self, block, r_size);
+}
+
+static int _bench_sink_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    bench_ctx_t *ctx = (bench_ctx_t *)context;
+    int64_t stamp;
+    memcpy(&stamp, buffer, sizeof(stamp));
+    int64_t latency = esp_timer_get_time() - stamp;
+    ctx->chunks++;
+    ctx->latency_sum += latency;
+    if (latency > ctx->latency_max) {
+        ctx->latency_max = latency;
+    }
+    return len;
+}
+
+static audio_pipeline_handle_t bench_pipeline_init(bench_mode_t mode, bench_ctx_t *ctx, audio_element_handle_t *sink)
+{
+    const char *tags[] = {"decoder", "resampler", "equalizer", "i2s"};
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pipeline_cfg.single_task = (mode == BENCH_SINGLE_TASK);
+    if (mode == BENCH_BUF_POOL) {
+        pipeline_cfg.buf_queue_depth = BENCH_QUEUE_DEPTH;
+        pipeline_cfg.buf_block_size = BENCH_CHUNK_SIZE;
+    }
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    TEST_ASSERT_NOT_NULL(pipeline);
+
+    audio_element_cfg_t el_cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    el_cfg.open = _bench_open;
+    el_cfg.process = (mode == BENCH_BUF_POOL) ? _bench_process_zero_copy : _bench_process;
+    el_cfg.buffer_len = BENCH_CHUNK_SIZE;
+    audio_element_handle_t el = NULL;
+    for (int i = 0; i < 4; i++) {
+        el = audio_element_init(&el_cfg);
+        TEST_ASSERT_NOT_NULL(el);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_register(pipeline, el, tags[i]));
+        if (i == 0) {
+            audio_element_set_read_cb(el, _bench_src_read, ctx);
+        }
+    }
+    audio_element_set_write_cb(el, _bench_sink_write, ctx);
+    *sink = el;
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_link(pipeline, tags, 4));
+    return pipeline;
+}
+
+static void bench_wait_for_finish(audio_event_iface_handle_t evt, audio_element_handle_t sink)
+{
+    while (1) {
+        audio_event_iface_msg_t msg;
+        TEST_ASSERT_EQUAL(ESP_OK, audio_event_iface_listen(evt, &msg, 10000 / portTICK_RATE_MS));
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *)sink
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS && (int)msg.data == AEL_STATUS_STATE_FINISHED) {
+            break;
+        }
+    }
+}
+
+static void bench_run(bench_mode_t mode)
+{
+    bench_ctx_t ctx = { .chunks_left = BENCH_CHUNK_COUNT };
+    audio_element_handle_t sink;
+    audio_pipeline_handle_t pipeline = bench_pipeline_init(mode, &ctx, &sink);
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_set_listener(pipeline, evt));
+
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_run(pipeline));
+    bench_wait_for_finish(evt, sink);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    printf("audio_pipeline benchmark: %-14s %d x %d B in %7lld us, %5lld us/chunk, latency avg %6lld us, max %6lld us\n",
+           bench_mode_name[mode], ctx.chunks, BENCH_CHUNK_SIZE, elapsed,
+           elapsed / BENCH_CHUNK_COUNT, ctx.latency_sum / (ctx.chunks ? ctx.chunks : 1), ctx.latency_max);
+    TEST_ASSERT_EQUAL(BENCH_CHUNK_COUNT, ctx.chunks);
+
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_deinit(pipeline));
+    audio_event_iface_destroy(evt);
+}
+
+TEST_CASE("audio_pipeline single task stop and restart", "esp-adf")
+{
+    bench_ctx_t ctx = { .chunks_left = -1 };
+    audio_element_handle_t sink;
+    audio_pipeline_handle_t pipeline = bench_pipeline_init(BENCH_SINGLE_TASK, &ctx, &sink);
+
+    for (int i = 0; i < 2; i++) {
+        int chunks = ctx.chunks;
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_run(pipeline));
+        TEST_ASSERT_EQUAL(AEL_STATE_RUNNING, audio_element_get_state(sink));
+        vTaskDelay(100 / portTICK_RATE_MS);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_pause(pipeline));
+        TEST_ASSERT_EQUAL(AEL_STATE_PAUSED, audio_element_get_state(sink));
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_resume(pipeline));
+        vTaskDelay(100 / portTICK_RATE_MS);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_stop(pipeline));
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_wait_for_stop(pipeline));
+        TEST_ASSERT_TRUE(ctx.chunks > chunks);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_deinit(pipeline));
+}
+
+#define STACK_TEST_EL_STACK     (6 * 1024)
+#define STACK_TEST_FRAME        (3 * 1024)
+
+static UBaseType_t s_stack_free;
+
+static int _stack_process(audio_element_handle_t self, char *buffer, int len)
+{
+    /* Stands in for a codec with large locals, fused elements nest one such frame each */
+    volatile char frame[STACK_TEST_FRAME];
+    for (int i = 0; i < sizeof(frame); i++) {
+        frame[i] = (char)i;
+    }
+    int r_size = audio_element_input(self, buffer, len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    return audio_element_output(self, buffer, r_size);
+}
+
+static int _stack_sink_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    UBaseType_t free_stack = uxTaskGetStackHighWaterMark(NULL);
+    if (s_stack_free == 0 || free_stack < s_stack_free) {
+        s_stack_free = free_stack;
+    }
+    return len;
+}
+
+TEST_CASE("audio_pipeline single task stack holds the whole chain", "esp-adf")
+{
+    const char *tags[] = {"decoder", "resampler", "equalizer", "i2s"};
+    bench_ctx_t ctx = { .chunks_left = 8 };
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pipeline_cfg.single_task = true;
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    TEST_ASSERT_NOT_NULL(pipeline);
+
+    audio_element_cfg_t el_cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    el_cfg.open = _bench_open;
+    el_cfg.process = _stack_process;
+    el_cfg.task_stack = STACK_TEST_EL_STACK;
+    el_cfg.buffer_len = 512;
+    audio_element_handle_t el = NULL;
+    for (int i = 0; i < 4; i++) {
+        el = audio_element_init(&el_cfg);
+        TEST_ASSERT_NOT_NULL(el);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_register(pipeline, el, tags[i]));
+        if (i == 0) {
+            audio_element_set_read_cb(el, _bench_src_read, &ctx);
+        }
+    }
+    audio_element_set_write_cb(el, _stack_sink_write, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_link(pipeline, tags, 4));
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_set_listener(pipeline, evt));
+
+    /* The sink runs with the frames of all four elements on the stack of the head,
+     * more than the stack of one element: the head task has the stack of the chain */
+    s_stack_free = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_run(pipeline));
+    bench_wait_for_finish(evt, el);
+    printf("audio_pipeline single task: %u bytes of stack left in the sink\n", (unsigned)s_stack_free);
+    TEST_ASSERT_TRUE(s_stack_free > STACK_TEST_FRAME);
+
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_deinit(pipeline));
+    audio_event_iface_destroy(evt);
+}
+
+TEST_CASE("audio_pipeline single task vs task per element benchmark", "esp-adf")
+{
+    esp_log_level_set("AUDIO_PIPELINE", ESP_LOG_WARN);
+    esp_log_level_set("AUDIO_ELEMENT", ESP_LOG_WARN);
+    bench_run(BENCH_TASK_PER_ELEMENT);
+    bench_run(BENCH_SINGLE_TASK);
+}
+
+TEST_CASE("audio_pipeline buffer pool vs ringbuffer benchmark", "esp-adf")
+{
+    esp_log_level_set("AUDIO_PIPELINE", ESP_LOG_WARN);
+    esp_log_level_set("AUDIO_ELEMENT", ESP_LOG_WARN);
+    bench_run(BENCH_TASK_PER_ELEMENT);
+    bench_run(BENCH_BUF_POOL);
+}
+
+/*
+ * Byte counter stream through a buffer pool pipeline mixing legacy elements, which read and write
+ * through the copy adapter with sizes not matching the pool blocks, and elements exchanging blocks.
+ */
+#define BQ_TEST_TOTAL_SIZE  (100 * 1000)
+#define BQ_TEST_BLOCK_SIZE  (1024)
+#define BQ_TEST_DEPTH       (2)
+
+typedef struct {
+    int     produced;
+    int     consumed;
+    bool    corrupted;
+} bq_test_ctx_t;
+
+static int _bq_src_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    bq_test_ctx_t *ctx = (bq_test_ctx_t *)context;
+    if (ctx->produced >= BQ_TEST_TOTAL_SIZE) {
+        return AEL_IO_DONE;
+    }
+    if (len > BQ_TEST_TOTAL_SIZE - ctx->produced) {
+        len = BQ_TEST_TOTAL_SIZE - ctx->produced;
+    }
+    for (int i = 0; i < len; i++) {
+        buffer[i] = (char)(ctx->produced + i);
+    }
+    ctx->produced += len;
+    return len;
+}
+
+static int _bq_sink_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    bq_test_ctx_t *ctx = (bq_test_ctx_t *)context;
+    for (int i = 0; i < len; i++) {
+        if (buffer[i] != (char)(ctx->consumed + i)) {
+            ctx->corrupted = true;
+        }
+    }
+    ctx->consumed += len;
+    return len;
+}
+
+static int _bq_copy_process(audio_element_handle_t self, char *buffer, int len)
+{
+    int r_size = audio_element_input(self, buffer, len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    return audio_element_output(self, buffer, r_size);
+}
+
+static int _bq_forward_process(audio_element_handle_t self, char *buffer, int len)
+{
+    char *block = NULL;
+    int r_size = audio_element_acquire_input_buf(self, &block);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    return audio_element_commit_output_buf(self, block, r_size);
+}
+
+static int _bq_new_block_process(audio_element_handle_t self, char *buffer, int len)
+{
+    char *in = NULL;
+    char *out = NULL;
+    int r_size = audio_element_acquire_input_buf(self, &in);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    int out_size = audio_element_acquire_output_buf(self, &out);
+    if (out_size < r_size) {
+        audio_element_release_input_buf(self, in);
+        return out_size > 0 ? AEL_IO_FAIL : out_size;
+    }
+    memcpy(out, in, r_size);
+    audio_element_release_input_buf(self, in);
+    return audio_element_commit_output_buf(self, out, r_size);
+}
+
+TEST_CASE("audio_pipeline buffer pool with zero copy and legacy elements", "esp-adf")
+{
+    const char *tags[] = {"src", "forward", "legacy", "new_block", "sink"};
+    const process_func processes[] = {_bq_copy_process, _bq_forward_process, _bq_copy_process, _bq_new_block_process, _bq_forward_process};
+    const int buffer_lens[] = {700, 0, 1500, BQ_TEST_BLOCK_SIZE, 0};
+    bq_test_ctx_t ctx = { 0 };
+
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pipeline_cfg.buf_queue_depth = BQ_TEST_DEPTH;
+    pipeline_cfg.buf_block_size = BQ_TEST_BLOCK_SIZE;
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    TEST_ASSERT_NOT_NULL(pipeline);
+
+    audio_element_handle_t els[5];
+    for (int i = 0; i < 5; i++) {
+        audio_element_cfg_t el_cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+        el_cfg.open = _bench_open;
+        el_cfg.process = processes[i];
+        el_cfg.buffer_len = buffer_lens[i];
+        els[i] = audio_element_init(&el_cfg);
+        TEST_ASSERT_NOT_NULL(els[i]);
+        TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_register(pipeline, els[i], tags[i]));
+    }
+    audio_element_set_read_cb(els[0], _bq_src_read, &ctx);
+    audio_element_set_write_cb(els[4], _bq_sink_write, &ctx);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_link(pipeline, tags, 5));
+    TEST_ASSERT_NULL(audio_element_get_output_ringbuf(els[0]));
+    buf_queue_handle_t bq = audio_element_get_output_buf_queue(els[0]);
+    TEST_ASSERT_NOT_NULL(bq);
+    TEST_ASSERT_EQUAL_PTR(bq, audio_element_get_input_buf_queue(els[1]));
+    buf_pool_handle_t pool = buf_queue_get_pool(bq);
+    int pool_blocks = buf_pool_get_free_blocks(pool);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, audio_pipeline_breakup_elements(pipeline, NULL));
+
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_set_listener(pipeline, evt));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_run(pipeline));
+    bench_wait_for_finish(evt, els[4]);
+
+    TEST_ASSERT_EQUAL(BQ_TEST_TOTAL_SIZE, ctx.consumed);
+    TEST_ASSERT_FALSE(ctx.corrupted);
+    TEST_ASSERT_EQUAL(pool_blocks, buf_pool_get_free_blocks(pool));
+
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_pipeline_deinit(pipeline));
+    audio_event_iface_destroy(evt);
+}
@@ -38,6 +38,7 @@
 #include "audio_element.h"
 #include "wav_head.h"
 #include "esp_log.h"
+#include "esp_vfs_fat.h"
 
 #define FILE_WAV_SUFFIX_TYPE  "wav"
 #define FILE_OPUS_SUFFIX_TYPE "opus"
@@ -60,6 +61,8 @@ typedef struct fatfs_stream {
     bool is_open;
     FILE *file;
     wr_stream_type_t w_type;
+    int prealloc_size;
+    bool preallocated;
 } fatfs_stream_t;
 
 
@@ -122,6 +125,15 @@ static esp_err_t _fatfs_open(audio_element_handle_t self)
     } else if (fatfs->type == AUDIO_STREAM_WRITER) {
         fatfs->file = fopen(path, "w+");
         fatfs->w_type =  get_type(path);
+        fatfs->preallocated = false;
+        if (fatfs->file && fatfs->prealloc_size > 0) {
+            esp_err_t ret = esp_vfs_fat_preallocate(fileno(fatfs->file), fatfs->prealloc_size, true);
+            if (ret == ESP_OK) {
+                fatfs->preallocated = true;
+            } else {
+                ESP_LOGW(TAG, "Failed to preallocate %d bytes, ret:%x, file will grow on demand", fatfs->prealloc_size, ret);
+            }
+        }
         if (fatfs->file && STREAM_TYPE_WAV == fatfs->w_type) {
             wav_header_t info = {0};
             fwrite(&info, 1, sizeof(wav_header_t), fatfs->file);
@@ -197,7 +209,11 @@ static int _fatfs_process(audio_element_handle_t self, char *in_buffer, int in_l
 static esp_err_t _fatfs_close(audio_element_handle_t self)
 {
     fatfs_stream_t *fatfs = (fatfs_stream_t *)audio_element_getdata(self);
+    long end_pos = -1;
 
+    if (fatfs->preallocated && fatfs->file) {
+        end_pos = ftell(fatfs->file);
+    }
     if (AUDIO_STREAM_WRITER == fatfs->type
         && fatfs->file
         && STREAM_TYPE_WAV == fatfs->w_type) {
@@ -217,6 +233,14 @@ static esp_err_t _fatfs_close(audio_element_handle_t self)
         audio_free(wav_info);
     }
 
+    if (end_pos >= 0) {
+        // Release the part of the preallocated area which was not recorded
+        fflush(fatfs->file);
+        if (ftruncate(fileno(fatfs->file), end_pos) != 0) {
+            ESP_LOGE(TAG, "Failed to truncate file to %ld bytes, errno:%d", end_pos, errno);
+        }
+        fatfs->preallocated = false;
+    }
     if (fatfs->is_open) {
         fclose(fatfs->file);
         fatfs->is_open = false;
@@ -262,6 +286,7 @@ audio_element_handle_t fatfs_stream_init(fatfs_stream_cfg_t *config)
 
     cfg.tag = "file";
     fatfs->type = config->type;
+    fatfs->prealloc_size = config->prealloc_size;
 
     if (config->type == AUDIO_STREAM_WRITER) {
         cfg.write = _fatfs_write;
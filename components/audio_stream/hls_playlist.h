@@ -44,7 +44,8 @@ typedef struct {
     int             total_read;
     track_list_t    tracks;
     int             total_tracks;
-    int             content_length;
+    int             content_length;     /* 0 if not known, then the playlist is read until no more data comes */
+    bool            is_read_done;
     bool            is_incomplete;      /* Indicates if playlist is live stream and must be fetched again */
 } playlist_t;
 
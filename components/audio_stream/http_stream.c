@@ -53,6 +53,7 @@ typedef struct http_stream {
     audio_stream_type_t             stream_type;
     void                            *user_data;
     bool                            enable_playlist_parser;
+    bool                            enable_decompression;
     bool                            auto_connect_next_track; /* connect next track without open/close */
     bool                            is_variant_playlist;
     bool                            is_playlist_resolved;
@@ -139,6 +140,15 @@ static bool _is_playlist(audio_element_info_t *info, const char *uri)
     return false;
 }
 
+static bool _playlist_read_done(http_stream_t *http)
+{
+    if (http->playlist->content_length > 0) {
+        return http->playlist->total_read >= http->playlist->content_length;
+    }
+    /* Chunked or decoded playlist */
+    return http->playlist->is_read_done;
+}
+
 static bool _get_line_in_buffer(http_stream_t *http, char **out)
 {
     *out = NULL;
@@ -159,7 +169,7 @@ static bool _get_line_in_buffer(http_stream_t *http, char **out)
             }
             idx++;
         }
-        if (http->playlist->total_read >= http->playlist->content_length) {
+        if (_playlist_read_done(http)) {
             http->playlist->remain = 0;
             return true; // This is the last remaining line
         }
@@ -177,7 +187,7 @@ static char *_client_read_line(http_stream_t *http)
         return line;
     }
 
-    if (http->playlist->total_read >= http->playlist->content_length) {
+    if (_playlist_read_done(http)) {
         return NULL;
     }
 
@@ -195,6 +205,11 @@ static char *_client_read_line(http_stream_t *http)
             if (_get_line_in_buffer(http, &line)) {
                 return line;
             }
+        } else if (http->playlist->content_length <= 0) {
+            http->playlist->is_read_done = true;
+            if (_get_line_in_buffer(http, &line)) {
+                return line;
+            }
         }
     }
 
@@ -229,6 +244,7 @@ static esp_err_t _resolve_playlist(audio_element_handle_t self, const char *uri)
     http->playlist->remain = 0;
     http->playlist->index = 0;
     http->playlist->total_read = 0;
+    http->playlist->is_read_done = false;
     if (http->playlist->host_uri) {
         audio_free(http->playlist->host_uri);
     }
@@ -359,6 +375,7 @@ _stream_open_begin:
             .user_data = &info,
             .timeout_ms = 30 * 1000,
             .buffer_size = HTTP_STREAM_BUFFER_SIZE,
+            .decompress_response = http->enable_decompression,
         };
         http->client = esp_http_client_init(&http_cfg);
         AUDIO_MEM_CHECK(TAG, http->client, return ESP_ERR_NO_MEM);
@@ -624,6 +641,7 @@ audio_element_handle_t http_stream_init(http_stream_cfg_t *config)
 
     http->type = config->type;
     http->enable_playlist_parser = config->enable_playlist_parser;
+    http->enable_decompression = config->enable_decompression;
     http->auto_connect_next_track = config->auto_connect_next_track;
     http->hook = config->event_handle;
     http->stream_type = config->type;
@@ -44,6 +44,8 @@ typedef struct {
     int                     task_core;      /*!< Task running in core (0 or 1) */
     int                     task_prio;      /*!< Task priority (based on freeRTOS priority) */
     bool                    ext_stack;      /*!< Allocate stack on extern ram */
+    int                     prealloc_size;  /*!< Writer only: bytes to preallocate contiguously when the file is created, 0 to let the file grow on demand.
+                                                 The unused part of the preallocated area is released when the stream is closed */
 } fatfs_stream_cfg_t;
 
 
@@ -60,7 +62,8 @@ typedef struct {
     .task_stack = FATFS_STREAM_TASK_STACK,       \
     .task_core = FATFS_STREAM_TASK_CORE,         \
     .task_prio = FATFS_STREAM_TASK_PRIO,         \
-    .ext_stack = false                           \
+    .ext_stack = false,                          \
+    .prealloc_size = 0,                          \
 }
 
 /**
@@ -84,6 +84,8 @@ typedef struct {
     void                        *user_data;             /*!< User data context */
     bool                        auto_connect_next_track;/*!< connect next track without open/close */
     bool                        enable_playlist_parser; /*!< Enable playlist parser*/
+    bool                        enable_decompression;   /*!< Request gzip or deflate compressed responses, such as playlists, and decode them.
+                                                             Needs CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION, the total bytes of a decoded response are not known */
     int                         multi_out_num;          /*!< The number of multiple output */
 } http_stream_cfg_t;
 
@@ -104,6 +106,7 @@ typedef struct {
     .user_data = NULL,                           \
     .auto_connect_next_track = false,            \
     .enable_playlist_parser = false,             \
+    .enable_decompression = false,               \
     .multi_out_num = 0,                          \
 }
 
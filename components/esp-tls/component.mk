@@ -9,6 +9,10 @@ ifneq ($(CONFIG_ESP_TLS_USING_MBEDTLS), )
 COMPONENT_OBJS += esp_tls_mbedtls.o
 endif
 
+ifneq ($(CONFIG_ESP_TLS_CLIENT_SESSION_CACHE), )
+COMPONENT_OBJS += esp_tls_session_cache.o
+endif
+
 ifneq ($(CONFIG_ESP_TLS_USING_WOLFSSL), )
 COMPONENT_OBJS += esp_tls_wolfssl.o
 endif
@@ -205,6 +205,9 @@ typedef struct esp_tls_cfg {
                                             /*!< Function pointer to esp_crt_bundle_attach. Enables the use of certification
                                                  bundle for server verification, must be enabled in menuconfig */
 
+    bool skip_session_cache;                /*!< Do not resume a cached session nor cache the session of this connection,
+                                                 when the client session cache is enabled in menuconfig */
+
 } esp_tls_cfg_t;
 
 #ifdef CONFIG_ESP_TLS_SERVER
@@ -295,6 +298,10 @@ typedef struct esp_tls {
     mbedtls_pk_context serverkey;                                               /*!< Container for the private key of the server
                                                                                    certificate */
 #endif
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    struct esp_tls_session_key *session_key;                                    /*!< Entry of the connection in the client
+                                                                                     session cache */
+#endif
 #elif CONFIG_ESP_TLS_USING_WOLFSSL
     void *priv_ctx;
     void *priv_ssl;
@@ -589,6 +596,45 @@ esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tl
 mbedtls_x509_crt *esp_tls_get_global_ca_store(void);
 
 #endif /* CONFIG_ESP_TLS_USING_MBEDTLS */
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+/**
+ * @brief      Statistics of the client session cache
+ *
+ * The resumption hit rate is resumed / lookups: hits that are not resumed
+ * were refused by the server, which then performed a full handshake.
+ */
+typedef struct esp_tls_session_cache_stats {
+    uint32_t lookups;       /*!< Client handshakes which looked for a cached session */
+    uint32_t hits;          /*!< Handshakes which offered a cached session to the server */
+    uint32_t resumed;       /*!< Handshakes in which the server resumed the offered session */
+    uint32_t stored;        /*!< Sessions added to the cache or updated */
+    uint32_t evictions;     /*!< Sessions dropped to make room for another host */
+    uint32_t expirations;   /*!< Sessions dropped at the end of their lifetime */
+    uint32_t entries;       /*!< Sessions currently in the cache */
+} esp_tls_session_cache_stats_t;
+
+/**
+ * @brief      Get the statistics of the client session cache
+ *
+ * The counters are cumulative since boot, esp_tls_session_cache_clear() does not reset them.
+ *
+ * @param[out] stats  Statistics
+ *
+ * @return
+ *             - ESP_OK
+ *             - ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t esp_tls_session_cache_get_stats(esp_tls_session_cache_stats_t *stats);
+
+/**
+ * @brief      Drop all the sessions of the client session cache
+ *
+ * The next connection to each host performs a full handshake, for instance
+ * after changing the trusted certificates.
+ */
+void esp_tls_session_cache_clear(void);
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
+
 #ifdef CONFIG_ESP_TLS_SERVER
 /**
  * @brief      Create TLS/SSL server session
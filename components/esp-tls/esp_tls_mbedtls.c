@@ -30,6 +30,12 @@
 #include "esp_crt_bundle.h"
 #endif
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+#include "esp_tls_session_cache.h"
+static void session_cache_load(const char *hostname, size_t hostlen, const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+static void session_cache_update(esp_tls_t *tls);
+#endif
+
 #ifdef CONFIG_ESP_TLS_USE_SECURE_ELEMENT
 
 #define ATECC608A_TNG_SLAVE_ADDR        0x6A
@@ -111,6 +117,11 @@ esp_err_t esp_create_mbedtls_handle(const char *hostname, size_t hostlen, const
     }
     mbedtls_ssl_set_bio(&tls->ssl, &tls->server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    if (tls->role == ESP_TLS_CLIENT && !((esp_tls_cfg_t *)cfg)->skip_session_cache) {
+        session_cache_load(hostname, hostlen, (esp_tls_cfg_t *)cfg, tls);
+    }
+#endif
     return ESP_OK;
 
 exit:
@@ -125,10 +136,19 @@ int esp_mbedtls_handshake(esp_tls_t *tls, const esp_tls_cfg_t *cfg)
     ret = mbedtls_ssl_handshake(&tls->ssl);
     if (ret == 0) {
         tls->conn_state = ESP_TLS_DONE;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+        session_cache_update(tls);
+#endif
         return 1;
     } else {
         if (ret != ESP_TLS_ERR_SSL_WANT_READ && ret != ESP_TLS_ERR_SSL_WANT_WRITE) {
             ESP_LOGE(TAG, "mbedtls_ssl_handshake returned -0x%x", -ret);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+            if (tls->session_key && tls->session_key->offered) {
+                /* Do not offer the session again, in case it is the culprit */
+                esp_tls_session_cache_remove(tls->session_key);
+            }
+#endif
             ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ERR_TYPE_MBEDTLS, -ret);
             ESP_INT_EVENT_TRACKER_CAPTURE(tls->error_handle, ERR_TYPE_ESP, ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED);
             if (cfg->cacert_buf != NULL || cfg->use_global_ca_store == true) {
@@ -244,6 +264,10 @@ void esp_mbedtls_cleanup(esp_tls_t *tls)
     mbedtls_ssl_config_free(&tls->conf);
     mbedtls_ctr_drbg_free(&tls->ctr_drbg);
     mbedtls_ssl_free(&tls->ssl);
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+    esp_tls_session_key_destroy(tls->session_key);
+    tls->session_key = NULL;
+#endif
 #ifdef CONFIG_ESP_TLS_USE_SECURE_ELEMENT
     atcab_release();
 #endif
@@ -591,6 +615,87 @@ void esp_mbedtls_free_global_ca_store(void)
     }
 }
 
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_CACHE
+static uint16_t get_peer_port(int sockfd)
+{
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(sockfd, (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.ss_family == AF_INET) {
+        return ntohs(((struct sockaddr_in *)&addr)->sin_port);
+    } else if (addr.ss_family == AF_INET6) {
+        return ntohs(((struct sockaddr_in6 *)&addr)->sin6_port);
+    }
+    return 0;
+}
+
+static int session_apply(const void *session, void *ctx)
+{
+    esp_tls_t *tls = (esp_tls_t *)ctx;
+    const mbedtls_ssl_session *cached = (const mbedtls_ssl_session *)session;
+    int ret = mbedtls_ssl_set_session(&tls->ssl, cached);
+    if (ret != 0) {
+        ESP_LOGD(TAG, "mbedtls_ssl_set_session returned -0x%x", -ret);
+        return ret;
+    }
+    /* The master secret stays the same if the server resumes the session */
+    memcpy(tls->session_key->master, cached->master, ESP_TLS_SESSION_MASTER_LEN);
+    tls->session_key->offered = true;
+    return 0;
+}
+
+static void session_free(void *session)
+{
+    mbedtls_ssl_session_free((mbedtls_ssl_session *)session);
+    free(session);
+}
+
+static void session_cache_load(const char *hostname, size_t hostlen, const esp_tls_cfg_t *cfg, esp_tls_t *tls)
+{
+    /* Without a key the connection simply goes on with a full handshake */
+    tls->session_key = esp_tls_session_key_create(hostname, hostlen, get_peer_port(tls->sockfd), cfg);
+    if (tls->session_key && esp_tls_session_cache_lookup(tls->session_key, session_apply, tls)) {
+        ESP_LOGD(TAG, "Offering cached session of %s:%d", tls->session_key->host, tls->session_key->port);
+    }
+}
+
+static void session_cache_update(esp_tls_t *tls)
+{
+    esp_tls_session_key_t *key = tls->session_key;
+    if (!key) {
+        return;
+    }
+    const mbedtls_ssl_session *active = tls->ssl.session;
+    bool resumed = key->offered && memcmp(active->master, key->master, ESP_TLS_SESSION_MASTER_LEN) == 0;
+    bool resumable = active->id_len > 0;
+    uint32_t lifetime = 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    if (active->ticket_len > 0) {
+        resumable = true;
+        lifetime = active->ticket_lifetime;
+    }
+#endif
+    ESP_LOGD(TAG, "Session with %s:%d %s", key->host, key->port, resumed ? "resumed" : "established");
+
+    mbedtls_ssl_session *session = NULL;
+    if (resumable) {
+        session = calloc(1, sizeof(mbedtls_ssl_session));
+        if (session) {
+            mbedtls_ssl_session_init(session);
+            int ret = mbedtls_ssl_get_session(&tls->ssl, session);
+            if (ret != 0) {
+                ESP_LOGD(TAG, "mbedtls_ssl_get_session returned -0x%x", -ret);
+                session_free(session);
+                session = NULL;
+            }
+        }
+    }
+    esp_tls_session_cache_store(key, session, session_free, lifetime, resumed);
+}
+#endif /* CONFIG_ESP_TLS_CLIENT_SESSION_CACHE */
+
 #ifdef CONFIG_ESP_TLS_USE_SECURE_ELEMENT
 static esp_err_t esp_init_atecc608a(uint8_t slave_addr)
 {
@@ -0,0 +1,234 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdlib.h>
+#include <string.h>
+#include <sys/lock.h>
+
+#include "esp_tls_session_cache.h"
+#include "esp_private/lru_cache.h"
+#include "esp_log.h"
+
+static const char *TAG = "esp-tls-session";
+
+typedef struct {
+    char *host;
+    uint16_t port;
+    uint32_t config_hash;
+    void *session;                      /* NULL if the entry is free */
+    esp_tls_session_free_t free_fn;
+    int64_t expiry;                     /* Monotonic time in seconds */
+    uint32_t last_used;
+} session_entry_t;
+
+static session_entry_t s_entries[CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE];
+static uint32_t s_use_count;
+static esp_tls_session_cache_stats_t s_stats;
+static _lock_t s_lock;
+
+static uint32_t config_hash(const esp_tls_cfg_t *cfg)
+{
+    uint32_t hash = ESP_LRU_CACHE_HASH_INIT;
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->cacert_buf);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->cacert_bytes);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->use_global_ca_store);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->crt_bundle_attach);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->psk_hint_key);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->clientcert_buf);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->clientcert_bytes);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->clientkey_buf);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->use_secure_element);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, cfg->skip_common_name);
+    if (cfg->common_name) {
+        hash = esp_lru_cache_hash(hash, cfg->common_name, strlen(cfg->common_name) + 1);
+    }
+    return hash;
+}
+
+esp_tls_session_key_t *esp_tls_session_key_create(const char *host, size_t hostlen, uint16_t port, const esp_tls_cfg_t *cfg)
+{
+    esp_tls_session_key_t *key = calloc(1, sizeof(esp_tls_session_key_t));
+    if (!key) {
+        return NULL;
+    }
+    key->host = strndup(host, hostlen);
+    if (!key->host) {
+        free(key);
+        return NULL;
+    }
+    key->port = port;
+    key->config_hash = config_hash(cfg);
+    return key;
+}
+
+void esp_tls_session_key_destroy(esp_tls_session_key_t *key)
+{
+    if (key) {
+        /* The master secret must not linger on the heap */
+        volatile unsigned char *p = key->master;
+        for (size_t i = 0; i < sizeof(key->master); i++) {
+            p[i] = 0;
+        }
+        free(key->host);
+        free(key);
+    }
+}
+
+static void entry_free(session_entry_t *entry)
+{
+    entry->free_fn(entry->session);
+    free(entry->host);
+    memset(entry, 0, sizeof(session_entry_t));
+}
+
+static session_entry_t *entry_find(const esp_tls_session_key_t *key)
+{
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        session_entry_t *entry = &s_entries[i];
+        if (entry->session && entry->port == key->port && entry->config_hash == key->config_hash &&
+                strcmp(entry->host, key->host) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Free entry if there is one, else the one of an expired session, else the least recently used one */
+static session_entry_t *entry_alloc(int64_t now)
+{
+    session_entry_t *lru = NULL;
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        session_entry_t *entry = &s_entries[i];
+        if (!entry->session) {
+            return entry;
+        }
+        if (entry->expiry <= now) {
+            s_stats.expirations++;
+            entry_free(entry);
+            return entry;
+        }
+        if (!lru || esp_lru_cache_used_before(entry->last_used, lru->last_used)) {
+            lru = entry;
+        }
+    }
+    ESP_LOGD(TAG, "evicting session of %s:%d", lru->host, lru->port);
+    s_stats.evictions++;
+    entry_free(lru);
+    return lru;
+}
+
+bool esp_tls_session_cache_lookup(esp_tls_session_key_t *key, esp_tls_session_apply_t apply, void *ctx)
+{
+    bool applied = false;
+    _lock_acquire(&s_lock);
+    s_stats.lookups++;
+    session_entry_t *entry = entry_find(key);
+    if (entry && entry->expiry <= esp_lru_cache_now()) {
+        ESP_LOGD(TAG, "session of %s:%d expired", entry->host, entry->port);
+        s_stats.expirations++;
+        entry_free(entry);
+        entry = NULL;
+    }
+    if (entry && apply(entry->session, ctx) == 0) {
+        entry->last_used = ++s_use_count;
+        s_stats.hits++;
+        applied = true;
+    }
+    _lock_release(&s_lock);
+    return applied;
+}
+
+void esp_tls_session_cache_store(const esp_tls_session_key_t *key, void *session, esp_tls_session_free_t free_fn,
+                                 uint32_t lifetime_s, bool resumed)
+{
+    int64_t now = esp_lru_cache_now();
+    int64_t expiry = now + CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_LIFETIME;
+    if (lifetime_s && lifetime_s < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_LIFETIME) {
+        expiry = now + lifetime_s;
+    }
+
+    _lock_acquire(&s_lock);
+    if (resumed) {
+        s_stats.resumed++;
+    }
+    session_entry_t *entry = entry_find(key);
+    if (!session) {
+        /* The server did not provide a resumable session, the one we had is of no use */
+        if (entry && !resumed) {
+            entry_free(entry);
+        }
+        _lock_release(&s_lock);
+        return;
+    }
+    if (entry) {
+        if (resumed && entry->expiry < expiry) {
+            expiry = entry->expiry;
+        }
+        entry->free_fn(entry->session);
+    } else {
+        entry = entry_alloc(now);
+        entry->host = strdup(key->host);
+        if (!entry->host) {
+            memset(entry, 0, sizeof(session_entry_t));
+            _lock_release(&s_lock);
+            free_fn(session);
+            return;
+        }
+        entry->port = key->port;
+        entry->config_hash = key->config_hash;
+    }
+    entry->session = session;
+    entry->free_fn = free_fn;
+    entry->expiry = expiry;
+    entry->last_used = ++s_use_count;
+    s_stats.stored++;
+    _lock_release(&s_lock);
+}
+
+void esp_tls_session_cache_remove(const esp_tls_session_key_t *key)
+{
+    _lock_acquire(&s_lock);
+    session_entry_t *entry = entry_find(key);
+    if (entry) {
+        entry_free(entry);
+    }
+    _lock_release(&s_lock);
+}
+
+esp_err_t esp_tls_session_cache_get_stats(esp_tls_session_cache_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _lock_acquire(&s_lock);
+    *stats = s_stats;
+    stats->entries = 0;
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (s_entries[i].session) {
+            stats->entries++;
+        }
+    }
+    _lock_release(&s_lock);
+    return ESP_OK;
+}
+
+void esp_tls_session_cache_clear(void)
+{
+    _lock_acquire(&s_lock);
+    for (int i = 0; i < CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE; i++) {
+        if (s_entries[i].session) {
+            entry_free(&s_entries[i]);
+        }
+    }
+    _lock_release(&s_lock);
+}
@@ -0,0 +1,101 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Size of the TLS master secret, used to tell a resumed handshake from a full one
+ */
+#define ESP_TLS_SESSION_MASTER_LEN  48
+
+/**
+ * Identifies the cache entry of a client connection
+ *
+ * Sessions are only resumed with the same host and port, and with the same
+ * server authentication settings: a session established without verifying
+ * the server must not be reused by a connection which requires verification.
+ */
+typedef struct esp_tls_session_key {
+    char *host;                                         /*!< Host name, null-terminated */
+    uint16_t port;                                      /*!< Port of the server */
+    uint32_t config_hash;                               /*!< Hash of the authentication settings of esp_tls_cfg_t */
+    bool offered;                                       /*!< A cached session was offered in the handshake */
+    unsigned char master[ESP_TLS_SESSION_MASTER_LEN];   /*!< Master secret of the offered session */
+} esp_tls_session_key_t;
+
+/**
+ * Copies a cached session into the TLS context, called with the cache locked
+ */
+typedef int (*esp_tls_session_apply_t)(const void *session, void *ctx);
+
+/**
+ * Frees a session owned by the cache
+ */
+typedef void (*esp_tls_session_free_t)(void *session);
+
+/**
+ * Create the cache key of a client connection
+ *
+ * @return Key, or NULL if out of memory
+ */
+esp_tls_session_key_t *esp_tls_session_key_create(const char *host, size_t hostlen, uint16_t port, const esp_tls_cfg_t *cfg);
+
+/**
+ * Free a key created by esp_tls_session_key_create(), may be NULL
+ */
+void esp_tls_session_key_destroy(esp_tls_session_key_t *key);
+
+/**
+ * Look up the session of a key and pass it to apply
+ *
+ * Expired sessions are dropped on the way. The lookup counts as a hit if
+ * apply returns 0.
+ *
+ * @return true if a session was applied
+ */
+bool esp_tls_session_cache_lookup(esp_tls_session_key_t *key, esp_tls_session_apply_t apply, void *ctx);
+
+/**
+ * Store the session of a completed handshake
+ *
+ * The cache takes ownership of session, even on failure. The lifetime of the
+ * entry is the configured one, capped by lifetime_s when non-zero. A resumed
+ * session keeps the expiry of the entry it came from, as its master secret
+ * is the same. A NULL session records the outcome of a handshake which did
+ * not yield a resumable session, and drops the cached one unless resumed.
+ *
+ * @param[in] key         Key of the connection
+ * @param[in] session     Session, freed with free_fn, may be NULL
+ * @param[in] free_fn     Function freeing session
+ * @param[in] lifetime_s  Lifetime announced by the server, 0 if none
+ * @param[in] resumed     The handshake resumed the offered session
+ */
+void esp_tls_session_cache_store(const esp_tls_session_key_t *key, void *session, esp_tls_session_free_t free_fn,
+                                 uint32_t lifetime_s, bool resumed);
+
+/**
+ * Drop the session of a key, after a handshake that offered it failed
+ */
+void esp_tls_session_cache_remove(const esp_tls_session_key_t *key);
+
+#ifdef __cplusplus
+}
+#endif
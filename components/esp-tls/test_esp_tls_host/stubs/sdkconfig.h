@@ -0,0 +1,5 @@
+#pragma once
+
+#define CONFIG_ESP_TLS_CLIENT_SESSION_CACHE             1
+#define CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_SIZE        3
+#define CONFIG_ESP_TLS_CLIENT_SESSION_CACHE_LIFETIME    3600
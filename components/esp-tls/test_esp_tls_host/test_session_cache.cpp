@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <string.h>
+#include <set>
+#include "catch.hpp"
+#include "esp_tls_session_cache.h"
+
+extern "C" int64_t fake_clock_s;
+
+namespace {
+
+struct fake_session {
+    int id;
+};
+
+std::set<int> live_sessions;
+
+void free_session(void *session)
+{
+    fake_session *s = static_cast<fake_session *>(session);
+    live_sessions.erase(s->id);
+    delete s;
+}
+
+void *new_session(int id)
+{
+    live_sessions.insert(id);
+    return new fake_session{id};
+}
+
+int apply_session(const void *session, void *ctx)
+{
+    *static_cast<int *>(ctx) = static_cast<const fake_session *>(session)->id;
+    return 0;
+}
+
+int refuse_session(const void *session, void *ctx)
+{
+    return -1;
+}
+
+struct key_holder {
+    esp_tls_session_key_t *key;
+    key_holder(const char *host, uint16_t port, const esp_tls_cfg_t &cfg)
+    {
+        key = esp_tls_session_key_create(host, strlen(host), port, &cfg);
+        REQUIRE(key != nullptr);
+    }
+    key_holder(const char *host, uint16_t port = 443) : key_holder(host, port, esp_tls_cfg_t()) {}
+    ~key_holder()
+    {
+        esp_tls_session_key_destroy(key);
+    }
+    int lookup()
+    {
+        int id = -1;
+        esp_tls_session_cache_lookup(key, apply_session, &id);
+        return id;
+    }
+    void store(int id, uint32_t lifetime_s = 0, bool resumed = false)
+    {
+        esp_tls_session_cache_store(key, new_session(id), free_session, lifetime_s, resumed);
+    }
+};
+
+esp_tls_session_cache_stats_t get_stats()
+{
+    esp_tls_session_cache_stats_t stats;
+    REQUIRE(esp_tls_session_cache_get_stats(&stats) == ESP_OK);
+    return stats;
+}
+
+struct cache_fixture {
+    esp_tls_session_cache_stats_t before;
+    cache_fixture()
+    {
+        esp_tls_session_cache_clear();
+        before = get_stats();
+    }
+    ~cache_fixture()
+    {
+        esp_tls_session_cache_clear();
+        CHECK(live_sessions.empty());
+    }
+};
+
+} // namespace
+
+TEST_CASE_METHOD(cache_fixture, "session of a host is found by later connections", "[esp_tls_session_cache]")
+{
+    key_holder first("example.com");
+    CHECK(first.lookup() == -1);
+    first.store(1);
+
+    key_holder second("example.com");
+    CHECK(second.lookup() == 1);
+
+    esp_tls_session_cache_stats_t stats = get_stats();
+    CHECK(stats.lookups - before.lookups == 2);
+    CHECK(stats.hits - before.hits == 1);
+    CHECK(stats.stored - before.stored == 1);
+    CHECK(stats.entries == 1);
+}
+
+TEST_CASE_METHOD(cache_fixture, "sessions are keyed by host, port and authentication settings", "[esp_tls_session_cache]")
+{
+    static const unsigned char ca[] = "ca";
+    esp_tls_cfg_t cfg = {};
+    cfg.cacert_buf = ca;
+    cfg.cacert_bytes = sizeof(ca);
+    key_holder("example.com", 443, cfg).store(1);
+
+    CHECK(key_holder("example.com", 443, cfg).lookup() == 1);
+    CHECK(key_holder("example.com", 8443, cfg).lookup() == -1);
+    CHECK(key_holder("example.org", 443, cfg).lookup() == -1);
+    /* A session of a verified server must not be used without verification, and conversely */
+    CHECK(key_holder("example.com", 443).lookup() == -1);
+
+    esp_tls_cfg_t other_cn = cfg;
+    other_cn.common_name = "other.example.com";
+    CHECK(key_holder("example.com", 443, other_cn).lookup() == -1);
+
+    esp_tls_cfg_t same = cfg;
+    same.timeout_ms = 1000;
+    same.non_block = true;
+    CHECK(key_holder("example.com", 443, same).lookup() == 1);
+
+    /* Host names are compared up to hostlen */
+    esp_tls_session_key_t *key = esp_tls_session_key_create("example.com:443", 11, 443, &cfg);
+    int id = -1;
+    CHECK(esp_tls_session_cache_lookup(key, apply_session, &id));
+    CHECK(id == 1);
+    esp_tls_session_key_destroy(key);
+}
+
+TEST_CASE_METHOD(cache_fixture, "least recently used session is evicted", "[esp_tls_session_cache]")
+{
+    key_holder a("a"), b("b"), c("c"), d("d");
+    a.store(1);
+    b.store(2);
+    c.store(3);
+    CHECK(a.lookup() == 1);
+    d.store(4);
+
+    CHECK(live_sessions == std::set<int>({1, 3, 4}));
+    CHECK(b.lookup() == -1);
+    CHECK(a.lookup() == 1);
+    CHECK(c.lookup() == 3);
+    CHECK(d.lookup() == 4);
+
+    esp_tls_session_cache_stats_t stats = get_stats();
+    CHECK(stats.evictions - before.evictions == 1);
+    CHECK(stats.entries == 3);
+}
+
+TEST_CASE_METHOD(cache_fixture, "updating a session replaces it in place", "[esp_tls_session_cache]")
+{
+    key_holder a("a"), b("b"), c("c"), d("d");
+    a.store(1);
+    b.store(2);
+    c.store(3);
+    a.store(4);
+    CHECK(live_sessions == std::set<int>({2, 3, 4}));
+    CHECK(a.lookup() == 4);
+    /* a was the most recently stored, b goes */
+    d.store(5);
+    CHECK(live_sessions == std::set<int>({3, 4, 5}));
+}
+
+TEST_CASE_METHOD(cache_fixture, "sessions expire", "[esp_tls_session_cache]")
+{
+    key_holder a("a"), b("b"), c("c"), d("d");
+    a.store(1);
+    b.store(2, 100);
+    fake_clock_s += 99;
+    CHECK(b.lookup() == 2);
+    fake_clock_s += 1;
+    CHECK(b.lookup() == -1);
+
+    /* The server lifetime does not extend the configured one */
+    c.store(3, 100000);
+    fake_clock_s += 3599;
+    CHECK(c.lookup() == 3);
+    fake_clock_s += 1;
+    CHECK(c.lookup() == -1);
+    CHECK(live_sessions == std::set<int>({1}));
+
+    /* Expired entries are reused before evicting live ones */
+    b.store(4);
+    c.store(5);
+    d.store(6);
+    CHECK(live_sessions == std::set<int>({4, 5, 6}));
+
+    esp_tls_session_cache_stats_t stats = get_stats();
+    CHECK(stats.expirations - before.expirations == 3);
+    CHECK(stats.evictions == before.evictions);
+}
+
+TEST_CASE_METHOD(cache_fixture, "resumed session keeps its expiry", "[esp_tls_session_cache]")
+{
+    key_holder a("a"), b("b");
+    a.store(1);
+    b.store(2);
+    fake_clock_s += 3000;
+    CHECK(a.lookup() == 1);
+    a.store(3, 0, true);
+    CHECK(b.lookup() == 2);
+    b.store(4, 0, false);
+
+    fake_clock_s += 600;
+    CHECK(a.lookup() == -1);
+    CHECK(b.lookup() == 4);
+
+    esp_tls_session_cache_stats_t stats = get_stats();
+    CHECK(stats.resumed - before.resumed == 1);
+}
+
+TEST_CASE_METHOD(cache_fixture, "handshake without resumable session drops the cached one", "[esp_tls_session_cache]")
+{
+    key_holder a("a"), b("b");
+    a.store(1);
+    b.store(2);
+
+    esp_tls_session_cache_store(a.key, NULL, free_session, 0, true);
+    CHECK(a.lookup() == 1);
+    esp_tls_session_cache_store(a.key, NULL, free_session, 0, false);
+    CHECK(a.lookup() == -1);
+
+    esp_tls_session_cache_remove(b.key);
+    CHECK(b.lookup() == -1);
+    CHECK(live_sessions.empty());
+}
+
+TEST_CASE_METHOD(cache_fixture, "session refused by the TLS context is not a hit", "[esp_tls_session_cache]")
+{
+    key_holder a("a");
+    a.store(1);
+    CHECK_FALSE(esp_tls_session_cache_lookup(a.key, refuse_session, NULL));
+    esp_tls_session_cache_stats_t stats = get_stats();
+    CHECK(stats.lookups - before.lookups == 1);
+    CHECK(stats.hits == before.hits);
+    CHECK(stats.entries == 1);
+}
+
+TEST_CASE_METHOD(cache_fixture, "clear drops all the sessions", "[esp_tls_session_cache]")
+{
+    key_holder("a").store(1);
+    key_holder("b").store(2);
+    esp_tls_session_cache_clear();
+    CHECK(live_sessions.empty());
+    CHECK(get_stats().entries == 0);
+    CHECK(key_holder("a").lookup() == -1);
+    CHECK(esp_tls_session_cache_get_stats(NULL) == ESP_ERR_INVALID_ARG);
+}
@@ -0,0 +1,96 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Helpers of the small caches of IDF components, such as the TLS session
+ * cache of esp-tls and the connection pool of esp_http_client.
+ *
+ * These keep a few entries, e.g. one per server the device talks to, in a
+ * fixed table which is scanned linearly. Entries are keyed by a hash of
+ * their settings, stamped with an LRU counter, and expire after some time.
+ */
+
+/**
+ * Initial value of esp_lru_cache_hash()
+ */
+#define ESP_LRU_CACHE_HASH_INIT     2166136261u
+
+/**
+ * @brief      Add bytes to a hash of settings (FNV-1a)
+ *
+ * @param[in]  hash  Hash so far, ESP_LRU_CACHE_HASH_INIT to start
+ * @param[in]  data  The data
+ * @param[in]  len   Length of data
+ *
+ * @return     The new hash
+ */
+static inline uint32_t esp_lru_cache_hash(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Adds a field of a configuration to a hash.
+ *
+ * Pointers are hashed as such: buffers such as the certificates and keys of
+ * TLS settings are identified by their address rather than by their
+ * contents, as the same buffers are passed from one connection to the next
+ * in practice, and hashing the PEM data of each connection would cost more
+ * than what the caches save.
+ */
+#define ESP_LRU_CACHE_HASH_FIELD(hash, field)   esp_lru_cache_hash(hash, &(field), sizeof(field))
+
+/**
+ * @brief      Monotonic time in seconds, of the expiry of entries
+ */
+static inline int64_t esp_lru_cache_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/**
+ * @brief      Tell whether an entry was used before another one
+ *
+ * The stamps are compared as a difference, so that the order holds when the
+ * counter wraps around.
+ *
+ * @param[in]  last_used        Stamp of the entry
+ * @param[in]  other_last_used  Stamp of the other entry
+ *
+ * @return     true if the entry is the least recently used of both
+ */
+static inline bool esp_lru_cache_used_before(uint32_t last_used, uint32_t other_last_used)
+{
+    return (int32_t)(last_used - other_last_used) < 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
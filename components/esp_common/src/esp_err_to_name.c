@@ -267,6 +267,15 @@ static const esp_err_msg_t esp_err_msg_table[] = {
                                                                                 essentially first boot of firmware image
                                                                                 post upgrade and hence firmware upgrade
                                                                                 is not possible */
+#   endif
+#   ifdef      ESP_ERR_OTA_DELTA_INVALID
+    ERR_TBL_IT(ESP_ERR_OTA_DELTA_INVALID),                      /*  5383 0x1507 Error if a delta patch is corrupt or
+                                                                                not supported */
+#   endif
+#   ifdef      ESP_ERR_OTA_DELTA_SOURCE_MISMATCH
+    ERR_TBL_IT(ESP_ERR_OTA_DELTA_SOURCE_MISMATCH),              /*  5384 0x1508 Error if a delta patch was made from
+                                                                                another image than the one in the
+                                                                                source partition */
 #   endif
     // components/efuse/include/esp_efuse.h
 #   ifdef      ESP_ERR_EFUSE
@@ -194,6 +194,24 @@ esp_err_t esp_eth_update_input_path(
 */
 esp_err_t esp_eth_transmit(esp_eth_handle_t hdl, void *buf, uint32_t length);
 
+/**
+* @brief Transmit a frame made of several buffers
+*
+* @note If the MAC can't gather the buffers itself, they are copied into a single frame buffer.
+*
+* @param[in] hdl: handle of Ethernet driver
+* @param[in] bufs: buffers of the frame, in order
+* @param[in] lengths: length of each buffer
+* @param[in] count: number of buffers
+*
+* @return
+*       - ESP_OK: transmit frame successfully
+*       - ESP_ERR_INVALID_ARG: transmit frame failed because of some invalid argument
+*       - ESP_ERR_NO_MEM: transmit frame failed because the frame buffer couldn't be allocated
+*       - ESP_FAIL: transmit frame failed because some other error occurred
+*/
+esp_err_t esp_eth_transmit_multiple_buf(esp_eth_handle_t hdl, uint8_t **bufs, uint32_t *lengths, uint32_t count);
+
 /**
 * @brief General Receive
 *
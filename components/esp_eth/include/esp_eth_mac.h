@@ -113,6 +113,25 @@ struct esp_eth_mac_s {
     */
     esp_err_t (*transmit)(esp_eth_mac_t *mac, uint8_t *buf, uint32_t length);
 
+    /**
+    * @brief Transmit a packet made of several buffers from Ethernet MAC (optional)
+    *
+    * @param[in] mac: Ethernet MAC instance
+    * @param[in] bufs: buffers of the packet, in order
+    * @param[in] lengths: length of each buffer
+    * @param[in] count: number of buffers
+    *
+    * @return
+    *      - ESP_OK: transmit packet successfully
+    *      - ESP_ERR_INVALID_ARG: transmit packet failed because of invalid argument
+    *      - ESP_ERR_INVALID_SIZE: transmit packet failed because of insufficient TX buffer size
+    *      - ESP_FAIL: transmit packet failed because some other error occurred
+    *
+    * @note MAC drivers which don't set this function get the packet copied into a single buffer
+    *
+    */
+    esp_err_t (*transmit_multiple_buf)(esp_eth_mac_t *mac, uint8_t **bufs, uint32_t *lengths, uint32_t count);
+
     /**
     * @brief Receive packet from Ethernet MAC
     *
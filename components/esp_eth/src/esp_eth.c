@@ -13,6 +13,8 @@
 // limitations under the License.
 #include <sys/cdefs.h>
 #include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 #include "esp_log.h"
 #include "esp_eth.h"
 #include "esp_event.h"
@@ -325,6 +327,37 @@ err:
     return ret;
 }
 
+esp_err_t esp_eth_transmit_multiple_buf(esp_eth_handle_t hdl, uint8_t **bufs, uint32_t *lengths, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+    esp_eth_driver_t *eth_driver = (esp_eth_driver_t *)hdl;
+    ETH_CHECK(bufs && lengths, "can't set bufs and lengths to null", err, ESP_ERR_INVALID_ARG);
+    ETH_CHECK(count, "buffer count can't be zero", err, ESP_ERR_INVALID_ARG);
+    ETH_CHECK(eth_driver, "ethernet driver handle can't be null", err, ESP_ERR_INVALID_ARG);
+    esp_eth_mac_t *mac = eth_driver->mac;
+    if (mac->transmit_multiple_buf) {
+        return mac->transmit_multiple_buf(mac, bufs, lengths, count);
+    }
+    if (count == 1) {
+        return mac->transmit(mac, bufs[0], lengths[0]);
+    }
+    /* MAC can't gather the buffers, copy them into a single frame */
+    uint32_t length = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        length += lengths[i];
+    }
+    uint8_t *frame = malloc(length);
+    ETH_CHECK(frame, "no mem for frame buffer", err, ESP_ERR_NO_MEM);
+    for (uint32_t i = 0, offset = 0; i < count; offset += lengths[i], i++) {
+        memcpy(frame + offset, bufs[i], lengths[i]);
+    }
+    ret = mac->transmit(mac, frame, length);
+    free(frame);
+    return ret;
+err:
+    return ret;
+}
+
 esp_err_t esp_eth_receive(esp_eth_handle_t hdl, uint8_t *buf, uint32_t *length)
 {
     esp_err_t ret = ESP_OK;
@@ -226,6 +226,21 @@ err:
     return ret;
 }
 
+static esp_err_t emac_esp32_transmit_multiple_buf(esp_eth_mac_t *mac, uint8_t **bufs, uint32_t *lengths, uint32_t count)
+{
+    esp_err_t ret = ESP_OK;
+    emac_esp32_t *emac = __containerof(mac, emac_esp32_t, parent);
+    uint32_t length = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        length += lengths[i];
+    }
+    uint32_t sent_len = emac_hal_transmit_multiple_buf_frame(&emac->hal, bufs, lengths, count);
+    MAC_CHECK(sent_len == length, "insufficient TX buffer size", err, ESP_ERR_INVALID_SIZE);
+    return ESP_OK;
+err:
+    return ret;
+}
+
 static esp_err_t emac_esp32_receive(esp_eth_mac_t *mac, uint8_t *buf, uint32_t *length)
 {
     esp_err_t ret = ESP_OK;
@@ -441,6 +456,7 @@ esp_eth_mac_t *esp_eth_mac_new_esp32(const eth_mac_config_t *config)
     emac->parent.set_link = emac_esp32_set_link;
     emac->parent.set_promiscuous = emac_esp32_set_promiscuous;
     emac->parent.transmit = emac_esp32_transmit;
+    emac->parent.transmit_multiple_buf = emac_esp32_transmit_multiple_buf;
     emac->parent.receive = emac_esp32_receive;
     /* Interrupt configuration */
     if (config->flags & ETH_MAC_FLAG_WORK_WITH_CACHE_DISABLE) {
@@ -30,6 +30,20 @@ static esp_err_t eth_input_to_netif(esp_eth_handle_t eth_handle, uint8_t *buffer
     return esp_netif_receive((esp_netif_t *)priv, buffer, length, NULL);
 }
 
+static esp_err_t esp_eth_transmit_sg(void *h, const esp_netif_iovec_t *iov, size_t iovcnt)
+{
+    uint8_t *bufs[ESP_NETIF_IOV_MAX];
+    uint32_t lengths[ESP_NETIF_IOV_MAX];
+    if (iovcnt > ESP_NETIF_IOV_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < iovcnt; i++) {
+        bufs[i] = iov[i].base;
+        lengths[i] = iov[i].len;
+    }
+    return esp_eth_transmit_multiple_buf(h, bufs, lengths, iovcnt);
+}
+
 static esp_err_t esp_eth_post_attach(esp_netif_t *esp_netif, void *args)
 {
     uint8_t eth_mac[6];
@@ -42,7 +56,8 @@ static esp_err_t esp_eth_post_attach(esp_netif_t *esp_netif, void *args)
     esp_netif_driver_ifconfig_t driver_ifconfig = {
         .handle =  glue->eth_driver,
         .transmit = esp_eth_transmit,
-        .driver_free_rx_buffer = NULL
+        .driver_free_rx_buffer = NULL,
+        .transmit_sg = esp_eth_transmit_sg
     };
 
     ESP_ERROR_CHECK(esp_netif_set_driver_config(esp_netif, &driver_ifconfig));
@@ -0,0 +1,651 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/lock.h>
+#include "esp_log.h"
+#include "esp_executor.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char* TAG = "executor";
+
+typedef struct esp_executor_job esp_executor_job_t;
+typedef struct esp_executor esp_executor_t;
+
+/* Task blocked in esp_executor_wait, lives on the stack of the waiting task */
+typedef struct job_waiter {
+    SemaphoreHandle_t sem;
+    struct job_waiter* next;
+} job_waiter_t;
+
+struct esp_executor_job {
+    esp_executor_func_t func;
+    void* arg;
+    esp_executor_t* executor;
+    portMUX_TYPE lock;                  // protects the fields below
+    int refs;                           // one for the executor until the job has run, one for the handle
+    bool done;
+    esp_executor_job_t* continuations;  // jobs to submit when this one is done
+    esp_executor_job_t* next;           // link in the continuation list of the parent job
+    job_waiter_t* waiters;
+};
+
+/* Bounded double-ended queue of jobs. The owner pushes and pops at the bottom,
+ * other workers steal from the top. Operations are a few instructions long, so a
+ * spinlock per queue is enough to keep contention low: workers touch each other's
+ * queues only when they run out of jobs.
+ */
+typedef struct {
+    portMUX_TYPE lock;
+    size_t top;                         // index of the oldest job
+    size_t count;
+    size_t capacity;
+    esp_executor_job_t** jobs;
+} job_deque_t;
+
+typedef struct {
+    esp_executor_t* executor;
+    size_t index;
+    job_deque_t deque;
+    TaskHandle_t task;
+} executor_worker_t;
+
+struct esp_executor {
+    size_t num_workers;
+    executor_worker_t* workers;
+    job_deque_t shared;                 // jobs submitted from outside of the workers
+    SemaphoreHandle_t wake_sem;         // given to wake up idle workers
+    SemaphoreHandle_t exit_sem;         // given by each worker when it exits
+    atomic_int idle_workers;            // workers about to wait on wake_sem
+    atomic_int pending_jobs;            // jobs created and not completed yet
+    atomic_bool stopping;
+};
+
+/* Worker running in the current task, NULL in tasks which are not workers */
+static __thread executor_worker_t* s_current_worker;
+
+static pthread_key_t s_wait_sem_key;
+static pthread_once_t s_wait_sem_key_once = PTHREAD_ONCE_INIT;
+
+static _lock_t s_default_executor_lock;
+static esp_executor_handle_t s_default_executor;
+
+static bool deque_init(job_deque_t* deque, size_t capacity)
+{
+    deque->jobs = calloc(capacity, sizeof(esp_executor_job_t*));
+    if (deque->jobs == NULL) {
+        return false;
+    }
+    vPortCPUInitializeMutex(&deque->lock);
+    deque->top = 0;
+    deque->count = 0;
+    deque->capacity = capacity;
+    return true;
+}
+
+static bool deque_push_bottom(job_deque_t* deque, esp_executor_job_t* job)
+{
+    bool ret = false;
+    portENTER_CRITICAL(&deque->lock);
+    if (deque->count < deque->capacity) {
+        deque->jobs[(deque->top + deque->count) % deque->capacity] = job;
+        deque->count++;
+        ret = true;
+    }
+    portEXIT_CRITICAL(&deque->lock);
+    return ret;
+}
+
+static esp_executor_job_t* deque_pop_bottom(job_deque_t* deque)
+{
+    esp_executor_job_t* job = NULL;
+    portENTER_CRITICAL(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        job = deque->jobs[(deque->top + deque->count) % deque->capacity];
+    }
+    portEXIT_CRITICAL(&deque->lock);
+    return job;
+}
+
+static esp_executor_job_t* deque_pop_top(job_deque_t* deque)
+{
+    esp_executor_job_t* job = NULL;
+    /* Unlocked peek, avoids taking the locks of idle queues while looking for work */
+    if (deque->count == 0) {
+        return NULL;
+    }
+    portENTER_CRITICAL(&deque->lock);
+    if (deque->count > 0) {
+        job = deque->jobs[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        deque->count--;
+    }
+    portEXIT_CRITICAL(&deque->lock);
+    return job;
+}
+
+static void wait_sem_destructor(void* sem)
+{
+    vSemaphoreDelete((SemaphoreHandle_t) sem);
+}
+
+static void wait_sem_key_create(void)
+{
+    pthread_key_create(&s_wait_sem_key, wait_sem_destructor);
+}
+
+/* Binary semaphore of the calling task to block in esp_executor_wait, created on first use */
+static SemaphoreHandle_t get_wait_sem(void)
+{
+    pthread_once(&s_wait_sem_key_once, wait_sem_key_create);
+    SemaphoreHandle_t sem = (SemaphoreHandle_t) pthread_getspecific(s_wait_sem_key);
+    if (sem == NULL) {
+        sem = xSemaphoreCreateBinary();
+        if (sem != NULL && pthread_setspecific(s_wait_sem_key, sem) != 0) {
+            vSemaphoreDelete(sem);
+            sem = NULL;
+        }
+    }
+    return sem;
+}
+
+static esp_executor_job_t* job_create(esp_executor_t* executor, esp_executor_func_t func, void* arg, bool with_handle)
+{
+    esp_executor_job_t* job = malloc(sizeof(esp_executor_job_t));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->func = func;
+    job->arg = arg;
+    job->executor = executor;
+    vPortCPUInitializeMutex(&job->lock);
+    job->refs = with_handle ? 2 : 1;
+    job->done = false;
+    job->continuations = NULL;
+    job->next = NULL;
+    job->waiters = NULL;
+    atomic_fetch_add(&executor->pending_jobs, 1);
+    return job;
+}
+
+void esp_executor_job_release(esp_executor_job_handle_t job)
+{
+    if (job == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&job->lock);
+    int refs = --job->refs;
+    portEXIT_CRITICAL(&job->lock);
+    if (refs == 0) {
+        free(job);
+    }
+}
+
+static void wake_workers(esp_executor_t* executor, int count)
+{
+    for (int i = 0; i < count; i++) {
+        xSemaphoreGive(executor->wake_sem);
+    }
+}
+
+static void job_run(esp_executor_job_t* job);
+
+/* Queue a job, preferably on the queue of the current worker */
+static bool job_schedule(esp_executor_job_t* job)
+{
+    esp_executor_t* executor = job->executor;
+    executor_worker_t* worker = s_current_worker;
+
+    if (worker != NULL && worker->executor == executor) {
+        if (!deque_push_bottom(&worker->deque, job)) {
+            /* Our own queue is full, running the job now is as good as anything else */
+            job_run(job);
+            return true;
+        }
+    } else if (!deque_push_bottom(&executor->shared, job)) {
+        return false;
+    }
+
+    /* Pairs with the fence in the idle path of the worker: either the worker sees the new job,
+       or we see the worker as idle and wake it up */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&executor->idle_workers) > 0) {
+        wake_workers(executor, 1);
+    }
+    return true;
+}
+
+static void job_run(esp_executor_job_t* job)
+{
+    esp_executor_t* executor = job->executor;
+
+    job->func(job->arg);
+
+    portENTER_CRITICAL(&job->lock);
+    job->done = true;
+    esp_executor_job_t* continuations = job->continuations;
+    job_waiter_t* waiter = job->waiters;
+    job->continuations = NULL;
+    job->waiters = NULL;
+    portEXIT_CRITICAL(&job->lock);
+
+    while (waiter != NULL) {
+        /* The waiter returns, and its entry goes out of scope, as soon as its semaphore is given */
+        job_waiter_t* next = waiter->next;
+        xSemaphoreGive(waiter->sem);
+        waiter = next;
+    }
+
+    while (continuations != NULL) {
+        esp_executor_job_t* next = continuations->next;
+        if (!job_schedule(continuations)) {
+            /* Shared queue is full, run the continuation in this task */
+            job_run(continuations);
+        }
+        continuations = next;
+    }
+
+    esp_executor_job_release(job);
+
+    if (atomic_fetch_sub(&executor->pending_jobs, 1) == 1 && atomic_load(&executor->stopping)) {
+        /* Last job of an executor being deleted, let all the workers exit */
+        wake_workers(executor, executor->num_workers);
+    }
+}
+
+static esp_executor_job_t* find_job(executor_worker_t* worker)
+{
+    esp_executor_t* executor = worker->executor;
+
+    esp_executor_job_t* job = deque_pop_bottom(&worker->deque);
+    if (job != NULL) {
+        return job;
+    }
+    job = deque_pop_top(&executor->shared);
+    if (job != NULL) {
+        return job;
+    }
+    for (size_t i = 1; i < executor->num_workers; i++) {
+        executor_worker_t* victim = &executor->workers[(worker->index + i) % executor->num_workers];
+        job = deque_pop_top(&victim->deque);
+        if (job != NULL) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+static bool worker_should_exit(esp_executor_t* executor)
+{
+    return atomic_load(&executor->stopping) && atomic_load(&executor->pending_jobs) == 0;
+}
+
+static void worker_task(void* arg)
+{
+    executor_worker_t* worker = (executor_worker_t*) arg;
+    esp_executor_t* executor = worker->executor;
+    s_current_worker = worker;
+
+    while (true) {
+        esp_executor_job_t* job = find_job(worker);
+        if (job != NULL) {
+            job_run(job);
+            continue;
+        }
+        if (worker_should_exit(executor)) {
+            break;
+        }
+
+        atomic_fetch_add(&executor->idle_workers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        job = find_job(worker);
+        if (job == NULL && !worker_should_exit(executor)) {
+            xSemaphoreTake(executor->wake_sem, portMAX_DELAY);
+        }
+        atomic_fetch_sub(&executor->idle_workers, 1);
+        if (job != NULL) {
+            job_run(job);
+        }
+    }
+
+    s_current_worker = NULL;
+    xSemaphoreGive(executor->exit_sem);
+    vTaskDelete(NULL);
+}
+
+static void executor_free(esp_executor_t* executor)
+{
+    if (executor->workers != NULL) {
+        for (size_t i = 0; i < executor->num_workers; i++) {
+            free(executor->workers[i].deque.jobs);
+        }
+        free(executor->workers);
+    }
+    free(executor->shared.jobs);
+    if (executor->wake_sem != NULL) {
+        vSemaphoreDelete(executor->wake_sem);
+    }
+    if (executor->exit_sem != NULL) {
+        vSemaphoreDelete(executor->exit_sem);
+    }
+    free(executor);
+}
+
+static void executor_stop_workers(esp_executor_t* executor, size_t started)
+{
+    atomic_store(&executor->stopping, true);
+    wake_workers(executor, executor->num_workers);
+    for (size_t i = 0; i < started; i++) {
+        xSemaphoreTake(executor->exit_sem, portMAX_DELAY);
+    }
+}
+
+esp_err_t esp_executor_create(const esp_executor_config_t* config, esp_executor_handle_t* out_handle)
+{
+    if (config == NULL || out_handle == NULL || config->queue_size == 0 || config->name == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_executor_t* executor = calloc(1, sizeof(esp_executor_t));
+    if (executor == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    executor->num_workers = config->num_workers ? config->num_workers : portNUM_PROCESSORS;
+    atomic_init(&executor->idle_workers, 0);
+    atomic_init(&executor->pending_jobs, 0);
+    atomic_init(&executor->stopping, false);
+
+    executor->workers = calloc(executor->num_workers, sizeof(executor_worker_t));
+    executor->wake_sem = xSemaphoreCreateCounting(executor->num_workers, 0);
+    executor->exit_sem = xSemaphoreCreateCounting(executor->num_workers, 0);
+    if (executor->workers == NULL || executor->wake_sem == NULL || executor->exit_sem == NULL ||
+            !deque_init(&executor->shared, config->queue_size * executor->num_workers)) {
+        executor_free(executor);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < executor->num_workers; i++) {
+        executor_worker_t* worker = &executor->workers[i];
+        worker->executor = executor;
+        worker->index = i;
+        if (!deque_init(&worker->deque, config->queue_size)) {
+            executor_free(executor);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    for (size_t i = 0; i < executor->num_workers; i++) {
+        executor_worker_t* worker = &executor->workers[i];
+        BaseType_t core_id = config->pin_to_cores ? (BaseType_t) (i % portNUM_PROCESSORS) : tskNO_AFFINITY;
+        if (xTaskCreatePinnedToCore(worker_task, config->name, config->stack_size, worker,
+                                    config->priority, &worker->task, core_id) != pdPASS) {
+            ESP_LOGE(TAG, "failed to create worker %u", (unsigned) i);
+            executor_stop_workers(executor, i);
+            executor_free(executor);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    *out_handle = executor;
+    return ESP_OK;
+}
+
+esp_err_t esp_executor_delete(esp_executor_handle_t executor)
+{
+    if (executor == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_current_worker != NULL && s_current_worker->executor == executor) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    executor_stop_workers(executor, executor->num_workers);
+    executor_free(executor);
+    return ESP_OK;
+}
+
+esp_executor_handle_t esp_executor_get_default(void)
+{
+    _lock_acquire(&s_default_executor_lock);
+    if (s_default_executor == NULL) {
+        esp_executor_config_t config = ESP_EXECUTOR_DEFAULT_CONFIG();
+        if (esp_executor_create(&config, &s_default_executor) != ESP_OK) {
+            ESP_LOGE(TAG, "failed to create the default executor");
+        }
+    }
+    _lock_release(&s_default_executor_lock);
+    return s_default_executor;
+}
+
+size_t esp_executor_get_num_workers(esp_executor_handle_t executor)
+{
+    return executor->num_workers;
+}
+
+esp_err_t esp_executor_submit(esp_executor_handle_t executor, esp_executor_func_t func, void* arg,
+                              esp_executor_job_handle_t* out_job)
+{
+    if (executor == NULL || func == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&executor->stopping)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_executor_job_t* job = job_create(executor, func, arg, out_job != NULL);
+    if (job == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!job_schedule(job)) {
+        atomic_fetch_sub(&executor->pending_jobs, 1);
+        free(job);
+        return ESP_ERR_NO_MEM;
+    }
+    if (out_job != NULL) {
+        *out_job = job;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_executor_then(esp_executor_job_handle_t job, esp_executor_func_t func, void* arg,
+                            esp_executor_job_handle_t* out_job)
+{
+    if (job == NULL || func == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_load(&job->executor->stopping) && esp_executor_job_is_done(job)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_executor_job_t* continuation = job_create(job->executor, func, arg, out_job != NULL);
+    if (continuation == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (out_job != NULL) {
+        *out_job = continuation;
+    }
+
+    portENTER_CRITICAL(&job->lock);
+    bool done = job->done;
+    if (!done) {
+        continuation->next = job->continuations;
+        job->continuations = continuation;
+    }
+    portEXIT_CRITICAL(&job->lock);
+
+    if (done && !job_schedule(continuation)) {
+        job_run(continuation);
+    }
+    return ESP_OK;
+}
+
+bool esp_executor_job_is_done(esp_executor_job_handle_t job)
+{
+    portENTER_CRITICAL(&job->lock);
+    bool done = job->done;
+    portEXIT_CRITICAL(&job->lock);
+    return done;
+}
+
+esp_err_t esp_executor_wait(esp_executor_job_handle_t job, TickType_t ticks_to_wait)
+{
+    if (job == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    executor_worker_t* worker = s_current_worker;
+    if (worker != NULL && worker->executor == job->executor) {
+        /* Help instead of blocking: the awaited job may well be in our own queue */
+        while (!esp_executor_job_is_done(job)) {
+            esp_executor_job_t* other = find_job(worker);
+            if (other == NULL) {
+                break;
+            }
+            job_run(other);
+            if (ticks_to_wait != portMAX_DELAY && xTaskGetTickCount() - start >= ticks_to_wait) {
+                return esp_executor_job_is_done(job) ? ESP_OK : ESP_ERR_TIMEOUT;
+            }
+        }
+    }
+
+    if (esp_executor_job_is_done(job)) {
+        return ESP_OK;
+    }
+
+    job_waiter_t waiter = { .sem = get_wait_sem(), .next = NULL };
+    if (waiter.sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&job->lock);
+    bool done = job->done;
+    if (!done) {
+        waiter.next = job->waiters;
+        job->waiters = &waiter;
+    }
+    portEXIT_CRITICAL(&job->lock);
+    if (done) {
+        return ESP_OK;
+    }
+
+    TickType_t remaining = portMAX_DELAY;
+    if (ticks_to_wait != portMAX_DELAY) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        remaining = elapsed < ticks_to_wait ? ticks_to_wait - elapsed : 0;
+    }
+    if (xSemaphoreTake(waiter.sem, remaining) == pdTRUE) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+    portENTER_CRITICAL(&job->lock);
+    if (job->done) {
+        ret = ESP_OK;
+    } else {
+        for (job_waiter_t** p = &job->waiters; *p != NULL; p = &(*p)->next) {
+            if (*p == &waiter) {
+                *p = waiter.next;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&job->lock);
+    if (ret == ESP_OK) {
+        /* Completed between the timeout and the critical section, the give is on its way */
+        xSemaphoreTake(waiter.sem, portMAX_DELAY);
+    }
+    return ret;
+}
+
+typedef struct {
+    atomic_size_t next;
+    size_t end;
+    size_t grain;
+    esp_executor_range_func_t func;
+    void* arg;
+} parallel_for_ctx_t;
+
+static void parallel_for_run(void* arg)
+{
+    parallel_for_ctx_t* ctx = (parallel_for_ctx_t*) arg;
+    size_t begin = atomic_load(&ctx->next);
+    while (begin < ctx->end) {
+        size_t end = ctx->end - begin > ctx->grain ? begin + ctx->grain : ctx->end;
+        if (atomic_compare_exchange_weak(&ctx->next, &begin, end)) {
+            ctx->func(begin, end, ctx->arg);
+            begin = end;
+        }
+    }
+}
+
+esp_err_t esp_executor_parallel_for(esp_executor_handle_t executor, size_t begin, size_t end, size_t grain,
+                                    esp_executor_range_func_t func, void* arg)
+{
+    if (executor == NULL || func == NULL || begin > end) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (begin == end) {
+        return ESP_OK;
+    }
+
+    size_t helpers = executor->num_workers;
+    if (grain == 0) {
+        /* A few chunks per participant, so that uneven chunks balance out */
+        grain = (end - begin) / ((helpers + 1) * 4);
+        grain = grain ? grain : 1;
+    }
+    size_t chunks = (end - begin + grain - 1) / grain;
+    if (helpers > chunks - 1) {
+        helpers = chunks - 1;
+    }
+
+    parallel_for_ctx_t ctx = {
+        .end = end,
+        .grain = grain,
+        .func = func,
+        .arg = arg,
+    };
+    atomic_init(&ctx.next, begin);
+
+    esp_executor_job_handle_t* jobs = NULL;
+    if (helpers > 0) {
+        jobs = calloc(helpers, sizeof(esp_executor_job_handle_t));
+        if (jobs == NULL) {
+            helpers = 0;
+        }
+    }
+    for (size_t i = 0; i < helpers; i++) {
+        if (esp_executor_submit(executor, parallel_for_run, &ctx, &jobs[i]) != ESP_OK) {
+            /* The range gets processed by fewer tasks */
+            jobs[i] = NULL;
+        }
+    }
+
+    parallel_for_run(&ctx);
+
+    /* Helpers hold a pointer to ctx, which lives on our stack */
+    for (size_t i = 0; i < helpers; i++) {
+        if (jobs[i] != NULL) {
+            esp_executor_wait(jobs[i], portMAX_DELAY);
+            esp_executor_job_release(jobs[i]);
+        }
+    }
+    free(jobs);
+    return ESP_OK;
+}
@@ -0,0 +1,242 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * @file esp_executor.h
+ * @brief Work-stealing thread pool
+ *
+ * An executor runs short jobs on a fixed set of worker tasks, spread over the
+ * CPU cores. Submitting a job doesn't create a task: it only allocates a small
+ * job descriptor and pushes it to a queue.
+ *
+ * Each worker has its own double-ended queue. Jobs submitted from a worker
+ * (for example, sub-jobs of a job) go to the queue of that worker, which runs
+ * them in LIFO order while they are still hot in cache. Jobs submitted from
+ * other tasks go to a shared queue. A worker which runs out of jobs steals the
+ * oldest job from the queue of another worker, so load is balanced between the
+ * cores without a central lock.
+ *
+ * Waiting for a job from a worker of the same executor doesn't block the worker:
+ * it keeps running queued jobs until the awaited one is done. Jobs can therefore
+ * wait for sub-jobs without deadlocking the pool.
+ *
+ * A C++ interface with futures and lambdas is provided in esp_executor.hpp.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opaque type representing an executor
+ */
+typedef struct esp_executor* esp_executor_handle_t;
+
+/**
+ * @brief Opaque type representing a job submitted to an executor
+ */
+typedef struct esp_executor_job* esp_executor_job_handle_t;
+
+/**
+ * @brief Job function type
+ * @param arg argument passed when the job was submitted
+ */
+typedef void (*esp_executor_func_t)(void* arg);
+
+/**
+ * @brief Function type for esp_executor_parallel_for
+ * @param begin first index of the range to process
+ * @param end   index after the last one of the range to process
+ * @param arg   argument passed to esp_executor_parallel_for
+ */
+typedef void (*esp_executor_range_func_t)(size_t begin, size_t end, void* arg);
+
+/**
+ * @brief Executor configuration passed to esp_executor_create
+ */
+typedef struct {
+    size_t num_workers;         //!< Number of worker tasks, 0 to create one worker per core
+    size_t stack_size;          //!< Stack size of each worker task, in bytes
+    UBaseType_t priority;       //!< Priority of the worker tasks
+    bool pin_to_cores;          //!< Pin worker N to core N % portNUM_PROCESSORS, otherwise no affinity
+    size_t queue_size;          //!< Capacity of the queue of each worker, in jobs
+    const char* name;           //!< Name of the worker tasks
+} esp_executor_config_t;
+
+/**
+ * @brief Default executor configuration, using the values set in menuconfig
+ */
+#define ESP_EXECUTOR_DEFAULT_CONFIG() { \
+    .num_workers = 0, \
+    .stack_size = CONFIG_ESP_EXECUTOR_TASK_STACK_SIZE, \
+    .priority = CONFIG_ESP_EXECUTOR_TASK_PRIORITY, \
+    .pin_to_cores = true, \
+    .queue_size = CONFIG_ESP_EXECUTOR_QUEUE_SIZE, \
+    .name = "executor", \
+}
+
+/**
+ * @brief Create an executor and start its worker tasks
+ *
+ * @param config        Executor configuration. Not saved by the library, can be allocated on the stack.
+ * @param[out] out_handle  Output, handle of the created executor
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if some of the arguments are not valid
+ *      - ESP_ERR_NO_MEM if memory or worker tasks can't be allocated
+ */
+esp_err_t esp_executor_create(const esp_executor_config_t* config, esp_executor_handle_t* out_handle);
+
+/**
+ * @brief Stop an executor and free its resources
+ *
+ * No jobs can be submitted anymore. The function blocks until all the jobs
+ * already submitted, and their continuations, have run, then deletes the
+ * worker tasks. Job handles which haven't been released can still be waited
+ * for and must still be released, but no continuation can be attached to them.
+ *
+ * @note Must not be called from a job running on this executor.
+ *
+ * @param executor  executor handle
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if the handle is NULL
+ *      - ESP_ERR_INVALID_STATE if called from a worker of the executor
+ */
+esp_err_t esp_executor_delete(esp_executor_handle_t executor);
+
+/**
+ * @brief Get the default executor
+ *
+ * The default executor is created with ESP_EXECUTOR_DEFAULT_CONFIG() on first use
+ * and never deleted. Components should use it rather than create their own
+ * thread pools, so that the CPU cores are shared between them.
+ *
+ * @return executor handle, or NULL if it couldn't be created
+ */
+esp_executor_handle_t esp_executor_get_default(void);
+
+/**
+ * @brief Get the number of worker tasks of an executor
+ *
+ * @param executor  executor handle
+ * @return number of workers
+ */
+size_t esp_executor_get_num_workers(esp_executor_handle_t executor);
+
+/**
+ * @brief Submit a job to an executor
+ *
+ * @param executor  executor handle
+ * @param func      function to run
+ * @param arg       argument to pass to the function
+ * @param[out] out_job  Output, handle of the job to wait for its completion or attach continuations
+ *                      to it. Must be released with esp_executor_job_release. May be NULL if not needed.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if some of the arguments are not valid
+ *      - ESP_ERR_INVALID_STATE if the executor is being deleted
+ *      - ESP_ERR_NO_MEM if the job can't be allocated, or the shared queue is full
+ */
+esp_err_t esp_executor_submit(esp_executor_handle_t executor, esp_executor_func_t func, void* arg,
+                              esp_executor_job_handle_t* out_job);
+
+/**
+ * @brief Attach a continuation to a job
+ *
+ * The continuation is submitted to the executor of the job once the job is
+ * done, or right away if it is already done.
+ *
+ * @param job       job handle
+ * @param func      function to run after the job
+ * @param arg       argument to pass to the function
+ * @param[out] out_job  Output, handle of the continuation job. May be NULL if not needed.
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if some of the arguments are not valid
+ *      - ESP_ERR_INVALID_STATE if the job is done and its executor is being deleted
+ *      - ESP_ERR_NO_MEM if the job can't be allocated
+ */
+esp_err_t esp_executor_then(esp_executor_job_handle_t job, esp_executor_func_t func, void* arg,
+                            esp_executor_job_handle_t* out_job);
+
+/**
+ * @brief Wait for a job to complete
+ *
+ * When called from a worker of the executor of the job, the worker runs other
+ * queued jobs while waiting. The timeout is then only checked between jobs.
+ *
+ * @param job           job handle
+ * @param ticks_to_wait maximum time to wait, portMAX_DELAY to wait forever
+ *
+ * @return
+ *      - ESP_OK if the job is done
+ *      - ESP_ERR_INVALID_ARG if the handle is NULL
+ *      - ESP_ERR_TIMEOUT if the job is not done when the timeout expires
+ *      - ESP_ERR_NO_MEM if the semaphore of the waiting task can't be allocated
+ */
+esp_err_t esp_executor_wait(esp_executor_job_handle_t job, TickType_t ticks_to_wait);
+
+/**
+ * @brief Check whether a job has completed, without blocking
+ *
+ * @param job   job handle
+ * @return true if the job is done
+ */
+bool esp_executor_job_is_done(esp_executor_job_handle_t job);
+
+/**
+ * @brief Release a job handle returned by esp_executor_submit or esp_executor_then
+ *
+ * Releasing the handle doesn't cancel the job.
+ *
+ * @param job   job handle, may be NULL
+ */
+void esp_executor_job_release(esp_executor_job_handle_t job);
+
+/**
+ * @brief Run a function over a range of indices, in parallel on the workers of an executor
+ *
+ * The range is split in chunks of 'grain' indices, which are distributed
+ * dynamically between the workers and the calling task. The function returns
+ * when the whole range has been processed.
+ *
+ * @param executor  executor handle
+ * @param begin     first index
+ * @param end       index after the last one
+ * @param grain     number of indices per call of func, 0 to choose automatically
+ * @param func      function to call for each chunk
+ * @param arg       argument to pass to the function
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if some of the arguments are not valid
+ */
+esp_err_t esp_executor_parallel_for(esp_executor_handle_t executor, size_t begin, size_t end, size_t grain,
+                                    esp_executor_range_func_t func, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,331 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * @file esp_executor.hpp
+ * @brief C++ interface of the work-stealing thread pool
+ *
+ * Example:
+ *
+ *     idf::Executor executor;  // default executor
+ *     idf::Future<int> sum = executor.submit([&]() { return compute(); });
+ *     idf::Future<void> done = sum.then([](int &value) { printf("%d\n", value); });
+ *     executor.parallel_for(0, num_rows, [&](size_t row) { process_row(row); });
+ *
+ * Doesn't rely on C++ exceptions: when a job can't be submitted, the returned
+ * future is not valid().
+ */
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "esp_executor.h"
+
+namespace idf {
+
+template<typename T> class Future;
+
+namespace detail {
+
+/* Result of a job, shared between the job and its futures */
+template<typename T>
+class FutureState {
+public:
+    FutureState() : job(nullptr), has_value(false) { }
+
+    ~FutureState()
+    {
+        if (has_value) {
+            reinterpret_cast<T*>(&storage)->~T();
+        }
+        esp_executor_job_release(job);
+    }
+
+    template<typename F>
+    void set(F &func)
+    {
+        new (&storage) T(func());
+        has_value = true;
+    }
+
+    T &value()
+    {
+        return *reinterpret_cast<T*>(&storage);
+    }
+
+    esp_executor_job_handle_t job;
+
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    bool has_value;
+};
+
+template<>
+class FutureState<void> {
+public:
+    FutureState() : job(nullptr) { }
+
+    ~FutureState()
+    {
+        esp_executor_job_release(job);
+    }
+
+    template<typename F>
+    void set(F &func)
+    {
+        func();
+    }
+
+    void value() { }
+
+    esp_executor_job_handle_t job;
+};
+
+/* Calls a continuation with the result of the previous job */
+template<typename T>
+struct Continuation {
+    template<typename G>
+    static auto call(G &func, FutureState<T> &state) -> decltype(func(state.value()))
+    {
+        return func(state.value());
+    }
+};
+
+template<>
+struct Continuation<void> {
+    template<typename G>
+    static auto call(G &func, FutureState<void> &) -> decltype(func())
+    {
+        return func();
+    }
+};
+
+template<typename T, typename G>
+struct ContinuationResult {
+    typedef typename std::result_of<G(T&)>::type type;
+};
+
+template<typename G>
+struct ContinuationResult<void, G> {
+    typedef typename std::result_of<G()>::type type;
+};
+
+/* Heap allocated closure passed as the argument of a job */
+template<typename T, typename F>
+struct Job {
+    Job(F &&func, std::shared_ptr<FutureState<T>> state) : func(std::move(func)), state(std::move(state)) { }
+
+    static void run(void *arg)
+    {
+        Job *job = static_cast<Job*>(arg);
+        job->state->set(job->func);
+        delete job;
+    }
+
+    F func;
+    std::shared_ptr<FutureState<T>> state;
+};
+
+template<typename T, typename P, typename G>
+struct ContinuationJob {
+    ContinuationJob(G &&func, std::shared_ptr<FutureState<P>> parent, std::shared_ptr<FutureState<T>> state)
+        : func(std::move(func)), parent(std::move(parent)), state(std::move(state)) { }
+
+    T operator()()
+    {
+        return Continuation<P>::call(func, *parent);
+    }
+
+    static void run(void *arg)
+    {
+        ContinuationJob *job = static_cast<ContinuationJob*>(arg);
+        job->state->set(*job);
+        delete job;
+    }
+
+    G func;
+    std::shared_ptr<FutureState<P>> parent;
+    std::shared_ptr<FutureState<T>> state;
+};
+
+template<typename F>
+void parallel_for_range(size_t begin, size_t end, void *arg)
+{
+    F &func = *static_cast<F*>(arg);
+    for (size_t i = begin; i < end; i++) {
+        func(i);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Result of a job submitted to an Executor
+ *
+ * Futures are cheap to copy, all copies refer to the same result.
+ */
+template<typename T>
+class Future {
+public:
+    Future() { }
+
+    /**
+     * @brief Check if the future refers to a job, false if the job couldn't be submitted
+     */
+    bool valid() const
+    {
+        return state != nullptr;
+    }
+
+    /**
+     * @brief Check if the job is done, without blocking
+     */
+    bool is_ready() const
+    {
+        return esp_executor_job_is_done(state->job);
+    }
+
+    /**
+     * @brief Wait for the job to be done
+     *
+     * @param ticks_to_wait maximum time to wait, portMAX_DELAY to wait forever
+     * @return true if the job is done
+     */
+    bool wait(TickType_t ticks_to_wait = portMAX_DELAY) const
+    {
+        return esp_executor_wait(state->job, ticks_to_wait) == ESP_OK;
+    }
+
+    /**
+     * @brief Wait for the job to be done and get its result
+     *
+     * The result is moved out of the future, so get() may only be called once.
+     */
+    T get()
+    {
+        wait();
+        return std::move(state->value());
+    }
+
+    /**
+     * @brief Run a function on the result of the job, once it is done
+     *
+     * @param func function taking a reference to the result, or no argument if T is void
+     * @return future of the result of func
+     */
+    template<typename G>
+    Future<typename detail::ContinuationResult<T, G>::type> then(G func)
+    {
+        typedef typename detail::ContinuationResult<T, G>::type R;
+        typedef detail::ContinuationJob<R, T, G> Job;
+
+        Future<R> future;
+        std::shared_ptr<detail::FutureState<R>> next_state = std::make_shared<detail::FutureState<R>>();
+        Job *job = new (std::nothrow) Job(std::move(func), state, next_state);
+        if (job == nullptr) {
+            return future;
+        }
+        if (esp_executor_then(state->job, Job::run, job, &next_state->job) != ESP_OK) {
+            delete job;
+            return future;
+        }
+        future.state = std::move(next_state);
+        return future;
+    }
+
+private:
+    std::shared_ptr<detail::FutureState<T>> state;
+
+    friend class Executor;
+    template<typename U> friend class Future;
+};
+
+template<>
+inline void Future<void>::get()
+{
+    wait();
+}
+
+/**
+ * @brief Wrapper of an executor handle, doesn't own the executor
+ */
+class Executor {
+public:
+    /**
+     * @brief Use the default executor, see esp_executor_get_default()
+     */
+    Executor() : handle(esp_executor_get_default()) { }
+
+    explicit Executor(esp_executor_handle_t handle) : handle(handle) { }
+
+    esp_executor_handle_t get_handle() const
+    {
+        return handle;
+    }
+
+    size_t get_num_workers() const
+    {
+        return esp_executor_get_num_workers(handle);
+    }
+
+    /**
+     * @brief Submit a function object to run on a worker
+     *
+     * @return future of the result of func, not valid() if the job couldn't be submitted
+     */
+    template<typename F>
+    Future<typename std::result_of<typename std::decay<F>::type()>::type> submit(F &&func)
+    {
+        typedef typename std::decay<F>::type Func;
+        typedef typename std::result_of<Func()>::type R;
+        typedef detail::Job<R, Func> Job;
+
+        Future<R> future;
+        if (handle == nullptr) {
+            return future;
+        }
+        std::shared_ptr<detail::FutureState<R>> state = std::make_shared<detail::FutureState<R>>();
+        Job *job = new (std::nothrow) Job(Func(std::forward<F>(func)), state);
+        if (job == nullptr) {
+            return future;
+        }
+        if (esp_executor_submit(handle, Job::run, job, &state->job) != ESP_OK) {
+            delete job;
+            return future;
+        }
+        future.state = std::move(state);
+        return future;
+    }
+
+    /**
+     * @brief Call func(i) for each i in [begin, end), in parallel on the workers and the calling task
+     *
+     * @param grain number of indices processed by a job at a time, 0 to choose automatically
+     */
+    template<typename F>
+    esp_err_t parallel_for(size_t begin, size_t end, F &&func, size_t grain = 0)
+    {
+        typedef typename std::remove_reference<F>::type Func;
+        return esp_executor_parallel_for(handle, begin, end, grain, detail::parallel_for_range<Func>,
+                                         const_cast<void*>(static_cast<const void*>(&func)));
+    }
+
+private:
+    esp_executor_handle_t handle;
+};
+
+} // namespace idf
@@ -0,0 +1,214 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "unity.h"
+#include "esp_timer.h"
+#include "esp_executor.h"
+#include "sdkconfig.h"
+
+static void increment_job(void *arg)
+{
+    atomic_fetch_add((atomic_int *) arg, 1);
+}
+
+TEST_CASE("executor runs submitted jobs", "[executor]")
+{
+    esp_executor_config_t config = ESP_EXECUTOR_DEFAULT_CONFIG();
+    esp_executor_handle_t executor;
+    TEST_ESP_OK(esp_executor_create(&config, &executor));
+    TEST_ASSERT_EQUAL(portNUM_PROCESSORS, esp_executor_get_num_workers(executor));
+
+    const int num_jobs = 500;
+    atomic_int counter;
+    atomic_init(&counter, 0);
+    esp_executor_job_handle_t last;
+    for (int i = 0; i < num_jobs - 1; i++) {
+        esp_err_t err;
+        while ((err = esp_executor_submit(executor, increment_job, &counter, NULL)) == ESP_ERR_NO_MEM) {
+            /* Shared queue full, let the workers catch up */
+            vTaskDelay(1);
+        }
+        TEST_ESP_OK(err);
+    }
+    TEST_ESP_OK(esp_executor_submit(executor, increment_job, &counter, &last));
+    TEST_ESP_OK(esp_executor_wait(last, portMAX_DELAY));
+    TEST_ASSERT_TRUE(esp_executor_job_is_done(last));
+    esp_executor_job_release(last);
+
+    /* Deleting the executor runs the remaining jobs */
+    TEST_ESP_OK(esp_executor_delete(executor));
+    TEST_ASSERT_EQUAL(num_jobs, atomic_load(&counter));
+}
+
+typedef struct {
+    SemaphoreHandle_t start;
+    int order[3];
+    atomic_int count;
+} continuation_ctx_t;
+
+static void blocked_job(void *arg)
+{
+    continuation_ctx_t *ctx = (continuation_ctx_t *) arg;
+    xSemaphoreTake(ctx->start, portMAX_DELAY);
+    ctx->order[atomic_fetch_add(&ctx->count, 1)] = 1;
+}
+
+static void second_job(void *arg)
+{
+    continuation_ctx_t *ctx = (continuation_ctx_t *) arg;
+    ctx->order[atomic_fetch_add(&ctx->count, 1)] = 2;
+}
+
+static void third_job(void *arg)
+{
+    continuation_ctx_t *ctx = (continuation_ctx_t *) arg;
+    ctx->order[atomic_fetch_add(&ctx->count, 1)] = 3;
+}
+
+TEST_CASE("executor continuations run after their job", "[executor]")
+{
+    esp_executor_handle_t executor = esp_executor_get_default();
+    TEST_ASSERT_NOT_NULL(executor);
+    TEST_ASSERT_EQUAL_PTR(executor, esp_executor_get_default());
+
+    continuation_ctx_t ctx = { .start = xSemaphoreCreateBinary() };
+    atomic_init(&ctx.count, 0);
+    esp_executor_job_handle_t first, second, third;
+    TEST_ESP_OK(esp_executor_submit(executor, blocked_job, &ctx, &first));
+    TEST_ESP_OK(esp_executor_then(first, second_job, &ctx, &second));
+    TEST_ESP_OK(esp_executor_then(second, third_job, &ctx, &third));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, esp_executor_wait(third, 10 / portTICK_PERIOD_MS));
+    TEST_ASSERT_EQUAL(0, atomic_load(&ctx.count));
+    xSemaphoreGive(ctx.start);
+    TEST_ESP_OK(esp_executor_wait(third, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(3, atomic_load(&ctx.count));
+    TEST_ASSERT_EQUAL(1, ctx.order[0]);
+    TEST_ASSERT_EQUAL(2, ctx.order[1]);
+    TEST_ASSERT_EQUAL(3, ctx.order[2]);
+
+    /* Continuation of a completed job is submitted right away */
+    esp_executor_job_handle_t fourth;
+    TEST_ESP_OK(esp_executor_then(first, increment_job, &ctx.count, &fourth));
+    TEST_ESP_OK(esp_executor_wait(fourth, portMAX_DELAY));
+    TEST_ASSERT_EQUAL(4, atomic_load(&ctx.count));
+
+    esp_executor_job_release(first);
+    esp_executor_job_release(second);
+    esp_executor_job_release(third);
+    esp_executor_job_release(fourth);
+    vSemaphoreDelete(ctx.start);
+}
+
+#define NESTED_DEPTH 6
+
+typedef struct {
+    esp_executor_handle_t executor;
+    int depth;
+    atomic_int *leaves;
+} nested_ctx_t;
+
+/* Each job submits two sub-jobs and waits for them, from within the worker */
+static void nested_job(void *arg)
+{
+    nested_ctx_t *ctx = (nested_ctx_t *) arg;
+    if (ctx->depth == 0) {
+        atomic_fetch_add(ctx->leaves, 1);
+        return;
+    }
+    nested_ctx_t children[2];
+    esp_executor_job_handle_t jobs[2];
+    for (int i = 0; i < 2; i++) {
+        children[i] = *ctx;
+        children[i].depth = ctx->depth - 1;
+        TEST_ESP_OK(esp_executor_submit(ctx->executor, nested_job, &children[i], &jobs[i]));
+    }
+    for (int i = 0; i < 2; i++) {
+        TEST_ESP_OK(esp_executor_wait(jobs[i], portMAX_DELAY));
+        esp_executor_job_release(jobs[i]);
+    }
+}
+
+TEST_CASE("executor jobs can wait for sub-jobs with a single worker", "[executor]")
+{
+    esp_executor_config_t config = ESP_EXECUTOR_DEFAULT_CONFIG();
+    config.num_workers = 1;
+    esp_executor_handle_t executor;
+    TEST_ESP_OK(esp_executor_create(&config, &executor));
+
+    atomic_int leaves;
+    atomic_init(&leaves, 0);
+    nested_ctx_t root = { .executor = executor, .depth = NESTED_DEPTH, .leaves = &leaves };
+    esp_executor_job_handle_t job;
+    TEST_ESP_OK(esp_executor_submit(executor, nested_job, &root, &job));
+    TEST_ESP_OK(esp_executor_wait(job, 1000 / portTICK_PERIOD_MS));
+    esp_executor_job_release(job);
+    TEST_ASSERT_EQUAL(1 << NESTED_DEPTH, atomic_load(&leaves));
+
+    TEST_ESP_OK(esp_executor_delete(executor));
+}
+
+#define PARALLEL_FOR_SIZE 4096
+
+typedef struct {
+    uint32_t *data;
+    atomic_int calls;
+} parallel_for_ctx_t;
+
+/* CPU-bound stand-in for a DSP or decode kernel */
+static void hash_range(size_t begin, size_t end, void *arg)
+{
+    parallel_for_ctx_t *ctx = (parallel_for_ctx_t *) arg;
+    for (size_t i = begin; i < end; i++) {
+        uint32_t h = i;
+        for (int round = 0; round < 64; round++) {
+            h = (h ^ (h >> 15)) * 0x2c1b3c6d;
+        }
+        ctx->data[i] = h;
+    }
+    atomic_fetch_add(&ctx->calls, 1);
+}
+
+TEST_CASE("executor parallel_for covers the range and scales", "[executor]")
+{
+    esp_executor_handle_t executor = esp_executor_get_default();
+    TEST_ASSERT_NOT_NULL(executor);
+
+    parallel_for_ctx_t ctx = { .data = calloc(PARALLEL_FOR_SIZE, sizeof(uint32_t)) };
+    uint32_t *expected = calloc(PARALLEL_FOR_SIZE, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(ctx.data);
+    TEST_ASSERT_NOT_NULL(expected);
+    atomic_init(&ctx.calls, 0);
+
+    int64_t start = esp_timer_get_time();
+    hash_range(0, PARALLEL_FOR_SIZE, &ctx);
+    int64_t serial_time = esp_timer_get_time() - start;
+    memcpy(expected, ctx.data, PARALLEL_FOR_SIZE * sizeof(uint32_t));
+    memset(ctx.data, 0, PARALLEL_FOR_SIZE * sizeof(uint32_t));
+
+    start = esp_timer_get_time();
+    TEST_ESP_OK(esp_executor_parallel_for(executor, 0, PARALLEL_FOR_SIZE, 0, hash_range, &ctx));
+    int64_t parallel_time = esp_timer_get_time() - start;
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(expected, ctx.data, PARALLEL_FOR_SIZE);
+    TEST_ASSERT_TRUE(atomic_load(&ctx.calls) > 2);
+    printf("parallel_for over %d items: serial %lld us, %d workers %lld us\n",
+           PARALLEL_FOR_SIZE, serial_time, (int) esp_executor_get_num_workers(executor), parallel_time);
+#if !CONFIG_FREERTOS_UNICORE
+    TEST_ASSERT_TRUE(parallel_time * 4 < serial_time * 3);
+#endif
+
+    /* Uneven range with an explicit grain */
+    atomic_store(&ctx.calls, 0);
+    TEST_ESP_OK(esp_executor_parallel_for(executor, 10, 1010, 7, hash_range, &ctx));
+    TEST_ASSERT_EQUAL((1000 + 6) / 7, atomic_load(&ctx.calls));
+    TEST_ESP_OK(esp_executor_parallel_for(executor, 5, 5, 0, hash_range, &ctx));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_executor_parallel_for(executor, 6, 5, 0, hash_range, &ctx));
+
+    free(expected);
+    free(ctx.data);
+}
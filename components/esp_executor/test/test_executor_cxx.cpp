@@ -0,0 +1,68 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "unity.h"
+#include "esp_executor.hpp"
+
+TEST_CASE("executor C++ futures and continuations", "[executor]")
+{
+    idf::Executor executor;
+    TEST_ASSERT_NOT_NULL(executor.get_handle());
+
+    idf::Future<int> answer = executor.submit([]() {
+        return 6 * 7;
+    });
+    TEST_ASSERT_TRUE(answer.valid());
+
+    idf::Future<std::string> text = answer.then([](int &value) {
+        return std::to_string(value);
+    });
+    std::atomic<int> void_calls(0);
+    idf::Future<void> printed = text.then([&](std::string &value) {
+        TEST_ASSERT_EQUAL_STRING("42", value.c_str());
+        void_calls++;
+    });
+    idf::Future<int> after_void = printed.then([&]() {
+        return void_calls.load() + 1;
+    });
+
+    TEST_ASSERT_EQUAL(2, after_void.get());
+    TEST_ASSERT_TRUE(printed.is_ready());
+    TEST_ASSERT_EQUAL_STRING("42", text.get().c_str());
+    TEST_ASSERT_EQUAL(42, answer.get());
+
+    /* Move-only results */
+    idf::Future<std::unique_ptr<int>> owned = executor.submit([]() {
+        return std::unique_ptr<int>(new int(5));
+    });
+    std::unique_ptr<int> value = owned.get();
+    TEST_ASSERT_EQUAL(5, *value);
+}
+
+TEST_CASE("executor C++ parallel_for", "[executor]")
+{
+    idf::Executor executor;
+    std::vector<int> squares(1000);
+
+    TEST_ESP_OK(executor.parallel_for(0, squares.size(), [&](size_t i) {
+        squares[i] = i * i;
+    }));
+    for (size_t i = 0; i < squares.size(); i++) {
+        TEST_ASSERT_EQUAL(i * i, squares[i]);
+    }
+
+    /* Nested parallel_for from within a job doesn't deadlock */
+    std::atomic<int> total(0);
+    idf::Future<void> outer = executor.submit([&]() {
+        executor.parallel_for(0, 8, [&](size_t) {
+            executor.parallel_for(0, 100, [&](size_t) {
+                total++;
+            }, 10);
+        }, 1);
+    });
+    TEST_ASSERT_TRUE(outer.wait(1000 / portTICK_PERIOD_MS));
+    TEST_ASSERT_EQUAL(800, total.load());
+}
@@ -4,3 +4,7 @@
 
 COMPONENT_SRCDIRS :=  . lib
 COMPONENT_PRIV_INCLUDEDIRS := lib/include
+
+ifndef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+COMPONENT_OBJEXCLUDE += lib/http_pool.o
+endif
@@ -23,6 +23,8 @@
 #include "esp_transport_tcp.h"
 #include "http_utils.h"
 #include "http_auth.h"
+#include "http_pool.h"
+#include "esp_transport_inflate.h"
 #include "sdkconfig.h"
 #include "esp_http_client.h"
 #include "errno.h"
@@ -120,6 +122,15 @@ struct esp_http_client {
     bool                        first_line_prepared;
     int                         header_index;
     bool                        is_async;
+    http_pool_tls_cfg_t         tls_cfg;
+    bool                        skip_connection_pool;
+    http_pool_key_t             *pool_key;          /*!< Server of the connection, set while connected if pooling is enabled */
+    bool                        connection_reused;  /*!< The connection was idle before the current request */
+    bool                        decompress_response;
+    esp_transport_inflate_handle_t inflate;         /*!< Decoder of compressed responses, allocated on first use */
+    int                         content_encoding;   /*!< esp_transport_inflate_format_t of the response, -1 if not compressed */
+    bool                        decoding;           /*!< The body of the current response is decoded */
+    esp_transport_inflate_status_t inflate_status;  /*!< Status of the decoder for the current response */
 };
 
 typedef struct esp_http_client esp_http_client_t;
@@ -179,6 +190,8 @@ static int http_on_message_begin(http_parser *parser)
 
     client->response->is_chunked = false;
     client->is_chunk_complete = false;
+    client->content_encoding = -1;
+    client->decoding = false;
     return 0;
 }
 
@@ -193,6 +206,24 @@ static int http_on_status(http_parser *parser, const char *at, size_t length)
     return 0;
 }
 
+/* Returns the esp_transport_inflate_format_t of a Content-Encoding, -1 if it isn't supported */
+static int http_content_encoding(const char *at, size_t length)
+{
+    while (length && (at[length - 1] == ' ' || at[length - 1] == '\t')) {
+        length--;
+    }
+    if ((length == 4 && strncasecmp(at, "gzip", 4) == 0) || (length == 6 && strncasecmp(at, "x-gzip", 6) == 0)) {
+        return ESP_TRANSPORT_INFLATE_GZIP;
+    }
+    if (length == 7 && strncasecmp(at, "deflate", 7) == 0) {
+        return ESP_TRANSPORT_INFLATE_DEFLATE;
+    }
+    if (!(length == 8 && strncasecmp(at, "identity", 8) == 0)) {
+        ESP_LOGW(TAG, "Content-Encoding %.*s is not supported, the body is not decoded", (int)length, at);
+    }
+    return -1;
+}
+
 static int http_on_header_field(http_parser *parser, const char *at, size_t length)
 {
     esp_http_client_t *client = parser->data;
@@ -214,6 +245,8 @@ static int http_on_header_value(http_parser *parser, const char *at, size_t leng
         client->response->is_chunked = true;
     } else if (strcasecmp(client->current_header_key, "WWW-Authenticate") == 0) {
         http_utils_assign_string(&client->auth_header, at, length);
+    } else if (strcasecmp(client->current_header_key, "Content-Encoding") == 0 && client->decompress_response) {
+        client->content_encoding = http_content_encoding(at, length);
     }
     http_utils_assign_string(&client->current_header_value, at, length);
 
@@ -228,6 +261,68 @@ static int http_on_header_value(http_parser *parser, const char *at, size_t leng
     return 0;
 }
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+static esp_err_t http_client_decode_begin(esp_http_client_handle_t client)
+{
+    int status = client->response->status_code;
+    /* Responses without a body are not decoded */
+    if (client->content_encoding < 0 || client->connection_info.method == HTTP_METHOD_HEAD
+            || client->response->content_length == 0 || status == 204 || status == 304) {
+        return ESP_OK;
+    }
+    if (client->inflate == NULL) {
+        client->inflate = esp_transport_inflate_create(CONFIG_ESP_HTTP_CLIENT_INFLATE_WINDOW_BITS);
+        if (client->inflate == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate the decoder of the response");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    esp_transport_inflate_reset(client->inflate, client->content_encoding, false);
+    client->inflate_status = ESP_TRANSPORT_INFLATE_OK;
+    client->response->buffer->raw_len = 0;
+    client->decoding = true;
+    return ESP_OK;
+}
+
+/* Decodes the compressed data received so far, returns the length written to buffer or ESP_FAIL */
+static int http_client_decode(esp_http_client_handle_t client, char *buffer, int len)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+    if (client->inflate_status == ESP_TRANSPORT_INFLATE_DONE) {
+        /* Data after the end of the stream is ignored */
+        res_buffer->raw_len = 0;
+        return 0;
+    } else if (client->inflate_status != ESP_TRANSPORT_INFLATE_OK) {
+        return ESP_FAIL;
+    }
+    size_t consumed = 0;
+    size_t produced = 0;
+    client->inflate_status = esp_transport_inflate_run(client->inflate, (const uint8_t *)res_buffer->raw_data,
+                                                       res_buffer->raw_len, &consumed, (uint8_t *)buffer, len, &produced);
+    res_buffer->raw_data += consumed;
+    res_buffer->raw_len -= consumed;
+    if (client->inflate_status < 0) {
+        ESP_LOGE(TAG, "Invalid compressed response, error %d", client->inflate_status);
+        return ESP_FAIL;
+    }
+    if (client->inflate_status == ESP_TRANSPORT_INFLATE_DONE) {
+        /* Data after the end of the stream is ignored */
+        res_buffer->raw_len = 0;
+    }
+    return produced;
+}
+
+/* Dispatches the decoded data to HTTP_EVENT_ON_DATA, the request buffer is free while the response is read */
+static esp_err_t http_client_dispatch_decoded(esp_http_client_handle_t client)
+{
+    int len;
+    while ((len = http_client_decode(client, client->request->buffer->data, client->buffer_size_tx)) > 0) {
+        http_dispatch_event(client, HTTP_EVENT_ON_DATA, client->request->buffer->data, len);
+    }
+    return len < 0 ? ESP_FAIL : ESP_OK;
+}
+#endif
+
 static int http_on_headers_complete(http_parser *parser)
 {
     esp_http_client_handle_t client = parser->data;
@@ -237,6 +332,11 @@ static int http_on_headers_complete(http_parser *parser)
     client->response->data_process = 0;
     ESP_LOGD(TAG, "http_on_headers_complete, status=%d, offset=%d, nread=%d", parser->status_code, client->response->data_offset, parser->nread);
     client->state = HTTP_STATE_RES_COMPLETE_HEADER;
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+    if (http_client_decode_begin(client) != ESP_OK) {
+        return -1;
+    }
+#endif
     return 0;
 }
 
@@ -244,6 +344,16 @@ static int http_on_body(http_parser *parser, const char *at, size_t length)
 {
     esp_http_client_t *client = parser->data;
     ESP_LOGD(TAG, "http_on_body %d", length);
+    if (client->decoding) {
+        /* Compressed data waits at the start of the buffer until it is decoded, over data already parsed.
+           More data is only read once it is all decoded */
+        esp_http_buffer_t *res_buffer = client->response->buffer;
+        memmove(res_buffer->data + res_buffer->raw_len, at, length);
+        res_buffer->raw_data = res_buffer->data;
+        res_buffer->raw_len += length;
+        client->response->data_process += length;
+        return 0;
+    }
     client->response->buffer->raw_data = (char *)at;
     if (client->response->buffer->output_ptr) {
         memcpy(client->response->buffer->output_ptr, (char *)at, length);
@@ -434,6 +544,8 @@ static esp_err_t _set_config(esp_http_client_handle_t client, const esp_http_cli
     if (config->is_async) {
         client->is_async = true;
     }
+    client->skip_connection_pool = config->skip_connection_pool;
+    client->decompress_response = config->decompress_response;
 
     return ESP_OK;
 }
@@ -474,6 +586,8 @@ static esp_err_t esp_http_client_prepare(esp_http_client_handle_t client)
 {
     client->process_again = 0;
     client->response->data_process = 0;
+    /* Body of the previous response which was not read, if the connection was closed before */
+    client->response->buffer->raw_len = 0;
     client->first_line_prepared = false;
     http_parser_init(client->parser, HTTP_RESPONSE);
     if (client->connection_info.username) {
@@ -497,32 +611,10 @@ static esp_err_t esp_http_client_prepare(esp_http_client_handle_t client)
     return ESP_OK;
 }
 
-esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+static esp_err_t _init_transports(esp_http_client_handle_t client)
 {
-
-    esp_http_client_handle_t client;
     esp_transport_handle_t tcp;
-    bool _success;
-
-    _success = (
-                   (client                         = calloc(1, sizeof(esp_http_client_t)))           &&
-                   (client->parser                 = calloc(1, sizeof(struct http_parser)))          &&
-                   (client->parser_settings        = calloc(1, sizeof(struct http_parser_settings))) &&
-                   (client->auth_data              = calloc(1, sizeof(esp_http_auth_data_t)))        &&
-                   (client->request                = calloc(1, sizeof(esp_http_data_t)))             &&
-                   (client->request->headers       = http_header_init())                             &&
-                   (client->request->buffer        = calloc(1, sizeof(esp_http_buffer_t)))           &&
-                   (client->response               = calloc(1, sizeof(esp_http_data_t)))             &&
-                   (client->response->headers      = http_header_init())                             &&
-                   (client->response->buffer       = calloc(1, sizeof(esp_http_buffer_t)))
-               );
-
-    if (!_success) {
-        ESP_LOGE(TAG, "Error allocate memory");
-        goto error;
-    }
-
-    _success = (
+    bool _success = (
                    (client->transport_list = esp_transport_list_init()) &&
                    (tcp = esp_transport_tcp_init()) &&
                    (esp_transport_set_default_port(tcp, DEFAULT_HTTP_PORT) == ESP_OK) &&
@@ -530,7 +622,7 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
                );
     if (!_success) {
         ESP_LOGE(TAG, "Error initialize transport");
-        goto error;
+        return ESP_FAIL;
     }
 #ifdef CONFIG_ESP_HTTP_CLIENT_ENABLE_HTTPS
     esp_transport_handle_t ssl;
@@ -542,27 +634,63 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
 
     if (!_success) {
         ESP_LOGE(TAG, "Error initialize SSL Transport");
-        goto error;
+        return ESP_FAIL;
     }
 
-    if (config->use_global_ca_store == true) {
+    if (client->tls_cfg.use_global_ca_store == true) {
         esp_transport_ssl_enable_global_ca_store(ssl);
-    } else if (config->cert_pem) {
-        esp_transport_ssl_set_cert_data(ssl, config->cert_pem, strlen(config->cert_pem));
+    } else if (client->tls_cfg.cert_pem) {
+        esp_transport_ssl_set_cert_data(ssl, client->tls_cfg.cert_pem, strlen(client->tls_cfg.cert_pem));
     }
 
-    if (config->client_cert_pem) {
-        esp_transport_ssl_set_client_cert_data(ssl, config->client_cert_pem, strlen(config->client_cert_pem));
+    if (client->tls_cfg.client_cert_pem) {
+        esp_transport_ssl_set_client_cert_data(ssl, client->tls_cfg.client_cert_pem, strlen(client->tls_cfg.client_cert_pem));
     }
 
-    if (config->client_key_pem) {
-        esp_transport_ssl_set_client_key_data(ssl, config->client_key_pem, strlen(config->client_key_pem));
+    if (client->tls_cfg.client_key_pem) {
+        esp_transport_ssl_set_client_key_data(ssl, client->tls_cfg.client_key_pem, strlen(client->tls_cfg.client_key_pem));
     }
 
-    if (config->skip_cert_common_name_check) {
+    if (client->tls_cfg.skip_cert_common_name_check) {
         esp_transport_ssl_skip_common_name_check(ssl);
     }
 #endif
+    return ESP_OK;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+
+    esp_http_client_handle_t client;
+    bool _success;
+
+    _success = (
+                   (client                         = calloc(1, sizeof(esp_http_client_t)))           &&
+                   (client->parser                 = calloc(1, sizeof(struct http_parser)))          &&
+                   (client->parser_settings        = calloc(1, sizeof(struct http_parser_settings))) &&
+                   (client->auth_data              = calloc(1, sizeof(esp_http_auth_data_t)))        &&
+                   (client->request                = calloc(1, sizeof(esp_http_data_t)))             &&
+                   (client->request->headers       = http_header_init())                             &&
+                   (client->request->buffer        = calloc(1, sizeof(esp_http_buffer_t)))           &&
+                   (client->response               = calloc(1, sizeof(esp_http_data_t)))             &&
+                   (client->response->headers      = http_header_init())                             &&
+                   (client->response->buffer       = calloc(1, sizeof(esp_http_buffer_t)))
+               );
+
+    if (!_success) {
+        ESP_LOGE(TAG, "Error allocate memory");
+        goto error;
+    }
+
+    client->tls_cfg.cert_pem = config->cert_pem;
+    client->tls_cfg.client_cert_pem = config->client_cert_pem;
+    client->tls_cfg.client_key_pem = config->client_key_pem;
+    client->tls_cfg.use_global_ca_store = config->use_global_ca_store;
+    client->tls_cfg.skip_cert_common_name_check = config->skip_cert_common_name_check;
+
+    if (_init_transports(client) != ESP_OK) {
+        goto error;
+    }
 
     if (_set_config(client, config) != ESP_OK) {
         ESP_LOGE(TAG, "Error set configurations");
@@ -604,6 +732,18 @@ esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *co
         goto error;
     }
 
+    if (client->decompress_response) {
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+        if (esp_http_client_set_header(client, "Accept-Encoding", "gzip, deflate") != ESP_OK) {
+            ESP_LOGE(TAG, "Error while setting default configurations");
+            goto error;
+        }
+#else
+        ESP_LOGW(TAG, "Please enable response decompression at menuconfig to decode responses");
+        client->decompress_response = false;
+#endif
+    }
+
     client->parser_settings->on_message_begin = http_on_message_begin;
     client->parser_settings->on_url = http_on_url;
     client->parser_settings->on_status = http_on_status;
@@ -630,7 +770,9 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
         return ESP_FAIL;
     }
     esp_http_client_close(client);
-    esp_transport_list_destroy(client->transport_list);
+    if (client->transport_list) {
+        esp_transport_list_destroy(client->transport_list);
+    }
     if (client->request) {
         http_header_destroy(client->request->headers);
         if (client->request->buffer) {
@@ -648,6 +790,9 @@ esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
         free(client->response);
     }
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+    esp_transport_inflate_destroy(client->inflate);
+#endif
     free(client->parser);
     free(client->parser_settings);
     _clear_connection_info(client);
@@ -820,6 +965,11 @@ static int esp_http_client_get_data(esp_http_client_handle_t client)
     int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
     if (rlen >= 0) {
         http_parser_execute(client->parser, client->parser_settings, res_buffer->data, rlen);
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+        if (client->decoding && http_client_dispatch_decoded(client) != ESP_OK) {
+            return ESP_FAIL;
+        }
+#endif
     }
     return rlen;
 }
@@ -837,13 +987,88 @@ bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
             return false;
         }
     }
+    if (client->decoding && client->inflate_status != ESP_TRANSPORT_INFLATE_DONE) {
+        ESP_LOGD(TAG, "Compressed data was not completely decoded");
+        return false;
+    }
     return true;
 }
 
+static bool http_client_data_remain(esp_http_client_handle_t client)
+{
+    if (client->response->is_chunked) {
+        return !client->is_chunk_complete;
+    }
+    return client->response->data_process < client->response->content_length;
+}
+
+static void http_client_read_failed(esp_http_client_handle_t client, int rlen)
+{
+    if (errno != 0) {
+        esp_log_level_t sev = ESP_LOG_WARN;
+        /* On connection close from server, recv should ideally return 0 but we have error conversion
+         * in `tcp_transport` SSL layer which translates it `-1` and hence below additional checks */
+        if (rlen == -1 && errno == ENOTCONN && client->response->is_chunked) {
+            /* Explicit call to parser for invoking `message_complete` callback */
+            http_parser_execute(client->parser, client->parser_settings, client->response->buffer->data, 0);
+            /* ...and lowering the message severity, as closed connection from server side is expected in chunked transport */
+            sev = ESP_LOG_DEBUG;
+        }
+        ESP_LOG_LEVEL(sev, TAG, "esp_transport_read returned:%d and errno:%d ", rlen, errno);
+    }
+}
+
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+static int http_client_read_decoded(esp_http_client_handle_t client, char *buffer, int len)
+{
+    esp_http_buffer_t *res_buffer = client->response->buffer;
+    int ridx = 0;
+    while (ridx < len) {
+        int dlen = http_client_decode(client, buffer + ridx, len - ridx);
+        if (dlen < 0) {
+            return ESP_FAIL;
+        }
+        ridx += dlen;
+        if (dlen > 0) {
+            continue;
+        }
+        /* All the compressed data received is decoded, the rest of the response is read
+           even after the end of the stream, so that the connection can be reused */
+        if (!http_client_data_remain(client)) {
+            if (client->inflate_status != ESP_TRANSPORT_INFLATE_DONE) {
+                ESP_LOGE(TAG, "Compressed response is truncated");
+                client->inflate_status = ESP_TRANSPORT_INFLATE_ERR_DATA;
+                return ridx ? ridx : ESP_FAIL;
+            }
+            break;
+        }
+        errno = 0;
+        int rlen = esp_transport_read(client->transport, res_buffer->data, client->buffer_size_rx, client->timeout_ms);
+        ESP_LOGD(TAG, "decoded=%d, rlen=%d", ridx, rlen);
+        if (rlen <= 0) {
+            http_client_read_failed(client, rlen);
+            if (rlen < 0 && ridx == 0) {
+                return ESP_FAIL;
+            } else {
+                return ridx;
+            }
+        }
+        http_parser_execute(client->parser, client->parser_settings, res_buffer->data, rlen);
+    }
+    return ridx;
+}
+#endif
+
 int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
 {
     esp_http_buffer_t *res_buffer = client->response->buffer;
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+    if (client->decoding) {
+        return http_client_read_decoded(client, buffer, len);
+    }
+#endif
+
     int rlen = ESP_FAIL, ridx = 0;
     if (res_buffer->raw_len) {
         int remain_len = client->response->buffer->raw_len;
@@ -858,11 +1083,7 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     int need_read = len - ridx;
     bool is_data_remain = true;
     while (need_read > 0 && is_data_remain) {
-        if (client->response->is_chunked) {
-            is_data_remain = !client->is_chunk_complete;
-        } else {
-            is_data_remain = client->response->data_process < client->response->content_length;
-        }
+        is_data_remain = http_client_data_remain(client);
         ESP_LOGD(TAG, "is_data_remain=%d, is_chunked=%d, content_length=%d", is_data_remain, client->response->is_chunked, client->response->content_length);
         if (!is_data_remain) {
             break;
@@ -876,18 +1097,7 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
         ESP_LOGD(TAG, "need_read=%d, byte_to_read=%d, rlen=%d, ridx=%d", need_read, byte_to_read, rlen, ridx);
 
         if (rlen <= 0) {
-            if (errno != 0) {
-                esp_log_level_t sev = ESP_LOG_WARN;
-                /* On connection close from server, recv should ideally return 0 but we have error conversion
-                 * in `tcp_transport` SSL layer which translates it `-1` and hence below additional checks */
-                if (rlen == -1 && errno == ENOTCONN && client->response->is_chunked) {
-                    /* Explicit call to parser for invoking `message_complete` callback */
-                    http_parser_execute(client->parser, client->parser_settings, res_buffer->data, 0);
-                    /* ...and lowering the message severity, as closed connection from server side is expected in chunked transport */
-                    sev = ESP_LOG_DEBUG;
-                }
-                ESP_LOG_LEVEL(sev, TAG, "esp_transport_read returned:%d and errno:%d ", rlen, errno);
-            }
+            http_client_read_failed(client, rlen);
             if (rlen < 0 && ridx == 0) {
                 return ESP_FAIL;
             } else {
@@ -906,6 +1116,44 @@ int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
     return ridx;
 }
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+/* Idempotent methods (RFC 7231, 4.2.2) which can be sent again if the server may have
+   received them. PUT is left out, as its body may be written by the application */
+static bool http_method_is_idempotent(esp_http_client_method_t method)
+{
+    switch (method) {
+        case HTTP_METHOD_GET:
+        case HTTP_METHOD_HEAD:
+        case HTTP_METHOD_DELETE:
+        case HTTP_METHOD_OPTIONS:
+            return true;
+        default:
+            return false;
+    }
+}
+#endif
+
+/* The server may close an idle connection at any time, an idempotent request which failed
+   on a reused connection is sent again on a new one */
+static bool http_client_retry_request(esp_http_client_handle_t client)
+{
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+    if (!client->connection_reused || client->is_async ||
+        !http_method_is_idempotent(client->connection_info.method)) {
+        return false;
+    }
+    ESP_LOGD(TAG, "Reused connection failed, retry on a new connection");
+    client->connection_reused = false;
+    if (client->state > HTTP_STATE_INIT) {
+        esp_http_client_close(client);
+    }
+    client->process_again = 1;
+    return true;
+#else
+    return false;
+#endif
+}
+
 esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
 {
     esp_err_t err;
@@ -931,6 +1179,9 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     if (client->is_async && errno == EAGAIN) {
                         return ESP_ERR_HTTP_EAGAIN;
                     }
+                    if (http_client_retry_request(client)) {
+                        break;
+                    }
                     return err;
                 }
                 /* falls through */
@@ -947,6 +1198,9 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     if (client->is_async && errno == EAGAIN) {
                         return ESP_ERR_HTTP_EAGAIN;
                     }
+                    if (http_client_retry_request(client)) {
+                        break;
+                    }
                     return ESP_ERR_HTTP_FETCH_HEADER;
                 }
                 /* falls through */
@@ -955,6 +1209,13 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     ESP_LOGE(TAG, "Error response");
                     return err;
                 }
+#ifdef CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION
+                /* Data received with the headers */
+                if (client->decoding && http_client_dispatch_decoded(client) != ESP_OK) {
+                    esp_http_client_close(client);
+                    return ESP_FAIL;
+                }
+#endif
                 while (client->response->is_chunked && !client->is_chunk_complete) {
                     if (esp_http_client_get_data(client) <= 0) {
                         if (client->is_async && errno == EAGAIN) {
@@ -973,6 +1234,11 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                         break;
                     }
                 }
+                if (client->decoding && client->inflate_status != ESP_TRANSPORT_INFLATE_DONE) {
+                    ESP_LOGE(TAG, "Failed to decode the response");
+                    esp_http_client_close(client);
+                    return ESP_FAIL;
+                }
                 http_dispatch_event(client, HTTP_EVENT_ON_FINISH, NULL, 0);
 
                 if (!http_should_keep_alive(client->parser)) {
@@ -982,6 +1248,7 @@ esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
                     if (client->state > HTTP_STATE_CONNECTED) {
                         client->state = HTTP_STATE_CONNECTED;
                         client->first_line_prepared = false;
+                        client->connection_reused = true;
                     }
                 }
                 break;
@@ -1014,9 +1281,65 @@ int esp_http_client_fetch_headers(esp_http_client_handle_t client)
         client->response->is_chunked = true;
         return 0;
     }
+    if (client->decoding) {
+        /* The length of the decoded data is not known */
+        return 0;
+    }
     return client->response->content_length;
 }
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+/* Takes over an idle connection to the server from the pool, if there is one */
+static bool http_client_pool_take(esp_http_client_handle_t client)
+{
+    if (client->skip_connection_pool) {
+        return false;
+    }
+    /* The key is already set while an asynchronous connection is in progress */
+    if (client->is_async && client->pool_key) {
+        return false;
+    }
+    http_pool_key_destroy(client->pool_key);
+    client->pool_key = http_pool_key_create(client->connection_info.scheme, client->connection_info.host,
+                                            client->connection_info.port, &client->tls_cfg);
+    if (client->pool_key == NULL) {
+        return false;
+    }
+    esp_transport_handle_t transport;
+    esp_transport_list_handle_t list = http_pool_checkout(client->pool_key, &transport);
+    if (list == NULL) {
+        return false;
+    }
+    if (client->transport_list) {
+        esp_transport_list_destroy(client->transport_list);
+    }
+    client->transport_list = list;
+    client->transport = transport;
+    return true;
+}
+
+/* Hands the connection over to the pool if it is idle: the response to the last request was
+   completely read and the server keeps the connection open */
+static bool http_client_pool_give(esp_http_client_handle_t client)
+{
+    bool idle = false;
+    if (client->state == HTTP_STATE_CONNECTED) {
+        idle = !client->first_line_prepared;
+    } else if (client->state >= HTTP_STATE_RES_COMPLETE_HEADER) {
+        idle = http_should_keep_alive(client->parser) && esp_http_client_is_complete_data_received(client);
+    }
+    if (!idle || client->pool_key == NULL || client->transport == NULL) {
+        return false;
+    }
+    http_pool_checkin(client->pool_key, client->transport_list, client->transport);
+    /* The next connection of this client gets a new transport list */
+    client->pool_key = NULL;
+    client->transport_list = NULL;
+    client->transport = NULL;
+    return true;
+}
+#endif
+
 static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 {
     esp_err_t err;
@@ -1034,6 +1357,17 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
 
     if (client->state < HTTP_STATE_CONNECTED) {
         ESP_LOGD(TAG, "Begin connect to: %s://%s:%d", client->connection_info.scheme, client->connection_info.host, client->connection_info.port);
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        if (http_client_pool_take(client)) {
+            client->connection_reused = true;
+            client->state = HTTP_STATE_CONNECTED;
+            http_dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
+            return ESP_OK;
+        }
+#endif
+        if (client->transport_list == NULL && _init_transports(client) != ESP_OK) {
+            return ESP_ERR_NO_MEM;
+        }
         client->transport = esp_transport_list_get_transport(client->transport_list, client->connection_info.scheme);
         if (client->transport == NULL) {
             ESP_LOGE(TAG, "No transport found");
@@ -1063,6 +1397,7 @@ static esp_err_t esp_http_client_connect(esp_http_client_handle_t client)
                 return ESP_ERR_HTTP_CONNECTING;
             }
         }
+        client->connection_reused = false;
         client->state = HTTP_STATE_CONNECTED;
         http_dispatch_event(client, HTTP_EVENT_ON_CONNECTED, NULL, 0);
     }
@@ -1234,6 +1569,14 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client)
 {
     if (client->state >= HTTP_STATE_INIT) {
         http_dispatch_event(client, HTTP_EVENT_DISCONNECTED, esp_transport_get_error_handle(client->transport), 0);
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+        if (http_client_pool_give(client)) {
+            client->state = HTTP_STATE_INIT;
+            return ESP_OK;
+        }
+        http_pool_key_destroy(client->pool_key);
+        client->pool_key = NULL;
+#endif
         client->state = HTTP_STATE_INIT;
         return esp_transport_close(client->transport);
     }
@@ -1276,6 +1619,14 @@ int esp_http_client_get_status_code(esp_http_client_handle_t client)
 }
 
 int esp_http_client_get_content_length(esp_http_client_handle_t client)
+{
+    if (client->decoding) {
+        return -1;
+    }
+    return client->response->content_length;
+}
+
+int esp_http_client_get_encoded_content_length(esp_http_client_handle_t client)
 {
     return client->response->content_length;
 }
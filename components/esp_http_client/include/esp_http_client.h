@@ -39,7 +39,8 @@ typedef enum {
     HTTP_EVENT_HEADER_SENT = HTTP_EVENT_HEADERS_SENT, /*!< This header has been kept for backward compatability
                                                            and will be deprecated in future versions esp-idf */
     HTTP_EVENT_ON_HEADER,       /*!< Occurs when receiving each header sent from the server */
-    HTTP_EVENT_ON_DATA,         /*!< Occurs when receiving data from the server, possibly multiple portions of the packet */
+    HTTP_EVENT_ON_DATA,         /*!< Occurs when receiving data from the server, possibly multiple portions of the packet,
+                                     decoded if `decompress_response` is set */
     HTTP_EVENT_ON_FINISH,       /*!< Occurs when finish a HTTP session */
     HTTP_EVENT_DISCONNECTED,    /*!< The connection has been disconnected */
 } esp_http_client_event_id_t;
@@ -122,12 +123,18 @@ typedef struct {
     bool                        is_async;                 /*!< Set asynchronous mode, only supported with HTTPS for now */
     bool                        use_global_ca_store;      /*!< Use a global ca_store for all the connections in which this bool is set. */
     bool                        skip_cert_common_name_check;    /*!< Skip any validation of server certificate CN field */
+    bool                        skip_connection_pool;     /*!< Neither take a connection from the connection pool, nor put the connection of this client into it */
+    bool                        decompress_response;      /*!< Request gzip or deflate compressed responses and decode them, needs CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION */
 } esp_http_client_config_t;
 
 /**
  * Enum for the HTTP status codes.
  */
 typedef enum {
+    /* 2xx - Success */
+    HttpStatus_Ok                = 200,
+    HttpStatus_PartialContent    = 206,
+
     /* 3xx - Redirection */
     HttpStatus_MovedPermanently  = 301,
     HttpStatus_Found             = 302,
@@ -374,7 +381,8 @@ int esp_http_client_write(esp_http_client_handle_t client, const char *buffer, i
  * @param[in]  client  The esp_http_client handle
  *
  * @return
- *     - (0) if stream doesn't contain content-length header, or chunked encoding (checked by `esp_http_client_is_chunked` response)
+ *     - (0) if stream doesn't contain content-length header, or chunked encoding (checked by `esp_http_client_is_chunked` response),
+ *       or if the response is decoded, as the decoded length is not known
  *     - (-1: ESP_FAIL) if any errors
  *     - Download data length defined by content-length header
  */
@@ -393,6 +401,9 @@ bool esp_http_client_is_chunked_response(esp_http_client_handle_t client);
 /**
  * @brief      Read data from http stream
  *
+ * @note       With `decompress_response`, compressed responses are decoded: the data read is the decoded data,
+ *             and a corrupt or truncated response is an error.
+ *
  * @param[in]  client  The esp_http_client handle
  * @param      buffer  The buffer
  * @param[in]  len     The length
@@ -420,11 +431,23 @@ int esp_http_client_get_status_code(esp_http_client_handle_t client);
  * @param[in]  client  The esp_http_client handle
  *
  * @return
- *     - (-1) Chunked transfer
+ *     - (-1) Chunked transfer, or decoded response (see `decompress_response`)
  *     - Content-Length value as bytes
  */
 int esp_http_client_get_content_length(esp_http_client_handle_t client);
 
+/**
+ * @brief      Get http response content length as sent by the server (from header Content-Length),
+ *             which is the length of the compressed data if the response is decoded
+ *
+ * @param[in]  client  The esp_http_client handle
+ *
+ * @return
+ *     - (-1) Chunked transfer
+ *     - Content-Length value as bytes
+ */
+int esp_http_client_get_encoded_content_length(esp_http_client_handle_t client);
+
 /**
  * @brief      Close http connection, still kept all http request resources
  *
@@ -440,6 +463,8 @@ esp_err_t esp_http_client_close(esp_http_client_handle_t client);
  * @brief      This function must be the last function to call for an session.
  *             It is the opposite of the esp_http_client_init function and must be called with the same handle as input that a esp_http_client_init call returned.
  *             This might close all connections this handle has used and possibly has kept open until now.
+ *             With CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL, an idle connection is instead kept in the connection pool,
+ *             for the next client to the same server.
  *             Don't call this function if you intend to transfer more files, re-using handles is a key to good performance with esp_http_client.
  *
  * @param[in]  client  The esp_http_client handle
@@ -538,6 +563,43 @@ esp_err_t esp_http_client_get_url(esp_http_client_handle_t client, char *url, co
  */
 esp_err_t esp_http_client_get_chunk_length(esp_http_client_handle_t client, int *len);
 
+#ifdef CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL
+/**
+ * @brief      Statistics of the connection pool
+ */
+typedef struct {
+    uint32_t hits;          /*!< Connections taken from the pool */
+    uint32_t misses;        /*!< Connections opened as the pool had none to the server */
+    uint32_t stored;        /*!< Idle connections put into the pool */
+    uint32_t stale;         /*!< Pooled connections found closed by the server */
+    uint32_t expired;       /*!< Pooled connections closed at the end of the idle timeout */
+    uint32_t evicted;       /*!< Pooled connections closed to make room for another one */
+    uint32_t entries;       /*!< Idle connections currently in the pool */
+} esp_http_client_pool_stats_t;
+
+/**
+ * @brief      Get the statistics of the connection pool
+ *
+ * The counters are cumulative since boot, esp_http_client_pool_clear() does not reset them.
+ *
+ * @param[out] stats  Statistics
+ *
+ * @return
+ *     - ESP_OK
+ *     - ESP_ERR_INVALID_ARG if stats is NULL
+ */
+esp_err_t esp_http_client_pool_get_stats(esp_http_client_pool_stats_t *stats);
+
+/**
+ * @brief      Close all the idle connections of the connection pool
+ *
+ * Idle connections are only closed at the end of the idle timeout when the
+ * pool is used, call this function to release their memory and sockets
+ * earlier, for instance before stopping Wi-Fi.
+ */
+void esp_http_client_pool_clear(void);
+#endif /* CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,257 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/lock.h>
+
+#include "esp_log.h"
+#include "esp_private/lru_cache.h"
+#include "esp_http_client.h"
+#include "http_pool.h"
+
+#define POOL_SIZE           CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_SIZE
+#define POOL_MAX_PER_HOST   CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_MAX_PER_HOST
+#define POOL_IDLE_TIMEOUT   CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_IDLE_TIMEOUT
+
+static const char *TAG = "HTTP_POOL";
+
+typedef struct {
+    http_pool_key_t *key;
+    esp_transport_list_handle_t list;   /* NULL if the entry is free */
+    esp_transport_handle_t transport;
+    int64_t idle_since;                 /* Monotonic time in seconds */
+    uint32_t last_used;
+} pool_entry_t;
+
+static pool_entry_t s_entries[POOL_SIZE];
+static uint32_t s_use_count;
+static esp_http_client_pool_stats_t s_stats;
+static _lock_t s_lock;
+
+static uint32_t tls_hash(const http_pool_tls_cfg_t *tls)
+{
+    uint32_t hash = ESP_LRU_CACHE_HASH_INIT;
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, tls->cert_pem);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, tls->client_cert_pem);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, tls->client_key_pem);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, tls->use_global_ca_store);
+    hash = ESP_LRU_CACHE_HASH_FIELD(hash, tls->skip_cert_common_name_check);
+    return hash;
+}
+
+http_pool_key_t *http_pool_key_create(const char *scheme, const char *host, int port, const http_pool_tls_cfg_t *tls)
+{
+    http_pool_key_t *key = calloc(1, sizeof(http_pool_key_t));
+    if (!key) {
+        return NULL;
+    }
+    key->scheme = strdup(scheme);
+    key->host = strdup(host);
+    if (!key->scheme || !key->host) {
+        http_pool_key_destroy(key);
+        return NULL;
+    }
+    key->port = port;
+    key->tls_hash = tls_hash(tls);
+    return key;
+}
+
+void http_pool_key_destroy(http_pool_key_t *key)
+{
+    if (key) {
+        free(key->scheme);
+        free(key->host);
+        free(key);
+    }
+}
+
+static bool same_host(const http_pool_key_t *a, const http_pool_key_t *b)
+{
+    return a->port == b->port && strcasecmp(a->host, b->host) == 0;
+}
+
+static bool same_server(const http_pool_key_t *a, const http_pool_key_t *b)
+{
+    return same_host(a, b) && a->tls_hash == b->tls_hash && strcasecmp(a->scheme, b->scheme) == 0;
+}
+
+static bool is_expired(const pool_entry_t *entry, int64_t now)
+{
+    return entry->idle_since + POOL_IDLE_TIMEOUT <= now;
+}
+
+/* Connections are closed once the lock is released, closing a TLS connection sends an alert */
+static void entry_take(pool_entry_t *entry, pool_entry_t *out)
+{
+    *out = *entry;
+    memset(entry, 0, sizeof(pool_entry_t));
+}
+
+static void entry_close(pool_entry_t *entry)
+{
+    esp_transport_close(entry->transport);
+    esp_transport_list_destroy(entry->list);
+    http_pool_key_destroy(entry->key);
+}
+
+static void close_all(pool_entry_t *entries, int num)
+{
+    for (int i = 0; i < num; i++) {
+        entry_close(&entries[i]);
+    }
+}
+
+esp_transport_list_handle_t http_pool_checkout(const http_pool_key_t *key, esp_transport_handle_t *transport)
+{
+    while (true) {
+        pool_entry_t closed[POOL_SIZE];
+        int num_closed = 0;
+        pool_entry_t found = { 0 };
+        pool_entry_t *best = NULL;
+        int64_t now = esp_lru_cache_now();
+
+        _lock_acquire(&s_lock);
+        for (int i = 0; i < POOL_SIZE; i++) {
+            pool_entry_t *entry = &s_entries[i];
+            if (!entry->list) {
+                continue;
+            }
+            if (is_expired(entry, now)) {
+                s_stats.expired++;
+                entry_take(entry, &closed[num_closed++]);
+                continue;
+            }
+            if (same_server(entry->key, key) && (!best || esp_lru_cache_used_before(best->last_used, entry->last_used))) {
+                best = entry;
+            }
+        }
+        if (best) {
+            entry_take(best, &found);
+        } else {
+            s_stats.misses++;
+        }
+        _lock_release(&s_lock);
+
+        close_all(closed, num_closed);
+        if (!found.list) {
+            return NULL;
+        }
+
+        if (esp_transport_poll_read(found.transport, 0) != 0) {
+            ESP_LOGD(TAG, "connection to %s:%d closed by the server", key->host, key->port);
+            entry_close(&found);
+            _lock_acquire(&s_lock);
+            s_stats.stale++;
+            _lock_release(&s_lock);
+            continue;
+        }
+
+        ESP_LOGD(TAG, "reusing connection to %s:%d", key->host, key->port);
+        _lock_acquire(&s_lock);
+        s_stats.hits++;
+        _lock_release(&s_lock);
+        http_pool_key_destroy(found.key);
+        *transport = found.transport;
+        return found.list;
+    }
+}
+
+void http_pool_checkin(http_pool_key_t *key, esp_transport_list_handle_t list, esp_transport_handle_t transport)
+{
+    pool_entry_t closed[POOL_SIZE];
+    int num_closed = 0;
+    pool_entry_t *slot = NULL;
+    pool_entry_t *lru = NULL;
+    pool_entry_t *host_lru = NULL;
+    int host_num = 0;
+    int64_t now = esp_lru_cache_now();
+
+    _lock_acquire(&s_lock);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        pool_entry_t *entry = &s_entries[i];
+        if (entry->list && is_expired(entry, now)) {
+            s_stats.expired++;
+            entry_take(entry, &closed[num_closed++]);
+        }
+        if (!entry->list) {
+            if (!slot) {
+                slot = entry;
+            }
+            continue;
+        }
+        if (same_host(entry->key, key)) {
+            host_num++;
+            if (!host_lru || esp_lru_cache_used_before(entry->last_used, host_lru->last_used)) {
+                host_lru = entry;
+            }
+        }
+        if (!lru || esp_lru_cache_used_before(entry->last_used, lru->last_used)) {
+            lru = entry;
+        }
+    }
+    if (host_num >= POOL_MAX_PER_HOST) {
+        slot = host_lru;
+    } else if (!slot) {
+        slot = lru;
+    }
+    if (slot->list) {
+        ESP_LOGD(TAG, "evicting connection to %s:%d", slot->key->host, slot->key->port);
+        s_stats.evicted++;
+        entry_take(slot, &closed[num_closed++]);
+    }
+    slot->key = key;
+    slot->list = list;
+    slot->transport = transport;
+    slot->idle_since = now;
+    slot->last_used = ++s_use_count;
+    s_stats.stored++;
+    _lock_release(&s_lock);
+
+    close_all(closed, num_closed);
+}
+
+esp_err_t esp_http_client_pool_get_stats(esp_http_client_pool_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _lock_acquire(&s_lock);
+    *stats = s_stats;
+    stats->entries = 0;
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (s_entries[i].list) {
+            stats->entries++;
+        }
+    }
+    _lock_release(&s_lock);
+    return ESP_OK;
+}
+
+void esp_http_client_pool_clear(void)
+{
+    pool_entry_t closed[POOL_SIZE];
+    int num_closed = 0;
+
+    _lock_acquire(&s_lock);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (s_entries[i].list) {
+            entry_take(&s_entries[i], &closed[num_closed++]);
+        }
+    }
+    _lock_release(&s_lock);
+
+    close_all(closed, num_closed);
+}
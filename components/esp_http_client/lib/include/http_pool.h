@@ -0,0 +1,103 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _HTTP_POOL_H_
+#define _HTTP_POOL_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * TLS settings of the transports of a client
+ *
+ * A pooled connection carries its transport list, configured with these
+ * settings, to the client which takes it over.
+ */
+typedef struct {
+    const char *cert_pem;
+    const char *client_cert_pem;
+    const char *client_key_pem;
+    bool use_global_ca_store;
+    bool skip_cert_common_name_check;
+} http_pool_tls_cfg_t;
+
+/**
+ * Identifies the server of a connection
+ *
+ * A connection is only handed to a client with the same scheme, host and
+ * port, and the same TLS settings: a connection to a server which was not
+ * verified must not be used by a client which requires verification.
+ */
+typedef struct http_pool_key {
+    char *scheme;           /*!< Scheme, "http" or "https" */
+    char *host;             /*!< Host name, null-terminated */
+    int port;               /*!< Port of the server */
+    uint32_t tls_hash;      /*!< Hash of the TLS settings */
+} http_pool_key_t;
+
+/**
+ * @brief      Create the pool key of a connection
+ *
+ * @param[in]  scheme  The scheme
+ * @param[in]  host    The host
+ * @param[in]  port    The port
+ * @param[in]  tls     TLS settings of the transports
+ *
+ * @return     Key, or NULL if out of memory
+ */
+http_pool_key_t *http_pool_key_create(const char *scheme, const char *host, int port, const http_pool_tls_cfg_t *tls);
+
+/**
+ * @brief      Free a key, may be NULL
+ */
+void http_pool_key_destroy(http_pool_key_t *key);
+
+/**
+ * @brief      Take an idle connection to the server of a key out of the pool
+ *
+ * The most recently used connection is preferred. Expired connections are
+ * closed on the way, and so are connections found readable: an idle
+ * connection has nothing to read unless the server closed it.
+ *
+ * @param[in]  key        Key of the server
+ * @param[out] transport  Connected transport of the returned list
+ *
+ * @return     Transport list now owned by the caller, NULL if no connection was found
+ */
+esp_transport_list_handle_t http_pool_checkout(const http_pool_key_t *key, esp_transport_handle_t *transport);
+
+/**
+ * @brief      Put an idle connection into the pool
+ *
+ * The pool takes ownership of key, list and transport. Expired connections
+ * are closed, then the least recently used connection to the same server
+ * if it has the maximum number of connections, or else the least recently
+ * used connection if the pool is full.
+ *
+ * @param[in]  key        Key of the server
+ * @param[in]  list       Transport list of the client
+ * @param[in]  transport  Connected transport of list
+ */
+void http_pool_checkin(http_pool_key_t *key, esp_transport_list_handle_t list, esp_transport_handle_t transport);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
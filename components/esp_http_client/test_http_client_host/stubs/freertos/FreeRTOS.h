@@ -0,0 +1,5 @@
+#pragma once
+
+/* What the public headers rely on FreeRTOS.h for */
+#include <stdbool.h>
+#include <stdint.h>
@@ -0,0 +1,6 @@
+#pragma once
+
+#define CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL                  1
+#define CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_SIZE             4
+#define CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_MAX_PER_HOST     2
+#define CONFIG_ESP_HTTP_CLIENT_CONNECTION_POOL_IDLE_TIMEOUT     10
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <set>
+#include "catch.hpp"
+#include "esp_http_client.h"
+#include "http_pool.h"
+
+extern "C" int64_t fake_clock_s;
+
+/* Connections of the tests, a list holds the transport of its connection */
+struct esp_transport_item_t {
+    int id;
+    bool readable;
+};
+
+struct esp_transport_internal {
+    esp_transport_item_t transport;
+};
+
+namespace {
+
+std::set<int> open_connections;
+std::set<int> destroyed_lists;
+
+} // namespace
+
+extern "C" int esp_transport_close(esp_transport_handle_t t)
+{
+    open_connections.erase(t->id);
+    return 0;
+}
+
+extern "C" esp_err_t esp_transport_list_destroy(esp_transport_list_handle_t list)
+{
+    CHECK(open_connections.count(list->transport.id) == 0);
+    destroyed_lists.insert(list->transport.id);
+    delete list;
+    return ESP_OK;
+}
+
+extern "C" int esp_transport_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    CHECK(timeout_ms == 0);
+    return t->readable ? 1 : 0;
+}
+
+namespace {
+
+const http_pool_tls_cfg_t no_tls = {};
+
+struct server {
+    const char *scheme;
+    const char *host;
+    int port;
+    http_pool_tls_cfg_t tls;
+
+    server(const char *host, int port = 80, const char *scheme = "http", http_pool_tls_cfg_t tls = no_tls)
+        : scheme(scheme), host(host), port(port), tls(tls) {}
+
+    http_pool_key_t *key() const
+    {
+        http_pool_key_t *key = http_pool_key_create(scheme, host, port, &tls);
+        REQUIRE(key != nullptr);
+        return key;
+    }
+
+    /* A client closing its idle connection */
+    esp_transport_list_handle_t checkin(int id) const
+    {
+        esp_transport_list_handle_t list = new esp_transport_internal{{id, false}};
+        open_connections.insert(id);
+        http_pool_checkin(key(), list, &list->transport);
+        return list;
+    }
+
+    /* A client connecting, returns the id of the connection it took over, -1 if none */
+    int checkout() const
+    {
+        http_pool_key_t *k = key();
+        esp_transport_handle_t transport = nullptr;
+        esp_transport_list_handle_t list = http_pool_checkout(k, &transport);
+        http_pool_key_destroy(k);
+        if (!list) {
+            return -1;
+        }
+        CHECK(transport == &list->transport);
+        int id = transport->id;
+        open_connections.erase(id);
+        delete list;
+        return id;
+    }
+};
+
+esp_http_client_pool_stats_t get_stats()
+{
+    esp_http_client_pool_stats_t stats;
+    REQUIRE(esp_http_client_pool_get_stats(&stats) == ESP_OK);
+    return stats;
+}
+
+struct pool_fixture {
+    esp_http_client_pool_stats_t before;
+    pool_fixture()
+    {
+        esp_http_client_pool_clear();
+        destroyed_lists.clear();
+        before = get_stats();
+    }
+    ~pool_fixture()
+    {
+        esp_http_client_pool_clear();
+        CHECK(open_connections.empty());
+    }
+};
+
+} // namespace
+
+TEST_CASE_METHOD(pool_fixture, "idle connection is taken over by the next client", "[http_pool]")
+{
+    server s("example.com");
+    CHECK(s.checkout() == -1);
+    s.checkin(1);
+    CHECK(s.checkout() == 1);
+    CHECK(s.checkout() == -1);
+    CHECK(destroyed_lists.empty());
+
+    esp_http_client_pool_stats_t stats = get_stats();
+    CHECK(stats.hits - before.hits == 1);
+    CHECK(stats.misses - before.misses == 2);
+    CHECK(stats.stored - before.stored == 1);
+    CHECK(stats.entries == 0);
+}
+
+TEST_CASE_METHOD(pool_fixture, "connections are keyed by scheme, host, port and TLS settings", "[http_pool]")
+{
+    static const char ca[] = "ca";
+    http_pool_tls_cfg_t verified = {};
+    verified.cert_pem = ca;
+
+    server("example.com", 443, "https", verified).checkin(1);
+
+    CHECK(server("example.com", 8443, "https", verified).checkout() == -1);
+    CHECK(server("example.org", 443, "https", verified).checkout() == -1);
+    CHECK(server("example.com", 443, "http", verified).checkout() == -1);
+    /* A connection to a server which was not verified must not be used by a client which requires verification */
+    CHECK(server("example.com", 443, "https").checkout() == -1);
+    http_pool_tls_cfg_t skip_cn = verified;
+    skip_cn.skip_cert_common_name_check = true;
+    CHECK(server("example.com", 443, "https", skip_cn).checkout() == -1);
+
+    CHECK(server("EXAMPLE.com", 443, "HTTPS", verified).checkout() == 1);
+}
+
+TEST_CASE_METHOD(pool_fixture, "most recently used connection is taken first", "[http_pool]")
+{
+    server s("example.com");
+    s.checkin(1);
+    s.checkin(2);
+    CHECK(s.checkout() == 2);
+    CHECK(s.checkout() == 1);
+}
+
+TEST_CASE_METHOD(pool_fixture, "connections per server are limited", "[http_pool]")
+{
+    server s("example.com");
+    server https("example.com", 443, "https");
+    s.checkin(1);
+    s.checkin(2);
+    https.checkin(3);
+    s.checkin(4);
+
+    CHECK(open_connections == std::set<int>({2, 3, 4}));
+    CHECK(destroyed_lists == std::set<int>({1}));
+    CHECK(s.checkout() == 4);
+    CHECK(s.checkout() == 2);
+    CHECK(https.checkout() == 3);
+
+    esp_http_client_pool_stats_t stats = get_stats();
+    CHECK(stats.evicted - before.evicted == 1);
+}
+
+TEST_CASE_METHOD(pool_fixture, "least recently used connection is closed when the pool is full", "[http_pool]")
+{
+    server a("a"), b("b"), c("c"), d("d"), e("e");
+    a.checkin(1);
+    b.checkin(2);
+    c.checkin(3);
+    d.checkin(4);
+    e.checkin(5);
+
+    CHECK(open_connections == std::set<int>({2, 3, 4, 5}));
+    CHECK(a.checkout() == -1);
+    CHECK(get_stats().entries == 4);
+}
+
+TEST_CASE_METHOD(pool_fixture, "idle connections expire", "[http_pool]")
+{
+    server a("a"), b("b");
+    a.checkin(1);
+    fake_clock_s += 5;
+    b.checkin(2);
+    fake_clock_s += 4;
+    CHECK(a.checkout() == 1);
+    a.checkin(3);
+    fake_clock_s += 6;
+    /* Expired connections are closed by any use of the pool */
+    CHECK(a.checkout() == 3);
+    CHECK(open_connections.empty());
+
+    esp_http_client_pool_stats_t stats = get_stats();
+    CHECK(stats.expired - before.expired == 1);
+    CHECK(stats.entries == 0);
+}
+
+TEST_CASE_METHOD(pool_fixture, "connection closed by the server is skipped", "[http_pool]")
+{
+    server s("example.com");
+    s.checkin(1);
+    esp_transport_list_handle_t closed = s.checkin(2);
+    /* The FIN of the server, or unexpected data, makes an idle connection readable */
+    closed->transport.readable = true;
+
+    CHECK(s.checkout() == 1);
+    CHECK(destroyed_lists == std::set<int>({2}));
+
+    esp_http_client_pool_stats_t stats = get_stats();
+    CHECK(stats.stale - before.stale == 1);
+    CHECK(stats.hits - before.hits == 1);
+}
+
+TEST_CASE_METHOD(pool_fixture, "clearing the pool closes idle connections", "[http_pool]")
+{
+    server("a").checkin(1);
+    server("b").checkin(2);
+    esp_http_client_pool_clear();
+    CHECK(open_connections.empty());
+    CHECK(destroyed_lists == std::set<int>({1, 2}));
+    CHECK(get_stats().entries == 0);
+    CHECK(get_stats().stored - before.stored == 2);
+}
@@ -44,6 +44,9 @@ initializer that should be kept in sync
         .lru_purge_enable   = false,                    \
         .recv_wait_timeout  = 5,                        \
         .send_wait_timeout  = 5,                        \
+        .worker_count       = 0,                        \
+        .worker_stack_size  = 4096,                     \
+        .worker_pin_to_cores = false,                   \
         .global_user_ctx = NULL,                        \
         .global_user_ctx_free_fn = NULL,                \
         .global_transport_ctx = NULL,                   \
@@ -163,6 +166,26 @@ typedef struct httpd_config {
     uint16_t    recv_wait_timeout;  /*!< Timeout for recv function (in seconds)*/
     uint16_t    send_wait_timeout;  /*!< Timeout for send function (in seconds)*/
 
+    /**
+     * Number of worker tasks processing requests.
+     *
+     * When 0, the server task receives, parses and handles every request
+     * itself, so a slow URI handler delays all the other clients.
+     *
+     * Otherwise the server task only accepts connections and waits for
+     * activity on the sockets, and hands the sessions which are ready over
+     * to the workers. Requests of different sessions are then handled in
+     * parallel, while the requests of a given session are still handled one
+     * at a time, in order. URI handlers must then only access the context of
+     * their own session directly; other sessions should be accessed through
+     * httpd_queue_work().
+     *
+     * The workers run at task_priority.
+     */
+    size_t      worker_count;
+    size_t      worker_stack_size;  /*!< Stack size of each worker task */
+    bool        worker_pin_to_cores; /*!< Pin worker N to core N % portNUM_PROCESSORS, otherwise run the workers on core_id */
+
     /**
      * Global user context.
      *
@@ -237,6 +260,11 @@ typedef struct httpd_config {
      *
      * Users can implement their own matching functions (See description
      * of the `httpd_uri_match_func_t` function prototype)
+     *
+     * With either of the available options, registered URIs are indexed
+     * by a hash table and a prefix tree, so that the lookup cost doesn't
+     * grow with the number of handlers. A custom function is called for
+     * each registered handler in turn.
      */
     httpd_uri_match_func_t uri_match_fn;
 } httpd_config_t;
@@ -382,6 +410,30 @@ typedef struct httpd_req {
     bool ignore_sess_ctx_changes;
 } httpd_req_t;
 
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+/**
+ * @brief Settings of the permessage-deflate extension (RFC 7692) of a WebSocket endpoint
+ *
+ * The extension is accepted when offered by a client, the data frames of the
+ * session are then compressed. The server compresses its messages with a
+ * window of 2^server_max_window_bits bytes, taking about 6 times as much heap
+ * while a message is sent, and keeps 2^client_max_window_bits bytes of the
+ * client messages unless client_no_context_takeover is set.
+ *
+ * Compressed messages received are decompressed whole: httpd_ws_recv_frame()
+ * returns the frames of a fragmented message with no data, then the message
+ * with its last frame.
+ */
+typedef struct httpd_ws_deflate_config {
+    bool enable;                        /*!< Accept permessage-deflate offers */
+    uint8_t server_max_window_bits;     /*!< Window of the server compressor, 8 to 15, 0 for the default (11) */
+    uint8_t client_max_window_bits;     /*!< Largest window accepted from the client, 8 to 15, 0 for the default (11) */
+    bool server_no_context_takeover;    /*!< Reset the server compressor after each message */
+    bool client_no_context_takeover;    /*!< Have the client reset its compressor after each message */
+    size_t max_message_size;            /*!< Largest message received, compressed or decompressed, 0 for the default (16 KB) */
+} httpd_ws_deflate_config_t;
+#endif
+
 /**
  * @brief Structure for URI handler
  */
@@ -406,6 +458,11 @@ typedef struct httpd_uri {
      * If this flag is true, then method must be HTTP_GET. Otherwise the handshake will not be handled.
      */
     bool is_websocket;
+
+    /**
+     * Compression of the WebSocket messages, if the client offers it
+     */
+    httpd_ws_deflate_config_t ws_deflate;
 #endif
 } httpd_uri_t;
 
@@ -1491,12 +1548,17 @@ typedef struct httpd_ws_frame {
 
 /**
  * @brief Receive and parse a WebSocket frame
+ *
+ * If the session uses permessage-deflate, compressed messages are returned
+ * decompressed, see httpd_ws_deflate_config_t.
+ *
  * @param[in]   req         Current request
  * @param[out]  pkt         WebSocket packet
  * @param[in]   max_len     Maximum length for receive
  * @return
  *  - ESP_OK                    : On successful
- *  - ESP_FAIL                  : Socket errors occurs
+ *  - ESP_FAIL                  : Socket errors occurs, or invalid compressed data
+ *  - ESP_ERR_INVALID_SIZE      : Frame or message longer than max_len
  *  - ESP_ERR_INVALID_STATE     : Handshake was already done beforehand
  *  - ESP_ERR_INVALID_ARG       : Argument is invalid (null or non-WebSocket)
  */
@@ -26,6 +26,10 @@
 #include <esp_http_server.h>
 #include "osal.h"
 
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+#include "esp_transport_ws_deflate.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -69,12 +73,20 @@ struct sock_db {
     httpd_recv_func_t recv_fn;              /*!< Receive function for this socket */
     httpd_pending_func_t pending_fn;        /*!< Pending function for this socket */
     uint64_t lru_counter;                   /*!< LRU Counter indicating when the socket was last used */
+    uint64_t lru_ordered;                   /*!< Value of lru_counter when the session was last placed in the LRU list */
+    struct sock_db *lru_prev;               /*!< Previous (less recently used) session */
+    struct sock_db *lru_next;               /*!< Next (more recently used) session, or next free slot */
     char pending_data[PARSER_BLOCK_SIZE];   /*!< Buffer for pending data to be received */
     size_t pending_len;                     /*!< Length of pending data to be received */
+    bool busy;                              /*!< True while a worker is processing a request of this session */
+    bool close_pending;                     /*!< Close the session once the worker is done with it */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_done;                 /*!< True if it has done WebSocket handshake (if this socket is a valid WS) */
     bool ws_close;                          /*!< Set to true to close the socket later (when WS Close frame received) */
     esp_err_t (*ws_handler)(httpd_req_t *r);   /*!< WebSocket handler, leave to null if it's not WebSocket */
+    esp_transport_ws_deflate_handle_t ws_deflate; /*!< permessage-deflate context, if negotiated */
+    httpd_ws_type_t ws_deflate_type;        /*!< Type of the compressed message being received, HTTPD_WS_TYPE_CONTINUE if none */
+    omutex_t ws_deflate_lock;               /*!< Held while a frame is compressed and sent, as any task may send frames */
 #endif
 };
 
@@ -100,6 +112,7 @@ struct httpd_req_aux {
     bool ws_handshake_detect;                       /*!< WebSocket handshake detection flag */
     httpd_ws_type_t ws_type;                        /*!< WebSocket frame type */
     bool ws_final;                                  /*!< WebSocket FIN bit (final frame or not) */
+    bool ws_compressed;                             /*!< Frame is part of a compressed message */
 #endif
 };
 
@@ -114,12 +127,36 @@ struct httpd_data {
     int msg_fd;                             /*!< Ctrl message sender FD */
     struct thread_data hd_td;               /*!< Information for the HTTPD thread */
     struct sock_db *hd_sd;                  /*!< The socket database */
+    struct sock_db *hd_sd_map[FD_SETSIZE];  /*!< Sessions indexed by their descriptor */
+    struct sock_db *hd_sd_free;             /*!< Free slots of the socket database, linked by lru_next */
+    struct sock_db *hd_lru_head;            /*!< Least recently used session */
+    struct sock_db *hd_lru_tail;            /*!< Most recently used session */
+    fd_set hd_sess_fds;                     /*!< Descriptors of the sessions to be watched by select() */
+    int hd_sess_maxfd;                      /*!< Highest session descriptor, -1 if none */
     httpd_uri_t **hd_calls;                 /*!< Registered URI handlers */
-    struct httpd_req hd_req;                /*!< The current HTTPD request */
+    struct httpd_router *hd_router;         /*!< Index of hd_calls, NULL if handlers are looked up by a linear scan */
+    omutex_t hd_calls_lock;                 /*!< Held while hd_calls and hd_router are read or modified, as handlers may be
+                                                 (un)registered by any task while the server thread or workers look them up */
+    struct httpd_req hd_req;                /*!< The current HTTPD request, when processed by the server thread */
     struct httpd_req_aux hd_req_aux;        /*!< Additional data about the HTTPD request kept unexposed */
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
+
+    struct httpd_worker *hd_workers;        /*!< Worker threads, NULL if requests are processed by the server thread */
+    oqueue_t hd_work_queue;                 /*!< Sessions ready to be processed by a worker */
+    oqueue_t hd_done_queue;                 /*!< Sessions processed by the workers, to be released by the server thread */
+    unsigned hd_busy_sessions;              /*!< Number of sessions being processed by workers */
+};
+
+/**
+ * @brief Worker thread processing the requests of the sessions handed over by the server thread
+ */
+struct httpd_worker {
+    struct httpd_data *hd;                  /*!< Server instance */
+    struct thread_data td;                  /*!< Information for the worker thread */
+    struct httpd_req req;                   /*!< The request being processed by this worker */
+    struct httpd_req_aux req_aux;           /*!< Additional data about the request kept unexposed */
 };
 
 /******************* Group : Session Management ********************/
@@ -168,14 +205,37 @@ esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd);
 /**
  * @brief   Processes incoming HTTP requests
  *
+ * @note    This may run in a worker thread. The session database must
+ *          then only be modified by the server thread, through
+ *          httpd_sess_release() once processing is done.
+ *
  * @param[in] hd    Server instance data
- * @param[in] clifd Descriptor of the client from which data is to be received
+ * @param[in] r     Request structure of the calling thread
+ * @param[in] sd    Session of the client from which data is to be received
  *
  * @return
  *  - ESP_OK    : on successfully receiving, parsing and responding to a request
  *  - ESP_FAIL  : in case of failure in any of the stages of processing
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, int clifd);
+esp_err_t httpd_sess_process(struct httpd_data *hd, httpd_req_t *r, struct sock_db *sd);
+
+/**
+ * @brief   Completes the processing of a request of a session, from the
+ *          server thread
+ *
+ * Updates the LRU counter of the session if the request was processed
+ * successfully. Otherwise, or if the session was asked to be closed while
+ * it was being processed, closes the session.
+ *
+ * @param[in] hd    Server instance data
+ * @param[in] sd    Session which has been processed
+ * @param[in] ret   Value returned by httpd_sess_process()
+ *
+ * @return
+ *  - Descriptor of the session, if it is still open
+ *  - Otherwise, the value returned by httpd_sess_delete()
+ */
+int httpd_sess_release(struct httpd_data *hd, struct sock_db *sd, esp_err_t ret);
 
 /**
  * @brief   Remove client descriptor from the session / socket database
@@ -205,20 +265,36 @@ int httpd_sess_delete(struct httpd_data *hd, int clifd);
 void httpd_sess_free_ctx(void *ctx, httpd_free_ctx_fn_t free_fn);
 
 /**
- * @brief   Add descriptors present in the socket database to an fdset and
- *          update the value of maxfd which are needed by the select function
- *          for looking through all available sockets for incoming data.
+ * @brief   Initialize an fdset with the descriptors present in the socket
+ *          database, and get the value of maxfd which are needed by the
+ *          select function for looking through all available sockets for
+ *          incoming data.
+ *
+ * The set is maintained as sessions are added, removed or handed to workers,
+ * so this is only a copy. Sessions being processed by a worker are left out.
  *
  * @param[in]  hd    Server instance data
- * @param[out] fdset File descriptor set to be updated.
+ * @param[out] fdset File descriptor set to be initialized.
  * @param[out] maxfd Maximum value among all file descriptors.
  */
 void httpd_sess_set_descriptors(struct httpd_data *hd, fd_set *fdset, int *maxfd);
 
+/**
+ * @brief   Marks a session as being processed by a worker, or done with
+ *
+ * Busy sessions aren't watched by select() nor closed by the LRU purge.
+ *
+ * @param[in] hd    Server instance data
+ * @param[in] sd    Session
+ * @param[in] busy  True when the session is handed to a worker
+ */
+void httpd_sess_set_busy(struct httpd_data *hd, struct sock_db *sd, bool busy);
+
 /**
  * @brief   Iterates through the list of client fds in the session /socket database.
  *          Passing the value of a client fd returns the fd for the next client
  *          in the database. In order to iterate from the beginning pass -1 as fd.
+ *          Clients are iterated in ascending order of their descriptors.
  *
  * @param[in] hd    Server instance data
  * @param[in] fd    Last accessed client descriptor.
@@ -267,6 +343,7 @@ bool httpd_sess_pending(struct httpd_data *hd, int fd);
  * This may be useful if new clients are requesting for connection but
  * max number of connections is reached, in which case the client which
  * is inactive for the longest will be removed from the session.
+ * Sessions being processed by a worker are never removed.
  *
  * @param[in] hd  Server instance data
  *
@@ -291,12 +368,13 @@ esp_err_t httpd_sess_close_lru(struct httpd_data *hd);
  *          and invokes the appropriate one if found
  *
  * @param[in] hd  Server instance data for which handler needs to be invoked
+ * @param[in] r   The parsed request
  *
  * @return
  *  - ESP_OK    : if handler found and executed successfully
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_uri(struct httpd_data *hd);
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *r);
 
 /**
  * @brief   Unregister all URI handlers
@@ -326,6 +404,64 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
 #define httpd_valid_req(r)  true
 #endif
 
+/**
+ * @brief   Rebuilds the index of the registered URI handlers
+ *
+ * Exact URIs are hashed and the prefixes of wildcard templates are kept in
+ * a radix trie. This must be called whenever hd_calls is modified, with
+ * hd_calls_lock held. The router isn't built for a custom uri_match_fn, or if memory runs out, in
+ * which case handlers are looked up by a linear scan of hd_calls.
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_router_build(struct httpd_data *hd);
+
+/**
+ * @brief   Frees the index of the registered URI handlers
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_router_free(struct httpd_data *hd);
+
+/**
+ * @brief   Looks up the handler for a URI and method using the router.
+ *          Gives the same result as a linear scan of hd_calls.
+ *
+ * @param[in]  hd         Server instance data, with hd_router built
+ * @param[in]  uri        URI to look up, not necessarily NULL terminated
+ * @param[in]  uri_len    Length of the URI
+ * @param[in]  method     Method of the request
+ * @param[out] uri_found  Set if some handler matches the URI, whatever its method
+ *
+ * @return
+ *  - First registered handler matching the URI and method
+ *  - NULL if none
+ */
+httpd_uri_t *httpd_router_find(struct httpd_data *hd, const char *uri, size_t uri_len,
+                               httpd_method_t method, bool *uri_found);
+
+/**
+ * @brief   Finds the handler with matching URI and method
+ *
+ * Must be called with hd_calls_lock held, the handler returned is only
+ * valid until it is released.
+ *
+ * @param[in]  hd       Server instance data
+ * @param[in]  uri      URI to look up, not necessarily NULL terminated
+ * @param[in]  uri_len  Length of the URI
+ * @param[in]  method   Method of the request
+ * @param[out] err      HTTPD_404_NOT_FOUND or HTTPD_405_METHOD_NOT_ALLOWED
+ *                      if no handler is found, can be NULL
+ *
+ * @return
+ *  - Matching handler
+ *  - NULL if none
+ */
+httpd_uri_t *httpd_find_uri_handler(struct httpd_data *hd,
+                                    const char *uri, size_t uri_len,
+                                    httpd_method_t method,
+                                    httpd_err_code_t *err);
+
 /** End of Group : URI Handling
  * @}
  */
@@ -345,25 +481,26 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
  * http_recv() after this reads the body of the request.
  *
  * @param[in] hd  Server instance data
+ * @param[in] r   Request structure of the calling thread, with its aux pointer set
  * @param[in] sd  Pointer to socket which is needed for receiving TCP packets.
  *
  * @return
  *  - ESP_OK    : if request packet is valid
  *  - ESP_FAIL  : otherwise
  */
-esp_err_t httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
+esp_err_t httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct sock_db *sd);
 
 /**
  * @brief   For an HTTP request, resets the resources allocated for it and
  *          purges any data left to be received
  *
- * @param[in] hd  Server instance data
+ * @param[in] r   The request to delete
  *
  * @return
  *  - ESP_OK    : if request packet deleted and resources cleaned.
  *  - ESP_FAIL  : otherwise.
  */
-esp_err_t httpd_req_delete(struct httpd_data *hd);
+esp_err_t httpd_req_delete(httpd_req_t *r);
 
 /**
  * @brief   For handling HTTP errors by invoking registered
@@ -492,6 +629,7 @@ int httpd_default_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len,
  * @brief   This function is for responding a WebSocket handshake
  *
  * @param[in] req    Pointer to handshake request that will be handled
+ * @param[in] uri    URI handler of the WebSocket endpoint
  * @return
  *  - ESP_OK                        : When handshake is sucessful
  *  - ESP_ERR_NOT_FOUND             : When some headers (Sec-WebSocket-*) are not found
@@ -500,7 +638,7 @@ int httpd_default_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len,
  *  - ESP_ERR_INVALID_ARG           : Argument is invalid (null or non-WebSocket)
  *  - ESP_FAIL                      : Socket failures
  */
-esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req);
+esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req, const httpd_uri_t *uri);
 
 /**
  * @brief   This function is for getting a frame type
@@ -519,6 +657,68 @@ esp_err_t httpd_ws_get_frame_type(httpd_req_t *req);
  * @}
  */
 
+/* ************** Group: Workers ************** */
+/** @name Workers
+ * Functions for processing requests in worker threads
+ * @{
+ */
+
+/**
+ * @brief   Creates the worker threads, if config.worker_count is not 0
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - ESP_OK                  : on success, or if no workers are configured
+ *  - ESP_ERR_HTTPD_ALLOC_MEM : if the workers or their queues can't be allocated
+ *  - ESP_ERR_HTTPD_TASK      : if a worker thread can't be created
+ */
+esp_err_t httpd_workers_start(struct httpd_data *hd);
+
+/**
+ * @brief   Stops the worker threads and frees their resources
+ *
+ * Waits for the requests being processed to complete.
+ *
+ * @param[in] hd  Server instance data
+ */
+void httpd_workers_stop(struct httpd_data *hd);
+
+/**
+ * @brief   Hands a session with pending activity over to a worker
+ *
+ * The session is marked busy until the server thread collects it back
+ * with httpd_workers_collect(), so that its requests are processed one at
+ * a time, in order.
+ *
+ * @param[in] hd  Server instance data
+ * @param[in] sd  Session to process
+ */
+void httpd_worker_dispatch(struct httpd_data *hd, struct sock_db *sd);
+
+/**
+ * @brief   Releases the sessions processed by the workers. Runs in the
+ *          server thread.
+ *
+ * @param[in] arg  Server instance data
+ */
+void httpd_workers_collect(void *arg);
+
+/**
+ * @brief   Gets the request structure of the calling thread
+ *
+ * @param[in] hd  Server instance data
+ *
+ * @return
+ *  - Request structure, if called from the server thread or one of its workers
+ *  - NULL otherwise
+ */
+httpd_req_t *httpd_req_current(struct httpd_data *hd);
+
+/** End of Group : Workers
+ * @}
+ */
+
 #ifdef __cplusplus
 }
 #endif
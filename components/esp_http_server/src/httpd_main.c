@@ -154,24 +154,34 @@ static void httpd_process_ctrl_msg(struct httpd_data *hd)
 /* Manage in-coming connection or data requests */
 static esp_err_t httpd_server(struct httpd_data *hd)
 {
+    /* Release the sessions the workers are done with, in case the
+     * control message notifying about them was lost */
+    httpd_workers_collect(hd);
+
     fd_set read_set;
-    FD_ZERO(&read_set);
-    if (hd->config.lru_purge_enable || httpd_is_sess_available(hd)) {
+    int tmp_max_fd;
+    httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
+    if ((hd->config.lru_purge_enable && hd->hd_busy_sessions < hd->config.max_open_sockets) ||
+            httpd_is_sess_available(hd)) {
         /* Only listen for new connections if server has capacity to
          * handle more (or when LRU purge is enabled, in which case
-         * older connections will be closed) */
+         * older connections not being processed by a worker will
+         * be closed) */
         FD_SET(hd->listen_fd, &read_set);
     }
     FD_SET(hd->ctrl_fd, &read_set);
 
-    int tmp_max_fd;
-    httpd_sess_set_descriptors(hd, &read_set, &tmp_max_fd);
     int maxfd = MAX(hd->listen_fd, tmp_max_fd);
     tmp_max_fd = maxfd;
     maxfd = MAX(hd->ctrl_fd, tmp_max_fd);
 
+    /* Don't wait forever while workers are busy, so that their
+     * sessions get collected even if a control message is lost */
+    struct timeval timeout = { .tv_sec = 1 };
+    struct timeval *ptimeout = hd->hd_busy_sessions ? &timeout : NULL;
+
     ESP_LOGD(TAG, LOG_FMT("doing select maxfd+1 = %d"), maxfd + 1);
-    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, NULL);
+    int active_cnt = select(maxfd + 1, &read_set, NULL, NULL, ptimeout);
     if (active_cnt < 0) {
         ESP_LOGE(TAG, LOG_FMT("error in select (%d)"), errno);
         httpd_sess_delete_invalid(hd);
@@ -192,15 +202,21 @@ static esp_err_t httpd_server(struct httpd_data *hd)
      * sessions? */
     int fd = -1;
     while ((fd = httpd_sess_iterate(hd, fd)) != -1) {
+        struct sock_db *sd = httpd_sess_get(hd, fd);
+        if (sd->busy) {
+            /* Already being processed by a worker */
+            continue;
+        }
         if (FD_ISSET(fd, &read_set) || (httpd_sess_pending(hd, fd))) {
-            ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
-            if (httpd_sess_process(hd, fd) != ESP_OK) {
-                ESP_LOGD(TAG, LOG_FMT("closing socket %d"), fd);
-                close(fd);
-                /* Delete session and update fd to that
-                 * preceding the one being deleted */
-                fd = httpd_sess_delete(hd, fd);
+            if (hd->hd_workers) {
+                httpd_worker_dispatch(hd, sd);
+                continue;
             }
+            ESP_LOGD(TAG, LOG_FMT("processing socket %d"), fd);
+            esp_err_t ret = httpd_sess_process(hd, &hd->hd_req, sd);
+            /* Update fd to that preceding the session
+             * if it gets deleted */
+            fd = httpd_sess_release(hd, sd, ret);
         }
     }
 
@@ -231,6 +247,8 @@ static void httpd_thread(void *arg)
     }
 
     ESP_LOGD(TAG, LOG_FMT("web server exiting"));
+    /* Wait for the requests being processed by the workers */
+    httpd_workers_stop(hd);
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_close_all_sessions(hd);
@@ -320,6 +338,7 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
         return NULL;
     }
     struct httpd_req_aux *ra = &hd->hd_req_aux;
+    hd->hd_req.aux = ra;
     ra->resp_hdrs = calloc(config->max_resp_headers, sizeof(struct resp_hdr));
     if (!ra->resp_hdrs) {
         ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP response headers"));
@@ -337,6 +356,16 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
         free(hd);
         return NULL;
     }
+    hd->hd_calls_lock = httpd_os_mutex_create();
+    if (!hd->hd_calls_lock) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to create the lock of the HTTP URI handlers"));
+        free(hd->err_handler_fns);
+        free(ra->resp_hdrs);
+        free(hd->hd_sd);
+        free(hd->hd_calls);
+        free(hd);
+        return NULL;
+    }
     /* Save the configuration for this instance */
     hd->config = *config;
     return hd;
@@ -352,6 +381,7 @@ static void httpd_delete(struct httpd_data *hd)
 
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
+    httpd_os_mutex_delete(hd->hd_calls_lock);
     free(hd->hd_calls);
     free(hd);
 }
@@ -391,12 +421,22 @@ esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    esp_err_t ret = httpd_workers_start(hd);
+    if (ret != ESP_OK) {
+        close(hd->listen_fd);
+        close(hd->msg_fd);
+        cs_free_ctrl_sock(hd->ctrl_fd);
+        httpd_delete(hd);
+        return ret;
+    }
+
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd,
                                hd->config.core_id) != ESP_OK) {
         /* Failed to launch task */
+        httpd_workers_stop(hd);
         httpd_delete(hd);
         return ESP_ERR_HTTPD_TASK;
     }
@@ -0,0 +1,277 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_router";
+
+/* Flags of a wildcard route */
+#define ROUTE_ASTERISK  (1 << 0)    /* Any trailing characters allowed */
+#define ROUTE_QUEST     (1 << 1)    /* Optional character after the prefix */
+
+/* A registered handler, as indexed by the router */
+struct httpd_route {
+    httpd_uri_t *handler;           /*!< Registered handler */
+    uint16_t index;                 /*!< Position in hd_calls, lower wins as with the linear scan */
+    uint8_t flags;                  /*!< ROUTE_* flags of a wildcard route */
+    char opt;                       /*!< Optional character, if ROUTE_QUEST is set */
+    size_t len;                     /*!< Length of the URI, or of the prefix of a wildcard route */
+    struct httpd_route *next;       /*!< Next route of the same hash bucket or trie node */
+};
+
+/* Node of the radix trie of wildcard prefixes. Labels point into the
+ * URI strings of the handlers, which outlive the router as it is rebuilt
+ * whenever a handler is registered or unregistered */
+struct httpd_router_node {
+    const char *label;              /*!< Characters leading from the parent to this node */
+    size_t label_len;               /*!< Number of characters in label */
+    struct httpd_router_node *child;    /*!< First child */
+    struct httpd_router_node *sibling;  /*!< Next child of the parent */
+    struct httpd_route *routes;     /*!< Wildcard routes whose prefix ends at this node */
+};
+
+struct httpd_router {
+    struct httpd_route *routes;     /*!< One entry per indexed handler */
+    struct httpd_route **buckets;   /*!< Hash table of exact URIs */
+    size_t bucket_mask;             /*!< Number of buckets - 1, a power of two */
+    struct httpd_router_node *nodes;    /*!< Pool of trie nodes, the first one is the root */
+    size_t node_count;              /*!< Number of nodes used from the pool */
+};
+
+/* FNV-1a */
+static uint32_t httpd_router_hash(const char *uri, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t) uri[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Splits a wildcard template the way httpd_uri_match_wildcard() reads it.
+ * Returns false for templates which can never match */
+static bool httpd_router_parse_template(const char *template, struct httpd_route *route)
+{
+    const size_t tpl_len = strlen(template);
+    const char last = (const char) (tpl_len > 0 ? template[tpl_len - 1] : 0);
+    const char prevlast = (const char) (tpl_len > 1 ? template[tpl_len - 2] : 0);
+    const bool asterisk = last == '*' || (prevlast == '*' && last == '?');
+    const bool quest = last == '?' || (prevlast == '?' && last == '*');
+
+    if (tpl_len < asterisk + quest * 2) {
+        return false;
+    }
+    route->len = tpl_len - (asterisk + quest * 2);
+    route->flags = (asterisk ? ROUTE_ASTERISK : 0) | (quest ? ROUTE_QUEST : 0);
+    route->opt = quest ? template[route->len] : 0;
+    return true;
+}
+
+static struct httpd_router_node *httpd_router_find_child(struct httpd_router_node *node, char c)
+{
+    for (struct httpd_router_node *child = node->child; child; child = child->sibling) {
+        if (child->label[0] == c) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+static void httpd_router_insert_wildcard(struct httpd_router *router, struct httpd_route *route)
+{
+    struct httpd_router_node *node = &router->nodes[0];
+    const char *prefix = route->handler->uri;
+    size_t rem = route->len;
+
+    while (rem) {
+        struct httpd_router_node *child = httpd_router_find_child(node, prefix[0]);
+        if (!child) {
+            /* No common prefix with the other children */
+            child = &router->nodes[router->node_count++];
+            child->label = prefix;
+            child->label_len = rem;
+            child->sibling = node->child;
+            node->child = child;
+            node = child;
+            break;
+        }
+
+        size_t common = 1;
+        while (common < child->label_len && common < rem && child->label[common] == prefix[common]) {
+            common++;
+        }
+        if (common < child->label_len) {
+            /* Split the child, its tail moves to a new node */
+            struct httpd_router_node *tail = &router->nodes[router->node_count++];
+            tail->label = child->label + common;
+            tail->label_len = child->label_len - common;
+            tail->child = child->child;
+            tail->routes = child->routes;
+            child->label_len = common;
+            child->child = tail;
+            child->routes = NULL;
+        }
+        node = child;
+        prefix += common;
+        rem -= common;
+    }
+
+    route->next = node->routes;
+    node->routes = route;
+}
+
+void httpd_router_free(struct httpd_data *hd)
+{
+    struct httpd_router *router = hd->hd_router;
+    if (router) {
+        free(router->nodes);
+        free(router->buckets);
+        free(router->routes);
+        free(router);
+        hd->hd_router = NULL;
+    }
+}
+
+void httpd_router_build(struct httpd_data *hd)
+{
+    httpd_router_free(hd);
+
+    /* Routing is only known for the built-in matchers. With a
+     * custom one, handlers are looked up by a linear scan */
+    const bool wildcard = hd->config.uri_match_fn == httpd_uri_match_wildcard;
+    if (hd->config.uri_match_fn && !wildcard) {
+        return;
+    }
+
+    size_t count = 0;
+    while (count < hd->config.max_uri_handlers && hd->hd_calls[count]) {
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    size_t buckets = 1;
+    while (buckets < count) {
+        buckets <<= 1;
+    }
+
+    struct httpd_router *router = calloc(1, sizeof(struct httpd_router));
+    if (router) {
+        router->routes = calloc(count, sizeof(struct httpd_route));
+        router->buckets = calloc(buckets, sizeof(struct httpd_route *));
+        /* Each wildcard adds at most a leaf and a split node */
+        router->nodes = calloc(1 + 2 * count, sizeof(struct httpd_router_node));
+    }
+    if (!router || !router->routes || !router->buckets || !router->nodes) {
+        ESP_LOGW(TAG, LOG_FMT("Failed to allocate memory for the URI router, using linear lookup"));
+        hd->hd_router = router;
+        httpd_router_free(hd);
+        return;
+    }
+    router->bucket_mask = buckets - 1;
+    router->node_count = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        struct httpd_route *route = &router->routes[i];
+        route->handler = hd->hd_calls[i];
+        route->index = i;
+        if (wildcard) {
+            if (!httpd_router_parse_template(route->handler->uri, route)) {
+                /* Invalid template, never matches */
+                continue;
+            }
+        } else {
+            route->len = strlen(route->handler->uri);
+        }
+
+        if (route->flags) {
+            httpd_router_insert_wildcard(router, route);
+        } else {
+            struct httpd_route **bucket = &router->buckets[httpd_router_hash(route->handler->uri, route->len) & router->bucket_mask];
+            route->next = *bucket;
+            *bucket = route;
+        }
+    }
+    ESP_LOGD(TAG, LOG_FMT("%u handlers, %u trie nodes"), (unsigned) count, (unsigned) router->node_count);
+    hd->hd_router = router;
+}
+
+/* Keeps the first registered route matching the method, and
+ * notes if the URI matched with some other method */
+static inline void httpd_router_candidate(struct httpd_route *route, httpd_method_t method,
+                                          struct httpd_route **best, bool *uri_found)
+{
+    *uri_found = true;
+    if (route->handler->method == method && (!*best || route->index < (*best)->index)) {
+        *best = route;
+    }
+}
+
+static bool httpd_router_wildcard_match(const struct httpd_route *route, const char *uri, size_t len)
+{
+    /* The prefix has already been matched by the trie walk */
+    if (!(route->flags & ROUTE_QUEST)) {
+        return true;
+    }
+    if (len > route->len && uri[route->len] != route->opt) {
+        return false;
+    }
+    return (route->flags & ROUTE_ASTERISK) || len <= route->len + 1;
+}
+
+httpd_uri_t *httpd_router_find(struct httpd_data *hd, const char *uri, size_t uri_len,
+                               httpd_method_t method, bool *uri_found)
+{
+    struct httpd_router *router = hd->hd_router;
+    struct httpd_route *best = NULL;
+    *uri_found = false;
+
+    struct httpd_route *route = router->buckets[httpd_router_hash(uri, uri_len) & router->bucket_mask];
+    for (; route; route = route->next) {
+        if (route->len == uri_len && memcmp(route->handler->uri, uri, uri_len) == 0) {
+            httpd_router_candidate(route, method, &best, uri_found);
+        }
+    }
+
+    /* Walk the wildcard prefixes of the URI */
+    struct httpd_router_node *node = &router->nodes[0];
+    size_t depth = 0;
+    while (node) {
+        for (route = node->routes; route; route = route->next) {
+            if (httpd_router_wildcard_match(route, uri, uri_len)) {
+                httpd_router_candidate(route, method, &best, uri_found);
+            }
+        }
+        if (depth == uri_len) {
+            break;
+        }
+        node = httpd_router_find_child(node, uri[depth]);
+        if (node) {
+            if (node->label_len > uri_len - depth ||
+                memcmp(node->label, uri + depth, node->label_len) != 0) {
+                break;
+            }
+            depth += node->label_len;
+        }
+    }
+    return best ? best->handler : NULL;
+}
@@ -24,13 +24,63 @@ static const char *TAG = "httpd_sess";
 
 bool httpd_is_sess_available(struct httpd_data *hd)
 {
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == -1) {
-            return true;
-        }
+    return hd->hd_sd_free != NULL;
+}
+
+/* Removes a session from the LRU list */
+static void httpd_sess_lru_unlink(struct httpd_data *hd, struct sock_db *sd)
+{
+    if (sd->lru_prev) {
+        sd->lru_prev->lru_next = sd->lru_next;
+    } else {
+        hd->hd_lru_head = sd->lru_next;
+    }
+    if (sd->lru_next) {
+        sd->lru_next->lru_prev = sd->lru_prev;
+    } else {
+        hd->hd_lru_tail = sd->lru_prev;
+    }
+    sd->lru_prev = sd->lru_next = NULL;
+}
+
+/* Inserts a session in the LRU list, after 'prev' or at the head if NULL */
+static void httpd_sess_lru_insert(struct httpd_data *hd, struct sock_db *prev, struct sock_db *sd)
+{
+    sd->lru_prev = prev;
+    sd->lru_next = prev ? prev->lru_next : hd->hd_lru_head;
+    if (sd->lru_next) {
+        sd->lru_next->lru_prev = sd;
+    } else {
+        hd->hd_lru_tail = sd;
+    }
+    if (prev) {
+        prev->lru_next = sd;
+    } else {
+        hd->hd_lru_head = sd;
+    }
+    sd->lru_ordered = sd->lru_counter;
+}
+
+/* Moves a session to its place in the LRU list, which is kept sorted by
+ * lru_ordered. Sessions are usually touched last, so this is the tail */
+static void httpd_sess_lru_reorder(struct httpd_data *hd, struct sock_db *sd)
+{
+    httpd_sess_lru_unlink(hd, sd);
+    struct sock_db *prev = hd->hd_lru_tail;
+    while (prev && prev->lru_ordered > sd->lru_counter) {
+        prev = prev->lru_prev;
+    }
+    httpd_sess_lru_insert(hd, prev, sd);
+}
+
+/* Adds or removes a session descriptor from the set watched by select() */
+static void httpd_sess_watch(struct httpd_data *hd, struct sock_db *sd, bool watch)
+{
+    if (watch) {
+        FD_SET(sd->fd, &hd->hd_sess_fds);
+    } else {
+        FD_CLR(sd->fd, &hd->hd_sess_fds);
     }
-    return false;
 }
 
 struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
@@ -41,53 +91,66 @@ struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
 
     /* Check if called inside a request handler, and the
      * session sockfd in use is same as the parameter */
-    if ((hd->hd_req_aux.sd) && (hd->hd_req_aux.sd->fd == sockfd)) {
-        /* Just return the pointer to the sock_db
-         * corresponding to the request */
-        return hd->hd_req_aux.sd;
+    httpd_req_t *r = httpd_req_current(hd);
+    if (r) {
+        struct httpd_req_aux *ra = r->aux;
+        if ((ra->sd) && (ra->sd->fd == sockfd)) {
+            /* Just return the pointer to the sock_db
+             * corresponding to the request */
+            return ra->sd;
+        }
     }
 
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == sockfd) {
-            return &hd->hd_sd[i];
-        }
+    if (sockfd < 0 || sockfd >= FD_SETSIZE) {
+        return NULL;
     }
-    return NULL;
+    return hd->hd_sd_map[sockfd];
 }
 
 esp_err_t httpd_sess_new(struct httpd_data *hd, int newfd)
 {
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), newfd);
 
+    if (newfd < 0 || newfd >= FD_SETSIZE) {
+        /* Such a descriptor couldn't be watched by select() */
+        ESP_LOGE(TAG, LOG_FMT("fd = %d out of range"), newfd);
+        return ESP_FAIL;
+    }
+
     if (httpd_sess_get(hd, newfd)) {
         ESP_LOGE(TAG, LOG_FMT("session already exists with fd = %d"), newfd);
         return ESP_FAIL;
     }
 
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == -1) {
-            memset(&hd->hd_sd[i], 0, sizeof(hd->hd_sd[i]));
-            hd->hd_sd[i].fd = newfd;
-            hd->hd_sd[i].handle = (httpd_handle_t) hd;
-            hd->hd_sd[i].send_fn = httpd_default_send;
-            hd->hd_sd[i].recv_fn = httpd_default_recv;
-
-            /* Call user-defined session opening function */
-            if (hd->config.open_fn) {
-                esp_err_t ret = hd->config.open_fn(hd, hd->hd_sd[i].fd);
-                if (ret != ESP_OK) {
-                    httpd_sess_delete(hd, hd->hd_sd[i].fd);
-                    ESP_LOGD(TAG, LOG_FMT("open_fn failed for fd = %d"), newfd);
-                    return ret;
-                }
-            }
-            return ESP_OK;
+    struct sock_db *sd = hd->hd_sd_free;
+    if (!sd) {
+        ESP_LOGD(TAG, LOG_FMT("unable to launch session for fd = %d"), newfd);
+        return ESP_FAIL;
+    }
+    hd->hd_sd_free = sd->lru_next;
+
+    memset(sd, 0, sizeof(*sd));
+    sd->fd = newfd;
+    sd->handle = (httpd_handle_t) hd;
+    sd->send_fn = httpd_default_send;
+    sd->recv_fn = httpd_default_recv;
+
+    hd->hd_sd_map[newfd] = sd;
+    hd->hd_sess_maxfd = MAX(hd->hd_sess_maxfd, newfd);
+    httpd_sess_watch(hd, sd, true);
+    /* Not used yet, hence least recently used */
+    httpd_sess_lru_insert(hd, NULL, sd);
+
+    /* Call user-defined session opening function */
+    if (hd->config.open_fn) {
+        esp_err_t ret = hd->config.open_fn(hd, sd->fd);
+        if (ret != ESP_OK) {
+            httpd_sess_delete(hd, sd->fd);
+            ESP_LOGD(TAG, LOG_FMT("open_fn failed for fd = %d"), newfd);
+            return ret;
         }
     }
-    ESP_LOGD(TAG, LOG_FMT("unable to launch session for fd = %d"), newfd);
-    return ESP_FAIL;
+    return ESP_OK;
 }
 
 void httpd_sess_free_ctx(void *ctx, httpd_free_ctx_fn_t free_fn)
@@ -111,9 +174,9 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
     /* Check if the function has been called from inside a
      * request handler, in which case fetch the context from
      * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        return hd->hd_req.sess_ctx;
+    httpd_req_t *r = httpd_req_current((struct httpd_data *) handle);
+    if (r && ((struct httpd_req_aux *) r->aux)->sd == sd) {
+        return r->sess_ctx;
     }
 
     return sd->ctx;
@@ -129,18 +192,18 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
     /* Check if the function has been called from inside a
      * request handler, in which case set the context inside
      * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    httpd_req_t *r = httpd_req_current((struct httpd_data *) handle);
+    if (r && ((struct httpd_req_aux *) r->aux)->sd == sd) {
+        if (r->sess_ctx != ctx) {
             /* Don't free previous context if it is in sockdb
              * as it will be freed inside httpd_req_cleanup() */
-            if (sd->ctx != hd->hd_req.sess_ctx) {
+            if (sd->ctx != r->sess_ctx) {
                 /* Free previous context */
-                httpd_sess_free_ctx(hd->hd_req.sess_ctx, hd->hd_req.free_ctx);
+                httpd_sess_free_ctx(r->sess_ctx, r->free_ctx);
             }
-            hd->hd_req.sess_ctx = ctx;
+            r->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        r->free_ctx = free_fn;
         return;
     }
 
@@ -181,16 +244,15 @@ void httpd_sess_set_transport_ctx(httpd_handle_t handle, int sockfd, void *ctx,
 void httpd_sess_set_descriptors(struct httpd_data *hd,
                                 fd_set *fdset, int *maxfd)
 {
-    int i;
-    *maxfd = -1;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1) {
-            FD_SET(hd->hd_sd[i].fd, fdset);
-            if (hd->hd_sd[i].fd > *maxfd) {
-                *maxfd = hd->hd_sd[i].fd;
-            }
-        }
-    }
+    *fdset = hd->hd_sess_fds;
+    *maxfd = hd->hd_sess_maxfd;
+}
+
+void httpd_sess_set_busy(struct httpd_data *hd, struct sock_db *sd, bool busy)
+{
+    /* Sessions being processed by a worker are read by the worker */
+    sd->busy = busy;
+    httpd_sess_watch(hd, sd, !busy);
 }
 
 /** Check if a FD is valid */
@@ -208,7 +270,7 @@ static inline uint64_t httpd_sess_get_lru_counter(void)
 void httpd_sess_delete_invalid(struct httpd_data *hd)
 {
     for (int i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1 && !fd_is_valid(hd->hd_sd[i].fd)) {
+        if (hd->hd_sd[i].fd != -1 && !hd->hd_sd[i].busy && !fd_is_valid(hd->hd_sd[i].fd)) {
             ESP_LOGW(TAG, LOG_FMT("Closing invalid socket %d"), hd->hd_sd[i].fd);
             httpd_sess_delete(hd, hd->hd_sd[i].fd);
         }
@@ -218,46 +280,65 @@ void httpd_sess_delete_invalid(struct httpd_data *hd)
 int httpd_sess_delete(struct httpd_data *hd, int fd)
 {
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), fd);
-    int i;
-    int pre_sess_fd = -1;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == fd) {
-            /* global close handler */
-            if (hd->config.close_fn) {
-                hd->config.close_fn(hd, fd);
-            }
+    struct sock_db *sd = httpd_sess_get(hd, fd);
+    if (sd) {
+        /* global close handler */
+        if (hd->config.close_fn) {
+            hd->config.close_fn(hd, fd);
+        }
 
-            /* release 'user' context */
-            if (hd->hd_sd[i].ctx) {
-                if (hd->hd_sd[i].free_ctx) {
-                    hd->hd_sd[i].free_ctx(hd->hd_sd[i].ctx);
-                } else {
-                    free(hd->hd_sd[i].ctx);
-                }
-                hd->hd_sd[i].ctx = NULL;
-                hd->hd_sd[i].free_ctx = NULL;
+        /* release 'user' context */
+        if (sd->ctx) {
+            if (sd->free_ctx) {
+                sd->free_ctx(sd->ctx);
+            } else {
+                free(sd->ctx);
             }
+            sd->ctx = NULL;
+            sd->free_ctx = NULL;
+        }
 
-            /* release 'transport' context */
-            if (hd->hd_sd[i].transport_ctx) {
-                if (hd->hd_sd[i].free_transport_ctx) {
-                    hd->hd_sd[i].free_transport_ctx(hd->hd_sd[i].transport_ctx);
-                } else {
-                    free(hd->hd_sd[i].transport_ctx);
-                }
-                hd->hd_sd[i].transport_ctx = NULL;
-                hd->hd_sd[i].free_transport_ctx = NULL;
+        /* release 'transport' context */
+        if (sd->transport_ctx) {
+            if (sd->free_transport_ctx) {
+                sd->free_transport_ctx(sd->transport_ctx);
+            } else {
+                free(sd->transport_ctx);
             }
+            sd->transport_ctx = NULL;
+            sd->free_transport_ctx = NULL;
+        }
 
-            /* mark session slot as available */
-            hd->hd_sd[i].fd = -1;
-            break;
-        } else if (hd->hd_sd[i].fd != -1) {
-            /* Return the fd just preceding the one being
-             * deleted so that iterator can continue from
-             * the correct fd */
-            pre_sess_fd = hd->hd_sd[i].fd;
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        /* release the permessage-deflate context */
+        esp_transport_ws_deflate_destroy(sd->ws_deflate);
+        sd->ws_deflate = NULL;
+        if (sd->ws_deflate_lock) {
+            httpd_os_mutex_delete(sd->ws_deflate_lock);
+            sd->ws_deflate_lock = NULL;
         }
+#endif
+
+        httpd_sess_watch(hd, sd, false);
+        httpd_sess_lru_unlink(hd, sd);
+        hd->hd_sd_map[fd] = NULL;
+
+        /* mark session slot as available */
+        sd->fd = -1;
+        sd->lru_next = hd->hd_sd_free;
+        hd->hd_sd_free = sd;
+    }
+
+    /* Return the fd just preceding the one being
+     * deleted so that iterator can continue from
+     * the correct fd */
+    int pre_sess_fd = MIN(fd, hd->hd_sess_maxfd + 1) - 1;
+    while (pre_sess_fd >= 0 && !hd->hd_sd_map[pre_sess_fd]) {
+        pre_sess_fd--;
+    }
+    pre_sess_fd = MAX(pre_sess_fd, -1);
+    if (fd >= hd->hd_sess_maxfd) {
+        hd->hd_sess_maxfd = pre_sess_fd;
     }
     return pre_sess_fd;
 }
@@ -265,10 +346,17 @@ int httpd_sess_delete(struct httpd_data *hd, int fd)
 void httpd_sess_init(struct httpd_data *hd)
 {
     int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
+    hd->hd_sd_free = NULL;
+    for (i = hd->config.max_open_sockets - 1; i >= 0; i--) {
         hd->hd_sd[i].fd = -1;
         hd->hd_sd[i].ctx = NULL;
+        hd->hd_sd[i].lru_next = hd->hd_sd_free;
+        hd->hd_sd_free = &hd->hd_sd[i];
     }
+    memset(hd->hd_sd_map, 0, sizeof(hd->hd_sd_map));
+    hd->hd_lru_head = hd->hd_lru_tail = NULL;
+    FD_ZERO(&hd->hd_sess_fds);
+    hd->hd_sess_maxfd = -1;
 }
 
 bool httpd_sess_pending(struct httpd_data *hd, int fd)
@@ -293,61 +381,84 @@ bool httpd_sess_pending(struct httpd_data *hd, int fd)
  * value is returned, everything related to this socket will be
  * cleaned up and the socket will be closed.
  */
-esp_err_t httpd_sess_process(struct httpd_data *hd, int newfd)
+esp_err_t httpd_sess_process(struct httpd_data *hd, httpd_req_t *r, struct sock_db *sd)
 {
-    struct sock_db *sd = httpd_sess_get(hd, newfd);
-    if (! sd) {
-        return ESP_FAIL;
-    }
-
     ESP_LOGD(TAG, LOG_FMT("httpd_req_new"));
-    if (httpd_req_new(hd, sd) != ESP_OK) {
+    if (httpd_req_new(hd, r, sd) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != ESP_OK) {
+    if (httpd_req_delete(r) != ESP_OK) {
         return ESP_FAIL;
     }
     ESP_LOGD(TAG, LOG_FMT("success"));
-    sd->lru_counter = httpd_sess_get_lru_counter();
     return ESP_OK;
 }
 
+int httpd_sess_release(struct httpd_data *hd, struct sock_db *sd, esp_err_t ret)
+{
+    int fd = sd->fd;
+    httpd_sess_set_busy(hd, sd, false);
+    if (ret != ESP_OK || sd->close_pending) {
+        ESP_LOGD(TAG, LOG_FMT("closing socket %d"), fd);
+        close(fd);
+        /* Delete session and return the fd preceding
+         * the one being deleted */
+        return httpd_sess_delete(hd, fd);
+    }
+    sd->lru_counter = httpd_sess_get_lru_counter();
+    httpd_sess_lru_reorder(hd, sd);
+    return fd;
+}
+
 esp_err_t httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd)
 {
     if (handle == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    /* Search for the socket database entry */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd == sockfd) {
-            hd->hd_sd[i].lru_counter = httpd_sess_get_lru_counter();
-            return ESP_OK;
-        }
+    struct sock_db *sd = httpd_sess_get(handle, sockfd);
+    if (sd == NULL) {
+        return ESP_ERR_NOT_FOUND;
     }
-    return ESP_ERR_NOT_FOUND;
+    /* The counter of a session being processed by a worker is
+     * updated by the server thread once the worker is done.
+     * As this may be called from any task, the LRU list itself
+     * is only reordered by the server thread, when purging */
+    if (!sd->busy) {
+        sd->lru_counter = httpd_sess_get_lru_counter();
+    }
+    return ESP_OK;
 }
 
 esp_err_t httpd_sess_close_lru(struct httpd_data *hd)
 {
-    uint64_t lru_counter = UINT64_MAX;
+    /* If a slot is free, there is no need to close any session */
+    if (httpd_is_sess_available(hd)) {
+        return ESP_OK;
+    }
+
+    /* Sessions are ordered from the least recently used one, except those
+     * touched by httpd_sess_update_lru_counter() since they were placed.
+     * These can only move towards the tail, and are moved when met */
     int lru_fd = -1;
-    int i;
-    for (i = 0; i < hd->config.max_open_sockets; i++) {
-        /* If a descriptor is -1, there is no need to close any session.
-         * So, we can return from here, without finding the Least Recently Used
-         * session
-         */
-        if (hd->hd_sd[i].fd == -1) {
-            return ESP_OK;
+    struct sock_db *sd = hd->hd_lru_head;
+    for (int i = 0; sd && i < 2 * hd->config.max_open_sockets; i++) {
+        if (sd->lru_counter != sd->lru_ordered) {
+            struct sock_db *prev = sd->lru_prev;
+            httpd_sess_lru_reorder(hd, sd);
+            sd = prev ? prev->lru_next : hd->hd_lru_head;
+            continue;
         }
-        if (hd->hd_sd[i].lru_counter < lru_counter) {
-            lru_counter = hd->hd_sd[i].lru_counter;
-            lru_fd = hd->hd_sd[i].fd;
+        if (!sd->busy) {
+            lru_fd = sd->fd;
+            break;
         }
+        sd = sd->lru_next;
+    }
+    if (lru_fd == -1) {
+        ESP_LOGD(TAG, LOG_FMT("all sessions are being processed"));
+        return ESP_ERR_NOT_FOUND;
     }
     ESP_LOGD(TAG, LOG_FMT("fd = %d"), lru_fd);
     return httpd_sess_trigger_close(hd, lru_fd);
@@ -355,22 +466,9 @@ esp_err_t httpd_sess_close_lru(struct httpd_data *hd)
 
 int httpd_sess_iterate(struct httpd_data *hd, int start_fd)
 {
-    int start_index = 0;
-    int i;
-
-    if (start_fd != -1) {
-        /* Take our index to where this fd is stored */
-        for (i = 0; i < hd->config.max_open_sockets; i++) {
-            if (hd->hd_sd[i].fd == start_fd) {
-                start_index = i + 1;
-                break;
-            }
-        }
-    }
-
-    for (i = start_index; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1) {
-            return hd->hd_sd[i].fd;
+    for (int fd = MAX(start_fd + 1, 0); fd <= hd->hd_sess_maxfd; fd++) {
+        if (hd->hd_sd_map[fd]) {
+            return fd;
         }
     }
     return -1;
@@ -384,6 +482,12 @@ static void httpd_sess_close(void *arg)
             ESP_LOGD(TAG, "Skipping session close for %d as it seems to be a race condition", sock_db->fd);
             return;
         }
+        if (sock_db->busy) {
+            /* Let the worker complete the request first */
+            ESP_LOGD(TAG, "Deferring session close for %d until processed", sock_db->fd);
+            sock_db->close_pending = true;
+            return;
+        }
         int fd = sock_db->fd;
         struct httpd_data *hd = (struct httpd_data *) sock_db->handle;
         httpd_sess_delete(hd, fd);
@@ -90,15 +90,24 @@ bool httpd_uri_match_wildcard(const char *template, const char *uri, size_t len)
 
 /* Find handler with matching URI and method, and set
  * appropriate error code if URI or method not found */
-static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
-                                           const char *uri, size_t uri_len,
-                                           httpd_method_t method,
-                                           httpd_err_code_t *err)
+httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
+                                    const char *uri, size_t uri_len,
+                                    httpd_method_t method,
+                                    httpd_err_code_t *err)
 {
     if (err) {
         *err = HTTPD_404_NOT_FOUND;
     }
 
+    if (hd->hd_router) {
+        bool uri_found;
+        httpd_uri_t *handler = httpd_router_find(hd, uri, uri_len, method, &uri_found);
+        if (err) {
+            *err = handler ? 0 : (uri_found ? HTTPD_405_METHOD_NOT_ALLOWED : HTTPD_404_NOT_FOUND);
+        }
+        return handler;
+    }
+
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -131,20 +140,14 @@ static httpd_uri_t* httpd_find_uri_handler(struct httpd_data *hd,
     return NULL;
 }
 
-esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
-                                     const httpd_uri_t *uri_handler)
+static esp_err_t httpd_register_uri_handler_locked(struct httpd_data *hd,
+                                                   const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri_handler == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    struct httpd_data *hd = (struct httpd_data *) handle;
-
     /* Make sure another handler with matching URI and method
      * is not already registered. This will also catch cases
      * when a registered URI wildcard pattern already accounts
      * for the new URI being registered */
-    if (httpd_find_uri_handler(handle, uri_handler->uri,
+    if (httpd_find_uri_handler(hd, uri_handler->uri,
                                strlen(uri_handler->uri),
                                uri_handler->method, NULL) != NULL) {
         ESP_LOGW(TAG, LOG_FMT("handler %s with method %d already registered"),
@@ -174,8 +177,10 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
             hd->hd_calls[i]->user_ctx = uri_handler->user_ctx;
 #ifdef CONFIG_HTTPD_WS_SUPPORT
             hd->hd_calls[i]->is_websocket = uri_handler->is_websocket;
+            hd->hd_calls[i]->ws_deflate = uri_handler->ws_deflate;
 #endif
             ESP_LOGD(TAG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
+            httpd_router_build(hd);
             return ESP_OK;
         }
         ESP_LOGD(TAG, LOG_FMT("[%d] exists %s"), i, hd->hd_calls[i]->uri);
@@ -184,14 +189,23 @@ esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
     return ESP_ERR_HTTPD_HANDLERS_FULL;
 }
 
-esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
-                                       const char *uri, httpd_method_t method)
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler)
 {
-    if (handle == NULL || uri == NULL) {
+    if (handle == NULL || uri_handler == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
     struct httpd_data *hd = (struct httpd_data *) handle;
+    httpd_os_mutex_lock(hd->hd_calls_lock);
+    esp_err_t ret = httpd_register_uri_handler_locked(hd, uri_handler);
+    httpd_os_mutex_unlock(hd->hd_calls_lock);
+    return ret;
+}
+
+static esp_err_t httpd_unregister_uri_handler_locked(struct httpd_data *hd,
+                                                     const char *uri, httpd_method_t method)
+{
     for (int i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -214,6 +228,7 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
             }
             /* Nullify the following non null entry */
             hd->hd_calls[i-1] = NULL;
+            httpd_router_build(hd);
             return ESP_OK;
         }
     }
@@ -221,6 +236,20 @@ esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
     return ESP_ERR_NOT_FOUND;
 }
 
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle,
+                                       const char *uri, httpd_method_t method)
+{
+    if (handle == NULL || uri == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    httpd_os_mutex_lock(hd->hd_calls_lock);
+    esp_err_t ret = httpd_unregister_uri_handler_locked(hd, uri, method);
+    httpd_os_mutex_unlock(hd->hd_calls_lock);
+    return ret;
+}
+
 esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
 {
     if (handle == NULL || uri == NULL) {
@@ -230,6 +259,7 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
     struct httpd_data *hd = (struct httpd_data *) handle;
     bool found = false;
 
+    httpd_os_mutex_lock(hd->hd_calls_lock);
     int i = 0, j = 0; // For keeping count of removed entries
     for (; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
@@ -254,6 +284,8 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
     for (int k = (i - j); k < i; k++) {
         hd->hd_calls[k] = NULL;
     }
+    httpd_router_build(hd);
+    httpd_os_mutex_unlock(hd->hd_calls_lock);
 
     if (!found) {
         ESP_LOGW(TAG, LOG_FMT("no handler found for URI %s"), uri);
@@ -263,6 +295,7 @@ esp_err_t httpd_unregister_uri(httpd_handle_t handle, const char *uri)
 
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
 {
+    httpd_os_mutex_lock(hd->hd_calls_lock);
     for (unsigned i = 0; i < hd->config.max_uri_handlers; i++) {
         if (!hd->hd_calls[i]) {
             break;
@@ -273,23 +306,33 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
         free(hd->hd_calls[i]);
         hd->hd_calls[i] = NULL;
     }
+    httpd_router_free(hd);
+    httpd_os_mutex_unlock(hd->hd_calls_lock);
 }
 
-esp_err_t httpd_uri(struct httpd_data *hd)
+esp_err_t httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct httpd_req_aux   *ra  = req->aux;
+    struct http_parser_url *res = &ra->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
 
     ESP_LOGD(TAG, LOG_FMT("request for %s with type %d"), req->uri, req->method);
 
-    /* URL parser result contains offset and length of path string */
+    /* URL parser result contains offset and length of path string. The handler
+     * is copied, as it may be unregistered by another task while it runs */
+    httpd_uri_t found;
     if (res->field_set & (1 << UF_PATH)) {
+        httpd_os_mutex_lock(hd->hd_calls_lock);
         uri = httpd_find_uri_handler(hd, req->uri + res->field_data[UF_PATH].off,
                                      res->field_data[UF_PATH].len, req->method, &err);
+        if (uri) {
+            found = *uri;
+            uri = &found;
+        }
+        httpd_os_mutex_unlock(hd->hd_calls_lock);
     }
 
     /* If URI with method not found, respond with error code */
@@ -315,7 +358,7 @@ esp_err_t httpd_uri(struct httpd_data *hd)
     struct httpd_req_aux   *aux = req->aux;
     if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
         ESP_LOGD(TAG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        esp_err_t ret = httpd_ws_respond_server_handshake(&hd->hd_req);
+        esp_err_t ret = httpd_ws_respond_server_handshake(req, uri);
         if (ret != ESP_OK) {
             return ret;
         }
@@ -0,0 +1,175 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <esp_log.h>
+#include <esp_err.h>
+
+#include <esp_http_server.h>
+#include "esp_httpd_priv.h"
+
+static const char *TAG = "httpd_worker";
+
+/* Result of the processing of a session by a worker */
+struct httpd_worker_result {
+    struct sock_db *sd;
+    esp_err_t ret;
+};
+
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *w = (struct httpd_worker *) arg;
+    struct httpd_data *hd = w->hd;
+
+    struct sock_db *sd;
+    /* A NULL session asks the worker to stop */
+    while (httpd_os_queue_receive(hd->hd_work_queue, &sd, -1) == OS_SUCCESS && sd) {
+        ESP_LOGD(TAG, LOG_FMT("processing socket %d"), sd->fd);
+        struct httpd_worker_result res = {
+            .sd = sd,
+            .ret = httpd_sess_process(hd, &w->req, sd),
+        };
+        /* The done queue can hold all the sessions, this doesn't block */
+        httpd_os_queue_send(hd->hd_done_queue, &res);
+        /* Wake up the server thread. If the control message is lost, the
+         * session is still collected on the next pass of the server loop */
+        httpd_queue_work(hd, httpd_workers_collect, hd);
+    }
+
+    ESP_LOGD(TAG, LOG_FMT("worker exiting"));
+    w->td.status = THREAD_STOPPED;
+    httpd_os_thread_delete();
+}
+
+esp_err_t httpd_workers_start(struct httpd_data *hd)
+{
+    size_t count = hd->config.worker_count;
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    /* Every session is queued at most once at a time, plus one stop
+     * request per worker, so sending to the queues never blocks */
+    hd->hd_work_queue = httpd_os_queue_create(hd->config.max_open_sockets + count,
+                                              sizeof(struct sock_db *));
+    hd->hd_done_queue = httpd_os_queue_create(hd->config.max_open_sockets,
+                                              sizeof(struct httpd_worker_result));
+    hd->hd_workers = calloc(count, sizeof(struct httpd_worker));
+    if (!hd->hd_work_queue || !hd->hd_done_queue || !hd->hd_workers) {
+        ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP workers"));
+        httpd_workers_stop(hd);
+        return ESP_ERR_HTTPD_ALLOC_MEM;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        w->hd = hd;
+        w->req.aux = &w->req_aux;
+        w->req_aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!w->req_aux.resp_hdrs) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to allocate memory for HTTP response headers"));
+            httpd_workers_stop(hd);
+            return ESP_ERR_HTTPD_ALLOC_MEM;
+        }
+
+        BaseType_t core_id = hd->config.core_id;
+        if (hd->config.worker_pin_to_cores) {
+            core_id = i % portNUM_PROCESSORS;
+        }
+        if (httpd_os_thread_create(&w->td.handle, "httpd_worker",
+                                   hd->config.worker_stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, w, core_id) != OS_SUCCESS) {
+            ESP_LOGE(TAG, LOG_FMT("Failed to launch HTTP worker %u"), (unsigned) i);
+            httpd_workers_stop(hd);
+            return ESP_ERR_HTTPD_TASK;
+        }
+        w->td.status = THREAD_RUNNING;
+    }
+    return ESP_OK;
+}
+
+void httpd_workers_stop(struct httpd_data *hd)
+{
+    if (hd->hd_workers) {
+        /* Any worker may pick any stop request, so one is sent per started
+         * worker, whether or not it has already exited */
+        struct sock_db *stop = NULL;
+        for (size_t i = 0; i < hd->config.worker_count; i++) {
+            if (hd->hd_workers[i].td.status != THREAD_IDLE) {
+                httpd_os_queue_send(hd->hd_work_queue, &stop);
+            }
+        }
+        for (size_t i = 0; i < hd->config.worker_count; i++) {
+            struct httpd_worker *w = &hd->hd_workers[i];
+            if (w->td.status != THREAD_IDLE) {
+                while (w->td.status != THREAD_STOPPED) {
+                    httpd_os_thread_sleep(10);
+                }
+            }
+            free(w->req_aux.resp_hdrs);
+        }
+        free(hd->hd_workers);
+        hd->hd_workers = NULL;
+    }
+
+    if (hd->hd_done_queue) {
+        /* Sessions still marked busy are closed by the caller */
+        httpd_os_queue_delete(hd->hd_done_queue);
+        hd->hd_done_queue = NULL;
+    }
+    if (hd->hd_work_queue) {
+        httpd_os_queue_delete(hd->hd_work_queue);
+        hd->hd_work_queue = NULL;
+    }
+    hd->hd_busy_sessions = 0;
+}
+
+void httpd_worker_dispatch(struct httpd_data *hd, struct sock_db *sd)
+{
+    ESP_LOGD(TAG, LOG_FMT("dispatching socket %d"), sd->fd);
+    httpd_sess_set_busy(hd, sd, true);
+    hd->hd_busy_sessions++;
+    httpd_os_queue_send(hd->hd_work_queue, &sd);
+}
+
+void httpd_workers_collect(void *arg)
+{
+    struct httpd_data *hd = (struct httpd_data *) arg;
+    if (!hd->hd_done_queue) {
+        return;
+    }
+
+    struct httpd_worker_result res;
+    while (httpd_os_queue_receive(hd->hd_done_queue, &res, 0) == OS_SUCCESS) {
+        hd->hd_busy_sessions--;
+        httpd_sess_release(hd, res.sd, res.ret);
+    }
+}
+
+httpd_req_t *httpd_req_current(struct httpd_data *hd)
+{
+    othread_t self = httpd_os_thread_handle();
+    if (self == hd->hd_td.handle) {
+        return &hd->hd_req;
+    }
+    if (hd->hd_workers) {
+        for (size_t i = 0; i < hd->config.worker_count; i++) {
+            if (self == hd->hd_workers[i].td.handle) {
+                return &hd->hd_workers[i].req;
+            }
+        }
+    }
+    return NULL;
+}
@@ -33,6 +33,7 @@ static const char *TAG="httpd_ws";
  * Please refer to RFC6455 Section 5.2 for more details.
  */
 #define HTTPD_WS_FIN_BIT        0x80U
+#define HTTPD_WS_RSV1_BIT       0x40U
 #define HTTPD_WS_OPCODE_BITS    0x0fU
 #define HTTPD_WS_MASK_BIT       0x80U
 #define HTTPD_WS_LENGTH_BITS    0x7fU
@@ -43,7 +44,59 @@ static const char *TAG="httpd_ws";
  */
 static const char ws_magic_uuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
-esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req)
+/* Accepts the permessage-deflate offer of the client, if any acceptable,
+ * and fills the Sec-WebSocket-Extensions header of the response */
+static esp_err_t httpd_ws_accept_deflate(httpd_req_t *req, const httpd_ws_deflate_config_t *deflate,
+                                         char *ext_header, size_t ext_header_size)
+{
+    ext_header[0] = '\0';
+    size_t offers_len = httpd_req_get_hdr_value_len(req, "Sec-WebSocket-Extensions");
+    if (!deflate->enable || offers_len == 0) {
+        return ESP_OK;
+    }
+    char *offers = malloc(offers_len + 1);
+    if (!offers) {
+        return ESP_ERR_NO_MEM;
+    }
+    httpd_req_get_hdr_value_str(req, "Sec-WebSocket-Extensions", offers, offers_len + 1);
+
+    const esp_transport_ws_deflate_config_t config = {
+        .server_max_window_bits = deflate->server_max_window_bits,
+        .client_max_window_bits = deflate->client_max_window_bits,
+        .server_no_context_takeover = deflate->server_no_context_takeover,
+        .client_no_context_takeover = deflate->client_no_context_takeover,
+        .max_message_size = deflate->max_message_size,
+    };
+    esp_transport_ws_deflate_params_t params;
+    const char prefix[] = "Sec-WebSocket-Extensions: ";
+    char *response = ext_header + strlen(prefix);
+    esp_err_t ret = esp_transport_ws_deflate_server_accept(&config, offers, &params, response,
+                                                           ext_header_size - strlen(prefix) - 2);
+    free(offers);
+    if (ret != ESP_OK) {
+        /* The session goes on without compression */
+        ext_header[0] = '\0';
+        ESP_LOGD(TAG, LOG_FMT("No permessage-deflate offer accepted"));
+        return ESP_OK;
+    }
+
+    struct httpd_req_aux *req_aux = req->aux;
+    req_aux->sd->ws_deflate_lock = httpd_os_mutex_create();
+    if (!req_aux->sd->ws_deflate_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    req_aux->sd->ws_deflate = esp_transport_ws_deflate_create(&params);
+    if (!req_aux->sd->ws_deflate) {
+        return ESP_ERR_NO_MEM;
+    }
+    req_aux->sd->ws_deflate_type = HTTPD_WS_TYPE_CONTINUE;
+    memcpy(ext_header, prefix, strlen(prefix));
+    strcat(ext_header, "\r\n");
+    ESP_LOGD(TAG, LOG_FMT("Accepted %s"), response);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req, const httpd_uri_t *uri)
 {
     /* Probe if input parameters are valid or not */
     if (!req || !req->aux) {
@@ -100,13 +153,22 @@ esp_err_t httpd_ws_respond_server_handshake(httpd_req_t *req)
 
     ESP_LOGD(TAG, LOG_FMT("Generated server key: %s"), server_key_encoded);
 
+    /* Negotiate compression, RFC7692 Section 5 */
+    char ext_header[192];
+    esp_err_t ret = httpd_ws_accept_deflate(req, &uri->ws_deflate, ext_header, sizeof(ext_header));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, LOG_FMT("Failed to allocate the permessage-deflate context"));
+        return ret;
+    }
+
     /* Prepare the Switching Protocol response */
-    char tx_buf[192] = { '\0' };
+    char tx_buf[192 + sizeof(ext_header)] = { '\0' };
     int fmt_len = snprintf(tx_buf, sizeof(tx_buf),
                            "HTTP/1.1 101 Switching Protocols\r\n"
                            "Upgrade: websocket\r\n"
                            "Connection: Upgrade\r\n"
-                           "Sec-WebSocket-Accept: %s\r\n\r\n", server_key_encoded);
+                           "Sec-WebSocket-Accept: %s\r\n"
+                           "%s\r\n", server_key_encoded, ext_header);
     if (fmt_len < 0 || fmt_len > sizeof(tx_buf)) {
         ESP_LOGW(TAG, LOG_FMT("Failed to prepare Tx buffer"));
         return ESP_FAIL;
@@ -153,6 +215,46 @@ static esp_err_t httpd_ws_unmask_payload(uint8_t *payload, size_t len, const uin
     return ESP_OK;
 }
 
+/* Gathers the payload of a compressed frame, the message is decompressed
+ * into the frame once its last frame is in */
+static esp_err_t httpd_ws_recv_compressed(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len,
+                                          const uint8_t *mask_key)
+{
+    struct httpd_req_aux *aux = req->aux;
+    struct sock_db *sd = aux->sd;
+    char *data = esp_transport_ws_deflate_reserve(sd->ws_deflate, frame->len);
+    if (!data) {
+        ESP_LOGW(TAG, LOG_FMT("WS compressed message too long"));
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (frame->len > 0) {
+        if (httpd_recv_with_opt(req, data, frame->len, false) <= 0) {
+            ESP_LOGW(TAG, LOG_FMT("Failed to receive payload"));
+            return ESP_FAIL;
+        }
+        httpd_ws_unmask_payload((uint8_t *)data, frame->len, mask_key);
+    }
+
+    frame->len = 0;
+    if (!frame->final) {
+        return ESP_OK;
+    }
+
+    frame->type = sd->ws_deflate_type;
+    sd->ws_deflate_type = HTTPD_WS_TYPE_CONTINUE;
+    size_t len = 0;
+    esp_err_t ret = esp_transport_ws_deflate_finish(sd->ws_deflate, (char *)frame->payload,
+                                                    frame->payload ? max_len : 0, &len);
+    if (ret == ESP_ERR_NO_MEM) {
+        return ESP_FAIL;
+    } else if (ret != ESP_OK) {
+        ESP_LOGW(TAG, LOG_FMT("Failed to decompress the WS message"));
+        return ret;
+    }
+    frame->len = len;
+    return ESP_OK;
+}
+
 esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len)
 {
     esp_err_t ret = httpd_ws_check_req(req);
@@ -218,8 +320,9 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
                     ((uint64_t)length_bytes[7]));
     }
 
-    /* We only accept the incoming packet length that is smaller than the max_len (or it will overflow the buffer!) */
-    if (frame->len > max_len) {
+    /* We only accept the incoming packet length that is smaller than the max_len (or it will overflow the buffer!)
+     * Compressed frames are bounded by the max_message_size of the session instead */
+    if (frame->len > max_len && !aux->ws_compressed) {
         ESP_LOGW(TAG, LOG_FMT("WS Message too long"));
         return ESP_ERR_INVALID_SIZE;
     }
@@ -238,6 +341,10 @@ esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t
         return ESP_ERR_INVALID_STATE;
     }
 
+    if (aux->ws_compressed) {
+        return httpd_ws_recv_compressed(req, frame, max_len, mask_key);
+    }
+
     /* Receive buffer */
     /* If there's nothing to receive, return and stop here. */
     if (frame->len == 0) {
@@ -276,26 +383,57 @@ esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t
         return ESP_ERR_INVALID_ARG;
     }
 
+    struct sock_db *sess = httpd_sess_get(hd, fd);
+    if (!sess) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
     /* Prepare Tx buffer - maximum length is 14, which includes 2 bytes header, 8 bytes length, 4 bytes mask key */
     uint8_t tx_len = 0;
     uint8_t header_buf[10] = {0 };
     header_buf[0] |= frame->final ? HTTPD_WS_FIN_BIT : 0; /* Final (FIN) bit */
     header_buf[0] |= frame->type; /* Type (opcode): 4 bits */
 
-    if (frame->len <= 125) {
-        header_buf[1] = frame->len & 0x7fU; /* Length for 7 bits */
+    /* Data frames are compressed if negotiated, RSV1 marks the first frame of the message.
+     * Frames may be sent by the handler and by other tasks at once: the compressor state
+     * must follow the order of the frames on the wire, so the lock is held until sent */
+    const uint8_t *payload = frame->payload;
+    size_t len = frame->len;
+    char *compressed = NULL;
+    omutex_t lock = NULL;
+    if (sess->ws_deflate && frame->type < HTTPD_WS_TYPE_CLOSE) {
+        compressed = malloc(esp_transport_ws_deflate_bound(len));
+        if (!compressed) {
+            return ESP_ERR_NO_MEM;
+        }
+        lock = sess->ws_deflate_lock;
+        httpd_os_mutex_lock(lock);
+        if (esp_transport_ws_deflate_compress(sess->ws_deflate, (const char *)payload, len, frame->final,
+                                              compressed, &len) != ESP_OK) {
+            httpd_os_mutex_unlock(lock);
+            free(compressed);
+            return ESP_ERR_NO_MEM;
+        }
+        payload = (const uint8_t *)compressed;
+        if (frame->type != HTTPD_WS_TYPE_CONTINUE) {
+            header_buf[0] |= HTTPD_WS_RSV1_BIT;
+        }
+    }
+
+    if (len <= 125) {
+        header_buf[1] = len & 0x7fU; /* Length for 7 bits */
         tx_len = 2;
-    } else if (frame->len > 125 && frame->len < UINT16_MAX) {
+    } else if (len > 125 && len < UINT16_MAX) {
         header_buf[1] = 126;                /* Length for 16 bits */
-        header_buf[2] = (frame->len >> 8U) & 0xffU;
-        header_buf[3] = frame->len & 0xffU;
+        header_buf[2] = (len >> 8U) & 0xffU;
+        header_buf[3] = len & 0xffU;
         tx_len = 4;
     } else {
         header_buf[1] = 127;                /* Length for 64 bits */
         uint8_t shift_idx = sizeof(uint64_t) - 1; /* Shift index starts at 7 */
-        for (int8_t idx = 2; idx > 9; idx--) {
+        for (int8_t idx = 2; idx <= 9; idx++) {
             /* Now do shifting (be careful of endianess, i.e. when buffer index is 2, frame length shift index is 7) */
-            header_buf[idx] = (frame->len >> (uint8_t)(shift_idx * 8)) & 0xffU;
+            header_buf[idx] = ((uint64_t)len >> (uint8_t)(shift_idx * 8)) & 0xffU;
             shift_idx--;
         }
         tx_len = 10;
@@ -304,26 +442,24 @@ esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t
     /* WebSocket server does not required to mask response payload, so leave the MASK bit as 0. */
     header_buf[1] &= (~HTTPD_WS_MASK_BIT);
 
-    struct sock_db *sess = httpd_sess_get(hd, fd);
-    if (!sess) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
+    esp_err_t ret = ESP_OK;
     /* Send off header */
     if (sess->send_fn(hd, fd, (const char *)header_buf, tx_len, 0) < 0) {
         ESP_LOGW(TAG, LOG_FMT("Failed to send WS header"));
-        return ESP_FAIL;
-    }
-
+        ret = ESP_FAIL;
     /* Send off payload */
-    if(frame->len > 0 && frame->payload != NULL) {
-        if (sess->send_fn(hd, fd, (const char *)frame->payload, frame->len, 0) < 0) {
+    } else if (len > 0 && payload != NULL) {
+        if (sess->send_fn(hd, fd, (const char *)payload, len, 0) < 0) {
             ESP_LOGW(TAG, LOG_FMT("Failed to send WS payload"));
-            return ESP_FAIL;
+            ret = ESP_FAIL;
         }
     }
 
-    return ESP_OK;
+    if (lock) {
+        httpd_os_mutex_unlock(lock);
+    }
+    free(compressed);
+    return ret;
 }
 
 esp_err_t httpd_ws_get_frame_type(httpd_req_t *req)
@@ -357,6 +493,15 @@ esp_err_t httpd_ws_get_frame_type(httpd_req_t *req)
     aux->ws_final = (first_byte & HTTPD_WS_FIN_BIT) != 0;
     aux->ws_type = (first_byte & HTTPD_WS_OPCODE_BITS);
 
+    /* RSV1 is set on the first frame of a compressed message, RFC7692 Section 6 */
+    aux->ws_compressed = false;
+    if (aux->sd->ws_deflate && aux->ws_type < HTTPD_WS_TYPE_CLOSE) {
+        if ((first_byte & HTTPD_WS_RSV1_BIT) && aux->ws_type != HTTPD_WS_TYPE_CONTINUE) {
+            aux->sd->ws_deflate_type = aux->ws_type;
+        }
+        aux->ws_compressed = aux->sd->ws_deflate_type != HTTPD_WS_TYPE_CONTINUE;
+    }
+
     /* Reply to PING. For PONG and CLOSE, it will be handled elsewhere. */
     if(aux->ws_type == HTTPD_WS_TYPE_PING) {
         ESP_LOGD(TAG, LOG_FMT("Got a WS PING frame, Replying PONG..."));
@@ -1 +1,2 @@
+COMPONENT_PRIV_INCLUDEDIRS := . ../src/port/esp32
 COMPONENT_ADD_LDFLAGS = -Wl,--whole-archive -l$(COMPONENT_NAME) -Wl,--no-whole-archive
@@ -0,0 +1,237 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <esp_timer.h>
+#include <esp_http_server.h>
+#include "../src/esp_httpd_priv.h"
+
+#include "unity.h"
+#include "test_utils.h"
+
+#define ROUTER_TEST_PORT        8071
+#define ROUTER_TEST_CTRL_PORT   32801
+#define ROUTER_TEST_MAX_URIS    96
+
+static esp_err_t router_null_handler(httpd_req_t *req)
+{
+    return ESP_OK;
+}
+
+/* Same as httpd_uri_match_wildcard(), but unknown to the router,
+ * so that handlers are looked up by the linear scan */
+static bool linear_match_wildcard(const char *template, const char *uri, size_t len)
+{
+    return httpd_uri_match_wildcard(template, uri, len);
+}
+
+static struct httpd_data *start_router_server(httpd_uri_match_func_t match_fn)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = ROUTER_TEST_PORT;
+    config.ctrl_port = ROUTER_TEST_CTRL_PORT;
+    config.max_uri_handlers = ROUTER_TEST_MAX_URIS;
+    config.uri_match_fn = match_fn;
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_start(&hd, &config));
+    return (struct httpd_data *) hd;
+}
+
+typedef struct {
+    char uri[12];
+    httpd_method_t method;
+} ref_handler_t;
+
+/* The lookup as done before the router: first registered match wins */
+static int ref_find(const ref_handler_t *refs, int count, httpd_uri_match_func_t match_fn,
+                    const char *uri, httpd_method_t method, httpd_err_code_t *err)
+{
+    *err = HTTPD_404_NOT_FOUND;
+    for (int i = 0; i < count; i++) {
+        bool match = match_fn ? match_fn(refs[i].uri, uri, strlen(uri)) :
+                     strcmp(refs[i].uri, uri) == 0;
+        if (match) {
+            if (refs[i].method == method) {
+                *err = 0;
+                return i;
+            }
+            *err = HTTPD_405_METHOD_NOT_ALLOWED;
+        }
+    }
+    return -1;
+}
+
+/* Removes the handlers of a URI, for the given method or any if negative */
+static int ref_remove(ref_handler_t *refs, int count, const char *uri, int method)
+{
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(refs[i].uri, uri) != 0 || (method >= 0 && refs[i].method != method)) {
+            refs[kept++] = refs[i];
+        }
+    }
+    return kept;
+}
+
+static void check_against_ref(struct httpd_data *hd, const ref_handler_t *refs, int count,
+                              httpd_uri_match_func_t match_fn)
+{
+    static const char alphabet[] = "/ab";
+    static const httpd_method_t methods[] = { HTTP_GET, HTTP_POST };
+    char uri[8];
+
+    /* Every URI of up to 6 characters over the alphabet used by the templates */
+    for (int len = 0; len <= 6; len++) {
+        int combinations = 1;
+        for (int i = 0; i < len; i++) {
+            combinations *= sizeof(alphabet) - 1;
+        }
+        for (int n = 0; n < combinations; n++) {
+            for (int i = 0, v = n; i < len; i++, v /= sizeof(alphabet) - 1) {
+                uri[i] = alphabet[v % (sizeof(alphabet) - 1)];
+            }
+            uri[len] = '\0';
+            for (int m = 0; m < sizeof(methods) / sizeof(methods[0]); m++) {
+                httpd_err_code_t err, ref_err;
+                httpd_os_mutex_lock(hd->hd_calls_lock);
+                httpd_uri_t *handler = httpd_find_uri_handler(hd, uri, len, methods[m], &err);
+                int ref = ref_find(refs, count, match_fn, uri, methods[m], &ref_err);
+                TEST_ASSERT_EQUAL(ref_err, err);
+                if (ref < 0) {
+                    TEST_ASSERT_NULL(handler);
+                } else {
+                    TEST_ASSERT_NOT_NULL(handler);
+                    TEST_ASSERT_EQUAL_STRING(refs[ref].uri, handler->uri);
+                    TEST_ASSERT_EQUAL(refs[ref].method, handler->method);
+                }
+                httpd_os_mutex_unlock(hd->hd_calls_lock);
+            }
+        }
+    }
+}
+
+static void test_router_semantics(httpd_uri_match_func_t match_fn)
+{
+    static const char *suffixes[] = { "", "", "*", "?", "?*", "*?" };
+    static const char alphabet[] = "/ab";
+    struct httpd_data *hd = start_router_server(match_fn);
+    ref_handler_t refs[ROUTER_TEST_MAX_URIS];
+    int count = 0;
+
+    srand(0x5eed);
+    for (int i = 0; i < 60; i++) {
+        ref_handler_t ref;
+        int len = rand() % 5;
+        for (int j = 0; j < len; j++) {
+            ref.uri[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        strcpy(ref.uri + len, suffixes[rand() % (sizeof(suffixes) / sizeof(suffixes[0]))]);
+        ref.method = rand() % 2 ? HTTP_GET : HTTP_POST;
+
+        httpd_uri_t uri = {
+            .uri = ref.uri,
+            .method = ref.method,
+            .handler = router_null_handler,
+        };
+        /* Templates overlapping with earlier ones are rejected */
+        if (httpd_register_uri_handler(hd, &uri) == ESP_OK) {
+            refs[count++] = ref;
+        }
+    }
+    TEST_ASSERT_NOT_NULL(hd->hd_router);
+    check_against_ref(hd, refs, count, match_fn);
+
+    /* The router follows the changes of the handlers, keeping their order */
+    for (int i = count - 1; i >= 0; i -= 3) {
+        ref_handler_t removed = refs[i];
+        TEST_ASSERT_EQUAL(ESP_OK, httpd_unregister_uri_handler(hd, removed.uri, removed.method));
+        count = ref_remove(refs, count, removed.uri, removed.method);
+    }
+    ref_handler_t removed = refs[0];
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_unregister_uri(hd, removed.uri));
+    count = ref_remove(refs, count, removed.uri, -1);
+    check_against_ref(hd, refs, count, match_fn);
+
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+}
+
+TEST_CASE("URI router matches like the linear lookup", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    test_router_semantics(httpd_uri_match_wildcard);
+    test_router_semantics(NULL);
+}
+
+/* Registers a REST-like API of 'count' handlers, a quarter of them being wildcards */
+static void register_api(struct httpd_data *hd, int count)
+{
+    char path[32];
+    for (int i = 0; i < count; i++) {
+        if (i % 4 == 3) {
+            snprintf(path, sizeof(path), "/api/v1/files/%d/*", i);
+        } else {
+            snprintf(path, sizeof(path), "/api/v1/resource/%d", i);
+        }
+        httpd_uri_t uri = {
+            .uri = path,
+            .method = i % 2 ? HTTP_POST : HTTP_GET,
+            .handler = router_null_handler,
+        };
+        TEST_ASSERT_EQUAL(ESP_OK, httpd_register_uri_handler(hd, &uri));
+    }
+}
+
+static int64_t time_lookups(struct httpd_data *hd, int count)
+{
+    /* Looks up the last registered handlers, the worst case for a linear scan */
+    char paths[2][40];
+    snprintf(paths[0], sizeof(paths[0]), "/api/v1/resource/%d", count - 2);
+    snprintf(paths[1], sizeof(paths[1]), "/api/v1/files/%d/some/file.txt", count - 1);
+    const size_t lens[2] = { strlen(paths[0]), strlen(paths[1]) };
+
+    httpd_os_mutex_lock(hd->hd_calls_lock);
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < 1000; i++) {
+        httpd_err_code_t err;
+        TEST_ASSERT_NOT_NULL(httpd_find_uri_handler(hd, paths[i % 2], lens[i % 2],
+                                                    i % 2 ? HTTP_POST : HTTP_GET, &err));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    httpd_os_mutex_unlock(hd->hd_calls_lock);
+    return elapsed;
+}
+
+TEST_CASE("URI router lookup cost against handler count", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    const int counts[] = { 8, 32, ROUTER_TEST_MAX_URIS };
+    int64_t router_time = 0, linear_time = 0;
+    for (int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        struct httpd_data *hd = start_router_server(httpd_uri_match_wildcard);
+        register_api(hd, counts[c]);
+        router_time = time_lookups(hd, counts[c]);
+        TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+
+        hd = start_router_server(linear_match_wildcard);
+        register_api(hd, counts[c]);
+        linear_time = time_lookups(hd, counts[c]);
+        TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+
+        printf("%d handlers: 1000 lookups in %lld us with the router, %lld us with the linear scan\n",
+               counts[c], router_time, linear_time);
+    }
+    TEST_ASSERT_TRUE(router_time < linear_time);
+}
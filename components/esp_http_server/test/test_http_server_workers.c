@@ -0,0 +1,340 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_http_server.h>
+
+#include "unity.h"
+#include "test_utils.h"
+
+#define WORKERS_TEST_PORT       8070
+#define WORKERS_TEST_CTRL_PORT  32800
+#define WORKERS_TEST_COUNT      3
+
+#define LOAD_CLIENTS            4
+#define LOAD_REQUESTS           50
+
+static SemaphoreHandle_t s_slow_release;
+static SemaphoreHandle_t s_work_done;
+static int s_last_sockfd;
+
+static esp_err_t fast_handler(httpd_req_t *req)
+{
+    /* Echo the query string, if any, to let clients check the order of responses */
+    char query[16] = "ok";
+    s_last_sockfd = httpd_req_to_sockfd(req);
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+    return httpd_resp_sendstr(req, query);
+}
+
+static esp_err_t slow_handler(httpd_req_t *req)
+{
+    /* Stand-in for a long download: keeps its worker busy until released */
+    xSemaphoreTake(s_slow_release, 5000 / portTICK_PERIOD_MS);
+    return httpd_resp_sendstr(req, "slow");
+}
+
+static httpd_handle_t start_workers_server(size_t worker_count, uint16_t max_open_sockets, bool lru_purge_enable)
+{
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = WORKERS_TEST_PORT;
+    config.ctrl_port = WORKERS_TEST_CTRL_PORT;
+    config.worker_count = worker_count;
+    config.worker_pin_to_cores = true;
+    config.max_open_sockets = max_open_sockets;
+    config.lru_purge_enable = lru_purge_enable;
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_start(&hd, &config));
+
+    httpd_uri_t fast = { .uri = "/fast", .method = HTTP_GET, .handler = fast_handler };
+    httpd_uri_t slow = { .uri = "/slow", .method = HTTP_GET, .handler = slow_handler };
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_register_uri_handler(hd, &fast));
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_register_uri_handler(hd, &slow));
+    return hd;
+}
+
+static int client_connect(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT(fd >= 0);
+
+    /* Fail the test rather than hang if the server stalls */
+    struct timeval tv = { .tv_sec = 3 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(WORKERS_TEST_PORT),
+    };
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+    return fd;
+}
+
+static void client_send_get(int fd, const char *uri)
+{
+    char req[64];
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", uri);
+    TEST_ASSERT_EQUAL(len, send(fd, req, len, 0));
+}
+
+/* Receives one response and copies its body to 'body'. Returns false on timeout or disconnection. */
+static bool client_recv_response(int fd, char *body, size_t body_size)
+{
+    char buf[256] = "";
+    size_t len = 0;
+    char *hdr_end = NULL;
+    int content_len = -1;
+    while (1) {
+        if (!hdr_end && (hdr_end = strstr(buf, "\r\n\r\n")) != NULL) {
+            const char *cl = strstr(buf, "Content-Length: ");
+            TEST_ASSERT_NOT_NULL(cl);
+            content_len = atoi(cl + strlen("Content-Length: "));
+        }
+        if (hdr_end && buf + len >= hdr_end + 4 + content_len) {
+            break;
+        }
+        /* Read byte by byte, so that pipelined responses are left in the socket */
+        if (len >= sizeof(buf) - 1 || recv(fd, buf + len, 1, 0) != 1) {
+            return false;
+        }
+        buf[++len] = '\0';
+    }
+    snprintf(body, body_size, "%.*s", content_len, hdr_end + 4);
+    return true;
+}
+
+static bool client_get(int fd, const char *uri, const char *expected)
+{
+    char body[16];
+    client_send_get(fd, uri);
+    return client_recv_response(fd, body, sizeof(body)) && strcmp(body, expected) == 0;
+}
+
+static void work_fn(void *arg)
+{
+    xSemaphoreGive(s_work_done);
+}
+
+TEST_CASE("Slow handler doesn't stall other clients with workers", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    s_slow_release = xSemaphoreCreateBinary();
+    s_work_done = xSemaphoreCreateBinary();
+    httpd_handle_t hd = start_workers_server(WORKERS_TEST_COUNT, 7, false);
+
+    int slow_fd = client_connect();
+    client_send_get(slow_fd, "/slow");
+    /* Let a worker pick the slow request */
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+
+    /* Other clients are served while the slow handler runs */
+    int fast_fd = client_connect();
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(client_get(fast_fd, "/fast", "ok"));
+    }
+    printf("10 requests served in %lld us while a handler is blocked\n", esp_timer_get_time() - start);
+
+    /* Work queued to the server task still runs */
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_queue_work(hd, work_fn, NULL));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_work_done, 1000 / portTICK_PERIOD_MS));
+
+    /* Pipelined requests of a session are processed one at a time, in order */
+    char uri[16];
+    char expected[16];
+    for (int i = 0; i < 8; i++) {
+        snprintf(uri, sizeof(uri), "/fast?%d", i);
+        client_send_get(fast_fd, uri);
+    }
+    for (int i = 0; i < 8; i++) {
+        char body[16];
+        snprintf(expected, sizeof(expected), "%d", i);
+        TEST_ASSERT_TRUE(client_recv_response(fast_fd, body, sizeof(body)));
+        TEST_ASSERT_EQUAL_STRING(expected, body);
+    }
+
+    xSemaphoreGive(s_slow_release);
+    char body[16];
+    TEST_ASSERT_TRUE(client_recv_response(slow_fd, body, sizeof(body)));
+    TEST_ASSERT_EQUAL_STRING("slow", body);
+
+    close(fast_fd);
+    close(slow_fd);
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+    vSemaphoreDelete(s_work_done);
+    vSemaphoreDelete(s_slow_release);
+}
+
+typedef struct {
+    SemaphoreHandle_t done;
+    int served;
+} load_client_t;
+
+static void load_client_task(void *arg)
+{
+    load_client_t *client = (load_client_t *) arg;
+    int fd = client_connect();
+    for (int i = 0; i < LOAD_REQUESTS; i++) {
+        if (client_get(fd, "/fast", "ok")) {
+            client->served++;
+        }
+    }
+    close(fd);
+    xSemaphoreGive(client->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("HTTP server load test over loopback", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    /* Same load, processed by the server task and by workers */
+    const size_t worker_counts[] = { 0, WORKERS_TEST_COUNT };
+    for (int w = 0; w < sizeof(worker_counts) / sizeof(worker_counts[0]); w++) {
+        httpd_handle_t hd = start_workers_server(worker_counts[w], 7, false);
+        load_client_t clients[LOAD_CLIENTS];
+        int64_t start = esp_timer_get_time();
+        for (int i = 0; i < LOAD_CLIENTS; i++) {
+            clients[i].done = xSemaphoreCreateBinary();
+            clients[i].served = 0;
+            TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(load_client_task, "load_client", 4096,
+                                                              &clients[i], 5, NULL, i % portNUM_PROCESSORS));
+        }
+        int served = 0;
+        for (int i = 0; i < LOAD_CLIENTS; i++) {
+            TEST_ASSERT_TRUE(xSemaphoreTake(clients[i].done, 10000 / portTICK_PERIOD_MS));
+            vSemaphoreDelete(clients[i].done);
+            served += clients[i].served;
+        }
+        printf("%d workers: %d requests from %d clients in %lld us\n", (int) worker_counts[w],
+               served, LOAD_CLIENTS, esp_timer_get_time() - start);
+        TEST_ASSERT_EQUAL(LOAD_CLIENTS * LOAD_REQUESTS, served);
+        TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+    }
+}
+
+TEST_CASE("LRU purge skips sessions being processed by workers", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    s_slow_release = xSemaphoreCreateBinary();
+    httpd_handle_t hd = start_workers_server(WORKERS_TEST_COUNT, 3, true);
+
+    /* The oldest session is busy in the slow handler */
+    int fds[4];
+    fds[0] = client_connect();
+    client_send_get(fds[0], "/slow");
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+    for (int i = 1; i < 3; i++) {
+        fds[i] = client_connect();
+        TEST_ASSERT_TRUE(client_get(fds[i], "/fast", "ok"));
+    }
+
+    /* A new client makes the server close the least recently used idle session */
+    fds[3] = client_connect();
+    TEST_ASSERT_TRUE(client_get(fds[3], "/fast", "ok"));
+    char c;
+    TEST_ASSERT_EQUAL(0, recv(fds[1], &c, 1, 0));
+    TEST_ASSERT_TRUE(client_get(fds[2], "/fast", "ok"));
+
+    /* The busy session wasn't purged */
+    xSemaphoreGive(s_slow_release);
+    char body[16];
+    TEST_ASSERT_TRUE(client_recv_response(fds[0], body, sizeof(body)));
+    TEST_ASSERT_EQUAL_STRING("slow", body);
+
+    for (int i = 0; i < 4; i++) {
+        close(fds[i]);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+    vSemaphoreDelete(s_slow_release);
+}
+
+TEST_CASE("LRU purge closes the least recently used session", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    httpd_handle_t hd = start_workers_server(0, 3, true);
+
+    int fds[4];
+    int server_fds[3];
+    for (int i = 0; i < 3; i++) {
+        fds[i] = client_connect();
+        TEST_ASSERT_TRUE(client_get(fds[i], "/fast", "ok"));
+        server_fds[i] = s_last_sockfd;
+    }
+
+    /* Order of use: 1, 2, 0 */
+    TEST_ASSERT_TRUE(client_get(fds[0], "/fast", "ok"));
+    /* Then 2, 0, 1, touched from outside the server task */
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_sess_update_lru_counter(hd, server_fds[1]));
+
+    fds[3] = client_connect();
+    TEST_ASSERT_TRUE(client_get(fds[3], "/fast", "ok"));
+    char c;
+    TEST_ASSERT_EQUAL(0, recv(fds[2], &c, 1, 0));
+    TEST_ASSERT_TRUE(client_get(fds[0], "/fast", "ok"));
+    TEST_ASSERT_TRUE(client_get(fds[1], "/fast", "ok"));
+
+    for (int i = 0; i < 4; i++) {
+        close(fds[i]);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+}
+
+TEST_CASE("Handlers can be registered while workers look them up", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    httpd_handle_t hd = start_workers_server(WORKERS_TEST_COUNT, 7, false);
+    load_client_t clients[LOAD_CLIENTS];
+    for (int i = 0; i < LOAD_CLIENTS; i++) {
+        clients[i].done = xSemaphoreCreateBinary();
+        clients[i].served = 0;
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreatePinnedToCore(load_client_task, "load_client", 4096,
+                                                          &clients[i], 5, NULL, i % portNUM_PROCESSORS));
+    }
+
+    /* Each change of the handlers rebuilds the router the workers are reading */
+    char path[16];
+    int changes = 0;
+    while (uxSemaphoreGetCount(clients[0].done) == 0) {
+        snprintf(path, sizeof(path), "/tmp/%d", changes % 4);
+        httpd_uri_t uri = { .uri = path, .method = HTTP_GET, .handler = fast_handler };
+        if (changes % 8 < 4) {
+            TEST_ASSERT_EQUAL(ESP_OK, httpd_register_uri_handler(hd, &uri));
+        } else {
+            TEST_ASSERT_EQUAL(ESP_OK, httpd_unregister_uri(hd, path));
+        }
+        changes++;
+        vTaskDelay(1);
+    }
+
+    int served = 0;
+    for (int i = 0; i < LOAD_CLIENTS; i++) {
+        TEST_ASSERT_TRUE(xSemaphoreTake(clients[i].done, 10000 / portTICK_PERIOD_MS));
+        vSemaphoreDelete(clients[i].done);
+        served += clients[i].served;
+    }
+    printf("%d handler changes while serving %d requests\n", changes, served);
+    TEST_ASSERT_EQUAL(LOAD_CLIENTS * LOAD_REQUESTS, served);
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+}
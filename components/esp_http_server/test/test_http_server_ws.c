@@ -0,0 +1,267 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_http_server.h>
+#include <esp_transport_ws_deflate.h>
+
+#include "unity.h"
+#include "test_utils.h"
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+
+#define WS_TEST_PORT            8071
+#define WS_TEST_CTRL_PORT       32801
+#define WS_TEST_WORKERS         2
+
+/* Messages sent by the handler and by work queued to the server task at once */
+#define WS_TEST_ECHOES          100
+
+#define WS_FIN                  0x80
+#define WS_RSV1                 0x40
+
+static const char s_async_msg[] = "sent by the server task, sent by the server task, sent by the server task";
+
+static struct {
+    httpd_handle_t hd;
+    int fd;
+    int async_sent;
+    SemaphoreHandle_t work_started;
+    SemaphoreHandle_t work_done;
+} s_ws;
+
+static void ws_async_send(void *arg)
+{
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)s_async_msg,
+        .len = strlen(s_async_msg),
+    };
+    xSemaphoreGive(s_ws.work_started);
+    for (int i = 0; i < WS_TEST_ECHOES; i++) {
+        if (httpd_ws_send_frame_async(s_ws.hd, s_ws.fd, &frame) == ESP_OK) {
+            s_ws.async_sent++;
+        }
+    }
+    xSemaphoreGive(s_ws.work_done);
+}
+
+/* Echoes each message, while the server task sends its own */
+static esp_err_t ws_echo_handler(httpd_req_t *req)
+{
+    uint8_t buf[256];
+    httpd_ws_frame_t frame = { .payload = buf };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, sizeof(buf));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (!frame.final) {
+        /* The fragments of a compressed message come with no data */
+        return frame.len == 0 ? ESP_OK : ESP_FAIL;
+    }
+
+    s_ws.hd = req->handle;
+    s_ws.fd = httpd_req_to_sockfd(req);
+    ret = httpd_queue_work(req->handle, ws_async_send, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    /* Both send at the same time */
+    xSemaphoreTake(s_ws.work_started, portMAX_DELAY);
+    for (int i = 0; i < WS_TEST_ECHOES; i++) {
+        ret = httpd_ws_send_frame(req, &frame);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+static int ws_client_connect(void)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    TEST_ASSERT(fd >= 0);
+
+    struct timeval tv = { .tv_sec = 3 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(WS_TEST_PORT),
+    };
+    inet_aton("127.0.0.1", &addr.sin_addr);
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr *)&addr, sizeof(addr)));
+    return fd;
+}
+
+static void ws_client_recv_all(int fd, void *buf, size_t len)
+{
+    for (size_t got = 0; got < len; ) {
+        int ret = recv(fd, (char *)buf + got, len - got, 0);
+        TEST_ASSERT(ret > 0);
+        got += ret;
+    }
+}
+
+/* Offers permessage-deflate and returns the client side of the agreed compression */
+static esp_transport_ws_deflate_handle_t ws_client_handshake(int fd)
+{
+    const esp_transport_ws_deflate_config_t config = { 0 };
+    char offer[128];
+    TEST_ASSERT(esp_transport_ws_deflate_client_offer(&config, offer, sizeof(offer)) > 0);
+
+    char req[320];
+    int len = snprintf(req, sizeof(req), "GET /ws HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "Sec-WebSocket-Version: 13\r\n"
+                       "Sec-WebSocket-Extensions: %s\r\n\r\n", offer);
+    TEST_ASSERT_EQUAL(len, send(fd, req, len, 0));
+
+    /* Read byte by byte, so that the frames following the response are left in the socket */
+    char resp[384] = "";
+    size_t resp_len = 0;
+    while (!strstr(resp, "\r\n\r\n")) {
+        TEST_ASSERT(resp_len < sizeof(resp) - 1);
+        ws_client_recv_all(fd, resp + resp_len++, 1);
+    }
+    TEST_ASSERT_EQUAL(0, strncmp(resp, "HTTP/1.1 101 ", strlen("HTTP/1.1 101 ")));
+
+    const char header[] = "Sec-WebSocket-Extensions: ";
+    char *ext = strstr(resp, header);
+    TEST_ASSERT_NOT_NULL(ext);
+    ext += strlen(header);
+    *strstr(ext, "\r\n") = '\0';
+
+    esp_transport_ws_deflate_params_t params;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_ws_deflate_client_accept(&config, ext, &params));
+    esp_transport_ws_deflate_handle_t deflate = esp_transport_ws_deflate_create(&params);
+    TEST_ASSERT_NOT_NULL(deflate);
+    return deflate;
+}
+
+/* Compresses a part of a message and sends it masked, as clients must */
+static void ws_client_send(int fd, esp_transport_ws_deflate_handle_t deflate, uint8_t first_byte,
+                           const char *data, bool final)
+{
+    size_t len = 0;
+    uint8_t frame[6 + 128];
+    TEST_ASSERT(esp_transport_ws_deflate_bound(strlen(data)) <= sizeof(frame) - 6);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_ws_deflate_compress(deflate, data, strlen(data), final,
+                                                                (char *)frame + 6, &len));
+    TEST_ASSERT(len < 126);
+    const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    frame[0] = first_byte;
+    frame[1] = 0x80 | len;
+    memcpy(frame + 2, mask, sizeof(mask));
+    for (size_t i = 0; i < len; i++) {
+        frame[6 + i] ^= mask[i % 4];
+    }
+    TEST_ASSERT_EQUAL(6 + len, send(fd, frame, 6 + len, 0));
+}
+
+/* Receives a whole compressed message and decompresses it into buf */
+static void ws_client_recv_message(int fd, esp_transport_ws_deflate_handle_t deflate, char *buf, size_t size)
+{
+    uint8_t header[4];
+    ws_client_recv_all(fd, header, 2);
+    TEST_ASSERT_EQUAL_HEX8(WS_FIN | WS_RSV1 | HTTPD_WS_TYPE_TEXT, header[0]);
+    /* Server frames are not masked */
+    size_t len = header[1];
+    TEST_ASSERT(len <= 126);
+    if (len == 126) {
+        ws_client_recv_all(fd, header + 2, 2);
+        len = (header[2] << 8) | header[3];
+    }
+    char *data = esp_transport_ws_deflate_reserve(deflate, len);
+    TEST_ASSERT_NOT_NULL(data);
+    ws_client_recv_all(fd, data, len);
+
+    size_t msg_len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_transport_ws_deflate_finish(deflate, buf, size - 1, &msg_len));
+    buf[msg_len] = '\0';
+}
+
+TEST_CASE("WebSocket permessage-deflate round trip with concurrent senders", "[HTTP SERVER]")
+{
+    test_case_uses_tcpip();
+    s_ws.async_sent = 0;
+    s_ws.work_started = xSemaphoreCreateBinary();
+    s_ws.work_done = xSemaphoreCreateBinary();
+
+    httpd_handle_t hd;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = WS_TEST_PORT;
+    config.ctrl_port = WS_TEST_CTRL_PORT;
+    config.worker_count = WS_TEST_WORKERS;
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_start(&hd, &config));
+    httpd_uri_t ws = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = ws_echo_handler,
+        .is_websocket = true,
+        .ws_deflate = { .enable = true },
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_register_uri_handler(hd, &ws));
+
+    int fd = ws_client_connect();
+    esp_transport_ws_deflate_handle_t deflate = ws_client_handshake(fd);
+
+    /* A fragmented message: RSV1 is only set on its first frame */
+    const char echo_msg[] = "echoed by the handler, echoed by the handler, echoed by the handler";
+    const size_t half = strlen(echo_msg) / 2;
+    char part[sizeof(echo_msg)];
+    snprintf(part, sizeof(part), "%.*s", (int)half, echo_msg);
+    ws_client_send(fd, deflate, WS_RSV1 | HTTPD_WS_TYPE_TEXT, part, false);
+    ws_client_send(fd, deflate, WS_FIN | HTTPD_WS_TYPE_CONTINUE, echo_msg + half, true);
+
+    /* Messages of both senders interleave, but each one must decompress whole
+     * as the compressor state follows the order of the frames on the wire */
+    int echoes = 0;
+    int async = 0;
+    for (int i = 0; i < 2 * WS_TEST_ECHOES; i++) {
+        char msg[128];
+        ws_client_recv_message(fd, deflate, msg, sizeof(msg));
+        if (strcmp(msg, echo_msg) == 0) {
+            echoes++;
+        } else {
+            TEST_ASSERT_EQUAL_STRING(s_async_msg, msg);
+            async++;
+        }
+    }
+    TEST_ASSERT_EQUAL(WS_TEST_ECHOES, echoes);
+    TEST_ASSERT_EQUAL(WS_TEST_ECHOES, async);
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_ws.work_done, 1000 / portTICK_PERIOD_MS));
+    TEST_ASSERT_EQUAL(WS_TEST_ECHOES, s_ws.async_sent);
+
+    esp_transport_ws_deflate_destroy(deflate);
+    close(fd);
+    TEST_ASSERT_EQUAL(ESP_OK, httpd_stop(hd));
+    vSemaphoreDelete(s_ws.work_done);
+    vSemaphoreDelete(s_ws.work_started);
+}
+
+#endif /* CONFIG_HTTPD_WS_SUPPORT */
@@ -28,6 +28,10 @@ typedef void *esp_https_ota_handle_t;
  */
 typedef struct {
     const esp_http_client_config_t *http_config;   /*!< ESP HTTP client configuration */
+    bool disable_pipeline;                          /*!< Write to flash from the task calling esp_https_ota_perform(),
+                                                         even if CONFIG_ESP_HTTPS_OTA_PIPELINE is enabled */
+    bool disable_resume;                            /*!< Neither resume an interrupted update nor save the progress,
+                                                         even if CONFIG_ESP_HTTPS_OTA_RESUME is enabled */
 } esp_https_ota_config_t;
 
 #define ESP_ERR_HTTPS_OTA_BASE            (0x9000)
@@ -78,6 +82,14 @@ esp_err_t esp_https_ota(const esp_http_client_config_t *config);
  *
  * @note     This API is blocking, so setting `is_async` member of `http_config` structure will
  *           result in an error.
+ * @note     An image served compressed, with Content-Encoding gzip or deflate, is decoded before it
+ *           is written if `decompress_response` member of `http_config` is set, which needs
+ *           CONFIG_ESP_HTTP_CLIENT_DECOMPRESSION. The server must compress it with a window no larger
+ *           than CONFIG_ESP_HTTP_CLIENT_INFLATE_WINDOW_BITS.
+ * @note     With CONFIG_ESP_HTTPS_OTA_RESUME enabled, an update of the same URL which was interrupted
+ *           is resumed from its last checkpoint, if the server still has the same image. The event
+ *           handler of `http_config` gets its `user_data` in the events, but esp_http_client_get_user_data()
+ *           gives the OTA handle.
  *
  * @return
  *    - ESP_OK: HTTPS OTA Firmware upgrade context initialised and HTTPS connection established
@@ -96,6 +108,10 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
  * This function must be called in a loop since it returns after every HTTP read operation thus 
  * giving you the flexibility to stop OTA operation midway.
  * 
+ * @note     With CONFIG_ESP_HTTPS_OTA_PIPELINE enabled, the data read is queued and written to flash
+ *           by a separate task: this function blocks while all the buffers wait to be written, and
+ *           a failed write is returned by the next call. ESP_OK is returned once all the data is written.
+ *
  * @param[in]  https_ota_handle  pointer to esp_https_ota_handle_t structure
  *
  * @return
@@ -167,6 +183,8 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
 *
 * @note   This API should be called only if `esp_https_ota_perform()` has been called atleast once or
 *         if `esp_https_ota_get_img_desc` has been called before.
+* @note   With CONFIG_ESP_HTTPS_OTA_PIPELINE enabled, part of the data read may not be written to flash yet.
+* @note   For a resumed update, the length includes the data written before the update was interrupted.
 *
 * @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
 *
@@ -176,6 +194,24 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
 */
 int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle);
 
+/**
+* @brief  Gives the SHA-256 of the image downloaded, computed while it was written to flash.
+*
+* @note   This API can be called once `esp_https_ota_perform()` returned ESP_OK, before `esp_https_ota_finish()`.
+*         For a resumed update, the hash of the data written before the update was interrupted is
+*         restored from the saved progress, not read again from flash.
+*
+* @param[in]   https_ota_handle   pointer to esp_https_ota_handle_t structure
+* @param[out]  sha256             buffer of 32 bytes for the hash
+*
+* @return
+*    - ESP_OK: Hash written to sha256
+*    - ESP_ERR_INVALID_ARG: Invalid arguments
+*    - ESP_ERR_INVALID_STATE: The image was not completely downloaded
+*    - ESP_ERR_NOT_SUPPORTED: CONFIG_ESP_HTTPS_OTA_RESUME is disabled, or `disable_resume` is set
+*/
+esp_err_t esp_https_ota_get_img_sha256(esp_https_ota_handle_t https_ota_handle, uint8_t *sha256);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,17 @@
 #include <esp_log.h>
 #include <esp_ota_ops.h>
 #include <errno.h>
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#endif
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+#include <nvs.h>
+#include <esp_spi_flash.h>
+#include <mbedtls/sha256.h>
+#endif
 
 #define IMAGE_HEADER_SIZE sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t) + 1
 #define DEFAULT_OTA_BUF_SIZE IMAGE_HEADER_SIZE
@@ -31,6 +42,59 @@ typedef enum {
     ESP_HTTPS_OTA_SUCCESS,
 } esp_https_ota_state;
 
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+#define OTA_PIPELINE_BUFFERS CONFIG_ESP_HTTPS_OTA_PIPELINE_BUFFERS
+
+typedef struct {
+    char *data;         /* NULL stops the writer */
+    int len;
+} ota_write_req_t;
+
+typedef struct {
+    char *bufs[OTA_PIPELINE_BUFFERS];   /* bufs[0] is ota_upgrade_buf */
+    QueueHandle_t free_queue;           /* Buffers to download into */
+    QueueHandle_t write_queue;          /* Downloaded buffers, to be written by the writer task */
+    SemaphoreHandle_t writer_done;
+    bool writer_running;
+    esp_err_t write_err;                /* First error of the writer, later buffers are dropped */
+} ota_pipeline_t;
+#endif
+
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+#define OTA_PROGRESS_NAMESPACE  "esp_https_ota"
+#define OTA_PROGRESS_KEY        "progress"
+#define OTA_PROGRESS_VERSION    1
+#define OTA_ETAG_MAX_LEN        64
+#define OTA_CHECKPOINT_INTERVAL ((CONFIG_ESP_HTTPS_OTA_RESUME_CHECKPOINT_INTERVAL * 1024 + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1))
+
+/* Saved to NVS at every checkpoint */
+typedef struct {
+    uint32_t version;
+    uint32_t partition_address;
+    uint32_t url_hash;
+    uint32_t image_len;
+    uint32_t written;               /* Sector aligned, all of it is in flash */
+    uint32_t sha_total[2];          /* SHA-256 state of the data written, on whole blocks */
+    uint32_t sha_state[8];
+    char etag[OTA_ETAG_MAX_LEN];    /* Strong ETag of the image */
+} ota_progress_t;
+
+typedef struct {
+    http_event_handle_cb event_handler; /* Of the application, called from _http_event_handler() */
+    void *user_data;
+    ota_progress_t progress;            /* Loaded when begun, then updated at every checkpoint */
+    bool resuming;                      /* Range request sent, then accepted */
+    bool checkpoints;                   /* Image can be resumed: progress is saved */
+    uint32_t written;
+    uint32_t next_checkpoint;
+    mbedtls_sha256_context sha;
+    uint8_t sha256[32];                 /* Of the whole image, once downloaded */
+    char response_etag[OTA_ETAG_MAX_LEN];
+    int range_start;                    /* From Content-Range, -1 if none */
+    int range_total;
+} ota_resume_t;
+#endif
+
 struct esp_https_ota_handle {
     esp_ota_handle_t update_handle;
     const esp_partition_t *update_partition;
@@ -39,6 +103,12 @@ struct esp_https_ota_handle {
     size_t ota_upgrade_buf_size;
     int binary_file_len;
     esp_https_ota_state state;
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    ota_pipeline_t *pipeline;           /* NULL if written from the calling task */
+#endif
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    ota_resume_t *resume;               /* NULL if the update is not resumable */
+#endif
 };
 
 typedef struct esp_https_ota_handle esp_https_ota_t;
@@ -116,12 +186,285 @@ static void _http_cleanup(esp_http_client_handle_t client)
     esp_http_client_cleanup(client);
 }
 
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+static uint32_t _fnv1a(uint32_t hash, const char *str)
+{
+    while (str && *str) {
+        hash = (hash ^ (uint8_t)*str++) * 16777619;
+    }
+    return hash;
+}
+
+/* Identifies the image of the saved progress, the URL it is redirected to may change */
+static uint32_t _url_hash(const esp_http_client_config_t *config)
+{
+    uint32_t hash = 2166136261;
+    if (config->url) {
+        return _fnv1a(hash, config->url);
+    }
+    hash = _fnv1a(hash, config->host);
+    hash = _fnv1a(hash, config->path);
+    return _fnv1a(hash, config->query);
+}
+
+/* Loads the progress of an earlier update of the same image to the same partition */
+static bool _progress_load(esp_https_ota_t *handle)
+{
+    ota_resume_t *resume = handle->resume;
+    ota_progress_t progress;
+    size_t size = sizeof(progress);
+    nvs_handle_t nvs;
+
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(nvs, OTA_PROGRESS_KEY, &progress, &size);
+    nvs_close(nvs);
+    if (err != ESP_OK || size != sizeof(progress) || progress.version != OTA_PROGRESS_VERSION ||
+            progress.partition_address != handle->update_partition->address ||
+            progress.url_hash != resume->progress.url_hash ||
+            progress.written == 0 || progress.written % SPI_FLASH_SEC_SIZE != 0 ||
+            progress.written >= progress.image_len ||
+            progress.etag[0] == '\0' || memchr(progress.etag, '\0', sizeof(progress.etag)) == NULL) {
+        return false;
+    }
+    resume->progress = progress;
+    return true;
+}
+
+/* Called with all the data up to a sector boundary written to flash */
+static void _progress_save(ota_resume_t *resume)
+{
+    ota_progress_t *progress = &resume->progress;
+    mbedtls_sha256_context sha;
+    nvs_handle_t nvs;
+
+    /* Reads the digest state out of the SHA engine, if the hash runs in hardware */
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_clone(&sha, &resume->sha);
+    memcpy(progress->sha_total, sha.total, sizeof(progress->sha_total));
+    memcpy(progress->sha_state, sha.state, sizeof(progress->sha_state));
+    mbedtls_sha256_free(&sha);
+    progress->written = resume->written;
+
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Couldn't save the OTA progress, is NVS initialized?");
+        return;
+    }
+    if (nvs_set_blob(nvs, OTA_PROGRESS_KEY, progress, sizeof(*progress)) != ESP_OK || nvs_commit(nvs) != ESP_OK) {
+        ESP_LOGW(TAG, "Couldn't save the OTA progress");
+    } else {
+        ESP_LOGD(TAG, "OTA progress saved at %u bytes", progress->written);
+    }
+    nvs_close(nvs);
+}
+
+static void _progress_clear(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(OTA_PROGRESS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_erase_key(nvs, OTA_PROGRESS_KEY) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+/* Goes on with the hash of the data written before the checkpoint */
+static void _sha256_restore(mbedtls_sha256_context *sha, const ota_progress_t *progress)
+{
+    mbedtls_sha256_starts_ret(sha, 0);
+    memcpy(sha->total, progress->sha_total, sizeof(sha->total));
+    memcpy(sha->state, progress->sha_state, sizeof(sha->state));
+#if defined(MBEDTLS_SHA256_ALT) && CONFIG_IDF_TARGET_ESP32
+    /* The SHA engine can't be loaded with a digest state, the rest is hashed in software */
+    sha->mode = ESP_MBEDTLS_SHA256_SOFTWARE;
+#elif defined(MBEDTLS_SHA256_ALT) && CONFIG_IDF_TARGET_ESP32S2
+    sha->sha_state = ESP_SHA256_STATE_IN_PROCESS;
+#endif
+}
+
+/* Takes the ETag and Content-Range of the response, before passing the events on to the application */
+static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)evt->user_data;
+    ota_resume_t *resume = handle->resume;
+
+    if (evt->event_id == HTTP_EVENT_HEADERS_SENT) {
+        resume->response_etag[0] = '\0';
+        resume->range_start = -1;
+        resume->range_total = -1;
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && evt->header_value) {
+        if (strcasecmp(evt->header_key, "ETag") == 0) {
+            if (strlen(evt->header_value) < sizeof(resume->response_etag)) {
+                strcpy(resume->response_etag, evt->header_value);
+            }
+        } else if (strcasecmp(evt->header_key, "Content-Range") == 0) {
+            int start, end, total;
+            if (sscanf(evt->header_value, "bytes %d-%d/%d", &start, &end, &total) == 3) {
+                resume->range_start = start;
+                resume->range_total = total;
+            }
+        }
+    }
+    if (resume->event_handler == NULL) {
+        return ESP_OK;
+    }
+    evt->user_data = resume->user_data;
+    return resume->event_handler(evt);
+}
+
+static esp_err_t _resume_create(esp_https_ota_t *handle, const esp_http_client_config_t *http_config)
+{
+    ota_resume_t *resume = calloc(1, sizeof(ota_resume_t));
+    if (!resume) {
+        return ESP_ERR_NO_MEM;
+    }
+    resume->event_handler = http_config->event_handler;
+    resume->user_data = http_config->user_data;
+    resume->progress.url_hash = _url_hash(http_config);
+    resume->range_start = -1;
+    resume->range_total = -1;
+    mbedtls_sha256_init(&resume->sha);
+    mbedtls_sha256_starts_ret(&resume->sha, 0);
+    handle->resume = resume;
+    return ESP_OK;
+}
+
+static void _resume_destroy(ota_resume_t *resume)
+{
+    mbedtls_sha256_free(&resume->sha);
+    free(resume);
+}
+
+/* Asks for the rest of the image if an earlier update of it was interrupted */
+static esp_err_t _resume_request(esp_https_ota_t *handle)
+{
+    ota_resume_t *resume = handle->resume;
+    if (!_progress_load(handle)) {
+        return ESP_OK;
+    }
+    char range[32];
+    snprintf(range, sizeof(range), "bytes=%u-", resume->progress.written);
+    esp_err_t err = esp_http_client_set_header(handle->http_client, "Range", range);
+    if (err == ESP_OK) {
+        /* The server sends the whole image if it changed */
+        err = esp_http_client_set_header(handle->http_client, "If-Range", resume->progress.etag);
+    }
+    resume->resuming = (err == ESP_OK);
+    return err;
+}
+
+/* Checks that the response goes on from the checkpoint, else gets the whole image */
+static esp_err_t _resume_check_response(esp_https_ota_t *handle)
+{
+    ota_resume_t *resume = handle->resume;
+    ota_progress_t *progress = &resume->progress;
+    esp_http_client_handle_t client = handle->http_client;
+    int status_code = esp_http_client_get_status_code(client);
+
+    if (resume->resuming) {
+        if (status_code == HttpStatus_PartialContent && resume->range_start == (int)progress->written &&
+                resume->range_total == (int)progress->image_len && strcmp(resume->response_etag, progress->etag) == 0) {
+            ESP_LOGI(TAG, "Resuming OTA at %u of %u bytes", progress->written, progress->image_len);
+            _sha256_restore(&resume->sha, progress);
+            resume->written = progress->written;
+            resume->next_checkpoint = progress->written + OTA_CHECKPOINT_INTERVAL;
+            resume->checkpoints = true;
+            return ESP_OK;
+        }
+        resume->resuming = false;
+        esp_http_client_delete_header(client, "Range");
+        esp_http_client_delete_header(client, "If-Range");
+        if (status_code != HttpStatus_Ok) {
+            ESP_LOGW(TAG, "OTA can't be resumed (status %d), downloading the whole image", status_code);
+            esp_http_client_close(client);
+            esp_err_t err = _http_connect(client);
+            if (err != ESP_OK) {
+                return err;
+            }
+            status_code = esp_http_client_get_status_code(client);
+        }
+    }
+
+    /* A new download, the image is checked by its strong ETag and its length when resumed */
+    int image_len = esp_http_client_get_content_length(client);
+    if (status_code != HttpStatus_Ok || image_len <= 0 || resume->response_etag[0] == '\0' ||
+            strncmp(resume->response_etag, "W/", 2) == 0) {
+        ESP_LOGI(TAG, "OTA won't be resumable, no ETag or Content-Length");
+        return ESP_OK;
+    }
+    progress->version = OTA_PROGRESS_VERSION;
+    progress->partition_address = handle->update_partition->address;
+    progress->image_len = image_len;
+    progress->written = 0;
+    strcpy(progress->etag, resume->response_etag);
+    resume->next_checkpoint = OTA_CHECKPOINT_INTERVAL;
+    resume->checkpoints = true;
+    return ESP_OK;
+}
+#endif
+
+/* Writes the next part of the image, from the task downloading it or from the writer task */
+static esp_err_t _ota_flash_write(esp_https_ota_t *handle, const char *data, size_t len)
+{
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    ota_resume_t *resume = handle->resume;
+    if (resume) {
+        while (len > 0) {
+            /* Writes are split at checkpoints, so that the progress is saved on sector boundaries */
+            size_t chunk = len;
+            if (resume->checkpoints && resume->next_checkpoint - resume->written < chunk) {
+                chunk = resume->next_checkpoint - resume->written;
+            }
+            mbedtls_sha256_update_ret(&resume->sha, (const unsigned char *)data, chunk);
+            esp_err_t err = esp_ota_write(handle->update_handle, data, chunk);
+            if (err != ESP_OK) {
+                return err;
+            }
+            resume->written += chunk;
+            data += chunk;
+            len -= chunk;
+            if (resume->checkpoints && resume->written == resume->next_checkpoint) {
+                if (resume->written < resume->progress.image_len) {
+                    _progress_save(resume);
+                }
+                resume->next_checkpoint += OTA_CHECKPOINT_INTERVAL;
+            }
+        }
+        return ESP_OK;
+    }
+#endif
+    return esp_ota_write(handle->update_handle, data, len);
+}
+
+/* Starts writing the update partition, or goes on from the checkpoint */
+static esp_err_t _ota_begin(esp_https_ota_t *handle)
+{
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    ota_resume_t *resume = handle->resume;
+    if (resume && resume->resuming) {
+        esp_err_t err = esp_ota_resume(handle->update_partition, resume->progress.image_len,
+                                       resume->written, &handle->update_handle);
+        if (err == ESP_OK) {
+            handle->binary_file_len = resume->written;
+        }
+        return err;
+    }
+    if (resume) {
+        /* The partition is erased, an earlier update can't be resumed anymore */
+        _progress_clear();
+    }
+#endif
+    return esp_ota_begin(handle->update_partition, OTA_SIZE_UNKNOWN, &handle->update_handle);
+}
+
 static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffer, size_t buf_len)
 {
     if (buffer == NULL || https_ota_handle == NULL) {
         return ESP_FAIL;
     }
-    esp_err_t err = esp_ota_write(https_ota_handle->update_handle, buffer, buf_len);
+    esp_err_t err = _ota_flash_write(https_ota_handle, buffer, buf_len);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%d", err);
     } else {
@@ -132,6 +475,154 @@ static esp_err_t _ota_write(esp_https_ota_t *https_ota_handle, const void *buffe
     return err;
 }
 
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+static void _pipeline_destroy(ota_pipeline_t *pipeline)
+{
+    /* bufs[0] belongs to the handle */
+    for (int i = 1; i < OTA_PIPELINE_BUFFERS; i++) {
+        free(pipeline->bufs[i]);
+    }
+    if (pipeline->free_queue) {
+        vQueueDelete(pipeline->free_queue);
+    }
+    if (pipeline->write_queue) {
+        vQueueDelete(pipeline->write_queue);
+    }
+    if (pipeline->writer_done) {
+        vSemaphoreDelete(pipeline->writer_done);
+    }
+    free(pipeline);
+}
+
+static esp_err_t _pipeline_create(esp_https_ota_t *handle)
+{
+    ota_pipeline_t *pipeline = calloc(1, sizeof(ota_pipeline_t));
+    if (!pipeline) {
+        return ESP_ERR_NO_MEM;
+    }
+    pipeline->bufs[0] = handle->ota_upgrade_buf;
+    for (int i = 1; i < OTA_PIPELINE_BUFFERS; i++) {
+        pipeline->bufs[i] = malloc(handle->ota_upgrade_buf_size);
+        if (!pipeline->bufs[i]) {
+            goto failure;
+        }
+    }
+    pipeline->free_queue = xQueueCreate(OTA_PIPELINE_BUFFERS, sizeof(char *));
+    /* One more entry for the request stopping the writer, so that it never blocks */
+    pipeline->write_queue = xQueueCreate(OTA_PIPELINE_BUFFERS + 1, sizeof(ota_write_req_t));
+    pipeline->writer_done = xSemaphoreCreateBinary();
+    if (!pipeline->free_queue || !pipeline->write_queue || !pipeline->writer_done) {
+        goto failure;
+    }
+    pipeline->write_err = ESP_OK;
+    handle->pipeline = pipeline;
+    return ESP_OK;
+
+failure:
+    _pipeline_destroy(pipeline);
+    return ESP_ERR_NO_MEM;
+}
+
+static void _pipeline_writer_task(void *arg)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)arg;
+    ota_pipeline_t *pipeline = handle->pipeline;
+    ota_write_req_t req;
+
+    while (xQueueReceive(pipeline->write_queue, &req, portMAX_DELAY) == pdTRUE && req.data) {
+        if (pipeline->write_err == ESP_OK) {
+            esp_err_t err = _ota_flash_write(handle, req.data, req.len);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Error: esp_ota_write failed! err=0x%d", err);
+                pipeline->write_err = err;
+            }
+        }
+        /* The error is set before the buffer is handed back, so that the download sees it */
+        xQueueSend(pipeline->free_queue, &req.data, portMAX_DELAY);
+    }
+    xSemaphoreGive(pipeline->writer_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t _pipeline_start(esp_https_ota_t *handle, int header_len)
+{
+    ota_pipeline_t *pipeline = handle->pipeline;
+    if (xTaskCreate(_pipeline_writer_task, "ota_writer", CONFIG_ESP_HTTPS_OTA_WRITER_TASK_STACK_SIZE,
+                    handle, CONFIG_ESP_HTTPS_OTA_WRITER_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Couldn't create the OTA writer task");
+        return ESP_ERR_NO_MEM;
+    }
+    pipeline->writer_running = true;
+    int first_free = 0;
+    /* Image header read by esp_https_ota_get_img_desc() */
+    if (header_len) {
+        ota_write_req_t req = { .data = pipeline->bufs[0], .len = header_len };
+        xQueueSend(pipeline->write_queue, &req, portMAX_DELAY);
+        handle->binary_file_len += header_len;
+        first_free = 1;
+    }
+    for (int i = first_free; i < OTA_PIPELINE_BUFFERS; i++) {
+        xQueueSend(pipeline->free_queue, &pipeline->bufs[i], portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+/* Waits for the downloaded buffers to be written and the writer to exit */
+static esp_err_t _pipeline_stop(esp_https_ota_t *handle)
+{
+    ota_pipeline_t *pipeline = handle->pipeline;
+    if (pipeline->writer_running) {
+        ota_write_req_t req = { .data = NULL, .len = 0 };
+        xQueueSend(pipeline->write_queue, &req, portMAX_DELAY);
+        xSemaphoreTake(pipeline->writer_done, portMAX_DELAY);
+        pipeline->writer_running = false;
+    }
+    return pipeline->write_err;
+}
+#endif
+
+/* Buffer to download the next part of the image into */
+static esp_err_t _ota_buf_get(esp_https_ota_t *handle, char **buf)
+{
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    ota_pipeline_t *pipeline = handle->pipeline;
+    if (pipeline) {
+        /* Blocks while all the buffers wait to be written */
+        xQueueReceive(pipeline->free_queue, buf, portMAX_DELAY);
+        if (pipeline->write_err != ESP_OK) {
+            xQueueSend(pipeline->free_queue, buf, portMAX_DELAY);
+            return pipeline->write_err;
+        }
+        return ESP_OK;
+    }
+#endif
+    *buf = handle->ota_upgrade_buf;
+    return ESP_OK;
+}
+
+/* Gives back a buffer which got no data */
+static void _ota_buf_put(esp_https_ota_t *handle, char *buf)
+{
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    if (handle->pipeline) {
+        xQueueSend(handle->pipeline->free_queue, &buf, portMAX_DELAY);
+    }
+#endif
+}
+
+static esp_err_t _ota_buf_write(esp_https_ota_t *handle, char *buf, int len)
+{
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    if (handle->pipeline) {
+        ota_write_req_t req = { .data = buf, .len = len };
+        xQueueSend(handle->pipeline->write_queue, &req, portMAX_DELAY);
+        handle->binary_file_len += len;
+        return ESP_ERR_HTTPS_OTA_IN_PROGRESS;
+    }
+#endif
+    return _ota_write(handle, (const void *)buf, len);
+}
+
 esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_handle_t *handle)
 {
     esp_err_t err;
@@ -158,29 +649,61 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
         *handle = NULL;
         return ESP_ERR_NO_MEM;
     }
-    
+
+    /* Looked up first, the saved progress of a resumed update is for this partition */
+    https_ota_handle->update_partition = esp_ota_get_next_update_partition(NULL);
+    if (https_ota_handle->update_partition == NULL) {
+        ESP_LOGE(TAG, "Passive OTA partition not found");
+        err = ESP_FAIL;
+        goto failure;
+    }
+
+    const esp_http_client_config_t *http_config = ota_config->http_config;
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    esp_http_client_config_t resume_http_config;
+    if (!ota_config->disable_resume) {
+        err = _resume_create(https_ota_handle, http_config);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't allocate memory to resume the OTA");
+            goto failure;
+        }
+        /* The response headers are only given to the event handler */
+        resume_http_config = *http_config;
+        resume_http_config.event_handler = _http_event_handler;
+        resume_http_config.user_data = https_ota_handle;
+        http_config = &resume_http_config;
+    }
+#endif
+
     /* Initiate HTTP Connection */
-    https_ota_handle->http_client = esp_http_client_init(ota_config->http_config);
+    https_ota_handle->http_client = esp_http_client_init(http_config);
     if (https_ota_handle->http_client == NULL) {
         ESP_LOGE(TAG, "Failed to initialise HTTP connection");
         err = ESP_FAIL;
         goto failure;
     }
 
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    if (https_ota_handle->resume) {
+        err = _resume_request(https_ota_handle);
+        if (err != ESP_OK) {
+            goto http_cleanup;
+        }
+    }
+#endif
+
     err = _http_connect(https_ota_handle->http_client);
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    if (err == ESP_OK && https_ota_handle->resume) {
+        err = _resume_check_response(https_ota_handle);
+    }
+#endif
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to establish HTTP connection");
         goto http_cleanup;
     }
 
-    https_ota_handle->update_partition = NULL;
     ESP_LOGI(TAG, "Starting OTA...");
-    https_ota_handle->update_partition = esp_ota_get_next_update_partition(NULL);
-    if (https_ota_handle->update_partition == NULL) {
-        ESP_LOGE(TAG, "Passive OTA partition not found");
-        err = ESP_FAIL;
-        goto http_cleanup;
-    }
     ESP_LOGI(TAG, "Writing to partition subtype %d at offset 0x%x",
         https_ota_handle->update_partition->subtype, https_ota_handle->update_partition->address);
 
@@ -194,6 +717,17 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
     }
     https_ota_handle->ota_upgrade_buf_size = alloc_size;
 
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    if (!ota_config->disable_pipeline) {
+        err = _pipeline_create(https_ota_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Couldn't allocate memory to the OTA pipeline");
+            free(https_ota_handle->ota_upgrade_buf);
+            goto http_cleanup;
+        }
+    }
+#endif
+
     https_ota_handle->binary_file_len = 0;
     *handle = (esp_https_ota_handle_t)https_ota_handle;
     https_ota_handle->state = ESP_HTTPS_OTA_BEGIN;
@@ -202,6 +736,11 @@ esp_err_t esp_https_ota_begin(esp_https_ota_config_t *ota_config, esp_https_ota_
 http_cleanup:
     _http_cleanup(https_ota_handle->http_client);
 failure:
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    if (https_ota_handle->resume) {
+        _resume_destroy(https_ota_handle->resume);
+    }
+#endif
     free(https_ota_handle);
     *handle = NULL;
     return err;
@@ -218,6 +757,17 @@ esp_err_t esp_https_ota_get_img_desc(esp_https_ota_handle_t https_ota_handle, es
         ESP_LOGE(TAG, "esp_https_ota_read_img_desc: Invalid state");
         return ESP_FAIL;
     }
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    if (handle->resume && handle->resume->resuming) {
+        /* The image header was written before the checkpoint */
+        if (esp_partition_read(handle->update_partition, sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t),
+                               new_app_info, sizeof(esp_app_desc_t)) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read image descriptor from flash");
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+#endif
     /*
      * `data_read_size` holds number of bytes needed to read complete header.
      * `bytes_read` holds number of bytes read.
@@ -265,26 +815,46 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
     }
 
     esp_err_t err;
-    int data_read;
+    int data_read, header_len;
+    char *buf;
     switch (handle->state) {
         case ESP_HTTPS_OTA_BEGIN:
-            err = esp_ota_begin(handle->update_partition, OTA_SIZE_UNKNOWN, &handle->update_handle);
+            /* Image data read by `esp_https_ota_read_img_desc`, counted again once written */
+            header_len = handle->binary_file_len;
+            handle->binary_file_len = 0;
+            err = _ota_begin(handle);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "esp_ota_begin failed (%s)", esp_err_to_name(err));
+                handle->binary_file_len = header_len;
                 return err;
             }
             handle->state = ESP_HTTPS_OTA_IN_PROGRESS;
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+            if (handle->pipeline) {
+                /* Queues the image data read by `esp_https_ota_read_img_desc`, if any */
+                err = _pipeline_start(handle, header_len);
+                if (err != ESP_OK) {
+                    return err;
+                }
+                return ESP_ERR_HTTPS_OTA_IN_PROGRESS;
+            }
+#endif
             /* In case `esp_https_ota_read_img_desc` was invoked first,
                then the image data read there should be written to OTA partition
                */
-            if (handle->binary_file_len) {
-                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, handle->binary_file_len);
+            if (header_len) {
+                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, header_len);
             }
             /* falls through */
         case ESP_HTTPS_OTA_IN_PROGRESS:
-            data_read = esp_http_client_read(handle->http_client,
-                                             handle->ota_upgrade_buf,
-                                             handle->ota_upgrade_buf_size);
+            err = _ota_buf_get(handle, &buf);
+            if (err != ESP_OK) {
+                return err;
+            }
+            data_read = esp_http_client_read(handle->http_client, buf, handle->ota_upgrade_buf_size);
+            if (data_read <= 0) {
+                _ota_buf_put(handle, buf);
+            }
             if (data_read == 0) {
                 /*
                  *  esp_https_ota_is_complete_data_received is added to check whether
@@ -306,10 +876,25 @@ esp_err_t esp_https_ota_perform(esp_https_ota_handle_t https_ota_handle)
                 }
                 ESP_LOGI(TAG, "Connection closed");
             } else if (data_read > 0) {
-                return _ota_write(handle, (const void *)handle->ota_upgrade_buf, data_read);
+                return _ota_buf_write(handle, buf, data_read);
             } else {
                 return ESP_FAIL;
             }
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+            if (handle->pipeline) {
+                err = _pipeline_stop(handle);
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+#endif
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+            if (handle->resume) {
+                /* Also gives the SHA engine back before the image is verified */
+                mbedtls_sha256_finish_ret(&handle->resume->sha, handle->resume->sha256);
+                mbedtls_sha256_free(&handle->resume->sha);
+            }
+#endif
             handle->state = ESP_HTTPS_OTA_SUCCESS;
             break;
          default:
@@ -337,10 +922,23 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
     }
 
     esp_err_t err = ESP_OK;
+#if CONFIG_ESP_HTTPS_OTA_PIPELINE
+    if (handle->pipeline) {
+        /* Buffers still queued are written before the update is ended */
+        _pipeline_stop(handle);
+        _pipeline_destroy(handle->pipeline);
+    }
+#endif
     switch (handle->state) {
         case ESP_HTTPS_OTA_SUCCESS:
         case ESP_HTTPS_OTA_IN_PROGRESS:
             err = esp_ota_end(handle->update_handle);
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+            if (handle->resume && handle->state == ESP_HTTPS_OTA_SUCCESS) {
+                /* Updated, or the image is invalid and resuming it is of no use */
+                _progress_clear();
+            }
+#endif
             /* falls through */
         case ESP_HTTPS_OTA_BEGIN:
             if (handle->ota_upgrade_buf) {
@@ -354,6 +952,12 @@ esp_err_t esp_https_ota_finish(esp_https_ota_handle_t https_ota_handle)
             ESP_LOGE(TAG, "Invalid ESP HTTPS OTA State");
             break;
     }
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    /* After the HTTP client, which may call _http_event_handler() until then */
+    if (handle->resume) {
+        _resume_destroy(handle->resume);
+    }
+#endif
 
     if ((err == ESP_OK) && (handle->state == ESP_HTTPS_OTA_SUCCESS)) {
         esp_err_t err = esp_ota_set_boot_partition(handle->update_partition);
@@ -377,6 +981,26 @@ int esp_https_ota_get_image_len_read(esp_https_ota_handle_t https_ota_handle)
     return handle->binary_file_len;
 }
 
+esp_err_t esp_https_ota_get_img_sha256(esp_https_ota_handle_t https_ota_handle, uint8_t *sha256)
+{
+    esp_https_ota_t *handle = (esp_https_ota_t *)https_ota_handle;
+    if (handle == NULL || sha256 == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if CONFIG_ESP_HTTPS_OTA_RESUME
+    if (handle->resume == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (handle->state != ESP_HTTPS_OTA_SUCCESS) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memcpy(sha256, handle->resume->sha256, sizeof(handle->resume->sha256));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 esp_err_t esp_https_ota(const esp_http_client_config_t *config)
 {
     if (!config) {
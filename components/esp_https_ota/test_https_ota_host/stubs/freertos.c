@@ -0,0 +1,112 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+typedef struct {
+    TaskFunction_t code;
+    void *arg;
+} task_start_t;
+
+static void *task_main(void *arg)
+{
+    task_start_t start = *(task_start_t *)arg;
+    free(arg);
+    start.code(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask)
+{
+    pthread_t thread;
+    task_start_t *start = malloc(sizeof(task_start_t));
+    start->code = pvTaskCode;
+    start->arg = pvParameters;
+    if (pthread_create(&thread, NULL, task_main, start) != 0) {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (pxCreatedTask) {
+        *pxCreatedTask = (TaskHandle_t)thread;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL) {
+        pthread_exit(NULL);
+    }
+    abort();
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize)
+{
+    QueueHandle_t q = calloc(1, sizeof(struct QueueDefinition));
+    q->items = calloc(uxQueueLength, uxItemSize ? uxItemSize : 1);
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->changed);
+    free(q->items);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (xTicksToWait == 0) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+        pthread_cond_wait(&q->changed, &q->lock);
+    }
+    if (q->item_size) {
+        memcpy(q->items + ((q->head + q->count) % q->length) * q->item_size, pvItemToQueue, q->item_size);
+    }
+    q->count++;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *pvBuffer, TickType_t xTicksToWait)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (xTicksToWait == 0) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+        pthread_cond_wait(&q->changed, &q->lock);
+    }
+    if (q->item_size) {
+        memcpy(pvBuffer, q->items + q->head * q->item_size, q->item_size);
+    }
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
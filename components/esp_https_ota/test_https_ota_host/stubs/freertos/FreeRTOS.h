@@ -0,0 +1,15 @@
+#pragma once
+
+/* FreeRTOS on pthreads, what the writer task of the OTA pipeline needs */
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define portMAX_DELAY   ((TickType_t) 0xffffffff)
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/* As in FreeRTOS, a semaphore is a queue of items of size 0 */
+#define xSemaphoreCreateBinary()                    xQueueCreate(1, 0)
+#define vSemaphoreDelete( xSemaphore )              vQueueDelete(xSemaphore)
+#define xSemaphoreGive( xSemaphore )                xQueueSend((xSemaphore), NULL, 0)
+#define xSemaphoreTake( xSemaphore, xBlockTime )    xQueueReceive((xSemaphore), NULL, (xBlockTime))
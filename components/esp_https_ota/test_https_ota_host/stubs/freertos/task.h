@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+/* Tasks are detached threads, priority and stack size are ignored */
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                       void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+
+/* Only deleting the calling task is supported */
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+
+#if defined(__cplusplus)
+}
+#endif
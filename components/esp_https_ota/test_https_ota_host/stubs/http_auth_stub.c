@@ -0,0 +1,14 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "http_auth.h"
+
+/* The test server does not ask for authentication */
+char *http_auth_digest(const char *username, const char *password, esp_http_auth_data_t *auth_data)
+{
+    return NULL;
+}
+
+char *http_auth_basic(const char *username, const char *password)
+{
+    return NULL;
+}
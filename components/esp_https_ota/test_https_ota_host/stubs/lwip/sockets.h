@@ -0,0 +1,11 @@
+#pragma once
+
+/* The TCP transport runs on the sockets of the host */
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
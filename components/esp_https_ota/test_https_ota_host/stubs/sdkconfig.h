@@ -0,0 +1,10 @@
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32                         1
+#define CONFIG_OTA_ALLOW_HTTP                           1
+#define CONFIG_ESP_HTTPS_OTA_PIPELINE                   1
+#define CONFIG_ESP_HTTPS_OTA_PIPELINE_BUFFERS           3
+#define CONFIG_ESP_HTTPS_OTA_WRITER_TASK_STACK_SIZE     3072
+#define CONFIG_ESP_HTTPS_OTA_WRITER_TASK_PRIORITY       5
+#define CONFIG_ESP_HTTPS_OTA_RESUME                     1
+#define CONFIG_ESP_HTTPS_OTA_RESUME_CHECKPOINT_INTERVAL 16
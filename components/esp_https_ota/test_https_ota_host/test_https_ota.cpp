@@ -0,0 +1,639 @@
+#include "catch.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "esp_https_ota.h"
+#include "esp_ota_ops.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+/* Flash of the update partition, with the page program time of the spi_flash simulator */
+const int PAGE_SIZE = 256;
+const int PAGE_PROGRAM_US = 600;
+
+const int TCP_WND = 4 * 1436;
+
+struct fake_flash {
+    std::mutex lock;
+    bytes data;
+    bool begun = false;
+    bool ended = false;
+    bool boot_set = false;
+    size_t resumed_at = 0;          /* Offset given to esp_ota_resume(), 0 if begun */
+    size_t fail_after = SIZE_MAX;   /* Writes fail from this offset on */
+    std::atomic<bool> writing{false};
+    /* Catch assertions are not thread safe, writes may come from the writer task */
+    std::atomic<int> bad_writes{0};
+} flash;
+
+const esp_partition_t update_partition = {};
+
+/* Blobs by key, the writer task saves the progress while the test waits for the update */
+struct fake_nvs {
+    std::mutex lock;
+    std::map<std::string, bytes> blobs;
+    int saves = 0;
+} nvs;
+
+} // namespace
+
+extern "C" const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &update_partition;
+}
+
+extern "C" esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    std::lock_guard<std::mutex> guard(flash.lock);
+    CHECK(!flash.begun);
+    flash.begun = true;
+    flash.resumed_at = 0;
+    flash.data.clear();
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t image_size, size_t image_offset,
+                                    esp_ota_handle_t *out_handle)
+{
+    std::lock_guard<std::mutex> guard(flash.lock);
+    CHECK(!flash.begun);
+    /* The data before the offset was written by the interrupted update */
+    CHECK(image_offset % 4096 == 0);
+    CHECK(image_offset > 0);
+    CHECK(image_offset <= flash.data.size());
+    CHECK(image_offset < image_size);
+    flash.begun = true;
+    flash.resumed_at = image_offset;
+    flash.data.resize(image_offset);
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    std::lock_guard<std::mutex> guard(flash.lock);
+    if (partition != &update_partition || src_offset + size > flash.data.size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, flash.data.data() + src_offset, size);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (handle != 1 || flash.writing.exchange(true)) {
+        flash.bad_writes++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(flash.lock);
+        if (!flash.begun || flash.ended) {
+            flash.bad_writes++;
+        }
+        if (flash.data.size() + size > flash.fail_after) {
+            flash.writing = false;
+            return ESP_ERR_FLASH_OP_FAIL;
+        }
+        flash.data.insert(flash.data.end(), (const uint8_t *)data, (const uint8_t *)data + size);
+    }
+    usleep((size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_PROGRAM_US);
+    flash.writing = false;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> guard(flash.lock);
+    CHECK(handle == 1);
+    CHECK(!flash.writing);
+    flash.ended = true;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    CHECK(partition == &update_partition);
+    flash.boot_set = true;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (std::string(name) != "esp_https_ota") {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    std::lock_guard<std::mutex> guard(nvs.lock);
+    auto it = nvs.blobs.find(key);
+    if (it == nvs.blobs.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out_value == NULL) {
+        *length = it->second.size();
+        return ESP_OK;
+    }
+    if (*length < it->second.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, it->second.data(), it->second.size());
+    *length = it->second.size();
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    std::lock_guard<std::mutex> guard(nvs.lock);
+    nvs.blobs[key] = bytes((const uint8_t *)value, (const uint8_t *)value + length);
+    nvs.saves++;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    std::lock_guard<std::mutex> guard(nvs.lock);
+    return nvs.blobs.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+extern "C" esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+extern "C" void nvs_close(nvs_handle_t handle)
+{
+}
+
+/* The client socket, the window of lwIP is a few segments (TCP_WND) where the
+   host buffers megabytes, which would hide the stalls of the download */
+extern "C" int test_socket(int domain, int type, int protocol)
+{
+    int sock = socket(domain, type, protocol);
+    int size = TCP_WND;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    return sock;
+}
+
+namespace {
+
+/* Serves an image over HTTP, paced like a network of limited bandwidth, with
+   the Range requests of a static file server */
+struct image_server {
+    bytes image;
+    size_t segment = 1460;
+    int segment_us = 0;
+    int sock;
+    int port;
+    std::thread thread;
+
+    /* Changed by the tests between updates */
+    std::mutex lock;
+    std::string etag;               /* Not sent if empty */
+    bool ignore_if_range = false;   /* Sends the range even if the image changed */
+    size_t drop_after = SIZE_MAX;   /* The next response is reset after this much of the image */
+    std::vector<std::string> requests;
+    size_t body_sent = 0;
+
+    explicit image_server(const bytes &image) : image(image)
+    {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(sock >= 0);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        REQUIRE(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        socklen_t len = sizeof(addr);
+        REQUIRE(getsockname(sock, (struct sockaddr *)&addr, &len) == 0);
+        port = ntohs(addr.sin_port);
+        REQUIRE(listen(sock, 4) == 0);
+        thread = std::thread([this] { serve(); });
+    }
+
+    ~image_server()
+    {
+        shutdown(sock, SHUT_RDWR);
+        thread.join();
+        close(sock);
+    }
+
+    std::string url() const
+    {
+        return "http://127.0.0.1:" + std::to_string(port) + "/image.bin";
+    }
+
+    void set_image(const bytes &new_image, const std::string &new_etag)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        image = new_image;
+        etag = new_etag;
+    }
+
+    static std::string header_value(const std::string &request, const std::string &key)
+    {
+        size_t pos = request.find("\r\n" + key + ": ");
+        if (pos == std::string::npos) {
+            return "";
+        }
+        pos += key.size() + 4;
+        return request.substr(pos, request.find("\r\n", pos) - pos);
+    }
+
+    void serve()
+    {
+        int conn;
+        while ((conn = accept(sock, NULL, NULL)) >= 0) {
+            /* Data the client does not read stays in its window instead of queuing up here */
+            int size = segment;
+            setsockopt(conn, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+            std::string request;
+            char buf[512];
+            ssize_t len;
+            while (request.find("\r\n\r\n") == std::string::npos && (len = recv(conn, buf, sizeof(buf), 0)) > 0) {
+                request.append(buf, len);
+            }
+
+            std::unique_lock<std::mutex> guard(lock);
+            requests.push_back(request);
+            bytes body = image;
+            size_t drop = drop_after;
+            drop_after = SIZE_MAX;
+            std::string header = "HTTP/1.1 200 OK\r\n";
+            std::string range = header_value(request, "Range");
+            std::string if_range = header_value(request, "If-Range");
+            size_t start;
+            if (sscanf(range.c_str(), "bytes=%zu-", &start) == 1 && start < image.size() &&
+                    (if_range.empty() || if_range == etag || ignore_if_range)) {
+                header = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(start) + "-" +
+                         std::to_string(image.size() - 1) + "/" + std::to_string(image.size()) + "\r\n";
+                body.erase(body.begin(), body.begin() + start);
+            }
+            if (!etag.empty()) {
+                header += "ETag: " + etag + "\r\n";
+            }
+            guard.unlock();
+
+            header += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+            send(conn, header.data(), header.size(), MSG_NOSIGNAL);
+            size_t sent = 0;
+            for (size_t pos = 0; pos < body.size() && pos < drop; pos += segment) {
+                if (segment_us) {
+                    usleep(segment_us);
+                }
+                ssize_t ret = send(conn, body.data() + pos, std::min(std::min(segment, body.size() - pos), drop - pos), MSG_NOSIGNAL);
+                if (ret < 0) {
+                    break;
+                }
+                sent += ret;
+            }
+            if (sent < body.size()) {
+                /* The connection drops: reset once the client had time to read what was sent */
+                usleep(50000);
+                struct linger linger = { 1, 0 };
+                setsockopt(conn, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+            }
+            close(conn);
+            guard.lock();
+            body_sent += sent;
+        }
+    }
+
+    std::string last_request()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return requests.empty() ? "" : requests.back();
+    }
+
+    size_t take_body_sent()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t sent = body_sent;
+        body_sent = 0;
+        return sent;
+    }
+};
+
+bytes make_image(size_t size)
+{
+    bytes image(size);
+    uint32_t seed = size;
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        image[i] = seed >> 16;
+    }
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    esp_app_desc_t desc = {};
+    desc.magic_word = ESP_APP_DESC_MAGIC_WORD;
+    strcpy(desc.version, "2.0.1");
+    memcpy(&image[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)], &desc, sizeof(desc));
+    return image;
+}
+
+struct ota_fixture {
+    ota_fixture()
+    {
+        std::lock_guard<std::mutex> guard(flash.lock);
+        flash.data.clear();
+        flash.begun = false;
+        flash.ended = false;
+        flash.boot_set = false;
+        flash.resumed_at = 0;
+        flash.fail_after = SIZE_MAX;
+        flash.bad_writes = 0;
+        std::lock_guard<std::mutex> nvs_guard(nvs.lock);
+        nvs.blobs.clear();
+        nvs.saves = 0;
+    }
+    ~ota_fixture()
+    {
+        CHECK(flash.bad_writes == 0);
+    }
+};
+
+/* The device restarts, flash and NVS are kept */
+void restart()
+{
+    std::lock_guard<std::mutex> guard(flash.lock);
+    flash.begun = false;
+    flash.ended = false;
+    flash.boot_set = false;
+}
+
+bool progress_saved()
+{
+    std::lock_guard<std::mutex> guard(nvs.lock);
+    return nvs.blobs.count("progress") != 0;
+}
+
+bytes sha256(const bytes &data)
+{
+    bytes hash(32);
+    mbedtls_sha256_ret(data.data(), data.size(), hash.data(), 0);
+    return hash;
+}
+
+/* Runs an update with begin/perform/finish, returns the error of perform or finish */
+esp_err_t update(const image_server &server, bool pipeline, int buffer_size = 4096, bool read_desc = true,
+                 bytes *image_sha256 = nullptr)
+{
+    std::string url = server.url();
+    esp_http_client_config_t http_config = {};
+    http_config.url = url.c_str();
+    http_config.buffer_size = buffer_size;
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+    ota_config.disable_pipeline = !pipeline;
+
+    esp_https_ota_handle_t handle = NULL;
+    esp_err_t err = esp_https_ota_begin(&ota_config, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (read_desc) {
+        esp_app_desc_t desc;
+        CHECK(esp_https_ota_get_img_desc(handle, &desc) == ESP_OK);
+        CHECK(std::string(desc.version) == "2.0.1");
+    }
+    while ((err = esp_https_ota_perform(handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+        CHECK(esp_https_ota_get_image_len_read(handle) <= (int)server.image.size());
+    }
+    if (err == ESP_OK) {
+        CHECK(esp_https_ota_get_image_len_read(handle) == (int)server.image.size());
+        if (image_sha256) {
+            image_sha256->resize(32);
+            CHECK(esp_https_ota_get_img_sha256(handle, image_sha256->data()) == ESP_OK);
+        }
+    }
+    esp_err_t finish_err = esp_https_ota_finish(handle);
+    return err != ESP_OK ? err : finish_err;
+}
+
+double elapsed_s(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST_CASE_METHOD(ota_fixture, "image is written with and without the pipeline", "[https_ota]")
+{
+    image_server server(make_image(100000));
+    for (bool pipeline : {true, false}) {
+        for (bool read_desc : {true, false}) {
+            CAPTURE(pipeline);
+            CAPTURE(read_desc);
+            ota_fixture reset;
+            CHECK(update(server, pipeline, 4096, read_desc) == ESP_OK);
+            CHECK(flash.data == server.image);
+            CHECK(flash.ended);
+            CHECK(flash.boot_set);
+        }
+    }
+    /* Buffers smaller than a segment of the server */
+    ota_fixture reset;
+    CHECK(update(server, true, 512) == ESP_OK);
+    CHECK(flash.data == server.image);
+}
+
+TEST_CASE_METHOD(ota_fixture, "failed flash write stops the update", "[https_ota]")
+{
+    image_server server(make_image(200000));
+    for (bool pipeline : {true, false}) {
+        CAPTURE(pipeline);
+        ota_fixture reset;
+        flash.fail_after = 50000;
+        CHECK(update(server, pipeline) == ESP_ERR_FLASH_OP_FAIL);
+        CHECK(flash.data.size() <= 50000);
+        CHECK(flash.ended);
+        CHECK(!flash.boot_set);
+    }
+}
+
+TEST_CASE_METHOD(ota_fixture, "update is aborted midway", "[https_ota]")
+{
+    image_server server(make_image(200000));
+    std::string url = server.url();
+    esp_http_client_config_t http_config = {};
+    http_config.url = url.c_str();
+    http_config.buffer_size = 1024;
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+
+    esp_https_ota_handle_t handle = NULL;
+    REQUIRE(esp_https_ota_begin(&ota_config, &handle) == ESP_OK);
+    for (int i = 0; i < 20; i++) {
+        REQUIRE(esp_https_ota_perform(handle) == ESP_ERR_HTTPS_OTA_IN_PROGRESS);
+    }
+    /* Buffers already downloaded are written before the update is ended */
+    int len_read = esp_https_ota_get_image_len_read(handle);
+    CHECK(esp_https_ota_finish(handle) == ESP_OK);
+    CHECK(flash.data.size() == (size_t)len_read);
+    CHECK(flash.data == bytes(server.image.begin(), server.image.begin() + len_read));
+    CHECK(flash.ended);
+    CHECK(!flash.boot_set);
+}
+
+TEST_CASE_METHOD(ota_fixture, "pipeline overlaps download and flash write", "[https_ota][timing]")
+{
+    /* About 480 KB/s of network and 420 KB/s of flash. Reads of 16 KB are larger
+       than the TCP window: written in turn, the update takes the sum of both,
+       pipelined, the slowest of them */
+    image_server server(make_image(256 * 1024));
+    server.segment_us = 3000;
+    double seconds[2];
+    for (bool pipeline : {false, true}) {
+        ota_fixture reset;
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE(update(server, pipeline, 16384) == ESP_OK);
+        seconds[pipeline] = elapsed_s(start);
+        CHECK(flash.data == server.image);
+        printf("OTA of %zu KB, %s: %.2f s, %.0f KB/s\n", server.image.size() / 1024,
+               pipeline ? "pipelined" : "sequential", seconds[pipeline], server.image.size() / 1024 / seconds[pipeline]);
+    }
+    CHECK(seconds[1] < seconds[0] * 0.8);
+}
+
+TEST_CASE_METHOD(ota_fixture, "interrupted update is resumed from the last checkpoint", "[https_ota][resume]")
+{
+    bytes image = make_image(200000);
+    for (bool pipeline : {true, false}) {
+        for (bool read_desc : {true, false}) {
+            CAPTURE(pipeline);
+            CAPTURE(read_desc);
+            ota_fixture reset;
+            image_server server(image);
+            server.etag = "\"5f3a-30d40\"";
+            server.drop_after = 100000;
+            CHECK(update(server, pipeline, 4096, read_desc) == ESP_FAIL);
+            CHECK(!flash.boot_set);
+            CHECK(progress_saved());
+            server.take_body_sent();
+
+            restart();
+            bytes hash;
+            CHECK(update(server, pipeline, 4096, read_desc, &hash) == ESP_OK);
+            /* Goes on from the last checkpoint, the image header is read back from flash */
+            CHECK(flash.resumed_at > 50000);
+            CHECK(flash.resumed_at <= 100000);
+            CHECK(flash.resumed_at % 16384 == 0);
+            std::string request = server.last_request();
+            CHECK(request.find("Range: bytes=" + std::to_string(flash.resumed_at) + "-\r\n") != std::string::npos);
+            CHECK(request.find("If-Range: \"5f3a-30d40\"\r\n") != std::string::npos);
+            CHECK(server.take_body_sent() == image.size() - flash.resumed_at);
+            CHECK(flash.data == image);
+            CHECK(flash.boot_set);
+            /* The hash of the data before the checkpoint is restored */
+            CHECK(hash == sha256(image));
+            CHECK(!progress_saved());
+        }
+    }
+}
+
+TEST_CASE_METHOD(ota_fixture, "progress is saved at every checkpoint", "[https_ota][resume]")
+{
+    image_server server(make_image(200000));
+    server.etag = "\"1\"";
+    for (bool pipeline : {true, false}) {
+        CAPTURE(pipeline);
+        ota_fixture reset;
+        bytes hash;
+        CHECK(update(server, pipeline, 4096, true, &hash) == ESP_OK);
+        CHECK(hash == sha256(server.image));
+        /* Every 16 KB, up to the end of the image */
+        CHECK(nvs.saves == 200000 / 16384);
+        CHECK(!progress_saved());
+    }
+    /* A failed write keeps the progress before it */
+    ota_fixture reset;
+    flash.fail_after = 60000;
+    CHECK(update(server, true) == ESP_ERR_FLASH_OP_FAIL);
+    CHECK(nvs.saves == 3);
+    CHECK(progress_saved());
+}
+
+TEST_CASE_METHOD(ota_fixture, "changed image is downloaded again", "[https_ota][resume]")
+{
+    bytes image = make_image(200000);
+    bytes new_image = make_image(180000);
+    for (bool ignore_if_range : {false, true}) {
+        CAPTURE(ignore_if_range);
+        ota_fixture reset;
+        image_server server(image);
+        server.etag = "\"v1\"";
+        server.ignore_if_range = ignore_if_range;
+        server.drop_after = 100000;
+        CHECK(update(server, true) == ESP_FAIL);
+        CHECK(progress_saved());
+
+        /* The server sends the new image, or the range of it with the new ETag */
+        restart();
+        server.set_image(new_image, "\"v2\"");
+        bytes hash;
+        CHECK(update(server, true, 4096, true, &hash) == ESP_OK);
+        CHECK(flash.resumed_at == 0);
+        CHECK(flash.data == new_image);
+        CHECK(hash == sha256(new_image));
+        if (ignore_if_range) {
+            /* Asked again for the whole image */
+            CHECK(server.last_request().find("Range:") == std::string::npos);
+        }
+    }
+}
+
+TEST_CASE_METHOD(ota_fixture, "image without ETag is not resumed", "[https_ota][resume]")
+{
+    image_server server(make_image(200000));
+    server.drop_after = 100000;
+    CHECK(update(server, true) == ESP_FAIL);
+    CHECK(nvs.saves == 0);
+
+    restart();
+    bytes hash;
+    CHECK(update(server, true, 4096, true, &hash) == ESP_OK);
+    CHECK(server.last_request().find("Range:") == std::string::npos);
+    CHECK(flash.data == server.image);
+    /* Still hashed */
+    CHECK(hash == sha256(server.image));
+}
+
+TEST_CASE_METHOD(ota_fixture, "resuming is disabled by the configuration", "[https_ota][resume]")
+{
+    image_server server(make_image(100000));
+    server.etag = "\"1\"";
+    std::string url = server.url();
+    esp_http_client_config_t http_config = {};
+    http_config.url = url.c_str();
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+    ota_config.disable_resume = true;
+
+    esp_https_ota_handle_t handle = NULL;
+    REQUIRE(esp_https_ota_begin(&ota_config, &handle) == ESP_OK);
+    esp_err_t err;
+    while ((err = esp_https_ota_perform(handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+    }
+    CHECK(err == ESP_OK);
+    uint8_t hash[32];
+    CHECK(esp_https_ota_get_img_sha256(handle, hash) == ESP_ERR_NOT_SUPPORTED);
+    CHECK(esp_https_ota_finish(handle) == ESP_OK);
+    CHECK(flash.data == server.image);
+    CHECK(nvs.saves == 0);
+}
@@ -3,4 +3,7 @@
 #
 COMPONENT_ADD_INCLUDEDIRS := include
 COMPONENT_PRIV_INCLUDEDIRS := private_include lwip
-COMPONENT_SRCDIRS := . lwip loopback
\ No newline at end of file
+COMPONENT_SRCDIRS := . lwip loopback
+
+# uses C11 atomic feature
+esp_netif_rx_batch.o: CFLAGS += -std=gnu11
@@ -0,0 +1,134 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "esp_netif_rx_batch.h"
+
+//
+// Purpose of this module is to provide the receive ring of an interface
+//  - this module has no dependency on a specific network stack (lwip)
+//
+
+struct esp_netif_rx_batch {
+    _Atomic(void *) *frames;        // the consumer takes a frame by clearing its slot
+    size_t mask;
+    atomic_size_t head;             // next frame to deliver, written by the stack task
+    atomic_size_t tail;             // next free slot, written by the IO driver
+    atomic_bool drain_pending;
+    esp_netif_rx_batch_schedule_fn schedule;
+    esp_netif_rx_batch_frame_fn deliver;
+    void *ctx;
+    // statistics, each counter has a single writer
+    atomic_uint frames_delivered;
+    atomic_uint batches;
+    atomic_uint max_batch;
+    atomic_uint dropped;
+};
+
+esp_netif_rx_batch_t *esp_netif_rx_batch_new(size_t size, esp_netif_rx_batch_schedule_fn schedule,
+                                             esp_netif_rx_batch_frame_fn deliver, void *ctx)
+{
+    size_t capacity = 1;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    esp_netif_rx_batch_t *batch = calloc(1, sizeof(esp_netif_rx_batch_t));
+    if (batch == NULL) {
+        return NULL;
+    }
+    batch->frames = calloc(capacity, sizeof(_Atomic(void *)));
+    if (batch->frames == NULL) {
+        free(batch);
+        return NULL;
+    }
+    batch->mask = capacity - 1;
+    atomic_init(&batch->head, 0);
+    atomic_init(&batch->tail, 0);
+    atomic_init(&batch->drain_pending, false);
+    batch->schedule = schedule;
+    batch->deliver = deliver;
+    batch->ctx = ctx;
+    return batch;
+}
+
+void esp_netif_rx_batch_destroy(esp_netif_rx_batch_t *batch, esp_netif_rx_batch_frame_fn free_frame)
+{
+    if (batch == NULL) {
+        return;
+    }
+    size_t tail = atomic_load(&batch->tail);
+    for (size_t head = atomic_load(&batch->head); head != tail; head++) {
+        free_frame(batch->ctx, atomic_load(&batch->frames[head & batch->mask]));
+    }
+    free(batch->frames);
+    free(batch);
+}
+
+esp_err_t esp_netif_rx_batch_push(esp_netif_rx_batch_t *batch, void *frame)
+{
+    size_t tail = atomic_load_explicit(&batch->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&batch->head, memory_order_acquire) > batch->mask) {
+        atomic_fetch_add_explicit(&batch->dropped, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    atomic_store(&batch->frames[tail & batch->mask], frame);
+    atomic_store(&batch->tail, tail + 1);
+    // Only wake up the stack task if no drain is pending: a pending drain will pick this frame up
+    if (!atomic_exchange(&batch->drain_pending, true) && !batch->schedule(batch->ctx)) {
+        atomic_store(&batch->drain_pending, false);
+        // No drain will pick this frame up, take it back unless a drain which was already running got it
+        if (atomic_exchange(&batch->frames[tail & batch->mask], NULL) == frame) {
+            atomic_store(&batch->tail, tail);
+            atomic_fetch_add_explicit(&batch->dropped, 1, memory_order_relaxed);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+size_t esp_netif_rx_batch_drain(esp_netif_rx_batch_t *batch)
+{
+    // Clear the flag before reading the ring: frames pushed after this point schedule a new drain
+    atomic_store(&batch->drain_pending, false);
+    size_t head = atomic_load_explicit(&batch->head, memory_order_relaxed);
+    size_t tail = atomic_load(&batch->tail);
+    size_t count = 0;
+    for (; head != tail; head++) {
+        void *frame = atomic_exchange(&batch->frames[head & batch->mask], NULL);
+        if (frame == NULL) {
+            // Taken back by esp_netif_rx_batch_push(), it was the last frame
+            break;
+        }
+        atomic_store_explicit(&batch->head, head + 1, memory_order_release);
+        batch->deliver(batch->ctx, frame);
+        count++;
+    }
+    if (count) {
+        atomic_fetch_add_explicit(&batch->frames_delivered, count, memory_order_relaxed);
+        atomic_fetch_add_explicit(&batch->batches, 1, memory_order_relaxed);
+        if (count > atomic_load_explicit(&batch->max_batch, memory_order_relaxed)) {
+            atomic_store_explicit(&batch->max_batch, count, memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
+void esp_netif_rx_batch_get_stats(esp_netif_rx_batch_t *batch, esp_netif_rx_batch_stats_t *stats)
+{
+    stats->frames = atomic_load_explicit(&batch->frames_delivered, memory_order_relaxed);
+    stats->batches = atomic_load_explicit(&batch->batches, memory_order_relaxed);
+    stats->max_batch = atomic_load_explicit(&batch->max_batch, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&batch->dropped, memory_order_relaxed);
+}
@@ -402,6 +402,22 @@ esp_err_t esp_netif_set_old_ip_info(esp_netif_t *esp_netif, const esp_netif_ip_i
  */
 int esp_netif_get_netif_impl_index(esp_netif_t *esp_netif);
 
+/**
+ * @brief  Get statistics of the batched hand-off of received frames to the network stack
+ *
+ * Received frames are queued in a receive ring of the interface and processed in bursts
+ * by the network stack task, see CONFIG_ESP_NETIF_RX_BATCH.
+ *
+ * @param[in]  esp_netif Handle to esp-netif instance
+ * @param[out] stats Statistics of the interface
+ *
+ * @return
+ *         - ESP_OK
+ *         - ESP_ERR_ESP_NETIF_INVALID_PARAMS
+ *         - ESP_ERR_NOT_SUPPORTED if received frames are not batched on this interface
+ */
+esp_err_t esp_netif_get_rx_batch_stats(esp_netif_t *esp_netif, esp_netif_rx_batch_stats_t *stats);
+
 /**
  * @brief  Get net interface name from network stack implementation
  *
@@ -69,6 +69,22 @@ void* esp_netif_get_netif_impl(esp_netif_t *esp_netif);
   */
 esp_err_t esp_netif_transmit(esp_netif_t *esp_netif, void* data, size_t len);
 
+/**
+  * @brief  Outputs a frame made of several fragments to the media to be transmitted
+  *
+  * This function gets called from network stack to output chained packet buffers
+  * without copying them. If the IO driver doesn't support scatter-gather transmit,
+  * the fragments are copied into a single buffer which is passed to esp_netif_transmit().
+  *
+  * @param[in]  esp_netif Handle to esp-netif instance
+  * @param[in]  iov Fragments of the frame, in order
+  * @param[in]  iovcnt Number of fragments, up to ESP_NETIF_IOV_MAX
+  *
+  * @return   ESP_OK on success, ESP_ERR_NO_MEM if the frame couldn't be flattened,
+  *           an error passed from the I/O driver otherwise
+  */
+esp_err_t esp_netif_transmit_sg(esp_netif_t *esp_netif, const esp_netif_iovec_t *iov, size_t iovcnt);
+
 /**
   * @brief  Free the rx buffer allocated by the media driver
   *
@@ -54,6 +54,18 @@ typedef struct {
     esp_ip_addr_t ip; /**< IPV4 address of DNS server */
 } esp_netif_dns_info_t;
 
+/**
+ * @brief  Statistics of the batched hand-off of received frames to the network stack
+ *
+ * The average number of frames processed per wake-up of the network stack task is frames / batches.
+ */
+typedef struct {
+    uint32_t frames;                 /*!< frames passed to the network stack */
+    uint32_t batches;                /*!< wake-ups of the network stack task which processed received frames */
+    uint32_t max_batch;              /*!< largest number of frames processed in one wake-up */
+    uint32_t dropped;                /*!< frames dropped because the receive ring was full */
+} esp_netif_rx_batch_stats_t;
+
 /** @brief Status of DHCP client or DHCP server */
 typedef enum {
     ESP_NETIF_DHCP_INIT = 0,    /**< DHCP client/server is in initial state (not yet started) */
@@ -178,6 +190,19 @@ typedef struct esp_netif_driver_base_s {
     esp_netif_t *netif;
 } esp_netif_driver_base_t;
 
+/**
+ * @brief  Maximum number of fragments of a frame passed to esp_netif_transmit_sg()
+ */
+#define ESP_NETIF_IOV_MAX   8
+
+/**
+ * @brief  Fragment of a scatter-gather frame
+ */
+typedef struct esp_netif_iovec {
+    void *base;                      /*!< pointer to the fragment data */
+    size_t len;                      /*!< length of the fragment in bytes */
+} esp_netif_iovec_t;
+
 /**
  * @brief  Specific IO driver configuration
  */
@@ -185,6 +210,11 @@ struct esp_netif_driver_ifconfig {
     esp_netif_iodriver_handle handle;
     esp_err_t (*transmit)(void *h, void *buffer, size_t len);
     void (*driver_free_rx_buffer)(void *h, void* buffer);
+    /**
+     * Optional scatter-gather transmit, called with the fragments of one frame.
+     * Frames are flattened into a single buffer and passed to transmit() if not set.
+     */
+    esp_err_t (*transmit_sg)(void *h, const esp_netif_iovec_t *iov, size_t iovcnt);
 };
 
 typedef struct esp_netif_driver_ifconfig esp_netif_driver_ifconfig_t;
@@ -12,12 +12,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include "esp_netif_lwip_internal.h"
+#include "lwip/netif.h"
 
 #include "esp_netif.h"
+#include "esp_netif_sta_list.h"
 #include "esp_netif_private.h"
+#include "esp_netif_net_stack.h"
+#include "esp_netif_rx_batch.h"
 
 #if CONFIG_ESP_NETIF_LOOPBACK
 
@@ -36,6 +41,25 @@ static bool s_netif_initialized = false;
 static bool s_netif_started = false;
 static bool s_netif_up = false;
 
+#if ESP_NETIF_LOOPBACK_TESTING
+static size_t s_tx_copies = 0;
+#if CONFIG_ESP_NETIF_RX_BATCH
+static size_t s_rx_drain_requests = 0;
+static bool s_rx_drain_requests_fail = false;
+static bool s_rx_deferred = false;
+#endif
+#endif
+
+#if CONFIG_ESP_NETIF_RX_BATCH
+
+// Received frame waiting in the receive ring
+typedef struct {
+    void *buffer;
+    size_t len;
+    void *eb;
+} loopback_rx_frame_t;
+#endif
+
 /**
  * @brief Main esp-netif container with interface related information
  *
@@ -50,8 +74,14 @@ struct esp_netif_obj {
     // io driver related
     void* driver_handle;
     esp_err_t (*driver_transmit)(void *h, void *buffer, size_t len);
+    esp_err_t (*driver_transmit_sg)(void *h, const esp_netif_iovec_t *iov, size_t iovcnt);
     void (*driver_free_rx_buffer)(void *h, void* buffer);
 
+#if CONFIG_ESP_NETIF_RX_BATCH
+    esp_netif_rx_batch_t *rx_batch;
+    atomic_bool rx_draining;
+#endif
+
     // misc flags, types, keys, priority
     esp_netif_flags_t flags;
     char * hostname;
@@ -154,6 +184,9 @@ static esp_err_t esp_netif_init_configuration(esp_netif_t *esp_netif, const esp_
         if (esp_netif_driver_config->transmit) {
             esp_netif->driver_transmit = esp_netif_driver_config->transmit;
         }
+        if (esp_netif_driver_config->transmit_sg) {
+            esp_netif->driver_transmit_sg = esp_netif_driver_config->transmit_sg;
+        }
         if (esp_netif_driver_config->driver_free_rx_buffer) {
             esp_netif->driver_free_rx_buffer = esp_netif_driver_config->driver_free_rx_buffer;
         }
@@ -161,6 +194,74 @@ static esp_err_t esp_netif_init_configuration(esp_netif_t *esp_netif, const esp_
     return ESP_OK;
 }
 
+#if CONFIG_ESP_NETIF_RX_BATCH
+//
+// Receive ring: loopback has no network stack task, frames queued by esp_netif_receive()
+// are echoed back to the driver right away, on the task of the driver
+//
+static void esp_netif_loopback_rx_free(void *ctx, void *frame)
+{
+    loopback_rx_frame_t *rx_frame = frame;
+    if (rx_frame->eb) {
+        esp_netif_free_rx_buffer(ctx, rx_frame->eb);
+    }
+    free(rx_frame);
+}
+
+static void esp_netif_loopback_rx_deliver(void *ctx, void *frame)
+{
+    loopback_rx_frame_t *rx_frame = frame;
+    esp_netif_transmit(ctx, rx_frame->buffer, rx_frame->len);
+    esp_netif_loopback_rx_free(ctx, frame);
+}
+
+static bool esp_netif_loopback_rx_schedule(void *ctx)
+{
+    esp_netif_t *esp_netif = ctx;
+#if ESP_NETIF_LOOPBACK_TESTING
+    if (s_rx_drain_requests_fail) {
+        return false;
+    }
+    s_rx_drain_requests++;
+    if (s_rx_deferred) {
+        // left to esp_netif_loopback_process_rx()
+        return true;
+    }
+#endif
+    // A driver echoing the frame back calls esp_netif_receive() from the drain,
+    // the frames it pushes are picked up by the running drain rather than a nested one
+    if (atomic_exchange(&esp_netif->rx_draining, true)) {
+        return true;
+    }
+    while (esp_netif_rx_batch_drain(esp_netif->rx_batch) > 0) {
+    }
+    atomic_store(&esp_netif->rx_draining, false);
+    return true;
+}
+
+#if ESP_NETIF_LOOPBACK_TESTING
+size_t esp_netif_loopback_process_rx(esp_netif_t *esp_netif)
+{
+    return esp_netif_rx_batch_drain(esp_netif->rx_batch);
+}
+
+size_t esp_netif_loopback_get_rx_drain_requests(void)
+{
+    return s_rx_drain_requests;
+}
+
+void esp_netif_loopback_set_rx_drain_requests_fail(bool fail)
+{
+    s_rx_drain_requests_fail = fail;
+}
+
+void esp_netif_loopback_set_rx_deferred(bool deferred)
+{
+    s_rx_deferred = deferred;
+}
+#endif
+#endif
+
 esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
 {
     // mandatory configuration must be provided when creating esp_netif object
@@ -191,6 +292,18 @@ esp_netif_t *esp_netif_new(const esp_netif_config_t *esp_netif_config)
     }
     esp_netif->ip_info_old = ip_info;
 
+#if CONFIG_ESP_NETIF_RX_BATCH
+    esp_netif->rx_batch = esp_netif_rx_batch_new(CONFIG_ESP_NETIF_RX_BATCH_SIZE, esp_netif_loopback_rx_schedule,
+                                                 esp_netif_loopback_rx_deliver, esp_netif);
+    if (!esp_netif->rx_batch) {
+        free(esp_netif->ip_info_old);
+        free(esp_netif->ip_info);
+        free(esp_netif);
+        return NULL;
+    }
+    atomic_init(&esp_netif->rx_draining, false);
+#endif
+
     esp_netif_add_to_list(esp_netif);
 
     // Configure the created object with provided configuration
@@ -208,6 +321,9 @@ void esp_netif_destroy(esp_netif_t *esp_netif)
 {
     if (esp_netif) {
         esp_netif_remove_from_list(esp_netif);
+#if CONFIG_ESP_NETIF_RX_BATCH
+        esp_netif_rx_batch_destroy(esp_netif->rx_batch, esp_netif_loopback_rx_free);
+#endif
         free(esp_netif->ip_info);
         free(esp_netif->ip_info_old);
         free(esp_netif->if_key);
@@ -239,6 +355,7 @@ esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif,
     }
     esp_netif->driver_handle = driver_config->handle;
     esp_netif->driver_transmit = driver_config->transmit;
+    esp_netif->driver_transmit_sg = driver_config->transmit_sg;
     esp_netif->driver_free_rx_buffer = driver_config->driver_free_rx_buffer;
     return ESP_OK;
 }
@@ -278,10 +395,58 @@ esp_err_t esp_netif_transmit(esp_netif_t *esp_netif, void* data, size_t len)
     return (esp_netif->driver_transmit)(esp_netif->driver_handle, data, len);
 }
 
+esp_err_t esp_netif_transmit_sg(esp_netif_t *esp_netif, const esp_netif_iovec_t *iov, size_t iovcnt)
+{
+    ESP_LOGV(TAG, "Transmitting fragments: iov:%p, count:%d", iov, iovcnt);
+    if (esp_netif->driver_transmit_sg) {
+        return (esp_netif->driver_transmit_sg)(esp_netif->driver_handle, iov, iovcnt);
+    }
+    if (iovcnt == 1) {
+        return (esp_netif->driver_transmit)(esp_netif->driver_handle, iov[0].base, iov[0].len);
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+    uint8_t *frame = malloc(len);
+    if (frame == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0, offset = 0; i < iovcnt; offset += iov[i].len, i++) {
+        memcpy(frame + offset, iov[i].base, iov[i].len);
+    }
+#if ESP_NETIF_LOOPBACK_TESTING
+    s_tx_copies++;
+#endif
+    esp_err_t ret = (esp_netif->driver_transmit)(esp_netif->driver_handle, frame, len);
+    free(frame);
+    return ret;
+}
+
+#if ESP_NETIF_LOOPBACK_TESTING
+size_t esp_netif_loopback_get_tx_copies(void)
+{
+    return s_tx_copies;
+}
+#endif
+
 esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb)
 {
     ESP_LOGV(TAG, "Received data: ptr:%p, size:%d", buffer, len);
+#if CONFIG_ESP_NETIF_RX_BATCH
+    loopback_rx_frame_t *rx_frame = malloc(sizeof(loopback_rx_frame_t));
+    if (rx_frame) {
+        rx_frame->buffer = buffer;
+        rx_frame->len = len;
+        rx_frame->eb = eb;
+        if (esp_netif_rx_batch_push(esp_netif->rx_batch, rx_frame) == ESP_OK) {
+            return ESP_OK;
+        }
+        free(rx_frame);
+    }
+#else
     esp_netif_transmit(esp_netif, buffer, len);
+#endif
     if (eb) {
         esp_netif_free_rx_buffer(esp_netif, eb);
     }
@@ -432,7 +597,7 @@ const char *esp_netif_get_desc(esp_netif_t *esp_netif)
     return esp_netif->if_desc;
 }
 
-uint32_t esp_netif_get_event_id(esp_netif_t *esp_netif, esp_netif_ip_event_type_t event_type)
+int32_t esp_netif_get_event_id(esp_netif_t *esp_netif, esp_netif_ip_event_type_t event_type)
 {
     return 0;
 }
@@ -454,4 +619,17 @@ int esp_netif_get_netif_impl_index(esp_netif_t *esp_netif)
     return 0;
 }
 
+esp_err_t esp_netif_get_rx_batch_stats(esp_netif_t *esp_netif, esp_netif_rx_batch_stats_t *stats)
+{
+    if (esp_netif == NULL || stats == NULL) {
+        return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+    }
+#if CONFIG_ESP_NETIF_RX_BATCH
+    esp_netif_rx_batch_get_stats(esp_netif->rx_batch, stats);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 #endif /* CONFIG_ESP_NETIF_LOOPBACK */
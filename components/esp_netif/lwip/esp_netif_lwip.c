@@ -19,6 +19,7 @@
 
 #include "esp_netif.h"
 #include "esp_netif_private.h"
+#include "esp_netif_net_stack.h"
 
 #if CONFIG_ESP_NETIF_TCPIP_LWIP
 
@@ -31,6 +32,8 @@
 #include "lwip/netif.h"
 #if LWIP_DNS /* don't build if not configured for use in lwipopts.h */
 #include "lwip/dns.h"
+#include "lwip/ip.h"
+#include "netif/ethernet.h"
 #endif
 
 #include "esp_netif_lwip_ppp.h"
@@ -368,6 +371,9 @@ static esp_err_t esp_netif_init_configuration(esp_netif_t *esp_netif, const esp_
         if (esp_netif_driver_config->transmit) {
             esp_netif->driver_transmit = esp_netif_driver_config->transmit;
         }
+        if (esp_netif_driver_config->transmit_sg) {
+            esp_netif->driver_transmit_sg = esp_netif_driver_config->transmit_sg;
+        }
         if (esp_netif_driver_config->driver_free_rx_buffer) {
             esp_netif->driver_free_rx_buffer = esp_netif_driver_config->driver_free_rx_buffer;
         }
@@ -452,6 +458,88 @@ static void esp_netif_lwip_remove(esp_netif_t *esp_netif)
     }
 }
 
+#if CONFIG_ESP_NETIF_RX_BATCH
+static bool esp_netif_lwip_rx_batch_schedule(void *ctx)
+{
+    esp_netif_t *esp_netif = ctx;
+    return tcpip_callbackmsg_trycallback(esp_netif->rx_batch_msg) == ERR_OK;
+}
+
+static void esp_netif_lwip_rx_batch_deliver(void *ctx, void *frame)
+{
+    esp_netif_t *esp_netif = ctx;
+    struct netif *netif = esp_netif->lwip_netif;
+    struct pbuf *p = frame;
+    err_t err;
+    // same dispatch as tcpip_input(), but already running in lwip task
+#if LWIP_ETHERNET
+    if (netif->flags & (NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET)) {
+        err = ethernet_input(p, netif);
+    } else
+#endif
+    {
+        err = ip_input(p, netif);
+    }
+    if (err != ERR_OK) {
+        pbuf_free(p);
+    }
+}
+
+static void esp_netif_lwip_rx_batch_free(void *ctx, void *frame)
+{
+    pbuf_free(frame);
+}
+
+static void esp_netif_lwip_rx_batch_drain(void *ctx)
+{
+    esp_netif_t *esp_netif = ctx;
+    esp_netif_rx_batch_drain(esp_netif->rx_batch);
+}
+
+/**
+ * @brief Input function of lwip netif, queues received frames instead of posting each of them to lwip task
+ */
+static err_t esp_netif_lwip_rx_batch_input(struct pbuf *p, struct netif *netif)
+{
+    esp_netif_t *esp_netif = netif->state;
+    return esp_netif_rx_batch_push(esp_netif->rx_batch, p) == ESP_OK ? ERR_OK : ERR_MEM;
+}
+
+static esp_err_t esp_netif_lwip_rx_batch_create(esp_netif_t *esp_netif)
+{
+    if (esp_netif->rx_batch) {
+        return ESP_OK;
+    }
+    esp_netif->rx_batch_msg = tcpip_callbackmsg_new(esp_netif_lwip_rx_batch_drain, esp_netif);
+    if (esp_netif->rx_batch_msg == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_netif->rx_batch = esp_netif_rx_batch_new(CONFIG_ESP_NETIF_RX_BATCH_SIZE, esp_netif_lwip_rx_batch_schedule,
+                                                 esp_netif_lwip_rx_batch_deliver, esp_netif);
+    if (esp_netif->rx_batch == NULL) {
+        tcpip_callbackmsg_delete(esp_netif->rx_batch_msg);
+        esp_netif->rx_batch_msg = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_netif_lwip_rx_batch_destroy_api(esp_netif_api_msg_t *msg)
+{
+    // running in lwip task, after any drain which was posted before
+    esp_netif_t *esp_netif = msg->esp_netif;
+    if (esp_netif->lwip_netif) {
+        // frames the driver still passes to the netif go the regular way
+        esp_netif->lwip_netif->input = tcpip_input;
+    }
+    esp_netif_rx_batch_destroy(esp_netif->rx_batch, esp_netif_lwip_rx_batch_free);
+    tcpip_callbackmsg_delete(esp_netif->rx_batch_msg);
+    esp_netif->rx_batch = NULL;
+    esp_netif->rx_batch_msg = NULL;
+    return ESP_OK;
+}
+#endif /* CONFIG_ESP_NETIF_RX_BATCH */
+
 static esp_err_t esp_netif_lwip_add(esp_netif_t *esp_netif)
 {
     if (esp_netif->lwip_netif == NULL) {
@@ -468,9 +556,19 @@ static esp_err_t esp_netif_lwip_add(esp_netif_t *esp_netif)
         }
     }
 
+    netif_input_fn input_fn = tcpip_input;
+#if CONFIG_ESP_NETIF_RX_BATCH
+    if (!(esp_netif->flags & ESP_NETIF_FLAG_IS_PPP)) {
+        if (esp_netif_lwip_rx_batch_create(esp_netif) != ESP_OK) {
+            return ESP_ERR_NO_MEM;
+        }
+        input_fn = esp_netif_lwip_rx_batch_input;
+    }
+#endif
+
     if (NULL == netif_add(esp_netif->lwip_netif, (struct ip4_addr*)&esp_netif->ip_info->ip,
                          (struct ip4_addr*)&esp_netif->ip_info->netmask, (struct ip4_addr*)&esp_netif->ip_info->gw,
-                         esp_netif, esp_netif->lwip_init_fn, tcpip_input)) {
+                         esp_netif, esp_netif->lwip_init_fn, input_fn)) {
         esp_netif_lwip_remove(esp_netif);
         return ESP_ERR_ESP_NETIF_IF_NOT_READY;
     }
@@ -486,6 +584,12 @@ void esp_netif_destroy(esp_netif_t *esp_netif)
         free(esp_netif->if_key);
         free(esp_netif->if_desc);
         esp_netif_lwip_remove(esp_netif);
+#if CONFIG_ESP_NETIF_RX_BATCH
+        // after the netif is removed, input of frames to the ring must have stopped when it is freed
+        if (esp_netif->rx_batch) {
+            esp_netif_lwip_ipc_call(esp_netif_lwip_rx_batch_destroy_api, esp_netif, NULL);
+        }
+#endif
         if (esp_netif->is_ppp_netif) {
             esp_netif_destroy_ppp(esp_netif->netif_handle);
         }
@@ -522,6 +626,7 @@ esp_err_t esp_netif_set_driver_config(esp_netif_t *esp_netif,
     }
     esp_netif->driver_handle = driver_config->handle;
     esp_netif->driver_transmit = driver_config->transmit;
+    esp_netif->driver_transmit_sg = driver_config->transmit_sg;
     esp_netif->driver_free_rx_buffer = driver_config->driver_free_rx_buffer;
     return ESP_OK;
 }
@@ -742,6 +847,31 @@ esp_err_t esp_netif_transmit(esp_netif_t *esp_netif, void* data, size_t len)
     return (esp_netif->driver_transmit)(esp_netif->driver_handle, data, len);
 }
 
+esp_err_t esp_netif_transmit_sg(esp_netif_t *esp_netif, const esp_netif_iovec_t *iov, size_t iovcnt)
+{
+    if (esp_netif->driver_transmit_sg) {
+        return (esp_netif->driver_transmit_sg)(esp_netif->driver_handle, iov, iovcnt);
+    }
+    if (iovcnt == 1) {
+        return (esp_netif->driver_transmit)(esp_netif->driver_handle, iov[0].base, iov[0].len);
+    }
+    // IO driver doesn't support scatter-gather, flatten the frame
+    size_t len = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+    uint8_t *frame = malloc(len);
+    if (frame == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0, offset = 0; i < iovcnt; offset += iov[i].len, i++) {
+        memcpy(frame + offset, iov[i].base, iov[i].len);
+    }
+    esp_err_t ret = (esp_netif->driver_transmit)(esp_netif->driver_handle, frame, len);
+    free(frame);
+    return ret;
+}
+
 esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb)
 {
     esp_netif->lwip_input_fn(esp_netif->netif_handle, buffer, len, eb);
@@ -1736,6 +1866,20 @@ int esp_netif_get_netif_impl_index(esp_netif_t *esp_netif)
     return netif_get_index(esp_netif->lwip_netif);
 }
 
+esp_err_t esp_netif_get_rx_batch_stats(esp_netif_t *esp_netif, esp_netif_rx_batch_stats_t *stats)
+{
+    if (esp_netif == NULL || stats == NULL) {
+        return ESP_ERR_ESP_NETIF_INVALID_PARAMS;
+    }
+#if CONFIG_ESP_NETIF_RX_BATCH
+    if (esp_netif->rx_batch) {
+        esp_netif_rx_batch_get_stats(esp_netif->rx_batch, stats);
+        return ESP_OK;
+    }
+#endif
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
 esp_err_t esp_netif_get_netif_impl_name(esp_netif_t *esp_netif, char* name)
 {
     ESP_LOGD(TAG, "%s esp_netif:%p", __func__, esp_netif);
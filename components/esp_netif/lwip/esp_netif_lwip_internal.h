@@ -16,6 +16,7 @@
 
 #include "esp_netif.h"
 #include "esp_netif_ppp.h"
+#include "esp_netif_rx_batch.h"
 #include "lwip/netif.h"
 
 struct esp_netif_netstack_lwip_vanilla_config {
@@ -81,8 +82,15 @@ struct esp_netif_obj {
     // io driver related
     void* driver_handle;
     esp_err_t (*driver_transmit)(void *h, void *buffer, size_t len);
+    esp_err_t (*driver_transmit_sg)(void *h, const esp_netif_iovec_t *iov, size_t iovcnt);
     void (*driver_free_rx_buffer)(void *h, void* buffer);
 
+#if CONFIG_ESP_NETIF_RX_BATCH
+    // batched hand-off of received frames to the tcpip task
+    esp_netif_rx_batch_t *rx_batch;
+    struct tcpip_callback_msg *rx_batch_msg;
+#endif
+
     // dhcp related
     esp_netif_dhcp_status_t dhcpc_status;
     esp_netif_dhcp_status_t dhcps_status;
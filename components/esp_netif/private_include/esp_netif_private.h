@@ -145,4 +145,55 @@ void esp_netif_list_unlock(void);
  */
 bool esp_netif_is_netif_listed(esp_netif_t *esp_netif);
 
+#if CONFIG_ESP_NETIF_LOOPBACK && ESP_NETIF_LOOPBACK_TESTING
+//
+// Hooks of the loopback netif for the host tests, only built with ESP_NETIF_LOOPBACK_TESTING defined
+//
+
+/**
+ * @brief  Get the number of frames the loopback netif had to flatten into a single buffer
+ *
+ * Frames are copied by esp_netif_transmit_sg() when the IO driver has no scatter-gather transmit.
+ *
+ * @return number of copied frames since boot
+ */
+size_t esp_netif_loopback_get_tx_copies(void);
+
+#if CONFIG_ESP_NETIF_RX_BATCH
+/**
+ * @brief  Leave the frames queued in the receive ring of the loopback netifs to esp_netif_loopback_process_rx()
+ *
+ * By default the loopback netifs echo the received frames back to the driver within esp_netif_receive().
+ *
+ * @param[in]  deferred true to leave the frames in the ring, false to echo them right away again
+ */
+void esp_netif_loopback_set_rx_deferred(bool deferred);
+
+/**
+ * @brief  Echo the frames queued in the receive ring of a loopback netif back to its driver
+ *
+ * Stands in for the network stack task, which drains the receive ring of lwip netifs.
+ *
+ * @param[in]  esp_netif Handle to esp-netif instance
+ *
+ * @return number of processed frames
+ */
+size_t esp_netif_loopback_process_rx(esp_netif_t *esp_netif);
+
+/**
+ * @brief  Get the number of times the loopback netifs requested their receive ring to be drained
+ *
+ * @return number of drain requests since boot
+ */
+size_t esp_netif_loopback_get_rx_drain_requests(void);
+
+/**
+ * @brief  Make the drain requests of the loopback netifs fail, as if the network stack task queue was full
+ *
+ * @param[in]  fail true to fail the following requests, false to accept them again
+ */
+void esp_netif_loopback_set_rx_drain_requests_fail(bool fail);
+#endif
+#endif
+
 #endif //_ESP_NETIF_PRIVATE_H_
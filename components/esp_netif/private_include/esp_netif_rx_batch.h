@@ -0,0 +1,103 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_NETIF_RX_BATCH_H_
+#define _ESP_NETIF_RX_BATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_netif.h"
+
+//
+// Receive ring of an interface, filled by the IO driver task and drained by the network stack task.
+// Only the first frame pushed to an empty ring wakes up the stack task, the following frames
+// are picked up by the same drain, so that the stack task processes received frames in bursts.
+// The ring has a single producer (IO driver) and a single consumer (network stack task).
+//
+
+typedef struct esp_netif_rx_batch esp_netif_rx_batch_t;
+
+/**
+ * @brief Posts a drain request to the network stack task
+ *
+ * @param ctx context passed to esp_netif_rx_batch_new()
+ * @return true if the request was posted
+ */
+typedef bool (*esp_netif_rx_batch_schedule_fn)(void *ctx);
+
+/**
+ * @brief Passes one frame to the network stack, or frees it when the ring is destroyed
+ *
+ * @param ctx context passed to esp_netif_rx_batch_new()
+ * @param frame frame pushed to the ring
+ */
+typedef void (*esp_netif_rx_batch_frame_fn)(void *ctx, void *frame);
+
+/**
+ * @brief  Creates a receive ring
+ *
+ * @param[in]  size Maximum number of queued frames, rounded up to a power of two
+ * @param[in]  schedule Function to request a drain from the network stack task
+ * @param[in]  deliver Function called by esp_netif_rx_batch_drain() for each frame
+ * @param[in]  ctx Context passed to schedule and deliver
+ *
+ * @return Receive ring, or NULL if out of memory
+ */
+esp_netif_rx_batch_t *esp_netif_rx_batch_new(size_t size, esp_netif_rx_batch_schedule_fn schedule,
+                                             esp_netif_rx_batch_frame_fn deliver, void *ctx);
+
+/**
+ * @brief  Destroys a receive ring
+ *
+ * Must not be called while a drain is scheduled or running.
+ *
+ * @param[in]  batch Receive ring
+ * @param[in]  free_frame Function called for each frame left in the ring
+ */
+void esp_netif_rx_batch_destroy(esp_netif_rx_batch_t *batch, esp_netif_rx_batch_frame_fn free_frame);
+
+/**
+ * @brief  Queues a received frame, called from the IO driver task
+ *
+ * Schedules a drain if none is pending. If the drain can't be scheduled, the frame is
+ * taken back out of the ring and dropped, as when the ring is full.
+ *
+ * @param[in]  batch Receive ring
+ * @param[in]  frame Frame to queue, not NULL, owned by the ring on success
+ *
+ * @return
+ *         - ESP_OK on success
+ *         - ESP_ERR_NO_MEM if the ring is full or the drain can't be scheduled, the frame is then
+ *           still owned by the caller
+ */
+esp_err_t esp_netif_rx_batch_push(esp_netif_rx_batch_t *batch, void *frame);
+
+/**
+ * @brief  Passes all queued frames to the network stack, called from the network stack task
+ *
+ * @param[in]  batch Receive ring
+ *
+ * @return Number of delivered frames
+ */
+size_t esp_netif_rx_batch_drain(esp_netif_rx_batch_t *batch);
+
+/**
+ * @brief  Gets the statistics of a receive ring
+ *
+ * @param[in]  batch Receive ring
+ * @param[out] stats Statistics
+ */
+void esp_netif_rx_batch_get_stats(esp_netif_rx_batch_t *batch, esp_netif_rx_batch_stats_t *stats);
+
+#endif //_ESP_NETIF_RX_BATCH_H_
@@ -0,0 +1,6 @@
+#pragma once
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_ESP_NETIF_LOOPBACK 1
+#define CONFIG_ESP_NETIF_RX_BATCH 1
+#define CONFIG_ESP_NETIF_RX_BATCH_SIZE 8
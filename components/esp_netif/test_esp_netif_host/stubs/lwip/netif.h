@@ -0,0 +1,13 @@
+#pragma once
+
+// Subset of lwIP definitions used by the loopback esp-netif, which bypasses the network stack
+
+#include <stdint.h>
+
+#define NETIF_MAX_HWADDR_LEN 6U
+
+typedef int8_t err_t;
+
+struct netif;
+
+#define ip4_addr_set_zero(ipaddr) ((ipaddr)->addr = 0)
@@ -0,0 +1,266 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "esp_netif_private.h"
+}
+
+namespace {
+
+struct echo_driver {
+    esp_netif_driver_base_t base;
+    std::vector<uintptr_t> echoed;
+    std::atomic<size_t> freed_rx_buffers;
+};
+
+esp_err_t echo_transmit(void *h, void *buffer, size_t len)
+{
+    echo_driver *driver = static_cast<echo_driver *>(h);
+    driver->echoed.push_back(reinterpret_cast<uintptr_t>(buffer));
+    return ESP_OK;
+}
+
+void echo_free_rx_buffer(void *h, void *buffer)
+{
+    echo_driver *driver = static_cast<echo_driver *>(h);
+    driver->freed_rx_buffers++;
+}
+
+int s_dummy_stack;
+
+esp_netif_t *create_netif(echo_driver *driver)
+{
+    esp_netif_inherent_config_t base = {};
+    base.if_key = "loopback";
+    esp_netif_driver_ifconfig_t driver_config = {};
+    driver_config.handle = driver;
+    driver_config.transmit = echo_transmit;
+    driver_config.driver_free_rx_buffer = echo_free_rx_buffer;
+    esp_netif_config_t config = {};
+    config.base = &base;
+    config.driver = &driver_config;
+    config.stack = reinterpret_cast<const esp_netif_netstack_config_t *>(&s_dummy_stack);
+    return esp_netif_new(&config);
+}
+
+void *frame(uintptr_t id)
+{
+    return reinterpret_cast<void *>(id);
+}
+
+// Leaves the received frames to esp_netif_loopback_process_rx(), which stands in for the stack task
+struct deferred_rx {
+    deferred_rx()
+    {
+        esp_netif_loopback_set_rx_deferred(true);
+    }
+    ~deferred_rx()
+    {
+        esp_netif_loopback_set_rx_deferred(false);
+    }
+};
+
+// Echo driver which receives each echoed frame again, up to a number of hops
+struct bouncing_driver : echo_driver {
+    esp_netif_t *netif;
+    uintptr_t hops;
+};
+
+esp_err_t bouncing_transmit(void *h, void *buffer, size_t len)
+{
+    bouncing_driver *driver = static_cast<bouncing_driver *>(h);
+    echo_transmit(h, buffer, len);
+    if (reinterpret_cast<uintptr_t>(buffer) < driver->hops) {
+        esp_netif_receive(driver->netif, frame(reinterpret_cast<uintptr_t>(buffer) + 1), len, NULL);
+    }
+    return ESP_OK;
+}
+
+} // namespace
+
+TEST_CASE("received frames are handed to the stack task in batches", "[esp_netif]")
+{
+    deferred_rx deferred;
+    echo_driver driver;
+    driver.freed_rx_buffers = 0;
+    esp_netif_t *netif = create_netif(&driver);
+    REQUIRE(netif != NULL);
+
+    // Only the first frame of a burst wakes up the stack task
+    size_t requests = esp_netif_loopback_get_rx_drain_requests();
+    for (uintptr_t i = 1; i <= 6; i++) {
+        CHECK(esp_netif_receive(netif, frame(i), 60, frame(i)) == ESP_OK);
+    }
+    CHECK(esp_netif_loopback_get_rx_drain_requests() == requests + 1);
+    CHECK(driver.echoed.empty());
+    CHECK(esp_netif_loopback_process_rx(netif) == 6);
+    CHECK(driver.echoed == std::vector<uintptr_t>({1, 2, 3, 4, 5, 6}));
+    CHECK(driver.freed_rx_buffers == 6);
+
+    CHECK(esp_netif_receive(netif, frame(7), 60, NULL) == ESP_OK);
+    CHECK(esp_netif_loopback_get_rx_drain_requests() == requests + 2);
+    CHECK(esp_netif_loopback_process_rx(netif) == 1);
+    CHECK(esp_netif_loopback_process_rx(netif) == 0);
+
+    esp_netif_rx_batch_stats_t stats;
+    CHECK(esp_netif_get_rx_batch_stats(netif, &stats) == ESP_OK);
+    CHECK(stats.frames == 7);
+    CHECK(stats.batches == 2);
+    CHECK(stats.max_batch == 6);
+    CHECK(stats.dropped == 0);
+
+    // Frames are dropped and their rx buffers freed when the ring is full
+    driver.freed_rx_buffers = 0;
+    for (uintptr_t i = 0; i < CONFIG_ESP_NETIF_RX_BATCH_SIZE + 3; i++) {
+        CHECK(esp_netif_receive(netif, frame(100 + i), 60, frame(100 + i)) == ESP_OK);
+    }
+    CHECK(driver.freed_rx_buffers == 3);
+    CHECK(esp_netif_get_rx_batch_stats(netif, &stats) == ESP_OK);
+    CHECK(stats.dropped == 3);
+
+    // Frames left in the ring are freed with the interface
+    esp_netif_destroy(netif);
+    CHECK(driver.freed_rx_buffers == CONFIG_ESP_NETIF_RX_BATCH_SIZE + 3);
+}
+
+TEST_CASE("received frames are dropped if the stack task can't be woken up", "[esp_netif]")
+{
+    deferred_rx deferred;
+    echo_driver driver;
+    driver.freed_rx_buffers = 0;
+    esp_netif_t *netif = create_netif(&driver);
+    REQUIRE(netif != NULL);
+
+    esp_netif_loopback_set_rx_drain_requests_fail(true);
+    CHECK(esp_netif_receive(netif, frame(1), 60, frame(1)) == ESP_OK);
+    CHECK(esp_netif_receive(netif, frame(2), 60, frame(2)) == ESP_OK);
+    esp_netif_loopback_set_rx_drain_requests_fail(false);
+
+    // Nothing was left behind in the ring
+    CHECK(driver.freed_rx_buffers == 2);
+    CHECK(esp_netif_loopback_process_rx(netif) == 0);
+    esp_netif_rx_batch_stats_t stats;
+    CHECK(esp_netif_get_rx_batch_stats(netif, &stats) == ESP_OK);
+    CHECK(stats.dropped == 2);
+
+    // Next frame goes through
+    CHECK(esp_netif_receive(netif, frame(3), 60, frame(3)) == ESP_OK);
+    CHECK(esp_netif_loopback_process_rx(netif) == 1);
+    CHECK(driver.echoed == std::vector<uintptr_t>({3}));
+    CHECK(driver.freed_rx_buffers == 3);
+
+    esp_netif_destroy(netif);
+}
+
+TEST_CASE("receive ring delivers all frames in order across threads", "[esp_netif]")
+{
+    deferred_rx deferred;
+    echo_driver driver;
+    driver.freed_rx_buffers = 0;
+    esp_netif_t *netif = create_netif(&driver);
+    REQUIRE(netif != NULL);
+
+    const uintptr_t num_frames = 10000;
+    std::atomic<bool> done(false);
+
+    // IO driver task, sends a frame again when it was dropped because the ring was full
+    std::thread driver_task([&]() {
+        esp_netif_rx_batch_stats_t stats = {};
+        uint32_t dropped = 0;
+        for (uintptr_t i = 1; i <= num_frames; i++) {
+            esp_netif_receive(netif, frame(i), 60, NULL);
+            esp_netif_get_rx_batch_stats(netif, &stats);
+            if (stats.dropped != dropped) {
+                dropped = stats.dropped;
+                std::this_thread::yield();
+                i--;
+            }
+        }
+        done = true;
+    });
+
+    // Stack task
+    size_t delivered = 0;
+    while (!done) {
+        size_t count = esp_netif_loopback_process_rx(netif);
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        delivered += count;
+    }
+    delivered += esp_netif_loopback_process_rx(netif);
+    driver_task.join();
+
+    esp_netif_rx_batch_stats_t stats;
+    CHECK(esp_netif_get_rx_batch_stats(netif, &stats) == ESP_OK);
+    CHECK(delivered == num_frames);
+    CHECK(stats.frames == num_frames);
+    std::vector<uintptr_t> expected(num_frames);
+    for (size_t i = 0; i < num_frames; i++) {
+        expected[i] = i + 1;
+    }
+    CHECK(driver.echoed == expected);
+    CHECK(stats.max_batch <= CONFIG_ESP_NETIF_RX_BATCH_SIZE);
+
+    esp_netif_destroy(netif);
+}
+
+TEST_CASE("loopback echoes received frames right away", "[esp_netif]")
+{
+    echo_driver driver;
+    driver.freed_rx_buffers = 0;
+    esp_netif_t *netif = create_netif(&driver);
+    REQUIRE(netif != NULL);
+
+    // No stack task drains the ring, so more frames than it holds must go through
+    const uintptr_t num_frames = 3 * CONFIG_ESP_NETIF_RX_BATCH_SIZE;
+    for (uintptr_t i = 1; i <= num_frames; i++) {
+        CHECK(esp_netif_receive(netif, frame(i), 60, frame(i)) == ESP_OK);
+        CHECK(driver.echoed.size() == i);
+    }
+    CHECK(driver.freed_rx_buffers == num_frames);
+    esp_netif_rx_batch_stats_t stats;
+    CHECK(esp_netif_get_rx_batch_stats(netif, &stats) == ESP_OK);
+    CHECK(stats.frames == num_frames);
+    CHECK(stats.dropped == 0);
+
+    esp_netif_destroy(netif);
+}
+
+TEST_CASE("loopback echoes frames received again from the driver transmit", "[esp_netif]")
+{
+    bouncing_driver driver;
+    driver.freed_rx_buffers = 0;
+    esp_netif_inherent_config_t base = {};
+    base.if_key = "loopback";
+    esp_netif_driver_ifconfig_t driver_config = {};
+    driver_config.handle = &driver;
+    driver_config.transmit = bouncing_transmit;
+    driver_config.driver_free_rx_buffer = echo_free_rx_buffer;
+    esp_netif_config_t config = {};
+    config.base = &base;
+    config.driver = &driver_config;
+    config.stack = reinterpret_cast<const esp_netif_netstack_config_t *>(&s_dummy_stack);
+    driver.netif = esp_netif_new(&config);
+    REQUIRE(driver.netif != NULL);
+
+    // Each frame is received from within the echo of the previous one, and picked up by the same drain
+    driver.hops = 4 * CONFIG_ESP_NETIF_RX_BATCH_SIZE;
+    CHECK(esp_netif_receive(driver.netif, frame(1), 60, NULL) == ESP_OK);
+    std::vector<uintptr_t> expected(driver.hops);
+    for (size_t i = 0; i < driver.hops; i++) {
+        expected[i] = i + 1;
+    }
+    CHECK(driver.echoed == expected);
+    esp_netif_rx_batch_stats_t stats;
+    CHECK(esp_netif_get_rx_batch_stats(driver.netif, &stats) == ESP_OK);
+    CHECK(stats.dropped == 0);
+    CHECK(stats.max_batch == 1);
+
+    esp_netif_destroy(driver.netif);
+}
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "esp_netif_private.h"
+}
+
+namespace {
+
+struct test_driver {
+    esp_netif_driver_base_t base;
+    std::vector<std::vector<uint8_t>> frames;
+    size_t transmit_calls;
+    size_t transmit_sg_calls;
+    size_t last_iovcnt;
+};
+
+esp_err_t test_transmit(void *h, void *buffer, size_t len)
+{
+    test_driver *driver = static_cast<test_driver *>(h);
+    const uint8_t *data = static_cast<const uint8_t *>(buffer);
+    driver->frames.emplace_back(data, data + len);
+    driver->transmit_calls++;
+    return ESP_OK;
+}
+
+esp_err_t test_transmit_sg(void *h, const esp_netif_iovec_t *iov, size_t iovcnt)
+{
+    test_driver *driver = static_cast<test_driver *>(h);
+    std::vector<uint8_t> frame;
+    for (size_t i = 0; i < iovcnt; i++) {
+        const uint8_t *data = static_cast<const uint8_t *>(iov[i].base);
+        frame.insert(frame.end(), data, data + iov[i].len);
+    }
+    driver->frames.push_back(frame);
+    driver->transmit_sg_calls++;
+    driver->last_iovcnt = iovcnt;
+    return ESP_OK;
+}
+
+// Loopback netif doesn't use the network stack config, it only has to be provided
+int s_dummy_stack;
+
+esp_netif_t *create_netif(test_driver *driver, bool with_sg)
+{
+    esp_netif_inherent_config_t base = {};
+    base.if_key = "loopback";
+    esp_netif_driver_ifconfig_t driver_config = {};
+    driver_config.handle = driver;
+    driver_config.transmit = test_transmit;
+    driver_config.transmit_sg = with_sg ? test_transmit_sg : NULL;
+    esp_netif_config_t config = {};
+    config.base = &base;
+    config.driver = &driver_config;
+    config.stack = reinterpret_cast<const esp_netif_netstack_config_t *>(&s_dummy_stack);
+    return esp_netif_new(&config);
+}
+
+// Ethernet header, TCP/IP headers and payload, as lwIP passes a TCP segment
+uint8_t s_eth_header[14] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 1, 2, 3, 4, 5, 6, 0x08, 0x00 };
+uint8_t s_tcpip_header[40] = { 0x45 };
+uint8_t s_payload[1460];
+
+std::vector<uint8_t> expected_frame()
+{
+    std::vector<uint8_t> frame(s_eth_header, s_eth_header + sizeof(s_eth_header));
+    frame.insert(frame.end(), s_tcpip_header, s_tcpip_header + sizeof(s_tcpip_header));
+    frame.insert(frame.end(), s_payload, s_payload + sizeof(s_payload));
+    return frame;
+}
+
+} // namespace
+
+TEST_CASE("transmit_sg passes fragments to a scatter-gather driver without copying", "[esp_netif]")
+{
+    memset(s_payload, 0xa5, sizeof(s_payload));
+    test_driver driver = {};
+    esp_netif_t *netif = create_netif(&driver, true);
+    REQUIRE(netif != NULL);
+
+    esp_netif_iovec_t iov[3] = {
+        { s_eth_header, sizeof(s_eth_header) },
+        { s_tcpip_header, sizeof(s_tcpip_header) },
+        { s_payload, sizeof(s_payload) },
+    };
+    size_t copies = esp_netif_loopback_get_tx_copies();
+    for (int i = 0; i < 10; i++) {
+        CHECK(esp_netif_transmit_sg(netif, iov, 3) == ESP_OK);
+    }
+    CHECK(esp_netif_loopback_get_tx_copies() == copies);
+    CHECK(driver.transmit_sg_calls == 10);
+    CHECK(driver.transmit_calls == 0);
+    CHECK(driver.last_iovcnt == 3);
+    CHECK(driver.frames.back() == expected_frame());
+
+    esp_netif_destroy(netif);
+}
+
+TEST_CASE("transmit_sg flattens frames for drivers without scatter-gather support", "[esp_netif]")
+{
+    memset(s_payload, 0x5a, sizeof(s_payload));
+    test_driver driver = {};
+    esp_netif_t *netif = create_netif(&driver, false);
+    REQUIRE(netif != NULL);
+
+    esp_netif_iovec_t iov[3] = {
+        { s_eth_header, sizeof(s_eth_header) },
+        { s_tcpip_header, sizeof(s_tcpip_header) },
+        { s_payload, sizeof(s_payload) },
+    };
+    size_t copies = esp_netif_loopback_get_tx_copies();
+    CHECK(esp_netif_transmit_sg(netif, iov, 3) == ESP_OK);
+    CHECK(esp_netif_loopback_get_tx_copies() == copies + 1);
+    CHECK(driver.transmit_calls == 1);
+    CHECK(driver.frames.back() == expected_frame());
+
+    // A single fragment is passed as is
+    CHECK(esp_netif_transmit_sg(netif, &iov[2], 1) == ESP_OK);
+    CHECK(esp_netif_loopback_get_tx_copies() == copies + 1);
+    CHECK(driver.transmit_calls == 2);
+    CHECK(driver.frames.back() == std::vector<uint8_t>(s_payload, s_payload + sizeof(s_payload)));
+
+    // Driver config updated after creation, e.g. in post_attach callback
+    esp_netif_driver_ifconfig_t driver_config = {};
+    driver_config.handle = &driver;
+    driver_config.transmit = test_transmit;
+    driver_config.transmit_sg = test_transmit_sg;
+    CHECK(esp_netif_set_driver_config(netif, &driver_config) == ESP_OK);
+    CHECK(esp_netif_transmit_sg(netif, iov, 3) == ESP_OK);
+    CHECK(esp_netif_loopback_get_tx_copies() == copies + 1);
+    CHECK(driver.transmit_sg_calls == 1);
+
+    esp_netif_destroy(netif);
+}
@@ -65,6 +65,7 @@ typedef struct {
     char                        *subprotocol;
     char                        *user_agent;
     char                        *headers;
+    esp_transport_ws_deflate_config_t *deflate;
 } websocket_config_storage_t;
 
 typedef enum {
@@ -198,6 +199,12 @@ static esp_err_t esp_websocket_client_set_config(esp_websocket_client_handle_t c
         cfg->headers = strdup(config->headers);
         ESP_WS_CLIENT_MEM_CHECK(TAG, cfg->headers, return ESP_ERR_NO_MEM);
     }
+    if (config->deflate) {
+        free(cfg->deflate);
+        cfg->deflate = malloc(sizeof(esp_transport_ws_deflate_config_t));
+        ESP_WS_CLIENT_MEM_CHECK(TAG, cfg->deflate, return ESP_ERR_NO_MEM);
+        *cfg->deflate = *config->deflate;
+    }
 
     cfg->network_timeout_ms = WEBSOCKET_NETWORK_TIMEOUT_MS;
     cfg->user_context = config->user_context;
@@ -228,6 +235,7 @@ static esp_err_t esp_websocket_client_destroy_config(esp_websocket_client_handle
     free(cfg->subprotocol);
     free(cfg->user_agent);
     free(cfg->headers);
+    free(cfg->deflate);
     memset(cfg, 0, sizeof(websocket_config_storage_t));
     free(client->config);
     client->config = NULL;
@@ -248,6 +256,9 @@ static void set_websocket_transport_optional_settings(esp_websocket_client_handl
     if (trans && client->config->headers) {
         esp_transport_ws_set_headers(trans, client->config->headers);
     }
+    if (trans && client->config->deflate) {
+        esp_transport_ws_set_deflate(trans, client->config->deflate);
+    }
 }
 
 esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config)
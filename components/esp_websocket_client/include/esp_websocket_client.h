@@ -22,6 +22,7 @@
 #include "freertos/FreeRTOS.h"
 #include "esp_err.h"
 #include "esp_event.h"
+#include "esp_transport_ws_deflate.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -85,6 +86,7 @@ typedef struct {
     char                        *subprotocol;               /*!< Websocket subprotocol */
     char                        *user_agent;                /*!< Websocket user-agent */
     char                        *headers;                   /*!< Websocket additional headers */
+    const esp_transport_ws_deflate_config_t *deflate;       /*!< Offer the permessage-deflate extension with these settings, NULL not to */
 } esp_websocket_client_config_t;
 
 /**
@@ -48,7 +48,11 @@
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
+#ifdef CONFIG_FATFS_USE_EXPAND
+#define FF_USE_EXPAND	1
+#else
 #define FF_USE_EXPAND	0
+#endif
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
@@ -298,6 +298,60 @@ void test_fatfs_truncate_file(const char* filename)
     TEST_ASSERT_EQUAL(0, fclose(f));
 }
 
+void test_fatfs_preallocate(const char* filename)
+{
+    const size_t prealloc_size = 64 * 1024;
+    const char data[] = "0123456789abcdef";
+    char output[sizeof(data)];
+    struct stat st;
+
+    int fd = open(filename, O_CREAT | O_TRUNC | O_RDWR);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_fat_preallocate(fd, 0, true));
+    TEST_ESP_OK(esp_vfs_fat_preallocate(fd, prealloc_size, true));
+
+    // File size covers the preallocated area, position stays at the beginning
+    TEST_ASSERT_EQUAL(0, fstat(fd, &st));
+    TEST_ASSERT_EQUAL(prealloc_size, st.st_size);
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_CUR));
+
+    // Only empty files can be preallocated
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_fat_preallocate(fd, prealloc_size, true));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_fat_preallocate(fd, prealloc_size, false));
+
+    // Write into the preallocated area, then release the unused part
+    TEST_ASSERT_EQUAL(sizeof(data), write(fd, data, sizeof(data)));
+    TEST_ASSERT_EQUAL(0, ftruncate(fd, sizeof(data)));
+    TEST_ASSERT_EQUAL(0, fstat(fd, &st));
+    TEST_ASSERT_EQUAL(sizeof(data), st.st_size);
+    TEST_ASSERT_EQUAL(sizeof(data), lseek(fd, 0, SEEK_CUR));
+
+    // Extending the file with ftruncate is not supported
+    TEST_ASSERT_EQUAL(-1, ftruncate(fd, prealloc_size));
+    TEST_ASSERT_EQUAL(EPERM, errno);
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    FILE* f = fopen(filename, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    memset(output, 0, sizeof(output));
+    TEST_ASSERT_EQUAL(sizeof(data), fread(output, 1, sizeof(output), f));
+    TEST_ASSERT_EQUAL_STRING(data, output);
+    TEST_ASSERT_EQUAL(0, fclose(f));
+
+    // Same with a cluster chain which doesn't have to be contiguous
+    fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    TEST_ESP_OK(esp_vfs_fat_preallocate(fd, prealloc_size, false));
+    TEST_ASSERT_EQUAL(0, fstat(fd, &st));
+    TEST_ASSERT_EQUAL(prealloc_size, st.st_size);
+    TEST_ASSERT_EQUAL(0, ftruncate(fd, 0));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    // File descriptor is no longer valid
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_fat_preallocate(fd, prealloc_size, false));
+}
+
 void test_fatfs_stat(const char* filename, const char* root_dir)
 {
     struct tm tm;
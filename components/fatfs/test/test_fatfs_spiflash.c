@@ -118,6 +118,13 @@ TEST_CASE("(WL) can truncate", "[fatfs][wear_levelling]")
     test_teardown();
 }
 
+TEST_CASE("(WL) can preallocate file", "[fatfs][wear_levelling]")
+{
+    test_setup();
+    test_fatfs_preallocate("/spiflash/prealloc.bin");
+    test_teardown();
+}
+
 TEST_CASE("(WL) stat returns correct values", "[fatfs][wear_levelling]")
 {
     test_setup();
@@ -6,10 +6,12 @@
 #include "wear_levelling.h"
 #include "diskio_impl.h"
 #include "diskio_wl.h"
+#include "SpiFlash.h"
 
 #include "catch.hpp"
 
 extern "C" void _spi_flash_init(const char* chip_size, size_t block_size, size_t sector_size, size_t page_size, const char* partition_bin);
+extern SpiFlash spiflash;
 
 TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
 {
@@ -91,3 +93,82 @@ TEST_CASE("create volume, open file, write and read back data", "[fatfs]")
     free(read);
     free(data);
 }
+
+static void benchmark_write_file(const char* name, uint32_t file_size, uint32_t chunk_size, bool preallocate)
+{
+    FIL file;
+    UINT bw;
+    char *chunk = (char*) malloc(chunk_size);
+    memset(chunk, 0xa5, chunk_size);
+
+    REQUIRE(f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    if (preallocate) {
+        REQUIRE(f_expand(&file, file_size, 1) == FR_OK);
+    }
+    for (uint32_t written = 0; written < file_size; written += chunk_size) {
+        REQUIRE(f_write(&file, chunk, chunk_size, &bw) == FR_OK);
+        REQUIRE(bw == chunk_size);
+        REQUIRE(f_sync(&file) == FR_OK);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    free(chunk);
+}
+
+/* Standard FATFS on wear levelling workloads for the flash timing model, see
+ * spi_flash/sim/SpiFlashTiming.h. Run with "make benchmark", results of all storage
+ * components use the same format.
+ */
+TEST_CASE("fatfs benchmark: standard workloads", "[fatfs][benchmark][.]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    BYTE pdrv;
+    FATFS fs;
+    FIL file;
+    UINT br;
+    SpiFlashTiming& timing = spiflash.get_timing();
+
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+
+    wl_handle_t wl_handle;
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    REQUIRE(ff_diskio_get_drive(&pdrv) == ESP_OK);
+    REQUIRE(ff_diskio_register_wl_partition(pdrv, wl_handle) == ESP_OK);
+    timing.report("fatfs: mount wear levelling");
+
+    timing.reset();
+    DWORD part_list[] = {100, 0, 0, 0};
+    BYTE work_area[FF_MAX_SS];
+    REQUIRE(f_fdisk(pdrv, part_list, work_area) == FR_OK);
+    REQUIRE(f_mkfs("", FM_ANY, 0, work_area, sizeof(work_area)) == FR_OK);
+    REQUIRE(f_mount(&fs, "", 0) == FR_OK);
+    timing.report("fatfs: format and mount");
+
+    timing.reset();
+    benchmark_write_file("seq.bin", 256 * 1024, 4096, false);
+    timing.report("fatfs: write 256 KB file in 4 KB chunks");
+
+    timing.reset();
+    benchmark_write_file("prealloc.bin", 256 * 1024, 4096, true);
+    timing.report("fatfs: same, preallocated with f_expand");
+
+    const uint32_t chunk_size = 4096;
+    char *chunk = (char*) malloc(chunk_size);
+    timing.reset();
+    REQUIRE(f_open(&file, "seq.bin", FA_READ) == FR_OK);
+    for (uint32_t read = 0; read < 256 * 1024; read += chunk_size) {
+        REQUIRE(f_read(&file, chunk, chunk_size, &br) == FR_OK);
+        REQUIRE(br == chunk_size);
+    }
+    REQUIRE(f_close(&file) == FR_OK);
+    timing.report("fatfs: read 256 KB file in 4 KB chunks");
+    free(chunk);
+
+    timing.reset();
+    benchmark_write_file("log.txt", 1000 * 64, 64, false);
+    timing.report("fatfs: 1000 synced appends of 64 bytes");
+
+    REQUIRE(f_mount(0, "", 0) == FR_OK);
+    ff_diskio_unregister(pdrv);
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+}
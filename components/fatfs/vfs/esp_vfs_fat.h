@@ -68,6 +68,47 @@ esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive,
  */
 esp_err_t esp_vfs_fat_unregister_path(const char* base_path);
 
+/**
+ * @brief fcntl() commands implemented by the FAT VFS driver
+ *
+ * The argument of both commands is the number of bytes to preallocate,
+ * passed as an unsigned value. See esp_vfs_fat_preallocate for details.
+ */
+#define F_FAT_PREALLOC          0x4650  /*!< Allocate clusters for an empty file, the cluster chain may be fragmented */
+#define F_FAT_PREALLOC_CONTIG   0x4651  /*!< Allocate one contiguous block of clusters for an empty file */
+
+/**
+ * @brief Preallocate storage for a file opened on a FAT volume
+ *
+ * Reserves clusters for 'size' bytes of data in a file which has just been
+ * created, so that subsequent writes do not need to grow the cluster chain.
+ * If 'contiguous' is true, the clusters are allocated as one contiguous block
+ * (using FatFs f_expand), and data written to the file afterwards goes to
+ * consecutive sectors without any FAT table updates in between.
+ *
+ * After this call the file size is equal to 'size' and the file position is
+ * at the beginning of the file. Contents of the preallocated area are
+ * undefined until written. Once writing is finished, call ftruncate() with
+ * the number of bytes actually written to release the unused clusters.
+ *
+ * @note This function is equivalent to calling fcntl() with F_FAT_PREALLOC
+ *       or F_FAT_PREALLOC_CONTIG command.
+ *
+ * @param fd          file descriptor of an empty file opened for writing
+ * @param size        number of bytes to preallocate
+ * @param contiguous  if true, allocate a single contiguous block of clusters
+ * @return
+ *      - ESP_OK on success
+ *      - ESP_ERR_INVALID_ARG if fd is not valid or size is zero
+ *      - ESP_ERR_INVALID_STATE if the file is not empty or not opened for writing
+ *      - ESP_ERR_NOT_FOUND if there is not enough free space (or, if 'contiguous'
+ *        is set, no contiguous free area of the requested size)
+ *      - ESP_ERR_NOT_SUPPORTED if fd doesn't belong to a FAT volume, or if
+ *        'contiguous' is set and CONFIG_FATFS_USE_EXPAND is disabled
+ *      - ESP_FAIL on disk I/O error
+ */
+esp_err_t esp_vfs_fat_preallocate(int fd, size_t size, bool contiguous);
+
 
 /**
  * @brief Configuration arguments for esp_vfs_fat_sdmmc_mount and esp_vfs_fat_spiflash_mount functions
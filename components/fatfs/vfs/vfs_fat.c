@@ -23,6 +23,7 @@
 #include "esp_log.h"
 #include "ff.h"
 #include "diskio_impl.h"
+#include "esp_vfs_fat.h"
 
 typedef struct {
     char fat_drive[8];  /* FAT drive name */
@@ -74,6 +75,8 @@ static int vfs_fat_open(void* ctx, const char * path, int flags, int mode);
 static int vfs_fat_close(void* ctx, int fd);
 static int vfs_fat_fstat(void* ctx, int fd, struct stat * st);
 static int vfs_fat_fsync(void* ctx, int fd);
+static int vfs_fat_ftruncate(void* ctx, int fd, off_t length);
+static int vfs_fat_fcntl(void* ctx, int fd, int cmd, int arg);
 #ifdef CONFIG_VFS_SUPPORT_DIR
 static int vfs_fat_stat(void* ctx, const char * path, struct stat * st);
 static int vfs_fat_link(void* ctx, const char* n1, const char* n2);
@@ -139,6 +142,8 @@ esp_err_t esp_vfs_fat_register(const char* base_path, const char* fat_drive, siz
         .close_p = &vfs_fat_close,
         .fstat_p = &vfs_fat_fstat,
         .fsync_p = &vfs_fat_fsync,
+        .ftruncate_p = &vfs_fat_ftruncate,
+        .fcntl_p = &vfs_fat_fcntl,
 #ifdef CONFIG_VFS_SUPPORT_DIR
         .stat_p = &vfs_fat_stat,
         .link_p = &vfs_fat_link,
@@ -460,6 +465,134 @@ static int vfs_fat_fsync(void* ctx, int fd)
     return rc;
 }
 
+static int vfs_fat_ftruncate(void* ctx, int fd, off_t length)
+{
+    if (length < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
+    _lock_acquire(&fat_ctx->lock);
+    FIL* file = &fat_ctx->files[fd];
+    int ret = 0;
+    FRESULT res;
+
+    if (f_size(file) < (FSIZE_t) length) {
+        ESP_LOGD(TAG, "ftruncate does not support extending size");
+        errno = EPERM;
+        ret = -1;
+        goto out;
+    }
+
+    // FatFs truncates at the current file position. The position is restored
+    // afterwards, but not past the new end of file: seeking beyond the end
+    // in write mode would allocate the clusters again.
+    const FSIZE_t prev_pos = f_tell(file);
+    res = f_lseek(file, length);
+    if (res == FR_OK) {
+        res = f_truncate(file);
+    }
+    if (res == FR_OK) {
+        res = f_lseek(file, (prev_pos < (FSIZE_t) length) ? prev_pos : (FSIZE_t) length);
+    }
+    if (res != FR_OK) {
+        ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+        errno = fresult_to_errno(res);
+        ret = -1;
+    }
+
+out:
+    _lock_release(&fat_ctx->lock);
+    return ret;
+}
+
+static int vfs_fat_preallocate_file(FIL* file, FSIZE_t size, bool contiguous)
+{
+    FRESULT res;
+    if (size == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(file->flag & FA_WRITE) || f_size(file) != 0) {
+        errno = EPERM;
+        return -1;
+    }
+    if (contiguous) {
+#if FF_USE_EXPAND
+        // Preconditions of f_expand have been checked above, so FR_DENIED
+        // here means that no contiguous free area was found
+        res = f_expand(file, size, 1);
+        if (res == FR_DENIED) {
+            errno = ENOSPC;
+            return -1;
+        }
+#else
+        errno = ENOSYS;
+        return -1;
+#endif // FF_USE_EXPAND
+    } else {
+        // Seeking past the end of a file opened for writing makes FatFs
+        // allocate the cluster chain up to the new position
+        res = f_lseek(file, size);
+        if (res == FR_OK && f_size(file) < size) {
+            // Ran out of free clusters; release the ones which were allocated
+            f_lseek(file, 0);
+            f_truncate(file);
+            errno = ENOSPC;
+            return -1;
+        }
+        if (res == FR_OK) {
+            res = f_lseek(file, 0);
+        }
+    }
+    if (res != FR_OK) {
+        ESP_LOGD(TAG, "%s: fresult=%d", __func__, res);
+        errno = fresult_to_errno(res);
+        return -1;
+    }
+    return 0;
+}
+
+static int vfs_fat_fcntl(void* ctx, int fd, int cmd, int arg)
+{
+    vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
+    int ret;
+    switch (cmd) {
+        case F_FAT_PREALLOC:
+        case F_FAT_PREALLOC_CONTIG:
+            _lock_acquire(&fat_ctx->lock);
+            ret = vfs_fat_preallocate_file(&fat_ctx->files[fd], (FSIZE_t) (unsigned) arg,
+                                           cmd == F_FAT_PREALLOC_CONTIG);
+            _lock_release(&fat_ctx->lock);
+            break;
+        default:
+            errno = ENOSYS;
+            ret = -1;
+            break;
+    }
+    return ret;
+}
+
+esp_err_t esp_vfs_fat_preallocate(int fd, size_t size, bool contiguous)
+{
+    if (fcntl(fd, contiguous ? F_FAT_PREALLOC_CONTIG : F_FAT_PREALLOC, (int) size) == 0) {
+        return ESP_OK;
+    }
+    switch (errno) {
+        case EBADF:
+        case EINVAL:
+            return ESP_ERR_INVALID_ARG;
+        case EPERM:
+            return ESP_ERR_INVALID_STATE;
+        case ENOSPC:
+            return ESP_ERR_NOT_FOUND;
+        case ENOSYS:
+            return ESP_ERR_NOT_SUPPORTED;
+        default:
+            return ESP_FAIL;
+    }
+}
+
 static int vfs_fat_close(void* ctx, int fd)
 {
     vfs_fat_ctx_t* fat_ctx = (vfs_fat_ctx_t*) ctx;
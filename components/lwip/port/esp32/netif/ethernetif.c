@@ -116,8 +116,18 @@ static err_t ethernet_low_level_output(struct netif *netif, struct pbuf *p)
 
     if (q->next == NULL) {
         ret = esp_netif_transmit(esp_netif, q->payload, q->len);
+    } else if (pbuf_clen(p) <= ESP_NETIF_IOV_MAX) {
+        /* pass the chain to the driver as a list of fragments, without copying it */
+        esp_netif_iovec_t iov[ESP_NETIF_IOV_MAX];
+        size_t iovcnt = 0;
+        for (; q != NULL; q = q->next) {
+            iov[iovcnt].base = q->payload;
+            iov[iovcnt].len = q->len;
+            iovcnt++;
+        }
+        ret = esp_netif_transmit_sg(esp_netif, iov, iovcnt);
     } else {
-        LWIP_DEBUGF(PBUF_DEBUG, ("low_level_output: pbuf is a list, application may has bug"));
+        LWIP_DEBUGF(PBUF_DEBUG, ("low_level_output: pbuf chain too long, copying it"));
         q = pbuf_alloc(PBUF_RAW_TX, p->tot_len, PBUF_RAM);
         if (q != NULL) {
 #if ESP_LWIP
@@ -14,14 +14,32 @@
 
 
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/lock.h>
 #include <esp_system.h>
 #include "esp_crt_bundle.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "mbedtls/sha256.h"
 
 #define BUNDLE_HEADER_OFFSET 2
 #define CRT_HEADER_OFFSET 4
 
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE
+#define KEY_CACHE_SIZE CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE
+#else
+#define KEY_CACHE_SIZE 0
+#endif
+
+#ifdef CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_VERIFIED_CACHE_SIZE
+#define VERIFIED_CACHE_SIZE CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_VERIFIED_CACHE_SIZE
+#else
+#define VERIFIED_CACHE_SIZE 0
+#endif
+
+#define FINGERPRINT_LEN 32
+
 static const char *TAG = "esp-x509-crt-bundle";
 
 /* a dummy certificate so that
@@ -41,27 +59,173 @@ typedef struct crt_bundle_t {
 
 static crt_bundle_t s_crt_bundle;
 
+/* Parsed public key of a root of the bundle */
+typedef struct crt_bundle_key_t {
+    const uint8_t *crt;             /* Entry of the root in the bundle, NULL if unused */
+    mbedtls_pk_context pk;
+    uint32_t last_used;
+    uint16_t users;                 /* Verifications currently using pk */
+} crt_bundle_key_t;
+
+/* Certificate found to be signed by a root of the bundle */
+typedef struct crt_bundle_verified_t {
+    uint8_t fingerprint[FINGERPRINT_LEN];   /* SHA-256 of the DER certificate */
+    uint32_t last_used;                     /* 0 if unused */
+} crt_bundle_verified_t;
+
+/* Both caches refer to the current bundle, they are cleared when it changes */
+static crt_bundle_key_t s_keys[KEY_CACHE_SIZE];
+static crt_bundle_verified_t s_verified[VERIFIED_CACHE_SIZE];
+static uint32_t s_use_count;
+static _lock_t s_cache_lock;
+
 static int esp_crt_verify_callback(void *buf, mbedtls_x509_crt *crt, int data, uint32_t *flags);
-static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_key_buf, size_t pub_key_len);
+static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *crt);
 
 
-static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_key_buf, size_t pub_key_len)
+static inline bool esp_crt_less_recently_used(uint32_t a, uint32_t b)
 {
-    int ret = 0;
-    mbedtls_x509_crt parent;
-    const mbedtls_md_info_t *md_info;
-    unsigned char hash[MBEDTLS_MD_MAX_SIZE];
+    return (int32_t)(a - b) < 0;
+}
 
-    mbedtls_x509_crt_init(&parent);
+/* Get the parsed public key of a root, either from the cache or parsed into local.
+   The key must be given back with esp_crt_key_release() */
+static mbedtls_pk_context *esp_crt_key_acquire(const uint8_t *crt, mbedtls_pk_context *local)
+{
+    crt_bundle_key_t *entry = NULL;
+
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < KEY_CACHE_SIZE; i++) {
+        if (s_keys[i].crt == crt) {
+            entry = &s_keys[i];
+            entry->users++;
+            entry->last_used = ++s_use_count;
+            break;
+        }
+    }
+    _lock_release(&s_cache_lock);
+    if (entry) {
+        return &entry->pk;
+    }
 
-    if ( (ret = mbedtls_pk_parse_public_key(&parent.pk, pub_key_buf, pub_key_len) ) != 0) {
+    size_t name_len = crt[0] << 8 | crt[1];
+    size_t key_len = crt[2] << 8 | crt[3];
+    int ret;
+    mbedtls_pk_init(local);
+    if ( (ret = mbedtls_pk_parse_public_key(local, crt + CRT_HEADER_OFFSET + name_len, key_len) ) != 0) {
         ESP_LOGE(TAG, "PK parse failed with error %X", ret);
-        goto cleanup;
+        mbedtls_pk_free(local);
+        return NULL;
+    }
+
+    /* Keep the key in a free entry, else in place of the least recently used one */
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < KEY_CACHE_SIZE; i++) {
+        crt_bundle_key_t *candidate = &s_keys[i];
+        if (candidate->users) {
+            continue;
+        }
+        if (candidate->crt == NULL) {
+            entry = candidate;
+            break;
+        }
+        if (!entry || esp_crt_less_recently_used(candidate->last_used, entry->last_used)) {
+            entry = candidate;
+        }
+    }
+    if (entry) {
+        if (entry->crt) {
+            mbedtls_pk_free(&entry->pk);
+        }
+        entry->crt = crt;
+        entry->pk = *local;
+        entry->users = 1;
+        entry->last_used = ++s_use_count;
+    }
+    _lock_release(&s_cache_lock);
+    return entry ? &entry->pk : local;
+}
+
+static void esp_crt_key_release(mbedtls_pk_context *pk, mbedtls_pk_context *local)
+{
+    if (pk == local) {
+        mbedtls_pk_free(local);
+        return;
+    }
+    crt_bundle_key_t *entry = (crt_bundle_key_t *)((char *)pk - offsetof(crt_bundle_key_t, pk));
+    _lock_acquire(&s_cache_lock);
+    entry->users--;
+    _lock_release(&s_cache_lock);
+}
+
+static bool esp_crt_verified_find(const uint8_t *fingerprint)
+{
+    bool found = false;
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < VERIFIED_CACHE_SIZE; i++) {
+        if (s_verified[i].last_used && memcmp(s_verified[i].fingerprint, fingerprint, FINGERPRINT_LEN) == 0) {
+            s_verified[i].last_used = ++s_use_count;
+            found = true;
+            break;
+        }
+    }
+    _lock_release(&s_cache_lock);
+    return found;
+}
+
+static void esp_crt_verified_add(const uint8_t *fingerprint)
+{
+    crt_bundle_verified_t *entry = NULL;
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < VERIFIED_CACHE_SIZE; i++) {
+        crt_bundle_verified_t *candidate = &s_verified[i];
+        if (!candidate->last_used) {
+            entry = candidate;
+            break;
+        }
+        if (!entry || esp_crt_less_recently_used(candidate->last_used, entry->last_used)) {
+            entry = candidate;
+        }
+    }
+    if (entry) {
+        memcpy(entry->fingerprint, fingerprint, FINGERPRINT_LEN);
+        entry->last_used = ++s_use_count;
+        /* 0 marks unused entries */
+        if (s_use_count == 0) {
+            entry->last_used = ++s_use_count;
+        }
+    }
+    _lock_release(&s_cache_lock);
+}
+
+/* The bundle must not change while certificates are being verified */
+static void esp_crt_cache_clear(void)
+{
+    _lock_acquire(&s_cache_lock);
+    for (int i = 0; i < KEY_CACHE_SIZE; i++) {
+        if (s_keys[i].crt) {
+            mbedtls_pk_free(&s_keys[i].pk);
+        }
     }
+    memset(s_keys, 0, sizeof(s_keys));
+    memset(s_verified, 0, sizeof(s_verified));
+    _lock_release(&s_cache_lock);
+}
+
+static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *crt)
+{
+    int ret = 0;
+    mbedtls_pk_context local;
+    mbedtls_pk_context *pk;
+    const mbedtls_md_info_t *md_info;
+    unsigned char hash[MBEDTLS_MD_MAX_SIZE];
 
+    if ( (pk = esp_crt_key_acquire(crt, &local)) == NULL) {
+        return MBEDTLS_ERR_X509_FATAL_ERROR;
+    }
 
     // Fast check to avoid expensive computations when not necessary
-    if (!mbedtls_pk_can_do(&parent.pk, child->sig_pk)) {
+    if (!mbedtls_pk_can_do(pk, child->sig_pk)) {
         ESP_LOGE(TAG, "Simple compare failed");
         ret = -1;
         goto cleanup;
@@ -73,7 +237,7 @@ static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_k
         goto cleanup;
     }
 
-    if ( (ret = mbedtls_pk_verify_ext( child->sig_pk, child->sig_opts, &parent.pk,
+    if ( (ret = mbedtls_pk_verify_ext( child->sig_pk, child->sig_opts, pk,
                                        child->sig_md, hash, mbedtls_md_get_size( md_info ),
                                        child->sig.p, child->sig.len )) != 0 ) {
 
@@ -81,7 +245,7 @@ static int esp_crt_check_signature(mbedtls_x509_crt *child, const uint8_t *pub_k
         goto cleanup;
     }
 cleanup:
-    mbedtls_x509_crt_free(&parent);
+    esp_crt_key_release(pk, &local);
 
     return ret;
 }
@@ -136,8 +300,20 @@ int esp_crt_verify_callback(void *buf, mbedtls_x509_crt *crt, int data, uint32_t
 
     int ret = MBEDTLS_ERR_X509_FATAL_ERROR;
     if (crt_found) {
-        size_t key_len = s_crt_bundle.crts[middle][2] << 8 | s_crt_bundle.crts[middle][3];
-        ret = esp_crt_check_signature(child, s_crt_bundle.crts[middle] + CRT_HEADER_OFFSET + name_len, key_len);
+        /* A certificate already found to be signed by a root, usually the intermediate
+           certificate of a server we connected to before, needs no further check */
+        uint8_t fingerprint[FINGERPRINT_LEN];
+        bool use_verified = VERIFIED_CACHE_SIZE > 0 &&
+                            mbedtls_sha256_ret(child->raw.p, child->raw.len, fingerprint, 0) == 0;
+        if (use_verified && esp_crt_verified_find(fingerprint)) {
+            ESP_LOGD(TAG, "Certificate verified before");
+            ret = 0;
+        } else {
+            ret = esp_crt_check_signature(child, s_crt_bundle.crts[middle]);
+            if (ret == 0 && use_verified) {
+                esp_crt_verified_add(fingerprint);
+            }
+        }
     }
 
     if (ret == 0) {
@@ -207,6 +383,7 @@ esp_err_t esp_crt_bundle_attach(void *conf)
 
 void esp_crt_bundle_detach(mbedtls_ssl_config *conf)
 {
+    esp_crt_cache_clear();
     free(s_crt_bundle.crts);
     s_crt_bundle.crts = NULL;
     if (conf) {
@@ -217,6 +394,7 @@ void esp_crt_bundle_detach(mbedtls_ssl_config *conf)
 void esp_crt_bundle_set(const uint8_t *x509_bundle)
 {
     // Free any previously used bundle
+    esp_crt_cache_clear();
     free(s_crt_bundle.crts);
     esp_crt_bundle_init(x509_bundle);
 }
@@ -16,6 +16,7 @@
 #ifndef _ESP_CRT_BUNDLE_H_
 #define _ESP_CRT_BUNDLE_H_
 
+#include "esp_err.h"
 #include "mbedtls/ssl.h"
 
 #ifdef __cplusplus
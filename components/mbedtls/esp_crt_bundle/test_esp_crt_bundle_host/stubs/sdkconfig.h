@@ -0,0 +1,5 @@
+#pragma once
+
+#define CONFIG_MBEDTLS_CERTIFICATE_BUNDLE                   1
+#define CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_KEY_CACHE_SIZE    2
+#define CONFIG_MBEDTLS_CERTIFICATE_BUNDLE_VERIFIED_CACHE_SIZE 8
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "catch.hpp"
+#include "esp_crt_bundle.h"
+#include "mbedtls/x509_crt.h"
+
+/* Bundle generated from cacrt_all.pem and test_roots.pem, linked in as the default one */
+extern const uint8_t x509_crt_imported_bundle_bin_start[] asm("_binary_x509_crt_bundle_start");
+
+namespace {
+
+struct crt_chain {
+    mbedtls_x509_crt crt;
+    explicit crt_chain(const char *path)
+    {
+        mbedtls_x509_crt_init(&crt);
+        REQUIRE(mbedtls_x509_crt_parse_file(&crt, path) >= 0);
+    }
+    ~crt_chain()
+    {
+        mbedtls_x509_crt_free(&crt);
+    }
+};
+
+struct bundle_fixture {
+    mbedtls_ssl_config conf;
+    bundle_fixture()
+    {
+        mbedtls_ssl_config_init(&conf);
+        REQUIRE(esp_crt_bundle_attach(&conf) == ESP_OK);
+    }
+    ~bundle_fixture()
+    {
+        /* Also drops the caches, each test starts cold */
+        esp_crt_bundle_detach(&conf);
+        mbedtls_ssl_config_free(&conf);
+    }
+    /* What mbedtls does with the certificate chain sent by a server during the handshake */
+    int verify(mbedtls_x509_crt *chain)
+    {
+        uint32_t flags = 0;
+        return mbedtls_x509_crt_verify(chain, conf.ca_chain, NULL, NULL, &flags, conf.f_vrfy, conf.p_vrfy);
+    }
+};
+
+std::vector<uint8_t> read_file(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    REQUIRE(file.good());
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST_CASE_METHOD(bundle_fixture, "chains issued by roots of the bundle are verified", "[esp_crt_bundle]")
+{
+    crt_chain rsa("rsa_chain.pem");
+    crt_chain ecc("ecc_chain.pem");
+    for (int i = 0; i < 3; i++) {
+        CHECK(verify(&rsa.crt) == 0);
+        CHECK(verify(&ecc.crt) == 0);
+    }
+}
+
+TEST_CASE_METHOD(bundle_fixture, "certificate not signed by the root of its issuer name is rejected", "[esp_crt_bundle]")
+{
+    crt_chain rsa("rsa_chain.pem");
+    crt_chain rogue("rogue_int.pem");
+    CHECK(verify(&rogue.crt) != 0);
+    CHECK(verify(&rsa.crt) == 0);
+    CHECK(verify(&rogue.crt) != 0);
+}
+
+TEST_CASE_METHOD(bundle_fixture, "changing the bundle drops the certificates verified with the previous one", "[esp_crt_bundle]")
+{
+    crt_chain rsa("rsa_chain.pem");
+    CHECK(verify(&rsa.crt) == 0);
+
+    /* Same name as the RSA test root, another key */
+    std::vector<uint8_t> rogue_bundle = read_file("build/rogue/x509_crt_bundle");
+    esp_crt_bundle_set(rogue_bundle.data());
+    CHECK(verify(&rsa.crt) != 0);
+
+    esp_crt_bundle_set(x509_crt_imported_bundle_bin_start);
+    CHECK(verify(&rsa.crt) == 0);
+}
+
+TEST_CASE_METHOD(bundle_fixture, "repeated verifications skip key parsing and signature checks", "[esp_crt_bundle][timing]")
+{
+    /* Each root of cacrt_all.pem is self-signed, so presenting it as the chain of
+       a server makes the bundle check its signature with its own key */
+    crt_chain roots("../cacrt_all.pem");
+    double first_us = 0;
+    double repeat_us = 0;
+    int verified = 0;
+    for (mbedtls_x509_crt *crt = &roots.crt; crt != NULL && crt->raw.p != NULL; crt = crt->next) {
+        mbedtls_x509_crt *next = crt->next;
+        crt->next = NULL;
+
+        auto start = std::chrono::steady_clock::now();
+        int ret = verify(crt);
+        double first = elapsed_us(start);
+
+        /* Expired roots or weak signatures are rejected by mbedtls before reaching the bundle */
+        if (ret == 0) {
+            start = std::chrono::steady_clock::now();
+            CHECK(verify(crt) == 0);
+            repeat_us += elapsed_us(start);
+            first_us += first;
+            verified++;
+        }
+        crt->next = next;
+    }
+    printf("%d roots of cacrt_all.pem: %.1f us per first verification, %.1f us per repeated one\n",
+           verified, first_us / verified, repeat_us / verified);
+    REQUIRE(verified > 20);
+    CHECK(repeat_us * 2 < first_us);
+
+    crt_chain ecc("ecc_chain.pem");
+    mbedtls_x509_crt *intermediate = ecc.crt.next;
+    const int rounds = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        /* Setting the bundle drops the caches */
+        esp_crt_bundle_set(x509_crt_imported_bundle_bin_start);
+        CHECK(verify(intermediate) == 0);
+    }
+    first_us = elapsed_us(start) / rounds;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        CHECK(verify(intermediate) == 0);
+    }
+    repeat_us = elapsed_us(start) / rounds;
+    printf("ECC intermediate certificate: %.1f us per uncached verification, %.1f us per cached one\n",
+           first_us, repeat_us);
+    CHECK(repeat_us * 2 < first_us);
+}
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdbool.h>
 #include <string.h>
 #include "esp_mbedtls_dynamic_impl.h"
 
@@ -36,14 +37,39 @@ static int tx_buffer_len(mbedtls_ssl_context *ssl, int len)
     if (!len) {
         return MBEDTLS_SSL_OUT_BUFFER_LEN;
     } else {
-        return len + MBEDTLS_SSL_HEADER_LEN
-                   + MBEDTLS_SSL_COMPRESSION_ADD
-                   + MBEDTLS_MAX_IV_LENGTH
-                   + MBEDTLS_SSL_MAC_ADD
-                   + MBEDTLS_SSL_PADDING_ADD;
+        return ESP_MBEDTLS_RECORD_BUFFER_LEN(len);
     }
 }
 
+/**
+ * Between records, ssl->out_buf is a small buffer keeping the counter and IV,
+ * marked by ssl->out_iv being NULL, see esp_mbedtls_free_tx_buffer().
+ */
+static void free_tx_buf(mbedtls_ssl_context *ssl)
+{
+    if (ssl->out_iv) {
+        esp_mbedtls_record_buf_free(ssl->out_buf);
+    } else {
+        mbedtls_free(ssl->out_buf);
+    }
+    ssl->out_buf = NULL;
+}
+
+/**
+ * Between records, ssl->in_ctr is a small buffer keeping the counter and IV,
+ * see esp_mbedtls_free_rx_buffer().
+ */
+static void free_rx_buf(mbedtls_ssl_context *ssl)
+{
+    if (ssl->in_buf) {
+        esp_mbedtls_record_buf_free(ssl->in_buf);
+    } else {
+        mbedtls_free(ssl->in_ctr);
+    }
+    ssl->in_buf = NULL;
+    ssl->in_ctr = NULL;
+}
+
 static void init_tx_buffer(mbedtls_ssl_context *ssl, unsigned char *buf)
 {
     /**
@@ -116,16 +142,15 @@ static void init_rx_buffer(mbedtls_ssl_context *ssl, unsigned char *buf)
     ssl->in_left = 0;
 }
 
-static int esp_mbedtls_alloc_tx_buf(mbedtls_ssl_context *ssl, int len)
+static int esp_mbedtls_alloc_tx_buf(mbedtls_ssl_context *ssl, int len, bool record)
 {
     unsigned char *buf;
 
     if (ssl->out_buf) {
-        mbedtls_free(ssl->out_buf);
-        ssl->out_buf = NULL;
+        free_tx_buf(ssl);
     }
 
-    buf = mbedtls_calloc(1, len);
+    buf = record ? esp_mbedtls_record_buf_alloc(len) : mbedtls_calloc(1, len);
     if (!buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", len);
         return MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -147,7 +172,7 @@ static int esp_mbedtls_alloc_tx_buf(mbedtls_ssl_context *ssl, int len)
 
 int esp_mbedtls_setup_tx_buffer(mbedtls_ssl_context *ssl)
 {
-    CHECK_OK(esp_mbedtls_alloc_tx_buf(ssl, TX_IDLE_BUFFER_SIZE));
+    CHECK_OK(esp_mbedtls_alloc_tx_buf(ssl, TX_IDLE_BUFFER_SIZE, false));
 
     /* mark the out buffer has no data cached */
     ssl->out_iv = NULL;
@@ -163,14 +188,14 @@ void esp_mbedtls_setup_rx_buffer(mbedtls_ssl_context *ssl)
 
 int esp_mbedtls_reset_add_tx_buffer(mbedtls_ssl_context *ssl)
 {
-    return esp_mbedtls_alloc_tx_buf(ssl, MBEDTLS_SSL_OUT_BUFFER_LEN);
+    return esp_mbedtls_alloc_tx_buf(ssl, MBEDTLS_SSL_OUT_BUFFER_LEN, true);
 }
 
 int esp_mbedtls_reset_free_tx_buffer(mbedtls_ssl_context *ssl)
 {
     ESP_LOGV(TAG, "free out buffer @ %p", ssl->out_buf);
 
-    mbedtls_free(ssl->out_buf);
+    esp_mbedtls_record_buf_free(ssl->out_buf);
 
     init_tx_buffer(ssl, NULL);
 
@@ -183,12 +208,9 @@ int esp_mbedtls_reset_add_rx_buffer(mbedtls_ssl_context *ssl)
 {
     unsigned char *buf;
 
-    if (ssl->in_buf) {
-        mbedtls_free(ssl->in_buf);
-        ssl->in_buf = NULL;
-    }
+    free_rx_buf(ssl);
 
-    buf = mbedtls_calloc(1, MBEDTLS_SSL_IN_BUFFER_LEN);
+    buf = esp_mbedtls_record_buf_alloc(MBEDTLS_SSL_IN_BUFFER_LEN);
     if (!buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", MBEDTLS_SSL_IN_BUFFER_LEN);
         return MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -212,9 +234,9 @@ void esp_mbedtls_reset_free_rx_buffer(mbedtls_ssl_context *ssl)
 {
     ESP_LOGV(TAG, "free in buffer @ %p", ssl->in_buf);
 
-    mbedtls_free(ssl->in_buf);
+    esp_mbedtls_record_buf_free(ssl->in_buf);
 
-    init_rx_buffer(ssl, NULL);    
+    init_rx_buffer(ssl, NULL);
 }
 
 int esp_mbedtls_add_tx_buffer(mbedtls_ssl_context *ssl, size_t buffer_len)
@@ -242,7 +264,7 @@ int esp_mbedtls_add_tx_buffer(mbedtls_ssl_context *ssl, size_t buffer_len)
 
     buffer_len = tx_buffer_len(ssl, buffer_len);
 
-    buf = mbedtls_calloc(1, buffer_len);
+    buf = esp_mbedtls_record_buf_alloc(buffer_len);
     if (!buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", buffer_len);
         ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -284,7 +306,7 @@ int esp_mbedtls_free_tx_buffer(mbedtls_ssl_context *ssl)
 
     ESP_LOGV(TAG, "free out buffer @ %p", ssl->out_buf);
 
-    mbedtls_free(ssl->out_buf);
+    esp_mbedtls_record_buf_free(ssl->out_buf);
 
     init_tx_buffer(ssl, NULL);
 
@@ -346,7 +368,7 @@ int esp_mbedtls_add_rx_buffer(mbedtls_ssl_context *ssl)
     ESP_LOGV(TAG, "message length is %d RX buffer length should be %d left is %d",
                 (int)in_msglen, (int)buffer_len, (int)ssl->in_left);
 
-    buf = mbedtls_calloc(1, buffer_len);
+    buf = esp_mbedtls_record_buf_alloc(buffer_len);
     if (!buf) {
         ESP_LOGE(TAG, "alloc(%d bytes) failed", buffer_len);
         ret = MBEDTLS_ERR_SSL_ALLOC_FAILED;
@@ -404,9 +426,9 @@ int esp_mbedtls_free_rx_buffer(mbedtls_ssl_context *ssl)
     memcpy(buf, ssl->in_ctr, 8);
     memcpy(buf + 8, ssl->in_iv, 8);
 
-    ESP_LOGV(TAG, "free in buffer @ %p", ssl->out_buf);
+    ESP_LOGV(TAG, "free in buffer @ %p", ssl->in_buf);
 
-    mbedtls_free(ssl->in_buf);
+    esp_mbedtls_record_buf_free(ssl->in_buf);
 
     init_rx_buffer(ssl, NULL);
 
@@ -426,6 +448,12 @@ exit:
     return ret;
 }
 
+void esp_mbedtls_free_buffers(mbedtls_ssl_context *ssl)
+{
+    free_tx_buf(ssl);
+    free_rx_buf(ssl);
+}
+
 size_t esp_mbedtls_get_crt_size(mbedtls_x509_crt *cert, size_t *num)
 {
     size_t n = 0;
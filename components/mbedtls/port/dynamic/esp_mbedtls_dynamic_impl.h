@@ -44,6 +44,28 @@
  \
 })
 
+/**
+ * Length of a buffer holding a record of _len bytes
+ */
+#define ESP_MBEDTLS_RECORD_BUFFER_LEN(_len) \
+    ((_len) + MBEDTLS_SSL_HEADER_LEN \
+            + MBEDTLS_SSL_COMPRESSION_ADD \
+            + MBEDTLS_MAX_IV_LENGTH \
+            + MBEDTLS_SSL_MAC_ADD \
+            + MBEDTLS_SSL_PADDING_ADD)
+
+/**
+ * Allocate a zeroed TX/RX record buffer, from the pool if one of its slots fits
+ *
+ * @return Buffer, or NULL over the in-flight limit or out of memory
+ */
+unsigned char *esp_mbedtls_record_buf_alloc(size_t len);
+
+/**
+ * Free a buffer from esp_mbedtls_record_buf_alloc(), may be NULL
+ */
+void esp_mbedtls_record_buf_free(unsigned char *buf);
+
 int esp_mbedtls_setup_tx_buffer(mbedtls_ssl_context *ssl);
 
 void esp_mbedtls_setup_rx_buffer(mbedtls_ssl_context *ssl);
@@ -64,6 +86,8 @@ int esp_mbedtls_free_tx_buffer(mbedtls_ssl_context *ssl);
 
 int esp_mbedtls_free_rx_buffer(mbedtls_ssl_context *ssl);
 
+void esp_mbedtls_free_buffers(mbedtls_ssl_context *ssl);
+
 size_t esp_mbedtls_get_crt_size(mbedtls_x509_crt *cert, size_t *num);
 
 #ifdef CONFIG_MBEDTLS_DYNAMIC_FREE_CONFIG_DATA
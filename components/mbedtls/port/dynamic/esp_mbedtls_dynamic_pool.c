@@ -0,0 +1,177 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/lock.h>
+#include <sys/param.h>
+#include "mbedtls/platform_util.h"
+#include "mbedtls/esp_dynamic_buffer.h"
+#include "esp_mbedtls_dynamic_impl.h"
+
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL
+#define POOL_LARGE_NUM  CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_LARGE_NUM
+#define POOL_SMALL_NUM  CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SMALL_NUM
+#else
+#define POOL_LARGE_NUM  0
+#define POOL_SMALL_NUM  0
+#endif
+
+#define POOL_SLOT_NUM   (POOL_SMALL_NUM + POOL_LARGE_NUM)
+
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER_MAX_IN_FLIGHT
+#define MAX_IN_FLIGHT   CONFIG_MBEDTLS_DYNAMIC_BUFFER_MAX_IN_FLIGHT
+#else
+#define MAX_IN_FLIGHT   0
+#endif
+
+/**
+ * A large slot holds any record within the configured content lengths. Incoming
+ * records are given their encrypted length plus the overhead, and handshake
+ * messages MBEDTLS_SSL_OUT_BUFFER_LEN plus the overhead, see esp_mbedtls_add_tx_buffer().
+ */
+#define POOL_LARGE_LEN  ESP_MBEDTLS_RECORD_BUFFER_LEN(MAX(MBEDTLS_SSL_IN_PAYLOAD_LEN, MBEDTLS_SSL_OUT_BUFFER_LEN))
+
+/**
+ * A small slot holds a record of up to 4 KB of content
+ */
+#define POOL_SMALL_LEN  ESP_MBEDTLS_RECORD_BUFFER_LEN(4096 + MBEDTLS_SSL_PAYLOAD_OVERHEAD)
+
+static const char *TAG = "Dynamic Pool";
+
+#if POOL_SLOT_NUM > 0
+typedef struct {
+    unsigned char *buf;     /* Allocated when first needed, then kept */
+    size_t used;            /* Length requested by the holder, 0 if free */
+} pool_slot_t;
+
+/* Small slots first, so that they are preferred when both fit */
+static pool_slot_t s_slots[POOL_SLOT_NUM];
+#endif
+
+static esp_mbedtls_dynamic_buffer_stats_t s_stats;
+static _lock_t s_pool_lock;
+
+#if POOL_SLOT_NUM > 0
+static size_t slot_len(int i)
+{
+    return i < POOL_SMALL_NUM ? POOL_SMALL_LEN : POOL_LARGE_LEN;
+}
+
+static unsigned char *pool_take(size_t len)
+{
+    for (int i = 0; i < POOL_SLOT_NUM; i++) {
+        pool_slot_t *slot = &s_slots[i];
+
+        if (slot->used || slot_len(i) < len) {
+            continue;
+        }
+        if (!slot->buf) {
+            slot->buf = mbedtls_calloc(1, slot_len(i));
+            if (!slot->buf) {
+                ESP_LOGW(TAG, "alloc(%d bytes) of pool slot failed", (int)slot_len(i));
+                continue;
+            }
+            s_stats.pool_bytes += slot_len(i);
+        }
+        slot->used = len;
+        return slot->buf;
+    }
+
+    return NULL;
+}
+
+static bool pool_give(unsigned char *buf)
+{
+    for (int i = 0; i < POOL_SLOT_NUM; i++) {
+        pool_slot_t *slot = &s_slots[i];
+
+        if (slot->buf == buf) {
+            /* Free slots are kept zeroed, and do not keep records of past connections */
+            mbedtls_platform_zeroize(slot->buf, slot->used);
+            slot->used = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+#endif
+
+unsigned char *esp_mbedtls_record_buf_alloc(size_t len)
+{
+    unsigned char *buf = NULL;
+
+    _lock_acquire(&s_pool_lock);
+
+    if (MAX_IN_FLIGHT && s_stats.in_flight >= MAX_IN_FLIGHT) {
+        ESP_LOGW(TAG, "%d buffers in use, refusing %d bytes", (int)s_stats.in_flight, (int)len);
+        s_stats.failures++;
+        goto exit;
+    }
+
+#if POOL_SLOT_NUM > 0
+    buf = pool_take(len);
+    if (buf) {
+        s_stats.pool_allocs++;
+    }
+#endif
+
+    if (!buf) {
+        buf = mbedtls_calloc(1, len);
+        if (!buf) {
+            s_stats.failures++;
+            goto exit;
+        }
+        s_stats.heap_allocs++;
+    }
+
+    s_stats.in_flight++;
+    s_stats.peak_in_flight = MAX(s_stats.peak_in_flight, s_stats.in_flight);
+
+    ESP_LOGV(TAG, "alloc %d bytes @ %p, %d in use", (int)len, buf, (int)s_stats.in_flight);
+
+exit:
+    _lock_release(&s_pool_lock);
+
+    return buf;
+}
+
+void esp_mbedtls_record_buf_free(unsigned char *buf)
+{
+    if (!buf) {
+        return;
+    }
+
+    _lock_acquire(&s_pool_lock);
+
+    s_stats.in_flight--;
+
+#if POOL_SLOT_NUM > 0
+    if (pool_give(buf)) {
+        buf = NULL;
+    }
+#endif
+
+    _lock_release(&s_pool_lock);
+
+    mbedtls_free(buf);
+}
+
+void esp_mbedtls_dynamic_buffer_get_stats(esp_mbedtls_dynamic_buffer_stats_t *stats)
+{
+    _lock_acquire(&s_pool_lock);
+    *stats = s_stats;
+    _lock_release(&s_pool_lock);
+}
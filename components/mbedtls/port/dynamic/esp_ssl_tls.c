@@ -55,14 +55,18 @@ int __wrap_mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config
 {
     CHECK_OK(__real_mbedtls_ssl_setup(ssl, conf));
 
+    /*
+     * Drop both buffers allocated by mbedtls before allocating ours: if that fails,
+     * mbedtls_ssl_free() must not take the input buffer of mbedtls for a record buffer.
+     */
     mbedtls_free(ssl->out_buf);
     ssl->out_buf = NULL;
-    CHECK_OK(esp_mbedtls_setup_tx_buffer(ssl));
-
     mbedtls_free(ssl->in_buf);
     ssl->in_buf = NULL;
     esp_mbedtls_setup_rx_buffer(ssl);
 
+    CHECK_OK(esp_mbedtls_setup_tx_buffer(ssl));
+
     return 0;
 }
 
@@ -98,15 +102,7 @@ int __wrap_mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t
 
 void __wrap_mbedtls_ssl_free(mbedtls_ssl_context *ssl)
 {
-    if (ssl->out_buf) {
-        mbedtls_free(ssl->out_buf);
-        ssl->out_buf = NULL;
-    }
-
-    if (ssl->in_buf) {
-        mbedtls_free(ssl->in_buf);
-        ssl->in_buf = NULL;
-    }
+    esp_mbedtls_free_buffers(ssl);
 
     __real_mbedtls_ssl_free(ssl);
 }
@@ -0,0 +1,4 @@
+#pragma once
+
+/* Lets the test count the allocations of mbedtls */
+#define MBEDTLS_PLATFORM_MEMORY
@@ -0,0 +1,7 @@
+#pragma once
+
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER                   1
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL              1
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_LARGE_NUM    4
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SMALL_NUM    4
+#define CONFIG_MBEDTLS_DYNAMIC_BUFFER_MAX_IN_FLIGHT     16
@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/esp_dynamic_buffer.h"
+
+extern "C" {
+#include "esp_mbedtls_dynamic_impl.h"
+}
+
+namespace {
+
+/* Every allocation of mbedtls goes through here, with its size stored in front of it */
+const size_t ALLOC_HEADER = 16;
+const size_t LARGE_ALLOC = 4096;
+
+std::atomic<unsigned> s_allocs(0);
+std::atomic<unsigned> s_large_allocs(0);
+std::atomic<long> s_allocated(0);
+
+void *counting_calloc(size_t n, size_t size)
+{
+    size_t len = n * size;
+    unsigned char *p = static_cast<unsigned char *>(calloc(1, len + ALLOC_HEADER));
+    if (!p) {
+        return NULL;
+    }
+    memcpy(p, &len, sizeof(len));
+    s_allocs++;
+    if (len >= LARGE_ALLOC) {
+        s_large_allocs++;
+    }
+    s_allocated += len;
+    return p + ALLOC_HEADER;
+}
+
+void counting_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    unsigned char *p = static_cast<unsigned char *>(ptr) - ALLOC_HEADER;
+    size_t len;
+    memcpy(&len, p, sizeof(len));
+    s_allocated -= len;
+    free(p);
+}
+
+/* Before any allocation, as blocks must be freed by the allocator they come from */
+const int s_counting = mbedtls_platform_set_calloc_free(counting_calloc, counting_free);
+
+struct snapshot {
+    unsigned allocs;
+    unsigned large_allocs;
+    esp_mbedtls_dynamic_buffer_stats_t stats;
+    std::chrono::steady_clock::time_point time;
+
+    snapshot() : allocs(s_allocs), large_allocs(s_large_allocs), time(std::chrono::steady_clock::now())
+    {
+        esp_mbedtls_dynamic_buffer_get_stats(&stats);
+    }
+};
+
+struct phase {
+    unsigned allocs;
+    unsigned large_allocs;
+    unsigned pool_buffers;
+    unsigned heap_buffers;
+
+    phase(const snapshot &before, const snapshot &after, const char *name) :
+        allocs(after.allocs - before.allocs),
+        large_allocs(after.large_allocs - before.large_allocs),
+        pool_buffers(after.stats.pool_allocs - before.stats.pool_allocs),
+        heap_buffers(after.stats.heap_allocs - before.stats.heap_allocs)
+    {
+        double ms = std::chrono::duration<double, std::milli>(after.time - before.time).count();
+        printf("%-24s %6u heap allocations, %4u of 4 KB or more, TX/RX buffers: %4u from the pool, %4u from the heap (%.1f ms)\n",
+               name, allocs, large_allocs, pool_buffers, heap_buffers, ms);
+    }
+};
+
+/* One direction of an in-memory connection, blocking like a socket */
+struct byte_pipe {
+    std::mutex lock;
+    std::condition_variable readable;
+    std::deque<unsigned char> data;
+    bool closed = false;
+
+    void close()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        closed = true;
+        readable.notify_all();
+    }
+};
+
+struct endpoint {
+    byte_pipe *in;
+    byte_pipe *out;
+};
+
+int pipe_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    byte_pipe *out = static_cast<endpoint *>(ctx)->out;
+    std::lock_guard<std::mutex> guard(out->lock);
+    if (out->closed) {
+        return MBEDTLS_ERR_SSL_CONN_EOF;
+    }
+    out->data.insert(out->data.end(), buf, buf + len);
+    out->readable.notify_all();
+    return len;
+}
+
+int pipe_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    byte_pipe *in = static_cast<endpoint *>(ctx)->in;
+    std::unique_lock<std::mutex> guard(in->lock);
+    in->readable.wait(guard, [in] { return !in->data.empty() || in->closed; });
+    size_t n = std::min(len, in->data.size());
+    std::copy(in->data.begin(), in->data.begin() + n, buf);
+    in->data.erase(in->data.begin(), in->data.begin() + n);
+    return n;
+}
+
+struct tls_fixture {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_x509_crt cert;
+    mbedtls_pk_context key;
+    mbedtls_ssl_config server_conf;
+    mbedtls_ssl_config client_conf;
+
+    tls_fixture()
+    {
+        REQUIRE(s_counting == 0);
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+        mbedtls_x509_crt_init(&cert);
+        mbedtls_pk_init(&key);
+        mbedtls_ssl_config_init(&server_conf);
+        mbedtls_ssl_config_init(&client_conf);
+
+        REQUIRE(mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, NULL, 0) == 0);
+        REQUIRE(mbedtls_x509_crt_parse_file(&cert, "server_cert.pem") == 0);
+        REQUIRE(mbedtls_pk_parse_keyfile(&key, "server_key.pem", NULL) == 0);
+
+        REQUIRE(mbedtls_ssl_config_defaults(&server_conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                            MBEDTLS_SSL_PRESET_DEFAULT) == 0);
+        mbedtls_ssl_conf_rng(&server_conf, mbedtls_ctr_drbg_random, &drbg);
+        REQUIRE(mbedtls_ssl_conf_own_cert(&server_conf, &cert, &key) == 0);
+
+        REQUIRE(mbedtls_ssl_config_defaults(&client_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                            MBEDTLS_SSL_PRESET_DEFAULT) == 0);
+        mbedtls_ssl_conf_rng(&client_conf, mbedtls_ctr_drbg_random, &drbg);
+        mbedtls_ssl_conf_authmode(&client_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&client_conf, &cert, NULL);
+    }
+
+    ~tls_fixture()
+    {
+        mbedtls_ssl_config_free(&client_conf);
+        mbedtls_ssl_config_free(&server_conf);
+        mbedtls_pk_free(&key);
+        mbedtls_x509_crt_free(&cert);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+    }
+};
+
+struct connection {
+    byte_pipe to_server;
+    byte_pipe to_client;
+    endpoint client_end = {&to_client, &to_server};
+    endpoint server_end = {&to_server, &to_client};
+    mbedtls_ssl_context client;
+    mbedtls_ssl_context server;
+
+    explicit connection(tls_fixture &tls)
+    {
+        mbedtls_ssl_init(&client);
+        mbedtls_ssl_init(&server);
+        REQUIRE(mbedtls_ssl_setup(&client, &tls.client_conf) == 0);
+        REQUIRE(mbedtls_ssl_setup(&server, &tls.server_conf) == 0);
+        REQUIRE(mbedtls_ssl_set_hostname(&client, "localhost") == 0);
+        mbedtls_ssl_set_bio(&client, &client_end, pipe_send, pipe_recv, NULL);
+        mbedtls_ssl_set_bio(&server, &server_end, pipe_send, pipe_recv, NULL);
+    }
+
+    ~connection()
+    {
+        mbedtls_ssl_free(&client);
+        mbedtls_ssl_free(&server);
+    }
+
+    /* Runs the server side in a thread, a failing side closes the pipes so that the other one does not wait forever */
+    template<typename client_fn, typename server_fn>
+    void run(client_fn on_client, server_fn on_server)
+    {
+        int server_ret = 0;
+        std::thread server_thread([&] {
+            server_ret = on_server(&server);
+            if (server_ret != 0) {
+                to_client.close();
+            }
+        });
+        int client_ret = on_client(&client);
+        if (client_ret != 0) {
+            to_server.close();
+        }
+        server_thread.join();
+        CHECK(client_ret == 0);
+        CHECK(server_ret == 0);
+    }
+
+    void handshake()
+    {
+        run(mbedtls_ssl_handshake, mbedtls_ssl_handshake);
+    }
+
+    /* The client sends a request, the server answers with len bytes, like a download */
+    void transfer(size_t len)
+    {
+        static const unsigned char request[] = "GET /large HTTP/1.1\r\n\r\n";
+        std::vector<unsigned char> received;
+
+        run([&](mbedtls_ssl_context *ssl) {
+            int ret = write_all(ssl, request, sizeof(request));
+            std::vector<unsigned char> buf(MBEDTLS_SSL_IN_CONTENT_LEN);
+            while (ret == 0 && received.size() < len) {
+                int n = mbedtls_ssl_read(ssl, buf.data(), buf.size());
+                if (n <= 0) {
+                    return n ? n : -1;
+                }
+                received.insert(received.end(), buf.begin(), buf.begin() + n);
+            }
+            return ret;
+        }, [&](mbedtls_ssl_context *ssl) {
+            unsigned char buf[sizeof(request)];
+            int n = mbedtls_ssl_read(ssl, buf, sizeof(buf));
+            if (n != sizeof(request)) {
+                return n < 0 ? n : -1;
+            }
+            std::vector<unsigned char> response(MBEDTLS_SSL_OUT_CONTENT_LEN);
+            for (size_t sent = 0; sent < len; sent += response.size()) {
+                for (size_t i = 0; i < response.size(); i++) {
+                    response[i] = (sent + i) * 7;
+                }
+                int ret = write_all(ssl, response.data(), std::min(response.size(), len - sent));
+                if (ret != 0) {
+                    return ret;
+                }
+            }
+            return 0;
+        });
+
+        REQUIRE(received.size() == len);
+        for (size_t i = 0; i < len; i++) {
+            if (received[i] != static_cast<unsigned char>(i * 7)) {
+                FAIL("data differs at offset " << i);
+            }
+        }
+    }
+
+    static int write_all(mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len)
+    {
+        while (len > 0) {
+            int n = mbedtls_ssl_write(ssl, buf, len);
+            if (n <= 0) {
+                return n ? n : -1;
+            }
+            buf += n;
+            len -= n;
+        }
+        return 0;
+    }
+};
+
+esp_mbedtls_dynamic_buffer_stats_t get_stats()
+{
+    esp_mbedtls_dynamic_buffer_stats_t stats;
+    esp_mbedtls_dynamic_buffer_get_stats(&stats);
+    return stats;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(tls_fixture, "handshake and bulk transfer take their buffers from the pool", "[dynamic_buffer][timing]")
+{
+    const size_t bulk_len = 1024 * 1024;
+    long allocated = s_allocated;
+    size_t pool_bytes = get_stats().pool_bytes;
+
+    {
+        /* Fills the pool */
+        connection warmup(*this);
+        warmup.handshake();
+        warmup.transfer(bulk_len);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        snapshot start;
+        connection conn(*this);
+        conn.handshake();
+        snapshot handshake_done;
+        conn.transfer(bulk_len);
+        snapshot transfer_done;
+
+        phase handshake(start, handshake_done, "handshake:");
+        phase transfer(handshake_done, transfer_done, "1 MB transfer:");
+        /* Without the pool, each of these would be a heap allocation of up to 16 KB */
+        CHECK(transfer.pool_buffers >= bulk_len / MBEDTLS_SSL_OUT_CONTENT_LEN);
+        CHECK(transfer.heap_buffers == 0);
+        CHECK(transfer.large_allocs == 0);
+    }
+
+    esp_mbedtls_dynamic_buffer_stats_t stats = get_stats();
+    printf("peak of %u TX/RX buffers in use, %u bytes of pool\n",
+           (unsigned)stats.peak_in_flight, (unsigned)stats.pool_bytes);
+    CHECK(stats.in_flight == 0);
+    CHECK(stats.failures == 0);
+    /* Nothing left behind by the connections but the pool */
+    CHECK(s_allocated - allocated == (long)(stats.pool_bytes - pool_bytes));
+}
+
+TEST_CASE("buffers are taken from the smallest fitting pool slot", "[dynamic_buffer]")
+{
+    const size_t small_len = ESP_MBEDTLS_RECORD_BUFFER_LEN(1024);
+    const size_t large_len = ESP_MBEDTLS_RECORD_BUFFER_LEN(MBEDTLS_SSL_IN_PAYLOAD_LEN);
+    esp_mbedtls_dynamic_buffer_stats_t before = get_stats();
+
+    unsigned char *small = esp_mbedtls_record_buf_alloc(small_len);
+    unsigned char *large = esp_mbedtls_record_buf_alloc(large_len);
+    unsigned char *huge = esp_mbedtls_record_buf_alloc(64 * 1024);
+    REQUIRE(small != NULL);
+    REQUIRE(large != NULL);
+    REQUIRE(huge != NULL);
+
+    esp_mbedtls_dynamic_buffer_stats_t stats = get_stats();
+    CHECK(stats.pool_allocs - before.pool_allocs == 2);
+    CHECK(stats.heap_allocs - before.heap_allocs == 1);
+    CHECK(stats.in_flight == 3);
+
+    /* Released slots are zeroed and reused */
+    memset(small, 0xa5, small_len);
+    esp_mbedtls_record_buf_free(small);
+    unsigned char *again = esp_mbedtls_record_buf_alloc(small_len);
+    CHECK(again == small);
+    CHECK(std::vector<unsigned char>(again, again + small_len) == std::vector<unsigned char>(small_len, 0));
+
+    esp_mbedtls_record_buf_free(again);
+    esp_mbedtls_record_buf_free(large);
+    esp_mbedtls_record_buf_free(huge);
+    CHECK(get_stats().in_flight == 0);
+}
+
+TEST_CASE("buffers over the in-flight limit are refused", "[dynamic_buffer]")
+{
+    std::vector<unsigned char *> held;
+    esp_mbedtls_dynamic_buffer_stats_t before = get_stats();
+
+    for (int i = 0; i < CONFIG_MBEDTLS_DYNAMIC_BUFFER_MAX_IN_FLIGHT; i++) {
+        held.push_back(esp_mbedtls_record_buf_alloc(1024));
+        REQUIRE(held.back() != NULL);
+    }
+    CHECK(esp_mbedtls_record_buf_alloc(1024) == NULL);
+
+    esp_mbedtls_dynamic_buffer_stats_t stats = get_stats();
+    /* Large slots take small buffers once the small ones are used */
+    CHECK(stats.pool_allocs - before.pool_allocs ==
+          CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_SMALL_NUM + CONFIG_MBEDTLS_DYNAMIC_BUFFER_POOL_LARGE_NUM);
+    CHECK(stats.failures - before.failures == 1);
+    CHECK(stats.in_flight == CONFIG_MBEDTLS_DYNAMIC_BUFFER_MAX_IN_FLIGHT);
+
+    esp_mbedtls_record_buf_free(held.back());
+    held.pop_back();
+    held.push_back(esp_mbedtls_record_buf_alloc(1024));
+    CHECK(held.back() != NULL);
+
+    for (unsigned char *buf : held) {
+        esp_mbedtls_record_buf_free(buf);
+    }
+    CHECK(get_stats().in_flight == 0);
+}
@@ -0,0 +1,55 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef _ESP_DYNAMIC_BUFFER_H_
+#define _ESP_DYNAMIC_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sdkconfig.h"
+#ifdef CONFIG_MBEDTLS_DYNAMIC_BUFFER
+
+/**
+ * @brief Usage of the TX/RX record buffers, counted over all SSL contexts
+ *
+ * Only the buffers holding records are counted, not the few bytes kept by a
+ * context between records.
+ */
+typedef struct {
+    uint32_t pool_allocs;       /*!< Buffers taken from the pool */
+    uint32_t heap_allocs;       /*!< Buffers allocated from the heap: pool disabled, full, or too small */
+    uint32_t failures;          /*!< Buffers refused, over the in-flight limit or out of memory */
+    uint32_t in_flight;         /*!< Buffers currently held by SSL contexts */
+    uint32_t peak_in_flight;    /*!< Highest number of buffers held at the same time */
+    size_t pool_bytes;          /*!< Memory allocated for the pool, kept once allocated */
+} esp_mbedtls_dynamic_buffer_stats_t;
+
+/**
+ * @brief Get the usage of the TX/RX record buffers
+ *
+ * @param stats Filled with the counters since boot
+ */
+void esp_mbedtls_dynamic_buffer_get_stats(esp_mbedtls_dynamic_buffer_stats_t *stats);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_DYNAMIC_BUFFER_H_ */
@@ -28,6 +28,58 @@ int pthread_condattr_getclock(const pthread_condattr_t * attr, clockid_t * clock
 
 int pthread_condattr_setclock(pthread_condattr_t *attr, clockid_t clock_id);
 
+/* Reader-writer locks, spinlocks and barriers are implemented by the pthread component.
+   Declare them if the newlib configuration of the toolchain doesn't. */
+#ifndef _POSIX_READER_WRITER_LOCKS
+typedef __uint32_t pthread_rwlock_t;
+
+typedef struct {
+    int is_initialized;
+    int process_shared;
+} pthread_rwlockattr_t;
+
+#define PTHREAD_RWLOCK_INITIALIZER ((pthread_rwlock_t) 0xFFFFFFFF)
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr);
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock);
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_timedrdlock(pthread_rwlock_t *rwlock, const struct timespec *abstime);
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_timedwrlock(pthread_rwlock_t *rwlock, const struct timespec *abstime);
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock);
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr);
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr);
+#endif // _POSIX_READER_WRITER_LOCKS
+
+#ifndef _POSIX_SPIN_LOCKS
+typedef __uint32_t pthread_spinlock_t;
+
+int pthread_spin_init(pthread_spinlock_t *lock, int pshared);
+int pthread_spin_destroy(pthread_spinlock_t *lock);
+int pthread_spin_lock(pthread_spinlock_t *lock);
+int pthread_spin_trylock(pthread_spinlock_t *lock);
+int pthread_spin_unlock(pthread_spinlock_t *lock);
+#endif // _POSIX_SPIN_LOCKS
+
+#ifndef _POSIX_BARRIERS
+typedef __uint32_t pthread_barrier_t;
+
+typedef struct {
+    int is_initialized;
+    int process_shared;
+} pthread_barrierattr_t;
+
+#define PTHREAD_BARRIER_SERIAL_THREAD (-1)
+
+int pthread_barrier_init(pthread_barrier_t *barrier, const pthread_barrierattr_t *attr, unsigned count);
+int pthread_barrier_destroy(pthread_barrier_t *barrier);
+int pthread_barrier_wait(pthread_barrier_t *barrier);
+int pthread_barrierattr_init(pthread_barrierattr_t *attr);
+int pthread_barrierattr_destroy(pthread_barrierattr_t *attr);
+#endif // _POSIX_BARRIERS
+
 #ifdef __cplusplus
 }
 #endif
@@ -60,39 +60,3 @@ esp_err_t spi_flash_read(size_t src_addr, void *des_addr, size_t size)
 
     return ESP_OK;
 }
-
-// timing data for ESP8266, 160MHz CPU frequency, 80MHz flash requency
-// all values in microseconds
-// values are for block sizes starting at 4 bytes and going up to 4096 bytes
-static size_t readTimes[] = {7, 5, 6, 7, 11, 18, 32, 60, 118, 231, 459};
-static size_t writeTimes[] = {19, 23, 35, 57, 106, 205, 417, 814, 1622, 3200, 6367};
-static size_t blockEraseTime = 37142;
-
-
-static size_t timeInterp(uint32_t bytes, size_t* lut)
-{
-    const int lut_size = sizeof(readTimes)/sizeof(readTimes[0]);
-    int lz = __builtin_clz(bytes / 4);
-    int log_size = 32 - lz;
-    size_t x2 = 1 << (log_size + 2);
-    size_t y2 = lut[std::min(log_size, lut_size - 1)];
-    size_t x1 = 1 << (log_size + 1);
-    size_t y1 = lut[log_size - 1];
-    return (bytes - x1) * (y2 - y1) / (x2 - x1) + y1;
-}
-
-size_t SpiFlashEmulator::getReadOpTime(uint32_t bytes)
-{
-    return timeInterp(bytes, readTimes);
-}
-
-size_t SpiFlashEmulator::getWriteOpTime(uint32_t bytes)
-{
-    return timeInterp(bytes, writeTimes);
-}
-
-size_t SpiFlashEmulator::getEraseOpTime()
-{
-    return blockEraseTime;
-}
-
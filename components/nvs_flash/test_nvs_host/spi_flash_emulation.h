@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <random>
 #include "esp_spi_flash.h"
+#include "SpiFlashTiming.h"
 #include "catch.hpp"
 
 using std::copy;
@@ -66,7 +67,7 @@ public:
 
         ++mReadOps;
         mReadBytes += size;
-        mTotalTime += getReadOpTime(static_cast<uint32_t>(size));
+        mTiming.read(static_cast<uint32_t>(srcAddr), static_cast<uint32_t>(size));
         return true;
     }
 
@@ -102,7 +103,7 @@ public:
         }
         ++mWriteOps;
         mWriteBytes += size;
-        mTotalTime += getWriteOpTime(static_cast<uint32_t>(size));
+        mTiming.write(static_cast<uint32_t>(dstAddr), static_cast<uint32_t>(size));
         return true;
     }
 
@@ -126,7 +127,7 @@ public:
 
         ++mEraseOps;
         mEraseCnt[sectorNumber]++;
-        mTotalTime += getEraseOpTime();
+        mTiming.erase(static_cast<uint32_t>(sectorNumber * SPI_FLASH_SEC_SIZE), SPI_FLASH_SEC_SIZE);
         return true;
     }
     
@@ -182,7 +183,7 @@ public:
         mEraseOps = 0;
         mReadOps = 0;
         mWriteOps = 0;
-        mTotalTime = 0;
+        mTiming.reset();
     }
 
     size_t getReadOps() const
@@ -207,7 +208,12 @@ public:
     }
     size_t getTotalTime() const
     {
-        return mTotalTime;
+        return static_cast<size_t>(mTiming.get_time_us());
+    }
+
+    SpiFlashTiming& getTiming()
+    {
+        return mTiming;
     }
     
     void setBounds(uint32_t lowerSector, uint32_t upperSector) {
@@ -224,11 +230,6 @@ public:
     }
 
 protected:
-    static size_t getReadOpTime(uint32_t bytes);
-    static size_t getWriteOpTime(uint32_t bytes);
-    static size_t getEraseOpTime();
-
-
     std::vector<uint32_t> mData;
     std::vector<uint32_t> mEraseCnt;
 
@@ -237,7 +238,7 @@ protected:
     mutable size_t mReadBytes = 0;
     mutable size_t mWriteBytes = 0;
     mutable size_t mEraseOps = 0;
-    mutable size_t mTotalTime = 0;
+    mutable SpiFlashTiming mTiming;
     size_t mLowerSectorBound = 0;
     size_t mUpperSectorBound = 0;
     
@@ -0,0 +1,105 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "catch.hpp"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "nvs_test_api.h"
+#include "spi_flash_emulation.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Standard NVS workloads for the flash timing model, see spi_flash/sim/SpiFlashTiming.h.
+ * Run with "make benchmark", results of all storage components use the same format.
+ */
+
+static const uint32_t NVS_FLASH_SECTOR = 6;
+static const uint32_t NVS_FLASH_SECTOR_COUNT = 6;
+
+static void benchmark_begin(SpiFlashEmulator& emu, nvs_handle_t* handle)
+{
+    emu.setBounds(NVS_FLASH_SECTOR, NVS_FLASH_SECTOR + NVS_FLASH_SECTOR_COUNT);
+    REQUIRE(nvs_flash_init_custom(NVS_DEFAULT_PART_NAME, NVS_FLASH_SECTOR, NVS_FLASH_SECTOR_COUNT) == ESP_OK);
+    REQUIRE(nvs_open("bench", NVS_READWRITE, handle) == ESP_OK);
+}
+
+static void benchmark_end(nvs_handle_t handle)
+{
+    nvs_close(handle);
+    REQUIRE(nvs_flash_deinit_partition(NVS_DEFAULT_PART_NAME) == ESP_OK);
+}
+
+TEST_CASE("nvs benchmark: init empty partition", "[nvs][benchmark][.]")
+{
+    SpiFlashEmulator emu(NVS_FLASH_SECTOR + NVS_FLASH_SECTOR_COUNT);
+    nvs_handle_t handle;
+    benchmark_begin(emu, &handle);
+    emu.getTiming().report("nvs: init empty partition");
+    benchmark_end(handle);
+}
+
+TEST_CASE("nvs benchmark: update one u32 key", "[nvs][benchmark][.]")
+{
+    SpiFlashEmulator emu(NVS_FLASH_SECTOR + NVS_FLASH_SECTOR_COUNT);
+    nvs_handle_t handle;
+    benchmark_begin(emu, &handle);
+    emu.clearStats();
+    for (uint32_t i = 0; i < 2000; ++i) {
+        REQUIRE(nvs_set_u32(handle, "counter", i) == ESP_OK);
+        REQUIRE(nvs_commit(handle) == ESP_OK);
+    }
+    emu.getTiming().report("nvs: 2000 updates of one u32 key");
+    benchmark_end(handle);
+}
+
+TEST_CASE("nvs benchmark: write and read many string keys", "[nvs][benchmark][.]")
+{
+    SpiFlashEmulator emu(NVS_FLASH_SECTOR + NVS_FLASH_SECTOR_COUNT);
+    nvs_handle_t handle;
+    benchmark_begin(emu, &handle);
+    char key[16];
+    char value[64];
+    emu.clearStats();
+    for (int i = 0; i < 200; ++i) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value of string key number %d", i);
+        REQUIRE(nvs_set_str(handle, key, value) == ESP_OK);
+    }
+    REQUIRE(nvs_commit(handle) == ESP_OK);
+    emu.getTiming().report("nvs: write 200 string keys");
+
+    emu.clearStats();
+    for (int i = 0; i < 200; ++i) {
+        size_t len = sizeof(value);
+        snprintf(key, sizeof(key), "key%d", i);
+        REQUIRE(nvs_get_str(handle, key, value, &len) == ESP_OK);
+    }
+    emu.getTiming().report("nvs: read 200 string keys");
+    benchmark_end(handle);
+}
+
+TEST_CASE("nvs benchmark: rewrite a 4 KB blob", "[nvs][benchmark][.]")
+{
+    SpiFlashEmulator emu(NVS_FLASH_SECTOR + NVS_FLASH_SECTOR_COUNT);
+    nvs_handle_t handle;
+    benchmark_begin(emu, &handle);
+    uint8_t blob[4096];
+    emu.clearStats();
+    for (int i = 0; i < 50; ++i) {
+        memset(blob, i, sizeof(blob));
+        REQUIRE(nvs_set_blob(handle, "blob", blob, sizeof(blob)) == ESP_OK);
+        REQUIRE(nvs_commit(handle) == ESP_OK);
+    }
+    emu.getTiming().report("nvs: 50 rewrites of a 4 KB blob");
+    benchmark_end(handle);
+}
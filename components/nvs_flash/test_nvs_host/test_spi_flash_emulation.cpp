@@ -84,63 +84,71 @@ TEST_CASE("after erase the sector is set to 0xff", "[spi_flash_emu]")
 
 TEST_CASE("read/write/erase operation times are calculated correctly", "[spi_flash_emu]")
 {
+    // Times come from SpiFlashTiming::default_config(): 10 us per operation,
+    // 100 ns per byte read, 200 ns per byte written plus 600 us per page
+    // programmed, 45 ms per sector erased
     SpiFlashEmulator emu(1);
     uint8_t data[512];
     spi_flash_read(0, data, 4);
-    CHECK(emu.getTotalTime() == 7);
+    CHECK(emu.getTotalTime() == 10);
     CHECK(emu.getReadOps() == 1);
     CHECK(emu.getReadBytes() == 4);
     emu.clearStats();
     spi_flash_read(0, data, 8);
-    CHECK(emu.getTotalTime() == 5);
+    CHECK(emu.getTotalTime() == 10);
     CHECK(emu.getReadOps() == 1);
     CHECK(emu.getReadBytes() == 8);
     emu.clearStats();
     spi_flash_read(0, data, 16);
-    CHECK(emu.getTotalTime() == 6);
+    CHECK(emu.getTotalTime() == 11);
     CHECK(emu.getReadOps() == 1);
     CHECK(emu.getReadBytes() == 16);
     emu.clearStats();
     spi_flash_read(0, data, 128);
-    CHECK(emu.getTotalTime() == 18);
+    CHECK(emu.getTotalTime() == 22);
     CHECK(emu.getReadOps() == 1);
     CHECK(emu.getReadBytes() == 128);
     emu.clearStats();
     spi_flash_read(0, data, 256);
-    CHECK(emu.getTotalTime() == 32);
+    CHECK(emu.getTotalTime() == 35);
     emu.clearStats();
     spi_flash_read(0, data, (128+256)/2);
-    CHECK(emu.getTotalTime() == (18+32)/2);
+    CHECK(emu.getTotalTime() == 29);
     emu.clearStats();
 
     spi_flash_write(0, data, 4);
-    CHECK(emu.getTotalTime() == 19);
+    CHECK(emu.getTotalTime() == 610);
     CHECK(emu.getWriteOps() == 1);
     CHECK(emu.getWriteBytes() == 4);
     emu.clearStats();
     CHECK(emu.getWriteOps() == 0);
     CHECK(emu.getWriteBytes() == 0);
     spi_flash_write(0, data, 8);
-    CHECK(emu.getTotalTime() == 23);
+    CHECK(emu.getTotalTime() == 611);
     emu.clearStats();
     spi_flash_write(0, data, 16);
-    CHECK(emu.getTotalTime() == 35);
+    CHECK(emu.getTotalTime() == 613);
     CHECK(emu.getWriteOps() == 1);
     CHECK(emu.getWriteBytes() == 16);
     emu.clearStats();
     spi_flash_write(0, data, 128);
-    CHECK(emu.getTotalTime() == 205);
+    CHECK(emu.getTotalTime() == 635);
     emu.clearStats();
     spi_flash_write(0, data, 256);
-    CHECK(emu.getTotalTime() == 417);
+    CHECK(emu.getTotalTime() == 661);
     emu.clearStats();
     spi_flash_write(0, data, (128+256)/2);
-    CHECK(emu.getTotalTime() == (205+417)/2);
+    CHECK(emu.getTotalTime() == 648);
+    emu.clearStats();
+    // Crosses a page boundary, so two pages are programmed
+    spi_flash_write(248, data, 16);
+    CHECK(emu.getTotalTime() == 1213);
+    CHECK(emu.getTiming().get_stats().page_programs == 2);
     emu.clearStats();
 
     spi_flash_erase_sector(0);
     CHECK(emu.getEraseOps() == 1);
-    CHECK(emu.getTotalTime() == 37142);
+    CHECK(emu.getTotalTime() == 45010);
 }
 
 TEST_CASE("data is randomized predictably", "[spi_flash_emu]")
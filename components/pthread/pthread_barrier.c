@@ -0,0 +1,145 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// pthread barriers on top of a mutex and a condition variable. Each round of the
+// barrier has a generation number; threads wait until the generation they arrived
+// in is completed, so a thread which leaves the barrier and immediately re-enters
+// it can't be confused with the threads still waking up from the previous round.
+// Destroying the barrier waits for those threads to leave, so the serial thread
+// may destroy it as soon as pthread_barrier_wait() returns.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct esp_pthread_barrier {
+    pthread_mutex_t mutex;          ///< protects the fields below
+    pthread_cond_t cond;            ///< signalled when a round completes
+    unsigned count;                 ///< number of threads to wait for
+    unsigned waiting;               ///< threads arrived in the current round
+    unsigned generation;            ///< incremented on each completed round
+    unsigned leaving;               ///< threads released by a completed round, not returned yet
+} esp_pthread_barrier_t;
+
+int pthread_barrier_init(pthread_barrier_t *barrier, const pthread_barrierattr_t *attr, unsigned count)
+{
+    (void) attr; /* Only process private barriers are supported, which is the default */
+
+    if (barrier == NULL || count == 0) {
+        return EINVAL;
+    }
+
+    esp_pthread_barrier_t *b = (esp_pthread_barrier_t *) calloc(1, sizeof(esp_pthread_barrier_t));
+    if (b == NULL) {
+        return ENOMEM;
+    }
+
+    int ret = pthread_mutex_init(&b->mutex, NULL);
+    if (ret != 0) {
+        free(b);
+        return ret;
+    }
+    ret = pthread_cond_init(&b->cond, NULL);
+    if (ret != 0) {
+        pthread_mutex_destroy(&b->mutex);
+        free(b);
+        return ret;
+    }
+    b->count = count;
+
+    *barrier = (pthread_barrier_t) b;
+    return 0;
+}
+
+int pthread_barrier_destroy(pthread_barrier_t *barrier)
+{
+    if (barrier == NULL || *barrier == (pthread_barrier_t) 0) {
+        return EINVAL;
+    }
+
+    esp_pthread_barrier_t *b = (esp_pthread_barrier_t *) *barrier;
+
+    pthread_mutex_lock(&b->mutex);
+    bool busy = b->waiting > 0;
+    while (!busy && b->leaving > 0) {
+        pthread_cond_wait(&b->cond, &b->mutex);
+    }
+    pthread_mutex_unlock(&b->mutex);
+    if (busy) {
+        return EBUSY;
+    }
+
+    *barrier = (pthread_barrier_t) 0;
+    pthread_cond_destroy(&b->cond);
+    pthread_mutex_destroy(&b->mutex);
+    free(b);
+    return 0;
+}
+
+int pthread_barrier_wait(pthread_barrier_t *barrier)
+{
+    if (barrier == NULL || *barrier == (pthread_barrier_t) 0) {
+        return EINVAL;
+    }
+
+    esp_pthread_barrier_t *b = (esp_pthread_barrier_t *) *barrier;
+    int ret = 0;
+
+    pthread_mutex_lock(&b->mutex);
+    unsigned generation = b->generation;
+    if (++b->waiting == b->count) {
+        b->waiting = 0;
+        b->generation++;
+        b->leaving += b->count - 1;
+        pthread_cond_broadcast(&b->cond);
+        ret = PTHREAD_BARRIER_SERIAL_THREAD;
+    } else {
+        while (generation == b->generation) {
+            pthread_cond_wait(&b->cond, &b->mutex);
+        }
+        if (--b->leaving == 0) {
+            /* Wake up a pending pthread_barrier_destroy() */
+            pthread_cond_broadcast(&b->cond);
+        }
+    }
+    pthread_mutex_unlock(&b->mutex);
+
+    return ret;
+}
+
+int pthread_barrierattr_init(pthread_barrierattr_t *attr)
+{
+    if (attr == NULL) {
+        return EINVAL;
+    }
+    memset(attr, 0, sizeof(*attr));
+    attr->is_initialized = 1;
+    return 0;
+}
+
+int pthread_barrierattr_destroy(pthread_barrierattr_t *attr)
+{
+    if (attr == NULL) {
+        return EINVAL;
+    }
+    attr->is_initialized = 0;
+    return 0;
+}
+
+/* Hook function to force linking this file */
+void pthread_include_pthread_barrier_impl(void)
+{
+}
@@ -13,9 +13,10 @@
 // limitations under the License.
 
 // This is a simple implementation of pthread condition variables. In essence,
-// the waiter creates its own semaphore to wait on and pushes it in the cond var
-// specific list. Upon notify and broadcast, all the waiters for the given cond
-// var are woken up.
+// the waiter pushes its own semaphore in the cond var specific list and waits on
+// it. The semaphore is created once per thread and kept in the pthread thread local
+// storage, so waiting doesn't allocate. Upon notify, the first waiter is removed
+// from the list and woken up; upon broadcast, all of them are.
 
 #include <errno.h>
 #include <pthread.h>
@@ -30,12 +31,15 @@
 #include <sys/queue.h>
 #include <sys/time.h>
 
+#include "pthread_internal.h"
+
 #define LOG_LOCAL_LEVEL CONFIG_LOG_DEFAULT_LEVEL
 #include "esp_log.h"
 const static char *TAG = "esp_pthread";
 
 typedef struct esp_pthread_cond_waiter {
     SemaphoreHandle_t   wait_sem;           ///< task specific semaphore to wait on
+    bool                notified;           ///< set when removed from the list by a notify
     TAILQ_ENTRY(esp_pthread_cond_waiter) link;  ///< stash on the list of semaphores to be notified
 } esp_pthread_cond_waiter_t;
 
@@ -56,6 +60,8 @@ int pthread_cond_signal(pthread_cond_t *cv)
     esp_pthread_cond_waiter_t *entry;
     entry = TAILQ_FIRST(&cond->waiter_list);
     if (entry) {
+        TAILQ_REMOVE(&cond->waiter_list, entry, link);
+        entry->notified = true;
         xSemaphoreGive(entry->wait_sem);
     }
     _lock_release_recursive(&cond->lock);
@@ -73,7 +79,9 @@ int pthread_cond_broadcast(pthread_cond_t *cv)
 
     _lock_acquire_recursive(&cond->lock);
     esp_pthread_cond_waiter_t *entry;
-    TAILQ_FOREACH(entry, &cond->waiter_list, link) {
+    while ((entry = TAILQ_FIRST(&cond->waiter_list)) != NULL) {
+        TAILQ_REMOVE(&cond->waiter_list, entry, link);
+        entry->notified = true;
         xSemaphoreGive(entry->wait_sem);
     }
     _lock_release_recursive(&cond->lock);
@@ -126,7 +134,11 @@ int pthread_cond_timedwait(pthread_cond_t *cv, pthread_mutex_t *mut, const struc
     }
 
     esp_pthread_cond_waiter_t w;
-    w.wait_sem = xSemaphoreCreateCounting(1, 0); /* First get will block */
+    w.wait_sem = pthread_internal_get_wait_sem(); /* Not given, first take will block */
+    w.notified = false;
+    if (w.wait_sem == NULL) {
+        return ENOMEM;
+    }
 
     _lock_acquire_recursive(&cond->lock);
     TAILQ_INSERT_TAIL(&cond->waiter_list, &w, link);
@@ -136,14 +148,19 @@ int pthread_cond_timedwait(pthread_cond_t *cv, pthread_mutex_t *mut, const struc
     if (xSemaphoreTake(w.wait_sem, timeout_ticks) == pdTRUE) {
         ret = 0;
     } else {
-        ret = ETIMEDOUT;
+        _lock_acquire_recursive(&cond->lock);
+        if (w.notified) {
+            /* Notified between the timeout and taking the lock: consume the give,
+               so that the next wait of this thread doesn't return early */
+            xSemaphoreTake(w.wait_sem, 0);
+            ret = 0;
+        } else {
+            TAILQ_REMOVE(&cond->waiter_list, &w, link);
+            ret = ETIMEDOUT;
+        }
+        _lock_release_recursive(&cond->lock);
     }
 
-    _lock_acquire_recursive(&cond->lock);
-    TAILQ_REMOVE(&cond->waiter_list, &w, link);
-    _lock_release_recursive(&cond->lock);
-    vSemaphoreDelete(w.wait_sem);
-
     pthread_mutex_lock(mut);
     return ret;
 }
@@ -13,4 +13,11 @@
 // limitations under the License.
 #pragma once
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
 void pthread_internal_local_storage_destructor_callback(void);
+
+/* Binary semaphore of the calling thread to wait on condition variables, created on first use
+   and deleted with the thread local storage of the thread */
+SemaphoreHandle_t pthread_internal_get_wait_sem(void);
@@ -18,8 +18,8 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "sys/lock.h"
-#include "sys/queue.h"
 
 #include "pthread_internal.h"
 
@@ -27,80 +27,78 @@
 
 typedef void (*pthread_destructor_t)(void*);
 
-/* This is a very naive implementation of key-indexed thread local storage, using two linked lists
-   (one is a global list of registered keys, one per thread for thread local storage values).
+/* Key-indexed thread local storage with O(1) lookup.
 
-   It won't work well if lots of keys & thread-local values are stored (O(n) lookup for both),
-   but it should work for small amounts of data.
+   Keys are indexes in a static table of CONFIG_PTHREAD_KEYS_MAX entries. Each entry has a sequence number
+   which is odd while the key is in use and is incremented by pthread_key_create() and pthread_key_delete().
+
+   Each thread has a dense array of values indexed by key, grown on demand by pthread_setspecific(). A value
+   is only valid if the sequence number stored with it matches the one of the key, so values of a deleted
+   key are never returned for a new key reusing the same index.
 */
-typedef struct key_entry_t_ {
-    pthread_key_t key;
+typedef struct {
+    volatile uint32_t seq;
     pthread_destructor_t destructor;
-    SLIST_ENTRY(key_entry_t_) next;
 } key_entry_t;
 
-// List of all keys created with pthread_key_create()
-SLIST_HEAD(key_list_t, key_entry_t_) s_keys = SLIST_HEAD_INITIALIZER(s_keys);
+static key_entry_t s_keys[CONFIG_PTHREAD_KEYS_MAX];
 
 static portMUX_TYPE s_keys_lock = portMUX_INITIALIZER_UNLOCKED;
 
-// List of all value entries associated with a thread via pthread_setspecific()
-typedef struct value_entry_t_ {
-    pthread_key_t key;
+#define KEY_IN_USE(seq) (((seq) & 1) != 0)
+
+typedef struct {
     void *value;
-    SLIST_ENTRY(value_entry_t_) next;
+    uint32_t seq;
 } value_entry_t;
 
-// Type for the head of the list, as saved as a FreeRTOS thread local storage pointer
-SLIST_HEAD(values_list_t_, value_entry_t_);
-typedef struct values_list_t_ values_list_t;
+// Per-thread data, as saved as a FreeRTOS thread local storage pointer
+typedef struct {
+    SemaphoreHandle_t wait_sem;   ///< semaphore used by this thread to wait on condition variables
+    int num_values;               ///< number of entries in values
+    value_entry_t *values;        ///< values indexed by key
+} thread_data_t;
 
-int pthread_key_create(pthread_key_t *key, pthread_destructor_t destructor)
+/* Keys start from 1, so that 0 is never a valid key */
+static inline int key_to_index(pthread_key_t key)
 {
-    key_entry_t *new_key = malloc(sizeof(key_entry_t));
-    if (new_key == NULL) {
-        return ENOMEM;
-    }
-
-    portENTER_CRITICAL(&s_keys_lock);
-
-    const key_entry_t *head = SLIST_FIRST(&s_keys);
-    new_key->key = (head == NULL) ? 1 : (head->key + 1);
-    new_key->destructor = destructor;
-    *key = new_key->key;
-
-    SLIST_INSERT_HEAD(&s_keys, new_key, next);
-
-    portEXIT_CRITICAL(&s_keys_lock);
-    return 0;
+    return (int)key - 1;
 }
 
-static key_entry_t *find_key(pthread_key_t key)
+int pthread_key_create(pthread_key_t *key, pthread_destructor_t destructor)
 {
+    int ret = EAGAIN;
+
     portENTER_CRITICAL(&s_keys_lock);
-    key_entry_t *result = NULL;;
-    SLIST_FOREACH(result, &s_keys, next) {
-        if(result->key == key) {
+    for (int i = 0; i < CONFIG_PTHREAD_KEYS_MAX; i++) {
+        if (!KEY_IN_USE(s_keys[i].seq)) {
+            s_keys[i].seq++;
+            s_keys[i].destructor = destructor;
+            *key = i + 1;
+            ret = 0;
             break;
         }
     }
     portEXIT_CRITICAL(&s_keys_lock);
-    return result;
+
+    return ret;
 }
 
 int pthread_key_delete(pthread_key_t key)
 {
+    int index = key_to_index(key);
+    if (index < 0 || index >= CONFIG_PTHREAD_KEYS_MAX) {
+        return EINVAL;
+    }
 
     portENTER_CRITICAL(&s_keys_lock);
 
-    /* Ideally, we would also walk all tasks' thread local storage value_list here
-       and delete any values associated with this key. We do not do this...
+    /* Values associated with this key in the threads become stale, as their sequence number
+       doesn't match anymore. Their destructors are not called, as specified by POSIX.
     */
-
-    key_entry_t *entry = find_key(key);
-    if (entry != NULL) {
-        SLIST_REMOVE(&s_keys, entry, key_entry_t_, next);
-        free(entry);
+    if (KEY_IN_USE(s_keys[index].seq)) {
+        s_keys[index].seq++;
+        s_keys[index].destructor = NULL;
     }
 
     portEXIT_CRITICAL(&s_keys_lock);
@@ -122,23 +120,28 @@ int pthread_key_delete(pthread_key_t key)
 */
 static void pthread_local_storage_thread_deleted_callback(int index, void *v_tls)
 {
-    values_list_t *tls = (values_list_t *)v_tls;
+    thread_data_t *tls = (thread_data_t *)v_tls;
     assert(tls != NULL);
 
-    /* Walk the list, freeing all entries and calling destructors if they are registered */
-    value_entry_t *entry = SLIST_FIRST(tls);
-    while(entry != NULL) {
-        // This is a little slow, walking the linked list of keys once per value,
-        // but assumes that the thread's value list will have less entries
-        // than the keys list
-        key_entry_t *key = find_key(entry->key);
-        if (key != NULL && key->destructor != NULL) {
-            key->destructor(entry->value);
+    /* Call the destructors of all the valid non-NULL values */
+    for (int i = 0; i < tls->num_values; i++) {
+        value_entry_t *entry = &tls->values[i];
+        void *value = entry->value;
+        if (value == NULL) {
+            continue;
         }
-        value_entry_t *next_entry = SLIST_NEXT(entry, next);
-        free(entry);
-        entry = next_entry;
+        portENTER_CRITICAL(&s_keys_lock);
+        pthread_destructor_t destructor = (entry->seq == s_keys[i].seq) ? s_keys[i].destructor : NULL;
+        portEXIT_CRITICAL(&s_keys_lock);
+        entry->value = NULL;
+        if (destructor != NULL) {
+            destructor(value);
+        }
+    }
+    if (tls->wait_sem) {
+        vSemaphoreDelete(tls->wait_sem);
     }
+    free(tls->values);
     free(tls);
 }
 
@@ -185,77 +188,94 @@ void pthread_internal_local_storage_destructor_callback(void)
     }
 }
 
-static value_entry_t *find_value(const values_list_t *list, pthread_key_t key)
+static thread_data_t *get_thread_data(bool create)
 {
-    value_entry_t *result = NULL;;
-    SLIST_FOREACH(result, list, next) {
-        if(result->key == key) {
-            break;
+    thread_data_t *tls = (thread_data_t *) pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
+    if (tls == NULL && create) {
+        tls = calloc(1, sizeof(thread_data_t));
+        if (tls == NULL) {
+            return NULL;
         }
+#if defined(CONFIG_FREERTOS_ENABLE_STATIC_TASK_CLEAN_UP)
+        vTaskSetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX, tls);
+#else
+        vTaskSetThreadLocalStoragePointerAndDelCallback(NULL,
+                                                        PTHREAD_TLS_INDEX,
+                                                        tls,
+                                                        pthread_local_storage_thread_deleted_callback);
+#endif
     }
-    return result;
+    return tls;
 }
 
 void *pthread_getspecific(pthread_key_t key)
 {
-    values_list_t *tls = (values_list_t *) pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
-    if (tls == NULL) {
+    thread_data_t *tls = (thread_data_t *) pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
+    int index = key_to_index(key);
+    if (tls == NULL || index < 0 || index >= tls->num_values) {
         return NULL;
     }
 
-    value_entry_t *entry = find_value(tls, key);
-    if(entry != NULL) {
-        return entry->value;
+    value_entry_t *entry = &tls->values[index];
+    if (entry->seq != s_keys[index].seq) {
+        return NULL;
     }
-    return NULL;
+    return entry->value;
 }
 
 int pthread_setspecific(pthread_key_t key, const void *value)
 {
-    key_entry_t *key_entry = find_key(key);
-    if (key_entry == NULL) {
+    int index = key_to_index(key);
+    if (index < 0 || index >= CONFIG_PTHREAD_KEYS_MAX) {
         return ENOENT; // this situation is undefined by pthreads standard
     }
+    uint32_t seq = s_keys[index].seq;
+    if (!KEY_IN_USE(seq)) {
+        return ENOENT;
+    }
 
-    values_list_t *tls = pvTaskGetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX);
+    thread_data_t *tls = get_thread_data(value != NULL);
     if (tls == NULL) {
-        tls = calloc(1, sizeof(values_list_t));
-        if (tls == NULL) {
-            return ENOMEM;
-        }
-#if defined(CONFIG_FREERTOS_ENABLE_STATIC_TASK_CLEAN_UP)
-        vTaskSetThreadLocalStoragePointer(NULL, PTHREAD_TLS_INDEX, tls);
-#else
-        vTaskSetThreadLocalStoragePointerAndDelCallback(NULL,
-                                                        PTHREAD_TLS_INDEX,
-                                                        tls,
-                                                        pthread_local_storage_thread_deleted_callback);
-#endif
+        return (value != NULL) ? ENOMEM : 0;
     }
 
-    value_entry_t *entry = find_value(tls, key);
-    if (entry != NULL) {
-        if (value != NULL) {
-            // cast on next line is necessary as pthreads API uses
-            // 'const void *' here but elsewhere uses 'void *'
-            entry->value = (void *) value;
-        } else { // value == NULL, remove the entry
-            SLIST_REMOVE(tls, entry, value_entry_t_, next);
-            free(entry);
+    if (index >= tls->num_values) {
+        if (value == NULL) {
+            return 0;
+        }
+        /* Grow to the next multiple of 8 keys, new entries have seq 0 which is never in use */
+        int num_values = (index + 8) & ~7;
+        if (num_values > CONFIG_PTHREAD_KEYS_MAX) {
+            num_values = CONFIG_PTHREAD_KEYS_MAX;
         }
-    } else if (value != NULL) {
-        entry = malloc(sizeof(value_entry_t));
-        if (entry == NULL) {
+        value_entry_t *values = realloc(tls->values, num_values * sizeof(value_entry_t));
+        if (values == NULL) {
             return ENOMEM;
         }
-        entry->key = key;
-        entry->value = (void *) value; // see note above about cast
-        SLIST_INSERT_HEAD(tls, entry, next);
+        memset(&values[tls->num_values], 0, (num_values - tls->num_values) * sizeof(value_entry_t));
+        tls->values = values;
+        tls->num_values = num_values;
     }
 
+    // cast on next line is necessary as pthreads API uses
+    // 'const void *' here but elsewhere uses 'void *'
+    tls->values[index].value = (void *) value;
+    tls->values[index].seq = seq;
     return 0;
 }
 
+SemaphoreHandle_t pthread_internal_get_wait_sem(void)
+{
+    thread_data_t *tls = get_thread_data(true);
+    if (tls == NULL) {
+        return NULL;
+    }
+    if (tls->wait_sem == NULL) {
+        tls->wait_sem = xSemaphoreCreateBinary();
+    }
+    return tls->wait_sem;
+}
+
 /* Hook function to force linking this file */
 void pthread_include_pthread_local_storage_impl(void)
 {
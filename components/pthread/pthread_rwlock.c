@@ -0,0 +1,370 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Writer-preferring reader-writer lock. The lock state (number of active readers,
+// owning writer) is protected by a portMUX spinlock, so taking an uncontended lock
+// never calls into the scheduler and readers on both cores proceed in parallel.
+// A thread which has to block queues itself on the reader or writer list and
+// waits on its own semaphore, the same one used by condition variables. Unlock
+// transfers ownership directly to the woken threads (the next writer, or all
+// queued readers at once), so a woken thread never has to retry.
+//
+// Readers don't get the lock while a writer is queued. As a consequence, a thread
+// which already holds a read lock must not take it again while writers may be waiting.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include <sys/queue.h>
+#include <sys/time.h>
+
+#include "pthread_internal.h"
+
+typedef struct esp_pthread_rwlock_waiter {
+    SemaphoreHandle_t   wait_sem;           ///< task specific semaphore to wait on
+    TaskHandle_t        task;               ///< waiting task, becomes the owner for writers
+    bool                granted;            ///< set when the lock has been handed over to the waiter
+    TAILQ_ENTRY(esp_pthread_rwlock_waiter) link;    ///< entry on the reader or writer wait list
+} esp_pthread_rwlock_waiter_t;
+
+typedef TAILQ_HEAD(esp_pthread_rwlock_waiter_list, esp_pthread_rwlock_waiter) esp_pthread_rwlock_waiter_list_t;
+
+typedef struct esp_pthread_rwlock {
+    portMUX_TYPE lock;                      ///< protects all the fields below
+    int active_readers;                     ///< number of threads holding a read lock
+    TaskHandle_t writer;                    ///< thread holding the write lock, NULL if none
+    esp_pthread_rwlock_waiter_list_t reader_waiters;   ///< threads waiting for a read lock
+    esp_pthread_rwlock_waiter_list_t writer_waiters;   ///< threads waiting for the write lock
+} esp_pthread_rwlock_t;
+
+static portMUX_TYPE s_rwlock_init_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_pthread_rwlock_t *rwlock_alloc(void)
+{
+    esp_pthread_rwlock_t *rwlock = (esp_pthread_rwlock_t *) calloc(1, sizeof(esp_pthread_rwlock_t));
+    if (rwlock == NULL) {
+        return NULL;
+    }
+    vPortCPUInitializeMutex(&rwlock->lock);
+    TAILQ_INIT(&rwlock->reader_waiters);
+    TAILQ_INIT(&rwlock->writer_waiters);
+    return rwlock;
+}
+
+static int rwlock_get(pthread_rwlock_t *rwlock, esp_pthread_rwlock_t **out)
+{
+    if (rwlock == NULL || *rwlock == (pthread_rwlock_t) 0) {
+        return EINVAL;
+    }
+
+    if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
+        /* Statically initialized lock, allocate it on first use. Allocation is done outside
+           of the critical section, the loser of a race frees its copy. */
+        esp_pthread_rwlock_t *new_rwlock = rwlock_alloc();
+        if (new_rwlock == NULL) {
+            return ENOMEM;
+        }
+        portENTER_CRITICAL(&s_rwlock_init_lock);
+        if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
+            *rwlock = (pthread_rwlock_t) new_rwlock;
+            new_rwlock = NULL;
+        }
+        portEXIT_CRITICAL(&s_rwlock_init_lock);
+        free(new_rwlock);
+    }
+
+    *out = (esp_pthread_rwlock_t *) *rwlock;
+    return 0;
+}
+
+/* Converts an absolute timeout to ticks, returns 0 if it has already expired */
+static TickType_t abstime_to_ticks(const struct timespec *abstime)
+{
+    if (abstime == NULL) {
+        return portMAX_DELAY;
+    }
+
+    struct timeval abs_time, cur_time, diff_time;
+    gettimeofday(&cur_time, NULL);
+    abs_time.tv_sec = abstime->tv_sec;
+    abs_time.tv_usec = abstime->tv_nsec / 1000;
+    if (!timercmp(&abs_time, &cur_time, >)) {
+        return 0;
+    }
+    timersub(&abs_time, &cur_time, &diff_time);
+    long timeout_msec = (diff_time.tv_sec * 1000) + (diff_time.tv_usec / 1000);
+    TickType_t timeout_ticks = timeout_msec / portTICK_PERIOD_MS;
+    /* Not expired yet, wait for at least one tick */
+    return timeout_ticks > 0 ? timeout_ticks : 1;
+}
+
+/* Hands the lock over to queued threads if it can be granted to them. Must be called inside
+   the critical section; the granted waiters are moved to 'wake' and have to be woken up with
+   rwlock_wake() after leaving it. */
+static void rwlock_grant(esp_pthread_rwlock_t *rw, esp_pthread_rwlock_waiter_list_t *wake)
+{
+    if (rw->writer != NULL) {
+        return;
+    }
+
+    esp_pthread_rwlock_waiter_t *entry = TAILQ_FIRST(&rw->writer_waiters);
+    if (entry != NULL) {
+        if (rw->active_readers == 0) {
+            TAILQ_REMOVE(&rw->writer_waiters, entry, link);
+            rw->writer = entry->task;
+            entry->granted = true;
+            TAILQ_INSERT_TAIL(wake, entry, link);
+        }
+        return;
+    }
+
+    while ((entry = TAILQ_FIRST(&rw->reader_waiters)) != NULL) {
+        TAILQ_REMOVE(&rw->reader_waiters, entry, link);
+        rw->active_readers++;
+        entry->granted = true;
+        TAILQ_INSERT_TAIL(wake, entry, link);
+    }
+}
+
+static void rwlock_wake(esp_pthread_rwlock_waiter_list_t *wake)
+{
+    esp_pthread_rwlock_waiter_t *entry = TAILQ_FIRST(wake);
+    while (entry != NULL) {
+        /* The waiter may return (and its entry go out of scope) as soon as its semaphore is given */
+        esp_pthread_rwlock_waiter_t *next = TAILQ_NEXT(entry, link);
+        xSemaphoreGive(entry->wait_sem);
+        entry = next;
+    }
+}
+
+static int rwlock_lock(pthread_rwlock_t *rwlock, bool write, const struct timespec *abstime, bool try)
+{
+    esp_pthread_rwlock_t *rw;
+    int ret = rwlock_get(rwlock, &rw);
+    if (ret != 0) {
+        return ret;
+    }
+
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    esp_pthread_rwlock_waiter_list_t *queue = write ? &rw->writer_waiters : &rw->reader_waiters;
+
+    portENTER_CRITICAL(&rw->lock);
+    if (rw->writer == self) {
+        portEXIT_CRITICAL(&rw->lock);
+        return EDEADLK;
+    }
+    if (write && rw->writer == NULL && rw->active_readers == 0) {
+        rw->writer = self;
+        portEXIT_CRITICAL(&rw->lock);
+        return 0;
+    }
+    if (!write && rw->writer == NULL && TAILQ_EMPTY(&rw->writer_waiters)) {
+        rw->active_readers++;
+        portEXIT_CRITICAL(&rw->lock);
+        return 0;
+    }
+    portEXIT_CRITICAL(&rw->lock);
+
+    if (try) {
+        return EBUSY;
+    }
+    TickType_t timeout_ticks = abstime_to_ticks(abstime);
+    if (timeout_ticks == 0) {
+        return ETIMEDOUT;
+    }
+
+    esp_pthread_rwlock_waiter_t w;
+    w.wait_sem = pthread_internal_get_wait_sem(); /* Not given, first take will block */
+    w.task = self;
+    w.granted = false;
+    if (w.wait_sem == NULL) {
+        return ENOMEM;
+    }
+
+    esp_pthread_rwlock_waiter_list_t wake = TAILQ_HEAD_INITIALIZER(wake);
+    portENTER_CRITICAL(&rw->lock);
+    TAILQ_INSERT_TAIL(queue, &w, link);
+    /* The lock may have been released since the fast path was checked */
+    rwlock_grant(rw, &wake);
+    portEXIT_CRITICAL(&rw->lock);
+    rwlock_wake(&wake);
+
+    if (xSemaphoreTake(w.wait_sem, timeout_ticks) == pdTRUE) {
+        return 0;
+    }
+
+    TAILQ_INIT(&wake);
+    portENTER_CRITICAL(&rw->lock);
+    if (w.granted) {
+        ret = 0;
+    } else {
+        TAILQ_REMOVE(queue, &w, link);
+        /* A writer giving up may unblock the readers queued behind it */
+        rwlock_grant(rw, &wake);
+        ret = ETIMEDOUT;
+    }
+    portEXIT_CRITICAL(&rw->lock);
+
+    if (ret == 0) {
+        /* Granted between the timeout and the critical section, the give is on its way */
+        xSemaphoreTake(w.wait_sem, portMAX_DELAY);
+    } else {
+        rwlock_wake(&wake);
+    }
+    return ret;
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+    return rwlock_lock(rwlock, false, NULL, false);
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock)
+{
+    return rwlock_lock(rwlock, false, NULL, true);
+}
+
+int pthread_rwlock_timedrdlock(pthread_rwlock_t *rwlock, const struct timespec *abstime)
+{
+    if (abstime == NULL) {
+        return EINVAL;
+    }
+    return rwlock_lock(rwlock, false, abstime, false);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+    return rwlock_lock(rwlock, true, NULL, false);
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+    return rwlock_lock(rwlock, true, NULL, true);
+}
+
+int pthread_rwlock_timedwrlock(pthread_rwlock_t *rwlock, const struct timespec *abstime)
+{
+    if (abstime == NULL) {
+        return EINVAL;
+    }
+    return rwlock_lock(rwlock, true, abstime, false);
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+    if (rwlock == NULL || *rwlock == (pthread_rwlock_t) 0 || *rwlock == PTHREAD_RWLOCK_INITIALIZER) {
+        return EINVAL;
+    }
+
+    esp_pthread_rwlock_t *rw = (esp_pthread_rwlock_t *) *rwlock;
+    esp_pthread_rwlock_waiter_list_t wake = TAILQ_HEAD_INITIALIZER(wake);
+    int ret = 0;
+
+    portENTER_CRITICAL(&rw->lock);
+    if (rw->writer != NULL) {
+        if (rw->writer == xTaskGetCurrentTaskHandle()) {
+            rw->writer = NULL;
+        } else {
+            ret = EPERM;
+        }
+    } else if (rw->active_readers > 0) {
+        rw->active_readers--;
+    } else {
+        ret = EPERM;
+    }
+    if (ret == 0) {
+        rwlock_grant(rw, &wake);
+    }
+    portEXIT_CRITICAL(&rw->lock);
+
+    rwlock_wake(&wake);
+    return ret;
+}
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr)
+{
+    (void) attr; /* Only process private locks are supported, which is the default */
+
+    if (rwlock == NULL) {
+        return EINVAL;
+    }
+
+    esp_pthread_rwlock_t *rw = rwlock_alloc();
+    if (rw == NULL) {
+        return ENOMEM;
+    }
+
+    *rwlock = (pthread_rwlock_t) rw;
+    return 0;
+}
+
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock)
+{
+    if (rwlock == NULL || *rwlock == (pthread_rwlock_t) 0) {
+        return EINVAL;
+    }
+
+    if (*rwlock == PTHREAD_RWLOCK_INITIALIZER) {
+        /* Never used, nothing was allocated */
+        *rwlock = (pthread_rwlock_t) 0;
+        return 0;
+    }
+
+    esp_pthread_rwlock_t *rw = (esp_pthread_rwlock_t *) *rwlock;
+    int ret = 0;
+
+    portENTER_CRITICAL(&rw->lock);
+    if (rw->writer != NULL || rw->active_readers > 0 ||
+        !TAILQ_EMPTY(&rw->reader_waiters) || !TAILQ_EMPTY(&rw->writer_waiters)) {
+        ret = EBUSY;
+    }
+    portEXIT_CRITICAL(&rw->lock);
+
+    if (ret == 0) {
+        *rwlock = (pthread_rwlock_t) 0;
+        free(rw);
+    }
+    return ret;
+}
+
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr)
+{
+    if (attr == NULL) {
+        return EINVAL;
+    }
+    memset(attr, 0, sizeof(*attr));
+    attr->is_initialized = 1;
+    return 0;
+}
+
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr)
+{
+    if (attr == NULL) {
+        return EINVAL;
+    }
+    attr->is_initialized = 0;
+    return 0;
+}
+
+/* Hook function to force linking this file */
+void pthread_include_pthread_rwlock_impl(void)
+{
+}
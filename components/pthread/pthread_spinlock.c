@@ -0,0 +1,103 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// pthread spinlocks use the same compare-and-set primitive as portMUX, but unlike
+// portENTER_CRITICAL they don't disable interrupts or preemption while held: the lock
+// word simply stores the handle of the owning task. Since the owner may be preempted
+// by the spinning task on the same core, a spinner which doesn't get the lock after
+// a while sleeps for a tick to let lower priority owners run.
+
+#include <errno.h>
+#include <pthread.h>
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define SPINLOCK_FREE           0
+#define SPINLOCK_SPINS_BEFORE_SLEEP     1000
+
+static inline bool IRAM_ATTR spinlock_try_acquire(pthread_spinlock_t *lock, uint32_t owner)
+{
+    uint32_t res = owner;
+    uxPortCompareSet((volatile uint32_t *) lock, SPINLOCK_FREE, &res);
+    return res == SPINLOCK_FREE;
+}
+
+int pthread_spin_init(pthread_spinlock_t *lock, int pshared)
+{
+    (void) pshared; /* All threads share the address space */
+
+    if (lock == NULL) {
+        return EINVAL;
+    }
+    *lock = SPINLOCK_FREE;
+    return 0;
+}
+
+int pthread_spin_destroy(pthread_spinlock_t *lock)
+{
+    if (lock == NULL) {
+        return EINVAL;
+    }
+    if (*lock != SPINLOCK_FREE) {
+        return EBUSY;
+    }
+    return 0;
+}
+
+int IRAM_ATTR pthread_spin_lock(pthread_spinlock_t *lock)
+{
+    if (lock == NULL) {
+        return EINVAL;
+    }
+
+    uint32_t self = (uint32_t) xTaskGetCurrentTaskHandle();
+    if (*lock == self) {
+        return EDEADLK;
+    }
+
+    int spins = 0;
+    while (!spinlock_try_acquire(lock, self)) {
+        if (++spins == SPINLOCK_SPINS_BEFORE_SLEEP) {
+            spins = 0;
+            vTaskDelay(1);
+        }
+    }
+    return 0;
+}
+
+int IRAM_ATTR pthread_spin_trylock(pthread_spinlock_t *lock)
+{
+    if (lock == NULL) {
+        return EINVAL;
+    }
+    return spinlock_try_acquire(lock, (uint32_t) xTaskGetCurrentTaskHandle()) ? 0 : EBUSY;
+}
+
+int IRAM_ATTR pthread_spin_unlock(pthread_spinlock_t *lock)
+{
+    if (lock == NULL) {
+        return EINVAL;
+    }
+
+    uint32_t self = (uint32_t) xTaskGetCurrentTaskHandle();
+    uint32_t res = SPINLOCK_FREE;
+    uxPortCompareSet((volatile uint32_t *) lock, self, &res);
+    return res == self ? 0 : EPERM;
+}
+
+/* Hook function to force linking this file */
+void pthread_include_pthread_spinlock_impl(void)
+{
+}
@@ -7,6 +7,7 @@
 #include <pthread.h>
 
 #include "unity.h"
+#include "esp_timer.h"
 
 static void *compute_square(void *arg)
 {
@@ -292,3 +293,108 @@ TEST_CASE("pthread mutex trylock timedlock", "[pthread]")
         pthread_mutex_destroy(&mutex);
     }
 }
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int value;
+    int woken;
+} cond_test_ctx_t;
+
+static void *cond_waiter(void *arg)
+{
+    cond_test_ctx_t *ctx = (cond_test_ctx_t *) arg;
+    pthread_mutex_lock(&ctx->mutex);
+    while (ctx->value == 0) {
+        pthread_cond_wait(&ctx->cond, &ctx->mutex);
+    }
+    ctx->value--;
+    ctx->woken++;
+    pthread_mutex_unlock(&ctx->mutex);
+    return NULL;
+}
+
+TEST_CASE("pthread cond var signals wake one waiter each", "[pthread]")
+{
+    const int NUM_WAITERS = 3;
+    cond_test_ctx_t ctx = { .value = 0, .woken = 0 };
+    pthread_t threads[NUM_WAITERS];
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_init(&ctx.mutex, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_cond_init(&ctx.cond, NULL));
+
+    for (int i = 0; i < NUM_WAITERS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, cond_waiter, &ctx));
+    }
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+
+    /* Back to back signals before any waiter runs must not be lost */
+    pthread_mutex_lock(&ctx.mutex);
+    for (int i = 0; i < NUM_WAITERS; i++) {
+        ctx.value++;
+        pthread_cond_signal(&ctx.cond);
+    }
+    pthread_mutex_unlock(&ctx.mutex);
+
+    for (int i = 0; i < NUM_WAITERS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], NULL));
+    }
+    TEST_ASSERT_EQUAL_INT(NUM_WAITERS, ctx.woken);
+
+    /* A timed out wait doesn't leave a stale wakeup behind */
+    struct timespec abs_timeout;
+    pthread_mutex_lock(&ctx.mutex);
+    for (int i = 0; i < 2; i++) {
+        clock_gettime(CLOCK_REALTIME, &abs_timeout);
+        timespec_add_nano(&abs_timeout, &abs_timeout, 50000000LL);
+        TEST_ASSERT_EQUAL_INT(ETIMEDOUT, pthread_cond_timedwait(&ctx.cond, &ctx.mutex, &abs_timeout));
+    }
+    pthread_mutex_unlock(&ctx.mutex);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_cond_destroy(&ctx.cond));
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_destroy(&ctx.mutex));
+}
+
+#define COND_PING_PONG_ROUNDS 5000
+
+static void *cond_pong(void *arg)
+{
+    cond_test_ctx_t *ctx = (cond_test_ctx_t *) arg;
+    pthread_mutex_lock(&ctx->mutex);
+    for (int i = 0; i < COND_PING_PONG_ROUNDS; i++) {
+        while (ctx->value != 1) {
+            pthread_cond_wait(&ctx->cond, &ctx->mutex);
+        }
+        ctx->value = 0;
+        pthread_cond_signal(&ctx->cond);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+    return NULL;
+}
+
+TEST_CASE("pthread cond var wait and signal performance", "[pthread]")
+{
+    cond_test_ctx_t ctx = { .value = 0 };
+    pthread_t thread;
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_init(&ctx.mutex, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_cond_init(&ctx.cond, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, cond_pong, &ctx));
+
+    int64_t start = esp_timer_get_time();
+    pthread_mutex_lock(&ctx.mutex);
+    for (int i = 0; i < COND_PING_PONG_ROUNDS; i++) {
+        ctx.value = 1;
+        pthread_cond_signal(&ctx.cond);
+        while (ctx.value != 0) {
+            pthread_cond_wait(&ctx.cond, &ctx.mutex);
+        }
+    }
+    pthread_mutex_unlock(&ctx.mutex);
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+    printf("pthread cond var ping-pong: %d round trips in %lld us, %lld us/round trip\n",
+           COND_PING_PONG_ROUNDS, elapsed, elapsed / COND_PING_PONG_ROUNDS);
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_cond_destroy(&ctx.cond));
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_destroy(&ctx.mutex));
+}
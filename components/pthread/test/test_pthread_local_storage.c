@@ -1,6 +1,8 @@
 // Test pthread_create_key, pthread_delete_key, pthread_setspecific, pthread_getspecific
+#include <errno.h>
 #include <pthread.h>
 #include "unity.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "test_utils.h"
@@ -129,3 +131,53 @@ static void task_test_pthread_destructor(void *v_key)
     thread_test_pthread_destructor(v_key);
     vTaskDelete(NULL);
 }
+
+TEST_CASE("pthread local storage values are not kept by reused keys", "[pthread]")
+{
+    pthread_key_t key;
+    int val = 3;
+    TEST_ASSERT_EQUAL(0, pthread_key_create(&key, NULL));
+    TEST_ASSERT_EQUAL(0, pthread_setspecific(key, &val));
+    TEST_ASSERT_EQUAL(0, pthread_key_delete(key));
+    TEST_ASSERT_EQUAL(ENOENT, pthread_setspecific(key, &val));
+
+    pthread_key_t new_key;
+    TEST_ASSERT_EQUAL(0, pthread_key_create(&new_key, NULL));
+    TEST_ASSERT_NULL(pthread_getspecific(new_key));
+    TEST_ASSERT_EQUAL(0, pthread_key_delete(new_key));
+}
+
+TEST_CASE("pthread local storage get and set performance", "[pthread]")
+{
+    const int NUM_KEYS = 16;
+    const int ITERATIONS = 10000;
+    pthread_key_t keys[NUM_KEYS];
+
+    for (int i = 0; i < NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL(0, pthread_key_create(&keys[i], NULL));
+        TEST_ASSERT_EQUAL(0, pthread_setspecific(keys[i], &keys[i]));
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < NUM_KEYS; i++) {
+            pthread_setspecific(keys[i], &keys[(i + n) % NUM_KEYS]);
+        }
+    }
+    int64_t set_time = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < NUM_KEYS; i++) {
+            TEST_ASSERT_NOT_NULL(pthread_getspecific(keys[i]));
+        }
+    }
+    int64_t get_time = esp_timer_get_time() - start;
+
+    printf("pthread_setspecific: %lld ns/op, pthread_getspecific: %lld ns/op with %d keys\n",
+           set_time * 1000 / (ITERATIONS * NUM_KEYS), get_time * 1000 / (ITERATIONS * NUM_KEYS), NUM_KEYS);
+
+    for (int i = 0; i < NUM_KEYS; i++) {
+        TEST_ASSERT_EQUAL(0, pthread_key_delete(keys[i]));
+    }
+}
@@ -0,0 +1,335 @@
+#include <errno.h>
+#include <stdatomic.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_pthread.h"
+#include <pthread.h>
+
+#include "unity.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+static void timespec_after_ms(struct timespec *out, long ms)
+{
+    clock_gettime(CLOCK_REALTIME, out);
+    out->tv_nsec += (ms % 1000) * 1000000L;
+    out->tv_sec += ms / 1000 + out->tv_nsec / 1000000000L;
+    out->tv_nsec %= 1000000000L;
+}
+
+TEST_CASE("pthread rwlock readers share, writers are exclusive", "[pthread]")
+{
+    pthread_rwlock_t rwlock;
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_init(&rwlock, NULL));
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_rdlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_tryrdlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(EBUSY, pthread_rwlock_trywrlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(EBUSY, pthread_rwlock_destroy(&rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(EPERM, pthread_rwlock_unlock(&rwlock));
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_wrlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(EDEADLK, pthread_rwlock_wrlock(&rwlock));
+    TEST_ASSERT_EQUAL_INT(EDEADLK, pthread_rwlock_rdlock(&rwlock));
+
+    struct timespec abs_timeout;
+    timespec_after_ms(&abs_timeout, 50);
+    TEST_ASSERT_EQUAL_INT(EDEADLK, pthread_rwlock_timedwrlock(&rwlock, &abs_timeout));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&rwlock));
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_destroy(&rwlock));
+
+    /* Statically initialized lock is allocated on first use */
+    pthread_rwlock_t static_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_timedrdlock(&static_rwlock, &abs_timeout));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&static_rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_destroy(&static_rwlock));
+}
+
+typedef struct {
+    pthread_rwlock_t rwlock;
+    struct timespec abs_timeout;
+    int ret;
+} rwlock_timeout_ctx_t;
+
+static void *timed_rdlock_thread(void *arg)
+{
+    rwlock_timeout_ctx_t *ctx = (rwlock_timeout_ctx_t *) arg;
+    ctx->ret = pthread_rwlock_timedrdlock(&ctx->rwlock, &ctx->abs_timeout);
+    if (ctx->ret == 0) {
+        pthread_rwlock_unlock(&ctx->rwlock);
+    }
+    return NULL;
+}
+
+static void *timed_wrlock_thread(void *arg)
+{
+    rwlock_timeout_ctx_t *ctx = (rwlock_timeout_ctx_t *) arg;
+    ctx->ret = pthread_rwlock_timedwrlock(&ctx->rwlock, &ctx->abs_timeout);
+    if (ctx->ret == 0) {
+        pthread_rwlock_unlock(&ctx->rwlock);
+    }
+    return NULL;
+}
+
+TEST_CASE("pthread rwlock prefers writers and times out", "[pthread]")
+{
+    rwlock_timeout_ctx_t writer = { .ret = -1 };
+    rwlock_timeout_ctx_t reader = { .ret = -1 };
+    pthread_t writer_thread, reader_thread;
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_init(&writer.rwlock, NULL));
+    reader.rwlock = writer.rwlock;
+
+    /* A writer queued behind a reader blocks new readers */
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_rdlock(&writer.rwlock));
+    timespec_after_ms(&writer.abs_timeout, 1000);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&writer_thread, NULL, timed_wrlock_thread, &writer));
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+    TEST_ASSERT_EQUAL_INT(EBUSY, pthread_rwlock_tryrdlock(&writer.rwlock));
+
+    timespec_after_ms(&reader.abs_timeout, 50);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&reader_thread, NULL, timed_rdlock_thread, &reader));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(reader_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(ETIMEDOUT, reader.ret);
+
+    /* Releasing the last read lock hands the lock over to the writer */
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&writer.rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(writer_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(0, writer.ret);
+
+    /* A writer timing out lets the readers queued behind it in */
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_rdlock(&writer.rwlock));
+    timespec_after_ms(&writer.abs_timeout, 100);
+    timespec_after_ms(&reader.abs_timeout, 1000);
+    reader.ret = -1;
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&writer_thread, NULL, timed_wrlock_thread, &writer));
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&reader_thread, NULL, timed_rdlock_thread, &reader));
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(writer_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(ETIMEDOUT, writer.ret);
+    TEST_ASSERT_EQUAL_INT(0, pthread_join(reader_thread, NULL));
+    TEST_ASSERT_EQUAL_INT(0, reader.ret);
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_unlock(&writer.rwlock));
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_destroy(&writer.rwlock));
+}
+
+#define SPIN_TEST_THREADS       3
+#define SPIN_TEST_INCREMENTS    10000
+
+typedef struct {
+    pthread_spinlock_t lock;
+    int counter;
+} spin_test_ctx_t;
+
+static void *spin_increment_thread(void *arg)
+{
+    spin_test_ctx_t *ctx = (spin_test_ctx_t *) arg;
+    for (int i = 0; i < SPIN_TEST_INCREMENTS; i++) {
+        pthread_spin_lock(&ctx->lock);
+        ctx->counter++;
+        pthread_spin_unlock(&ctx->lock);
+    }
+    return NULL;
+}
+
+TEST_CASE("pthread spinlock", "[pthread]")
+{
+    spin_test_ctx_t ctx = { .counter = 0 };
+    pthread_t threads[SPIN_TEST_THREADS];
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_spin_init(&ctx.lock, PTHREAD_PROCESS_PRIVATE));
+    TEST_ASSERT_EQUAL_INT(0, pthread_spin_trylock(&ctx.lock));
+    TEST_ASSERT_EQUAL_INT(EBUSY, pthread_spin_trylock(&ctx.lock));
+    TEST_ASSERT_EQUAL_INT(EDEADLK, pthread_spin_lock(&ctx.lock));
+    TEST_ASSERT_EQUAL_INT(EBUSY, pthread_spin_destroy(&ctx.lock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_spin_unlock(&ctx.lock));
+    TEST_ASSERT_EQUAL_INT(EPERM, pthread_spin_unlock(&ctx.lock));
+
+    for (int i = 0; i < SPIN_TEST_THREADS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, spin_increment_thread, &ctx));
+    }
+    for (int i = 0; i < SPIN_TEST_THREADS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], NULL));
+    }
+    TEST_ASSERT_EQUAL_INT(SPIN_TEST_THREADS * SPIN_TEST_INCREMENTS, ctx.counter);
+    TEST_ASSERT_EQUAL_INT(0, pthread_spin_destroy(&ctx.lock));
+}
+
+#define BARRIER_TEST_THREADS    4
+#define BARRIER_TEST_ROUNDS     20
+
+typedef struct {
+    pthread_barrier_t barrier;
+    atomic_int arrived;
+    atomic_int serial;
+    atomic_int errors;
+} barrier_test_ctx_t;
+
+static void *barrier_thread(void *arg)
+{
+    barrier_test_ctx_t *ctx = (barrier_test_ctx_t *) arg;
+    for (int round = 0; round < BARRIER_TEST_ROUNDS; round++) {
+        atomic_fetch_add(&ctx->arrived, 1);
+        int ret = pthread_barrier_wait(&ctx->barrier);
+        if (ret == PTHREAD_BARRIER_SERIAL_THREAD) {
+            atomic_fetch_add(&ctx->serial, 1);
+        } else if (ret != 0) {
+            atomic_fetch_add(&ctx->errors, 1);
+        }
+        /* Nobody leaves a round before everybody arrived in it */
+        if (atomic_load(&ctx->arrived) < (round + 1) * BARRIER_TEST_THREADS) {
+            atomic_fetch_add(&ctx->errors, 1);
+        }
+    }
+    return NULL;
+}
+
+TEST_CASE("pthread barrier", "[pthread]")
+{
+    barrier_test_ctx_t ctx;
+    pthread_t threads[BARRIER_TEST_THREADS];
+    atomic_init(&ctx.arrived, 0);
+    atomic_init(&ctx.serial, 0);
+    atomic_init(&ctx.errors, 0);
+
+    TEST_ASSERT_EQUAL_INT(EINVAL, pthread_barrier_init(&ctx.barrier, NULL, 0));
+    TEST_ASSERT_EQUAL_INT(0, pthread_barrier_init(&ctx.barrier, NULL, BARRIER_TEST_THREADS));
+    for (int i = 0; i < BARRIER_TEST_THREADS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, barrier_thread, &ctx));
+    }
+    for (int i = 0; i < BARRIER_TEST_THREADS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], NULL));
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&ctx.errors));
+    TEST_ASSERT_EQUAL_INT(BARRIER_TEST_ROUNDS, atomic_load(&ctx.serial));
+    TEST_ASSERT_EQUAL_INT(0, pthread_barrier_destroy(&ctx.barrier));
+}
+
+#define CONTENTION_READERS      4
+#define CONTENTION_ITERATIONS   2000
+#define CONTENTION_TABLE_SIZE   256
+
+typedef struct {
+    bool use_rwlock;
+    pthread_rwlock_t rwlock;
+    pthread_mutex_t mutex;
+    pthread_barrier_t start;
+    int table[CONTENTION_TABLE_SIZE];
+    atomic_int inside;
+    atomic_int max_inside;
+    atomic_int checksum_errors;
+} contention_ctx_t;
+
+static void *contention_reader(void *arg)
+{
+    contention_ctx_t *ctx = (contention_ctx_t *) arg;
+    pthread_barrier_wait(&ctx->start);
+
+    for (int i = 0; i < CONTENTION_ITERATIONS; i++) {
+        if (ctx->use_rwlock) {
+            pthread_rwlock_rdlock(&ctx->rwlock);
+        } else {
+            pthread_mutex_lock(&ctx->mutex);
+        }
+
+        int inside = atomic_fetch_add(&ctx->inside, 1) + 1;
+        int max_inside = atomic_load(&ctx->max_inside);
+        while (inside > max_inside && !atomic_compare_exchange_weak(&ctx->max_inside, &max_inside, inside)) {
+        }
+        /* Read-mostly cache lookup: the writer keeps the sum of the table at zero */
+        int sum = 0;
+        for (int j = 0; j < CONTENTION_TABLE_SIZE; j++) {
+            sum += ctx->table[j];
+        }
+        if (sum != 0) {
+            atomic_fetch_add(&ctx->checksum_errors, 1);
+        }
+        atomic_fetch_sub(&ctx->inside, 1);
+
+        if (ctx->use_rwlock) {
+            pthread_rwlock_unlock(&ctx->rwlock);
+        } else {
+            pthread_mutex_unlock(&ctx->mutex);
+        }
+    }
+    return NULL;
+}
+
+static int64_t run_contention(contention_ctx_t *ctx)
+{
+    pthread_t threads[CONTENTION_READERS];
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+
+    atomic_init(&ctx->inside, 0);
+    atomic_init(&ctx->max_inside, 0);
+    atomic_init(&ctx->checksum_errors, 0);
+    TEST_ASSERT_EQUAL_INT(0, pthread_barrier_init(&ctx->start, NULL, CONTENTION_READERS + 1));
+
+    for (int i = 0; i < CONTENTION_READERS; i++) {
+        /* Spread the readers over both cores */
+        cfg.pin_to_core = i % portNUM_PROCESSORS;
+        TEST_ESP_OK(esp_pthread_set_cfg(&cfg));
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, contention_reader, ctx));
+    }
+    cfg = esp_pthread_get_default_config();
+    TEST_ESP_OK(esp_pthread_set_cfg(&cfg));
+
+    int64_t start = esp_timer_get_time();
+    pthread_barrier_wait(&ctx->start);
+    /* Meanwhile, the writer updates the table a few times */
+    for (int i = 0; i < 10; i++) {
+        if (ctx->use_rwlock) {
+            pthread_rwlock_wrlock(&ctx->rwlock);
+        } else {
+            pthread_mutex_lock(&ctx->mutex);
+        }
+        ctx->table[i] += i;
+        ctx->table[CONTENTION_TABLE_SIZE - 1 - i] -= i;
+        if (ctx->use_rwlock) {
+            pthread_rwlock_unlock(&ctx->rwlock);
+        } else {
+            pthread_mutex_unlock(&ctx->mutex);
+        }
+    }
+    for (int i = 0; i < CONTENTION_READERS; i++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], NULL));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_barrier_destroy(&ctx->start));
+    TEST_ASSERT_EQUAL_INT(0, atomic_load(&ctx->checksum_errors));
+    return elapsed;
+}
+
+TEST_CASE("pthread rwlock contention performance", "[pthread]")
+{
+    static contention_ctx_t ctx;
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_init(&ctx.rwlock, NULL));
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_init(&ctx.mutex, NULL));
+
+    ctx.use_rwlock = false;
+    int64_t mutex_time = run_contention(&ctx);
+    int mutex_max_inside = atomic_load(&ctx.max_inside);
+
+    ctx.use_rwlock = true;
+    int64_t rwlock_time = run_contention(&ctx);
+    int rwlock_max_inside = atomic_load(&ctx.max_inside);
+
+    printf("%d readers x %d lookups: mutex %lld us (max %d concurrent), rwlock %lld us (max %d concurrent)\n",
+           CONTENTION_READERS, CONTENTION_ITERATIONS, mutex_time, mutex_max_inside, rwlock_time, rwlock_max_inside);
+
+    TEST_ASSERT_EQUAL_INT(1, mutex_max_inside);
+#if !CONFIG_FREERTOS_UNICORE
+    /* Readers on the two cores hold the lock at the same time */
+    TEST_ASSERT_TRUE(rwlock_max_inside >= 2);
+#endif
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_rwlock_destroy(&ctx.rwlock));
+    TEST_ASSERT_EQUAL_INT(0, pthread_mutex_destroy(&ctx.mutex));
+}
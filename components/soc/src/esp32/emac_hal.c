@@ -491,6 +491,60 @@ err:
     return sentout;
 }
 
+uint32_t emac_hal_transmit_multiple_buf_frame(emac_hal_context_t *hal, uint8_t **buffs, uint32_t *lengths, uint32_t buffs_cnt)
+{
+    uint32_t length = 0;
+    for (uint32_t i = 0; i < buffs_cnt; i++) {
+        length += lengths[i];
+    }
+    /* Get the number of Tx buffers to use for the frame, and check they are all owned by CPU */
+    uint32_t bufcount = (length + CONFIG_ETH_DMA_BUFFER_SIZE - 1) / CONFIG_ETH_DMA_BUFFER_SIZE;
+    eth_dma_tx_descriptor_t *desc = hal->tx_desc;
+    for (uint32_t i = 0; i < bufcount; i++) {
+        if (desc->TDES0.Own != EMAC_DMADESC_OWNER_CPU) {
+            return 0;
+        }
+        desc = (eth_dma_tx_descriptor_t *)(desc->Buffer2NextDescAddr);
+    }
+    uint32_t buf_index = 0;
+    uint32_t buf_offset = 0;
+    uint32_t sentout = 0;
+    for (uint32_t i = 0; i < bufcount; i++) {
+        /* gather the fragments of the frame into the DMA buffer */
+        uint8_t *dma_buf = (uint8_t *)(hal->tx_desc->Buffer1Addr);
+        uint32_t dma_len = 0;
+        while (dma_len < CONFIG_ETH_DMA_BUFFER_SIZE && buf_index < buffs_cnt) {
+            uint32_t copy_len = lengths[buf_index] - buf_offset;
+            if (copy_len > CONFIG_ETH_DMA_BUFFER_SIZE - dma_len) {
+                copy_len = CONFIG_ETH_DMA_BUFFER_SIZE - dma_len;
+            }
+            memcpy(dma_buf + dma_len, buffs[buf_index] + buf_offset, copy_len);
+            dma_len += copy_len;
+            buf_offset += copy_len;
+            if (buf_offset == lengths[buf_index]) {
+                buf_index++;
+                buf_offset = 0;
+            }
+        }
+        /* Set FIRST and LAST segment bits */
+        hal->tx_desc->TDES0.FirstSegment = (i == 0);
+        hal->tx_desc->TDES0.LastSegment = (i == bufcount - 1);
+        if (i == bufcount - 1) {
+            /* Enable transmit interrupt */
+            hal->tx_desc->TDES0.InterruptOnComplete = 1;
+        }
+        /* Program size */
+        hal->tx_desc->TDES1.TransmitBuffer1Size = dma_len;
+        sentout += dma_len;
+        /* Set Own bit of the Tx descriptor Status: gives the buffer back to ETHERNET DMA */
+        hal->tx_desc->TDES0.Own = EMAC_DMADESC_OWNER_DMA;
+        /* Point to next descriptor */
+        hal->tx_desc = (eth_dma_tx_descriptor_t *)(hal->tx_desc->Buffer2NextDescAddr);
+    }
+    hal->dma_regs->dmatxpolldemand = 0;
+    return sentout;
+}
+
 uint32_t emac_hal_receive_frame(emac_hal_context_t *hal, uint8_t *buf, uint32_t size, uint32_t *frames_remain)
 {
     eth_dma_rx_descriptor_t *desc_iter = NULL;
@@ -30,6 +30,7 @@ static const char TAG[] = "spi_flash";
 
 #define MAX_WRITE_CHUNK 8192 /* write in chunks */
 #define MAX_READ_CHUNK 16384
+#define BLOCK32_ERASE_SIZE (32 * 1024)
 
 
 #ifdef CONFIG_SPI_FLASH_DANGEROUS_WRITE_ABORTS
@@ -302,6 +303,7 @@ esp_err_t IRAM_ATTR esp_flash_erase_region(esp_flash_t *chip, uint32_t start, ui
     VERIFY_OP(erase_block);
     CHECK_WRITE_ADDRESS(chip, start, len);
     uint32_t block_erase_size = chip->chip_drv->erase_block == NULL ? 0 : chip->chip_drv->block_erase_size;
+    uint32_t block32_erase_size = (chip->chip_drv->erase_block_32k == NULL || block_erase_size <= BLOCK32_ERASE_SIZE) ? 0 : BLOCK32_ERASE_SIZE;
     uint32_t sector_size = chip->chip_drv->sector_size;
 
     if (sector_size == 0 || (block_erase_size % sector_size) != 0) {
@@ -357,6 +359,11 @@ esp_err_t IRAM_ATTR esp_flash_erase_region(esp_flash_t *chip, uint32_t start, ui
             err = chip->chip_drv->erase_block(chip, start);
             start += block_erase_size;
             len -= block_erase_size;
+        } else if (block32_erase_size > 0 && len >= block32_erase_size && (start % block32_erase_size) == 0) {
+            // Head or tail of the region is not aligned to the large block, but may still contain 32KB blocks
+            err = chip->chip_drv->erase_block_32k(chip, start);
+            start += block32_erase_size;
+            len -= block32_erase_size;
         } else
 #endif
         {
@@ -137,8 +137,9 @@ esp_err_t esp_flash_erase_chip(esp_flash_t *chip);
  * returned if the start & length are not a multiple of this size.
  *
  * Erase is performed using block (multi-sector) erases where possible (block size is specified in
- * chip->drv->block_erase_size field, typically 65536 bytes). Remaining sectors are erased using individual sector erase
- * commands.
+ * chip->drv->block_erase_size field, typically 65536 bytes). If the chip driver supports 32KB block erase, it is used for
+ * 32KB aligned parts of the region which are too small or not aligned for the large block erase. Remaining sectors are
+ * erased using individual sector erase commands.
  *
  * @return ESP_OK on success, or a flash error code if operation failed.
  */
@@ -271,6 +271,97 @@ esp_err_t esp_partition_write(const esp_partition_t* partition,
 esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
                                     size_t offset, size_t size);
 
+/**
+ * @brief Opaque handle of a background erase operation
+ *
+ * Obtained using esp_partition_erase_range_async, released by
+ * esp_partition_erase_end or esp_partition_erase_abort.
+ */
+typedef struct esp_partition_erase_job_* esp_partition_erase_handle_t;
+
+/**
+ * @brief Erase part of the partition in a background task
+ *
+ * The range is erased from the lowest to the highest address, in steps which
+ * end at 64 kilobyte boundaries of the flash chip, so that large ranges are
+ * erased using block erase commands. While the erase is running, data can be
+ * written to the part of the range which is already erased; use
+ * esp_partition_erase_wait to wait until the erase has passed a given offset.
+ *
+ * Each call must be paired with a call to esp_partition_erase_end or
+ * esp_partition_erase_abort, which waits for the task to stop and frees
+ * the resources.
+ *
+ * @param partition Pointer to partition structure obtained using
+ *                  esp_partition_find_first or esp_partition_get.
+ *                  Must be non-NULL and must remain valid until the operation ends.
+ * @param offset Offset from the beginning of partition where erase operation
+ *               should start. Must be aligned to 4 kilobytes.
+ * @param size Size of the range which should be erased, in bytes.
+ *             Must be divisible by 4 kilobytes.
+ * @param[out] out_handle Handle of the started operation.
+ *
+ * @return ESP_OK, if the erase task was started;
+ *         ESP_ERR_INVALID_ARG, if offset is not aligned or out_handle is NULL;
+ *         ESP_ERR_INVALID_SIZE, if erase would go out of bounds of the partition;
+ *         ESP_ERR_NO_MEM, if the task could not be created.
+ */
+esp_err_t esp_partition_erase_range_async(const esp_partition_t* partition,
+                                          size_t offset, size_t size,
+                                          esp_partition_erase_handle_t* out_handle);
+
+/**
+ * @brief Wait until the background erase reaches given offset
+ *
+ * Blocks until all of the range passed to esp_partition_erase_range_async
+ * which lies below end_offset is erased. Must not be called by more than one
+ * task at the same time for the same handle.
+ *
+ * @param handle Handle obtained using esp_partition_erase_range_async.
+ * @param end_offset Offset from the beginning of partition. Offsets past the
+ *                   end of the range wait for the whole range to be erased.
+ *
+ * @return ESP_OK, if the range below end_offset is erased;
+ *         ESP_ERR_INVALID_ARG, if handle is NULL;
+ *         ESP_ERR_INVALID_STATE, if the operation was aborted;
+ *         or one of error codes from lower-level flash driver if erase failed.
+ */
+esp_err_t esp_partition_erase_wait(esp_partition_erase_handle_t handle, size_t end_offset);
+
+/**
+ * @brief Get the offset up to which the background erase has progressed
+ *
+ * @param handle Handle obtained using esp_partition_erase_range_async. Must be non-NULL.
+ *
+ * @return Offset from the beginning of partition; the range between the start
+ *         offset of the operation and this offset is erased.
+ */
+size_t esp_partition_erase_get_erased_offset(esp_partition_erase_handle_t handle);
+
+/**
+ * @brief Wait for the background erase to complete and release the handle
+ *
+ * @param handle Handle obtained using esp_partition_erase_range_async.
+ *
+ * @return ESP_OK, if the whole range was erased;
+ *         ESP_ERR_INVALID_ARG, if handle is NULL;
+ *         or one of error codes from lower-level flash driver if erase failed.
+ */
+esp_err_t esp_partition_erase_end(esp_partition_erase_handle_t handle);
+
+/**
+ * @brief Stop the background erase and release the handle
+ *
+ * The erase step in progress is completed before the task stops, the rest
+ * of the range is left as it is.
+ *
+ * @param handle Handle obtained using esp_partition_erase_range_async.
+ *
+ * @return ESP_OK, if the operation was stopped;
+ *         ESP_ERR_INVALID_ARG, if handle is NULL.
+ */
+esp_err_t esp_partition_erase_abort(esp_partition_erase_handle_t handle);
+
 /**
  * @brief Configure MMU to map partition into data memory
  *
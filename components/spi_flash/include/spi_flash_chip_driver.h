@@ -86,6 +86,13 @@ struct spi_flash_chip_t {
      */
     esp_err_t (*erase_block)(esp_flash_t *chip, uint32_t block_address);
 
+    /* Erase a 32KB block of the chip. Optional, set to NULL if the chip doesn't support 32KB block erase.
+       Only used if 'block_erase_size' is larger than 32KB. block_address is an offset in bytes.
+
+       Caller has verified that this block should be non-write-protected.
+     */
+    esp_err_t (*erase_block_32k)(esp_flash_t *chip, uint32_t block_address);
+
     uint32_t sector_size; /* Sector is minimum erase size */
     uint32_t block_erase_size; /* Optimal (fastest) block size for multi-sector erases on this chip */
 
@@ -100,6 +100,18 @@ esp_err_t spi_flash_chip_generic_erase_sector(esp_flash_t *chip, uint32_t start_
  */
 esp_err_t spi_flash_chip_generic_erase_block(esp_flash_t *chip, uint32_t start_address);
 
+/**
+ * @brief Erase block by the generic 32KB block erase command
+ *
+ * @param chip Pointer to SPI flash chip to use. If NULL, esp_flash_default_chip is substituted.
+ * @param start_address Start address of the block to erase, aligned to 32KB
+ *
+ * @return
+ *      - ESP_OK if success
+ *      - or other error passed from the ``set_write_protect``, ``wait_idle`` or ``common_command`` function of host driver
+ */
+esp_err_t spi_flash_chip_generic_erase_block_32k(esp_flash_t *chip, uint32_t start_address);
+
 /**
  * @brief Read from flash by using a read command that matches the programmed
  * read mode.
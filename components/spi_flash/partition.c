@@ -17,6 +17,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <sys/lock.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_flash_partitions.h"
 #include "esp_attr.h"
 #include "esp_flash.h"
@@ -30,6 +34,11 @@
 
 #define HASH_LEN 32 /* SHA-256 digest length */
 
+/* Background erase advances in steps which end at 64kB block boundaries,
+ * so that every full step is erased with a single block erase command.
+ */
+#define ERASE_ASYNC_STEP_SIZE (64 * 1024)
+
 #ifndef NDEBUG
 // Enable built-in checks in queue.h in debug builds
 #define INVARIANTS
@@ -44,6 +53,18 @@ typedef struct partition_list_item_ {
     SLIST_ENTRY(partition_list_item_) next;
 } partition_list_item_t;
 
+typedef struct esp_partition_erase_job_ {
+    const esp_partition_t* partition;
+    size_t start;                               // offset of the range being erased
+    size_t end;                                 // end offset of the range being erased
+    volatile size_t erased_end;                 // [start, erased_end) is already erased
+    volatile bool done;                         // set by the erase task when it has stopped
+    volatile bool abort;                        // request to stop before the whole range is erased
+    esp_err_t result;                           // valid once 'done' is set
+    SemaphoreHandle_t progress;                 // given after each step, taken by the waiting task
+    SemaphoreHandle_t finished;                 // given by the erase task as its last action
+} esp_partition_erase_job_t;
+
 typedef struct esp_partition_iterator_opaque_ {
     esp_partition_type_t type;                  // requested type
     esp_partition_subtype_t subtype;               // requested subtype
@@ -402,10 +423,8 @@ esp_err_t esp_partition_write(const esp_partition_t* partition,
     }
 }
 
-esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
-                                    size_t offset, size_t size)
+static esp_err_t check_erase_range(const esp_partition_t* partition, size_t offset, size_t size)
 {
-    assert(partition != NULL);
     if (offset > partition->size) {
         return ESP_ERR_INVALID_ARG;
     }
@@ -418,6 +437,14 @@ esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
     if (offset % SPI_FLASH_SEC_SIZE != 0) {
         return ESP_ERR_INVALID_ARG;
     }
+    return ESP_OK;
+}
+
+/* The flash driver splits the range into the largest aligned block erases
+ * the chip supports, and erases remaining sectors one by one.
+ */
+static esp_err_t erase_range(const esp_partition_t* partition, size_t offset, size_t size)
+{
 #ifndef CONFIG_SPI_FLASH_USE_LEGACY_IMPL
     return esp_flash_erase_region(partition->flash_chip, partition->address + offset, size);
 #else
@@ -425,6 +452,140 @@ esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
 #endif // CONFIG_SPI_FLASH_USE_LEGACY_IMPL
 }
 
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition,
+                                    size_t offset, size_t size)
+{
+    assert(partition != NULL);
+    esp_err_t err = check_erase_range(partition, offset, size);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return erase_range(partition, offset, size);
+}
+
+static void erase_job_task(void* arg)
+{
+    esp_partition_erase_job_t* job = (esp_partition_erase_job_t*) arg;
+    esp_err_t err = ESP_OK;
+
+    while (err == ESP_OK && job->erased_end < job->end && !job->abort) {
+        size_t address = job->partition->address + job->erased_end;
+        size_t step = MIN(job->end - job->erased_end, ERASE_ASYNC_STEP_SIZE - address % ERASE_ASYNC_STEP_SIZE);
+        err = erase_range(job->partition, job->erased_end, step);
+        if (err == ESP_OK) {
+            job->erased_end += step;
+        }
+        xSemaphoreGive(job->progress);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "background erase of partition '%s' failed at offset 0x%x (0x%x)",
+                 job->partition->label, job->erased_end, err);
+    }
+    job->result = err;
+    job->done = true;
+    xSemaphoreGive(job->progress);
+    // Job must not be accessed after this, it may be freed by esp_partition_erase_end
+    xSemaphoreGive(job->finished);
+    vTaskDelete(NULL);
+}
+
+static void erase_job_free(esp_partition_erase_job_t* job)
+{
+    if (job->progress) {
+        vSemaphoreDelete(job->progress);
+    }
+    if (job->finished) {
+        vSemaphoreDelete(job->finished);
+    }
+    free(job);
+}
+
+esp_err_t esp_partition_erase_range_async(const esp_partition_t* partition,
+                                          size_t offset, size_t size,
+                                          esp_partition_erase_handle_t* out_handle)
+{
+    assert(partition != NULL);
+    if (out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = check_erase_range(partition, offset, size);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    esp_partition_erase_job_t* job = (esp_partition_erase_job_t*) calloc(1, sizeof(esp_partition_erase_job_t));
+    if (job == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    job->partition = partition;
+    job->start = offset;
+    job->end = offset + size;
+    job->erased_end = offset;
+    job->progress = xSemaphoreCreateBinary();
+    job->finished = xSemaphoreCreateBinary();
+    if (job->progress == NULL || job->finished == NULL) {
+        erase_job_free(job);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out_handle = job;
+    if (xTaskCreate(erase_job_task, "partition_erase", CONFIG_SPI_FLASH_ERASE_TASK_STACK_SIZE,
+                    job, CONFIG_SPI_FLASH_ERASE_TASK_PRIORITY, NULL) != pdPASS) {
+        *out_handle = NULL;
+        erase_job_free(job);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_wait(esp_partition_erase_handle_t handle, size_t end_offset)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t target = MIN(MAX(end_offset, handle->start), handle->end);
+    while (handle->erased_end < target) {
+        if (handle->done) {
+            return handle->result != ESP_OK ? handle->result : ESP_ERR_INVALID_STATE;
+        }
+        xSemaphoreTake(handle->progress, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+size_t esp_partition_erase_get_erased_offset(esp_partition_erase_handle_t handle)
+{
+    assert(handle != NULL);
+    return handle->erased_end;
+}
+
+static esp_err_t erase_job_finish(esp_partition_erase_handle_t handle)
+{
+    xSemaphoreTake(handle->finished, portMAX_DELAY);
+    esp_err_t err = handle->result;
+    erase_job_free(handle);
+    return err;
+}
+
+esp_err_t esp_partition_erase_end(esp_partition_erase_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return erase_job_finish(handle);
+}
+
+esp_err_t esp_partition_erase_abort(esp_partition_erase_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->abort = true;
+    erase_job_finish(handle);
+    return ESP_OK;
+}
+
 /*
  * Note: current implementation ignores the possibility of multiple regions in the same partition being
  * mapped. Reference counting and address space re-use is delegated to spi_flash_mmap.
@@ -37,6 +37,7 @@
 #define CMD_CHIP_ERASE 0xC7
 #define CMD_SECTOR_ERASE 0x20
 #define CMD_LARGE_BLOCK_ERASE 0xD8 /* 64KB block erase command */
+#define CMD_BLOCK_ERASE_32K 0x52 /* 32KB block erase command */
 #define CMD_PROGRAM_PAGE 0x02
 
 #define CMD_RST_EN      0x66
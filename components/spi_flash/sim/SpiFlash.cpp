@@ -63,6 +63,8 @@ void SpiFlash::init(uint32_t chip_size, uint32_t block_size, uint32_t sector_siz
 
     this->total_erase_cycles = 0;
 
+    this->timing.reset();
+
     // Load partitions table bin
     this->memory = (uint8_t *) malloc(this->chip_size);
     memset(this->memory, 0xFF, this->chip_size);
@@ -114,14 +116,42 @@ esp_rom_spiflash_result_t SpiFlash::erase_block(uint32_t block)
     uint32_t sectors_per_block = (this->block_size / this->sector_size);
     uint32_t start_sector = block * sectors_per_block;
 
+    this->timing.erase(block * this->block_size, this->block_size);
+
     for (int i = start_sector; i < start_sector + sectors_per_block; i++) {
-        this->erase_sector(i);
+        this->erase_sector_internal(i);
+    }
+
+    return ESP_ROM_SPIFLASH_RESULT_OK;
+}
+
+esp_rom_spiflash_result_t SpiFlash::erase_block_32k(uint32_t block32)
+{
+    const uint32_t block32_size = 32 * 1024;
+    uint32_t sectors_per_block32 = (block32_size / this->sector_size);
+    uint32_t start_sector = block32 * sectors_per_block32;
+
+    this->timing.erase(block32 * block32_size, block32_size);
+
+    for (int i = start_sector; i < start_sector + sectors_per_block32; i++) {
+        this->erase_sector_internal(i);
     }
 
     return ESP_ROM_SPIFLASH_RESULT_OK;
 }
 
 esp_rom_spiflash_result_t SpiFlash::erase_sector(uint32_t sector)
+{
+    esp_rom_spiflash_result_t result = this->erase_sector_internal(sector);
+
+    if (result == ESP_ROM_SPIFLASH_RESULT_OK) {
+        this->timing.erase(sector * this->sector_size, this->sector_size);
+    }
+
+    return result;
+}
+
+esp_rom_spiflash_result_t SpiFlash::erase_sector_internal(uint32_t sector)
 {
     if (this->total_erase_cycles_limit != 0 && 
         this->total_erase_cycles >= this->total_erase_cycles_limit) {
@@ -182,6 +212,8 @@ esp_rom_spiflash_result_t SpiFlash::write(uint32_t dest_addr, const void *src, u
         this->erase_states[i] = false;
     }
 
+    this->timing.write(dest_addr, size);
+
     // Do the write
     for(uint32_t ctr = 0; ctr < size; ctr++)
     {
@@ -218,6 +250,8 @@ esp_rom_spiflash_result_t SpiFlash::read(uint32_t src_addr, void *dest, uint32_t
         }
     }
 
+    this->timing.read(src_addr, size);
+
     // Do the read
     memcpy(dest, &this->memory[src_addr], size);
     return ESP_ROM_SPIFLASH_RESULT_OK;
@@ -228,6 +262,11 @@ uint8_t* SpiFlash::get_memory_ptr(uint32_t src_address)
     return &this->memory[src_address];
 }
 
+SpiFlashTiming& SpiFlash::get_timing()
+{
+    return this->timing;
+}
+
 uint32_t SpiFlash::get_erase_cycles(uint32_t sector)
 {
     return this->erase_cycles[sector];
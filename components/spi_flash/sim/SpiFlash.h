@@ -20,6 +20,8 @@
 #include "esp_err.h"
 #include "esp32/rom/spi_flash.h"
 
+#include "SpiFlashTiming.h"
+
 /**
 * @brief This class is used to emulate flash devices.
 *
@@ -39,6 +41,7 @@ public:
     uint32_t get_page_size();
 
     esp_rom_spiflash_result_t erase_block(uint32_t block);
+    esp_rom_spiflash_result_t erase_block_32k(uint32_t block32);
     esp_rom_spiflash_result_t erase_sector(uint32_t sector);
     esp_rom_spiflash_result_t erase_page(uint32_t page);
 
@@ -56,6 +59,8 @@ public:
 
     uint8_t* get_memory_ptr(uint32_t src_address);
 
+    SpiFlashTiming& get_timing();
+
 private:
     uint32_t chip_size;
     uint32_t block_size;
@@ -75,6 +80,9 @@ private:
     uint32_t total_erase_cycles;
     uint32_t total_erase_cycles_limit;
 
+    SpiFlashTiming timing;
+
+    esp_rom_spiflash_result_t erase_sector_internal(uint32_t sector);
     void deinit();
 };
 
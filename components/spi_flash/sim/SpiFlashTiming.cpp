@@ -0,0 +1,167 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SpiFlashTiming.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define BLOCK32_SIZE                    (32 * 1024)
+#define BLOCK64_SIZE                    (64 * 1024)
+
+#define DIV_AND_CEIL(x, y)              ((x) / (y) + ((x) % (y) > 0))
+
+SpiFlashTiming::SpiFlashTiming()
+{
+    this->config = default_config();
+    reset();
+}
+
+spi_flash_timing_config_t SpiFlashTiming::default_config()
+{
+    spi_flash_timing_config_t config;
+    config.op_overhead_us = 10;
+    config.read_per_byte_ns = 100;      // 2 bits per clock at 40 MHz
+    config.write_per_byte_ns = 200;     // page program is issued on a single line
+    config.program_page_size = 256;
+    config.page_program_us = 600;
+    config.sector_erase_size = 4096;
+    config.sector_erase_us = 45000;
+    config.block32_erase_us = 120000;
+    config.block64_erase_us = 150000;
+    return config;
+}
+
+void SpiFlashTiming::set_config(const spi_flash_timing_config_t& config)
+{
+    this->config = config;
+}
+
+const spi_flash_timing_config_t& SpiFlashTiming::get_config() const
+{
+    return this->config;
+}
+
+void SpiFlashTiming::add_time(uint64_t ns)
+{
+    this->time_ns += ns;
+    this->stats.time_us = this->time_ns / 1000;
+}
+
+void SpiFlashTiming::add_sector_erases(uint32_t start_addr, uint32_t size)
+{
+    uint32_t first = start_addr / this->config.sector_erase_size;
+    uint32_t count = DIV_AND_CEIL(size, this->config.sector_erase_size);
+
+    if (this->sector_erases.size() < first + count) {
+        this->sector_erases.resize(first + count, 0);
+    }
+
+    for (uint32_t i = first; i < first + count; i++) {
+        this->sector_erases[i]++;
+        this->stats.max_sector_erases = std::max(this->stats.max_sector_erases, this->sector_erases[i]);
+    }
+    this->stats.total_sector_erases += count;
+}
+
+uint32_t SpiFlashTiming::read(uint32_t src_addr, uint32_t size)
+{
+    (void) src_addr;    // read time doesn't depend on the address
+    uint64_t ns = (uint64_t) this->config.op_overhead_us * 1000 +
+                  (uint64_t) size * this->config.read_per_byte_ns;
+
+    this->stats.read_ops++;
+    this->stats.read_bytes += size;
+    add_time(ns);
+    return ns / 1000;
+}
+
+uint32_t SpiFlashTiming::write(uint32_t dest_addr, uint32_t size)
+{
+    // Each page touched by the write is programmed separately
+    uint32_t pages = 0;
+    if (size > 0) {
+        uint32_t first_page = dest_addr / this->config.program_page_size;
+        uint32_t last_page = (dest_addr + size - 1) / this->config.program_page_size;
+        pages = last_page - first_page + 1;
+    }
+
+    uint64_t ns = (uint64_t) this->config.op_overhead_us * 1000 +
+                  (uint64_t) size * this->config.write_per_byte_ns +
+                  (uint64_t) pages * this->config.page_program_us * 1000;
+
+    this->stats.write_ops++;
+    this->stats.write_bytes += size;
+    this->stats.page_programs += pages;
+    add_time(ns);
+    return ns / 1000;
+}
+
+uint32_t SpiFlashTiming::erase(uint32_t start_addr, uint32_t size)
+{
+    uint64_t us = this->config.op_overhead_us;
+
+    if (size == BLOCK64_SIZE && start_addr % BLOCK64_SIZE == 0) {
+        us += this->config.block64_erase_us;
+        this->stats.block64_erase_ops++;
+    } else if (size == BLOCK32_SIZE && start_addr % BLOCK32_SIZE == 0) {
+        us += this->config.block32_erase_us;
+        this->stats.block32_erase_ops++;
+    } else {
+        // Any other range is erased sector by sector
+        uint32_t sectors = DIV_AND_CEIL(size, this->config.sector_erase_size);
+        us += (uint64_t) sectors * this->config.sector_erase_us;
+        this->stats.sector_erase_ops += sectors;
+    }
+
+    add_sector_erases(start_addr, size);
+    add_time(us * 1000);
+    return us;
+}
+
+uint64_t SpiFlashTiming::get_time_us() const
+{
+    return this->stats.time_us;
+}
+
+uint32_t SpiFlashTiming::get_sector_erases(uint32_t sector) const
+{
+    if (sector >= this->sector_erases.size()) {
+        return 0;
+    }
+    return this->sector_erases[sector];
+}
+
+spi_flash_timing_stats_t SpiFlashTiming::get_stats() const
+{
+    return this->stats;
+}
+
+void SpiFlashTiming::reset()
+{
+    memset(&this->stats, 0, sizeof(this->stats));
+    this->time_ns = 0;
+    this->sector_erases.clear();
+}
+
+void SpiFlashTiming::report(const char* workload, FILE* out) const
+{
+    fprintf(out, "%-48s %10.3f ms | R %6zu ops %9zu B | W %6zu ops %9zu B %7zu pp | "
+            "E %5zu x4K %4zu x32K %4zu x64K | wear max %4u total %6llu\n",
+            workload, this->time_ns / 1e6,
+            this->stats.read_ops, this->stats.read_bytes,
+            this->stats.write_ops, this->stats.write_bytes, this->stats.page_programs,
+            this->stats.sector_erase_ops, this->stats.block32_erase_ops, this->stats.block64_erase_ops,
+            this->stats.max_sector_erases, (unsigned long long) this->stats.total_sector_erases);
+}
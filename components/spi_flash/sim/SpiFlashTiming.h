@@ -0,0 +1,106 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SpiFlashTiming_H_
+#define _SpiFlashTiming_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * @brief Latencies of flash chip operations used by the timing model
+ */
+typedef struct {
+    uint32_t op_overhead_us;        /*!< Fixed cost of every operation: driver, cache disable, command and address phases */
+    uint32_t read_per_byte_ns;      /*!< Time to clock one byte out of the flash chip */
+    uint32_t write_per_byte_ns;     /*!< Time to clock one byte into the flash chip */
+    uint32_t program_page_size;     /*!< Size of the program page, a write is split into programs at page boundaries */
+    uint32_t page_program_us;       /*!< Time to program one (possibly partial) page */
+    uint32_t sector_erase_size;     /*!< Size of the smallest erase unit */
+    uint32_t sector_erase_us;       /*!< Time to erase one sector */
+    uint32_t block32_erase_us;      /*!< Time to erase one 32 KB block */
+    uint32_t block64_erase_us;      /*!< Time to erase one 64 KB block */
+} spi_flash_timing_config_t;
+
+/**
+ * @brief Operation and wear counters accumulated by the timing model
+ */
+typedef struct {
+    uint64_t time_us;               /*!< Simulated time spent in flash operations */
+    size_t read_ops;                /*!< Number of read operations */
+    size_t read_bytes;              /*!< Number of bytes read */
+    size_t write_ops;               /*!< Number of write operations */
+    size_t write_bytes;             /*!< Number of bytes written */
+    size_t page_programs;           /*!< Number of page program cycles the writes were split into */
+    size_t sector_erase_ops;        /*!< Number of sector erase operations */
+    size_t block32_erase_ops;       /*!< Number of 32 KB block erase operations */
+    size_t block64_erase_ops;       /*!< Number of 64 KB block erase operations */
+    uint64_t total_sector_erases;   /*!< Sum of erase cycles over all sectors */
+    uint32_t max_sector_erases;     /*!< Erase cycles of the most worn sector */
+} spi_flash_timing_stats_t;
+
+/**
+* @brief Timing and wear model of a SPI NOR flash chip
+*
+* The model doesn't hold flash contents. Flash emulators report every
+* operation they perform to it, and the model accumulates the time the
+* operation would take on a real chip together with per-sector erase counts.
+* It is shared by the spi_flash simulator (used by SPIFFS, FATFS and wear
+* levelling host tests) and by the NVS flash emulator, so that results of
+* different storage components can be compared with each other.
+*/
+class SpiFlashTiming
+{
+
+public:
+    SpiFlashTiming();
+
+    /**
+     * @brief Default latencies: typical datasheet values of a 4 MB SPI NOR flash
+     * chip (tPP, tSE, tBE32, tBE64) accessed at 40 MHz in DIO mode
+     */
+    static spi_flash_timing_config_t default_config();
+
+    void set_config(const spi_flash_timing_config_t& config);
+    const spi_flash_timing_config_t& get_config() const;
+
+    /* Each of the functions below accounts one operation and returns its duration in microseconds */
+    uint32_t read(uint32_t src_addr, uint32_t size);
+    uint32_t write(uint32_t dest_addr, uint32_t size);
+    uint32_t erase(uint32_t start_addr, uint32_t size);
+
+    uint64_t get_time_us() const;
+    uint32_t get_sector_erases(uint32_t sector) const;
+    spi_flash_timing_stats_t get_stats() const;
+
+    void reset();
+
+    /**
+     * @brief Print one line with the accumulated stats, prefixed by workload name
+     */
+    void report(const char* workload, FILE* out = stdout) const;
+
+private:
+    spi_flash_timing_config_t config;
+    spi_flash_timing_stats_t stats;
+    uint64_t time_ns;
+    std::vector<uint32_t> sector_erases;
+
+    void add_time(uint64_t ns);
+    void add_sector_erases(uint32_t start_addr, uint32_t size);
+};
+
+#endif // _SpiFlashTiming_H_
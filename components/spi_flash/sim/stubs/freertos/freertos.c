@@ -0,0 +1,147 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct sim_semaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned count;
+};
+
+typedef struct {
+    TaskFunction_t function;
+    void *arg;
+} task_start_t;
+
+static void *task_entry(void *arg)
+{
+    task_start_t start = *(task_start_t *) arg;
+    free(arg);
+    start.function(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+                       void * const pvParameters, uint32_t uxPriority, TaskHandle_t * const pxCreatedTask)
+{
+    task_start_t *start = malloc(sizeof(task_start_t));
+    if (start == NULL) {
+        return pdFAIL;
+    }
+    start->function = pvTaskCode;
+    start->arg = pvParameters;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int ret = pthread_create(&thread, &attr, task_entry, start);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        free(start);
+        return pdFAIL;
+    }
+    if (pxCreatedTask) {
+        *pxCreatedTask = (TaskHandle_t) thread;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+    if (xTaskToDelete == NULL) {
+        pthread_exit(NULL);
+    }
+    abort();
+}
+
+static SemaphoreHandle_t semaphore_create(unsigned count)
+{
+    SemaphoreHandle_t sem = malloc(sizeof(struct sim_semaphore));
+    if (sem == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&sem->mutex, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = count;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(0);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    BaseType_t ret = pdFAIL;
+    pthread_mutex_lock(&xSemaphore->mutex);
+    if (xSemaphore->count == 0) {
+        xSemaphore->count = 1;
+        pthread_cond_signal(&xSemaphore->cond);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&xSemaphore->mutex);
+    return ret;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    // One tick is one millisecond
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += xBlockTime / 1000;
+    deadline.tv_nsec += (xBlockTime % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&xSemaphore->mutex);
+    while (xSemaphore->count == 0 && ret != ETIMEDOUT) {
+        if (xBlockTime == portMAX_DELAY) {
+            pthread_cond_wait(&xSemaphore->cond, &xSemaphore->mutex);
+        } else {
+            ret = pthread_cond_timedwait(&xSemaphore->cond, &xSemaphore->mutex, &deadline);
+        }
+    }
+    BaseType_t taken = pdFAIL;
+    if (xSemaphore->count > 0) {
+        xSemaphore->count = 0;
+        taken = pdPASS;
+    }
+    pthread_mutex_unlock(&xSemaphore->mutex);
+    return taken;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+    pthread_cond_destroy(&xSemaphore->cond);
+    pthread_mutex_destroy(&xSemaphore->mutex);
+    free(xSemaphore);
+}
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <stdint.h>
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             0
 #define pdTRUE              1
+#define pdFAIL              pdFALSE
+#define pdPASS              pdTRUE
+
+#define portMAX_DELAY       ((TickType_t) 0xffffffffUL)
 
 #if defined(__cplusplus)
 }
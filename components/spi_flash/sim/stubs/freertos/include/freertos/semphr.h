@@ -1,15 +1,19 @@
 #pragma once
 
+#include "projdefs.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-#define vSemaphoreDelete( xSemaphore )
-#define xSemaphoreCreateMutex()                     ((void*)(1))
-#define xSemaphoreGive( xSemaphore )
-#define xSemaphoreTake( xSemaphore, xBlockTime )    pdTRUE
+/* Semaphores are backed by pthreads, so that tasks created with xTaskCreate can wait on them */
+typedef struct sim_semaphore *SemaphoreHandle_t;
 
-typedef void* SemaphoreHandle_t;
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore);
 
 #if defined(__cplusplus)
 }
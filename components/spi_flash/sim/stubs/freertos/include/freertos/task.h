@@ -1 +1,21 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+#include "projdefs.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+/* Tasks run in their own detached pthread, priority and stack depth are ignored */
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char * const pcName, const uint32_t usStackDepth,
+                       void * const pvParameters, uint32_t uxPriority, TaskHandle_t * const pxCreatedTask);
+
+/* Only deleting the calling task (xTaskToDelete == NULL) is supported */
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+// heap_caps_malloc() and the capabilities are defined by esp_log.h of the stubs
+#include "esp_log.h"
+
+#define heap_caps_get_largest_free_block(caps)  SIZE_MAX
@@ -52,6 +52,12 @@ void esp_log_write(esp_log_level_t level, const char* tag, const char* format, .
 
 #define ESP_LOGV( tag, format, ... )  if (LOG_LOCAL_LEVEL >= ESP_LOG_VERBOSE) { esp_log_write(ESP_LOG_VERBOSE, tag, LOG_FORMAT(V, format), esp_log_timestamp(), tag, ##__VA_ARGS__); }
 
+#define ESP_EARLY_LOGE( tag, format, ... )  ESP_LOGE( tag, format, ##__VA_ARGS__ )
+#define ESP_EARLY_LOGW( tag, format, ... )  ESP_LOGW( tag, format, ##__VA_ARGS__ )
+#define ESP_EARLY_LOGI( tag, format, ... )  ESP_LOGI( tag, format, ##__VA_ARGS__ )
+#define ESP_EARLY_LOGD( tag, format, ... )  ESP_LOGD( tag, format, ##__VA_ARGS__ )
+#define ESP_EARLY_LOGV( tag, format, ... )  ESP_LOGV( tag, format, ##__VA_ARGS__ )
+
 // Assume that flash encryption is not enabled. Put here since in partition.c
 // esp_log.h is included later than esp_flash_encrypt.h.
 #define esp_flash_encryption_enabled()      false
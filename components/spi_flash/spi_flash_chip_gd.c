@@ -84,6 +84,7 @@ const spi_flash_chip_t esp_flash_chip_gd = {
     .erase_chip = spi_flash_chip_generic_erase_chip,
     .erase_sector = spi_flash_chip_generic_erase_sector,
     .erase_block = spi_flash_chip_generic_erase_block,
+    .erase_block_32k = spi_flash_chip_generic_erase_block_32k,
     .sector_size = 4 * 1024,
     .block_erase_size = 64 * 1024,
 
@@ -138,6 +138,34 @@ esp_err_t spi_flash_chip_generic_erase_block(esp_flash_t *chip, uint32_t start_a
     return err;
 }
 
+esp_err_t spi_flash_chip_generic_erase_block_32k(esp_flash_t *chip, uint32_t start_address)
+{
+    esp_err_t err = chip->chip_drv->set_chip_write_protect(chip, false);
+    if (err == ESP_OK) {
+        err = chip->chip_drv->wait_idle(chip, SPI_FLASH_DEFAULT_IDLE_TIMEOUT_MS * 1000);
+    }
+    if (err == ESP_OK) {
+        // The host drivers only have hardware commands for the sector and 64KB block erase
+        spi_flash_trans_t t = {
+            .command = CMD_BLOCK_ERASE_32K,
+            .address_bitlen = 24,
+            .address = start_address,
+        };
+        err = chip->host->common_command(chip->host, &t);
+    }
+    if (err == ESP_OK) {
+        //to save time, flush cache here
+        if (chip->host->flush_cache) {
+            err = chip->host->flush_cache(chip->host, start_address, 32 * 1024);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        err = chip->chip_drv->wait_idle(chip, SPI_FLASH_GENERIC_BLOCK_ERASE_TIMEOUT_MS * 1000);
+    }
+    return err;
+}
+
 esp_err_t spi_flash_chip_generic_read(esp_flash_t *chip, void *buffer, uint32_t address, uint32_t length)
 {
     esp_err_t err = ESP_OK;
@@ -370,6 +398,7 @@ const spi_flash_chip_t esp_flash_chip_generic = {
     .erase_chip = spi_flash_chip_generic_erase_chip,
     .erase_sector = spi_flash_chip_generic_erase_sector,
     .erase_block = spi_flash_chip_generic_erase_block,
+    .erase_block_32k = spi_flash_chip_generic_erase_block_32k,
     .sector_size = 4 * 1024,
     .block_erase_size = 64 * 1024,
 
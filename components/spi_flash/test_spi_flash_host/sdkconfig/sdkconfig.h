@@ -0,0 +1,9 @@
+#pragma once
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_PARTITION_TABLE_OFFSET 0x8000
+#define CONFIG_ESPTOOLPY_FLASHSIZE "4MB"
+//currently use the legacy implementation, since the stubs for new HAL are not done yet
+#define CONFIG_SPI_FLASH_USE_LEGACY_IMPL 1
+#define CONFIG_SPI_FLASH_ERASE_TASK_STACK_SIZE 2048
+#define CONFIG_SPI_FLASH_ERASE_TASK_PRIORITY 5
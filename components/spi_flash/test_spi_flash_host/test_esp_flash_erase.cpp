@@ -0,0 +1,161 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_spi_flash.h"
+#include "esp_flash.h"
+#include "spi_flash_chip_driver.h"
+#include "spi_flash_chip_generic.h"
+#include "spi_flash_defs.h"
+#include "SpiFlash.h"
+
+#include "catch.hpp"
+
+#include "sdkconfig.h"
+
+extern "C" void _spi_flash_init(const char* chip_size, size_t block_size, size_t sector_size, size_t page_size, const char* partition_bin);
+extern SpiFlash spiflash;
+
+/* Only the chip driver is registered by spi_flash_chip_drivers.c, which is not built for the host */
+static const spi_flash_chip_t* registered_chips[] = { &esp_flash_chip_generic, NULL };
+const spi_flash_chip_t** esp_flash_registered_chips = registered_chips;
+
+static const uint32_t BLOCK32_SIZE = 32 * 1024;
+
+/* Host driver which executes the commands of the generic chip driver on the flash simulator */
+static bool s_write_enabled;
+
+static esp_err_t sim_dev_config(spi_flash_host_driver_t *driver)
+{
+    return ESP_OK;
+}
+
+static esp_err_t sim_common_command(spi_flash_host_driver_t *driver, spi_flash_trans_t *t)
+{
+    if (t->command != CMD_BLOCK_ERASE_32K || !s_write_enabled) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    spiflash.erase_block_32k(t->address / BLOCK32_SIZE);
+    s_write_enabled = false;
+    return ESP_OK;
+}
+
+static void sim_erase_sector(spi_flash_host_driver_t *driver, uint32_t start_address)
+{
+    REQUIRE(s_write_enabled);
+    spiflash.erase_sector(start_address / spiflash.get_sector_size());
+    s_write_enabled = false;
+}
+
+static void sim_erase_block(spi_flash_host_driver_t *driver, uint32_t start_address)
+{
+    REQUIRE(s_write_enabled);
+    spiflash.erase_block(start_address / spiflash.get_block_size());
+    s_write_enabled = false;
+}
+
+static esp_err_t sim_read_status(spi_flash_host_driver_t *driver, uint8_t *out_sr)
+{
+    *out_sr = s_write_enabled ? SR_WREN : 0;
+    return ESP_OK;
+}
+
+static esp_err_t sim_set_write_protect(spi_flash_host_driver_t *driver, bool wp)
+{
+    s_write_enabled = !wp;
+    return ESP_OK;
+}
+
+static bool sim_host_idle(spi_flash_host_driver_t *driver)
+{
+    return false;
+}
+
+static esp_flash_t init_sim_chip(spi_flash_host_driver_t* host, esp_flash_os_functions_t* os_func)
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, 64 * 1024, SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE, "partition_table.bin");
+    s_write_enabled = false;
+
+    memset(host, 0, sizeof(*host));
+    host->dev_config = sim_dev_config;
+    host->common_command = sim_common_command;
+    host->erase_sector = sim_erase_sector;
+    host->erase_block = sim_erase_block;
+    host->read_status = sim_read_status;
+    host->set_write_protect = sim_set_write_protect;
+    host->host_idle = sim_host_idle;
+    memset(os_func, 0, sizeof(*os_func));
+
+    esp_flash_t chip = {};
+    chip.host = host;
+    chip.chip_drv = &esp_flash_chip_generic;
+    chip.os_func = os_func;
+    chip.size = spiflash.get_chip_size();
+    spiflash.get_timing().reset();
+    return chip;
+}
+
+TEST_CASE("esp_flash_erase_region uses 32kB block erase for 32kB aligned head", "[esp_flash]")
+{
+    spi_flash_host_driver_t host;
+    esp_flash_os_functions_t os_func;
+    esp_flash_t chip = init_sim_chip(&host, &os_func);
+
+    // 0x114000 - 0x154000: 4 sectors, 32kB block at 0x118000, 64kB blocks at 0x120000, 0x130000 and 0x140000, 4 sectors
+    REQUIRE(esp_flash_erase_region(&chip, 0x114000, 0x40000) == ESP_OK);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 8);
+    CHECK(stats.block32_erase_ops == 1);
+    CHECK(stats.block64_erase_ops == 3);
+    CHECK(stats.total_sector_erases == 0x40000 / SPI_FLASH_SEC_SIZE);
+    CHECK(spiflash.get_timing().get_sector_erases(0x113000 / SPI_FLASH_SEC_SIZE) == 0);
+    CHECK(spiflash.get_timing().get_sector_erases(0x154000 / SPI_FLASH_SEC_SIZE) == 0);
+}
+
+TEST_CASE("esp_flash_erase_region uses 32kB block erase for 32kB aligned tail", "[esp_flash]")
+{
+    spi_flash_host_driver_t host;
+    esp_flash_os_functions_t os_func;
+    esp_flash_t chip = init_sim_chip(&host, &os_func);
+
+    // 0x120000 - 0x12c000: starts at a 64kB boundary but only covers 32kB of the block and 4 more sectors
+    REQUIRE(esp_flash_erase_region(&chip, 0x120000, 0xc000) == ESP_OK);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 4);
+    CHECK(stats.block32_erase_ops == 1);
+    CHECK(stats.block64_erase_ops == 0);
+    CHECK(spiflash.get_timing().get_sector_erases(0x127000 / SPI_FLASH_SEC_SIZE) == 1);
+    CHECK(spiflash.get_timing().get_sector_erases(0x12c000 / SPI_FLASH_SEC_SIZE) == 0);
+}
+
+TEST_CASE("esp_flash_erase_region uses sector erase if the chip has no 32kB block erase", "[esp_flash]")
+{
+    spi_flash_host_driver_t host;
+    esp_flash_os_functions_t os_func;
+    esp_flash_t chip = init_sim_chip(&host, &os_func);
+    spi_flash_chip_t chip_drv = esp_flash_chip_generic;
+    chip_drv.erase_block_32k = NULL;
+    chip.chip_drv = &chip_drv;
+
+    REQUIRE(esp_flash_erase_region(&chip, 0x114000, 0x40000) == ESP_OK);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 16);
+    CHECK(stats.block32_erase_ops == 0);
+    CHECK(stats.block64_erase_ops == 3);
+}
@@ -0,0 +1,187 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "esp_spi_flash.h"
+#include "esp_partition.h"
+#include "SpiFlash.h"
+
+#include "catch.hpp"
+
+#include "sdkconfig.h"
+
+extern "C" void _spi_flash_init(const char* chip_size, size_t block_size, size_t sector_size, size_t page_size, const char* partition_bin);
+extern SpiFlash spiflash;
+
+static const size_t BLOCK_SIZE = 64 * 1024;
+
+/* "storage" partition starts 0x4000 below a 64kB boundary (0x120000) and ends at one (0x200000) */
+static const esp_partition_t* init_storage_partition()
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, BLOCK_SIZE, SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE, "partition_table.bin");
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+    REQUIRE(partition != NULL);
+    REQUIRE(partition->address == 0x114000);
+    REQUIRE(partition->size == 0xEC000);
+    return partition;
+}
+
+static void fill_partition(const esp_partition_t* partition, uint8_t value)
+{
+    uint8_t buf[SPI_FLASH_SEC_SIZE];
+    memset(buf, value, sizeof(buf));
+    for (size_t offset = 0; offset < partition->size; offset += sizeof(buf)) {
+        REQUIRE(esp_partition_write(partition, offset, buf, sizeof(buf)) == ESP_OK);
+    }
+}
+
+static void check_erased(const esp_partition_t* partition, size_t offset, size_t size)
+{
+    uint8_t buf[SPI_FLASH_SEC_SIZE];
+    for (size_t end = offset + size; offset < end; offset += sizeof(buf)) {
+        REQUIRE(esp_partition_read(partition, offset, buf, sizeof(buf)) == ESP_OK);
+        for (size_t i = 0; i < sizeof(buf); ++i) {
+            REQUIRE(buf[i] == 0xff);
+        }
+    }
+}
+
+TEST_CASE("erase of the whole partition uses block erase for aligned blocks", "[partition]")
+{
+    const esp_partition_t* partition = init_storage_partition();
+    fill_partition(partition, 0xa5);
+    spiflash.get_timing().reset();
+
+    REQUIRE(esp_partition_erase_range(partition, 0, partition->size) == ESP_OK);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 12);
+    CHECK(stats.block64_erase_ops == 14);
+    CHECK(stats.total_sector_erases == partition->size / SPI_FLASH_SEC_SIZE);
+    check_erased(partition, 0, partition->size);
+}
+
+TEST_CASE("erase of a range smaller than a block uses sector erase", "[partition]")
+{
+    const esp_partition_t* partition = init_storage_partition();
+    spiflash.get_timing().reset();
+
+    // 0x120000 - 0x12c000, starts at a block boundary but doesn't cover the whole block
+    REQUIRE(esp_partition_erase_range(partition, 0xc000, 0xc000) == ESP_OK);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 12);
+    CHECK(stats.block64_erase_ops == 0);
+    CHECK(spiflash.get_timing().get_sector_erases(0x12c000 / SPI_FLASH_SEC_SIZE) == 0);
+}
+
+TEST_CASE("background erase produces the same operations as esp_partition_erase_range", "[partition]")
+{
+    const esp_partition_t* partition = init_storage_partition();
+    fill_partition(partition, 0x5a);
+    spiflash.get_timing().reset();
+
+    esp_partition_erase_handle_t handle;
+    REQUIRE(esp_partition_erase_range_async(partition, 0, partition->size, &handle) == ESP_OK);
+    CHECK(esp_partition_erase_wait(handle, 0x10000) == ESP_OK);
+    CHECK(esp_partition_erase_wait(handle, partition->size * 2) == ESP_OK);
+    CHECK(esp_partition_erase_get_erased_offset(handle) == partition->size);
+    REQUIRE(esp_partition_erase_end(handle) == ESP_OK);
+
+    // The first step ends at the first 64kB boundary, all other steps are single block erases
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 12);
+    CHECK(stats.block64_erase_ops == 14);
+    CHECK(stats.total_sector_erases == partition->size / SPI_FLASH_SEC_SIZE);
+    check_erased(partition, 0, partition->size);
+}
+
+/* Flash guard which holds back flash operations of other threads than the test one while paused */
+static std::mutex s_pause_lock;
+static std::condition_variable s_pause_cond;
+static bool s_paused;
+static std::thread::id s_test_thread;
+
+static void paused_guard_start()
+{
+    if (std::this_thread::get_id() != s_test_thread) {
+        std::unique_lock<std::mutex> lock(s_pause_lock);
+        s_pause_cond.wait(lock, [] { return !s_paused; });
+    }
+}
+
+static void paused_guard_end()
+{
+}
+
+static void set_paused(bool paused)
+{
+    std::lock_guard<std::mutex> lock(s_pause_lock);
+    s_paused = paused;
+    s_pause_cond.notify_all();
+}
+
+TEST_CASE("background erase runs in another task while the caller continues", "[partition]")
+{
+    const esp_partition_t* partition = init_storage_partition();
+    fill_partition(partition, 0x5a);
+    spiflash.get_timing().reset();
+
+    const spi_flash_guard_funcs_t* prev_guard = spi_flash_guard_get();
+    spi_flash_guard_funcs_t guard = {};
+    guard.start = paused_guard_start;
+    guard.end = paused_guard_end;
+    s_test_thread = std::this_thread::get_id();
+    set_paused(true);
+    spi_flash_guard_set(&guard);
+
+    esp_partition_erase_handle_t handle;
+    REQUIRE(esp_partition_erase_range_async(partition, 0, partition->size, &handle) == ESP_OK);
+
+    // The erase task can't touch the flash, yet the call returned and the flash is usable from this task
+    CHECK(esp_partition_erase_get_erased_offset(handle) == 0);
+    uint8_t buf[16];
+    REQUIRE(esp_partition_read(partition, 0, buf, sizeof(buf)) == ESP_OK);
+    CHECK(buf[0] == 0x5a);
+    CHECK(spiflash.get_timing().get_stats().sector_erase_ops == 0);
+
+    set_paused(false);
+    CHECK(esp_partition_erase_wait(handle, 0x10000) == ESP_OK);
+    CHECK(esp_partition_erase_get_erased_offset(handle) >= 0x10000);
+    REQUIRE(esp_partition_erase_end(handle) == ESP_OK);
+    spi_flash_guard_set(prev_guard);
+
+    spi_flash_timing_stats_t stats = spiflash.get_timing().get_stats();
+    CHECK(stats.sector_erase_ops == 12);
+    CHECK(stats.block64_erase_ops == 14);
+    check_erased(partition, 0, partition->size);
+}
+
+TEST_CASE("background erase checks arguments", "[partition]")
+{
+    const esp_partition_t* partition = init_storage_partition();
+    esp_partition_erase_handle_t handle;
+
+    CHECK(esp_partition_erase_range_async(partition, 0x800, SPI_FLASH_SEC_SIZE, &handle) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_partition_erase_range_async(partition, 0, 0x800, &handle) == ESP_ERR_INVALID_SIZE);
+    CHECK(esp_partition_erase_range_async(partition, 0, partition->size + SPI_FLASH_SEC_SIZE, &handle) == ESP_ERR_INVALID_SIZE);
+    CHECK(esp_partition_erase_range_async(partition, 0, SPI_FLASH_SEC_SIZE, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_partition_erase_wait(NULL, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_partition_erase_end(NULL) == ESP_ERR_INVALID_ARG);
+}
@@ -13,10 +13,12 @@
 #include "spiffs.h"
 #include "spiffs_nucleus.h"
 #include "spiffs_api.h"
+#include "SpiFlash.h"
 
 #include "catch.hpp"
 
 extern "C" void _spi_flash_init(const char* chip_size, size_t block_size, size_t sector_size, size_t page_size, const char* partition_bin);
+extern SpiFlash spiflash;
 
 static void init_spiffs(spiffs *fs, uint32_t max_files)
 {
@@ -254,4 +256,72 @@ TEST_CASE("can read spiffs image", "[spiffs]")
     check_spiffs_files(&fs, "../spiffs", path_buf);
 
     deinit_spiffs(&fs);
-}
\ No newline at end of file
+}
+
+/* Standard SPIFFS workloads for the flash timing model, see spi_flash/sim/SpiFlashTiming.h.
+ * Run with "make benchmark", results of all storage components use the same format.
+ */
+TEST_CASE("spiffs benchmark: standard workloads", "[spiffs][benchmark][.]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    spiffs fs;
+    s32_t spiffs_res;
+    SpiFlashTiming& timing = spiflash.get_timing();
+
+    init_spiffs(&fs, 5);
+    timing.report("spiffs: format and mount");
+
+    const uint32_t chunk_size = 4096;
+    const uint32_t file_size = 256 * 1024;
+    char *chunk = (char*) malloc(chunk_size);
+    memset(chunk, 0xa5, chunk_size);
+
+    // Sequential write of a large file
+    timing.reset();
+    spiffs_file file = SPIFFS_open(&fs, "seq.bin", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR, 0);
+    REQUIRE(file >= SPIFFS_OK);
+    for (uint32_t written = 0; written < file_size; written += chunk_size) {
+        spiffs_res = SPIFFS_write(&fs, file, chunk, chunk_size);
+        REQUIRE(spiffs_res == chunk_size);
+    }
+    REQUIRE(SPIFFS_close(&fs, file) >= SPIFFS_OK);
+    timing.report("spiffs: write 256 KB file in 4 KB chunks");
+
+    // Sequential read of the same file
+    timing.reset();
+    file = SPIFFS_open(&fs, "seq.bin", SPIFFS_O_RDONLY, 0);
+    REQUIRE(file >= SPIFFS_OK);
+    for (uint32_t read = 0; read < file_size; read += chunk_size) {
+        spiffs_res = SPIFFS_read(&fs, file, chunk, chunk_size);
+        REQUIRE(spiffs_res == chunk_size);
+    }
+    REQUIRE(SPIFFS_close(&fs, file) >= SPIFFS_OK);
+    timing.report("spiffs: read 256 KB file in 4 KB chunks");
+
+    // Small appends, each one flushed, as done by a data logger
+    timing.reset();
+    file = SPIFFS_open(&fs, "log.txt", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_RDWR | SPIFFS_O_APPEND, 0);
+    REQUIRE(file >= SPIFFS_OK);
+    for (int i = 0; i < 1000; i++) {
+        spiffs_res = SPIFFS_write(&fs, file, chunk, 64);
+        REQUIRE(spiffs_res == 64);
+        REQUIRE(SPIFFS_fflush(&fs, file) >= SPIFFS_OK);
+    }
+    REQUIRE(SPIFFS_close(&fs, file) >= SPIFFS_OK);
+    timing.report("spiffs: 1000 flushed appends of 64 bytes");
+
+    // Rewriting a small settings file over and over exercises garbage collection
+    timing.reset();
+    for (int i = 0; i < 500; i++) {
+        file = SPIFFS_open(&fs, "config.json", SPIFFS_O_CREAT | SPIFFS_O_TRUNC | SPIFFS_O_WRONLY, 0);
+        REQUIRE(file >= SPIFFS_OK);
+        spiffs_res = SPIFFS_write(&fs, file, chunk, 1024);
+        REQUIRE(spiffs_res == 1024);
+        REQUIRE(SPIFFS_close(&fs, file) >= SPIFFS_OK);
+    }
+    timing.report("spiffs: 500 rewrites of a 1 KB file");
+
+    deinit_spiffs(&fs);
+    free(chunk);
+}
@@ -0,0 +1,122 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_TRANSPORT_INFLATE_H_
+#define _ESP_TRANSPORT_INFLATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Streaming decoder of deflate data (RFC 1951), which decompresses the
+ * messages of the permessage-deflate WebSocket extension and the compressed
+ * responses of esp_http_client.
+ */
+
+typedef struct esp_transport_inflate *esp_transport_inflate_handle_t;
+
+/**
+ * Framing of the deflate stream
+ */
+typedef enum {
+    ESP_TRANSPORT_INFLATE_GZIP,         /*!< gzip, RFC 1952 */
+    ESP_TRANSPORT_INFLATE_DEFLATE,      /*!< HTTP "deflate" encoding: a zlib stream as of RFC 1950, or raw deflate
+                                             data as sent by some servers, told apart by the first two bytes */
+    ESP_TRANSPORT_INFLATE_RAW,          /*!< Raw deflate data, RFC 1951 */
+} esp_transport_inflate_format_t;
+
+typedef enum {
+    ESP_TRANSPORT_INFLATE_ERR_WINDOW = -3,  /*!< A match points further back than the window */
+    ESP_TRANSPORT_INFLATE_ERR_CHECK = -2,   /*!< Checksum or length of the trailer don't match */
+    ESP_TRANSPORT_INFLATE_ERR_DATA = -1,    /*!< Invalid stream */
+    ESP_TRANSPORT_INFLATE_OK = 0,           /*!< Output buffer full, or more input needed */
+    ESP_TRANSPORT_INFLATE_DONE = 1,         /*!< End of the stream, trailer checked */
+} esp_transport_inflate_status_t;
+
+/**
+ * @brief      Create a decoder
+ *
+ * The decoder keeps the last 2^window_bits bytes of output, streams
+ * referring further back are rejected with ESP_TRANSPORT_INFLATE_ERR_WINDOW.
+ * It takes about 3 KB besides the window.
+ *
+ * @param[in]  window_bits  Window size, 8 to 15
+ *
+ * @return     Decoder, or NULL if out of memory
+ */
+esp_transport_inflate_handle_t esp_transport_inflate_create(int window_bits);
+
+/**
+ * @brief      Prepare the decoder for a new stream
+ *
+ * @param[in]  h            The decoder
+ * @param[in]  format       Framing of the stream
+ * @param[in]  keep_window  Matches of the new stream may refer to the output of the previous ones,
+ *                          as with the context takeover of permessage-deflate
+ */
+void esp_transport_inflate_reset(esp_transport_inflate_handle_t h, esp_transport_inflate_format_t format,
+                                 bool keep_window);
+
+/**
+ * @brief      Decode part of the stream
+ *
+ * Input may be given in pieces of any size. Decoding stops when the output
+ * buffer is full or when more input is needed; input is consumed as far as
+ * the decoder can hold it, which may be before the output it yields is
+ * returned, so a call with no new input may still produce output.
+ *
+ * @param[in]  h         The decoder
+ * @param[in]  in        Input, may be NULL if in_len is 0
+ * @param[in]  in_len    Length of the input
+ * @param[out] consumed  Bytes of input consumed
+ * @param[out] out       Output buffer
+ * @param[in]  out_size  Size of the output buffer
+ * @param[out] produced  Bytes written to out
+ *
+ * @return
+ *     - ESP_TRANSPORT_INFLATE_OK: call again with more input, or with more room for output
+ *     - ESP_TRANSPORT_INFLATE_DONE: the stream and its trailer are complete, input after them is ignored
+ *     - < 0: the stream is invalid, the decoder must be reset
+ */
+esp_transport_inflate_status_t esp_transport_inflate_run(esp_transport_inflate_handle_t h, const uint8_t *in, size_t in_len,
+                                                         size_t *consumed, uint8_t *out, size_t out_size, size_t *produced);
+
+/**
+ * @brief      Tell whether all the input is decoded up to a block boundary
+ *
+ * This is the case at the end of the stream, or after a sync flush such as
+ * the one ending the messages of permessage-deflate, with all the output
+ * returned.
+ *
+ * @param[in]  h     The decoder
+ *
+ * @return     true if no input and no output is pending
+ */
+bool esp_transport_inflate_flushed(esp_transport_inflate_handle_t h);
+
+/**
+ * @brief      Free a decoder, may be NULL
+ */
+void esp_transport_inflate_destroy(esp_transport_inflate_handle_t h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_TRANSPORT_INFLATE_H_ */
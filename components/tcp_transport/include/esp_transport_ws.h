@@ -8,6 +8,7 @@
 #define _ESP_TRANSPORT_WS_H_
 
 #include "esp_transport.h"
+#include "esp_transport_ws_deflate.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -76,6 +77,23 @@ esp_err_t esp_transport_ws_set_user_agent(esp_transport_handle_t t, const char *
  */
 esp_err_t esp_transport_ws_set_headers(esp_transport_handle_t t, const char *headers);
 
+/**
+ * @brief               Offer the permessage-deflate extension (RFC 7692) when connecting
+ *
+ * Data messages are compressed if the server accepts the offer, which is
+ * checked when connecting. A response which does not match the offer fails
+ * the connection. Compressed messages received are read once decompressed,
+ * esp_transport_ws_get_read_payload_len() then gives the decompressed length.
+ *
+ * @param t             websocket transport handle
+ * @param config        settings of the extension, copied; NULL not to offer it
+ *
+ * @return
+ *      - ESP_OK on success
+ *      - One of the error codes
+ */
+esp_err_t esp_transport_ws_set_deflate(esp_transport_handle_t t, const esp_transport_ws_deflate_config_t *config);
+
 /**
  * @brief               Sends websocket raw message with custom opcode and payload
  *
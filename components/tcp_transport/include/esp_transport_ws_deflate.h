@@ -0,0 +1,202 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ESP_TRANSPORT_WS_DEFLATE_H_
+#define _ESP_TRANSPORT_WS_DEFLATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Window size used when no window bits are configured
+ */
+#define ESP_TRANSPORT_WS_DEFLATE_DEFAULT_WINDOW_BITS    11
+
+/**
+ * Maximum message size used when none is configured
+ */
+#define ESP_TRANSPORT_WS_DEFLATE_DEFAULT_MAX_MESSAGE    (16 * 1024)
+
+/**
+ * @brief Settings of the permessage-deflate extension (RFC 7692)
+ *
+ * The parameters are named after the extension parameters, from the point
+ * of view of the connection: the server compresses the messages it sends
+ * with server_max_window_bits, the client with client_max_window_bits.
+ *
+ * The compressor of an endpoint takes about 6 times 2^window_bits bytes of
+ * heap. The decompressor takes about 3 KB plus 2^window_bits bytes, kept
+ * between messages when context takeover is in use; compressed messages are
+ * assembled and decompressed whole, using at most max_message_size bytes for each.
+ */
+typedef struct {
+    uint8_t server_max_window_bits;     /*!< Window of the server compressor, 8 to 15, 0 for the default */
+    uint8_t client_max_window_bits;     /*!< Window of the client compressor, 8 to 15, 0 for the default */
+    bool server_no_context_takeover;    /*!< Server resets its compressor after each message */
+    bool client_no_context_takeover;    /*!< Client resets its compressor after each message */
+    size_t max_message_size;            /*!< Largest message received, compressed or decompressed, 0 for the default */
+} esp_transport_ws_deflate_config_t;
+
+/**
+ * @brief Parameters of the extension agreed for a connection, for one endpoint
+ */
+typedef struct {
+    uint8_t tx_window_bits;             /*!< Window of our compressor */
+    bool tx_no_context_takeover;        /*!< Reset our compressor after each message */
+    uint8_t rx_window_bits;             /*!< Window of the peer compressor */
+    bool rx_no_context_takeover;        /*!< Peer resets its compressor after each message */
+    size_t max_message_size;            /*!< Largest message received, compressed or decompressed */
+} esp_transport_ws_deflate_params_t;
+
+typedef struct esp_transport_ws_deflate *esp_transport_ws_deflate_handle_t;
+
+/**
+ * @brief      Format the extension offer of a client, the value of its Sec-WebSocket-Extensions header
+ *
+ * @param[in]  config  Client settings
+ * @param[out] buf     Buffer for the null-terminated offer
+ * @param[in]  size    Size of buf
+ *
+ * @return
+ *  - Length of the offer
+ *  - (-1) if it does not fit in buf
+ */
+int esp_transport_ws_deflate_client_offer(const esp_transport_ws_deflate_config_t *config, char *buf, size_t size);
+
+/**
+ * @brief      Check the extension response of a server against the offer of esp_transport_ws_deflate_client_offer()
+ *
+ * @param[in]  config    Client settings
+ * @param[in]  response  Value of the Sec-WebSocket-Extensions header of the server
+ * @param[out] params    Parameters of the client for the connection
+ *
+ * @return
+ *  - ESP_OK if the extension was accepted
+ *  - ESP_ERR_INVALID_RESPONSE if the response is not a valid acceptance of the offer
+ */
+esp_err_t esp_transport_ws_deflate_client_accept(const esp_transport_ws_deflate_config_t *config, const char *response,
+                                                 esp_transport_ws_deflate_params_t *params);
+
+/**
+ * @brief      Pick the first acceptable permessage-deflate offer of a client
+ *
+ * @param[in]  config    Server settings
+ * @param[in]  offers    Value of the Sec-WebSocket-Extensions header of the client
+ * @param[out] params    Parameters of the server for the connection
+ * @param[out] response  Buffer for the null-terminated value of the Sec-WebSocket-Extensions header of the response
+ * @param[in]  size      Size of response
+ *
+ * @return
+ *  - ESP_OK if an offer was accepted
+ *  - ESP_ERR_NOT_FOUND if none can be accepted, the connection then goes on without compression
+ *  - ESP_ERR_INVALID_SIZE if the response does not fit in the buffer
+ */
+esp_err_t esp_transport_ws_deflate_server_accept(const esp_transport_ws_deflate_config_t *config, const char *offers,
+                                                 esp_transport_ws_deflate_params_t *params, char *response, size_t size);
+
+/**
+ * @brief      Create the compression context of a connection
+ *
+ * Memory of the compressor is allocated on first use, and released after
+ * each message if tx_no_context_takeover is set.
+ *
+ * @param[in]  params  Parameters agreed for the connection
+ *
+ * @return
+ *  - Compression context
+ *  - NULL if out of memory
+ */
+esp_transport_ws_deflate_handle_t esp_transport_ws_deflate_create(const esp_transport_ws_deflate_params_t *params);
+
+/**
+ * @brief      Destroy a compression context
+ *
+ * @param[in]  handle  Compression context, may be NULL
+ */
+void esp_transport_ws_deflate_destroy(esp_transport_ws_deflate_handle_t handle);
+
+/**
+ * @brief      Largest output of esp_transport_ws_deflate_compress() for a given input
+ *
+ * @param[in]  len  Number of bytes to compress
+ *
+ * @return     Size of the output buffer to provide
+ */
+size_t esp_transport_ws_deflate_bound(size_t len);
+
+/**
+ * @brief      Compress a part of the message being sent
+ *
+ * A message may be compressed in several parts, each one being sent in a
+ * frame of its own. The output of the last part is ended as per RFC 7692
+ * section 7.2.1, without the trailing 0x00 0x00 0xff 0xff.
+ *
+ * @param[in]  handle   Compression context
+ * @param[in]  in       Data to compress
+ * @param[in]  len      Length of in
+ * @param[in]  final    True for the last part of the message
+ * @param[out] out      Buffer for the compressed data, of at least esp_transport_ws_deflate_bound(len) bytes
+ * @param[out] out_len  Length of the compressed data
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_NO_MEM if the compressor could not be allocated
+ */
+esp_err_t esp_transport_ws_deflate_compress(esp_transport_ws_deflate_handle_t handle, const char *in, size_t len,
+                                            bool final, char *out, size_t *out_len);
+
+/**
+ * @brief      Reserve room for the next compressed bytes of the message being received
+ *
+ * The payload of each frame of the message is read into the returned
+ * buffer, then the message is decompressed by esp_transport_ws_deflate_finish().
+ *
+ * @param[in]  handle  Compression context
+ * @param[in]  len     Number of bytes about to be received
+ *
+ * @return
+ *  - Where to store the len bytes
+ *  - NULL if the message would exceed max_message_size, or if out of memory
+ */
+char *esp_transport_ws_deflate_reserve(esp_transport_ws_deflate_handle_t handle, size_t len);
+
+/**
+ * @brief      Decompress the message received through esp_transport_ws_deflate_reserve()
+ *
+ * On failure the decompressor no longer matches the peer's compressor, so
+ * the connection should be closed.
+ *
+ * @param[in]  handle   Compression context
+ * @param[out] out      Buffer for the message
+ * @param[in]  size     Size of out
+ * @param[out] out_len  Length of the message
+ *
+ * @return
+ *  - ESP_OK
+ *  - ESP_ERR_INVALID_SIZE if the message does not fit in out
+ *  - ESP_FAIL if the compressed data is invalid
+ */
+esp_err_t esp_transport_ws_deflate_finish(esp_transport_ws_deflate_handle_t handle, char *out, size_t size, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ESP_TRANSPORT_WS_DEFLATE_H_ */
@@ -15,6 +15,8 @@
 #ifndef _ESP_TRANSPORT_UTILS_H_
 #define _ESP_TRANSPORT_UTILS_H_
 #include <sys/time.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,6 +44,29 @@ extern "C" {
  */
 struct timeval* esp_transport_utils_ms_to_timeval(int timeout_ms, struct timeval *tv);
 
+/**
+ * @brief      Apply a WebSocket masking key to a payload, as per RFC 6455 section 5.3
+ *
+ * Processes a word at a time once the destination is aligned. Source and
+ * destination may be the same buffer, for unmasking in place.
+ *
+ * @param[out] dst       Destination buffer
+ * @param[in]  src       Source buffer, of len bytes
+ * @param[in]  len       Number of bytes to process
+ * @param[in]  mask_key  Masking key of the frame
+ * @param[in]  offset    Offset of src within the frame payload, for payloads processed in parts
+ */
+void esp_transport_utils_ws_mask(char *dst, const char *src, size_t len, const char mask_key[4], size_t offset);
+
+/**
+ * Base values and extra bits of the deflate length and distance codes (RFC 1951 section 3.2.5),
+ * shared by the compressor of permessage-deflate and the decoder of esp_transport_inflate.h
+ */
+extern const uint16_t esp_transport_deflate_len_base[29];
+extern const uint8_t esp_transport_deflate_len_extra[29];
+extern const uint16_t esp_transport_deflate_dist_base[30];
+extern const uint8_t esp_transport_deflate_dist_extra[30];
+
 
 #ifdef __cplusplus
 }
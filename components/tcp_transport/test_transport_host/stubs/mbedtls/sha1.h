@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stddef.h>
+
+int mbedtls_sha1_ret(const unsigned char *input, size_t ilen, unsigned char output[20]);
@@ -0,0 +1,17 @@
+#include <string.h>
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+
+/* The client key is then empty, and so is the key the WebSocket handshake expects */
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    *olen = 0;
+    return -1;
+}
+
+int mbedtls_sha1_ret(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    memset(output, 0, 20);
+    return -1;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+#define CONFIG_IDF_TARGET_ESP32     1
+#define CONFIG_WS_TX_BUFFER_SIZE    4096
@@ -0,0 +1,324 @@
+#include "catch.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <string>
+#include <vector>
+
+#include "esp_transport_inflate.h"
+
+/* CRC32 of the ROM, the same as zlib's */
+extern "C" uint32_t crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    return crc32(crc, buf, len);
+}
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+const int GZIP = 16;
+const int RAW = -1;
+
+/* zlib is the reference implementation. Framing is GZIP, RAW or 1 for zlib */
+bytes compress(const std::string &data, int framing, int window_bits = 15, int level = 6,
+               int strategy = Z_DEFAULT_STRATEGY, gz_header *header = nullptr)
+{
+    z_stream zs = {};
+    int bits = framing == RAW ? -window_bits : window_bits + (framing == GZIP ? 16 : 0);
+    REQUIRE(deflateInit2(&zs, level, Z_DEFLATED, bits, 8, strategy) == Z_OK);
+    if (header) {
+        REQUIRE(deflateSetHeader(&zs, header) == Z_OK);
+    }
+    bytes out(deflateBound(&zs, data.size()) + 64);
+    zs.next_in = (Bytef *)data.data();
+    zs.avail_in = data.size();
+    zs.next_out = out.data();
+    zs.avail_out = out.size();
+    REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+/* A playlist, the kind of response worth compressing */
+std::string playlist(int entries)
+{
+    std::string text = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:10\n";
+    char line[160];
+    for (int i = 0; i < entries; i++) {
+        snprintf(line, sizeof(line), "#EXTINF:10.%03d,\nhttp://media.example.com/stream/segment-%05d.aac\n",
+                 (i * 37) % 1000, i);
+        text += line;
+    }
+    return text + "#EXT-X-ENDLIST\n";
+}
+
+std::string noise(size_t len, uint32_t seed)
+{
+    std::string data(len, '\0');
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = seed >> 16;
+    }
+    return data;
+}
+
+struct decoder {
+    esp_transport_inflate_handle_t h;
+
+    explicit decoder(int window_bits = 15)
+    {
+        h = esp_transport_inflate_create(window_bits);
+        REQUIRE(h != nullptr);
+    }
+    ~decoder()
+    {
+        esp_transport_inflate_destroy(h);
+    }
+
+    /* Feeds the stream in pieces of in_chunk bytes, reading out_chunk bytes
+     * at most, and returns the status it ended with */
+    esp_transport_inflate_status_t run(const bytes &stream, esp_transport_inflate_format_t format, std::string &out,
+                                       size_t in_chunk = 4096, size_t out_chunk = 4096, bool keep_window = false)
+    {
+        esp_transport_inflate_reset(h, format, keep_window);
+        out.clear();
+        std::vector<uint8_t> buf(out_chunk);
+        size_t pos = 0;
+        for (;;) {
+            size_t len = std::min(in_chunk, stream.size() - pos);
+            size_t consumed = 0;
+            size_t produced = 0;
+            esp_transport_inflate_status_t ret = esp_transport_inflate_run(h, stream.data() + pos, len, &consumed,
+                                                                           buf.data(), buf.size(), &produced);
+            CHECK(consumed <= len);
+            CHECK(produced <= buf.size());
+            pos += consumed;
+            out.append((const char *)buf.data(), produced);
+            if (ret != ESP_TRANSPORT_INFLATE_OK) {
+                return ret;
+            }
+            if (pos == stream.size() && produced == 0) {
+                /* Truncated */
+                return ret;
+            }
+        }
+    }
+
+    std::string decompress(const bytes &stream, esp_transport_inflate_format_t format,
+                           size_t in_chunk = 4096, size_t out_chunk = 4096)
+    {
+        std::string out;
+        REQUIRE(run(stream, format, out, in_chunk, out_chunk) == ESP_TRANSPORT_INFLATE_DONE);
+        return out;
+    }
+};
+
+} // namespace
+
+TEST_CASE("gzip, zlib and raw deflate streams are decoded", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(200);
+    std::string binary = noise(20000, 1);
+
+    for (int level : {0, 1, 6, 9}) {
+        CAPTURE(level);
+        CHECK(d.decompress(compress(text, GZIP, 15, level), ESP_TRANSPORT_INFLATE_GZIP) == text);
+        CHECK(d.decompress(compress(binary, GZIP, 15, level), ESP_TRANSPORT_INFLATE_GZIP) == binary);
+        CHECK(d.decompress(compress(text, 1, 15, level), ESP_TRANSPORT_INFLATE_DEFLATE) == text);
+        CHECK(d.decompress(compress(text, RAW, 15, level), ESP_TRANSPORT_INFLATE_DEFLATE) == text);
+        CHECK(d.decompress(compress(text, RAW, 15, level), ESP_TRANSPORT_INFLATE_RAW) == text);
+    }
+    /* Fixed Huffman codes, and an empty body */
+    CHECK(d.decompress(compress(text, GZIP, 15, 6, Z_FIXED), ESP_TRANSPORT_INFLATE_GZIP) == text);
+    CHECK(d.decompress(compress("", GZIP), ESP_TRANSPORT_INFLATE_GZIP) == "");
+    CHECK(d.decompress(compress("", 1), ESP_TRANSPORT_INFLATE_DEFLATE) == "");
+}
+
+TEST_CASE("streams are decoded from and to buffers of any size", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(100) + noise(3000, 2) + playlist(50);
+    bytes gzip = compress(text, GZIP, 15, 9);
+    bytes stored = compress(text, GZIP, 15, 0);
+
+    for (size_t in_chunk : {1, 2, 7, 100, 1500}) {
+        for (size_t out_chunk : {1, 3, 258, 1024}) {
+            CAPTURE(in_chunk);
+            CAPTURE(out_chunk);
+            CHECK(d.decompress(gzip, ESP_TRANSPORT_INFLATE_GZIP, in_chunk, out_chunk) == text);
+            CHECK(d.decompress(stored, ESP_TRANSPORT_INFLATE_GZIP, in_chunk, out_chunk) == text);
+        }
+    }
+}
+
+TEST_CASE("optional fields of the gzip header are skipped", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(20);
+    static char name[] = "playlist.m3u8";
+    static char comment[] = "generated for the test";
+    std::string extra_data(300, 'x');
+
+    gz_header header = {};
+    header.name = (Bytef *)name;
+    header.comment = (Bytef *)comment;
+    header.extra = (Bytef *)&extra_data[0];
+    header.extra_len = extra_data.size();
+    header.hcrc = 1;
+    bytes stream = compress(text, GZIP, 15, 6, Z_DEFAULT_STRATEGY, &header);
+
+    CHECK(d.decompress(stream, ESP_TRANSPORT_INFLATE_GZIP) == text);
+    CHECK(d.decompress(stream, ESP_TRANSPORT_INFLATE_GZIP, 1, 1) == text);
+}
+
+TEST_CASE("matches beyond the window are rejected", "[inflate]")
+{
+    /* The same random block twice, 2 KB apart */
+    std::string block = noise(1000, 3);
+    std::string text = block + noise(1000, 4) + block;
+
+    decoder small(10);
+    std::string out;
+    CHECK(small.run(compress(text, GZIP, 15), ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_ERR_WINDOW);
+    CHECK(small.run(compress(text, RAW, 15), ESP_TRANSPORT_INFLATE_RAW, out) == ESP_TRANSPORT_INFLATE_ERR_WINDOW);
+    /* A zlib stream tells its window upfront */
+    CHECK(small.run(compress(text, 1, 15), ESP_TRANSPORT_INFLATE_DEFLATE, out) == ESP_TRANSPORT_INFLATE_ERR_WINDOW);
+    CHECK(out.empty());
+
+    /* Streams compressed for the window are fine, with the window full many times over */
+    std::string long_text = playlist(500);
+    CHECK(small.decompress(compress(long_text, GZIP, 10, 9), ESP_TRANSPORT_INFLATE_GZIP) == long_text);
+    CHECK(small.decompress(compress(long_text, 1, 10, 9), ESP_TRANSPORT_INFLATE_DEFLATE) == long_text);
+    CHECK(small.decompress(compress(long_text, GZIP, 10, 9), ESP_TRANSPORT_INFLATE_GZIP, 13, 1) == long_text);
+
+    CHECK(esp_transport_inflate_create(7) == nullptr);
+    CHECK(esp_transport_inflate_create(16) == nullptr);
+}
+
+TEST_CASE("corrupt and truncated streams are detected", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(50);
+    std::string out;
+
+    bytes gzip = compress(text, GZIP);
+    bytes bad_crc = gzip;
+    bad_crc[bad_crc.size() - 8] ^= 1;
+    CHECK(d.run(bad_crc, ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_ERR_CHECK);
+    CHECK(out == text);
+
+    bytes bad_size = gzip;
+    bad_size[bad_size.size() - 1] ^= 1;
+    CHECK(d.run(bad_size, ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_ERR_CHECK);
+
+    bytes zlib = compress(text, 1);
+    zlib[zlib.size() - 1] ^= 1;
+    CHECK(d.run(zlib, ESP_TRANSPORT_INFLATE_DEFLATE, out) == ESP_TRANSPORT_INFLATE_ERR_CHECK);
+
+    bytes bad_magic = gzip;
+    bad_magic[1] = 0;
+    CHECK(d.run(bad_magic, ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_ERR_DATA);
+
+    /* Invalid block type */
+    bytes bad_block = {0x07, 0x00};
+    CHECK(d.run(bad_block, ESP_TRANSPORT_INFLATE_RAW, out) == ESP_TRANSPORT_INFLATE_ERR_DATA);
+
+    /* Fixed codes, a match of distance 1 before any output */
+    bytes no_history = {0x03, 0x02, 0x00};
+    CHECK(d.run(no_history, ESP_TRANSPORT_INFLATE_RAW, out) == ESP_TRANSPORT_INFLATE_ERR_DATA);
+
+    for (size_t cut : {(size_t)5, (size_t)20, gzip.size() / 2, gzip.size() - 1}) {
+        CAPTURE(cut);
+        bytes truncated(gzip.begin(), gzip.begin() + cut);
+        CHECK(d.run(truncated, ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_OK);
+    }
+}
+
+TEST_CASE("input after the end of the stream is ignored", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(10);
+    bytes stream = compress(text, GZIP);
+    stream.insert(stream.end(), 100, 0xff);
+
+    std::string out;
+    CHECK(d.run(stream, ESP_TRANSPORT_INFLATE_GZIP, out) == ESP_TRANSPORT_INFLATE_DONE);
+    CHECK(out == text);
+
+    /* A call after the end produces nothing */
+    uint8_t buf[16];
+    size_t consumed = 1, produced = 1;
+    CHECK(esp_transport_inflate_run(d.h, stream.data(), 10, &consumed, buf, sizeof(buf), &produced) ==
+          ESP_TRANSPORT_INFLATE_DONE);
+    CHECK(produced == 0);
+}
+
+TEST_CASE("a decoder is reused after an error", "[inflate]")
+{
+    decoder d;
+    std::string text = playlist(30);
+    std::string out;
+    bytes garbage = {0x1f, 0x8b, 0x08, 0x00, 0, 0, 0, 0, 0, 0x03, 0xff, 0xff, 0xff};
+    CHECK(d.run(garbage, ESP_TRANSPORT_INFLATE_GZIP, out) < 0);
+    CHECK(d.decompress(compress(text, GZIP), ESP_TRANSPORT_INFLATE_GZIP) == text);
+}
+
+TEST_CASE("matches of a stream may refer to the previous stream", "[inflate]")
+{
+    std::string first = playlist(20);
+    std::string second = playlist(21).substr(first.size() - 200);
+
+    /* The second stream is compressed with the first one as its dictionary */
+    z_stream zs = {};
+    REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    REQUIRE(deflateSetDictionary(&zs, (const Bytef *)first.data(), first.size()) == Z_OK);
+    bytes stream(deflateBound(&zs, second.size()) + 64);
+    zs.next_in = (Bytef *)second.data();
+    zs.avail_in = second.size();
+    zs.next_out = stream.data();
+    zs.avail_out = stream.size();
+    REQUIRE(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    stream.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    decoder d;
+    std::string out;
+    CHECK(d.decompress(compress(first, RAW), ESP_TRANSPORT_INFLATE_RAW) == first);
+    CHECK(d.run(stream, ESP_TRANSPORT_INFLATE_RAW, out, 4096, 4096, true) == ESP_TRANSPORT_INFLATE_DONE);
+    CHECK(out == second);
+
+    /* Without the previous output the matches point before the stream */
+    CHECK(d.decompress(compress(first, RAW), ESP_TRANSPORT_INFLATE_RAW) == first);
+    CHECK(d.run(stream, ESP_TRANSPORT_INFLATE_RAW, out) == ESP_TRANSPORT_INFLATE_ERR_DATA);
+}
+
+TEST_CASE("a sync flush is reached with an output buffer of the exact size", "[inflate]")
+{
+    std::string text = playlist(10);
+    z_stream zs = {};
+    REQUIRE(deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    bytes stream(deflateBound(&zs, text.size()) + 64);
+    zs.next_in = (Bytef *)text.data();
+    zs.avail_in = text.size();
+    zs.next_out = stream.data();
+    zs.avail_out = stream.size();
+    REQUIRE(deflate(&zs, Z_SYNC_FLUSH) == Z_OK);
+    stream.resize(zs.total_out);
+    deflateEnd(&zs);
+
+    decoder d;
+    for (size_t size : {text.size() - 1, text.size(), text.size() + 1}) {
+        CAPTURE(size);
+        esp_transport_inflate_reset(d.h, ESP_TRANSPORT_INFLATE_RAW, false);
+        std::vector<uint8_t> buf(size);
+        size_t consumed = 0, produced = 0;
+        CHECK(esp_transport_inflate_run(d.h, stream.data(), stream.size(), &consumed, buf.data(), buf.size(), &produced) ==
+              ESP_TRANSPORT_INFLATE_OK);
+        CHECK(produced == std::min(size, text.size()));
+        CHECK(esp_transport_inflate_flushed(d.h) == (size >= text.size()));
+    }
+}
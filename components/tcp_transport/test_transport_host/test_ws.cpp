@@ -0,0 +1,434 @@
+#include "catch.hpp"
+
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "sdkconfig.h"
+#include "esp_transport.h"
+#include "esp_transport_ws.h"
+#include "esp_transport_utils.h"
+}
+
+namespace {
+
+void mask_bytewise(char *buffer, size_t len, const char *mask, size_t offset)
+{
+    for (size_t i = 0; i < len; ++i) {
+        buffer[i] = (buffer[i] ^ mask[(offset + i) % 4]);
+    }
+}
+
+/* Parent transport standing in for TCP: records writes and serves reads
+ * from a buffer, at most max_read bytes at a time */
+struct mock_parent {
+    std::vector<std::vector<char>> writes;
+    std::vector<char> rx;
+    size_t rx_pos;
+    int max_read;
+};
+
+mock_parent *get_mock(esp_transport_handle_t t)
+{
+    return static_cast<mock_parent *>(esp_transport_get_context_data(t));
+}
+
+int mock_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    return 0;
+}
+
+int mock_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    get_mock(t)->writes.emplace_back(buffer, buffer + len);
+    return len;
+}
+
+int mock_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    mock_parent *mock = get_mock(t);
+    size_t n = std::min<size_t>({(size_t)len, (size_t)mock->max_read, mock->rx.size() - mock->rx_pos});
+    memcpy(buffer, mock->rx.data() + mock->rx_pos, n);
+    mock->rx_pos += n;
+    return n;
+}
+
+int mock_poll(esp_transport_handle_t t, int timeout_ms)
+{
+    return 1;
+}
+
+/* Frames as sent by a server, unmasked */
+void add_frame(std::vector<char> &rx, uint8_t first_byte, const std::vector<uint8_t> &payload)
+{
+    rx.push_back((char)first_byte);
+    rx.push_back((char)payload.size());
+    rx.insert(rx.end(), payload.begin(), payload.end());
+}
+
+struct ws_fixture {
+    mock_parent mock = {};
+    esp_transport_handle_t parent;
+    esp_transport_handle_t ws;
+
+    ws_fixture()
+    {
+        mock.max_read = 1 << 20;
+        parent = esp_transport_init();
+        esp_transport_set_func(parent, mock_connect, mock_read, mock_write, NULL, mock_poll, mock_poll, NULL);
+        esp_transport_set_context_data(parent, &mock);
+        ws = esp_transport_ws_init(parent);
+        REQUIRE(ws != NULL);
+    }
+
+    ~ws_fixture()
+    {
+        esp_transport_destroy(ws);
+        esp_transport_destroy(parent);
+    }
+
+    /* The response is read at once, so the frames following it are kept for later */
+    int connect(const char *extensions, const esp_transport_ws_deflate_config_t *config)
+    {
+        REQUIRE(esp_transport_ws_set_deflate(ws, config) == ESP_OK);
+        std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: \r\n";
+        if (extensions) {
+            response += std::string("Sec-WebSocket-Extensions: ") + extensions + "\r\n";
+        }
+        response += "\r\n";
+        mock.rx.assign(response.begin(), response.end());
+        mock.rx_pos = 0;
+        mock.max_read = response.size();
+        int ret = esp_transport_connect(ws, "localhost", 80, 1000);
+        mock.rx.clear();
+        mock.rx_pos = 0;
+        mock.max_read = 1 << 20;
+        return ret;
+    }
+
+    std::string request()
+    {
+        REQUIRE(!mock.writes.empty());
+        return std::string(mock.writes[0].begin(), mock.writes[0].end());
+    }
+
+    /* Frames written after the handshake, unmasked */
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> sent_frames()
+    {
+        std::vector<char> data;
+        for (size_t i = 1; i < mock.writes.size(); i++) {
+            data.insert(data.end(), mock.writes[i].begin(), mock.writes[i].end());
+        }
+        std::vector<std::pair<uint8_t, std::vector<uint8_t>>> frames;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            uint8_t first_byte = data[pos];
+            size_t len = data[pos + 1] & 0x7f;
+            REQUIRE(len < 126);
+            const char *mask = &data[pos + 2];
+            std::vector<char> payload(data.begin() + pos + 6, data.begin() + pos + 6 + len);
+            mask_bytewise(payload.data(), len, mask, 0);
+            frames.emplace_back(first_byte, std::vector<uint8_t>(payload.begin(), payload.end()));
+            pos += 6 + len;
+        }
+        return frames;
+    }
+
+    std::string read_message()
+    {
+        char buffer[4];
+        std::string message;
+        do {
+            int rlen = esp_transport_read(ws, buffer, sizeof(buffer), 1000);
+            REQUIRE(rlen >= 0);
+            message.append(buffer, rlen);
+        } while ((int)message.size() < esp_transport_ws_get_read_payload_len(ws));
+        return message;
+    }
+};
+
+
+std::vector<char> make_payload(size_t len)
+{
+    std::vector<char> payload(len);
+    for (size_t i = 0; i < len; i++) {
+        payload[i] = (char)(i * 7 + 3);
+    }
+    return payload;
+}
+
+} // namespace
+
+TEST_CASE("ws mask matches byte-wise masking", "[ws]")
+{
+    const char mask[4] = { (char)0x12, (char)0x34, (char)0xab, (char)0xcd };
+    std::vector<char> src_buf(128 + 8), dst_buf(128 + 8);
+    for (size_t len = 0; len < 80; len++) {
+        for (size_t src_align = 0; src_align < 4; src_align++) {
+            for (size_t dst_align = 0; dst_align < 4; dst_align++) {
+                for (size_t offset = 0; offset < 8; offset++) {
+                    char *src = src_buf.data() + src_align;
+                    char *dst = dst_buf.data() + dst_align;
+                    std::vector<char> payload = make_payload(len);
+                    memcpy(src, payload.data(), len);
+                    esp_transport_utils_ws_mask(dst, src, len, mask, offset);
+                    mask_bytewise(payload.data(), len, mask, offset);
+                    CHECK(memcmp(dst, payload.data(), len) == 0);
+
+                    /* In place */
+                    esp_transport_utils_ws_mask(src, src, len, mask, offset);
+                    CHECK(memcmp(src, payload.data(), len) == 0);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ws frame is written at once and the data left untouched", "[ws]")
+{
+    for (int len : { 0, 1, 125, 126, 1000, 1024, 65535, 65536, 70000 }) {
+        ws_fixture f;
+        const std::vector<char> payload = make_payload(len);
+        const std::vector<char> original = payload;
+        REQUIRE(esp_transport_ws_send_raw(f.ws, WS_TRANSPORT_OPCODES_BINARY, payload.data(), len, 1000) == len);
+        CHECK(payload == original);
+
+        /* Frames which fit in the TX buffer go out in a single write */
+        const int chunk = CONFIG_WS_TX_BUFFER_SIZE;
+        size_t expected_writes = len <= chunk ? 1 : (len + chunk - 1) / chunk;
+        CHECK(f.mock.writes.size() == expected_writes);
+
+        std::vector<char> frame;
+        for (auto &w : f.mock.writes) {
+            frame.insert(frame.end(), w.begin(), w.end());
+        }
+        size_t header_len = len <= 125 ? 2 : len < 65536 ? 4 : 10;
+        REQUIRE(frame.size() == header_len + 4 + len);
+        CHECK((uint8_t)frame[0] == WS_TRANSPORT_OPCODES_BINARY);
+        CHECK((frame[1] & 0x80) != 0);
+
+        const char *mask = &frame[header_len];
+        std::vector<char> received(frame.begin() + header_len + 4, frame.end());
+        mask_bytewise(received.data(), len, mask, 0);
+        CHECK(received == original);
+    }
+}
+
+TEST_CASE("ws masked payload read in parts is unmasked", "[ws]")
+{
+    ws_fixture f;
+    const int len = 1000;
+    const std::vector<char> payload = make_payload(len);
+    const char mask[4] = { 1, 2, 3, 4 };
+
+    std::vector<char> &rx = f.mock.rx;
+    rx = { (char)(0x80 | WS_TRANSPORT_OPCODES_BINARY), (char)(0x80 | 126), (char)(len >> 8), (char)(len & 0xff) };
+    rx.insert(rx.end(), mask, mask + 4);
+    size_t payload_pos = rx.size();
+    rx.insert(rx.end(), payload.begin(), payload.end());
+    mask_bytewise(rx.data() + payload_pos, len, mask, 0);
+
+    /* Parts not multiple of the key length */
+    f.mock.max_read = 7;
+    std::vector<char> received;
+    char buffer[13];
+    while ((int)received.size() < len) {
+        int rlen = esp_transport_read(f.ws, buffer, sizeof(buffer), 1000);
+        REQUIRE(rlen > 0);
+        received.insert(received.end(), buffer, buffer + rlen);
+    }
+    CHECK(received == payload);
+}
+
+TEST_CASE("ws permessage-deflate is negotiated in the handshake", "[ws][ws_deflate]")
+{
+    esp_transport_ws_deflate_config_t config = {};
+    SECTION("accepted") {
+        ws_fixture f;
+        REQUIRE(f.connect("permessage-deflate; server_max_window_bits=11; client_max_window_bits=11", &config) == 0);
+        /* Both windows default to 2^11 bytes */
+        CHECK(f.request().find("\r\nSec-WebSocket-Extensions: permessage-deflate; client_max_window_bits=11; server_max_window_bits=11\r\n") != std::string::npos);
+    }
+    SECTION("declined by the server") {
+        ws_fixture f;
+        REQUIRE(f.connect(NULL, &config) == 0);
+        REQUIRE(esp_transport_ws_send_raw(f.ws, (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_TEXT | WS_TRANSPORT_OPCODES_FIN), "Hello", 5, 1000) == 5);
+        auto frames = f.sent_frames();
+        REQUIRE(frames.size() == 1);
+        CHECK(frames[0].first == 0x81);
+        CHECK(frames[0].second == std::vector<uint8_t>({ 'H', 'e', 'l', 'l', 'o' }));
+    }
+    SECTION("not offered") {
+        ws_fixture f;
+        REQUIRE(f.connect(NULL, NULL) == 0);
+        CHECK(f.request().find("Sec-WebSocket-Extensions") == std::string::npos);
+    }
+    SECTION("invalid response") {
+        ws_fixture f;
+        /* Larger window than offered */
+        CHECK(f.connect("permessage-deflate; server_max_window_bits=11; client_max_window_bits=12", &config) < 0);
+    }
+}
+
+TEST_CASE("ws compressed messages match the RFC 7692 examples", "[ws][ws_deflate]")
+{
+    const std::vector<uint8_t> hello = { 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 };
+    esp_transport_ws_deflate_config_t config = {};
+    /* The examples use the whole window */
+    config.server_max_window_bits = 15;
+    ws_fixture f;
+    REQUIRE(f.connect("permessage-deflate; client_max_window_bits=11", &config) == 0);
+
+    SECTION("sent") {
+        REQUIRE(esp_transport_ws_send_raw(f.ws, (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_TEXT | WS_TRANSPORT_OPCODES_FIN), "Hello", 5, 1000) == 5);
+        /* In fragments, RSV1 is only set on the first frame */
+        REQUIRE(esp_transport_ws_send_raw(f.ws, WS_TRANSPORT_OPCODES_TEXT, "Hel", 3, 1000) == 3);
+        REQUIRE(esp_transport_ws_send_raw(f.ws, WS_TRANSPORT_OPCODES_FIN, "lo", 2, 1000) == 2);
+        /* Control frames are not compressed */
+        REQUIRE(esp_transport_write(f.ws, NULL, 0, 1000) == 0);
+
+        auto frames = f.sent_frames();
+        REQUIRE(frames.size() == 4);
+        CHECK(frames[0].first == 0xc1);
+        CHECK(frames[0].second == hello);
+        CHECK(frames[1].first == 0x41);
+        CHECK(frames[2].first == 0x80);
+        CHECK(frames[3].first == 0x89);
+        CHECK(frames[3].second.empty());
+
+        /* Each fragment is compressed as it is sent, and the second message
+         * refers to the first one */
+        esp_transport_ws_deflate_params_t params = {};
+        params.tx_window_bits = 11;
+        params.rx_window_bits = 11;
+        params.max_message_size = 64;
+        esp_transport_ws_deflate_handle_t server = esp_transport_ws_deflate_create(&params);
+        REQUIRE(server != NULL);
+        for (size_t i = 0; i < 3; i++) {
+            memcpy(esp_transport_ws_deflate_reserve(server, frames[i].second.size()), frames[i].second.data(), frames[i].second.size());
+            if (i == 1) {
+                continue;
+            }
+            char message[16];
+            size_t len = 0;
+            CHECK(esp_transport_ws_deflate_finish(server, message, sizeof(message), &len) == ESP_OK);
+            CHECK(std::string(message, len) == "Hello");
+        }
+        esp_transport_ws_deflate_destroy(server);
+    }
+    SECTION("received") {
+        std::vector<char> &rx = f.mock.rx;
+        /* Section 7.2.3.1 */
+        add_frame(rx, 0xc1, hello);
+        /* Section 7.2.3.1 fragmented, with a ping in between */
+        add_frame(rx, 0x41, { 0xf2, 0x48, 0xcd });
+        add_frame(rx, 0x89, { 'p', 'i', 'n', 'g' });
+        add_frame(rx, 0x80, { 0xc9, 0xc9, 0x07, 0x00 });
+        /* Section 7.2.3.2, referring to the previous message */
+        add_frame(rx, 0xc2, { 0xf2, 0x00, 0x11, 0x00, 0x00 });
+        /* Not compressed */
+        add_frame(rx, 0x81, { 'H', 'i' });
+
+        CHECK(f.read_message() == "Hello");
+        CHECK(esp_transport_ws_get_read_opcode(f.ws) == WS_TRANSPORT_OPCODES_TEXT);
+        CHECK(f.read_message() == "ping");
+        CHECK(esp_transport_ws_get_read_opcode(f.ws) == WS_TRANSPORT_OPCODES_PING);
+        CHECK(f.read_message() == "Hello");
+        CHECK(esp_transport_ws_get_read_opcode(f.ws) == WS_TRANSPORT_OPCODES_TEXT);
+        CHECK(f.read_message() == "Hello");
+        CHECK(esp_transport_ws_get_read_opcode(f.ws) == WS_TRANSPORT_OPCODES_BINARY);
+        CHECK(esp_transport_ws_get_read_payload_len(f.ws) == 5);
+        CHECK(f.read_message() == "Hi");
+    }
+    SECTION("invalid data fails the read") {
+        add_frame(f.mock.rx, 0xc1, { 0xff, 0xff, 0xff });
+        char buffer[16];
+        CHECK(esp_transport_read(f.ws, buffer, sizeof(buffer), 1000) < 0);
+    }
+}
+
+TEST_CASE("ws compressed frame is written at once", "[ws][ws_deflate]")
+{
+    esp_transport_ws_deflate_config_t config = {};
+    config.server_max_window_bits = 15;
+    ws_fixture f;
+    REQUIRE(f.connect("permessage-deflate; client_max_window_bits=11", &config) == 0);
+    f.mock.writes.clear();
+
+    /* Random data doesn't compress, so the frame is larger than the TX buffer */
+    const int len = 64 * 1024;
+    std::vector<char> payload(len);
+    uint32_t seed = 1;
+    for (char &c : payload) {
+        seed = seed * 1103515245 + 12345;
+        c = (char)(seed >> 16);
+    }
+    const std::vector<char> original = payload;
+    const ws_transport_opcodes_t opcode = (ws_transport_opcodes_t)(WS_TRANSPORT_OPCODES_BINARY | WS_TRANSPORT_OPCODES_FIN);
+    REQUIRE(esp_transport_ws_send_raw(f.ws, opcode, payload.data(), len, 1000) == len);
+    CHECK(payload == original);
+    REQUIRE(f.mock.writes.size() == 1);
+
+    const std::vector<char> &frame = f.mock.writes[0];
+    CHECK((uint8_t)frame[0] == (0x40 | opcode));
+    REQUIRE((uint8_t)frame[1] == (0x80 | 127));
+    size_t compressed_len = 0;
+    for (int i = 2; i < 10; i++) {
+        compressed_len = (compressed_len << 8) | (uint8_t)frame[i];
+    }
+    CHECK(compressed_len > (size_t)CONFIG_WS_TX_BUFFER_SIZE);
+    CHECK(frame.size() == 14 + compressed_len);
+
+    std::vector<char> compressed(frame.begin() + 14, frame.end());
+    mask_bytewise(compressed.data(), compressed.size(), &frame[10], 0);
+    esp_transport_ws_deflate_params_t params = {};
+    params.tx_window_bits = 15;
+    params.rx_window_bits = 11;
+    params.max_message_size = 2 * len;
+    esp_transport_ws_deflate_handle_t server = esp_transport_ws_deflate_create(&params);
+    REQUIRE(server != NULL);
+    char *in = esp_transport_ws_deflate_reserve(server, compressed.size());
+    REQUIRE(in != NULL);
+    memcpy(in, compressed.data(), compressed.size());
+    std::vector<char> message(len);
+    size_t message_len = 0;
+    CHECK(esp_transport_ws_deflate_finish(server, message.data(), message.size(), &message_len) == ESP_OK);
+    CHECK(message_len == (size_t)len);
+    CHECK(message == original);
+    esp_transport_ws_deflate_destroy(server);
+}
+
+TEST_CASE("ws mask throughput", "[ws][benchmark]")
+{
+    const char mask[4] = { (char)0x12, (char)0x34, (char)0xab, (char)0xcd };
+    for (size_t len : { 1024, 4096, 16384, 65536 }) {
+        std::vector<char> src = make_payload(len);
+        std::vector<char> dst(len + 16);
+        const size_t total = 64 * 1024 * 1024;
+        const size_t rounds = total / len;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; r++) {
+            mask_bytewise(src.data(), len, mask, r);
+        }
+        auto bytewise = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; r++) {
+            esp_transport_utils_ws_mask(dst.data(), src.data(), len, mask, r);
+        }
+        auto kernel = std::chrono::steady_clock::now() - start;
+
+        double bytewise_s = std::chrono::duration<double>(bytewise).count();
+        double kernel_s = std::chrono::duration<double>(kernel).count();
+        printf("%6zu byte frames: byte-wise %7.1f MB/s, word-wide %7.1f MB/s\n", len,
+               total / bytewise_s / 1e6, total / kernel_s / 1e6);
+        CHECK(kernel_s < bytewise_s);
+    }
+}
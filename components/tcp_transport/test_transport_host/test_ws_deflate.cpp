@@ -0,0 +1,417 @@
+#include "catch.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "esp_transport_ws_deflate.h"
+}
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+esp_transport_ws_deflate_params_t make_params(uint8_t bits, bool no_context_takeover)
+{
+    esp_transport_ws_deflate_params_t params = {};
+    params.tx_window_bits = bits;
+    params.tx_no_context_takeover = no_context_takeover;
+    params.rx_window_bits = bits;
+    params.rx_no_context_takeover = no_context_takeover;
+    params.max_message_size = 256 * 1024;
+    return params;
+}
+
+struct codec {
+    esp_transport_ws_deflate_handle_t h;
+
+    explicit codec(const esp_transport_ws_deflate_params_t &params)
+    {
+        h = esp_transport_ws_deflate_create(&params);
+        REQUIRE(h != NULL);
+    }
+    ~codec()
+    {
+        esp_transport_ws_deflate_destroy(h);
+    }
+
+    bytes compress(const std::string &data, bool final = true)
+    {
+        bytes out(esp_transport_ws_deflate_bound(data.size()));
+        size_t len = 0;
+        REQUIRE(esp_transport_ws_deflate_compress(h, data.data(), data.size(), final, (char *)out.data(), &len) == ESP_OK);
+        REQUIRE(len <= out.size());
+        out.resize(len);
+        return out;
+    }
+
+    void feed(const bytes &data)
+    {
+        char *dst = esp_transport_ws_deflate_reserve(h, data.size());
+        REQUIRE(dst != NULL);
+        memcpy(dst, data.data(), data.size());
+    }
+
+    std::string decompress(const bytes &data)
+    {
+        feed(data);
+        std::vector<char> out(256 * 1024);
+        size_t len = 0;
+        REQUIRE(esp_transport_ws_deflate_finish(h, out.data(), out.size(), &len) == ESP_OK);
+        return std::string(out.data(), len);
+    }
+};
+
+/* Telemetry as sent by our devices */
+std::string telemetry(int seq)
+{
+    char msg[512];
+    snprintf(msg, sizeof(msg),
+             "{\"device\":\"esp32-%04d\",\"seq\":%d,\"ts\":%d,\"temperature\":%d.%d,\"humidity\":%d.%d,"
+             "\"rssi\":-%d,\"status\":\"ok\",\"uptime\":%d,\"heap\":{\"free\":%d,\"min\":%d},"
+             "\"readings\":[%d,%d,%d,%d,%d,%d,%d,%d]}",
+             42, seq, 1603100000 + seq * 5, 20 + seq % 7, seq % 10, 40 + seq % 13, (seq * 7) % 10,
+             50 + seq % 30, seq * 5, 150000 - seq % 1000, 120000,
+             seq % 100, (seq * 3) % 100, (seq * 7) % 100, (seq * 11) % 100,
+             (seq * 13) % 100, (seq * 17) % 100, (seq * 19) % 100, (seq * 23) % 100);
+    return msg;
+}
+
+std::string random_text(size_t len, unsigned seed)
+{
+    std::string s(len, ' ');
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245 + 12345;
+        /* Few distinct characters, so that there are matches at all distances */
+        s[i] = "abcdefgh{}\":,0123"[(seed >> 16) % 17];
+    }
+    return s;
+}
+
+/* Reference decompressor, keeping its window across messages as negotiated */
+struct zlib_inflater {
+    z_stream zs = {};
+    zlib_inflater()
+    {
+        REQUIRE(inflateInit2(&zs, -15) == Z_OK);
+    }
+    ~zlib_inflater()
+    {
+        inflateEnd(&zs);
+    }
+    std::string inflate_message(bytes data)
+    {
+        data.insert(data.end(), { 0x00, 0x00, 0xff, 0xff });
+        std::vector<char> out(512 * 1024);
+        zs.next_in = data.data();
+        zs.avail_in = data.size();
+        zs.next_out = (Bytef *)out.data();
+        zs.avail_out = out.size();
+        int ret = inflate(&zs, Z_SYNC_FLUSH);
+        REQUIRE((ret == Z_OK || ret == Z_BUF_ERROR));
+        REQUIRE(zs.avail_in == 0);
+        return std::string(out.data(), out.size() - zs.avail_out);
+    }
+};
+
+struct zlib_deflater {
+    z_stream zs = {};
+    explicit zlib_deflater(int bits)
+    {
+        REQUIRE(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -bits, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    }
+    ~zlib_deflater()
+    {
+        deflateEnd(&zs);
+    }
+    bytes deflate_message(const std::string &data)
+    {
+        bytes out(deflateBound(&zs, data.size()) + 16);
+        zs.next_in = (Bytef *)data.data();
+        zs.avail_in = data.size();
+        zs.next_out = out.data();
+        zs.avail_out = out.size();
+        int ret = deflate(&zs, Z_SYNC_FLUSH);
+        out.resize(out.size() - zs.avail_out);
+        if (data.empty() && ret == Z_BUF_ERROR) {
+            /* Nothing to flush after the previous message */
+            return out;
+        }
+        REQUIRE(ret == Z_OK);
+        REQUIRE(out.size() >= 4);
+        REQUIRE(bytes(out.end() - 4, out.end()) == bytes({ 0x00, 0x00, 0xff, 0xff }));
+        out.resize(out.size() - 4);
+        return out;
+    }
+};
+
+} // namespace
+
+TEST_CASE("ws deflate output matches the RFC 7692 examples", "[ws_deflate]")
+{
+    SECTION("with context takeover") {
+        codec c(make_params(15, false));
+        CHECK(c.compress("Hello") == bytes({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }));
+        /* Section 7.2.3.2, the second message refers to the first one. The
+         * example has a literal then a match, this is a single match */
+        CHECK(c.compress("Hello") == bytes({ 0x02, 0x13, 0x00, 0x00 }));
+        zlib_inflater ref;
+        CHECK(ref.inflate_message({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }) == "Hello");
+        CHECK(ref.inflate_message({ 0x02, 0x13, 0x00, 0x00 }) == "Hello");
+    }
+    SECTION("without context takeover") {
+        codec c(make_params(15, true));
+        CHECK(c.compress("Hello") == bytes({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }));
+        CHECK(c.compress("Hello") == bytes({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }));
+    }
+    SECTION("in fragments") {
+        codec c(make_params(15, false));
+        bytes out = c.compress("Hel", false);
+        bytes rest = c.compress("lo", true);
+        out.insert(out.end(), rest.begin(), rest.end());
+        CHECK(out == bytes({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }));
+    }
+}
+
+TEST_CASE("ws deflate decompresses the RFC 7692 examples", "[ws_deflate]")
+{
+    codec c(make_params(15, false));
+    /* Section 7.2.3.1 */
+    CHECK(c.decompress({ 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 }) == "Hello");
+    /* Section 7.2.3.2, referring to the previous message */
+    CHECK(c.decompress({ 0xf2, 0x00, 0x11, 0x00, 0x00 }) == "Hello");
+    /* Section 7.2.3.3, stored block */
+    CHECK(c.decompress({ 0x00, 0x05, 0x00, 0xfa, 0xff, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x00 }) == "Hello");
+    /* Section 7.2.3.4, final block */
+    CHECK(c.decompress({ 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00, 0x00 }) == "Hello");
+    /* Section 7.2.3.5, two blocks */
+    CHECK(c.decompress({ 0xf2, 0x48, 0x05, 0x00, 0x00, 0x00, 0xff, 0xff, 0xca, 0xc9, 0xc9, 0x07, 0x00 }) == "Hello");
+    /* Section 7.2.3.1, fragmented */
+    c.feed({ 0xf2, 0x48, 0xcd });
+    CHECK(c.decompress({ 0xc9, 0xc9, 0x07, 0x00 }) == "Hello");
+    /* Empty messages */
+    CHECK(c.decompress({ 0x00 }) == "");
+    CHECK(c.decompress({}) == "");
+}
+
+TEST_CASE("ws deflate interoperates with zlib", "[ws_deflate]")
+{
+    for (uint8_t bits = 8; bits <= 15; bits++) {
+        for (bool no_context_takeover : { false, true }) {
+            CAPTURE((int)bits);
+            CAPTURE(no_context_takeover);
+            codec ours(make_params(bits, no_context_takeover));
+            zlib_inflater ref_inflater;
+            zlib_deflater ref_deflater(bits < 9 ? 9 : bits);
+
+            std::vector<std::string> messages;
+            for (int i = 0; i < 20; i++) {
+                messages.push_back(telemetry(i));
+            }
+            messages.push_back(random_text(100000, bits));
+            messages.push_back(std::string(70000, 'x'));
+            messages.push_back("");
+            messages.push_back(telemetry(1000));
+
+            for (const std::string &msg : messages) {
+                /* Compressed in parts of various sizes, as sent in fragments */
+                bytes compressed;
+                size_t done = 0, part = 1;
+                while (done < msg.size()) {
+                    size_t len = std::min(part, msg.size() - done);
+                    bytes out = ours.compress(msg.substr(done, len), done + len == msg.size());
+                    compressed.insert(compressed.end(), out.begin(), out.end());
+                    done += len;
+                    part = part * 3 + 1;
+                }
+                if (msg.empty()) {
+                    compressed = ours.compress("");
+                }
+                CHECK(compressed.size() <= esp_transport_ws_deflate_bound(msg.size()));
+                REQUIRE(ref_inflater.inflate_message(compressed) == msg);
+                if (no_context_takeover) {
+                    REQUIRE(inflateReset(&ref_inflater.zs) == Z_OK);
+                }
+
+                REQUIRE(ours.decompress(ref_deflater.deflate_message(msg)) == msg);
+                if (no_context_takeover) {
+                    REQUIRE(deflateReset(&ref_deflater.zs) == Z_OK);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ws deflate sends incompressible messages in stored blocks", "[ws_deflate]")
+{
+    std::string noise(1000, ' ');
+    unsigned seed = 1;
+    for (char &c : noise) {
+        seed = seed * 1103515245 + 12345;
+        c = seed >> 16;
+    }
+    codec ours(make_params(11, false));
+    codec peer(make_params(11, false));
+    zlib_inflater ref;
+    bytes out = ours.compress(noise);
+    CHECK(out.size() == noise.size() + 6);
+    CHECK(ref.inflate_message(out) == noise);
+    CHECK(peer.decompress(out) == noise);
+    /* The window still holds the message */
+    out = ours.compress(noise);
+    CHECK(out.size() < 16);
+    CHECK(ref.inflate_message(out) == noise);
+    CHECK(peer.decompress(out) == noise);
+}
+
+TEST_CASE("ws deflate bounds the messages received", "[ws_deflate]")
+{
+    esp_transport_ws_deflate_params_t params = make_params(11, false);
+    params.max_message_size = 64;
+    codec c(params);
+    bytes hello = { 0xf2, 0x48, 0xcd, 0xc9, 0xc9, 0x07, 0x00 };
+
+    CHECK(esp_transport_ws_deflate_reserve(c.h, 60) != NULL);
+    CHECK(esp_transport_ws_deflate_reserve(c.h, 5) == NULL);
+    /* Invalid data */
+    std::vector<char> out(64);
+    size_t len;
+    memset(esp_transport_ws_deflate_reserve(c.h, 0) - 60, 0xff, 60);
+    CHECK(esp_transport_ws_deflate_finish(c.h, out.data(), out.size(), &len) == ESP_FAIL);
+
+    /* Output too small */
+    codec d(make_params(11, true));
+    d.feed(hello);
+    CHECK(esp_transport_ws_deflate_finish(d.h, out.data(), 4, &len) == ESP_ERR_INVALID_SIZE);
+    CHECK(d.decompress(hello) == "Hello");
+
+    /* Match reaching before the first message */
+    codec e(make_params(11, false));
+    e.feed({ 0xf2, 0x00, 0x11, 0x00, 0x00 });
+    CHECK(esp_transport_ws_deflate_finish(e.h, out.data(), out.size(), &len) == ESP_FAIL);
+}
+
+TEST_CASE("ws deflate negotiation", "[ws_deflate]")
+{
+    esp_transport_ws_deflate_config_t client = {};
+    esp_transport_ws_deflate_config_t server = {};
+    esp_transport_ws_deflate_params_t client_params, server_params;
+    char offer[128], response[128];
+
+    SECTION("between our client and server") {
+        REQUIRE(esp_transport_ws_deflate_client_offer(&client, offer, sizeof(offer)) > 0);
+        CHECK(std::string(offer) == "permessage-deflate; client_max_window_bits=11; server_max_window_bits=11");
+        REQUIRE(esp_transport_ws_deflate_server_accept(&server, offer, &server_params, response, sizeof(response)) == ESP_OK);
+        CHECK(std::string(response) == "permessage-deflate; server_max_window_bits=11; client_max_window_bits=11");
+        REQUIRE(esp_transport_ws_deflate_client_accept(&client, response, &client_params) == ESP_OK);
+        CHECK(client_params.tx_window_bits == 11);
+        CHECK(client_params.rx_window_bits == 11);
+        CHECK_FALSE(client_params.tx_no_context_takeover);
+        CHECK_FALSE(client_params.rx_no_context_takeover);
+        CHECK(server_params.tx_window_bits == 11);
+        CHECK(server_params.rx_window_bits == 11);
+        CHECK(server_params.max_message_size == ESP_TRANSPORT_WS_DEFLATE_DEFAULT_MAX_MESSAGE);
+    }
+
+    SECTION("with windows and context takeover configured") {
+        client.client_max_window_bits = 10;
+        client.server_max_window_bits = 15;
+        client.client_no_context_takeover = true;
+        client.server_no_context_takeover = true;
+        REQUIRE(esp_transport_ws_deflate_client_offer(&client, offer, sizeof(offer)) > 0);
+        CHECK(std::string(offer) == "permessage-deflate; client_max_window_bits=10; client_no_context_takeover; server_no_context_takeover");
+        server.server_max_window_bits = 9;
+        server.client_max_window_bits = 12;
+        REQUIRE(esp_transport_ws_deflate_server_accept(&server, offer, &server_params, response, sizeof(response)) == ESP_OK);
+        CHECK(std::string(response) == "permessage-deflate; server_no_context_takeover; client_no_context_takeover; client_max_window_bits=10");
+        REQUIRE(esp_transport_ws_deflate_client_accept(&client, response, &client_params) == ESP_OK);
+        CHECK(client_params.tx_window_bits == 10);
+        CHECK(client_params.tx_no_context_takeover);
+        CHECK(client_params.rx_window_bits == 15);
+        CHECK(client_params.rx_no_context_takeover);
+        CHECK(server_params.tx_window_bits == 9);
+        CHECK(server_params.tx_no_context_takeover);
+        CHECK(server_params.rx_window_bits == 10);
+        CHECK(server_params.rx_no_context_takeover);
+    }
+
+    SECTION("server picks the first acceptable offer") {
+        /* As sent by web browsers */
+        REQUIRE(esp_transport_ws_deflate_server_accept(&server, "permessage-deflate; client_max_window_bits",
+                                                       &server_params, response, sizeof(response)) == ESP_OK);
+        CHECK(std::string(response) == "permessage-deflate; client_max_window_bits=11");
+
+        REQUIRE(esp_transport_ws_deflate_server_accept(&server,
+                                                       "x-webkit-deflate-frame, permessage-deflate; server_max_window_bits, "
+                                                       "permessage-deflate; client_max_window_bits=16, "
+                                                       "permessage-deflate; server_no_context_takeover; server_no_context_takeover, "
+                                                       "permessage-deflate; server_max_window_bits=\"10\"; client_max_window_bits=9",
+                                                       &server_params, response, sizeof(response)) == ESP_OK);
+        CHECK(std::string(response) == "permessage-deflate; server_max_window_bits=10; client_max_window_bits=9");
+        CHECK(server_params.tx_window_bits == 10);
+        CHECK(server_params.rx_window_bits == 9);
+
+        /* The client window could be 15 bits, more than what the server keeps */
+        CHECK(esp_transport_ws_deflate_server_accept(&server, "permessage-deflate", &server_params,
+                                                     response, sizeof(response)) == ESP_ERR_NOT_FOUND);
+        server.client_no_context_takeover = true;
+        REQUIRE(esp_transport_ws_deflate_server_accept(&server, "permessage-deflate", &server_params,
+                                                       response, sizeof(response)) == ESP_OK);
+        CHECK(std::string(response) == "permessage-deflate; client_no_context_takeover");
+        CHECK(server_params.rx_no_context_takeover);
+        CHECK(esp_transport_ws_deflate_server_accept(&server, "x-webkit-deflate-frame", &server_params,
+                                                     response, sizeof(response)) == ESP_ERR_NOT_FOUND);
+    }
+
+    SECTION("client rejects invalid responses") {
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=11", &client_params) == ESP_OK);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=12", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=11; client_max_window_bits=12", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=11; client_max_window_bits", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=11; foo", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "permessage-deflate; server_max_window_bits=11, x-foo", &client_params) == ESP_ERR_INVALID_RESPONSE);
+        CHECK(esp_transport_ws_deflate_client_accept(&client, "x-foo", &client_params) == ESP_ERR_INVALID_RESPONSE);
+    }
+}
+
+TEST_CASE("ws deflate ratio and throughput on telemetry", "[ws_deflate][benchmark]")
+{
+    for (bool no_context_takeover : { false, true }) {
+        codec tx(make_params(11, no_context_takeover));
+        codec rx(make_params(11, no_context_takeover));
+        size_t raw = 0, compressed = 0;
+        double compress_s = 0, decompress_s = 0;
+        std::vector<char> out(esp_transport_ws_deflate_bound(512));
+        std::vector<char> back(512);
+        for (int i = 0; i < 2000; i++) {
+            std::string msg = telemetry(i);
+            size_t out_len = 0, back_len = 0;
+            /* Buffers are allocated beforehand, only the API calls are timed */
+            auto start = std::chrono::steady_clock::now();
+            esp_err_t compress_err = esp_transport_ws_deflate_compress(tx.h, msg.data(), msg.size(), true, out.data(), &out_len);
+            auto mid = std::chrono::steady_clock::now();
+            char *dst = esp_transport_ws_deflate_reserve(rx.h, out_len);
+            REQUIRE(dst != NULL);
+            memcpy(dst, out.data(), out_len);
+            esp_err_t finish_err = esp_transport_ws_deflate_finish(rx.h, back.data(), back.size(), &back_len);
+            auto end = std::chrono::steady_clock::now();
+            REQUIRE(compress_err == ESP_OK);
+            REQUIRE(finish_err == ESP_OK);
+            REQUIRE(std::string(back.data(), back_len) == msg);
+            compress_s += std::chrono::duration<double>(mid - start).count();
+            decompress_s += std::chrono::duration<double>(end - mid).count();
+            raw += msg.size();
+            compressed += out_len;
+        }
+        double ratio = (double)raw / compressed;
+        printf("telemetry, %s context takeover: %zu bytes to %zu (%.1fx), compress %.1f MB/s, decompress %.1f MB/s\n",
+               no_context_takeover ? "no" : "with", raw, compressed, ratio, raw / compress_s / 1e6, raw / decompress_s / 1e6);
+        /* zlib level 6 with the same window gives 3.8x and 1.3x */
+        CHECK(ratio > (no_context_takeover ? 1.05 : 3.5));
+    }
+}
@@ -0,0 +1,786 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_transport_inflate.h"
+#include "esp_transport_utils.h"
+
+#if CONFIG_IDF_TARGET_ESP32
+#include "esp32/rom/crc.h"
+#elif CONFIG_IDF_TARGET_ESP32S2
+#include "esp32s2/rom/crc.h"
+#endif
+
+static const char *TAG = "TRANSPORT_INFLATE";
+
+#define MIN_WINDOW_BITS     8
+#define MAX_WINDOW_BITS     15
+#define MAX_CODE_BITS       15
+#define IN_BUF_SIZE         1024    /* Holds the header of a dynamic block, the longest piece decoded at once */
+
+#define GZIP_FHCRC          0x02
+#define GZIP_FEXTRA         0x04
+#define GZIP_FNAME          0x08
+#define GZIP_FCOMMENT       0x10
+#define GZIP_FRESERVED      0xe0
+
+/* Results of a step of the decoder, besides ESP_TRANSPORT_INFLATE_DONE and errors */
+#define STEP_CONTINUE       0
+#define STEP_NEED_INPUT     (-10)
+#define STEP_OUT_FULL       (-11)
+
+const uint16_t esp_transport_deflate_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t esp_transport_deflate_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t esp_transport_deflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+const uint8_t esp_transport_deflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+typedef enum {
+    STATE_GZIP_HEADER,
+    STATE_GZIP_EXTRA_LEN,
+    STATE_GZIP_EXTRA,
+    STATE_GZIP_NAME,
+    STATE_GZIP_COMMENT,
+    STATE_GZIP_HCRC,
+    STATE_DEFLATE_HEADER,       /* zlib header or raw deflate data */
+    STATE_ZLIB_HEADER,
+    STATE_BLOCK,                /* Header of the next block */
+    STATE_STORED,
+    STATE_CODES,
+    STATE_TRAILER,
+    STATE_DONE,
+} inflate_state_t;
+
+typedef enum {
+    FRAMING_GZIP,
+    FRAMING_ZLIB,
+    FRAMING_RAW,
+} inflate_framing_t;
+
+/* Canonical Huffman code, decoded as in zlib's puff */
+typedef struct {
+    int16_t count[MAX_CODE_BITS + 1];   /*!< Number of codes of each length */
+    int16_t symbol[288];                /*!< Symbols ordered by code */
+} inflate_huffman_t;
+
+/* Input position to go back to when a piece of the stream, such as a
+ * symbol with its extra bits, is not complete yet */
+typedef struct {
+    size_t in_pos;
+    uint32_t bits;
+    unsigned bit_count;
+} inflate_checkpoint_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t pos;
+    size_t summed;              /*!< Output up to here is in the checksum */
+} inflate_out_t;
+
+struct esp_transport_inflate {
+    inflate_state_t state;
+    inflate_framing_t framing;
+    int window_bits;
+    uint8_t *window;            /*!< Last output, circular */
+    size_t window_mask;
+    size_t window_pos;          /*!< Next byte written */
+    size_t window_have;         /*!< Bytes of the window written so far */
+    uint8_t gzip_flags;
+    size_t skip;                /*!< Bytes of the gzip extra field left */
+    bool last;                  /*!< The current block is the final one */
+    size_t stored_left;
+    size_t match_len;           /*!< Rest of a match which didn't fit the output */
+    size_t match_dist;
+    uint32_t crc;
+    uint32_t adler;
+    uint32_t total_out;         /*!< Modulo 2^32, as ISIZE of gzip */
+    uint32_t bits;
+    unsigned bit_count;
+    size_t in_pos;
+    size_t in_len;
+    uint8_t in[IN_BUF_SIZE];
+    inflate_huffman_t lencode;
+    inflate_huffman_t distcode;
+    bool fixed_tables;          /*!< Tables hold the fixed codes */
+    uint16_t lengths[320];
+};
+
+static inline void inflate_save(esp_transport_inflate_handle_t h, inflate_checkpoint_t *cp)
+{
+    cp->in_pos = h->in_pos;
+    cp->bits = h->bits;
+    cp->bit_count = h->bit_count;
+}
+
+static inline void inflate_restore(esp_transport_inflate_handle_t h, const inflate_checkpoint_t *cp)
+{
+    h->in_pos = cp->in_pos;
+    h->bits = cp->bits;
+    h->bit_count = cp->bit_count;
+}
+
+static inline size_t inflate_avail(esp_transport_inflate_handle_t h)
+{
+    return h->in_len - h->in_pos;
+}
+
+static uint32_t inflate_adler32(uint32_t adler, const uint8_t *buf, size_t len)
+{
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while (len) {
+        /* Largest n keeping b below 2^32 before the modulo, from zlib */
+        size_t n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n--) {
+            a += *buf++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+static void inflate_sum(esp_transport_inflate_handle_t h, inflate_out_t *out)
+{
+    size_t len = out->pos - out->summed;
+    const uint8_t *data = out->buf + out->summed;
+    if (h->framing == FRAMING_GZIP) {
+        h->crc = crc32_le(h->crc, data, len);
+    } else if (h->framing == FRAMING_ZLIB) {
+        h->adler = inflate_adler32(h->adler, data, len);
+    }
+    h->total_out += len;
+    out->summed = out->pos;
+}
+
+static inline void inflate_emit(esp_transport_inflate_handle_t h, inflate_out_t *out, uint8_t byte)
+{
+    out->buf[out->pos++] = byte;
+    h->window[h->window_pos] = byte;
+    h->window_pos = (h->window_pos + 1) & h->window_mask;
+    if (h->window_have <= h->window_mask) {
+        h->window_have++;
+    }
+}
+
+static int inflate_bits(esp_transport_inflate_handle_t h, unsigned need)
+{
+    uint32_t val = h->bits;
+    while (h->bit_count < need) {
+        if (h->in_pos == h->in_len) {
+            return STEP_NEED_INPUT;
+        }
+        val |= (uint32_t)h->in[h->in_pos++] << h->bit_count;
+        h->bit_count += 8;
+    }
+    h->bits = val >> need;
+    h->bit_count -= need;
+    return val & ((1u << need) - 1);
+}
+
+static int inflate_decode(esp_transport_inflate_handle_t h, const inflate_huffman_t *code)
+{
+    int val = 0, first = 0, index = 0;
+    for (int len = 1; len <= MAX_CODE_BITS; len++) {
+        int bit = inflate_bits(h, 1);
+        if (bit < 0) {
+            return bit;
+        }
+        val |= bit;
+        int count = code->count[len];
+        if (val - count < first) {
+            return code->symbol[index + (val - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        val <<= 1;
+    }
+    return ESP_TRANSPORT_INFLATE_ERR_DATA;
+}
+
+/* Returns 0 for a complete code, > 0 for an incomplete one, < 0 if over-subscribed */
+static int inflate_construct(inflate_huffman_t *code, const uint16_t *length, int n)
+{
+    int16_t offs[MAX_CODE_BITS + 1];
+    memset(code->count, 0, sizeof(code->count));
+    for (int sym = 0; sym < n; sym++) {
+        code->count[length[sym]]++;
+    }
+    if (code->count[0] == n) {
+        return 0;
+    }
+    int left = 1;
+    for (int len = 1; len <= MAX_CODE_BITS; len++) {
+        left <<= 1;
+        left -= code->count[len];
+        if (left < 0) {
+            return left;
+        }
+    }
+    offs[1] = 0;
+    for (int len = 1; len < MAX_CODE_BITS; len++) {
+        offs[len + 1] = offs[len] + code->count[len];
+    }
+    for (int sym = 0; sym < n; sym++) {
+        if (length[sym] != 0) {
+            code->symbol[offs[length[sym]]++] = sym;
+        }
+    }
+    return left;
+}
+
+static void inflate_fixed_tables(esp_transport_inflate_handle_t h)
+{
+    if (h->fixed_tables) {
+        return;
+    }
+    uint16_t *lengths = h->lengths;
+    int sym = 0;
+    for (; sym < 144; sym++) {
+        lengths[sym] = 8;
+    }
+    for (; sym < 256; sym++) {
+        lengths[sym] = 9;
+    }
+    for (; sym < 280; sym++) {
+        lengths[sym] = 7;
+    }
+    for (; sym < 288; sym++) {
+        lengths[sym] = 8;
+    }
+    inflate_construct(&h->lencode, lengths, 288);
+    for (sym = 0; sym < 30; sym++) {
+        lengths[sym] = 5;
+    }
+    inflate_construct(&h->distcode, lengths, 30);
+    h->fixed_tables = true;
+}
+
+static int inflate_dynamic_tables(esp_transport_inflate_handle_t h)
+{
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    uint16_t *lengths = h->lengths;
+
+    int nlen = inflate_bits(h, 5);
+    int ndist = inflate_bits(h, 5);
+    int ncode = inflate_bits(h, 4);
+    if (nlen < 0 || ndist < 0 || ncode < 0) {
+        return STEP_NEED_INPUT;
+    }
+    nlen += 257;
+    ndist += 1;
+    ncode += 4;
+    if (nlen > 286 || ndist > 30) {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+
+    int index;
+    for (index = 0; index < ncode; index++) {
+        int len = inflate_bits(h, 3);
+        if (len < 0) {
+            return len;
+        }
+        lengths[order[index]] = len;
+    }
+    for (; index < 19; index++) {
+        lengths[order[index]] = 0;
+    }
+    h->fixed_tables = false;
+    if (inflate_construct(&h->lencode, lengths, 19) != 0) {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+
+    index = 0;
+    while (index < nlen + ndist) {
+        int sym = inflate_decode(h, &h->lencode);
+        if (sym < 0) {
+            return sym;
+        }
+        if (sym < 16) {
+            lengths[index++] = sym;
+            continue;
+        }
+        int len = 0;
+        int repeat;
+        if (sym == 16) {
+            if (index == 0) {
+                return ESP_TRANSPORT_INFLATE_ERR_DATA;
+            }
+            len = lengths[index - 1];
+            repeat = inflate_bits(h, 2);
+            repeat = repeat < 0 ? repeat : 3 + repeat;
+        } else if (sym == 17) {
+            repeat = inflate_bits(h, 3);
+            repeat = repeat < 0 ? repeat : 3 + repeat;
+        } else {
+            repeat = inflate_bits(h, 7);
+            repeat = repeat < 0 ? repeat : 11 + repeat;
+        }
+        if (repeat < 0) {
+            return repeat;
+        }
+        if (index + repeat > nlen + ndist) {
+            return ESP_TRANSPORT_INFLATE_ERR_DATA;
+        }
+        while (repeat--) {
+            lengths[index++] = len;
+        }
+    }
+    if (lengths[256] == 0) {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+
+    /* Incomplete codes are only allowed for a single length */
+    int err = inflate_construct(&h->lencode, lengths, nlen);
+    if (err < 0 || (err > 0 && nlen - h->lencode.count[0] != 1)) {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+    err = inflate_construct(&h->distcode, lengths + nlen, ndist);
+    if (err < 0 || (err > 0 && ndist - h->distcode.count[0] != 1)) {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+    return STEP_CONTINUE;
+}
+
+/* Header of a block, with the length of a stored block or the tables of a
+ * dynamic one, decoded at once */
+static int inflate_block(esp_transport_inflate_handle_t h)
+{
+    inflate_checkpoint_t cp;
+    inflate_save(h, &cp);
+
+    int last = inflate_bits(h, 1);
+    int type = inflate_bits(h, 2);
+    int err = STEP_CONTINUE;
+    if (last < 0 || type < 0) {
+        err = STEP_NEED_INPUT;
+    } else if (type == 0) {
+        /* Rest of the current byte is dropped */
+        h->bits = 0;
+        h->bit_count = 0;
+        if (inflate_avail(h) < 4) {
+            err = STEP_NEED_INPUT;
+        } else {
+            const uint8_t *p = h->in + h->in_pos;
+            size_t len = p[0] | p[1] << 8;
+            if (p[2] != (~len & 0xff) || p[3] != ((~len >> 8) & 0xff)) {
+                return ESP_TRANSPORT_INFLATE_ERR_DATA;
+            }
+            h->in_pos += 4;
+            h->stored_left = len;
+            h->state = STATE_STORED;
+        }
+    } else if (type == 1) {
+        inflate_fixed_tables(h);
+        h->state = STATE_CODES;
+    } else if (type == 2) {
+        err = inflate_dynamic_tables(h);
+        h->state = STATE_CODES;
+    } else {
+        return ESP_TRANSPORT_INFLATE_ERR_DATA;
+    }
+    if (err == STEP_NEED_INPUT) {
+        inflate_restore(h, &cp);
+        h->state = STATE_BLOCK;
+        return err;
+    }
+    h->last = last;
+    return err;
+}
+
+static int inflate_stored(esp_transport_inflate_handle_t h, inflate_out_t *out)
+{
+    if (h->stored_left == 0) {
+        h->state = h->last ? STATE_TRAILER : STATE_BLOCK;
+        return STEP_CONTINUE;
+    }
+    if (out->pos == out->size) {
+        return STEP_OUT_FULL;
+    }
+    size_t len = inflate_avail(h);
+    if (len == 0) {
+        return STEP_NEED_INPUT;
+    }
+    if (len > h->stored_left) {
+        len = h->stored_left;
+    }
+    if (len > out->size - out->pos) {
+        len = out->size - out->pos;
+    }
+    const uint8_t *from = h->in + h->in_pos;
+    h->in_pos += len;
+    h->stored_left -= len;
+    while (len--) {
+        inflate_emit(h, out, *from++);
+    }
+    return STEP_CONTINUE;
+}
+
+static int inflate_codes(esp_transport_inflate_handle_t h, inflate_out_t *out)
+{
+    for (;;) {
+        while (h->match_len && out->pos < out->size) {
+            inflate_emit(h, out, h->window[(h->window_pos - h->match_dist) & h->window_mask]);
+            h->match_len--;
+        }
+        if (h->match_len) {
+            return STEP_OUT_FULL;
+        }
+
+        /* The end of the block is decoded even if the output is full, so that
+         * the decoder gets to a block boundary once all output is returned */
+        inflate_checkpoint_t cp;
+        inflate_save(h, &cp);
+        int sym = inflate_decode(h, &h->lencode);
+        if (sym < 256) {
+            if (sym == STEP_NEED_INPUT) {
+                inflate_restore(h, &cp);
+            } else if (sym >= 0) {
+                if (out->pos == out->size) {
+                    inflate_restore(h, &cp);
+                    return STEP_OUT_FULL;
+                }
+                inflate_emit(h, out, sym);
+                continue;
+            }
+            return sym;
+        }
+        if (sym == 256) {
+            h->state = h->last ? STATE_TRAILER : STATE_BLOCK;
+            return STEP_CONTINUE;
+        }
+
+        sym -= 257;
+        if (sym >= 29) {
+            return ESP_TRANSPORT_INFLATE_ERR_DATA;
+        }
+        int len_extra = inflate_bits(h, esp_transport_deflate_len_extra[sym]);
+        int len_sym = sym;
+        sym = len_extra < 0 ? len_extra : inflate_decode(h, &h->distcode);
+        int dist_extra = sym < 0 ? sym : sym >= 30 ? ESP_TRANSPORT_INFLATE_ERR_DATA : inflate_bits(h, esp_transport_deflate_dist_extra[sym]);
+        if (dist_extra == STEP_NEED_INPUT) {
+            inflate_restore(h, &cp);
+            return STEP_NEED_INPUT;
+        } else if (dist_extra < 0) {
+            return dist_extra;
+        }
+        size_t dist = esp_transport_deflate_dist_base[sym] + dist_extra;
+        if (dist > h->window_have) {
+            if (dist > h->window_mask + 1) {
+                ESP_LOGE(TAG, "Distance %u beyond the window of %u bytes", (unsigned)dist, (unsigned)h->window_mask + 1);
+                return ESP_TRANSPORT_INFLATE_ERR_WINDOW;
+            }
+            return ESP_TRANSPORT_INFLATE_ERR_DATA;
+        }
+        h->match_len = esp_transport_deflate_len_base[len_sym] + len_extra;
+        h->match_dist = dist;
+    }
+}
+
+static int inflate_trailer(esp_transport_inflate_handle_t h, inflate_out_t *out)
+{
+    inflate_sum(h, out);
+    /* Rest of the current byte is dropped */
+    h->bits = 0;
+    h->bit_count = 0;
+
+    const uint8_t *p = h->in + h->in_pos;
+    if (h->framing == FRAMING_GZIP) {
+        if (inflate_avail(h) < 8) {
+            return STEP_NEED_INPUT;
+        }
+        uint32_t crc = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        uint32_t isize = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+        if (crc != h->crc || isize != h->total_out) {
+            return ESP_TRANSPORT_INFLATE_ERR_CHECK;
+        }
+        h->in_pos += 8;
+    } else if (h->framing == FRAMING_ZLIB) {
+        if (inflate_avail(h) < 4) {
+            return STEP_NEED_INPUT;
+        }
+        uint32_t adler = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        if (adler != h->adler) {
+            return ESP_TRANSPORT_INFLATE_ERR_CHECK;
+        }
+        h->in_pos += 4;
+    }
+    h->state = STATE_DONE;
+    return ESP_TRANSPORT_INFLATE_DONE;
+}
+
+/* Skips a null-terminated field of the gzip header */
+static int inflate_skip_string(esp_transport_inflate_handle_t h, uint8_t flag, inflate_state_t next)
+{
+    if (h->gzip_flags & flag) {
+        size_t avail = inflate_avail(h);
+        if (avail == 0) {
+            return STEP_NEED_INPUT;
+        }
+        const uint8_t *end = memchr(h->in + h->in_pos, 0, avail);
+        if (!end) {
+            h->in_pos = h->in_len;
+            return STEP_CONTINUE;
+        }
+        h->in_pos = end - h->in + 1;
+    }
+    h->state = next;
+    return STEP_CONTINUE;
+}
+
+static bool inflate_is_zlib_header(const uint8_t *p)
+{
+    return (p[0] & 0x0f) == 8 && (p[0] >> 4) <= 7 && (p[0] << 8 | p[1]) % 31 == 0;
+}
+
+/* Each step either makes progress, or returns STEP_NEED_INPUT without
+ * changing the state of the decoder */
+static int inflate_step(esp_transport_inflate_handle_t h, inflate_out_t *out)
+{
+    const uint8_t *p = h->in + h->in_pos;
+    size_t avail = inflate_avail(h);
+
+    switch (h->state) {
+    case STATE_GZIP_HEADER:
+        if (avail < 10) {
+            return STEP_NEED_INPUT;
+        }
+        if (p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || (p[3] & GZIP_FRESERVED)) {
+            return ESP_TRANSPORT_INFLATE_ERR_DATA;
+        }
+        h->gzip_flags = p[3];
+        h->in_pos += 10;
+        h->state = STATE_GZIP_EXTRA_LEN;
+        return STEP_CONTINUE;
+    case STATE_GZIP_EXTRA_LEN:
+        if (h->gzip_flags & GZIP_FEXTRA) {
+            if (avail < 2) {
+                return STEP_NEED_INPUT;
+            }
+            h->skip = p[0] | p[1] << 8;
+            h->in_pos += 2;
+        }
+        h->state = STATE_GZIP_EXTRA;
+        return STEP_CONTINUE;
+    case STATE_GZIP_EXTRA:
+        if (h->skip) {
+            if (avail == 0) {
+                return STEP_NEED_INPUT;
+            }
+            size_t len = avail < h->skip ? avail : h->skip;
+            h->in_pos += len;
+            h->skip -= len;
+            return STEP_CONTINUE;
+        }
+        h->state = STATE_GZIP_NAME;
+        return STEP_CONTINUE;
+    case STATE_GZIP_NAME:
+        return inflate_skip_string(h, GZIP_FNAME, STATE_GZIP_COMMENT);
+    case STATE_GZIP_COMMENT:
+        return inflate_skip_string(h, GZIP_FCOMMENT, STATE_GZIP_HCRC);
+    case STATE_GZIP_HCRC:
+        /* The CRC of the header is not checked, the trailer covers the data */
+        if (h->gzip_flags & GZIP_FHCRC) {
+            if (avail < 2) {
+                return STEP_NEED_INPUT;
+            }
+            h->in_pos += 2;
+        }
+        h->state = STATE_BLOCK;
+        return STEP_CONTINUE;
+    case STATE_DEFLATE_HEADER:
+        if (avail < 2) {
+            return STEP_NEED_INPUT;
+        }
+        /* Raw deflate data would start with a stored block whose padding bits
+         * are set, which compressors don't produce */
+        if (inflate_is_zlib_header(p)) {
+            h->framing = FRAMING_ZLIB;
+            h->state = STATE_ZLIB_HEADER;
+        } else {
+            h->framing = FRAMING_RAW;
+            h->state = STATE_BLOCK;
+        }
+        return STEP_CONTINUE;
+    case STATE_ZLIB_HEADER:
+        if (avail < 2) {
+            return STEP_NEED_INPUT;
+        }
+        if (!inflate_is_zlib_header(p) || (p[1] & 0x20)) {
+            /* Preset dictionaries are not used by HTTP */
+            return ESP_TRANSPORT_INFLATE_ERR_DATA;
+        }
+        if ((p[0] >> 4) + 8 > h->window_bits) {
+            ESP_LOGE(TAG, "Stream window of 2^%d bytes larger than 2^%d", (p[0] >> 4) + 8, h->window_bits);
+            return ESP_TRANSPORT_INFLATE_ERR_WINDOW;
+        }
+        h->in_pos += 2;
+        h->state = STATE_BLOCK;
+        return STEP_CONTINUE;
+    case STATE_BLOCK:
+        return inflate_block(h);
+    case STATE_STORED:
+        return inflate_stored(h, out);
+    case STATE_CODES:
+        return inflate_codes(h, out);
+    case STATE_TRAILER:
+        return inflate_trailer(h, out);
+    case STATE_DONE:
+    default:
+        return ESP_TRANSPORT_INFLATE_DONE;
+    }
+}
+
+static size_t inflate_fill(esp_transport_inflate_handle_t h, const uint8_t *in, size_t len)
+{
+    if (h->in_pos) {
+        memmove(h->in, h->in + h->in_pos, h->in_len - h->in_pos);
+        h->in_len -= h->in_pos;
+        h->in_pos = 0;
+    }
+    if (len > IN_BUF_SIZE - h->in_len) {
+        len = IN_BUF_SIZE - h->in_len;
+    }
+    if (len) {
+        memcpy(h->in + h->in_len, in, len);
+        h->in_len += len;
+    }
+    return len;
+}
+
+esp_transport_inflate_status_t esp_transport_inflate_run(esp_transport_inflate_handle_t h, const uint8_t *in, size_t in_len,
+                                                         size_t *consumed, uint8_t *out, size_t out_size, size_t *produced)
+{
+    inflate_out_t o = {
+        .buf = out,
+        .size = out_size,
+    };
+    size_t in_used = 0;
+    int ret;
+    for (;;) {
+        ret = inflate_step(h, &o);
+        if (ret == STEP_CONTINUE) {
+            continue;
+        }
+        if (ret != STEP_NEED_INPUT) {
+            break;
+        }
+        size_t len = inflate_fill(h, in + in_used, in_len - in_used);
+        in_used += len;
+        if (len == 0) {
+            /* Either all the input is used, or a piece of the stream doesn't fit the buffer */
+            ret = in_used < in_len ? ESP_TRANSPORT_INFLATE_ERR_DATA : ESP_TRANSPORT_INFLATE_OK;
+            break;
+        }
+    }
+    if (ret == STEP_OUT_FULL) {
+        ret = ESP_TRANSPORT_INFLATE_OK;
+    }
+    inflate_sum(h, &o);
+    *consumed = in_used;
+    *produced = o.pos;
+    return ret;
+}
+
+void esp_transport_inflate_reset(esp_transport_inflate_handle_t h, esp_transport_inflate_format_t format,
+                                 bool keep_window)
+{
+    switch (format) {
+    case ESP_TRANSPORT_INFLATE_GZIP:
+        h->framing = FRAMING_GZIP;
+        h->state = STATE_GZIP_HEADER;
+        break;
+    case ESP_TRANSPORT_INFLATE_DEFLATE:
+        h->framing = FRAMING_RAW;
+        h->state = STATE_DEFLATE_HEADER;
+        break;
+    case ESP_TRANSPORT_INFLATE_RAW:
+    default:
+        h->framing = FRAMING_RAW;
+        h->state = STATE_BLOCK;
+        break;
+    }
+    if (!keep_window) {
+        h->window_pos = 0;
+        h->window_have = 0;
+    }
+    h->gzip_flags = 0;
+    h->skip = 0;
+    h->last = false;
+    h->stored_left = 0;
+    h->match_len = 0;
+    h->crc = 0;
+    h->adler = 1;
+    h->total_out = 0;
+    h->bits = 0;
+    h->bit_count = 0;
+    h->in_pos = 0;
+    h->in_len = 0;
+}
+
+esp_transport_inflate_handle_t esp_transport_inflate_create(int window_bits)
+{
+    if (window_bits < MIN_WINDOW_BITS || window_bits > MAX_WINDOW_BITS) {
+        ESP_LOGE(TAG, "Invalid window bits %d", window_bits);
+        return NULL;
+    }
+    esp_transport_inflate_handle_t h = calloc(1, sizeof(struct esp_transport_inflate));
+    if (!h) {
+        return NULL;
+    }
+    h->window = malloc(1 << window_bits);
+    if (!h->window) {
+        free(h);
+        return NULL;
+    }
+    h->window_bits = window_bits;
+    h->window_mask = (1 << window_bits) - 1;
+    esp_transport_inflate_reset(h, ESP_TRANSPORT_INFLATE_GZIP, false);
+    return h;
+}
+
+bool esp_transport_inflate_flushed(esp_transport_inflate_handle_t h)
+{
+    if (h->state == STATE_DONE) {
+        return true;
+    }
+    return h->state == STATE_BLOCK && h->in_pos == h->in_len && h->bit_count == 0;
+}
+
+void esp_transport_inflate_destroy(esp_transport_inflate_handle_t h)
+{
+    if (h) {
+        free(h->window);
+        free(h);
+    }
+}
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "esp_transport_utils.h"
 
@@ -14,4 +15,58 @@ struct timeval* esp_transport_utils_ms_to_timeval(int timeout_ms, struct timeval
     tv->tv_sec = timeout_ms / 1000;
     tv->tv_usec = (timeout_ms - (tv->tv_sec * 1000)) * 1000;
     return tv;
-}
\ No newline at end of file
+}
+
+void esp_transport_utils_ws_mask(char *dst, const char *src, size_t len, const char mask_key[4], size_t offset)
+{
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t i = 0;
+
+    /* Key as applied from the start of src */
+    uint8_t key[4];
+    for (int k = 0; k < 4; k++) {
+        key[k] = mask_key[(offset + k) & 3];
+    }
+
+    while (i < len && ((uintptr_t)(d + i) & 3)) {
+        d[i] = s[i] ^ key[i & 3];
+        i++;
+    }
+
+    if (len - i >= 4) {
+        uint8_t rotated[4];
+        for (int k = 0; k < 4; k++) {
+            rotated[k] = key[(i + k) & 3];
+        }
+        uint32_t word_key;
+        memcpy(&word_key, rotated, sizeof(word_key));
+
+        uint32_t *dw = __builtin_assume_aligned(d + i, 4);
+        size_t words = (len - i) / 4;
+        if (((uintptr_t)(s + i) & 3) == 0) {
+            const uint32_t *sw = __builtin_assume_aligned(s + i, 4);
+            size_t w = 0;
+            for (; w + 4 <= words; w += 4) {
+                dw[w] = sw[w] ^ word_key;
+                dw[w + 1] = sw[w + 1] ^ word_key;
+                dw[w + 2] = sw[w + 2] ^ word_key;
+                dw[w + 3] = sw[w + 3] ^ word_key;
+            }
+            for (; w < words; w++) {
+                dw[w] = sw[w] ^ word_key;
+            }
+        } else {
+            for (size_t w = 0; w < words; w++) {
+                uint32_t v;
+                memcpy(&v, s + i + w * 4, sizeof(v));
+                dw[w] = v ^ word_key;
+            }
+        }
+        i += words * 4;
+    }
+
+    for (; i < len; i++) {
+        d[i] = s[i] ^ key[i & 3];
+    }
+}
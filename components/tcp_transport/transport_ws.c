@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdbool.h>
 #include <sys/random.h>
 #include "esp_log.h"
 #include "esp_transport.h"
@@ -9,11 +10,13 @@
 #include "esp_transport_utils.h"
 #include "mbedtls/base64.h"
 #include "mbedtls/sha1.h"
+#include "sdkconfig.h"
 
 static const char *TAG = "TRANSPORT_WS";
 
 #define DEFAULT_WS_BUFFER (1024)
 #define WS_FIN            0x80
+#define WS_RSV1           0x40
 #define WS_OPCODE_CONT    0x00
 #define WS_OPCODE_TEXT    0x01
 #define WS_OPCODE_BINARY  0x02
@@ -27,11 +30,16 @@ static const char *TAG = "TRANSPORT_WS";
 #define WS_SIZE64         127
 #define MAX_WEBSOCKET_HEADER_SIZE 16
 #define WS_RESPONSE_OK    101
+// Size of the buffer in which frames are masked, header included
+#define WS_TX_BUFFER_SIZE (MAX_WEBSOCKET_HEADER_SIZE + CONFIG_WS_TX_BUFFER_SIZE)
 
 
 typedef struct {
     uint8_t opcode;
     char mask_key[4];                   /*!< Mask key for this payload */
+    bool masked;                        /*!< True if the payload is masked */
+    bool fin;                           /*!< True if the frame is the last one of its message */
+    bool compressed;                    /*!< True if the frame is part of a compressed message */
     int payload_len;                    /*!< Total length of the payload */
     int bytes_remaining;                /*!< Bytes left to read of the payload  */
 } ws_transport_frame_state_t;
@@ -39,11 +47,17 @@ typedef struct {
 typedef struct {
     char *path;
     char *buffer;
+    char *tx_buffer;                    /*!< Frames are masked here, so that the data to send is left untouched */
     char *sub_protocol;
     char *user_agent;
     char *headers;
     ws_transport_frame_state_t frame_state;
     esp_transport_handle_t parent;
+    esp_transport_ws_deflate_config_t *deflate_config;  /*!< permessage-deflate is offered if set */
+    esp_transport_ws_deflate_handle_t deflate;          /*!< Set if the server accepted permessage-deflate */
+    size_t max_message_size;            /*!< Largest decompressed message */
+    uint8_t rx_message_opcode;          /*!< Opcode of the compressed message being received, 0 if none */
+    char *rx_message;                   /*!< Decompressed message, read as the payload of a frame */
 } transport_ws_t;
 
 static inline uint8_t ws_get_bin_opcode(ws_transport_opcodes_t opcode)
@@ -98,9 +112,20 @@ static char *get_http_header(const char *buffer, const char *key)
     return NULL;
 }
 
+static void ws_reset_deflate(transport_ws_t *ws)
+{
+    esp_transport_ws_deflate_destroy(ws->deflate);
+    ws->deflate = NULL;
+    free(ws->rx_message);
+    ws->rx_message = NULL;
+    ws->rx_message_opcode = 0;
+    memset(&ws->frame_state, 0, sizeof(ws->frame_state));
+}
+
 static int ws_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
+    ws_reset_deflate(ws);
     if (esp_transport_connect(ws->parent, host, port, timeout_ms) < 0) {
         ESP_LOGE(TAG, "Error connecting to host %s:%d", host, port);
         return -1;
@@ -151,6 +176,18 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
             return -1;
         }
     }
+    if (ws->deflate_config) {
+        int r = snprintf(ws->buffer + len, DEFAULT_WS_BUFFER - len, "Sec-WebSocket-Extensions: ");
+        len += r;
+        if (r <= 0 || len >= DEFAULT_WS_BUFFER
+                || (r = esp_transport_ws_deflate_client_offer(ws->deflate_config, ws->buffer + len, DEFAULT_WS_BUFFER - len)) < 0
+                || (len += r) + 2 >= DEFAULT_WS_BUFFER) {
+            ESP_LOGE(TAG, "Error in request generation (extension offer does not fit in %d bytes)", DEFAULT_WS_BUFFER);
+            return -1;
+        }
+        strcpy(ws->buffer + len, "\r\n");
+        len += 2;
+    }
     int r = snprintf(ws->buffer + len, DEFAULT_WS_BUFFER - len, "\r\n");
     len += r;
     if (r <= 0 || len >= DEFAULT_WS_BUFFER) {
@@ -174,6 +211,8 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
         ESP_LOGD(TAG, "Read header chunk %d, current header size: %d", len, header_len);
     } while (NULL == strstr(ws->buffer, "\r\n\r\n") && header_len < DEFAULT_WS_BUFFER);
 
+    // Looked up before get_http_header() terminates the line of the key
+    char *extensions = strcasestr(ws->buffer, "Sec-WebSocket-Extensions:");
     char *server_key = get_http_header(ws->buffer, "Sec-WebSocket-Accept:");
     if (server_key == NULL) {
         ESP_LOGE(TAG, "Sec-WebSocket-Accept not found");
@@ -199,22 +238,69 @@ static int ws_connect(esp_transport_handle_t t, const char *host, int port, int
         ESP_LOGE(TAG, "Invalid websocket key");
         return -1;
     }
+
+    if (ws->deflate_config && extensions) {
+        esp_transport_ws_deflate_params_t params;
+        extensions = get_http_header(extensions, "Sec-WebSocket-Extensions:");
+        if (extensions == NULL || esp_transport_ws_deflate_client_accept(ws->deflate_config, extensions, &params) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid extensions in the response: %s", extensions ? extensions : "");
+            return -1;
+        }
+        ws->deflate = esp_transport_ws_deflate_create(&params);
+        ESP_TRANSPORT_MEM_CHECK(TAG, ws->deflate, return -1);
+        ws->max_message_size = params.max_message_size;
+        ESP_LOGD(TAG, "permessage-deflate: %s", extensions);
+    }
     return 0;
 }
 
+/* Writes all the data, as a frame can't be left incomplete */
+static int ws_write_all(transport_ws_t *ws, const char *buffer, int len, int timeout_ms)
+{
+    int written = 0;
+    while (written < len) {
+        int ret = esp_transport_write(ws->parent, buffer + written, len - written, timeout_ms);
+        if (ret <= 0) {
+            return ret;
+        }
+        written += ret;
+    }
+    return written;
+}
+
 static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const char *b, int len, int timeout_ms)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
-    char *buffer = (char *)b;
     char ws_header[MAX_WEBSOCKET_HEADER_SIZE];
-    char *mask;
-    int header_len = 0, i;
+    char *mask = NULL;
+    char *compressed = NULL;
+    int data_len = len;
+    int header_len = 0;
 
     int poll_write;
     if ((poll_write = esp_transport_poll_write(ws->parent, timeout_ms)) <= 0) {
         ESP_LOGE(TAG, "Error transport_poll_write");
         return poll_write;
     }
+
+    // Data frames are compressed, a message sent in several frames is compressed in as many parts
+    if (ws->deflate && (opcode & 0x0F) < WS_OPCODE_CLOSE) {
+        size_t compressed_len = 0;
+        // Room is left for the header, the compressed data being ours it is masked in place
+        compressed = malloc(MAX_WEBSOCKET_HEADER_SIZE + esp_transport_ws_deflate_bound(len));
+        ESP_TRANSPORT_MEM_CHECK(TAG, compressed, return -1);
+        if (esp_transport_ws_deflate_compress(ws->deflate, b, len, opcode & WS_FIN,
+                                              compressed + MAX_WEBSOCKET_HEADER_SIZE, &compressed_len) != ESP_OK) {
+            ESP_LOGE(TAG, "Error compressing frame");
+            free(compressed);
+            return -1;
+        }
+        if ((opcode & 0x0F) != WS_OPCODE_CONT) {
+            opcode |= WS_RSV1;
+        }
+        b = compressed + MAX_WEBSOCKET_HEADER_SIZE;
+        len = compressed_len;
+    }
     ws_header[header_len++] = opcode;
 
     if (len <= 125) {
@@ -240,30 +326,51 @@ static int _ws_write(esp_transport_handle_t t, int opcode, int mask_flag, const
         mask = &ws_header[header_len];
         getrandom(ws_header + header_len, 4, 0);
         header_len += 4;
+    }
 
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
+    if (compressed) {
+        /* The compressed data is ours: it is masked in place and the
+         * whole frame, header included, goes out in a single write */
+        char *payload = compressed + MAX_WEBSOCKET_HEADER_SIZE;
+        char *frame = payload - header_len;
+        memcpy(frame, ws_header, header_len);
+        if (mask) {
+            esp_transport_utils_ws_mask(payload, payload, len, mask, 0);
+        }
+        int frame_len = header_len + len;
+        int ret = ws_write_all(ws, frame, frame_len, timeout_ms);
+        free(compressed);
+        if (ret != frame_len) {
+            ESP_LOGE(TAG, "Error write frame");
+            return -1;
         }
+        return data_len;
     }
 
-    if (esp_transport_write(ws->parent, ws_header, header_len, timeout_ms) != header_len) {
-        ESP_LOGE(TAG, "Error write header");
-        return -1;
-    }
-    if (len == 0) {
-        return 0;
-    }
+    /* The header is placed right before the payload, which starts word
+     * aligned in the TX buffer, and goes out with the first part of it */
+    char *payload = ws->tx_buffer + MAX_WEBSOCKET_HEADER_SIZE;
+    char *frame = payload - header_len;
+    memcpy(frame, ws_header, header_len);
 
-    int ret = esp_transport_write(ws->parent, buffer, len, timeout_ms);
-    // in case of masked transport we have to revert back to the original data, as ws layer
-    // does not create its own copy of data to be sent
-    if (mask_flag) {
-        mask = &ws_header[header_len-4];
-        for (i = 0; i < len; ++i) {
-            buffer[i] = (buffer[i] ^ mask[i % 4]);
+    int sent = 0;
+    int chunk = len < CONFIG_WS_TX_BUFFER_SIZE ? len : CONFIG_WS_TX_BUFFER_SIZE;
+    do {
+        if (mask) {
+            esp_transport_utils_ws_mask(payload, b + sent, chunk, mask, sent);
+        } else if (chunk) {
+            memcpy(payload, b + sent, chunk);
         }
-    }
-    return ret;
+        int frame_len = payload + chunk - frame;
+        if (ws_write_all(ws, frame, frame_len, timeout_ms) != frame_len) {
+            ESP_LOGE(TAG, "Error write frame");
+            return -1;
+        }
+        sent += chunk;
+        frame = payload;
+        chunk = len - sent < CONFIG_WS_TX_BUFFER_SIZE ? len - sent : CONFIG_WS_TX_BUFFER_SIZE;
+    } while (sent < len);
+    return data_len;
 }
 
 int esp_transport_ws_send_raw(esp_transport_handle_t t, ws_transport_opcodes_t opcode, const char *b, int len, int timeout_ms)
@@ -305,18 +412,29 @@ static int ws_read_payload(esp_transport_handle_t t, char *buffer, int len, int
         bytes_to_read = ws->frame_state.bytes_remaining;
     }
 
+    if (ws->rx_message) {
+        // Decompressed message, read from memory
+        memcpy(buffer, ws->rx_message + ws->frame_state.payload_len - ws->frame_state.bytes_remaining, bytes_to_read);
+        ws->frame_state.bytes_remaining -= bytes_to_read;
+        if (ws->frame_state.bytes_remaining == 0) {
+            free(ws->rx_message);
+            ws->rx_message = NULL;
+        }
+        return bytes_to_read;
+    }
+
     // Receive and process payload
     if (bytes_to_read != 0 && (rlen = esp_transport_read(ws->parent, buffer, bytes_to_read, timeout_ms)) <= 0) {
         ESP_LOGE(TAG, "Error read data");
         return rlen;
     }
-    ws->frame_state.bytes_remaining -= rlen;
 
-    if (ws->frame_state.mask_key) {
-        for (int i = 0; i < bytes_to_read; i++) {
-            buffer[i] = (buffer[i] ^ ws->frame_state.mask_key[i % 4]);
-        }
+    if (ws->frame_state.masked) {
+        // The payload may be read in parts, the key goes on from where the previous part ended
+        int offset = ws->frame_state.payload_len - ws->frame_state.bytes_remaining;
+        esp_transport_utils_ws_mask(buffer, buffer, rlen, ws->frame_state.mask_key, offset);
     }
+    ws->frame_state.bytes_remaining -= rlen;
     return rlen;
 }
 
@@ -331,6 +449,9 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
     char *data_ptr = ws_header, mask;
     int rlen;
     int poll_read;
+    free(ws->rx_message);
+    ws->rx_message = NULL;
+    ws->frame_state.compressed = false;
     if ((poll_read = esp_transport_poll_read(ws->parent, timeout_ms)) <= 0) {
         return poll_read;
     }
@@ -343,6 +464,14 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
         return rlen;
     }
     ws->frame_state.opcode = (*data_ptr & 0x0F);
+    ws->frame_state.fin = (*data_ptr & WS_FIN) != 0;
+    if (ws->deflate && ws->frame_state.opcode < WS_OPCODE_CLOSE) {
+        // RSV1 is set on the first frame of a compressed message
+        if ((*data_ptr & WS_RSV1) && ws->frame_state.opcode != WS_OPCODE_CONT) {
+            ws->rx_message_opcode = ws->frame_state.opcode;
+        }
+        ws->frame_state.compressed = ws->rx_message_opcode != 0;
+    }
     data_ptr ++;
     mask = ((*data_ptr >> 7) & 0x01);
     payload_len = (*data_ptr & 0x7F);
@@ -354,7 +483,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             ESP_LOGE(TAG, "Error read data");
             return rlen;
         }
-        payload_len = data_ptr[0] << 8 | data_ptr[1];
+        payload_len = (uint8_t)data_ptr[0] << 8 | (uint8_t)data_ptr[1];
     } else if (payload_len == 127) {
         // headerLen += 8;
         header = 8;
@@ -367,7 +496,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
             // really too big!
             payload_len = 0xFFFFFFFF;
         } else {
-            payload_len = data_ptr[4] << 24 | data_ptr[5] << 16 | data_ptr[6] << 8 | data_ptr[7];
+            payload_len = (uint8_t)data_ptr[4] << 24 | (uint8_t)data_ptr[5] << 16 | (uint8_t)data_ptr[6] << 8 | (uint8_t)data_ptr[7];
         }
     }
 
@@ -381,6 +510,7 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
     } else {
         memset(ws->frame_state.mask_key, 0, mask_len);
     }
+    ws->frame_state.masked = mask;
 
     ws->frame_state.payload_len = payload_len;
     ws->frame_state.bytes_remaining = payload_len;
@@ -388,18 +518,75 @@ static int ws_read_header(esp_transport_handle_t t, char *buffer, int len, int t
     return payload_len;
 }
 
+/* Gather the payload of a compressed frame, and once the last frame of the
+ * message is in, decompress the message so that it is read like a payload */
+static int ws_read_compressed(esp_transport_handle_t t, int timeout_ms)
+{
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    char *data = esp_transport_ws_deflate_reserve(ws->deflate, ws->frame_state.payload_len);
+    if (data == NULL) {
+        return -1;
+    }
+    int received = 0;
+    while (ws->frame_state.bytes_remaining > 0) {
+        int rlen = ws_read_payload(t, data + received, ws->frame_state.bytes_remaining, timeout_ms);
+        if (rlen <= 0) {
+            return -1;
+        }
+        received += rlen;
+    }
+    if (!ws->frame_state.fin) {
+        return 0;
+    }
+
+    size_t message_len = 0;
+    ws->rx_message = malloc(ws->max_message_size);
+    ESP_TRANSPORT_MEM_CHECK(TAG, ws->rx_message, return -1);
+    if (esp_transport_ws_deflate_finish(ws->deflate, ws->rx_message, ws->max_message_size, &message_len) != ESP_OK) {
+        free(ws->rx_message);
+        ws->rx_message = NULL;
+        return -1;
+    }
+    char *shrunk = realloc(ws->rx_message, message_len ? message_len : 1);
+    if (shrunk) {
+        ws->rx_message = shrunk;
+    }
+    ws->frame_state.opcode = ws->rx_message_opcode;
+    ws->frame_state.masked = false;
+    ws->frame_state.payload_len = message_len;
+    ws->frame_state.bytes_remaining = message_len;
+    ws->rx_message_opcode = 0;
+    return 0;
+}
+
 static int ws_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
 {
     int rlen = 0;
     transport_ws_t *ws = esp_transport_get_context_data(t);
 
     // If message exceeds buffer len then subsequent reads will skip reading header and read whatever is left of the payload
-    if (ws->frame_state.bytes_remaining <= 0) {
-        if ( (rlen = ws_read_header(t, buffer, len, timeout_ms)) <= 0) {
+    while (ws->frame_state.bytes_remaining <= 0) {
+        rlen = ws_read_header(t, buffer, len, timeout_ms);
+        if (rlen < 0 || (rlen == 0 && !ws->frame_state.compressed)) {
             // If something when wrong then we prepare for reading a new header
             ws->frame_state.bytes_remaining = 0;
             return rlen;
         }
+        if (!ws->frame_state.compressed) {
+            break;
+        }
+        // Control frames may come in between the frames of a compressed message, they are returned as they are
+        if (ws_read_compressed(t, timeout_ms) < 0) {
+            ESP_LOGE(TAG, "Error reading compressed message");
+            ws->frame_state.bytes_remaining = 0;
+            return -1;
+        }
+        if (ws->frame_state.fin) {
+            if (ws->frame_state.payload_len == 0) {
+                return 0;
+            }
+            break;
+        }
     }
     if (ws->frame_state.payload_len) {
         if ( (rlen = ws_read_payload(t, buffer, len, timeout_ms)) <= 0) {
@@ -428,13 +615,17 @@ static int ws_poll_write(esp_transport_handle_t t, int timeout_ms)
 static int ws_close(esp_transport_handle_t t)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
+    ws_reset_deflate(ws);
     return esp_transport_close(ws->parent);
 }
 
 static esp_err_t ws_destroy(esp_transport_handle_t t)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
+    ws_reset_deflate(ws);
+    free(ws->deflate_config);
     free(ws->buffer);
+    free(ws->tx_buffer);
     free(ws->path);
     free(ws->sub_protocol);
     free(ws->user_agent);
@@ -467,6 +658,13 @@ esp_transport_handle_t esp_transport_ws_init(esp_transport_handle_t parent_handl
         free(ws);
         return NULL;
     });
+    ws->tx_buffer = malloc(WS_TX_BUFFER_SIZE);
+    ESP_TRANSPORT_MEM_CHECK(TAG, ws->tx_buffer, {
+        free(ws->buffer);
+        free(ws->path);
+        free(ws);
+        return NULL;
+    });
 
     esp_transport_set_func(t, ws_connect, ws_read, ws_write, ws_close, ws_poll_read, ws_poll_write, ws_destroy);
     // webocket underlying transfer is the payload transfer handle
@@ -536,6 +734,25 @@ esp_err_t esp_transport_ws_set_headers(esp_transport_handle_t t, const char *hea
     return ESP_OK;
 }
 
+esp_err_t esp_transport_ws_set_deflate(esp_transport_handle_t t, const esp_transport_ws_deflate_config_t *config)
+{
+    if (t == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    transport_ws_t *ws = esp_transport_get_context_data(t);
+    free(ws->deflate_config);
+    ws->deflate_config = NULL;
+    if (config == NULL) {
+        return ESP_OK;
+    }
+    ws->deflate_config = malloc(sizeof(esp_transport_ws_deflate_config_t));
+    if (ws->deflate_config == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    *ws->deflate_config = *config;
+    return ESP_OK;
+}
+
 ws_transport_opcodes_t esp_transport_ws_get_read_opcode(esp_transport_handle_t t)
 {
     transport_ws_t *ws = esp_transport_get_context_data(t);
@@ -0,0 +1,672 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <strings.h>
+#include "esp_log.h"
+#include "esp_transport_ws_deflate.h"
+#include "esp_transport_inflate.h"
+#include "esp_transport_utils.h"
+
+static const char *TAG = "TRANSPORT_WS_DEFLATE";
+
+#define EXTENSION_NAME      "permessage-deflate"
+#define MIN_WINDOW_BITS     8
+#define MAX_WINDOW_BITS     15
+#define MAX_EXTENSION_LEN   160     /* Longest extension offer parsed */
+
+#define MIN_MATCH           3
+#define MAX_MATCH           258
+#define MAX_CHAIN           16      /* Earlier positions tried for each match */
+#define FAR_DISTANCE        4096    /* Shortest matches further than this take more bits than literals */
+#define MAX_HASH_BITS       12
+#define MAX_STORED          65535   /* Longest stored block */
+#define STORED_OVERHEAD     6       /* Stored block header, and the header of the sync flush block */
+
+/* Ending a message with a sync flush leaves this empty stored block,
+ * which is removed by the sender and appended back by the receiver */
+static const uint8_t s_sync_tail[] = { 0x00, 0x00, 0xff, 0xff };
+
+/* Compressor. Only fixed Huffman codes are written (RFC 1951 section
+ * 3.2.6), which need no per-block tables and suit short messages. Matches
+ * are found greedily through hash chains, over a window of twice wsize
+ * bytes which slides by wsize as it fills up */
+typedef struct {
+    uint8_t *window;            /*!< 2 * wsize bytes */
+    uint16_t *head;             /*!< Latest position of each hash */
+    uint16_t *prev;             /*!< Previous position of the same hash, indexed by position modulo wsize */
+    size_t wsize;               /*!< At least MAX_MATCH larger than half the buffer, so that a slide keeps any match */
+    size_t max_dist;            /*!< Negotiated window, furthest a match may point back */
+    unsigned hash_bits;
+    size_t fill;                /*!< Bytes in the window */
+    size_t pos;                 /*!< Next position to encode */
+    size_t ins;                 /*!< Next position to insert in the hash chains */
+    uint32_t bits;              /*!< Output bits not yet written */
+    unsigned bit_count;
+    bool in_block;              /*!< Header of the block of the current message is written */
+    uint16_t lit_code[288];     /*!< Bit reversed fixed literal/length codes */
+    uint8_t lit_bits[288];
+} ws_deflate_tx_t;
+
+struct esp_transport_ws_deflate {
+    esp_transport_ws_deflate_params_t params;
+    ws_deflate_tx_t *tx;        /*!< Compressor, allocated on first use */
+    char *rx_buf;               /*!< Compressed message being received */
+    size_t rx_len;
+    size_t rx_size;
+    esp_transport_inflate_handle_t rx;  /*!< Decompressor, allocated on first use */
+};
+
+static inline uint8_t ws_deflate_window_bits(uint8_t configured)
+{
+    return configured ? configured : ESP_TRANSPORT_WS_DEFLATE_DEFAULT_WINDOW_BITS;
+}
+
+static inline bool ws_deflate_valid_bits(uint8_t bits)
+{
+    return bits >= MIN_WINDOW_BITS && bits <= MAX_WINDOW_BITS;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Negotiation, RFC 7692 section 7.1                                         */
+
+typedef struct {
+    int server_max_window_bits;         /* -1 if absent */
+    int client_max_window_bits;         /* -1 if absent, 0 if present without value */
+    bool server_no_context_takeover;
+    bool client_no_context_takeover;
+} ws_deflate_offer_t;
+
+static char *ws_deflate_trim(char *str)
+{
+    while (*str == ' ' || *str == '\t') {
+        str++;
+    }
+    char *end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t')) {
+        *--end = '\0';
+    }
+    return str;
+}
+
+static int ws_deflate_parse_bits(const char *value)
+{
+    /* Quoted values are allowed by RFC 7692 section 7 */
+    size_t len = strlen(value);
+    if (len >= 2 && value[0] == '"' && value[len - 1] == '"') {
+        value++;
+        len -= 2;
+    }
+    if (len == 1 && value[0] == '8') {
+        return 8;
+    }
+    if (len == 1 && value[0] == '9') {
+        return 9;
+    }
+    if (len == 2 && value[0] == '1' && value[1] >= '0' && value[1] <= '5') {
+        return 10 + value[1] - '0';
+    }
+    return -1;
+}
+
+/* Parses the extension at *str, up to the next comma outside of a quoted
+ * string, and moves *str past it. Returns false if it isn't a valid
+ * permessage-deflate offer or response */
+static bool ws_deflate_parse_extension(const char **str, ws_deflate_offer_t *offer)
+{
+    char element[MAX_EXTENSION_LEN];
+    const char *end = *str;
+    bool quoted = false;
+    while (*end && (quoted || *end != ',')) {
+        quoted ^= *end == '"';
+        end++;
+    }
+    size_t len = end - *str;
+    bool valid = len < sizeof(element);
+    if (valid) {
+        memcpy(element, *str, len);
+        element[len] = '\0';
+    }
+    *str = *end ? end + 1 : end;
+    if (!valid) {
+        return false;
+    }
+
+    offer->server_max_window_bits = -1;
+    offer->client_max_window_bits = -1;
+    offer->server_no_context_takeover = false;
+    offer->client_no_context_takeover = false;
+
+    char *save = NULL;
+    char *token = strtok_r(element, ";", &save);
+    if (!token || strcasecmp(ws_deflate_trim(token), EXTENSION_NAME) != 0) {
+        return false;
+    }
+    while ((token = strtok_r(NULL, ";", &save)) != NULL) {
+        char *value = strchr(token, '=');
+        if (value) {
+            *value++ = '\0';
+            value = ws_deflate_trim(value);
+        }
+        char *name = ws_deflate_trim(token);
+        if (strcasecmp(name, "server_no_context_takeover") == 0 && !value && !offer->server_no_context_takeover) {
+            offer->server_no_context_takeover = true;
+        } else if (strcasecmp(name, "client_no_context_takeover") == 0 && !value && !offer->client_no_context_takeover) {
+            offer->client_no_context_takeover = true;
+        } else if (strcasecmp(name, "server_max_window_bits") == 0 && value && offer->server_max_window_bits < 0) {
+            if ((offer->server_max_window_bits = ws_deflate_parse_bits(value)) < 0) {
+                return false;
+            }
+        } else if (strcasecmp(name, "client_max_window_bits") == 0 && offer->client_max_window_bits < 0) {
+            if ((offer->client_max_window_bits = value ? ws_deflate_parse_bits(value) : 0) < 0) {
+                return false;
+            }
+        } else {
+            /* Unknown, duplicated or malformed parameter */
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t ws_deflate_max_message(size_t configured)
+{
+    return configured ? configured : ESP_TRANSPORT_WS_DEFLATE_DEFAULT_MAX_MESSAGE;
+}
+
+int esp_transport_ws_deflate_client_offer(const esp_transport_ws_deflate_config_t *config, char *buf, size_t size)
+{
+    uint8_t client_bits = ws_deflate_window_bits(config->client_max_window_bits);
+    uint8_t server_bits = ws_deflate_window_bits(config->server_max_window_bits);
+    if (!ws_deflate_valid_bits(client_bits) || !ws_deflate_valid_bits(server_bits)) {
+        ESP_LOGE(TAG, "Invalid window bits");
+        return -1;
+    }
+    char server_bits_param[32] = "";
+    if (server_bits < MAX_WINDOW_BITS) {
+        snprintf(server_bits_param, sizeof(server_bits_param), "; server_max_window_bits=%u", server_bits);
+    }
+    int len = snprintf(buf, size, EXTENSION_NAME "; client_max_window_bits=%u%s%s%s",
+                       client_bits, server_bits_param,
+                       config->client_no_context_takeover ? "; client_no_context_takeover" : "",
+                       config->server_no_context_takeover ? "; server_no_context_takeover" : "");
+    return len < 0 || len >= size ? -1 : len;
+}
+
+esp_err_t esp_transport_ws_deflate_client_accept(const esp_transport_ws_deflate_config_t *config, const char *response,
+                                                 esp_transport_ws_deflate_params_t *params)
+{
+    ws_deflate_offer_t accepted;
+    if (!ws_deflate_parse_extension(&response, &accepted) || *response) {
+        ESP_LOGE(TAG, "Invalid extension in the response");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    uint8_t client_bits = ws_deflate_window_bits(config->client_max_window_bits);
+    uint8_t server_bits = ws_deflate_window_bits(config->server_max_window_bits);
+    if (server_bits < MAX_WINDOW_BITS) {
+        /* Required to accept our offer, see RFC 7692 section 7.1.2.1 */
+        if (accepted.server_max_window_bits < 0 || accepted.server_max_window_bits > server_bits) {
+            ESP_LOGE(TAG, "Server window not accepted");
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        server_bits = accepted.server_max_window_bits;
+    } else if (accepted.server_max_window_bits > 0) {
+        server_bits = accepted.server_max_window_bits;
+    }
+    if (accepted.client_max_window_bits == 0 || accepted.client_max_window_bits > client_bits) {
+        ESP_LOGE(TAG, "Invalid client window in the response");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (config->server_no_context_takeover && !accepted.server_no_context_takeover) {
+        ESP_LOGE(TAG, "server_no_context_takeover not accepted");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    params->tx_window_bits = accepted.client_max_window_bits > 0 ? accepted.client_max_window_bits : client_bits;
+    params->tx_no_context_takeover = config->client_no_context_takeover || accepted.client_no_context_takeover;
+    params->rx_window_bits = server_bits;
+    params->rx_no_context_takeover = accepted.server_no_context_takeover;
+    params->max_message_size = ws_deflate_max_message(config->max_message_size);
+    return ESP_OK;
+}
+
+esp_err_t esp_transport_ws_deflate_server_accept(const esp_transport_ws_deflate_config_t *config, const char *offers,
+                                                 esp_transport_ws_deflate_params_t *params, char *response, size_t size)
+{
+    uint8_t server_bits = ws_deflate_window_bits(config->server_max_window_bits);
+    uint8_t client_bits = ws_deflate_window_bits(config->client_max_window_bits);
+    if (!ws_deflate_valid_bits(client_bits) || !ws_deflate_valid_bits(server_bits)) {
+        ESP_LOGE(TAG, "Invalid window bits");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    while (*offers) {
+        ws_deflate_offer_t offer;
+        if (!ws_deflate_parse_extension(&offers, &offer)) {
+            continue;
+        }
+
+        bool rx_no_context_takeover = config->client_no_context_takeover || offer.client_no_context_takeover;
+        uint8_t rx_bits = MAX_WINDOW_BITS;
+        if (offer.client_max_window_bits >= 0) {
+            rx_bits = offer.client_max_window_bits > 0 && offer.client_max_window_bits < client_bits ?
+                      offer.client_max_window_bits : client_bits;
+        } else if (!rx_no_context_takeover && client_bits < MAX_WINDOW_BITS) {
+            /* The client window can't be limited, nor its history be dropped */
+            continue;
+        }
+        uint8_t tx_bits = offer.server_max_window_bits > 0 && offer.server_max_window_bits < server_bits ?
+                          offer.server_max_window_bits : server_bits;
+
+        /* Parameters are only sent back when offered, except for client_no_context_takeover */
+        char server_bits_param[32] = "";
+        char client_bits_param[32] = "";
+        if (offer.server_max_window_bits > 0) {
+            snprintf(server_bits_param, sizeof(server_bits_param), "; server_max_window_bits=%u", tx_bits);
+        }
+        if (offer.client_max_window_bits >= 0) {
+            snprintf(client_bits_param, sizeof(client_bits_param), "; client_max_window_bits=%u", rx_bits);
+        }
+        int len = snprintf(response, size, EXTENSION_NAME "%s%s%s%s",
+                           offer.server_no_context_takeover ? "; server_no_context_takeover" : "",
+                           rx_no_context_takeover ? "; client_no_context_takeover" : "",
+                           server_bits_param, client_bits_param);
+        if (len < 0 || len >= size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        params->tx_window_bits = tx_bits;
+        params->tx_no_context_takeover = config->server_no_context_takeover || offer.server_no_context_takeover;
+        params->rx_window_bits = rx_bits;
+        params->rx_no_context_takeover = rx_no_context_takeover;
+        params->max_message_size = ws_deflate_max_message(config->max_message_size);
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Compression                                                               */
+
+static uint16_t ws_deflate_reverse(uint16_t code, unsigned bits)
+{
+    uint16_t reversed = 0;
+    while (bits--) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+static ws_deflate_tx_t *ws_deflate_tx_create(uint8_t window_bits)
+{
+    ws_deflate_tx_t *tx = calloc(1, sizeof(ws_deflate_tx_t));
+    if (!tx) {
+        return NULL;
+    }
+    tx->max_dist = 1 << window_bits;
+    tx->wsize = tx->max_dist < 2 * MAX_MATCH ? 2 * MAX_MATCH : tx->max_dist;
+    tx->hash_bits = window_bits < MAX_HASH_BITS ? window_bits : MAX_HASH_BITS;
+    tx->window = malloc(2 * tx->wsize);
+    tx->head = calloc(1 << tx->hash_bits, sizeof(uint16_t));
+    tx->prev = calloc(tx->wsize, sizeof(uint16_t));
+    if (!tx->window || !tx->head || !tx->prev) {
+        free(tx->window);
+        free(tx->head);
+        free(tx->prev);
+        free(tx);
+        return NULL;
+    }
+
+    /* RFC 1951 section 3.2.6, Huffman codes are sent most significant bit first */
+    for (int sym = 0; sym < 288; sym++) {
+        uint16_t code;
+        uint8_t bits;
+        if (sym < 144) {
+            code = 0x30 + sym;
+            bits = 8;
+        } else if (sym < 256) {
+            code = 0x190 + sym - 144;
+            bits = 9;
+        } else if (sym < 280) {
+            code = sym - 256;
+            bits = 7;
+        } else {
+            code = 0xc0 + sym - 280;
+            bits = 8;
+        }
+        tx->lit_code[sym] = ws_deflate_reverse(code, bits);
+        tx->lit_bits[sym] = bits;
+    }
+    return tx;
+}
+
+static void ws_deflate_tx_destroy(ws_deflate_tx_t *tx)
+{
+    if (tx) {
+        free(tx->window);
+        free(tx->head);
+        free(tx->prev);
+        free(tx);
+    }
+}
+
+static inline void ws_deflate_put(ws_deflate_tx_t *tx, uint8_t **out, uint32_t value, unsigned count)
+{
+    tx->bits |= value << tx->bit_count;
+    tx->bit_count += count;
+    while (tx->bit_count >= 8) {
+        *(*out)++ = (uint8_t)tx->bits;
+        tx->bits >>= 8;
+        tx->bit_count -= 8;
+    }
+}
+
+static inline unsigned ws_deflate_hash(const ws_deflate_tx_t *tx, const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+    return (v * 2654435761u) >> (32 - tx->hash_bits);
+}
+
+static void ws_deflate_insert_upto(ws_deflate_tx_t *tx, size_t end)
+{
+    while (tx->ins < end && tx->ins + MIN_MATCH <= tx->fill) {
+        unsigned h = ws_deflate_hash(tx, tx->window + tx->ins);
+        tx->prev[tx->ins & (tx->wsize - 1)] = tx->head[h];
+        tx->head[h] = (uint16_t)tx->ins;
+        tx->ins++;
+    }
+}
+
+static size_t ws_deflate_longest_match(ws_deflate_tx_t *tx, size_t *dist)
+{
+    const uint8_t *win = tx->window;
+    const size_t cur = tx->pos;
+    const size_t max_len = tx->fill - cur < MAX_MATCH ? tx->fill - cur : MAX_MATCH;
+    size_t best = MIN_MATCH - 1;
+    unsigned chain = MAX_CHAIN;
+
+    /* Positions in the chains may be stale, so every candidate is checked */
+    size_t p = tx->head[ws_deflate_hash(tx, win + cur)];
+    while (chain-- && p < cur && cur - p <= tx->max_dist) {
+        if (win[p + best] == win[cur + best] && win[p] == win[cur] && win[p + 1] == win[cur + 1]) {
+            size_t len = 2;
+            while (len < max_len && win[p + len] == win[cur + len]) {
+                len++;
+            }
+            if (len > best && (len > MIN_MATCH || cur - p <= FAR_DISTANCE)) {
+                best = len;
+                *dist = cur - p;
+                if (len == max_len) {
+                    break;
+                }
+            }
+        }
+        size_t next = tx->prev[p & (tx->wsize - 1)];
+        if (next >= p) {
+            break;
+        }
+        p = next;
+    }
+    return best >= MIN_MATCH ? best : 0;
+}
+
+static void ws_deflate_put_match(ws_deflate_tx_t *tx, uint8_t **out, size_t len, size_t dist)
+{
+    unsigned code;
+    if (len == MAX_MATCH) {
+        code = 28;
+    } else {
+        unsigned l = len - MIN_MATCH;
+        if (l < 8) {
+            code = l;
+        } else {
+            unsigned msb = 31 - __builtin_clz(l);
+            code = 4 * (msb - 1) + ((l >> (msb - 2)) & 3);
+        }
+    }
+    ws_deflate_put(tx, out, tx->lit_code[257 + code], tx->lit_bits[257 + code]);
+    ws_deflate_put(tx, out, len - esp_transport_deflate_len_base[code], esp_transport_deflate_len_extra[code]);
+
+    unsigned d = dist - 1;
+    if (d < 4) {
+        code = d;
+    } else {
+        unsigned msb = 31 - __builtin_clz(d);
+        code = 2 * msb + ((d >> (msb - 1)) & 1);
+    }
+    ws_deflate_put(tx, out, ws_deflate_reverse(code, 5), 5);
+    ws_deflate_put(tx, out, dist - esp_transport_deflate_dist_base[code], esp_transport_deflate_dist_extra[code]);
+}
+
+static void ws_deflate_encode(ws_deflate_tx_t *tx, uint8_t **out, size_t end)
+{
+    while (tx->pos < end) {
+        size_t len = 0, dist = 0;
+        if (tx->fill - tx->pos >= MIN_MATCH) {
+            ws_deflate_insert_upto(tx, tx->pos);
+            len = ws_deflate_longest_match(tx, &dist);
+        }
+        if (len) {
+            ws_deflate_put_match(tx, out, len, dist);
+            tx->pos += len;
+        } else {
+            uint8_t c = tx->window[tx->pos++];
+            ws_deflate_put(tx, out, tx->lit_code[c], tx->lit_bits[c]);
+        }
+    }
+}
+
+static void ws_deflate_slide(ws_deflate_tx_t *tx)
+{
+    const size_t wsize = tx->wsize;
+    memmove(tx->window, tx->window + wsize, tx->fill - wsize);
+    tx->fill -= wsize;
+    tx->pos -= wsize;
+    tx->ins -= wsize;
+    for (size_t i = 0; i < (1 << tx->hash_bits); i++) {
+        tx->head[i] = tx->head[i] >= wsize ? tx->head[i] - wsize : 0;
+    }
+    for (size_t i = 0; i < wsize; i++) {
+        tx->prev[i] = tx->prev[i] >= wsize ? tx->prev[i] - wsize : 0;
+    }
+}
+
+size_t esp_transport_ws_deflate_bound(size_t len)
+{
+    /* Literals take at most 9 bits, and so do matches per byte, as the
+     * shortest ones are only used up to FAR_DISTANCE. Then come the block
+     * header, the end of block and the empty stored block */
+    return len + len / 8 + 8;
+}
+
+esp_err_t esp_transport_ws_deflate_compress(esp_transport_ws_deflate_handle_t handle, const char *in, size_t len,
+                                            bool final, char *out, size_t *out_len)
+{
+    ws_deflate_tx_t *tx = handle->tx;
+    if (!tx) {
+        tx = ws_deflate_tx_create(handle->params.tx_window_bits);
+        if (!tx) {
+            ESP_LOGE(TAG, "Failed to allocate the compressor");
+            return ESP_ERR_NO_MEM;
+        }
+        handle->tx = tx;
+    }
+
+    /* Whole messages which don't compress are sent as they are, in a stored block */
+    const bool whole = final && !tx->in_block && len <= MAX_STORED;
+    const uint8_t *data = (const uint8_t *)in;
+    const size_t data_len = len;
+
+    uint8_t *o = (uint8_t *)out;
+    if (!tx->in_block) {
+        /* BFINAL 0, BTYPE 01: fixed Huffman codes */
+        ws_deflate_put(tx, &o, 2, 3);
+        tx->in_block = true;
+    }
+    while (len) {
+        if (tx->fill == 2 * tx->wsize) {
+            ws_deflate_slide(tx);
+        }
+        size_t chunk = 2 * tx->wsize - tx->fill;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(tx->window + tx->fill, in, chunk);
+        tx->fill += chunk;
+        in += chunk;
+        len -= chunk;
+        /* Matches may go on in the data still to be copied */
+        ws_deflate_encode(tx, &o, len ? tx->fill - MAX_MATCH : tx->fill);
+    }
+    if (final) {
+        /* End of block, then the header of the empty stored block of
+         * the sync flush, up to the byte boundary (RFC 7692 section 7.2.1) */
+        ws_deflate_put(tx, &o, tx->lit_code[256], tx->lit_bits[256]);
+        ws_deflate_put(tx, &o, 0, 3);
+        if (tx->bit_count) {
+            ws_deflate_put(tx, &o, 0, 8 - tx->bit_count);
+        }
+        tx->in_block = false;
+        if (whole && (char *)o - out > data_len + STORED_OVERHEAD) {
+            /* BFINAL 0, BTYPE 00 then LEN and NLEN, the data, and the
+             * header of the empty stored block of the sync flush */
+            o = (uint8_t *)out;
+            *o++ = 0;
+            *o++ = data_len & 0xff;
+            *o++ = data_len >> 8;
+            *o++ = ~data_len & 0xff;
+            *o++ = (~data_len >> 8) & 0xff;
+            memcpy(o, data, data_len);
+            o += data_len;
+            *o++ = 0;
+        }
+        if (handle->params.tx_no_context_takeover) {
+            ws_deflate_tx_destroy(tx);
+            handle->tx = NULL;
+        }
+    }
+    *out_len = (char *)o - out;
+    return ESP_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Decompression                                                             */
+
+char *esp_transport_ws_deflate_reserve(esp_transport_ws_deflate_handle_t handle, size_t len)
+{
+    size_t needed = handle->rx_len + len;
+    if (needed > handle->params.max_message_size || needed < len) {
+        ESP_LOGE(TAG, "Compressed message larger than %u bytes", (unsigned)handle->params.max_message_size);
+        return NULL;
+    }
+    if (needed + sizeof(s_sync_tail) > handle->rx_size) {
+        size_t size = handle->rx_size * 2;
+        if (size < needed + sizeof(s_sync_tail)) {
+            size = needed + sizeof(s_sync_tail);
+        }
+        if (size > handle->params.max_message_size + sizeof(s_sync_tail)) {
+            size = handle->params.max_message_size + sizeof(s_sync_tail);
+        }
+        char *buf = realloc(handle->rx_buf, size);
+        if (!buf) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for the message", (unsigned)size);
+            return NULL;
+        }
+        handle->rx_buf = buf;
+        handle->rx_size = size;
+    }
+    char *reserved = handle->rx_buf + handle->rx_len;
+    handle->rx_len = needed;
+    return reserved;
+}
+
+esp_err_t esp_transport_ws_deflate_finish(esp_transport_ws_deflate_handle_t handle, char *out, size_t size, size_t *out_len)
+{
+    if (handle->rx_len == 0) {
+        /* Not a valid deflate stream, but sent by some peers for empty messages */
+        *out_len = 0;
+        return ESP_OK;
+    }
+    if (!handle->rx) {
+        handle->rx = esp_transport_inflate_create(handle->params.rx_window_bits);
+        if (!handle->rx) {
+            ESP_LOGE(TAG, "Failed to allocate the decompressor");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    /* Room for the tail was kept by esp_transport_ws_deflate_reserve() */
+    char *tail = handle->rx_buf + handle->rx_len;
+    memcpy(tail, s_sync_tail, sizeof(s_sync_tail));
+
+    /* Each message is a raw deflate stream, whose matches may refer to the
+     * previous messages with context takeover */
+    esp_transport_inflate_reset(handle->rx, ESP_TRANSPORT_INFLATE_RAW, true);
+    size_t consumed = 0;
+    esp_transport_inflate_status_t status = esp_transport_inflate_run(handle->rx, (const uint8_t *)handle->rx_buf,
+                                                                      handle->rx_len + sizeof(s_sync_tail), &consumed,
+                                                                      (uint8_t *)out, size, out_len);
+    bool flushed = esp_transport_inflate_flushed(handle->rx);
+
+    /* The buffer is only kept while a message is being received */
+    free(handle->rx_buf);
+    handle->rx_buf = NULL;
+    handle->rx_len = 0;
+    handle->rx_size = 0;
+    if (handle->params.rx_no_context_takeover) {
+        esp_transport_inflate_destroy(handle->rx);
+        handle->rx = NULL;
+    }
+
+    if (status >= 0 && !flushed && *out_len == size) {
+        ESP_LOGE(TAG, "Decompressed message larger than %u bytes", (unsigned)size);
+        return ESP_ERR_INVALID_SIZE;
+    } else if (status < 0 || !flushed) {
+        /* The message ends with the empty stored block appended above, or with a final block */
+        ESP_LOGE(TAG, "Invalid compressed data");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/* ------------------------------------------------------------------------- */
+
+esp_transport_ws_deflate_handle_t esp_transport_ws_deflate_create(const esp_transport_ws_deflate_params_t *params)
+{
+    if (!ws_deflate_valid_bits(params->tx_window_bits) || !ws_deflate_valid_bits(params->rx_window_bits)) {
+        ESP_LOGE(TAG, "Invalid window bits");
+        return NULL;
+    }
+    esp_transport_ws_deflate_handle_t handle = calloc(1, sizeof(struct esp_transport_ws_deflate));
+    if (!handle) {
+        ESP_LOGE(TAG, "Failed to allocate the compression context");
+        return NULL;
+    }
+    handle->params = *params;
+    handle->params.max_message_size = ws_deflate_max_message(params->max_message_size);
+    return handle;
+}
+
+void esp_transport_ws_deflate_destroy(esp_transport_ws_deflate_handle_t handle)
+{
+    if (handle) {
+        ws_deflate_tx_destroy(handle->tx);
+        free(handle->rx_buf);
+        esp_transport_inflate_destroy(handle->rx);
+        free(handle);
+    }
+}
@@ -551,6 +551,20 @@ int esp_vfs_fsync(int fd)
     return ret;
 }
 
+int esp_vfs_ftruncate(int fd, off_t length)
+{
+    const vfs_entry_t* vfs = get_vfs_for_fd(fd);
+    const int local_fd = get_local_fd(vfs, fd);
+    struct _reent* r = __getreent();
+    if (vfs == NULL || local_fd < 0) {
+        __errno_r(r) = EBADF;
+        return -1;
+    }
+    int ret;
+    CHECK_AND_CALL(ret, r, vfs, ftruncate, local_fd, length);
+    return ret;
+}
+
 #ifdef CONFIG_VFS_SUPPORT_DIR
 
 int esp_vfs_stat(struct _reent *r, const char * path, struct stat * st)
@@ -1197,6 +1211,8 @@ int _fstat_r(struct _reent *r, int fd, struct stat * st)
     __attribute__((alias("esp_vfs_fstat")));
 int fsync(int fd)
     __attribute__((alias("esp_vfs_fsync")));
+int ftruncate(int fd, off_t length)
+    __attribute__((alias("esp_vfs_ftruncate")));
 int ioctl(int fd, int cmd, ...)
     __attribute__((alias("esp_vfs_ioctl")));
 #endif // CONFIG_VFS_SUPPORT_IO
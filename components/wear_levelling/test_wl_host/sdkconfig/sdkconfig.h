@@ -6,4 +6,6 @@
 #define CONFIG_ESPTOOLPY_FLASHSIZE "8MB"
 //currently use the legacy implementation, since the stubs for new HAL are not done yet
 #define CONFIG_SPI_FLASH_USE_LEGACY_IMPL 1
+#define CONFIG_SPI_FLASH_ERASE_TASK_STACK_SIZE 2048
+#define CONFIG_SPI_FLASH_ERASE_TASK_PRIORITY 5
 
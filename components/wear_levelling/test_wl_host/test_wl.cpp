@@ -207,4 +207,46 @@ TEST_CASE("power down test", "[wear_levelling]")
     // Unmount
     result = wl_unmount(wl_handle);
     REQUIRE(result == ESP_OK);
-}
\ No newline at end of file
+}
+
+/* Standard wear levelling workloads for the flash timing model, see spi_flash/sim/SpiFlashTiming.h.
+ * Run with "make benchmark", results of all storage components use the same format.
+ */
+TEST_CASE("wear_levelling benchmark: rewrite one sector", "[wear_levelling][benchmark][.]")
+{
+    _spi_flash_init(CONFIG_ESPTOOLPY_FLASHSIZE, CONFIG_WL_SECTOR_SIZE * 16, CONFIG_WL_SECTOR_SIZE, CONFIG_WL_SECTOR_SIZE, "partition_table.bin");
+
+    const int rewrites = 2000;
+    wl_handle_t wl_handle;
+    SpiFlashTiming& timing = spiflash.get_timing();
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "storage");
+
+    uint8_t* data = (uint8_t*) malloc(CONFIG_WL_SECTOR_SIZE);
+    memset(data, 0xa5, CONFIG_WL_SECTOR_SIZE);
+
+    // Without wear levelling, all erase cycles hit the same physical sector
+    timing.reset();
+    for (int i = 0; i < rewrites; i++) {
+        REQUIRE(esp_partition_erase_range(partition, 0, CONFIG_WL_SECTOR_SIZE) == ESP_OK);
+        REQUIRE(esp_partition_write(partition, 0, data, CONFIG_WL_SECTOR_SIZE) == ESP_OK);
+    }
+    timing.report("partition: 2000 rewrites of one 4 KB sector");
+
+    timing.reset();
+    REQUIRE(esp_partition_erase_range(partition, 0, partition->size) == ESP_OK);
+    timing.report("partition: erase whole partition");
+
+    timing.reset();
+    REQUIRE(wl_mount(partition, &wl_handle) == ESP_OK);
+    timing.report("wear_levelling: mount empty partition");
+
+    timing.reset();
+    for (int i = 0; i < rewrites; i++) {
+        REQUIRE(wl_erase_range(wl_handle, 0, CONFIG_WL_SECTOR_SIZE) == ESP_OK);
+        REQUIRE(wl_write(wl_handle, 0, data, CONFIG_WL_SECTOR_SIZE) == ESP_OK);
+    }
+    timing.report("wear_levelling: 2000 rewrites of one 4 KB sector");
+
+    REQUIRE(wl_unmount(wl_handle) == ESP_OK);
+    free(data);
+}
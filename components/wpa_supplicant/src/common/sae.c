@@ -27,6 +27,144 @@ void wpabuf_clear_free(struct wpabuf *buf)
     }
 }
 
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+/*
+ * Hunting-and-pecking runs at least 40 rounds of bignum operations, but the
+ * PWE only depends on the group, the MAC addresses and the password. The last
+ * PWEs are kept in RAM, along with precomputed multiples of the PWE for the
+ * scalar multiplications of each handshake, so that reconnecting to the same
+ * AP skips the derivation. The cache is only used from the supplicant task.
+ */
+struct sae_pwe_cache_entry {
+	u8 id[SHA256_MAC_LEN];	/* hash of the PWE derivation inputs */
+	int group;		/* 0 if the entry is unused */
+	unsigned int users;	/* number of sae_data referencing the entry */
+	u8 pwe[2 * SAE_MAX_ECC_PRIME_LEN];
+	struct crypto_ec_fixed_base *pwe_base;
+};
+
+static struct sae_pwe_cache_entry sae_pwe_cache[CONFIG_WPA_SAE_PWE_CACHE_SIZE];
+static unsigned int sae_pwe_cache_next;
+
+static void sae_pwe_cache_id(int group, const u8 *addrs, const u8 *password,
+			     size_t password_len, const char *identifier,
+			     u8 *id)
+{
+	u8 lens[4];
+	const u8 *addr[4];
+	size_t len[4];
+	size_t num_elem = 3;
+
+	WPA_PUT_BE16(lens, group);
+	WPA_PUT_BE16(lens + 2, password_len);
+	addr[0] = lens;
+	len[0] = sizeof(lens);
+	addr[1] = addrs;
+	len[1] = 2 * ETH_ALEN;
+	addr[2] = password;
+	len[2] = password_len;
+	if (identifier) {
+		addr[num_elem] = (const u8 *) identifier;
+		len[num_elem] = os_strlen(identifier);
+		num_elem++;
+	}
+	sha256_vector(num_elem, addr, len, id);
+}
+
+static void sae_pwe_cache_release(struct sae_temporary_data *tmp)
+{
+	if (tmp->pwe_cache) {
+		tmp->pwe_cache->users--;
+		tmp->pwe_cache = NULL;
+	}
+}
+
+static void sae_pwe_cache_clear_entry(struct sae_pwe_cache_entry *entry)
+{
+	crypto_ec_fixed_base_deinit(entry->pwe_base);
+	os_memset(entry, 0, sizeof(*entry));
+}
+
+static int sae_pwe_cache_get(struct sae_data *sae, const u8 *id)
+{
+	struct sae_pwe_cache_entry *entry;
+	struct crypto_ec_point *pwe;
+	int i;
+
+	for (i = 0; i < CONFIG_WPA_SAE_PWE_CACHE_SIZE; i++) {
+		entry = &sae_pwe_cache[i];
+		if (entry->group != sae->group ||
+		    os_memcmp_const(entry->id, id, SHA256_MAC_LEN) != 0)
+			continue;
+
+		pwe = crypto_ec_point_from_bin(sae->tmp->ec, entry->pwe);
+		if (pwe == NULL)
+			return -1;
+		crypto_ec_point_deinit(sae->tmp->pwe_ecc, 1);
+		sae->tmp->pwe_ecc = pwe;
+		sae_pwe_cache_release(sae->tmp);
+		entry->users++;
+		sae->tmp->pwe_cache = entry;
+		return 0;
+	}
+
+	return -1;
+}
+
+static void sae_pwe_cache_put(struct sae_data *sae, const u8 *id)
+{
+	struct sae_pwe_cache_entry *entry = NULL;
+	int i;
+
+	/* Replace the oldest entry not used by another SAE instance */
+	for (i = 0; i < CONFIG_WPA_SAE_PWE_CACHE_SIZE; i++) {
+		struct sae_pwe_cache_entry *cand;
+
+		cand = &sae_pwe_cache[(sae_pwe_cache_next + i) %
+				      CONFIG_WPA_SAE_PWE_CACHE_SIZE];
+		if (cand->users == 0) {
+			entry = cand;
+			break;
+		}
+	}
+	if (entry == NULL)
+		return;
+	sae_pwe_cache_next = (entry - sae_pwe_cache + 1) %
+		CONFIG_WPA_SAE_PWE_CACHE_SIZE;
+
+	sae_pwe_cache_clear_entry(entry);
+	entry->pwe_base = crypto_ec_fixed_base_init(sae->tmp->ec,
+						    sae->tmp->pwe_ecc);
+	if (entry->pwe_base == NULL ||
+	    crypto_ec_point_to_bin(sae->tmp->ec, sae->tmp->pwe_ecc, entry->pwe,
+				   entry->pwe + sae->tmp->prime_len) < 0) {
+		sae_pwe_cache_clear_entry(entry);
+		return;
+	}
+	os_memcpy(entry->id, id, SHA256_MAC_LEN);
+	entry->group = sae->group;
+
+	sae_pwe_cache_release(sae->tmp);
+	entry->users = 1;
+	sae->tmp->pwe_cache = entry;
+}
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
+
+/**
+ * sae_clear_pwe_cache - Free the cached PWEs not used by an SAE instance
+ */
+void sae_clear_pwe_cache(void)
+{
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+	int i;
+
+	for (i = 0; i < CONFIG_WPA_SAE_PWE_CACHE_SIZE; i++) {
+		if (sae_pwe_cache[i].users == 0)
+			sae_pwe_cache_clear_entry(&sae_pwe_cache[i]);
+	}
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
+}
+
 int sae_set_group(struct sae_data *sae, int group)
 {
 	struct sae_temporary_data *tmp;
@@ -91,6 +229,9 @@ void sae_clear_temp_data(struct sae_data *sae)
 	if (sae == NULL || sae->tmp == NULL)
 		return;
 	tmp = sae->tmp;
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+	sae_pwe_cache_release(tmp);
+#endif
 	crypto_ec_deinit(tmp->ec);
 	crypto_bignum_deinit(tmp->prime_buf, 0);
 	crypto_bignum_deinit(tmp->order_buf, 0);
@@ -436,6 +577,17 @@ static int sae_derive_pwe_ecc(struct sae_data *sae, const u8 *addr1,
 	struct crypto_bignum *x = NULL, *qr, *qnr;
 	size_t bits;
 	int res;
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+	u8 cache_id[SHA256_MAC_LEN];
+
+	sae_pwd_seed_key(addr1, addr2, addrs);
+	sae_pwe_cache_id(sae->group, addrs, password, password_len, identifier,
+			 cache_id);
+	if (sae_pwe_cache_get(sae, cache_id) == 0) {
+		wpa_printf(MSG_DEBUG, "SAE: Use cached PWE");
+		return ESP_OK;
+	}
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
 
 	dummy_password_len = password_len;
 	if (dummy_password_len > sizeof(dummy_password))
@@ -548,6 +700,10 @@ static int sae_derive_pwe_ecc(struct sae_data *sae, const u8 *addr1,
 		 */
 		wpa_printf(MSG_DEBUG, "SAE: Could not solve y");
 	}
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+	if (res == 0)
+		sae_pwe_cache_put(sae, cache_id);
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
 
 fail:
 	crypto_bignum_deinit(qr, 0);
@@ -621,6 +777,18 @@ static int sae_derive_pwe_ffc(struct sae_data *sae, const u8 *addr1,
 	return found ? 0 : -1;
 }
 
+/* res = b * PWE, with the precomputed multiples of the PWE when cached */
+static int sae_pwe_mul_ecc(struct sae_data *sae, const struct crypto_bignum *b,
+			   struct crypto_ec_point *res)
+{
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+	if (sae->tmp->pwe_cache)
+		return crypto_ec_fixed_base_mul(sae->tmp->pwe_cache->pwe_base,
+						b, res);
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
+	return crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc, b, res);
+}
+
 static int sae_derive_commit_element_ecc(struct sae_data *sae,
 					 struct crypto_bignum *mask)
 {
@@ -632,8 +800,7 @@ static int sae_derive_commit_element_ecc(struct sae_data *sae,
 			return ESP_FAIL;
 	}
 
-	if (crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc, mask,
-				sae->tmp->own_commit_element_ecc) < 0 ||
+	if (sae_pwe_mul_ecc(sae, mask, sae->tmp->own_commit_element_ecc) < 0 ||
 	    crypto_ec_point_invert(sae->tmp->ec,
 				   sae->tmp->own_commit_element_ecc) < 0) {
 		wpa_printf(MSG_DEBUG, "SAE: Could not compute commit-element");
@@ -744,8 +911,7 @@ static int sae_derive_k_ecc(struct sae_data *sae, u8 *k)
 	 * k = F(K) (= x coordinate)
 	 */
 
-	if (crypto_ec_point_mul(sae->tmp->ec, sae->tmp->pwe_ecc,
-				sae->peer_commit_scalar, K) < 0 ||
+	if (sae_pwe_mul_ecc(sae, sae->peer_commit_scalar, K) < 0 ||
 	    crypto_ec_point_add(sae->tmp->ec, K,
 				sae->tmp->peer_commit_element_ecc, K) < 0 ||
 	    crypto_ec_point_mul(sae->tmp->ec, K, sae->tmp->sae_rand, K) < 0 ||
@@ -27,6 +27,8 @@
 /* Special value returned by sae_parse_commit() */
 #define SAE_SILENTLY_DISCARD 65535
 
+struct sae_pwe_cache_entry;
+
 struct sae_temporary_data {
 	u8 kck[SAE_KCK_LEN];
 	struct crypto_bignum *own_commit_scalar;
@@ -45,6 +47,7 @@ struct sae_temporary_data {
 	struct crypto_bignum *prime_buf;
 	struct crypto_bignum *order_buf;
 	char *pw_id;
+	struct sae_pwe_cache_entry *pwe_cache; /* NULL if the PWE isn't cached */
 };
 
 enum {
@@ -71,6 +74,7 @@ struct sae_data {
 int sae_set_group(struct sae_data *sae, int group);
 void sae_clear_temp_data(struct sae_data *sae);
 void sae_clear_data(struct sae_data *sae);
+void sae_clear_pwe_cache(void);
 
 int sae_prepare_commit(const u8 *addr1, const u8 *addr2,
 		       const u8 *password, size_t password_len,
@@ -761,6 +761,44 @@ int crypto_ec_point_mul(struct crypto_ec *e, const struct crypto_ec_point *p,
         const struct crypto_bignum *b,
         struct crypto_ec_point *res);
 
+/**
+ * struct crypto_ec_fixed_base - EC point with precomputed multiples
+ *
+ * Internal data structure for speeding up repeated scalar multiplications of
+ * the same point, e.g., the SAE password element. Independent of the EC
+ * context it was created from, so it may outlive it.
+ */
+struct crypto_ec_fixed_base;
+
+/**
+ * crypto_ec_fixed_base_init - Precompute multiples of an EC point
+ * @e: EC context from crypto_ec_init()
+ * @p: EC point, in affine coordinates
+ * Returns: Pointer to the fixed base data or %NULL on failure
+ */
+struct crypto_ec_fixed_base *
+crypto_ec_fixed_base_init(struct crypto_ec *e, const struct crypto_ec_point *p);
+
+/**
+ * crypto_ec_fixed_base_deinit - Free precomputed multiples of an EC point
+ * @base: Fixed base data from crypto_ec_fixed_base_init(), may be %NULL
+ */
+void crypto_ec_fixed_base_deinit(struct crypto_ec_fixed_base *base);
+
+/**
+ * crypto_ec_fixed_base_mul - res = b * p, p being the fixed base point
+ * @base: Fixed base data from crypto_ec_fixed_base_init()
+ * @b: Bignum
+ * @res: EC point; used to store the result of b * p
+ * Returns: 0 on success, -1 on failure
+ *
+ * Same result as crypto_ec_point_mul() with the point used to create the
+ * fixed base, with the same constant-time properties.
+ */
+int crypto_ec_fixed_base_mul(struct crypto_ec_fixed_base *base,
+        const struct crypto_bignum *b,
+        struct crypto_ec_point *res);
+
 /**
  * crypto_ec_point_invert - Compute inverse of an EC point
  * @e: EC context from crypto_ec_init()
@@ -24,8 +24,6 @@
 #include "random.h"
 
 #include "mbedtls/ecp.h"
-#include "mbedtls/entropy.h"
-#include "mbedtls/ctr_drbg.h"
 
 #include "mbedtls/pk.h"
 #include "mbedtls/ecdh.h"
@@ -254,26 +252,96 @@ int crypto_ec_point_mul(struct crypto_ec *e, const struct crypto_ec_point *p,
 		const struct crypto_bignum *b,
 		struct crypto_ec_point *res)
 {
+	/* The RNG only randomizes the projective coordinates against side
+	 * channels, no need to seed a DRBG from the entropy pool every call */
+	return mbedtls_ecp_mul(&e->group,
+			(mbedtls_ecp_point *) res,
+			(const mbedtls_mpi *)b,
+			(const mbedtls_ecp_point *)p,
+			crypto_rng_wrapper, NULL) ? -1 : 0;
+}
+
+
+/*
+ * mbedtls_ecp_mul() uses a wider comb window, and keeps the comb table in
+ * the group, when the point is the generator of the group. A copy of the
+ * group with the fixed base point as generator therefore precomputes the
+ * table once for all the multiplications of that point.
+ */
+struct crypto_ec_fixed_base {
+	mbedtls_ecp_group group;
+};
+
+struct crypto_ec_fixed_base *
+crypto_ec_fixed_base_init(struct crypto_ec *e, const struct crypto_ec_point *p)
+{
+	struct crypto_ec_fixed_base *base;
+	mbedtls_ecp_group *grp;
+	mbedtls_ecp_point tmp;
+	mbedtls_mpi one;
 	int ret;
-	mbedtls_entropy_context entropy;
-	mbedtls_ctr_drbg_context ctr_drbg;
 
-	mbedtls_entropy_init(&entropy);
-	mbedtls_ctr_drbg_init(&ctr_drbg);
+	if (e == NULL || p == NULL) {
+		return NULL;
+	}
+
+	base = os_zalloc(sizeof(*base));
+	if (base == NULL) {
+		return NULL;
+	}
+
+	grp = &base->group;
+	mbedtls_ecp_group_init(grp);
+	mbedtls_ecp_point_init(&tmp);
+	mbedtls_mpi_init(&one);
 
-	MBEDTLS_MPI_CHK(mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
-				NULL, 0));
+	/* The parameters of a loaded group may point to constant data, so
+	 * they are copied rather than loaded and G overwritten */
+	grp->id = e->group.id;
+	grp->pbits = e->group.pbits;
+	grp->nbits = e->group.nbits;
+	grp->modp = e->group.modp;
+	MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&grp->P, &e->group.P));
+	MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&grp->A, &e->group.A));
+	MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&grp->B, &e->group.B));
+	MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&grp->N, &e->group.N));
+	MBEDTLS_MPI_CHK(mbedtls_ecp_copy(&grp->G, (const mbedtls_ecp_point *) p));
+	MBEDTLS_MPI_CHK(mbedtls_ecp_check_pubkey(grp, &grp->G));
+
+	/* Build the comb table now rather than on the first multiplication */
+	MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&one, 1));
+	MBEDTLS_MPI_CHK(mbedtls_ecp_mul(grp, &tmp, &one, &grp->G,
+				crypto_rng_wrapper, NULL));
 
-	MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&e->group,
-				(mbedtls_ecp_point *) res,
-				(const mbedtls_mpi *)b,
-				(const mbedtls_ecp_point *)p,
-				mbedtls_ctr_drbg_random,
-				&ctr_drbg));
 cleanup:
-	mbedtls_ctr_drbg_free(&ctr_drbg);
-	mbedtls_entropy_free(&entropy);
-	return ret ? -1 : 0;
+	mbedtls_ecp_point_free(&tmp);
+	mbedtls_mpi_free(&one);
+	if (ret) {
+		crypto_ec_fixed_base_deinit(base);
+		return NULL;
+	}
+	return base;
+}
+
+void crypto_ec_fixed_base_deinit(struct crypto_ec_fixed_base *base)
+{
+	if (base == NULL) {
+		return;
+	}
+
+	mbedtls_ecp_group_free(&base->group);
+	os_free(base);
+}
+
+int crypto_ec_fixed_base_mul(struct crypto_ec_fixed_base *base,
+		const struct crypto_bignum *b,
+		struct crypto_ec_point *res)
+{
+	return mbedtls_ecp_mul(&base->group,
+			(mbedtls_ecp_point *) res,
+			(const mbedtls_mpi *)b,
+			&base->group.G,
+			crypto_rng_wrapper, NULL) ? -1 : 0;
 }
 
 
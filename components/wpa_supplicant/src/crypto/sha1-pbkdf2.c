@@ -19,7 +19,22 @@
 #include "crypto.h"
 
 #ifdef USE_MBEDTLS_CRYPTO
+#include "mbedtls/sha1.h"
+#if CONFIG_IDF_TARGET_ESP32 && CONFIG_MBEDTLS_HARDWARE_SHA
+/*
+ * The SHA engine of the ESP32 can only hash from the initial state, so the
+ * precomputed key pad states below would take all the hashing off it. The
+ * HMAC of mbedtls hashes the key pads again for each iteration, but runs
+ * every hash on the engine.
+ */
+#define PBKDF2_SHA1_PKCS5
 #include "mbedtls/pkcs5.h"
+#endif
+#else
+#include "sha1_i.h"
+#endif
+
+#ifdef PBKDF2_SHA1_PKCS5
 
 /**
  * pbkdf2_sha1 - SHA1-based key derivation function (PBKDF2) for IEEE 802.11i
@@ -58,7 +73,7 @@ pbkdf2_sha1(const char *passphrase, const char *ssid, size_t ssid_len,
     }
 
     ret = mbedtls_pkcs5_pbkdf2_hmac( &sha1_ctx, (const unsigned char*) passphrase, os_strlen(passphrase) , (const unsigned char*) ssid,
-            ssid_len, iterations, 32, buf );
+            ssid_len, iterations, buflen, buf );
     if (ret != 0) {
         ret = -1;
         goto exit;
@@ -71,22 +86,90 @@ exit:
 }
 #else
 
-static int 
-pbkdf2_sha1_f(const char *passphrase, const char *ssid,
-        size_t ssid_len, int iterations, unsigned int count,
-        u8 *digest)
+/*
+ * Every PBKDF2 iteration is an HMAC-SHA1 of a 20 byte message keyed with the
+ * passphrase. The SHA-1 states after absorbing the inner and outer key pads
+ * don't depend on the message, so they are computed once per derivation.
+ * An iteration is then exactly two SHA-1 block compressions: the message
+ * fits in one padded block, both for the inner and for the outer hash.
+ * The usual HMAC implementation needs four compressions, plus the key pad
+ * setup, per iteration.
+ */
+
+#define SHA1_BLOCK_LEN 64
+
+#ifdef USE_MBEDTLS_CRYPTO
+
+/*
+ * mbedtls has no call to compress a block into a given state, the states are
+ * kept in SHA-1 contexts instead, and each hash starts from a clone of one.
+ * Hashing a 20 byte message from there still takes a single compression.
+ */
+
+struct pbkdf2_sha1_ctx {
+	mbedtls_sha1_context inner;	/* after (K xor ipad) */
+	mbedtls_sha1_context outer;	/* after (K xor opad) */
+};
+
+static void pbkdf2_sha1_free(struct pbkdf2_sha1_ctx *ctx)
 {
-	unsigned char tmp[SHA1_MAC_LEN], tmp2[SHA1_MAC_LEN];
-	int i, j;
-	unsigned char count_buf[4];
-	const u8 *addr[2];
-	size_t len[2];
-	size_t passphrase_len = os_strlen(passphrase);
+	mbedtls_sha1_free(&ctx->inner);
+	mbedtls_sha1_free(&ctx->outer);
+}
+
+static int pbkdf2_sha1_init(struct pbkdf2_sha1_ctx *ctx, const u8 *key,
+			    size_t key_len)
+{
+	u8 k_pad[SHA1_BLOCK_LEN];
+	u8 tk[SHA1_MAC_LEN];
+	size_t i;
+	int ret;
+
+	mbedtls_sha1_init(&ctx->inner);
+	mbedtls_sha1_init(&ctx->outer);
 
-	addr[0] = (u8 *) ssid;
-	len[0] = ssid_len;
-	addr[1] = count_buf;
-	len[1] = 4;
+	/* if key is longer than 64 bytes reset it to key = SHA1(key) */
+	if (key_len > SHA1_BLOCK_LEN) {
+		if ((ret = mbedtls_sha1_ret(key, key_len, tk)) != 0)
+			goto exit;
+		key = tk;
+		key_len = SHA1_MAC_LEN;
+	}
+
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memcpy(k_pad, key, key_len);
+	for (i = 0; i < SHA1_BLOCK_LEN; i++)
+		k_pad[i] ^= 0x36;
+	if ((ret = mbedtls_sha1_starts_ret(&ctx->inner)) != 0 ||
+	    (ret = mbedtls_sha1_update_ret(&ctx->inner, k_pad,
+					   SHA1_BLOCK_LEN)) != 0)
+		goto exit;
+
+	for (i = 0; i < SHA1_BLOCK_LEN; i++)
+		k_pad[i] ^= 0x36 ^ 0x5c;
+	if ((ret = mbedtls_sha1_starts_ret(&ctx->outer)) != 0 ||
+	    (ret = mbedtls_sha1_update_ret(&ctx->outer, k_pad,
+					   SHA1_BLOCK_LEN)) != 0)
+		goto exit;
+
+exit:
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memset(tk, 0, sizeof(tk));
+	if (ret != 0) {
+		pbkdf2_sha1_free(ctx);
+		return -1;
+	}
+	return 0;
+}
+
+static int pbkdf2_sha1_f(const struct pbkdf2_sha1_ctx *ctx, const char *ssid,
+			 size_t ssid_len, int iterations, unsigned int count,
+			 u8 *digest)
+{
+	mbedtls_sha1_context sha1;
+	u8 count_buf[4];
+	u8 tmp[SHA1_MAC_LEN];
+	int i, j, ret;
 
 	/* F(P, S, c, i) = U1 xor U2 xor ... Uc
 	 * U1 = PRF(P, S || i)
@@ -94,27 +177,171 @@ pbkdf2_sha1_f(const char *passphrase, const char *ssid,
 	 * Uc = PRF(P, Uc-1)
 	 */
 
-	count_buf[0] = (count >> 24) & 0xff;
-	count_buf[1] = (count >> 16) & 0xff;
-	count_buf[2] = (count >> 8) & 0xff;
-	count_buf[3] = count & 0xff;
-	if (hmac_sha1_vector((u8 *) passphrase, passphrase_len, 2, addr, len,
-			     tmp))
-		return -1;
-	os_memcpy(digest, tmp, SHA1_MAC_LEN);
+	mbedtls_sha1_init(&sha1);
+
+	/* Inner hash of U1, the salt can have any length */
+	WPA_PUT_BE32(count_buf, count);
+	mbedtls_sha1_clone(&sha1, &ctx->inner);
+	if ((ret = mbedtls_sha1_update_ret(&sha1, (const u8 *) ssid,
+					   ssid_len)) != 0 ||
+	    (ret = mbedtls_sha1_update_ret(&sha1, count_buf,
+					   sizeof(count_buf))) != 0)
+		goto exit;
+
+	for (i = 0; i < iterations; i++) {
+		if (i > 0) {
+			mbedtls_sha1_clone(&sha1, &ctx->inner);
+			if ((ret = mbedtls_sha1_update_ret(&sha1, tmp,
+							   SHA1_MAC_LEN)) != 0)
+				goto exit;
+		}
+		if ((ret = mbedtls_sha1_finish_ret(&sha1, tmp)) != 0)
+			goto exit;
+
+		mbedtls_sha1_clone(&sha1, &ctx->outer);
+		if ((ret = mbedtls_sha1_update_ret(&sha1, tmp,
+						   SHA1_MAC_LEN)) != 0 ||
+		    (ret = mbedtls_sha1_finish_ret(&sha1, tmp)) != 0)
+			goto exit;
+
+		if (i == 0) {
+			os_memcpy(digest, tmp, SHA1_MAC_LEN);
+		} else {
+			for (j = 0; j < SHA1_MAC_LEN; j++)
+				digest[j] ^= tmp[j];
+		}
+	}
+
+exit:
+	mbedtls_sha1_free(&sha1);
+	os_memset(tmp, 0, sizeof(tmp));
+	return ret != 0 ? -1 : 0;
+}
+
+#else /* USE_MBEDTLS_CRYPTO */
+
+struct pbkdf2_sha1_ctx {
+	u32 inner[5];	/* SHA-1 state after (K xor ipad) */
+	u32 outer[5];	/* SHA-1 state after (K xor opad) */
+};
+
+static void pbkdf2_sha1_free(struct pbkdf2_sha1_ctx *ctx)
+{
+	os_memset(ctx, 0, sizeof(*ctx));
+}
+
+static int pbkdf2_sha1_init(struct pbkdf2_sha1_ctx *ctx, const u8 *key,
+			    size_t key_len)
+{
+	struct SHA1Context sha1;
+	u8 k_pad[SHA1_BLOCK_LEN];
+	u8 tk[SHA1_MAC_LEN];
+	size_t i;
+
+	/* if key is longer than 64 bytes reset it to key = SHA1(key) */
+	if (key_len > SHA1_BLOCK_LEN) {
+		SHA1Init(&sha1);
+		SHA1Update(&sha1, key, key_len);
+		SHA1Final(tk, &sha1);
+		key = tk;
+		key_len = SHA1_MAC_LEN;
+	}
+
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memcpy(k_pad, key, key_len);
+	for (i = 0; i < SHA1_BLOCK_LEN; i++)
+		k_pad[i] ^= 0x36;
+	SHA1Init(&sha1);
+	os_memcpy(ctx->inner, sha1.state, sizeof(ctx->inner));
+	os_memcpy(ctx->outer, sha1.state, sizeof(ctx->outer));
+	SHA1Transform(ctx->inner, k_pad);
+
+	for (i = 0; i < SHA1_BLOCK_LEN; i++)
+		k_pad[i] ^= 0x36 ^ 0x5c;
+	SHA1Transform(ctx->outer, k_pad);
+
+	os_memset(k_pad, 0, sizeof(k_pad));
+	os_memset(tk, 0, sizeof(tk));
+	return 0;
+}
+
+static void pbkdf2_sha1_put_state(u8 *out, const u32 state[5])
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		WPA_PUT_BE32(out + 4 * i, state[i]);
+}
+
+/*
+ * HMAC of the SHA1_MAC_LEN bytes at the start of block, which must already
+ * hold the SHA-1 padding of a 84 byte message (key pad block + 20 bytes).
+ * The MAC replaces the message in block, ready for the next iteration, and
+ * its words are returned in mac.
+ */
+static void pbkdf2_sha1_hmac_block(const struct pbkdf2_sha1_ctx *ctx,
+				   u8 block[SHA1_BLOCK_LEN], u32 mac[5])
+{
+	os_memcpy(mac, ctx->inner, sizeof(ctx->inner));
+	SHA1Transform(mac, block);
+	pbkdf2_sha1_put_state(block, mac);
+
+	os_memcpy(mac, ctx->outer, sizeof(ctx->outer));
+	SHA1Transform(mac, block);
+	pbkdf2_sha1_put_state(block, mac);
+}
+
+static int pbkdf2_sha1_f(const struct pbkdf2_sha1_ctx *ctx, const char *ssid,
+			 size_t ssid_len, int iterations, unsigned int count,
+			 u8 *digest)
+{
+	struct SHA1Context sha1;
+	u8 block[SHA1_BLOCK_LEN];
+	u8 count_buf[4];
+	u32 mac[5], xor[5];
+	int i, j;
+
+	/* F(P, S, c, i) = U1 xor U2 xor ... Uc
+	 * U1 = PRF(P, S || i)
+	 * U2 = PRF(P, U1)
+	 * Uc = PRF(P, Uc-1)
+	 */
+
+	/* Inner hash of U1, the salt can have any length */
+	WPA_PUT_BE32(count_buf, count);
+	os_memcpy(sha1.state, ctx->inner, sizeof(ctx->inner));
+	sha1.count[0] = SHA1_BLOCK_LEN * 8;
+	sha1.count[1] = 0;
+	SHA1Update(&sha1, ssid, ssid_len);
+	SHA1Update(&sha1, count_buf, sizeof(count_buf));
+	SHA1Final(block, &sha1);
+
+	/* Padding of a 20 byte message following the key pad block */
+	block[SHA1_MAC_LEN] = 0x80;
+	os_memset(block + SHA1_MAC_LEN + 1, 0,
+		  SHA1_BLOCK_LEN - SHA1_MAC_LEN - 1 - 8);
+	WPA_PUT_BE64(block + SHA1_BLOCK_LEN - 8,
+		     (SHA1_BLOCK_LEN + SHA1_MAC_LEN) * 8);
+
+	/* Outer hash of U1 */
+	os_memcpy(mac, ctx->outer, sizeof(ctx->outer));
+	SHA1Transform(mac, block);
+	pbkdf2_sha1_put_state(block, mac);
+	os_memcpy(xor, mac, sizeof(xor));
 
 	for (i = 1; i < iterations; i++) {
-		if (hmac_sha1((u8 *) passphrase, passphrase_len, tmp,
-			      SHA1_MAC_LEN, tmp2))
-			return -1;
-		os_memcpy(tmp, tmp2, SHA1_MAC_LEN);
-		for (j = 0; j < SHA1_MAC_LEN; j++)
-			digest[j] ^= tmp2[j];
+		pbkdf2_sha1_hmac_block(ctx, block, mac);
+		for (j = 0; j < 5; j++)
+			xor[j] ^= mac[j];
 	}
 
+	pbkdf2_sha1_put_state(digest, xor);
+	os_memset(block, 0, sizeof(block));
+	os_memset(&sha1, 0, sizeof(sha1));
 	return 0;
 }
 
+#endif /* USE_MBEDTLS_CRYPTO */
 
 /**
  * pbkdf2_sha1 - SHA1-based key derivation function (PBKDF2) for IEEE 802.11i
@@ -130,26 +357,39 @@ pbkdf2_sha1_f(const char *passphrase, const char *ssid,
  * iterations is set to 4096 and buflen to 32. This function is described in
  * IEEE Std 802.11-2004, Clause H.4. The main construction is from PKCS#5 v2.0.
  */
-int 
+int
 pbkdf2_sha1(const char *passphrase, const char *ssid, size_t ssid_len,
 		int iterations, u8 *buf, size_t buflen)
 {
+	struct pbkdf2_sha1_ctx ctx;
 	unsigned int count = 0;
 	unsigned char *pos = buf;
 	size_t left = buflen, plen;
 	unsigned char digest[SHA1_MAC_LEN];
+	int ret = 0;
+
+	if (iterations < 1)
+		return -1;
+
+	if (pbkdf2_sha1_init(&ctx, (const u8 *) passphrase,
+			     os_strlen(passphrase)))
+		return -1;
 
 	while (left > 0) {
 		count++;
-		if (pbkdf2_sha1_f(passphrase, ssid, ssid_len, iterations,
-				  count, digest))
-			return -1;
+		if (pbkdf2_sha1_f(&ctx, ssid, ssid_len, iterations, count,
+				  digest)) {
+			ret = -1;
+			break;
+		}
 		plen = left > SHA1_MAC_LEN ? SHA1_MAC_LEN : left;
 		os_memcpy(pos, digest, plen);
 		pos += plen;
 		left -= plen;
 	}
 
-	return 0;
+	pbkdf2_sha1_free(&ctx);
+	os_memset(digest, 0, sizeof(digest));
+	return ret;
 }
-#endif
+#endif /* PBKDF2_SHA1_PKCS5 */
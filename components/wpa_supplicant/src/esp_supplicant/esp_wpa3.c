@@ -130,6 +130,12 @@ void esp_wpa3_free_sae_data(void)
     sae_clear_data(&g_sae_data);
 }
 
+void esp_wpa3_deinit(void)
+{
+    esp_wpa3_free_sae_data();
+    sae_clear_pwe_cache();
+}
+
 static u8 *wpa3_build_sae_msg(u8 *bssid, u32 sae_msg_type, u32 *sae_msg_len)
 {
     u8 *buf = NULL;
@@ -22,9 +22,14 @@
 
 void esp_wifi_register_wpa3_cb(struct wpa_funcs *wpa_cb);
 void esp_wpa3_free_sae_data(void);
+void esp_wpa3_deinit(void);
 
 #else /* CONFIG_WPA3_SAE */
 
+static inline void esp_wpa3_deinit(void)
+{
+}
+
 static inline void esp_wifi_register_wpa3_cb(struct wpa_funcs *wpa_cb)
 {
     wpa_cb->wpa3_build_sae_msg = NULL;
@@ -233,5 +233,6 @@ int esp_supplicant_init(void)
 
 int esp_supplicant_deinit(void)
 {
+    esp_wpa3_deinit();
     return esp_wifi_unregister_wpa_cb_internal();
 }
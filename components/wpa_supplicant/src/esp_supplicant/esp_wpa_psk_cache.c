@@ -0,0 +1,130 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/includes.h"
+#include "utils/common.h"
+#include "common/defs.h"
+#include "common/wpa_common.h"
+#include "crypto/crypto.h"
+#include "crypto/sha1.h"
+#include "crypto/sha256.h"
+#include "esp_wpa_psk_cache.h"
+#include "sdkconfig.h"
+
+#define WPA_PSK_ITERATIONS 4096
+
+#ifdef CONFIG_WPA_PSK_CACHE
+
+#include "nvs.h"
+
+#define PSK_CACHE_NAMESPACE "wpa_psk"
+#define PSK_CACHE_KEY       "cache"
+
+struct psk_cache_entry {
+    u8 id[SHA256_MAC_LEN];  /* SHA-256 of the SSID and passphrase, all zero if unused */
+    u8 psk[PMK_LEN];
+};
+
+/* Stored as a single blob: loading it is a single NVS lookup */
+struct psk_cache {
+    u8 next;                /* entry to replace on the next miss */
+    u8 reserved[3];
+    struct psk_cache_entry entries[CONFIG_WPA_PSK_CACHE_SIZE];
+};
+
+static void psk_cache_id(const char *passphrase, const u8 *ssid, size_t ssid_len,
+                         u8 *id)
+{
+    u8 ssid_len_buf = ssid_len;
+    const u8 *addr[3] = { &ssid_len_buf, ssid, (const u8 *) passphrase };
+    size_t len[3] = { 1, ssid_len, os_strlen(passphrase) };
+
+    sha256_vector(3, addr, len, id);
+}
+
+static int psk_cache_load(nvs_handle_t handle, struct psk_cache *cache)
+{
+    size_t size = sizeof(*cache);
+
+    if (nvs_get_blob(handle, PSK_CACHE_KEY, cache, &size) != ESP_OK ||
+        size != sizeof(*cache) || cache->next >= CONFIG_WPA_PSK_CACHE_SIZE) {
+        /* Missing, or written with a different cache size */
+        os_memset(cache, 0, sizeof(*cache));
+        return -1;
+    }
+    return 0;
+}
+
+int esp_wpa_psk_derive(const char *passphrase, const u8 *ssid, size_t ssid_len,
+                       u8 *psk)
+{
+    struct psk_cache *cache;
+    nvs_handle_t handle;
+    u8 id[SHA256_MAC_LEN];
+    int i, ret;
+
+    cache = os_malloc(sizeof(*cache));
+    if (cache == NULL ||
+        nvs_open(PSK_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        /* NVS not initialized: derive without caching */
+        os_free(cache);
+        return pbkdf2_sha1(passphrase, (const char *) ssid, ssid_len,
+                           WPA_PSK_ITERATIONS, psk, PMK_LEN);
+    }
+
+    psk_cache_id(passphrase, ssid, ssid_len, id);
+    if (psk_cache_load(handle, cache) == 0) {
+        for (i = 0; i < CONFIG_WPA_PSK_CACHE_SIZE; i++) {
+            if (os_memcmp_const(cache->entries[i].id, id, sizeof(id)) == 0) {
+                wpa_printf(MSG_DEBUG, "PSK cache hit");
+                os_memcpy(psk, cache->entries[i].psk, PMK_LEN);
+                ret = 0;
+                goto out;
+            }
+        }
+    } else {
+        /* The cleared cache is filled from its first entry */
+        wpa_printf(MSG_DEBUG, "PSK cache: no valid cache stored");
+    }
+
+    ret = pbkdf2_sha1(passphrase, (const char *) ssid, ssid_len,
+                      WPA_PSK_ITERATIONS, psk, PMK_LEN);
+    if (ret == 0) {
+        struct psk_cache_entry *entry = &cache->entries[cache->next];
+
+        os_memcpy(entry->id, id, sizeof(id));
+        os_memcpy(entry->psk, psk, PMK_LEN);
+        cache->next = (cache->next + 1) % CONFIG_WPA_PSK_CACHE_SIZE;
+        if (nvs_set_blob(handle, PSK_CACHE_KEY, cache, sizeof(*cache)) != ESP_OK ||
+            nvs_commit(handle) != ESP_OK) {
+            wpa_printf(MSG_DEBUG, "PSK cache: failed to store the PSK");
+        }
+    }
+
+out:
+    nvs_close(handle);
+    bin_clear_free(cache, sizeof(*cache));
+    return ret;
+}
+
+#else /* CONFIG_WPA_PSK_CACHE */
+
+int esp_wpa_psk_derive(const char *passphrase, const u8 *ssid, size_t ssid_len,
+                       u8 *psk)
+{
+    return pbkdf2_sha1(passphrase, (const char *) ssid, ssid_len,
+                       WPA_PSK_ITERATIONS, psk, PMK_LEN);
+}
+
+#endif /* CONFIG_WPA_PSK_CACHE */
@@ -0,0 +1,33 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ESP_WPA_PSK_CACHE_H
+#define ESP_WPA_PSK_CACHE_H
+
+/**
+ * esp_wpa_psk_derive - Derive the WPA-PSK of a passphrase
+ * @passphrase: ASCII passphrase
+ * @ssid: SSID
+ * @ssid_len: SSID length in bytes
+ * @psk: Buffer for the PMK_LEN bytes of the PSK
+ * Returns: 0 on success, -1 on failure
+ *
+ * Same as pbkdf2_sha1() with 4096 iterations. With CONFIG_WPA_PSK_CACHE, the
+ * PSKs of the last networks are kept in NVS, keyed by a hash of the SSID and
+ * passphrase, so that they are not derived again after a reboot.
+ */
+int esp_wpa_psk_derive(const char *passphrase, const u8 *ssid, size_t ssid_len,
+                       u8 *psk);
+
+#endif /* ESP_WPA_PSK_CACHE_H */
@@ -23,6 +23,7 @@
 #include "rsn_supp/wpa_ie.h"
 #include "esp_supplicant/esp_wpas_glue.h"
 #include "esp_supplicant/esp_wifi_driver.h"
+#include "esp_supplicant/esp_wpa_psk_cache.h"
 
 #include "crypto/crypto.h"
 #include "crypto/sha1.h"
@@ -2175,8 +2176,8 @@ wpa_set_passphrase(char * passphrase, u8 *ssid, size_t ssid_len)
         if (strlen((char *)esp_wifi_sta_get_prof_password_internal()) == 64) {
             hexstr2bin((char *)esp_wifi_sta_get_prof_password_internal(), esp_wifi_sta_get_ap_info_prof_pmk_internal(), PMK_LEN);
         } else {
-        pbkdf2_sha1((char *)esp_wifi_sta_get_prof_password_internal(), (char *)sta_ssid->ssid, (size_t)sta_ssid->len,
-            4096, esp_wifi_sta_get_ap_info_prof_pmk_internal(), PMK_LEN);
+        esp_wpa_psk_derive((char *)esp_wifi_sta_get_prof_password_internal(), sta_ssid->ssid, (size_t)sta_ssid->len,
+            esp_wifi_sta_get_ap_info_prof_pmk_internal());
         }
         esp_wifi_sta_update_ap_info_internal();
         esp_wifi_sta_set_reset_param_internal(0);
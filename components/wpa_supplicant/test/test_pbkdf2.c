@@ -0,0 +1,83 @@
+// Copyright 2020 Espressif Systems (Shanghai) PTE LTD
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "utils/includes.h"
+#include "utils/common.h"
+#include "crypto/sha1.h"
+#include "mbedtls/pkcs5.h"
+
+typedef struct {
+    const char *passphrase;
+    const char *salt;
+    int iterations;
+    size_t len;
+    const char *hex;
+} pbkdf2_vector_t;
+
+/* RFC 6070 and IEEE Std 802.11-2016, J.4 test vectors */
+static const pbkdf2_vector_t pbkdf2_vectors[] = {
+    { "password", "salt", 1, 20, "0c60c80f961f0e71f3a9b524af6012062fe037a6" },
+    { "password", "salt", 2, 20, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" },
+    { "password", "salt", 4096, 20, "4b007901b765489abead49d926f721d065a429c1" },
+    { "passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 25,
+      "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038" },
+    { "password", "IEEE", 4096, 32,
+      "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e" },
+    { "ThisIsAPassword", "ThisIsASSID", 4096, 32,
+      "0dc0d6eb90555ed6419756b9a15ec3e3209b63df707dd508d14581f8982721af" },
+};
+
+/* Reference PBKDF2, which pbkdf2_sha1() uses on the ESP32 with hardware SHA */
+static int pbkdf2_sha1_mbedtls(const char *passphrase, const char *salt, size_t salt_len,
+                               int iterations, u8 *buf, size_t buflen)
+{
+    mbedtls_md_context_t ctx;
+    int ret;
+
+    mbedtls_md_init(&ctx);
+    ret = mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), 1);
+    if (ret == 0) {
+        ret = mbedtls_pkcs5_pbkdf2_hmac(&ctx, (const unsigned char *) passphrase, strlen(passphrase),
+                                        (const unsigned char *) salt, salt_len, iterations, buflen, buf);
+    }
+    mbedtls_md_free(&ctx);
+    return ret;
+}
+
+TEST_CASE("Test pbkdf2_sha1 vectors", "[wpa_crypto]")
+{
+    u8 expected[32], out[32];
+
+    for (int i = 0; i < sizeof(pbkdf2_vectors) / sizeof(pbkdf2_vectors[0]); i++) {
+        const pbkdf2_vector_t *v = &pbkdf2_vectors[i];
+
+        TEST_ASSERT_EQUAL(0, hexstr2bin(v->hex, expected, v->len));
+        memset(out, 0xa5, sizeof(out));
+        TEST_ASSERT_EQUAL(0, pbkdf2_sha1(v->passphrase, v->salt, strlen(v->salt), v->iterations, out, v->len));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, v->len);
+        /* Only buflen bytes are written */
+        for (int j = v->len; j < sizeof(out); j++) {
+            TEST_ASSERT_EQUAL_HEX8(0xa5, out[j]);
+        }
+    }
+
+    /* Passphrases longer than the SHA-1 block are hashed first */
+    const char *long_passphrase = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdefXYZ";
+    TEST_ASSERT_EQUAL(0, pbkdf2_sha1_mbedtls(long_passphrase, "long", 4, 10, expected, 32));
+    TEST_ASSERT_EQUAL(0, pbkdf2_sha1(long_passphrase, "long", 4, 10, out, 32));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, 32);
+}
@@ -24,6 +24,7 @@
 #include "crypto/crypto.h"
 #include "../src/common/sae.h"
 #include "utils/wpabuf.h"
+#include "esp_timer.h"
 
 typedef struct crypto_bignum crypto_bignum;
 
@@ -268,4 +269,110 @@ TEST_CASE("Test SAE functionality with ECC group", "[wpa3_sae]")
 
 }
 
+TEST_CASE("Test SAE fixed base multiplication of the PWE", "[wpa3_sae]")
+{
+    struct sae_data sae;
+    u8 addr1[ETH_ALEN] = {0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0x11};
+    u8 addr2[ETH_ALEN] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    u8 pwd[] = "ESP32-WPA3";
+    const int rounds = 16;
+
+    memset(&sae, 0, sizeof(sae));
+    TEST_ASSERT(sae_set_group(&sae, IANA_SECP256R1) == 0);
+    TEST_ASSERT(sae_prepare_commit(addr1, addr2, pwd, strlen((const char *)pwd), NULL, &sae) == 0);
+
+    struct crypto_ec *ec = sae.tmp->ec;
+    struct crypto_ec_fixed_base *base = crypto_ec_fixed_base_init(ec, sae.tmp->pwe_ecc);
+    TEST_ASSERT_NOT_NULL(base);
+    struct crypto_ec_point *expected = crypto_ec_point_init(ec);
+    struct crypto_ec_point *res = crypto_ec_point_init(ec);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(res);
+
+    int64_t generic_time = 0, fixed_time = 0;
+    for (int i = 0; i < rounds; i++) {
+        /* Random scalar in [1, r - 1] */
+        crypto_bignum *b = crypto_bignum_init();
+        TEST_ASSERT_NOT_NULL(b);
+        do {
+            u8 buf[32];
+            TEST_ASSERT(!os_get_random(buf, sizeof(buf)));
+            crypto_bignum_deinit(b, 1);
+            b = crypto_bignum_init_set(buf, sizeof(buf));
+            TEST_ASSERT_NOT_NULL(b);
+            TEST_ASSERT(crypto_bignum_mod(b, sae.tmp->order, b) == 0);
+        } while (crypto_bignum_is_zero(b));
+
+        int64_t start = esp_timer_get_time();
+        TEST_ASSERT(crypto_ec_point_mul(ec, sae.tmp->pwe_ecc, b, expected) == 0);
+        generic_time += esp_timer_get_time() - start;
+
+        start = esp_timer_get_time();
+        TEST_ASSERT(crypto_ec_fixed_base_mul(base, b, res) == 0);
+        fixed_time += esp_timer_get_time() - start;
+
+        TEST_ASSERT(crypto_ec_point_cmp(ec, expected, res) == 0);
+        crypto_bignum_deinit(b, 1);
+    }
+
+    printf("P-256 scalar multiplication: generic %lld us, fixed base %lld us\n",
+           generic_time / rounds, fixed_time / rounds);
+    TEST_ASSERT_TRUE(fixed_time < generic_time);
+
+    crypto_ec_point_deinit(expected, 1);
+    crypto_ec_point_deinit(res, 1);
+    crypto_ec_fixed_base_deinit(base);
+    sae_clear_data(&sae);
+    sae_clear_pwe_cache();
+}
+
+#if CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0
+TEST_CASE("Test SAE PWE cache", "[wpa3_sae]")
+{
+    struct sae_data sae1, sae2, sae3;
+    u8 addr1[ETH_ALEN] = {0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0x11};
+    u8 addr2[ETH_ALEN] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    u8 addr3[ETH_ALEN] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x77};
+    u8 pwd[] = "ESP32-WPA3";
+
+    sae_clear_pwe_cache();
+    memset(&sae1, 0, sizeof(sae1));
+    memset(&sae2, 0, sizeof(sae2));
+    memset(&sae3, 0, sizeof(sae3));
+    TEST_ASSERT(sae_set_group(&sae1, IANA_SECP256R1) == 0);
+    TEST_ASSERT(sae_set_group(&sae2, IANA_SECP256R1) == 0);
+    TEST_ASSERT(sae_set_group(&sae3, IANA_SECP256R1) == 0);
+
+    int64_t start = esp_timer_get_time();
+    TEST_ASSERT(sae_prepare_commit(addr1, addr2, pwd, strlen((const char *)pwd), NULL, &sae1) == 0);
+    int64_t derive_time = esp_timer_get_time() - start;
+    TEST_ASSERT_NOT_NULL(sae1.tmp->pwe_cache);
+
+    /* The peer derives the same PWE, whatever the order of the addresses */
+    start = esp_timer_get_time();
+    TEST_ASSERT(sae_prepare_commit(addr2, addr1, pwd, strlen((const char *)pwd), NULL, &sae2) == 0);
+    int64_t cached_time = esp_timer_get_time() - start;
+    TEST_ASSERT(sae2.tmp->pwe_cache == sae1.tmp->pwe_cache);
+    TEST_ASSERT(crypto_ec_point_cmp(sae1.tmp->ec, sae1.tmp->pwe_ecc, sae2.tmp->pwe_ecc) == 0);
+
+    printf("SAE commit: PWE derived %lld us, cached %lld us\n", derive_time, cached_time);
+    TEST_ASSERT_TRUE(cached_time * 2 < derive_time);
+
+    /* Another AP or password gives another PWE */
+    TEST_ASSERT(sae_prepare_commit(addr1, addr3, pwd, strlen((const char *)pwd), NULL, &sae3) == 0);
+    TEST_ASSERT(sae3.tmp->pwe_cache != sae1.tmp->pwe_cache);
+    TEST_ASSERT(crypto_ec_point_cmp(sae1.tmp->ec, sae1.tmp->pwe_ecc, sae3.tmp->pwe_ecc) != 0);
+
+    /* Entries used by an SAE instance are not freed */
+    sae_clear_pwe_cache();
+    TEST_ASSERT(sae_prepare_commit(addr2, addr1, pwd, strlen((const char *)pwd), NULL, &sae2) == 0);
+    TEST_ASSERT(sae2.tmp->pwe_cache == sae1.tmp->pwe_cache);
+
+    sae_clear_data(&sae1);
+    sae_clear_data(&sae2);
+    sae_clear_data(&sae3);
+    sae_clear_pwe_cache();
+}
+#endif /* CONFIG_WPA_SAE_PWE_CACHE_SIZE > 0 */
+
 #endif /* CONFIG_WPA3_SAE */
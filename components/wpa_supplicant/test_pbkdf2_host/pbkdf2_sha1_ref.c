@@ -0,0 +1,65 @@
+/*
+ * PBKDF2-SHA1 as implemented before the key pad states were precomputed: an
+ * HMAC of hmac_sha1() per iteration. Reference of the host tests.
+ */
+
+#include "utils/includes.h"
+#include "utils/common.h"
+#include "crypto/sha1.h"
+#include "pbkdf2_sha1_ref.h"
+
+static int pbkdf2_sha1_ref_f(const char *passphrase, const char *ssid,
+			     size_t ssid_len, int iterations,
+			     unsigned int count, u8 *digest)
+{
+	unsigned char tmp[SHA1_MAC_LEN], tmp2[SHA1_MAC_LEN];
+	int i, j;
+	unsigned char count_buf[4];
+	const u8 *addr[2];
+	size_t len[2];
+	size_t passphrase_len = os_strlen(passphrase);
+
+	addr[0] = (u8 *) ssid;
+	len[0] = ssid_len;
+	addr[1] = count_buf;
+	len[1] = 4;
+
+	WPA_PUT_BE32(count_buf, count);
+	if (hmac_sha1_vector((u8 *) passphrase, passphrase_len, 2, addr, len,
+			     tmp))
+		return -1;
+	os_memcpy(digest, tmp, SHA1_MAC_LEN);
+
+	for (i = 1; i < iterations; i++) {
+		if (hmac_sha1((u8 *) passphrase, passphrase_len, tmp,
+			      SHA1_MAC_LEN, tmp2))
+			return -1;
+		os_memcpy(tmp, tmp2, SHA1_MAC_LEN);
+		for (j = 0; j < SHA1_MAC_LEN; j++)
+			digest[j] ^= tmp2[j];
+	}
+
+	return 0;
+}
+
+int pbkdf2_sha1_ref(const char *passphrase, const char *ssid, size_t ssid_len,
+		    int iterations, u8 *buf, size_t buflen)
+{
+	unsigned int count = 0;
+	unsigned char *pos = buf;
+	size_t left = buflen, plen;
+	unsigned char digest[SHA1_MAC_LEN];
+
+	while (left > 0) {
+		count++;
+		if (pbkdf2_sha1_ref_f(passphrase, ssid, ssid_len, iterations,
+				      count, digest))
+			return -1;
+		plen = left > SHA1_MAC_LEN ? SHA1_MAC_LEN : left;
+		os_memcpy(pos, digest, plen);
+		pos += plen;
+		left -= plen;
+	}
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int pbkdf2_sha1(const char *passphrase, const char *ssid, size_t ssid_len,
+                int iterations, uint8_t *buf, size_t buflen);
+
+int pbkdf2_sha1_ref(const char *passphrase, const char *ssid, size_t ssid_len,
+                    int iterations, uint8_t *buf, size_t buflen);
+
+#ifdef __cplusplus
+}
+#endif
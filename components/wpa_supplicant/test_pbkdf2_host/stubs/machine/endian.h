@@ -0,0 +1,4 @@
+#pragma once
+
+/* Included by port/include/byteswap.h, newlib has it but glibc doesn't */
+#include <endian.h>
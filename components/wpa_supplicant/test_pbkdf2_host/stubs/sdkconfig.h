@@ -0,0 +1,3 @@
+#pragma once
+
+#define CONFIG_WPA_MBEDTLS_CRYPTO   1
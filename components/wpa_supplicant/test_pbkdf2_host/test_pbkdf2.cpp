@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "catch.hpp"
+#include "pbkdf2_sha1_ref.h"
+
+namespace {
+
+struct pbkdf2_vector {
+    const char *passphrase;
+    const char *salt;
+    int iterations;
+    size_t len;
+    const char *hex;
+};
+
+/* RFC 6070 and IEEE Std 802.11-2016, J.4 test vectors */
+const pbkdf2_vector vectors[] = {
+    { "password", "salt", 1, 20, "0c60c80f961f0e71f3a9b524af6012062fe037a6" },
+    { "password", "salt", 2, 20, "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" },
+    { "password", "salt", 4096, 20, "4b007901b765489abead49d926f721d065a429c1" },
+    { "passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 25,
+      "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038" },
+    { "password", "IEEE", 4096, 32,
+      "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e" },
+    { "ThisIsAPassword", "ThisIsASSID", 4096, 32,
+      "0dc0d6eb90555ed6419756b9a15ec3e3209b63df707dd508d14581f8982721af" },
+};
+
+std::string to_hex(const uint8_t *data, size_t len)
+{
+    std::string hex;
+    char byte[3];
+    for (size_t i = 0; i < len; i++) {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+/* Best of a few runs, in microseconds */
+template<typename F>
+double time_us(F f)
+{
+    double best = 0;
+    for (int run = 0; run < 5; run++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+TEST_CASE("pbkdf2_sha1 matches the test vectors", "[pbkdf2]")
+{
+    uint8_t out[32];
+
+    for (const pbkdf2_vector &v : vectors) {
+        memset(out, 0xa5, sizeof(out));
+        CHECK(pbkdf2_sha1(v.passphrase, v.salt, strlen(v.salt), v.iterations, out, v.len) == 0);
+        CHECK(to_hex(out, v.len) == v.hex);
+        /* Only buflen bytes are written */
+        for (size_t i = v.len; i < sizeof(out); i++) {
+            CHECK(out[i] == 0xa5);
+        }
+        CHECK(pbkdf2_sha1_ref(v.passphrase, v.salt, strlen(v.salt), v.iterations, out, v.len) == 0);
+        CHECK(to_hex(out, v.len) == v.hex);
+    }
+}
+
+TEST_CASE("pbkdf2_sha1 matches the HMAC based implementation", "[pbkdf2]")
+{
+    /* Passphrases longer than the SHA-1 block are hashed first, salts span blocks */
+    const char *passphrases[] = { "", "p", "ThisIsAPassword",
+                                  "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef",
+                                  "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdefXYZ" };
+    char salt[200];
+    uint8_t expected[50], out[50];
+
+    memset(salt, 's', sizeof(salt));
+    for (const char *passphrase : passphrases) {
+        for (size_t salt_len = 0; salt_len <= sizeof(salt); salt_len += 13) {
+            CHECK(pbkdf2_sha1_ref(passphrase, salt, salt_len, 3, expected, sizeof(expected)) == 0);
+            CHECK(pbkdf2_sha1(passphrase, salt, salt_len, 3, out, sizeof(out)) == 0);
+            CHECK(to_hex(out, sizeof(out)) == to_hex(expected, sizeof(expected)));
+        }
+    }
+    CHECK(pbkdf2_sha1("password", "salt", 4, 0, out, sizeof(out)) == -1);
+}
+
+TEST_CASE("pbkdf2_sha1 derives a WPA2 PSK faster than the HMAC based implementation", "[pbkdf2]")
+{
+    const char *passphrase = "ThisIsAPassword";
+    const char *ssid = "ThisIsASSID";
+    uint8_t expected[32], out[32];
+
+    double reference_time = time_us([&] {
+        CHECK(pbkdf2_sha1_ref(passphrase, ssid, strlen(ssid), 4096, expected, sizeof(expected)) == 0);
+    });
+    double time = time_us([&] {
+        CHECK(pbkdf2_sha1(passphrase, ssid, strlen(ssid), 4096, out, sizeof(out)) == 0);
+    });
+    printf("WPA2 PSK derivation: HMAC based %.0f us, pbkdf2_sha1 %.0f us\n", reference_time, time);
+
+    CHECK(to_hex(out, sizeof(out)) == to_hex(expected, sizeof(expected)));
+    /* Two SHA-1 compressions per iteration instead of four */
+    CHECK(time < reference_time * 0.75);
+}
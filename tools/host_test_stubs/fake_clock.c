@@ -0,0 +1,12 @@
+#include <stdint.h>
+#include <time.h>
+
+/* Code under test is built with -Dclock_gettime=fake_clock_gettime, so that tests drive its timeouts */
+int64_t fake_clock_s = 1000;
+
+int fake_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    ts->tv_sec = fake_clock_s;
+    ts->tv_nsec = 0;
+    return 0;
+}
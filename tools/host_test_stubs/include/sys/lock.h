@@ -0,0 +1,15 @@
+#pragma once
+
+#include <pthread.h>
+
+typedef pthread_mutex_t _lock_t;
+
+static inline void _lock_acquire(_lock_t *lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+static inline void _lock_release(_lock_t *lock)
+{
+    pthread_mutex_unlock(lock);
+}